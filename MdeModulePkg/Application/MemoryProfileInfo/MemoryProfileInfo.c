@@ -638,6 +638,41 @@ DumpMemoryProfileMemoryRange (
   return (VOID *)Descriptor;
 }
 
+// MU_CHANGE [BEGIN] - Pool allocator statistics
+
+/**
+  Dump memory profile pool statistics information.
+
+  @param[in] PoolStatistics     Pointer to memory profile pool statistics.
+
+**/
+VOID
+DumpMemoryProfilePoolStatistics (
+  IN MEMORY_PROFILE_POOL_STATISTICS  *PoolStatistics
+  )
+{
+  if (PoolStatistics->Header.Signature != MEMORY_PROFILE_POOL_STATISTICS_SIGNATURE) {
+    return;
+  }
+
+  Print (L"MEMORY_PROFILE_POOL_STATISTICS\n");
+  Print (L"  Signature                     - 0x%08x\n", PoolStatistics->Header.Signature);
+  Print (L"  Length                        - 0x%04x\n", PoolStatistics->Header.Length);
+  Print (L"  Revision                      - 0x%04x\n", PoolStatistics->Header.Revision);
+  Print (L"  PageRunCacheEnabled           - 0x%02x\n", PoolStatistics->PageRunCacheEnabled);
+  Print (L"  AllocateCount                 - 0x%016lx\n", PoolStatistics->AllocateCount);
+  Print (L"  FreeCount                     - 0x%016lx\n", PoolStatistics->FreeCount);
+  Print (L"  RequestedBytes                - 0x%016lx\n", PoolStatistics->RequestedBytes);
+  Print (L"  ReservedBytes                 - 0x%016lx\n", PoolStatistics->ReservedBytes);
+  Print (L"  PageAllocations               - 0x%016lx\n", PoolStatistics->PageAllocations);
+  Print (L"  PageFrees                     - 0x%016lx\n", PoolStatistics->PageFrees);
+  Print (L"  PageRunCacheHits              - 0x%016lx\n", PoolStatistics->PageRunCacheHits);
+  Print (L"  PageRunCacheMisses            - 0x%016lx\n", PoolStatistics->PageRunCacheMisses);
+  Print (L"  PageRunCachedPages            - 0x%016lx\n", PoolStatistics->PageRunCachedPages);
+}
+
+// MU_CHANGE [END]
+
 /**
   Scan memory profile by Signature.
 
@@ -695,15 +730,24 @@ DumpMemoryProfile (
   IN BOOLEAN           IsForSmm
   )
 {
-  MEMORY_PROFILE_CONTEXT       *Context;
-  MEMORY_PROFILE_FREE_MEMORY   *FreeMemory;
-  MEMORY_PROFILE_MEMORY_RANGE  *MemoryRange;
+  MEMORY_PROFILE_CONTEXT          *Context;
+  MEMORY_PROFILE_FREE_MEMORY      *FreeMemory;
+  MEMORY_PROFILE_MEMORY_RANGE     *MemoryRange;
+  MEMORY_PROFILE_POOL_STATISTICS  *PoolStatistics; // MU_CHANGE
 
   Context = (MEMORY_PROFILE_CONTEXT *)ScanMemoryProfileBySignature (ProfileBuffer, ProfileSize, MEMORY_PROFILE_CONTEXT_SIGNATURE);
   if (Context != NULL) {
     DumpMemoryProfileContext (Context, IsForSmm);
   }
 
+  // MU_CHANGE [BEGIN] - Pool allocator statistics
+  PoolStatistics = (MEMORY_PROFILE_POOL_STATISTICS *)ScanMemoryProfileBySignature (ProfileBuffer, ProfileSize, MEMORY_PROFILE_POOL_STATISTICS_SIGNATURE);
+  if (PoolStatistics != NULL) {
+    DumpMemoryProfilePoolStatistics (PoolStatistics);
+  }
+
+  // MU_CHANGE [END]
+
   FreeMemory = (MEMORY_PROFILE_FREE_MEMORY *)ScanMemoryProfileBySignature (ProfileBuffer, ProfileSize, MEMORY_PROFILE_FREE_MEMORY_SIGNATURE);
   if (FreeMemory != NULL) {
     DumpMemoryProfileFreeMemory (FreeMemory);
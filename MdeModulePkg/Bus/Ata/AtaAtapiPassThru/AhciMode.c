@@ -2881,8 +2881,9 @@ AhciModeInitialization (
   EFI_ATA_DEVICE_TYPE      DeviceType;
   EFI_ATA_COLLECTIVE_MODE  *SupportedModes;
   EFI_ATA_TRANSFER_MODE    TransferMode;
-  UINT32                   PhyDetectDelay;
   UINT32                   Value;
+  UINT32                   StartedPortBitMap; // MU_CHANGE - Bring up the AHCI ports concurrently
+  UINT32                   ReadyPortBitMap;   // MU_CHANGE - Bring up the AHCI ports concurrently
 
   if (Instance == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -2949,6 +2950,13 @@ AhciModeInitialization (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  AhciNcqInitialize (Instance); // MU_CHANGE - AHCI native command queuing
+
+  // MU_CHANGE [BEGIN] - Bring up the AHCI ports concurrently
+  StartedPortBitMap = 0;
+  ReadyPortBitMap   = 0;
+  // MU_CHANGE [END]
+
   for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
     if ((PortImplementBitMap & (((UINT32)BIT0) << Port)) != 0) {
       //
@@ -2959,7 +2967,7 @@ AhciModeInitialization (
         // Should never be here.
         //
         ASSERT (FALSE);
-        return EFI_SUCCESS;
+        break; // MU_CHANGE - Bring up the AHCI ports concurrently: still set up the devices of the ports already started
       }
 
       IdeInit->NotifyPhase (IdeInit, EfiIdeBeforeChannelEnumeration, Port);
@@ -3011,51 +3019,28 @@ AhciModeInitialization (
       Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
       AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_FRE);
 
+      // MU_CHANGE [BEGIN] - Bring up the AHCI ports concurrently
       //
-      // Wait for the Phy to detect the presence of a device.
+      // Wait for the device of this port before starting the next port, unless
+      // the devices of all the ports are waited for together once they are all
+      // started, so that they spin up at the same time.
       //
-      PhyDetectDelay = EFI_AHCI_BUS_PHY_DETECT_TIMEOUT;
-      Offset         = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SSTS;
-      do {
-        Data = AhciReadReg (PciIo, Offset) & EFI_AHCI_PORT_SSTS_DET_MASK;
-        if ((Data == EFI_AHCI_PORT_SSTS_DET_PCE) || (Data == EFI_AHCI_PORT_SSTS_DET)) {
-          break;
-        }
-
-        MicroSecondDelay (1000);
-        PhyDetectDelay--;
-      } while (PhyDetectDelay > 0);
-
-      if (PhyDetectDelay == 0) {
-        //
-        // No device detected at this port.
-        // Clear PxCMD.SUD for those ports at which there are no device present.
-        //
-        Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
-        AhciAndReg (PciIo, Offset, (UINT32) ~(EFI_AHCI_PORT_CMD_SUD));
-        continue;
+      if (FeaturePcdGet (PcdAhciConcurrentPortInit)) {
+        StartedPortBitMap |= ((UINT32)BIT0) << Port;
+      } else {
+        ReadyPortBitMap |= AhciWaitPortsReady (PciIo, ((UINT32)BIT0) << Port);
       }
+    }
+  }
 
-      Status = AhciWaitDeviceReady (PciIo, Port);
-      if (EFI_ERROR (Status)) {
-        continue;
-      }
+  if (StartedPortBitMap != 0) {
+    ReadyPortBitMap = AhciWaitPortsReady (PciIo, StartedPortBitMap);
+  }
 
-      //
-      // When the first D2H register FIS is received, the content of PxSIG register is updated.
-      //
+  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+    if ((ReadyPortBitMap & (((UINT32)BIT0) << Port)) != 0) {
       Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SIG;
-      Status = AhciWaitMmioSet (
-                 PciIo,
-                 Offset,
-                 0x0000FFFF,
-                 0x00000101,
-                 EFI_TIMER_PERIOD_SECONDS (16)
-                 );
-      if (EFI_ERROR (Status)) {
-        continue;
-      }
-
+      // MU_CHANGE [END]
       Data = AhciReadReg (PciIo, Offset);
       if ((Data & EFI_AHCI_ATAPI_SIG_MASK) == EFI_AHCI_ATAPI_DEVICE_SIG) {
         Status = AhciIdentifyPacket (PciIo, AhciRegisters, Port, 0, &Buffer);
@@ -14,6 +14,7 @@
 #define EFI_AHCI_CAPABILITY_OFFSET  0x0000
 #define   EFI_AHCI_CAP_SAM          BIT18
 #define   EFI_AHCI_CAP_SSS          BIT27
+#define   EFI_AHCI_CAP_SNCQ         BIT30 // MU_CHANGE - AHCI native command queuing
 #define   EFI_AHCI_CAP_S64A         BIT31
 #define EFI_AHCI_GHC_OFFSET         0x0004
 #define   EFI_AHCI_GHC_RESET        BIT0
@@ -394,4 +395,164 @@ AhciStopCommand (
   IN  UINT64               Timeout
   );
 
+// MU_CHANGE [BEGIN] - Bring up the AHCI ports concurrently
+
+/**
+  Read AHCI Operation register.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+
+  @return The register content read.
+
+**/
+UINT32
+EFIAPI
+AhciReadReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT32              Offset
+  );
+
+/**
+  Write AHCI Operation register.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+  @param  Data         The data used to write down.
+
+**/
+VOID
+EFIAPI
+AhciWriteReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               Offset,
+  IN UINT32               Data
+  );
+
+/**
+  Do AND operation with the value of AHCI Operation register.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+  @param  AndData      The data used to do AND operation.
+
+**/
+VOID
+EFIAPI
+AhciAndReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               Offset,
+  IN UINT32               AndData
+  );
+
+// MU_CHANGE [END]
+
+// MU_CHANGE [BEGIN] - AHCI native command queuing
+
+/**
+  Do OR operation with the value of AHCI Operation register.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+  @param  OrData       The data used to do OR operation.
+
+**/
+VOID
+EFIAPI
+AhciOrReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               Offset,
+  IN UINT32               OrData
+  );
+
+/**
+
+  Clear the port interrupt and error status. It will also clear
+  HBA interrupt status.
+
+  @param      PciIo          The PCI IO protocol instance.
+  @param      Port           The number of port.
+
+**/
+VOID
+EFIAPI
+AhciClearPortStatus (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                Port
+  );
+
+/**
+  Enable the FIS running for giving port.
+
+  @param      PciIo          The PCI IO protocol instance.
+  @param      Port           The number of port.
+  @param      Timeout        The timeout value of enabling FIS, uses 100ns as a unit.
+
+  @retval EFI_DEVICE_ERROR   The FIS enable setting fails.
+  @retval EFI_TIMEOUT        The FIS enable setting is time out.
+  @retval EFI_SUCCESS        The FIS enable successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciEnableFisReceive (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                Port,
+  IN  UINT64               Timeout
+  );
+
+/**
+  Disable the FIS running for giving port.
+
+  @param      PciIo          The PCI IO protocol instance.
+  @param      Port           The number of port.
+  @param      Timeout        The timeout value of disabling FIS, uses 100ns as a unit.
+
+  @retval EFI_DEVICE_ERROR   The FIS disable setting fails.
+  @retval EFI_TIMEOUT        The FIS disable setting is time out.
+  @retval EFI_UNSUPPORTED    The port is in running state.
+  @retval EFI_SUCCESS        The FIS disable successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciDisableFisReceive (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                Port,
+  IN  UINT64               Timeout
+  );
+
+/**
+  Build a command FIS.
+
+  @param  CmdFis            A pointer to the EFI_AHCI_COMMAND_FIS data structure.
+  @param  AtaCommandBlock   A pointer to the AhciBuildCommandFis data structure.
+
+**/
+VOID
+EFIAPI
+AhciBuildCommandFis (
+  IN OUT EFI_AHCI_COMMAND_FIS   *CmdFis,
+  IN     EFI_ATA_COMMAND_BLOCK  *AtaCommandBlock
+  );
+
+/**
+  Recovers the SATA port from error condition.
+  This function implements algorithm described in
+  AHCI spec 1.3.1 section 6.2.2
+
+  @param[in] PciIo    Pointer to AHCI controller PciIo.
+  @param[in] Port     SATA port index on which to check.
+
+  @retval EFI_SUCCESS  Port recovered.
+  @retval Others       Failed to recover port.
+**/
+EFI_STATUS
+AhciRecoverPortError (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT8                Port
+  );
+
+// MU_CHANGE [END]
+
 #endif
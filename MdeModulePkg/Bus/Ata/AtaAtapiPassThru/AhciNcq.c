@@ -0,0 +1,571 @@
+/** @file
+  Native command queuing of the AHCI controllers.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "AtaAtapiPassThru.h"
+
+/**
+  Allocate the command tables of the queued commands of a controller.
+
+  The controller works without native command queuing if PcdAtaNcqQueueDepth
+  is zero, if it does not support it or if the command tables cannot be
+  allocated.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+
+**/
+VOID
+AhciNcqInitialize (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  )
+{
+  AHCI_NCQ_CONTEXT      *Ncq;
+  EFI_PCI_IO_PROTOCOL   *PciIo;
+  EFI_STATUS            Status;
+  UINT32                Capability;
+  UINT32                Depth;
+  UINTN                 Bytes;
+  UINTN                 MappedBytes;
+  VOID                  *Buffer;
+  EFI_PHYSICAL_ADDRESS  PciAddr;
+  VOID                  *Map;
+
+  Ncq   = &Instance->Ncq;
+  PciIo = Instance->PciIo;
+  ZeroMem (Ncq, sizeof (AHCI_NCQ_CONTEXT));
+
+  Depth = PcdGet8 (PcdAtaNcqQueueDepth);
+  if (Depth == 0) {
+    return;
+  }
+
+  Capability = AhciReadReg (PciIo, EFI_AHCI_CAPABILITY_OFFSET);
+  if ((Capability & EFI_AHCI_CAP_SNCQ) == 0) {
+    DEBUG ((DEBUG_INFO, "AHCI controller does not support native command queuing\n"));
+    return;
+  }
+
+  //
+  // Slot 0 is left to the commands that are not queued.
+  //
+  Depth = MIN (Depth, (Capability & 0x1F00) >> 8);
+  Depth = MIN (Depth, AHCI_NCQ_MAX_DEPTH);
+  if (Depth == 0) {
+    return;
+  }
+
+  Bytes  = Depth * sizeof (AHCI_NCQ_COMMAND_TABLE);
+  Status = PciIo->AllocateBuffer (
+                    PciIo,
+                    AllocateAnyPages,
+                    EfiBootServicesData,
+                    EFI_SIZE_TO_PAGES (Bytes),
+                    &Buffer,
+                    0
+                    );
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  ZeroMem (Buffer, Bytes);
+  MappedBytes = Bytes;
+  Status      = PciIo->Map (
+                         PciIo,
+                         EfiPciIoOperationBusMasterCommonBuffer,
+                         Buffer,
+                         &MappedBytes,
+                         &PciAddr,
+                         &Map
+                         );
+  if (EFI_ERROR (Status) || (MappedBytes != Bytes) ||
+      (((Capability & EFI_AHCI_CAP_S64A) == 0) && (PciAddr + Bytes > 0x100000000ULL)))
+  {
+    if (!EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, Map);
+    }
+
+    PciIo->FreeBuffer (PciIo, EFI_SIZE_TO_PAGES (Bytes), Buffer);
+    return;
+  }
+
+  Ncq->CommandTables        = Buffer;
+  Ncq->CommandTablesPciAddr = PciAddr;
+  Ncq->CommandTablesMap     = Map;
+  Ncq->CommandTablesPages   = EFI_SIZE_TO_PAGES (Bytes);
+  Ncq->SlotBitMap           = (UINT32)(LShiftU64 (1, Depth + 1) - 2);
+
+  DEBUG ((DEBUG_INFO, "AHCI native command queuing enabled, %d slots\n", Depth));
+}
+
+/**
+  Free the command tables of the queued commands of a controller.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+
+**/
+VOID
+AhciNcqCleanup (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  )
+{
+  AHCI_NCQ_CONTEXT     *Ncq;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+
+  Ncq   = &Instance->Ncq;
+  PciIo = Instance->PciIo;
+
+  if (Ncq->CommandTables == NULL) {
+    return;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "AHCI NCQ: %Lu commands, %Lu errors, at most %d in flight\n",
+    Ncq->Statistics.Commands,
+    Ncq->Statistics.Errors,
+    Ncq->Statistics.MaxInFlight
+    ));
+
+  PciIo->Unmap (PciIo, Ncq->CommandTablesMap);
+  PciIo->FreeBuffer (PciIo, Ncq->CommandTablesPages, Ncq->CommandTables);
+  ZeroMem (Ncq, sizeof (AHCI_NCQ_CONTEXT));
+}
+
+/**
+  Tell whether a command can be queued on a device.
+
+  @param[in] Instance            The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+  @param[in] Port                The port number of the device.
+  @param[in] PortMultiplierPort  The port multiplier port number of the device.
+  @param[in] IdentifyData        The IDENTIFY data of the device.
+  @param[in] Packet              The command.
+  @param[in] Event               The event of a non-blocking command, or NULL.
+
+  @retval TRUE   The command is a non-blocking READ or WRITE FPDMA QUEUED
+                 command that the controller and the device can queue.
+  @retval FALSE  Otherwise.
+
+**/
+BOOLEAN
+AhciNcqSupported (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE      *Instance,
+  IN UINT16                            Port,
+  IN UINT16                            PortMultiplierPort,
+  IN EFI_IDENTIFY_DATA                 *IdentifyData,
+  IN EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet,
+  IN EFI_EVENT                         Event OPTIONAL
+  )
+{
+  UINT16  SataCapabilities;
+
+  if ((Event == NULL) || (Instance->Mode != EfiAtaAhciMode) || (Instance->Ncq.CommandTables == NULL)) {
+    return FALSE;
+  }
+
+  if ((Port >= EFI_AHCI_MAX_PORTS) || (PortMultiplierPort != 0xFFFF)) {
+    return FALSE;
+  }
+
+  if ((Packet->Protocol != EFI_ATA_PASS_THRU_PROTOCOL_FPDMA) ||
+      ((Packet->Acb->AtaCommand != ATA_CMD_READ_FPDMA_QUEUED) && (Packet->Acb->AtaCommand != ATA_CMD_WRITE_FPDMA_QUEUED)))
+  {
+    return FALSE;
+  }
+
+  //
+  // Word 76 bit 8 tells that the device supports native command queuing.
+  //
+  SataCapabilities = IdentifyData->AtaData.serial_ata_capabilities;
+  if ((SataCapabilities == 0xFFFF) || ((SataCapabilities & BIT8) == 0)) {
+    return FALSE;
+  }
+
+  Instance->Ncq.PortDepth[Port] = (UINT8)((IdentifyData->AtaData.queue_depth & 0x1F) + 1);
+  return TRUE;
+}
+
+/**
+  Start the FIS receive and command list DMA engines of a port for queued
+  commands.
+
+  @param[in] PciIo  The PCI IO protocol instance.
+  @param[in] Port   The number of port.
+
+  @return The status of AhciEnableFisReceive().
+
+**/
+EFI_STATUS
+AhciNcqStartPort (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT8                Port
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Offset;
+
+  AhciClearPortStatus (PciIo, Port);
+
+  Status = AhciEnableFisReceive (PciIo, Port, ATA_ATAPI_TIMEOUT);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+  AhciAndReg (PciIo, Offset, (UINT32) ~(EFI_AHCI_PORT_CMD_DLAE | EFI_AHCI_PORT_CMD_ATAPI));
+  AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_ST);
+  return EFI_SUCCESS;
+}
+
+/**
+  Stop the DMA engines of a port that has no queued command in flight.
+
+  @param[in] PciIo  The PCI IO protocol instance.
+  @param[in] Port   The number of port.
+
+**/
+VOID
+AhciNcqStopPort (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT8                Port
+  )
+{
+  AhciStopCommand (PciIo, Port, ATA_ATAPI_TIMEOUT);
+  AhciDisableFisReceive (PciIo, Port, ATA_ATAPI_TIMEOUT);
+}
+
+/**
+  Start a queued command in a free slot.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+  @param[in] Task      The task of the command.
+  @param[in] Slot      The slot of the command.
+
+  @retval EFI_SUCCESS           The command was started.
+  @retval EFI_BAD_BUFFER_SIZE   The data buffer could not be mapped.
+  @retval Others                The port could not be started.
+
+**/
+EFI_STATUS
+AhciNcqStartCommand (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN ATA_NONBLOCK_TASK             *Task,
+  IN UINT32                        Slot
+  )
+{
+  AHCI_NCQ_CONTEXT                  *Ncq;
+  EFI_PCI_IO_PROTOCOL               *PciIo;
+  EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet;
+  AHCI_NCQ_COMMAND_TABLE            *CommandTable;
+  EFI_AHCI_COMMAND_LIST             *CommandList;
+  EFI_STATUS                        Status;
+  BOOLEAN                           Read;
+  VOID                              *Buffer;
+  UINT32                            DataCount;
+  UINTN                             MapLength;
+  EFI_PHYSICAL_ADDRESS              PhyAddr;
+  VOID                              *Map;
+  UINT32                            PrdtNumber;
+  UINT32                            PrdtIndex;
+  UINT32                            Offset;
+  UINT8                             Port;
+  DATA_64                           Data64;
+
+  Ncq    = &Instance->Ncq;
+  PciIo  = Instance->PciIo;
+  Packet = Task->Packet;
+  Port   = (UINT8)Task->Port;
+
+  Read = (BOOLEAN)(Packet->Acb->AtaCommand == ATA_CMD_READ_FPDMA_QUEUED);
+  if (Read) {
+    Buffer    = Packet->InDataBuffer;
+    DataCount = Packet->InTransferLength;
+  } else {
+    Buffer    = Packet->OutDataBuffer;
+    DataCount = Packet->OutTransferLength;
+  }
+
+  PrdtNumber = (DataCount + EFI_AHCI_MAX_DATA_PER_PRDT - 1) / EFI_AHCI_MAX_DATA_PER_PRDT;
+  if ((PrdtNumber == 0) || (PrdtNumber > AHCI_NCQ_PRDT_ENTRIES)) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  MapLength = DataCount;
+  Status    = PciIo->Map (
+                       PciIo,
+                       Read ? EfiPciIoOperationBusMasterWrite : EfiPciIoOperationBusMasterRead,
+                       Buffer,
+                       &MapLength,
+                       &PhyAddr,
+                       &Map
+                       );
+  if (EFI_ERROR (Status) || (MapLength != DataCount)) {
+    if (!EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, Map);
+    }
+
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  if (Ncq->PortInFlight[Port] == 0) {
+    Status = AhciNcqStartPort (PciIo, Port);
+    if (EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, Map);
+      return Status;
+    }
+  }
+
+  //
+  // The tag of the command is its slot, in bits 7:3 of the sector count.
+  //
+  CommandTable = &Ncq->CommandTables[Slot - 1];
+  ZeroMem (CommandTable, sizeof (AHCI_NCQ_COMMAND_TABLE));
+  AhciBuildCommandFis (&CommandTable->CommandFis, Packet->Acb);
+  CommandTable->CommandFis.AhciCFisSecCount = (UINT8)(Slot << 3);
+  CommandTable->CommandFis.AhciCFisDevHead  = (UINT8)(Packet->Acb->AtaDeviceHead | BIT6);
+
+  for (PrdtIndex = 0; PrdtIndex < PrdtNumber; PrdtIndex++) {
+    Data64.Uint64                                      = PhyAddr + (UINT64)PrdtIndex * EFI_AHCI_MAX_DATA_PER_PRDT;
+    CommandTable->PrdtTable[PrdtIndex].AhciPrdtDba  = Data64.Uint32.Lower32;
+    CommandTable->PrdtTable[PrdtIndex].AhciPrdtDbau = Data64.Uint32.Upper32;
+    CommandTable->PrdtTable[PrdtIndex].AhciPrdtDbc  = MIN (DataCount - PrdtIndex * EFI_AHCI_MAX_DATA_PER_PRDT, EFI_AHCI_MAX_DATA_PER_PRDT) - 1;
+  }
+
+  CommandTable->PrdtTable[PrdtNumber - 1].AhciPrdtIoc = 1;
+
+  CommandList = &Instance->AhciRegisters.AhciCmdList[Slot];
+  ZeroMem (CommandList, sizeof (EFI_AHCI_COMMAND_LIST));
+  CommandList->AhciCmdCfl   = EFI_AHCI_FIS_REGISTER_H2D_LENGTH / 4;
+  CommandList->AhciCmdW     = Read ? 0 : 1;
+  CommandList->AhciCmdPrdtl = PrdtNumber;
+  Data64.Uint64             = Ncq->CommandTablesPciAddr + (Slot - 1) * sizeof (AHCI_NCQ_COMMAND_TABLE);
+  CommandList->AhciCmdCtba  = Data64.Uint32.Lower32;
+  CommandList->AhciCmdCtbau = Data64.Uint32.Upper32;
+
+  //
+  // PxSACT must be set before PxCI. Both registers only take the bits written
+  // as one, so the commands already in flight are not affected.
+  //
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SACT;
+  AhciWriteReg (PciIo, Offset, BIT0 << Slot);
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CI;
+  AhciWriteReg (PciIo, Offset, BIT0 << Slot);
+
+  Task->Map           = Map;
+  Task->IsStart       = TRUE;
+  Ncq->SlotTask[Slot] = Task;
+  Ncq->BusySlots     |= BIT0 << Slot;
+  Ncq->PortInFlight[Port]++;
+
+  Ncq->Statistics.Commands++;
+  Ncq->Statistics.MaxInFlight = MAX (Ncq->Statistics.MaxInFlight, (UINT32)BitFieldCountOnes32 (Ncq->BusySlots, 0, 31));
+  return EFI_SUCCESS;
+}
+
+/**
+  Complete the queued commands of a port that are done.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+  @param[in] Port      The number of port.
+
+  @retval EFI_SUCCESS       No command of the port failed.
+  @retval EFI_DEVICE_ERROR  The port reported an error.
+  @retval EFI_TIMEOUT       A command of the port timed out.
+
+**/
+EFI_STATUS
+AhciNcqCompletePort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port
+  )
+{
+  AHCI_NCQ_CONTEXT     *Ncq;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  ATA_NONBLOCK_TASK    *Task;
+  UINT32               PortBase;
+  UINT32               PortInterrupt;
+  UINT32               PortTfd;
+  UINT32               Active;
+  UINT32               Slots;
+  UINT32               Slot;
+
+  Ncq      = &Instance->Ncq;
+  PciIo    = Instance->PciIo;
+  PortBase = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH;
+
+  PortInterrupt = AhciReadReg (PciIo, PortBase + EFI_AHCI_PORT_IS);
+  PortTfd       = AhciReadReg (PciIo, PortBase + EFI_AHCI_PORT_TFD);
+  if (((PortInterrupt & EFI_AHCI_PORT_IS_ERROR_MASK) != 0) || ((PortTfd & EFI_AHCI_PORT_TFD_ERR) != 0)) {
+    DEBUG ((DEBUG_ERROR, "AHCI NCQ: port %d failed, PxIS 0x%x, PxTFD 0x%x\n", Port, PortInterrupt, PortTfd));
+    return EFI_DEVICE_ERROR;
+  }
+
+  Active = AhciReadReg (PciIo, PortBase + EFI_AHCI_PORT_SACT) | AhciReadReg (PciIo, PortBase + EFI_AHCI_PORT_CI);
+
+  for (Slots = Ncq->BusySlots; Slots != 0; Slots &= Slots - 1) {
+    Slot = (UINT32)LowBitSet32 (Slots);
+    Task = Ncq->SlotTask[Slot];
+    if (Task->Port != Port) {
+      continue;
+    }
+
+    if ((Active & (BIT0 << Slot)) != 0) {
+      if (!Task->InfiniteWait) {
+        if (Task->RetryTimes == 0) {
+          DEBUG ((DEBUG_ERROR, "AHCI NCQ: command in slot %d of port %d timed out\n", Slot, Port));
+          return EFI_TIMEOUT;
+        }
+
+        Task->RetryTimes--;
+      }
+
+      continue;
+    }
+
+    PciIo->Unmap (PciIo, Task->Map);
+    Task->Map = NULL;
+    ZeroMem (Task->Packet->Asb, sizeof (EFI_ATA_STATUS_BLOCK));
+    Task->Packet->Asb->AtaStatus = (UINT8)PortTfd;
+
+    Ncq->SlotTask[Slot] = NULL;
+    Ncq->BusySlots     &= ~(BIT0 << Slot);
+    Ncq->PortInFlight[Port]--;
+
+    RemoveEntryList (&Task->Link);
+    gBS->SignalEvent (Task->Event);
+    FreePool (Task);
+  }
+
+  if (Ncq->PortInFlight[Port] == 0) {
+    AhciNcqStopPort (PciIo, Port);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Complete the queued commands that are done and start the queued commands at
+  the head of the non-blocking task list, as far as free slots allow.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+
+  @retval EFI_SUCCESS    No queued command is left at the head of the list.
+  @retval EFI_NOT_READY  Queued commands are in flight.
+  @retval Others         A queued command failed or timed out. All the queued
+                         commands in flight were aborted.
+
+**/
+EFI_STATUS
+AhciNcqTransferRoutine (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  )
+{
+  AHCI_NCQ_CONTEXT   *Ncq;
+  LIST_ENTRY         *Entry;
+  ATA_NONBLOCK_TASK  *Task;
+  EFI_STATUS         Status;
+  UINT32             FreeSlots;
+  UINT8              Port;
+
+  Ncq = &Instance->Ncq;
+
+  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+    if (Ncq->PortInFlight[Port] == 0) {
+      continue;
+    }
+
+    Status = AhciNcqCompletePort (Instance, Port);
+    if (EFI_ERROR (Status)) {
+      Ncq->Statistics.Errors++;
+      AhciNcqAbort (Instance);
+      return Status;
+    }
+  }
+
+  //
+  // Start the queued commands up to the first command that is not queued,
+  // which waits for them to complete.
+  //
+  for (Entry = GetFirstNode (&Instance->NonBlockingTaskList);
+       !IsNull (&Instance->NonBlockingTaskList, Entry);
+       Entry = GetNextNode (&Instance->NonBlockingTaskList, Entry))
+  {
+    Task = ATA_NON_BLOCK_TASK_FROM_ENTRY (Entry);
+    if (Task->Packet->Protocol != EFI_ATA_PASS_THRU_PROTOCOL_FPDMA) {
+      break;
+    }
+
+    FreeSlots = Ncq->SlotBitMap & ~Ncq->BusySlots;
+    if (FreeSlots == 0) {
+      break;
+    }
+
+    if (Task->IsStart || (Ncq->PortInFlight[Task->Port] >= Ncq->PortDepth[Task->Port])) {
+      continue;
+    }
+
+    Status = AhciNcqStartCommand (Instance, Task, (UINT32)LowBitSet32 (FreeSlots));
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "AHCI NCQ: failed to start a command on port %d - %r\n", Task->Port, Status));
+      Ncq->Statistics.Errors++;
+      AhciNcqAbort (Instance);
+      return Status;
+    }
+  }
+
+  if (IsListEmpty (&Instance->NonBlockingTaskList)) {
+    return EFI_SUCCESS;
+  }
+
+  Task = ATA_NON_BLOCK_TASK_FROM_ENTRY (GetFirstNode (&Instance->NonBlockingTaskList));
+  return (Task->Packet->Protocol == EFI_ATA_PASS_THRU_PROTOCOL_FPDMA) ? EFI_NOT_READY : EFI_SUCCESS;
+}
+
+/**
+  Abort the queued commands in flight.
+
+  The ports with queued commands in flight are stopped, the data buffers of
+  the commands are unmapped and their status block reports an error. The tasks
+  are left in the non-blocking task list.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+
+**/
+VOID
+AhciNcqAbort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  )
+{
+  AHCI_NCQ_CONTEXT     *Ncq;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  ATA_NONBLOCK_TASK    *Task;
+  UINT32               Slot;
+  UINT8                Port;
+
+  Ncq   = &Instance->Ncq;
+  PciIo = Instance->PciIo;
+
+  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+    if (Ncq->PortInFlight[Port] != 0) {
+      AhciRecoverPortError (PciIo, Port);
+      AhciNcqStopPort (PciIo, Port);
+      Ncq->PortInFlight[Port] = 0;
+    }
+  }
+
+  while (Ncq->BusySlots != 0) {
+    Slot = (UINT32)LowBitSet32 (Ncq->BusySlots);
+    Task = Ncq->SlotTask[Slot];
+
+    PciIo->Unmap (PciIo, Task->Map);
+    Task->Map                    = NULL;
+    Task->IsStart                = FALSE;
+    Task->Packet->Asb->AtaStatus = 0x01;
+
+    Ncq->SlotTask[Slot] = NULL;
+    Ncq->BusySlots     &= ~(BIT0 << Slot);
+  }
+}
@@ -0,0 +1,75 @@
+/** @file
+  Native command queuing of the AHCI controllers.
+
+  When PcdAtaNcqQueueDepth is not zero, READ FPDMA QUEUED and WRITE FPDMA
+  QUEUED commands sent in non-blocking mode are not executed one at a time
+  like the other non-blocking commands. The queued commands at the head of the
+  non-blocking task list are started together, each in its own command slot
+  and command table, up to the queue depth of the controller and of each
+  device, and they complete in any order. A command that is not queued waits
+  for the queued commands ahead of it in the list to complete, and the queued
+  commands after it wait for it.
+
+  The command list is shared by all the ports, so the queued commands of all
+  the ports share its slots. Slot 0 is left to the commands that are not
+  queued. Only the devices attached directly to a port queue commands.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef AHCI_NCQ_H_
+#define AHCI_NCQ_H_
+
+//
+// Number of PRDT entries of the command table of a queued command, enough for
+// 0x10000 blocks of 4 KB.
+//
+#define AHCI_NCQ_PRDT_ENTRIES  64
+
+//
+// Maximum number of queued commands of a controller, slot 0 excepted.
+//
+#define AHCI_NCQ_MAX_DEPTH  31
+
+#pragma pack(1)
+
+///
+/// Command table of a queued command.
+///
+typedef struct {
+  EFI_AHCI_COMMAND_FIS      CommandFis;
+  EFI_AHCI_ATAPI_COMMAND    AtapiCmd;
+  UINT8                     Reserved[0x30];
+  EFI_AHCI_COMMAND_PRDT     PrdtTable[AHCI_NCQ_PRDT_ENTRIES];
+} AHCI_NCQ_COMMAND_TABLE;
+
+#pragma pack()
+
+///
+/// Counters of the queued commands of a controller.
+///
+typedef struct {
+  UINT64    Commands;                 ///< Queued commands started.
+  UINT64    Errors;                   ///< Failed or timed out queued commands.
+  UINT32    MaxInFlight;              ///< Highest number of queued commands in flight together.
+} AHCI_NCQ_STATISTICS;
+
+///
+/// Native command queuing state of a controller.
+///
+typedef struct {
+  AHCI_NCQ_COMMAND_TABLE       *CommandTables;                          ///< Slot N uses entry N - 1, NULL if NCQ is disabled.
+  EFI_PHYSICAL_ADDRESS         CommandTablesPciAddr;
+  VOID                         *CommandTablesMap;
+  UINTN                        CommandTablesPages;
+  UINT32                       SlotBitMap;                              ///< Slots usable by queued commands.
+  UINT32                       BusySlots;                               ///< Slots of the queued commands in flight.
+  struct _ATA_NONBLOCK_TASK    *SlotTask[AHCI_NCQ_MAX_DEPTH + 1];
+  UINT8                        PortDepth[EFI_AHCI_MAX_PORTS];           ///< Queue depth of the device of each port.
+  UINT8                        PortInFlight[EFI_AHCI_MAX_PORTS];        ///< Queued commands in flight on each port.
+  AHCI_NCQ_STATISTICS          Statistics;
+} AHCI_NCQ_CONTEXT;
+
+#endif
@@ -0,0 +1,141 @@
+/** @file
+  Concurrent bring-up of the AHCI ports.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "AtaAtapiPassThru.h"
+
+///
+/// Progress of the bring-up of a port.
+///
+typedef enum {
+  AhciPortWaitDetect,
+  AhciPortWaitReady,
+  AhciPortWaitSignature
+} AHCI_PORT_WAIT_STATE;
+
+/**
+  Wait for the devices attached to ports that have been started to be detected,
+  to get ready for operation and to send their signature, polling all the ports
+  together.
+
+  PxCMD.SUD is cleared on the ports at which no device is detected.
+
+  @param[in] PciIo       Pointer to AHCI controller PciIo.
+  @param[in] PortBitMap  The ports to wait for. Their FIS receive DMA engine must
+                         be enabled and their device spun up.
+
+  @return The bit map of the ports whose device sent its signature.
+
+**/
+UINT32
+AhciWaitPortsReady (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               PortBitMap
+  )
+{
+  AHCI_PORT_WAIT_STATE  State[EFI_AHCI_MAX_PORTS];
+  UINT64                Deadline[EFI_AHCI_MAX_PORTS];
+  UINT32                PendingBitMap;
+  UINT32                ReadyBitMap;
+  UINT32                PortBit;
+  UINT64                Elapsed;
+  UINT32                Offset;
+  UINT32                Data;
+  UINT8                 Port;
+
+  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+    State[Port]    = AhciPortWaitDetect;
+    Deadline[Port] = EFI_AHCI_BUS_PHY_DETECT_TIMEOUT * 1000;
+  }
+
+  PendingBitMap = PortBitMap;
+  ReadyBitMap   = 0;
+  Elapsed       = 0;
+
+  while (PendingBitMap != 0) {
+    for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+      PortBit = ((UINT32)BIT0) << Port;
+      if ((PendingBitMap & PortBit) == 0) {
+        continue;
+      }
+
+      if (State[Port] == AhciPortWaitDetect) {
+        //
+        // Wait for the Phy to detect the presence of a device.
+        //
+        Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SSTS;
+        Data   = AhciReadReg (PciIo, Offset) & EFI_AHCI_PORT_SSTS_DET_MASK;
+        if ((Data == EFI_AHCI_PORT_SSTS_DET_PCE) || (Data == EFI_AHCI_PORT_SSTS_DET)) {
+          State[Port]    = AhciPortWaitReady;
+          Deadline[Port] = Elapsed + AHCI_PORT_DEVICE_READY_TIMEOUT;
+        } else if (Elapsed >= Deadline[Port]) {
+          //
+          // No device detected at this port.
+          // Clear PxCMD.SUD for those ports at which there are no device present.
+          //
+          Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+          AhciAndReg (PciIo, Offset, (UINT32) ~(EFI_AHCI_PORT_CMD_SUD));
+          PendingBitMap &= ~PortBit;
+          continue;
+        }
+      }
+
+      if (State[Port] == AhciPortWaitReady) {
+        //
+        // According to SATA1.0a spec section 5.2, we need to wait for PxTFD.BSY and PxTFD.DRQ
+        // and PxTFD.ERR to be zero.
+        //
+        Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SERR;
+        Data   = AhciReadReg (PciIo, Offset);
+        if (Data != 0) {
+          AhciWriteReg (PciIo, Offset, Data);
+        }
+
+        Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_TFD;
+        Data   = AhciReadReg (PciIo, Offset) & EFI_AHCI_PORT_TFD_MASK;
+        if (Data == 0) {
+          State[Port]    = AhciPortWaitSignature;
+          Deadline[Port] = Elapsed + AHCI_PORT_SIGNATURE_TIMEOUT;
+        } else if (Elapsed >= Deadline[Port]) {
+          DEBUG ((DEBUG_ERROR, "Port %d Device not ready (TFD=0x%X)\n", Port, Data));
+          PendingBitMap &= ~PortBit;
+          continue;
+        }
+      }
+
+      if (State[Port] == AhciPortWaitSignature) {
+        //
+        // When the first D2H register FIS is received, the content of PxSIG register is updated.
+        //
+        Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SIG;
+        Data   = AhciReadReg (PciIo, Offset);
+        if ((Data & 0x0000FFFF) == 0x00000101) {
+          ReadyBitMap   |= PortBit;
+          PendingBitMap &= ~PortBit;
+        } else if (Elapsed >= Deadline[Port]) {
+          DEBUG ((DEBUG_ERROR, "Port %d Device signature not received (SIG=0x%X)\n", Port, Data));
+          PendingBitMap &= ~PortBit;
+        }
+      }
+    }
+
+    if (PendingBitMap != 0) {
+      MicroSecondDelay (AHCI_PORT_POLL_INTERVAL);
+      Elapsed += AHCI_PORT_POLL_INTERVAL;
+    }
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "AhciWaitPortsReady: ports 0x%X of 0x%X ready after %Lu us\n",
+    ReadyBitMap,
+    PortBitMap,
+    Elapsed
+    ));
+
+  return ReadyBitMap;
+}
@@ -0,0 +1,52 @@
+/** @file
+  Concurrent bring-up of the AHCI ports.
+
+  Waiting for the devices attached to the ports of a controller one port at a
+  time costs the spin-up time of every drive in turn. When
+  PcdAhciConcurrentPortInit is TRUE, all the implemented ports are started
+  first, then the device detection, the device ready state and the device
+  signature of all of them are polled together, so that the drives spin up at
+  the same time.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef AHCI_PORT_INIT_H_
+#define AHCI_PORT_INIT_H_
+
+//
+// Interval in microseconds between two polls of the ports.
+//
+#define AHCI_PORT_POLL_INTERVAL  100
+
+//
+// Time in microseconds given to a device to clear PxTFD.BSY, PxTFD.DRQ and
+// PxTFD.ERR once it is detected, and then to send its signature. The maximum
+// wait time is 16s, as defined by the ATA spec.
+//
+#define AHCI_PORT_DEVICE_READY_TIMEOUT  (16 * 1000 * 1000)
+#define AHCI_PORT_SIGNATURE_TIMEOUT     (16 * 1000 * 1000)
+
+/**
+  Wait for the devices attached to ports that have been started to be detected,
+  to get ready for operation and to send their signature, polling all the ports
+  together.
+
+  PxCMD.SUD is cleared on the ports at which no device is detected.
+
+  @param[in] PciIo       Pointer to AHCI controller PciIo.
+  @param[in] PortBitMap  The ports to wait for. Their FIS receive DMA engine must
+                         be enabled and their device spun up.
+
+  @return The bit map of the ports whose device sent its signature.
+
+**/
+UINT32
+AhciWaitPortsReady (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               PortBitMap
+  );
+
+#endif
@@ -418,6 +418,26 @@ AsyncNonBlockingTransferRoutine (
       return;
     }
 
+    // MU_CHANGE [BEGIN] - AHCI native command queuing
+    //
+    // The queued commands at the head of the list are started together and
+    // completed by AhciNcqTransferRoutine().
+    //
+    if (Task->Packet->Protocol == EFI_ATA_PASS_THRU_PROTOCOL_FPDMA) {
+      Status = AhciNcqTransferRoutine (Instance);
+      if (Status == EFI_SUCCESS) {
+        continue;
+      }
+
+      if (Status != EFI_NOT_READY) {
+        DestroyAsynTaskList (Instance, TRUE);
+      }
+
+      break;
+    }
+
+    // MU_CHANGE [END]
+
     Status = AtaPassThruPassThruExecute (
                Task->Port,
                Task->PortMultiplier,
@@ -928,6 +948,7 @@ AtaAtapiPassThruStop (
     Instance->TimerEvent = NULL;
   }
 
+  AhciNcqAbort (Instance); // MU_CHANGE - AHCI native command queuing
   DestroyAsynTaskList (Instance, FALSE);
   //
   // Free allocated resource
@@ -979,6 +1000,7 @@ AtaAtapiPassThruStop (
              EFI_SIZE_TO_PAGES ((UINTN)AhciRegisters->MaxReceiveFisSize),
              AhciRegisters->AhciRFis
              );
+    AhciNcqCleanup (Instance); // MU_CHANGE - AHCI native command queuing
   }
 
   //
@@ -1378,6 +1400,15 @@ AtaPassThruPassThru (
     return EFI_BAD_BUFFER_SIZE;
   }
 
+  // MU_CHANGE [BEGIN] - AHCI native command queuing
+  if ((Packet->Protocol == EFI_ATA_PASS_THRU_PROTOCOL_FPDMA) &&
+      !AhciNcqSupported (Instance, Port, PortMultiplierPort, IdentifyData, Packet, Event))
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  // MU_CHANGE [END]
+
   //
   // For non-blocking mode, queue the Task into the list.
   //
@@ -1406,6 +1437,22 @@ AtaPassThruPassThru (
 
     return EFI_SUCCESS;
   } else {
+    // MU_CHANGE [BEGIN] - AHCI native command queuing
+    //
+    // The blocking commands use slot 0 of the command list and stop the port
+    // when they are done, so the queued commands in flight are completed first.
+    //
+    if (Instance->Ncq.BusySlots != 0) {
+      OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+      while (Instance->Ncq.BusySlots != 0) {
+        AsyncNonBlockingTransferRoutine (NULL, Instance);
+        MicroSecondDelay (100);
+      }
+
+      gBS->RestoreTPL (OldTpl);
+    }
+
+    // MU_CHANGE [END]
     return AtaPassThruPassThruExecute (
              Port,
              PortMultiplierPort,
@@ -36,6 +36,8 @@
 
 #include "IdeMode.h"
 #include "AhciMode.h"
+#include "AhciPortInit.h" // MU_CHANGE - Bring up the AHCI ports concurrently
+#include "AhciNcq.h"      // MU_CHANGE - AHCI native command queuing
 
 extern EFI_DRIVER_BINDING_PROTOCOL   gAtaAtapiPassThruDriverBinding;
 extern EFI_COMPONENT_NAME_PROTOCOL   gAtaAtapiPassThruComponentName;
@@ -119,6 +121,7 @@ typedef struct {
   //
   EFI_EVENT                           TimerEvent;
   LIST_ENTRY                          NonBlockingTaskList;
+  AHCI_NCQ_CONTEXT                    Ncq; // MU_CHANGE - AHCI native command queuing
 } ATA_ATAPI_PASS_THRU_INSTANCE;
 
 //
@@ -1294,4 +1297,91 @@ AtaPioDataInOut (
   IN     ATA_NONBLOCK_TASK      *Task
   );
 
+// MU_CHANGE [BEGIN] - AHCI native command queuing
+
+/**
+  Allocate the command tables of the queued commands of a controller.
+
+  The controller works without native command queuing if PcdAtaNcqQueueDepth
+  is zero, if it does not support it or if the command tables cannot be
+  allocated.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+
+**/
+VOID
+AhciNcqInitialize (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  );
+
+/**
+  Free the command tables of the queued commands of a controller.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+
+**/
+VOID
+AhciNcqCleanup (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  );
+
+/**
+  Tell whether a command can be queued on a device.
+
+  @param[in] Instance            The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+  @param[in] Port                The port number of the device.
+  @param[in] PortMultiplierPort  The port multiplier port number of the device.
+  @param[in] IdentifyData        The IDENTIFY data of the device.
+  @param[in] Packet              The command.
+  @param[in] Event               The event of a non-blocking command, or NULL.
+
+  @retval TRUE   The command is a non-blocking READ or WRITE FPDMA QUEUED
+                 command that the controller and the device can queue.
+  @retval FALSE  Otherwise.
+
+**/
+BOOLEAN
+AhciNcqSupported (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE      *Instance,
+  IN UINT16                            Port,
+  IN UINT16                            PortMultiplierPort,
+  IN EFI_IDENTIFY_DATA                 *IdentifyData,
+  IN EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet,
+  IN EFI_EVENT                         Event OPTIONAL
+  );
+
+/**
+  Complete the queued commands that are done and start the queued commands at
+  the head of the non-blocking task list, as far as free slots allow.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+
+  @retval EFI_SUCCESS    No queued command is left at the head of the list.
+  @retval EFI_NOT_READY  Queued commands are in flight.
+  @retval Others         A queued command failed or timed out. All the queued
+                         commands in flight were aborted.
+
+**/
+EFI_STATUS
+AhciNcqTransferRoutine (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  );
+
+/**
+  Abort the queued commands in flight.
+
+  The ports with queued commands in flight are stopped, the data buffers of
+  the commands are unmapped and their status block reports an error. The tasks
+  are left in the non-blocking task list.
+
+  @param[in] Instance  The ATA_ATAPI_PASS_THRU_INSTANCE protocol instance.
+
+**/
+VOID
+AhciNcqAbort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  );
+
+// MU_CHANGE [END]
+
 #endif
@@ -0,0 +1,1250 @@
+/** @file -- AhciNcqUnitTest.c
+  Host based unit tests of the native command queuing of AtaAtapiPassThru,
+  against a simulated HBA with SATA drives.
+
+  The simulated HBA keeps a virtual clock in microseconds that advances by one
+  period of the non-blocking timer of AtaAtapiPassThru on each tick of the
+  test. A drive takes TEST_COMMAND_LATENCY to start a command and then moves
+  its data at TEST_BYTES_PER_US, one command at a time, in the order the
+  commands were issued. It reports a command done by clearing its PxSACT bit.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../AtaAtapiPassThru.h"
+
+#define UNIT_TEST_NAME     "AHCI Native Command Queuing Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Simulated drive timing.
+//
+#define TEST_TICK             1000                                  // 1 ms, the non-blocking timer period
+#define TEST_COMMAND_LATENCY  100                                   // 100 us
+#define TEST_BYTES_PER_US     600                                   // 600 MB/s
+
+#define TEST_BLOCK_SIZE      512
+#define TEST_REQUEST_BLOCKS  256                                    // 128 KB
+#define TEST_REQUESTS        256
+#define TEST_NO_LBA          MAX_UINT64
+
+//
+// Number of command slots of the simulated HBA.
+//
+#define TEST_HBA_SLOTS  32
+
+///
+/// A command of a simulated drive.
+///
+typedef struct {
+  BOOLEAN    Active;
+  BOOLEAN    Read;
+  UINT64     Lba;
+  UINT32     Blocks;
+  UINT8      *Buffer;
+  UINT64     CompleteAt;
+} SIMULATED_COMMAND;
+
+///
+/// A port of the simulated HBA and its drive.
+///
+typedef struct {
+  UINT32               Cmd;
+  UINT32               Is;
+  UINT32               Tfd;
+  UINT32               Sact;
+  UINT64               LinkFreeAt;
+  UINT64               FailLba;                                     ///< LBA of the command that fails, or TEST_NO_LBA.
+  UINT64               HangLba;                                     ///< LBA of the command that never completes, or TEST_NO_LBA.
+  UINT32               InFlight;
+  UINT32               MaxInFlight;
+  UINT64               BlocksWritten;
+  UINTN                Recoveries;
+  SIMULATED_COMMAND    Commands[TEST_HBA_SLOTS];
+} SIMULATED_PORT;
+
+///
+/// State of the simulated HBA.
+///
+typedef struct {
+  UINT64            Clock;
+  SIMULATED_PORT    Ports[EFI_AHCI_MAX_PORTS];
+  UINTN             Maps;                                           ///< Including the command tables, mapped until cleanup.
+  UINTN             Unmaps;
+  UINTN             BadAccesses;
+} SIMULATED_HBA;
+
+///
+/// A request sent through the simulated non-blocking task list.
+///
+typedef struct {
+  EFI_ATA_PASS_THRU_COMMAND_PACKET    Packet;
+  EFI_ATA_COMMAND_BLOCK               Acb;
+  EFI_ATA_STATUS_BLOCK                Asb;
+  BOOLEAN                             Done;
+  UINT64                              DoneAt;
+  BOOLEAN                             OutOfOrder;                   ///< A queued command was in flight when it ran.
+} TEST_REQUEST;
+
+STATIC SIMULATED_HBA                 mHba;
+STATIC EFI_PCI_IO_PROTOCOL           mPciIo;
+STATIC EFI_BOOT_SERVICES             mBootServices;
+STATIC ATA_ATAPI_PASS_THRU_INSTANCE  mInstance;
+STATIC EFI_AHCI_COMMAND_LIST         mCommandList[TEST_HBA_SLOTS];
+STATIC EFI_IDENTIFY_DATA             mIdentifyData;
+STATIC TEST_REQUEST                  *mRequests;
+STATIC UINT8                         *mData;
+
+EFI_BOOT_SERVICES  *gBS = &mBootServices;
+
+/**
+  Complete the commands of a port whose data transfer is over.
+
+  @param[in] Port  The port.
+
+**/
+STATIC
+VOID
+TestPortUpdate (
+  IN SIMULATED_PORT  *Port
+  )
+{
+  SIMULATED_COMMAND  *Command;
+  UINT32             Slot;
+  UINT32             Block;
+
+  //
+  // A drive that failed a command does not complete the other ones.
+  //
+  if ((Port->Tfd & EFI_AHCI_PORT_TFD_ERR) != 0) {
+    return;
+  }
+
+  for (Slot = 0; Slot < TEST_HBA_SLOTS; Slot++) {
+    Command = &Port->Commands[Slot];
+    if (!Command->Active || (Command->CompleteAt > mHba.Clock)) {
+      continue;
+    }
+
+    if (Command->Lba == Port->FailLba) {
+      Port->Is  |= EFI_AHCI_PORT_IS_TFES;
+      Port->Tfd  = 0x0441;
+      return;
+    }
+
+    for (Block = 0; Block < Command->Blocks; Block++) {
+      if (Command->Read) {
+        SetMem (Command->Buffer + Block * TEST_BLOCK_SIZE, TEST_BLOCK_SIZE, (UINT8)(Command->Lba + Block));
+      }
+    }
+
+    if (!Command->Read) {
+      Port->BlocksWritten += Command->Blocks;
+    }
+
+    Command->Active = FALSE;
+    Port->Sact     &= ~(BIT0 << Slot);
+    Port->Is       |= EFI_AHCI_PORT_IS_SDBS;
+    Port->InFlight--;
+  }
+}
+
+/**
+  Accept the command of a slot, as a drive does when PxCI is set.
+
+  @param[in] Port  The port.
+  @param[in] Slot  The slot.
+
+**/
+STATIC
+VOID
+TestPortIssue (
+  IN SIMULATED_PORT  *Port,
+  IN UINT32          Slot
+  )
+{
+  EFI_AHCI_COMMAND_LIST   *CommandList;
+  AHCI_NCQ_COMMAND_TABLE  *CommandTable;
+  EFI_AHCI_COMMAND_FIS    *Fis;
+  SIMULATED_COMMAND       *Command;
+  UINT32                  Bytes;
+  UINT32                  Index;
+
+  if (((Port->Cmd & EFI_AHCI_PORT_CMD_ST) == 0) || ((Port->Cmd & EFI_AHCI_PORT_CMD_FRE) == 0) ||
+      ((Port->Sact & (BIT0 << Slot)) == 0) || Port->Commands[Slot].Active)
+  {
+    mHba.BadAccesses++;
+    return;
+  }
+
+  CommandList  = &mCommandList[Slot];
+  CommandTable = (AHCI_NCQ_COMMAND_TABLE *)(UINTN)(LShiftU64 (CommandList->AhciCmdCtbau, 32) | CommandList->AhciCmdCtba);
+  Fis          = &CommandTable->CommandFis;
+  Command      = &Port->Commands[Slot];
+
+  if (((Fis->AhciCFisCmd != ATA_CMD_READ_FPDMA_QUEUED) && (Fis->AhciCFisCmd != ATA_CMD_WRITE_FPDMA_QUEUED)) ||
+      ((Fis->AhciCFisSecCount >> 3) != Slot) || ((Fis->AhciCFisDevHead & BIT6) == 0) ||
+      (CommandList->AhciCmdCfl != EFI_AHCI_FIS_REGISTER_H2D_LENGTH / 4) ||
+      (CommandList->AhciCmdW != ((Fis->AhciCFisCmd == ATA_CMD_WRITE_FPDMA_QUEUED) ? 1 : 0)))
+  {
+    mHba.BadAccesses++;
+    return;
+  }
+
+  Command->Read   = (BOOLEAN)(Fis->AhciCFisCmd == ATA_CMD_READ_FPDMA_QUEUED);
+  Command->Blocks = ((UINT32)Fis->AhciCFisFeatureExp << 8) | Fis->AhciCFisFeature;
+  if (Command->Blocks == 0) {
+    Command->Blocks = 0x10000;
+  }
+
+  Command->Lba = Fis->AhciCFisSecNum | LShiftU64 (Fis->AhciCFisClyLow, 8) | LShiftU64 (Fis->AhciCFisClyHigh, 16) |
+                 LShiftU64 (Fis->AhciCFisSecNumExp, 24) | LShiftU64 (Fis->AhciCFisClyLowExp, 32) |
+                 LShiftU64 (Fis->AhciCFisClyHighExp, 40);
+
+  Bytes = 0;
+  for (Index = 0; Index < CommandList->AhciCmdPrdtl; Index++) {
+    Bytes += CommandTable->PrdtTable[Index].AhciPrdtDbc + 1;
+  }
+
+  if ((CommandList->AhciCmdPrdtl == 0) || (Bytes != Command->Blocks * TEST_BLOCK_SIZE) ||
+      (CommandTable->PrdtTable[CommandList->AhciCmdPrdtl - 1].AhciPrdtIoc != 1))
+  {
+    mHba.BadAccesses++;
+    return;
+  }
+
+  Command->Buffer = (UINT8 *)(UINTN)(LShiftU64 (CommandTable->PrdtTable[0].AhciPrdtDbau, 32) | CommandTable->PrdtTable[0].AhciPrdtDba);
+  Command->Active = TRUE;
+
+  if (Command->Lba == Port->HangLba) {
+    Command->CompleteAt = MAX_UINT64;
+  } else {
+    Command->CompleteAt = MAX (mHba.Clock + TEST_COMMAND_LATENCY, Port->LinkFreeAt) + Bytes / TEST_BYTES_PER_US;
+    Port->LinkFreeAt    = Command->CompleteAt;
+  }
+
+  Port->InFlight++;
+  Port->MaxInFlight = MAX (Port->MaxInFlight, Port->InFlight);
+}
+
+/**
+  Find the port and the port register of an AHCI register offset.
+
+  @param[in]  Offset    The register offset.
+  @param[out] Register  The offset of the port register.
+
+  @return The port, or NULL if the offset is not a port register.
+
+**/
+STATIC
+SIMULATED_PORT *
+TestGetPort (
+  IN  UINT32  Offset,
+  OUT UINT32  *Register
+  )
+{
+  UINT32  Index;
+
+  if (Offset < EFI_AHCI_PORT_START) {
+    return NULL;
+  }
+
+  Index     = (Offset - EFI_AHCI_PORT_START) / EFI_AHCI_PORT_REG_WIDTH;
+  *Register = (Offset - EFI_AHCI_PORT_START) % EFI_AHCI_PORT_REG_WIDTH;
+  if (Index >= EFI_AHCI_MAX_PORTS) {
+    return NULL;
+  }
+
+  return &mHba.Ports[Index];
+}
+
+/**
+  Read a register of the simulated HBA.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+
+  @return The register content read.
+
+**/
+UINT32
+EFIAPI
+AhciReadReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT32              Offset
+  )
+{
+  SIMULATED_PORT  *Port;
+  UINT32          Register;
+
+  if (Offset == EFI_AHCI_CAPABILITY_OFFSET) {
+    return EFI_AHCI_CAP_S64A | EFI_AHCI_CAP_SNCQ | ((TEST_HBA_SLOTS - 1) << 8);
+  }
+
+  Port = TestGetPort (Offset, &Register);
+  if (Port == NULL) {
+    mHba.BadAccesses++;
+    return 0;
+  }
+
+  TestPortUpdate (Port);
+  switch (Register) {
+    case EFI_AHCI_PORT_CMD:
+      return Port->Cmd;
+
+    case EFI_AHCI_PORT_IS:
+      return Port->Is;
+
+    case EFI_AHCI_PORT_TFD:
+      return Port->Tfd;
+
+    case EFI_AHCI_PORT_SACT:
+      return Port->Sact;
+
+    case EFI_AHCI_PORT_CI:
+      //
+      // The drive takes the commands as soon as they are issued.
+      //
+      return 0;
+
+    default:
+      mHba.BadAccesses++;
+      return 0;
+  }
+}
+
+/**
+  Write a register of the simulated HBA.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+  @param  Data         The data used to write down.
+
+**/
+VOID
+EFIAPI
+AhciWriteReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               Offset,
+  IN UINT32               Data
+  )
+{
+  SIMULATED_PORT  *Port;
+  UINT32          Register;
+  UINT32          Slot;
+
+  Port = TestGetPort (Offset, &Register);
+  if (Port == NULL) {
+    mHba.BadAccesses++;
+    return;
+  }
+
+  switch (Register) {
+    case EFI_AHCI_PORT_CMD:
+      Port->Cmd = Data;
+      break;
+
+    case EFI_AHCI_PORT_SACT:
+      Port->Sact |= Data;
+      break;
+
+    case EFI_AHCI_PORT_CI:
+      for (Slot = 0; Slot < TEST_HBA_SLOTS; Slot++) {
+        if ((Data & (BIT0 << Slot)) != 0) {
+          TestPortIssue (Port, Slot);
+        }
+      }
+
+      break;
+
+    default:
+      mHba.BadAccesses++;
+      break;
+  }
+}
+
+/**
+  Do AND operation with the value of a register of the simulated HBA.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+  @param  AndData      The data used to do AND operation.
+
+**/
+VOID
+EFIAPI
+AhciAndReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               Offset,
+  IN UINT32               AndData
+  )
+{
+  AhciWriteReg (PciIo, Offset, AhciReadReg (PciIo, Offset) & AndData);
+}
+
+/**
+  Do OR operation with the value of a register of the simulated HBA.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+  @param  OrData       The data used to do OR operation.
+
+**/
+VOID
+EFIAPI
+AhciOrReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               Offset,
+  IN UINT32               OrData
+  )
+{
+  AhciWriteReg (PciIo, Offset, AhciReadReg (PciIo, Offset) | OrData);
+}
+
+/**
+  Clear the port interrupt and error status of the simulated HBA.
+
+  @param      PciIo          The PCI IO protocol instance.
+  @param      Port           The number of port.
+
+**/
+VOID
+EFIAPI
+AhciClearPortStatus (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                Port
+  )
+{
+  mHba.Ports[Port].Is = 0;
+}
+
+/**
+  Enable the FIS running of a port of the simulated HBA.
+
+  @param      PciIo          The PCI IO protocol instance.
+  @param      Port           The number of port.
+  @param      Timeout        Not used.
+
+  @retval EFI_SUCCESS        The FIS enable successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciEnableFisReceive (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                Port,
+  IN  UINT64               Timeout
+  )
+{
+  mHba.Ports[Port].Cmd |= EFI_AHCI_PORT_CMD_FRE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Disable the FIS running of a port of the simulated HBA.
+
+  @param      PciIo          The PCI IO protocol instance.
+  @param      Port           The number of port.
+  @param      Timeout        Not used.
+
+  @retval EFI_SUCCESS        The FIS disable successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciDisableFisReceive (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                Port,
+  IN  UINT64               Timeout
+  )
+{
+  if ((mHba.Ports[Port].Cmd & EFI_AHCI_PORT_CMD_ST) != 0) {
+    mHba.BadAccesses++;
+  }
+
+  mHba.Ports[Port].Cmd &= ~EFI_AHCI_PORT_CMD_FRE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Stop a port of the simulated HBA. The commands of the port are dropped.
+
+  @param  PciIo              The PCI IO protocol instance.
+  @param  Port               The number of port.
+  @param  Timeout            Not used.
+
+  @retval EFI_SUCCESS        The command stop successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciStopCommand (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                Port,
+  IN  UINT64               Timeout
+  )
+{
+  SIMULATED_PORT  *SimulatedPort;
+
+  SimulatedPort       = &mHba.Ports[Port];
+  SimulatedPort->Cmd &= ~EFI_AHCI_PORT_CMD_ST;
+  SimulatedPort->Sact = 0;
+  SetMem (SimulatedPort->Commands, sizeof (SimulatedPort->Commands), 0);
+  SimulatedPort->InFlight = 0;
+  return EFI_SUCCESS;
+}
+
+/**
+  Recover a port of the simulated HBA from an error.
+
+  @param[in] PciIo    Pointer to AHCI controller PciIo.
+  @param[in] Port     SATA port index.
+
+  @retval EFI_SUCCESS  Port recovered.
+**/
+EFI_STATUS
+AhciRecoverPortError (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT8                Port
+  )
+{
+  if ((mHba.Ports[Port].Tfd & EFI_AHCI_PORT_TFD_ERR) != 0) {
+    mHba.Ports[Port].Recoveries++;
+  }
+
+  mHba.Ports[Port].Is  = 0;
+  mHba.Ports[Port].Tfd = 0x50;
+  return EFI_SUCCESS;
+}
+
+/**
+  Build a command FIS, as AhciMode.c does.
+
+  @param  CmdFis            A pointer to the EFI_AHCI_COMMAND_FIS data structure.
+  @param  AtaCommandBlock   A pointer to the AhciBuildCommandFis data structure.
+
+**/
+VOID
+EFIAPI
+AhciBuildCommandFis (
+  IN OUT EFI_AHCI_COMMAND_FIS   *CmdFis,
+  IN     EFI_ATA_COMMAND_BLOCK  *AtaCommandBlock
+  )
+{
+  ZeroMem (CmdFis, sizeof (EFI_AHCI_COMMAND_FIS));
+
+  CmdFis->AhciCFisType        = EFI_AHCI_FIS_REGISTER_H2D;
+  CmdFis->AhciCFisCmdInd      = 0x1;
+  CmdFis->AhciCFisCmd         = AtaCommandBlock->AtaCommand;
+  CmdFis->AhciCFisFeature     = AtaCommandBlock->AtaFeatures;
+  CmdFis->AhciCFisFeatureExp  = AtaCommandBlock->AtaFeaturesExp;
+  CmdFis->AhciCFisSecNum      = AtaCommandBlock->AtaSectorNumber;
+  CmdFis->AhciCFisSecNumExp   = AtaCommandBlock->AtaSectorNumberExp;
+  CmdFis->AhciCFisClyLow      = AtaCommandBlock->AtaCylinderLow;
+  CmdFis->AhciCFisClyLowExp   = AtaCommandBlock->AtaCylinderLowExp;
+  CmdFis->AhciCFisClyHigh     = AtaCommandBlock->AtaCylinderHigh;
+  CmdFis->AhciCFisClyHighExp  = AtaCommandBlock->AtaCylinderHighExp;
+  CmdFis->AhciCFisSecCount    = AtaCommandBlock->AtaSectorCount;
+  CmdFis->AhciCFisSecCountExp = AtaCommandBlock->AtaSectorCountExp;
+  CmdFis->AhciCFisDevHead     = (UINT8)(AtaCommandBlock->AtaDeviceHead | 0xE0);
+}
+
+/**
+  Allocate pages for a common buffer.
+
+  @retval EFI_SUCCESS           The pages were allocated.
+  @retval EFI_OUT_OF_RESOURCES  The pages could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+TestAllocateBuffer (
+  IN  EFI_PCI_IO_PROTOCOL  *This,
+  IN  EFI_ALLOCATE_TYPE    Type,
+  IN  EFI_MEMORY_TYPE      MemoryType,
+  IN  UINTN                Pages,
+  OUT VOID                 **HostAddress,
+  IN  UINT64               Attributes
+  )
+{
+  *HostAddress = AllocateAlignedPages (Pages, EFI_PAGE_SIZE);
+  return (*HostAddress == NULL) ? EFI_OUT_OF_RESOURCES : EFI_SUCCESS;
+}
+
+/**
+  Free pages allocated by TestAllocateBuffer().
+
+  @retval EFI_SUCCESS  The pages were freed.
+
+**/
+EFI_STATUS
+EFIAPI
+TestFreeBuffer (
+  IN  EFI_PCI_IO_PROTOCOL  *This,
+  IN  UINTN                Pages,
+  IN  VOID                 *HostAddress
+  )
+{
+  FreeAlignedPages (HostAddress, Pages);
+  return EFI_SUCCESS;
+}
+
+/**
+  Map a buffer at its host address.
+
+  @retval EFI_SUCCESS  The buffer was mapped.
+
+**/
+EFI_STATUS
+EFIAPI
+TestMap (
+  IN     EFI_PCI_IO_PROTOCOL            *This,
+  IN     EFI_PCI_IO_PROTOCOL_OPERATION  Operation,
+  IN     VOID                           *HostAddress,
+  IN OUT UINTN                          *NumberOfBytes,
+  OUT    EFI_PHYSICAL_ADDRESS           *DeviceAddress,
+  OUT    VOID                           **Mapping
+  )
+{
+  *DeviceAddress = (EFI_PHYSICAL_ADDRESS)(UINTN)HostAddress;
+  *Mapping       = HostAddress;
+  mHba.Maps++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Unmap a buffer mapped by TestMap().
+
+  @retval EFI_SUCCESS  The buffer was unmapped.
+
+**/
+EFI_STATUS
+EFIAPI
+TestUnmap (
+  IN  EFI_PCI_IO_PROTOCOL  *This,
+  IN  VOID                 *Mapping
+  )
+{
+  mHba.Unmaps++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Record the completion of a request.
+
+  @param[in] Event  The request.
+
+  @retval EFI_SUCCESS  The event was signaled.
+
+**/
+EFI_STATUS
+EFIAPI
+TestSignalEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  TEST_REQUEST  *Request;
+
+  Request         = (TEST_REQUEST *)Event;
+  Request->Done   = TRUE;
+  Request->DoneAt = mHba.Clock;
+  return EFI_SUCCESS;
+}
+
+/**
+  Queue a request in the non-blocking task list, as AtaPassThruPassThru()
+  does.
+
+  @param[in] Index   The index of the request.
+  @param[in] Port    The port of the drive.
+  @param[in] Queued  TRUE for a READ or WRITE FPDMA QUEUED command, FALSE for
+                     a READ DMA EXT command.
+  @param[in] Write   TRUE for a write.
+  @param[in] Lba     The first block.
+  @param[in] Blocks  The number of blocks.
+
+  @retval TRUE   The request was queued.
+  @retval FALSE  The command cannot be queued.
+
+**/
+STATIC
+BOOLEAN
+TestQueueRequest (
+  IN UINTN    Index,
+  IN UINT16   Port,
+  IN BOOLEAN  Queued,
+  IN BOOLEAN  Write,
+  IN UINT64   Lba,
+  IN UINT32   Blocks
+  )
+{
+  TEST_REQUEST       *Request;
+  ATA_NONBLOCK_TASK  *Task;
+
+  Request = &mRequests[Index];
+  ZeroMem (Request, sizeof (TEST_REQUEST));
+  Request->Acb.AtaSectorNumber    = (UINT8)Lba;
+  Request->Acb.AtaCylinderLow     = (UINT8)RShiftU64 (Lba, 8);
+  Request->Acb.AtaCylinderHigh    = (UINT8)RShiftU64 (Lba, 16);
+  Request->Acb.AtaSectorNumberExp = (UINT8)RShiftU64 (Lba, 24);
+  Request->Acb.AtaCylinderLowExp  = (UINT8)RShiftU64 (Lba, 32);
+  Request->Acb.AtaCylinderHighExp = (UINT8)RShiftU64 (Lba, 40);
+  Request->Acb.AtaDeviceHead      = BIT6;
+  if (Queued) {
+    Request->Acb.AtaCommand     = Write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+    Request->Acb.AtaFeatures    = (UINT8)Blocks;
+    Request->Acb.AtaFeaturesExp = (UINT8)(Blocks >> 8);
+    Request->Packet.Protocol    = EFI_ATA_PASS_THRU_PROTOCOL_FPDMA;
+  } else {
+    Request->Acb.AtaCommand  = ATA_CMD_READ_DMA_EXT;
+    Request->Packet.Protocol = EFI_ATA_PASS_THRU_PROTOCOL_UDMA_DATA_IN;
+  }
+
+  Request->Packet.Acb     = &Request->Acb;
+  Request->Packet.Asb     = &Request->Asb;
+  Request->Packet.Timeout = EFI_TIMER_PERIOD_SECONDS (1);
+  if (Write) {
+    Request->Packet.OutDataBuffer     = mData + Index * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE;
+    Request->Packet.OutTransferLength = Blocks * TEST_BLOCK_SIZE;
+  } else {
+    Request->Packet.InDataBuffer     = mData + Index * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE;
+    Request->Packet.InTransferLength = Blocks * TEST_BLOCK_SIZE;
+  }
+
+  if (Queued && !AhciNcqSupported (&mInstance, Port, 0xFFFF, &mIdentifyData, &Request->Packet, (EFI_EVENT)Request)) {
+    return FALSE;
+  }
+
+  Task               = AllocateZeroPool (sizeof (ATA_NONBLOCK_TASK));
+  Task->Signature    = ATA_NONBLOCKING_TASK_SIGNATURE;
+  Task->Port         = Port;
+  Task->Packet       = &Request->Packet;
+  Task->Event        = (EFI_EVENT)Request;
+  Task->RetryTimes   = DivU64x32 (Request->Packet.Timeout, 1000) + 1;
+  Task->InfiniteWait = FALSE;
+  InsertTailList (&mInstance.NonBlockingTaskList, &Task->Link);
+  return TRUE;
+}
+
+/**
+  Run one period of the non-blocking timer, as AsyncNonBlockingTransferRoutine()
+  does. The commands that are not queued complete at once.
+
+**/
+STATIC
+VOID
+TestTimerTick (
+  VOID
+  )
+{
+  LIST_ENTRY         *Entry;
+  ATA_NONBLOCK_TASK  *Task;
+  TEST_REQUEST       *Request;
+  EFI_STATUS         Status;
+
+  mHba.Clock += TEST_TICK;
+
+  while (!IsListEmpty (&mInstance.NonBlockingTaskList)) {
+    Task = ATA_NON_BLOCK_TASK_FROM_ENTRY (GetFirstNode (&mInstance.NonBlockingTaskList));
+    if (Task->Packet->Protocol == EFI_ATA_PASS_THRU_PROTOCOL_FPDMA) {
+      Status = AhciNcqTransferRoutine (&mInstance);
+      if (Status == EFI_SUCCESS) {
+        continue;
+      }
+
+      if (Status != EFI_NOT_READY) {
+        //
+        // DestroyAsynTaskList (Instance, TRUE)
+        //
+        while (!IsListEmpty (&mInstance.NonBlockingTaskList)) {
+          Entry = GetFirstNode (&mInstance.NonBlockingTaskList);
+          Task  = ATA_NON_BLOCK_TASK_FROM_ENTRY (Entry);
+          RemoveEntryList (Entry);
+          Task->Packet->Asb->AtaStatus = 0x01;
+          TestSignalEvent (Task->Event);
+          FreePool (Task);
+        }
+      }
+
+      return;
+    }
+
+    Request             = (TEST_REQUEST *)Task->Event;
+    Request->OutOfOrder = (BOOLEAN)(mInstance.Ncq.BusySlots != 0);
+    RemoveEntryList (&Task->Link);
+    TestSignalEvent (Task->Event);
+    FreePool (Task);
+  }
+}
+
+/**
+  Run the non-blocking timer until all the requests are done.
+
+  @param[in] MaxTicks  The number of ticks after which the requests are given up.
+
+  @return The time the requests took, in microseconds.
+
+**/
+STATIC
+UINT64
+TestRunRequests (
+  IN UINTN  MaxTicks
+  )
+{
+  UINT64  Start;
+  UINTN   Tick;
+
+  Start = mHba.Clock;
+  for (Tick = 0; Tick < MaxTicks && !IsListEmpty (&mInstance.NonBlockingTaskList); Tick++) {
+    TestTimerTick ();
+  }
+
+  return mHba.Clock - Start;
+}
+
+/**
+  Reset the simulated HBA and enable native command queuing on it.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED                      The simulated HBA was reset.
+  @retval UNIT_TEST_ERROR_PREREQUISITE_NOT_MET  The buffers could not be allocated.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+NcqTestSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  ZeroMem (&mHba, sizeof (mHba));
+  for (Index = 0; Index < EFI_AHCI_MAX_PORTS; Index++) {
+    mHba.Ports[Index].Tfd     = 0x50;
+    mHba.Ports[Index].FailLba = TEST_NO_LBA;
+    mHba.Ports[Index].HangLba = TEST_NO_LBA;
+  }
+
+  ZeroMem (&mPciIo, sizeof (mPciIo));
+  mPciIo.AllocateBuffer = TestAllocateBuffer;
+  mPciIo.FreeBuffer     = TestFreeBuffer;
+  mPciIo.Map            = TestMap;
+  mPciIo.Unmap          = TestUnmap;
+
+  ZeroMem (&mBootServices, sizeof (mBootServices));
+  mBootServices.SignalEvent = TestSignalEvent;
+
+  ZeroMem (mCommandList, sizeof (mCommandList));
+  ZeroMem (&mInstance, sizeof (mInstance));
+  mInstance.PciIo                     = &mPciIo;
+  mInstance.Mode                      = EfiAtaAhciMode;
+  mInstance.AhciRegisters.AhciCmdList = mCommandList;
+  InitializeListHead (&mInstance.NonBlockingTaskList);
+
+  //
+  // A drive with the largest queue depth.
+  //
+  ZeroMem (&mIdentifyData, sizeof (mIdentifyData));
+  mIdentifyData.AtaData.serial_ata_capabilities = BIT8 | BIT2 | BIT1;
+  mIdentifyData.AtaData.queue_depth             = 31;
+
+  mRequests = AllocateZeroPool (TEST_REQUESTS * sizeof (TEST_REQUEST));
+  mData     = AllocatePool (TEST_REQUESTS * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE);
+  if ((mRequests == NULL) || (mData == NULL)) {
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  AhciNcqInitialize (&mInstance);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the buffers of the test and the command tables of the controller.
+
+  @param[in]  Context  Not used.
+
+**/
+VOID
+EFIAPI
+NcqTestCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  AhciNcqCleanup (&mInstance);
+  if (mRequests != NULL) {
+    FreePool (mRequests);
+    mRequests = NULL;
+  }
+
+  if (mData != NULL) {
+    FreePool (mData);
+    mData = NULL;
+  }
+}
+
+/**
+  Check the data read by a request.
+
+  @param[in] Index  The index of the request.
+  @param[in] Lba    The first block read.
+
+  @retval TRUE   Each block holds the low byte of its LBA.
+  @retval FALSE  Otherwise.
+
+**/
+STATIC
+BOOLEAN
+TestCheckRead (
+  IN UINTN   Index,
+  IN UINT64  Lba
+  )
+{
+  UINT8   *Buffer;
+  UINT32  Block;
+
+  Buffer = mRequests[Index].Packet.InDataBuffer;
+  for (Block = 0; Block < mRequests[Index].Packet.InTransferLength / TEST_BLOCK_SIZE; Block++) {
+    if ((Buffer[Block * TEST_BLOCK_SIZE] != (UINT8)(Lba + Block)) ||
+        (Buffer[(Block + 1) * TEST_BLOCK_SIZE - 1] != (UINT8)(Lba + Block)))
+    {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Sequential 128 KB reads complete several per timer period when they are
+  queued, and one per timer period when the drive takes one command at a time.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The queued reads were faster.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+QueuedReadsOutrunOneAtATime (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN   Index;
+  UINT64  QueuedTime;
+  UINT64  SerialTime;
+  UINT32  QueuedMaxInFlight;
+
+  UT_ASSERT_NOT_NULL (mInstance.Ncq.CommandTables);
+  UT_ASSERT_EQUAL (mInstance.Ncq.SlotBitMap, 0xFFFFFFFE);
+
+  //
+  // Queue depth 32 on the drive, 31 slots on the controller.
+  //
+  for (Index = 0; Index < TEST_REQUESTS; Index++) {
+    UT_ASSERT_TRUE (TestQueueRequest (Index, 0, TRUE, FALSE, Index * TEST_REQUEST_BLOCKS, TEST_REQUEST_BLOCKS));
+  }
+
+  QueuedTime = TestRunRequests (TEST_REQUESTS * 2);
+  UT_ASSERT_TRUE (IsListEmpty (&mInstance.NonBlockingTaskList));
+  for (Index = 0; Index < TEST_REQUESTS; Index++) {
+    UT_ASSERT_TRUE (mRequests[Index].Done);
+    UT_ASSERT_EQUAL (mRequests[Index].Asb.AtaStatus & BIT0, 0);
+    UT_ASSERT_TRUE (TestCheckRead (Index, Index * TEST_REQUEST_BLOCKS));
+  }
+
+  QueuedMaxInFlight = mHba.Ports[0].MaxInFlight;
+  UT_ASSERT_EQUAL (QueuedMaxInFlight, AHCI_NCQ_MAX_DEPTH);
+  UT_ASSERT_EQUAL (mInstance.Ncq.Statistics.MaxInFlight, AHCI_NCQ_MAX_DEPTH);
+  UT_ASSERT_EQUAL (mInstance.Ncq.Statistics.Commands, TEST_REQUESTS);
+  UT_ASSERT_EQUAL (mInstance.Ncq.BusySlots, 0);
+  UT_ASSERT_EQUAL (mHba.Maps, mHba.Unmaps + 1);
+  UT_ASSERT_EQUAL (mHba.BadAccesses, 0);
+
+  //
+  // The port is stopped once its commands are done.
+  //
+  UT_ASSERT_EQUAL (mHba.Ports[0].Cmd & (EFI_AHCI_PORT_CMD_ST | EFI_AHCI_PORT_CMD_FRE), 0);
+
+  //
+  // The same reads on a drive with queue depth 1.
+  //
+  mIdentifyData.AtaData.queue_depth = 0;
+  mHba.Ports[0].MaxInFlight         = 0;
+  SetMem (mData, TEST_REQUESTS * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE, 0);
+  for (Index = 0; Index < TEST_REQUESTS; Index++) {
+    UT_ASSERT_TRUE (TestQueueRequest (Index, 0, TRUE, FALSE, Index * TEST_REQUEST_BLOCKS, TEST_REQUEST_BLOCKS));
+  }
+
+  SerialTime = TestRunRequests (TEST_REQUESTS * 2);
+  UT_ASSERT_TRUE (IsListEmpty (&mInstance.NonBlockingTaskList));
+  for (Index = 0; Index < TEST_REQUESTS; Index++) {
+    UT_ASSERT_TRUE (mRequests[Index].Done);
+    UT_ASSERT_TRUE (TestCheckRead (Index, Index * TEST_REQUEST_BLOCKS));
+  }
+
+  UT_ASSERT_EQUAL (mHba.Ports[0].MaxInFlight, 1);
+  UT_ASSERT_EQUAL (mHba.BadAccesses, 0);
+
+  //
+  // One command per timer period at queue depth 1; the drive keeps its link
+  // busy when commands are queued.
+  //
+  UT_ASSERT_TRUE (SerialTime >= TEST_REQUESTS * TEST_TICK);
+  UT_ASSERT_TRUE (QueuedTime * 3 <= SerialTime);
+
+  UT_LOG_INFO (
+    "%d reads of 128 KB: %Lu us at queue depth %d (%Lu MB/s), %Lu us at queue depth 1 (%Lu MB/s)\n",
+    TEST_REQUESTS,
+    QueuedTime,
+    QueuedMaxInFlight,
+    DivU64x32 (TEST_REQUESTS * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE, (UINT32)QueuedTime),
+    SerialTime,
+    DivU64x32 (TEST_REQUESTS * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE, (UINT32)SerialTime)
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The queued commands of two ports share the slots of the command list, and a
+  command that is not queued waits for the queued commands ahead of it, which
+  do not wait for it.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The commands ran in order.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+NonQueuedCommandWaitsForQueuedOnes (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  //
+  // 40 queued commands on two ports, a command that is not queued, then 20
+  // more queued commands.
+  //
+  for (Index = 0; Index < 40; Index++) {
+    UT_ASSERT_TRUE (TestQueueRequest (Index, (UINT16)(Index % 2), TRUE, (BOOLEAN)(Index % 3 == 0), Index * 8, 8));
+  }
+
+  UT_ASSERT_TRUE (TestQueueRequest (40, 0, FALSE, FALSE, 0, 8));
+  for (Index = 41; Index < 61; Index++) {
+    UT_ASSERT_TRUE (TestQueueRequest (Index, (UINT16)(Index % 2), TRUE, FALSE, Index * 8, 8));
+  }
+
+  TestRunRequests (1000);
+  UT_ASSERT_TRUE (IsListEmpty (&mInstance.NonBlockingTaskList));
+
+  UT_ASSERT_TRUE (mRequests[40].Done);
+  UT_ASSERT_FALSE (mRequests[40].OutOfOrder);
+  for (Index = 0; Index < 61; Index++) {
+    UT_ASSERT_TRUE (mRequests[Index].Done);
+    UT_ASSERT_EQUAL (mRequests[Index].Asb.AtaStatus & BIT0, 0);
+    if (Index < 40) {
+      UT_ASSERT_TRUE (mRequests[Index].DoneAt <= mRequests[40].DoneAt);
+    } else if (Index > 40) {
+      UT_ASSERT_TRUE (mRequests[Index].DoneAt > mRequests[40].DoneAt);
+      UT_ASSERT_TRUE (TestCheckRead (Index, Index * 8));
+    }
+  }
+
+  UT_ASSERT_TRUE (mHba.Ports[0].MaxInFlight + mHba.Ports[1].MaxInFlight >= AHCI_NCQ_MAX_DEPTH);
+  UT_ASSERT_TRUE (mInstance.Ncq.Statistics.MaxInFlight <= AHCI_NCQ_MAX_DEPTH);
+  UT_ASSERT_EQUAL (mHba.Ports[0].BlocksWritten + mHba.Ports[1].BlocksWritten, 14 * 8);
+  UT_ASSERT_EQUAL (mHba.Maps, mHba.Unmaps + 1);
+  UT_ASSERT_EQUAL (mHba.BadAccesses, 0);
+
+  //
+  // Commands that cannot be queued are refused.
+  //
+  mIdentifyData.AtaData.serial_ata_capabilities = BIT2 | BIT1;
+  UT_ASSERT_FALSE (TestQueueRequest (0, 0, TRUE, FALSE, 0, 8));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A failed queued command aborts all the queued commands in flight and fails
+  the requests left in the list.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The requests were aborted.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FailedCommandAbortsQueue (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+  UINTN  Failed;
+
+  mHba.Ports[0].FailLba = 40 * TEST_REQUEST_BLOCKS;
+  for (Index = 0; Index < 64; Index++) {
+    UT_ASSERT_TRUE (TestQueueRequest (Index, 0, TRUE, FALSE, Index * TEST_REQUEST_BLOCKS, TEST_REQUEST_BLOCKS));
+  }
+
+  TestRunRequests (1000);
+  UT_ASSERT_TRUE (IsListEmpty (&mInstance.NonBlockingTaskList));
+
+  Failed = 0;
+  for (Index = 0; Index < 64; Index++) {
+    UT_ASSERT_TRUE (mRequests[Index].Done);
+    if ((mRequests[Index].Asb.AtaStatus & BIT0) != 0) {
+      Failed++;
+    } else {
+      UT_ASSERT_TRUE (TestCheckRead (Index, Index * TEST_REQUEST_BLOCKS));
+    }
+  }
+
+  UT_ASSERT_TRUE ((mRequests[40].Asb.AtaStatus & BIT0) != 0);
+  UT_ASSERT_TRUE (Failed >= 64 - 40);
+  UT_ASSERT_EQUAL (mHba.Ports[0].Recoveries, 1);
+  UT_ASSERT_EQUAL (mInstance.Ncq.Statistics.Errors, 1);
+  UT_ASSERT_EQUAL (mInstance.Ncq.BusySlots, 0);
+  UT_ASSERT_EQUAL (mInstance.Ncq.PortInFlight[0], 0);
+  UT_ASSERT_EQUAL (mHba.Ports[0].Cmd & (EFI_AHCI_PORT_CMD_ST | EFI_AHCI_PORT_CMD_FRE), 0);
+  UT_ASSERT_EQUAL (mHba.Maps, mHba.Unmaps + 1);
+  UT_ASSERT_EQUAL (mHba.BadAccesses, 0);
+
+  //
+  // The port queues commands again afterwards.
+  //
+  UT_ASSERT_TRUE (TestQueueRequest (0, 0, TRUE, FALSE, 0, TEST_REQUEST_BLOCKS));
+  TestRunRequests (10);
+  UT_ASSERT_TRUE (mRequests[0].Done);
+  UT_ASSERT_EQUAL (mRequests[0].Asb.AtaStatus & BIT0, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A queued command that never completes times out after the timeout of its
+  packet and aborts the other ones.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The command timed out.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+HungCommandTimesOut (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN   Index;
+  UINT64  Elapsed;
+
+  mHba.Ports[3].HangLba = 0;
+  for (Index = 0; Index < 8; Index++) {
+    UT_ASSERT_TRUE (TestQueueRequest (Index, 3, TRUE, FALSE, Index * TEST_REQUEST_BLOCKS, TEST_REQUEST_BLOCKS));
+  }
+
+  Elapsed = TestRunRequests (100000);
+  UT_ASSERT_TRUE (IsListEmpty (&mInstance.NonBlockingTaskList));
+  UT_ASSERT_TRUE ((mRequests[0].Asb.AtaStatus & BIT0) != 0);
+  for (Index = 1; Index < 8; Index++) {
+    UT_ASSERT_TRUE (mRequests[Index].Done);
+    UT_ASSERT_EQUAL (mRequests[Index].Asb.AtaStatus & BIT0, 0);
+  }
+
+  //
+  // The command is started on the first timer period and checked on each of
+  // the next ones, one retry per period as for the commands that are not
+  // queued.
+  //
+  UT_ASSERT_EQUAL (Elapsed, (DivU64x32 (EFI_TIMER_PERIOD_SECONDS (1), 1000) + 3) * TEST_TICK);
+  UT_ASSERT_EQUAL (mInstance.Ncq.Statistics.Errors, 1);
+  UT_ASSERT_EQUAL (mInstance.Ncq.BusySlots, 0);
+  UT_ASSERT_EQUAL (mHba.Ports[3].Cmd & EFI_AHCI_PORT_CMD_ST, 0);
+  UT_ASSERT_EQUAL (mHba.Maps, mHba.Unmaps + 1);
+  UT_ASSERT_EQUAL (mHba.BadAccesses, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the native
+  command queuing of AtaAtapiPassThru and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+AhciNcqUnitTestEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      NcqTestSuite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &NcqTestSuite,
+             Framework,
+             "AHCI Native Command Queuing Test Suite",
+             "Ata.Ahci.Ncq",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for NcqTestSuite. Status = %r\n", Status));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (NcqTestSuite, "Queued reads outrun reads one at a time", "QueuedReadsOutrunOneAtATime", QueuedReadsOutrunOneAtATime, NcqTestSetup, NcqTestCleanup, NULL);
+  AddTestCase (NcqTestSuite, "A command that is not queued waits for the queued ones", "NonQueuedCommandWaitsForQueuedOnes", NonQueuedCommandWaitsForQueuedOnes, NcqTestSetup, NcqTestCleanup, NULL);
+  AddTestCase (NcqTestSuite, "A failed command aborts the queue", "FailedCommandAbortsQueue", FailedCommandAbortsQueue, NcqTestSetup, NcqTestCleanup, NULL);
+  AddTestCase (NcqTestSuite, "A hung command times out", "HungCommandTimesOut", HungCommandTimesOut, NcqTestSetup, NcqTestCleanup, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return AhciNcqUnitTestEntry ();
+}
@@ -0,0 +1,584 @@
+/** @file -- AhciPortInitUnitTest.c
+  Host based unit tests of the concurrent bring-up of the AHCI ports of
+  AtaAtapiPassThru, against a simulated HBA register model.
+
+  The simulated HBA keeps a virtual clock in microseconds that only advances
+  when the driver stalls. The drive of a port powers up when PxCMD.SUD is set:
+  the Phy detects it after TEST_PHY_DETECT_TIME, it keeps PxTFD.BSY set until
+  its spin-up time has elapsed and it sends its signature
+  TEST_SIGNATURE_DELAY later.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../AtaAtapiPassThru.h"
+
+#define UNIT_TEST_NAME     "AHCI Port Initialization Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Simulated drive timing, in microseconds.
+//
+#define TEST_PHY_DETECT_TIME    1000                                  // 1 ms
+#define TEST_SPIN_UP_TIME       (600 * 1000)                          // 600 ms
+#define TEST_SIGNATURE_DELAY    200                                   // 200 us
+#define TEST_NEVER              MAX_UINT64
+
+#define TEST_BACKPLANE_PORTS  8
+
+///
+/// A port of the simulated HBA.
+///
+typedef struct {
+  BOOLEAN    DevicePresent;
+  UINT32     Signature;
+  UINT64     SpinUpTime;                                               ///< TEST_NEVER if the drive stays busy.
+  UINT64     SignatureDelay;                                           ///< TEST_NEVER if no signature is sent.
+  UINT64     PowerOnAt;                                                ///< TEST_NEVER until PxCMD.SUD is set.
+  UINT32     Cmd;
+  UINT32     Serr;
+} SIMULATED_PORT;
+
+///
+/// State of the simulated HBA.
+///
+typedef struct {
+  UINT64            Clock;
+  SIMULATED_PORT    Ports[EFI_AHCI_MAX_PORTS];
+  UINTN             SerrClears;
+  UINTN             BadAccesses;
+} SIMULATED_HBA;
+
+STATIC SIMULATED_HBA        mHba;
+STATIC EFI_PCI_IO_PROTOCOL  mPciIo;
+
+/**
+  Stall, advancing the clock of the simulated HBA.
+
+  @param[in] MicroSeconds  The number of microseconds to stall.
+
+  @return MicroSeconds
+
+**/
+UINTN
+EFIAPI
+MicroSecondDelay (
+  IN UINTN  MicroSeconds
+  )
+{
+  mHba.Clock += MicroSeconds;
+  return MicroSeconds;
+}
+
+/**
+  Tell whether a given time has elapsed since a port powered up.
+
+  @param[in] Port   The port.
+  @param[in] Delay  The time since power up, or TEST_NEVER.
+
+  @return TRUE if the time has elapsed.
+
+**/
+STATIC
+BOOLEAN
+TestPortElapsed (
+  IN SIMULATED_PORT  *Port,
+  IN UINT64          Delay
+  )
+{
+  if ((Port->PowerOnAt == TEST_NEVER) || (Delay == TEST_NEVER)) {
+    return FALSE;
+  }
+
+  return mHba.Clock >= Port->PowerOnAt + Delay;
+}
+
+/**
+  Find the port and the port register of an AHCI register offset.
+
+  @param[in]  Offset    The register offset.
+  @param[out] Register  The offset of the port register.
+
+  @return The port, or NULL if the offset is not a port register.
+
+**/
+STATIC
+SIMULATED_PORT *
+TestGetPort (
+  IN  UINT32  Offset,
+  OUT UINT32  *Register
+  )
+{
+  UINT32  Index;
+
+  if (Offset < EFI_AHCI_PORT_START) {
+    mHba.BadAccesses++;
+    return NULL;
+  }
+
+  Index     = (Offset - EFI_AHCI_PORT_START) / EFI_AHCI_PORT_REG_WIDTH;
+  *Register = (Offset - EFI_AHCI_PORT_START) % EFI_AHCI_PORT_REG_WIDTH;
+  if (Index >= EFI_AHCI_MAX_PORTS) {
+    mHba.BadAccesses++;
+    return NULL;
+  }
+
+  return &mHba.Ports[Index];
+}
+
+/**
+  Read a register of the simulated HBA.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+
+  @return The register content read.
+
+**/
+UINT32
+EFIAPI
+AhciReadReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT32              Offset
+  )
+{
+  SIMULATED_PORT  *Port;
+  UINT32          Register;
+
+  Port = TestGetPort (Offset, &Register);
+  if (Port == NULL) {
+    return 0;
+  }
+
+  switch (Register) {
+    case EFI_AHCI_PORT_CMD:
+      return Port->Cmd;
+
+    case EFI_AHCI_PORT_SERR:
+      return Port->Serr;
+
+    case EFI_AHCI_PORT_SSTS:
+      if (Port->DevicePresent && TestPortElapsed (Port, TEST_PHY_DETECT_TIME)) {
+        return EFI_AHCI_PORT_SSTS_DET_PCE;
+      }
+
+      return 0;
+
+    case EFI_AHCI_PORT_TFD:
+      if (Port->DevicePresent && TestPortElapsed (Port, Port->SpinUpTime)) {
+        return 0x50;
+      }
+
+      return 0x80;
+
+    case EFI_AHCI_PORT_SIG:
+      if (  Port->DevicePresent
+         && (Port->SpinUpTime != TEST_NEVER)
+         && (Port->SignatureDelay != TEST_NEVER)
+         && TestPortElapsed (Port, Port->SpinUpTime + Port->SignatureDelay))
+      {
+        return Port->Signature;
+      }
+
+      return MAX_UINT32;
+
+    default:
+      mHba.BadAccesses++;
+      return 0;
+  }
+}
+
+/**
+  Write a register of the simulated HBA.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+  @param  Data         The data used to write down.
+
+**/
+VOID
+EFIAPI
+AhciWriteReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               Offset,
+  IN UINT32               Data
+  )
+{
+  SIMULATED_PORT  *Port;
+  UINT32          Register;
+
+  Port = TestGetPort (Offset, &Register);
+  if (Port == NULL) {
+    return;
+  }
+
+  switch (Register) {
+    case EFI_AHCI_PORT_CMD:
+      if (((Data & EFI_AHCI_PORT_CMD_SUD) != 0) && (Port->PowerOnAt == TEST_NEVER)) {
+        Port->PowerOnAt = mHba.Clock;
+      }
+
+      Port->Cmd = Data;
+      break;
+
+    case EFI_AHCI_PORT_SERR:
+      //
+      // PxSERR bits are cleared by writing ones.
+      //
+      Port->Serr &= ~Data;
+      mHba.SerrClears++;
+      break;
+
+    default:
+      mHba.BadAccesses++;
+      break;
+  }
+}
+
+/**
+  Do AND operation with the value of a register of the simulated HBA.
+
+  @param  PciIo        The PCI IO protocol instance.
+  @param  Offset       The operation register offset.
+  @param  AndData      The data used to do AND operation.
+
+**/
+VOID
+EFIAPI
+AhciAndReg (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT32               Offset,
+  IN UINT32               AndData
+  )
+{
+  AhciWriteReg (PciIo, Offset, AhciReadReg (PciIo, Offset) & AndData);
+}
+
+/**
+  Spin up the drive of a port, as AhciModeInitialization() does before waiting
+  for it.
+
+  @param[in] Port  The port.
+
+**/
+STATIC
+VOID
+TestStartPort (
+  IN UINT8  Port
+  )
+{
+  UINT32  Offset;
+
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+  AhciWriteReg (&mPciIo, Offset, AhciReadReg (&mPciIo, Offset) | EFI_AHCI_PORT_CMD_SUD | EFI_AHCI_PORT_CMD_FRE);
+}
+
+/**
+  Attach drives to the first ports of the simulated HBA.
+
+  @param[in] Count  Number of drives.
+
+**/
+STATIC
+VOID
+TestAttachDrives (
+  IN UINTN  Count
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Count; Index++) {
+    mHba.Ports[Index].DevicePresent = TRUE;
+    mHba.Ports[Index].Signature     = ((Index % 4) == 3) ? (EFI_AHCI_ATAPI_DEVICE_SIG | 0x0101) : 0x00000101;
+    //
+    // The drives do not all take the same time to spin up.
+    //
+    mHba.Ports[Index].SpinUpTime     = TEST_SPIN_UP_TIME + Index * 10 * 1000;
+    mHba.Ports[Index].SignatureDelay = TEST_SIGNATURE_DELAY;
+    mHba.Ports[Index].Serr           = 0x04000000;
+  }
+}
+
+/**
+  Reset the simulated HBA to a controller without drives.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED  The simulated HBA was reset.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+HbaTestSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  ZeroMem (&mHba, sizeof (mHba));
+  for (Index = 0; Index < EFI_AHCI_MAX_PORTS; Index++) {
+    mHba.Ports[Index].PowerOnAt      = TEST_NEVER;
+    mHba.Ports[Index].SpinUpTime     = TEST_NEVER;
+    mHba.Ports[Index].SignatureDelay = TEST_NEVER;
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The drives of a backplane spin up together when their ports are waited for
+  together, and one after the other when the ports are brought up one at a
+  time.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The drives spun up concurrently.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+BackplaneSpinsUpConcurrently (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8   Port;
+  UINT32  PortBitMap;
+  UINT32  ReadyBitMap;
+  UINT64  SlowestSpinUp;
+  UINT64  ConcurrentTime;
+  UINT64  SequentialTime;
+
+  TestAttachDrives (TEST_BACKPLANE_PORTS);
+  SlowestSpinUp = TEST_SPIN_UP_TIME + (TEST_BACKPLANE_PORTS - 1) * 10 * 1000 + TEST_SIGNATURE_DELAY;
+
+  PortBitMap = 0;
+  for (Port = 0; Port < TEST_BACKPLANE_PORTS; Port++) {
+    TestStartPort (Port);
+    PortBitMap |= ((UINT32)BIT0) << Port;
+  }
+
+  ReadyBitMap    = AhciWaitPortsReady (&mPciIo, PortBitMap);
+  ConcurrentTime = mHba.Clock;
+
+  UT_ASSERT_EQUAL (ReadyBitMap, PortBitMap);
+  UT_ASSERT_EQUAL (mHba.BadAccesses, 0);
+  for (Port = 0; Port < TEST_BACKPLANE_PORTS; Port++) {
+    UT_ASSERT_EQUAL (mHba.Ports[Port].Serr, 0);
+    UT_ASSERT_NOT_EQUAL (mHba.Ports[Port].Cmd & EFI_AHCI_PORT_CMD_SUD, 0);
+  }
+
+  //
+  // One spin-up latency, within a poll interval.
+  //
+  UT_ASSERT_TRUE (ConcurrentTime >= SlowestSpinUp);
+  UT_ASSERT_TRUE (ConcurrentTime <= SlowestSpinUp + AHCI_PORT_POLL_INTERVAL);
+
+  //
+  // Bring the same drives up one port at a time.
+  //
+  HbaTestSetup (NULL);
+  TestAttachDrives (TEST_BACKPLANE_PORTS);
+  ReadyBitMap = 0;
+  for (Port = 0; Port < TEST_BACKPLANE_PORTS; Port++) {
+    TestStartPort (Port);
+    ReadyBitMap |= AhciWaitPortsReady (&mPciIo, ((UINT32)BIT0) << Port);
+  }
+
+  SequentialTime = mHba.Clock;
+  UT_ASSERT_EQUAL (ReadyBitMap, PortBitMap);
+  UT_ASSERT_TRUE (SequentialTime >= TEST_BACKPLANE_PORTS * (TEST_SPIN_UP_TIME + TEST_SIGNATURE_DELAY));
+
+  UT_LOG_INFO (
+    "%d drives ready after %Lu us concurrently, %Lu us one port at a time\n",
+    TEST_BACKPLANE_PORTS,
+    ConcurrentTime,
+    SequentialTime
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Ports without a drive are given up after the Phy detection timeout, with
+  PxCMD.SUD cleared, without waiting for the drives of the other ports.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The empty ports were given up.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+EmptyPortsGivenUp (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8   Port;
+  UINT32  ReadyBitMap;
+
+  //
+  // No drive at all costs one Phy detection timeout.
+  //
+  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+    TestStartPort (Port);
+  }
+
+  ReadyBitMap = AhciWaitPortsReady (&mPciIo, MAX_UINT32);
+  UT_ASSERT_EQUAL (ReadyBitMap, 0);
+  UT_ASSERT_TRUE (mHba.Clock >= EFI_AHCI_BUS_PHY_DETECT_TIMEOUT * 1000);
+  UT_ASSERT_TRUE (mHba.Clock <= EFI_AHCI_BUS_PHY_DETECT_TIMEOUT * 1000 + AHCI_PORT_POLL_INTERVAL);
+  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+    UT_ASSERT_EQUAL (mHba.Ports[Port].Cmd & EFI_AHCI_PORT_CMD_SUD, 0);
+    UT_ASSERT_NOT_EQUAL (mHba.Ports[Port].Cmd & EFI_AHCI_PORT_CMD_FRE, 0);
+  }
+
+  //
+  // Drives on ports 1 and 5 only.
+  //
+  HbaTestSetup (NULL);
+  TestAttachDrives (6);
+  mHba.Ports[0].DevicePresent = FALSE;
+  mHba.Ports[2].DevicePresent = FALSE;
+  mHba.Ports[3].DevicePresent = FALSE;
+  mHba.Ports[4].DevicePresent = FALSE;
+  for (Port = 0; Port < 6; Port++) {
+    TestStartPort (Port);
+  }
+
+  ReadyBitMap = AhciWaitPortsReady (&mPciIo, 0x3F);
+  UT_ASSERT_EQUAL (ReadyBitMap, BIT1 | BIT5);
+  UT_ASSERT_EQUAL (mHba.Ports[0].Cmd & EFI_AHCI_PORT_CMD_SUD, 0);
+  UT_ASSERT_NOT_EQUAL (mHba.Ports[1].Cmd & EFI_AHCI_PORT_CMD_SUD, 0);
+  UT_ASSERT_EQUAL (mHba.Ports[4].Cmd & EFI_AHCI_PORT_CMD_SUD, 0);
+  UT_ASSERT_NOT_EQUAL (mHba.Ports[5].Cmd & EFI_AHCI_PORT_CMD_SUD, 0);
+  UT_ASSERT_TRUE (mHba.Clock <= mHba.Ports[5].SpinUpTime + TEST_SIGNATURE_DELAY + AHCI_PORT_POLL_INTERVAL);
+
+  //
+  // Ports that are not asked for are not touched.
+  //
+  UT_ASSERT_EQUAL (mHba.Ports[6].Cmd, 0);
+  UT_ASSERT_EQUAL (mHba.BadAccesses, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A drive that never gets ready or never sends its signature is given up after
+  its timeout, and does not prevent the other drives from being reported.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The failing drives were given up.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FailingDrivesGivenUp (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8   Port;
+  UINT32  ReadyBitMap;
+
+  TestAttachDrives (4);
+  mHba.Ports[1].SpinUpTime     = TEST_NEVER;
+  mHba.Ports[2].SignatureDelay = TEST_NEVER;
+  for (Port = 0; Port < 4; Port++) {
+    TestStartPort (Port);
+  }
+
+  ReadyBitMap = AhciWaitPortsReady (&mPciIo, 0xF);
+  UT_ASSERT_EQUAL (ReadyBitMap, BIT0 | BIT3);
+
+  //
+  // The busy drive is given up AHCI_PORT_DEVICE_READY_TIMEOUT after it was
+  // detected, the silent one AHCI_PORT_SIGNATURE_TIMEOUT after it got ready,
+  // both counted from the polls that saw the state change.
+  //
+  UT_ASSERT_TRUE (mHba.Clock >= mHba.Ports[2].SpinUpTime + AHCI_PORT_SIGNATURE_TIMEOUT);
+  UT_ASSERT_TRUE (mHba.Clock <= mHba.Ports[2].SpinUpTime + AHCI_PORT_SIGNATURE_TIMEOUT + 2 * AHCI_PORT_POLL_INTERVAL);
+  UT_ASSERT_TRUE (mHba.Clock >= TEST_PHY_DETECT_TIME + AHCI_PORT_DEVICE_READY_TIMEOUT);
+
+  //
+  // Drives that are detected keep spinning.
+  //
+  UT_ASSERT_NOT_EQUAL (mHba.Ports[1].Cmd & EFI_AHCI_PORT_CMD_SUD, 0);
+  UT_ASSERT_NOT_EQUAL (mHba.Ports[2].Cmd & EFI_AHCI_PORT_CMD_SUD, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the AHCI port
+  initialization of AtaAtapiPassThru and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+AhciPortInitUnitTestEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      PortInitTestSuite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &PortInitTestSuite,
+             Framework,
+             "AHCI Port Initialization Test Suite",
+             "Ata.Ahci.PortInit",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for PortInitTestSuite. Status = %r\n", Status));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (PortInitTestSuite, "The drives of a backplane spin up concurrently", "BackplaneSpinsUpConcurrently", BackplaneSpinsUpConcurrently, HbaTestSetup, NULL, NULL);
+  AddTestCase (PortInitTestSuite, "Empty ports are given up", "EmptyPortsGivenUp", EmptyPortsGivenUp, HbaTestSetup, NULL, NULL);
+  AddTestCase (PortInitTestSuite, "Failing drives are given up", "FailingDrivesGivenUp", FailingDrivesGivenUp, HbaTestSetup, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return AhciPortInitUnitTestEntry ();
+}
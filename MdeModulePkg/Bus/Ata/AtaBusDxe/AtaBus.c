@@ -80,6 +80,7 @@ ATA_DEVICE  gAtaDeviceTemplate = {
   NULL,                                       // Asb
   FALSE,                                      // UdmaValid
   FALSE,                                      // Lba48Bit
+  FALSE,                                      // NcqValid  // MU_CHANGE - AHCI native command queuing
   NULL,                                       // IdentifyData
   NULL,                                       // ControllerNameTable
   { L'\0',                                 }, // ModelName
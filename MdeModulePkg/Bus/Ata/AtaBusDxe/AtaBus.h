@@ -32,6 +32,7 @@
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/TimerLib.h>
 #include <Library/ReportStatusCodeLib.h>
+#include <Library/PcdLib.h> // MU_CHANGE - AHCI native command queuing
 
 #include <IndustryStandard/Atapi.h>
 
@@ -114,6 +115,7 @@ typedef struct {
 
   BOOLEAN                                  UdmaValid;
   BOOLEAN                                  Lba48Bit;
+  BOOLEAN                                  NcqValid; // MU_CHANGE - AHCI native command queuing
 
   //
   // Cached data for ATA identify data
@@ -333,6 +333,21 @@ IdentifyAtaDevice (
     AtaDevice->Lba48Bit = FALSE;
   }
 
+  // MU_CHANGE [BEGIN] - AHCI native command queuing
+  //
+  // Check whether the WORD 76 (Serial ATA capabilities) reports native command
+  // queuing. Queued commands are DMA commands.
+  //
+  AtaDevice->NcqValid = FALSE;
+  if ((PcdGet8 (PcdAtaNcqQueueDepth) != 0) && AtaDevice->UdmaValid &&
+      (IdentifyData->serial_ata_capabilities != 0xFFFF) &&
+      ((IdentifyData->serial_ata_capabilities & BIT8) != 0))
+  {
+    AtaDevice->NcqValid = TRUE;
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Block Media Information:
   //
@@ -471,6 +486,7 @@ TransferAtaDevice (
 {
   EFI_ATA_COMMAND_BLOCK             *Acb;
   EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet;
+  EFI_STATUS                        Status; // MU_CHANGE - AHCI native command queuing
 
   //
   // Ensure AtaDevice->UdmaValid, AtaDevice->Lba48Bit and IsWrite are valid boolean values
@@ -516,6 +532,27 @@ TransferAtaDevice (
 
   Packet->Protocol = mAtaPassThruCmdProtocols[AtaDevice->UdmaValid][IsWrite];
   Packet->Length   = EFI_ATA_PASS_THRU_LENGTH_SECTOR_COUNT;
+
+  // MU_CHANGE [BEGIN] - AHCI native command queuing
+  //
+  // Non-blocking transfers are queued on the devices that support it. The
+  // sector count of a queued command is in the features registers and its
+  // LBA always uses the 48-bit registers.
+  //
+  if ((TaskPacket != NULL) && AtaDevice->NcqValid) {
+    Acb->AtaCommand         = IsWrite ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+    Acb->AtaFeatures        = (UINT8)TransferLength;
+    Acb->AtaFeaturesExp     = (UINT8)(TransferLength >> 8);
+    Acb->AtaSectorCount     = 0;
+    Acb->AtaSectorCountExp  = 0;
+    Acb->AtaSectorNumberExp = (UINT8)RShiftU64 (StartLba, 24);
+    Acb->AtaCylinderLowExp  = (UINT8)RShiftU64 (StartLba, 32);
+    Acb->AtaCylinderHighExp = (UINT8)RShiftU64 (StartLba, 40);
+    Acb->AtaDeviceHead      = BIT6;
+    Packet->Protocol        = EFI_ATA_PASS_THRU_PROTOCOL_FPDMA;
+  }
+
+  // MU_CHANGE [END]
   //
   // |------------------------|-----------------|------------------------|-----------------|
   // | ATA PIO Transfer Mode  |  Transfer Rate  | ATA DMA Transfer Mode  |  Transfer Rate  |
@@ -549,7 +586,24 @@ TransferAtaDevice (
     Packet->Timeout = EFI_TIMER_PERIOD_SECONDS (DivU64x32 (MultU64x32 (TransferLength, AtaDevice->BlockMedia.BlockSize), 3300000) + 31);
   }
 
-  return AtaDevicePassThru (AtaDevice, TaskPacket, Event);
+  // MU_CHANGE [BEGIN] - AHCI native command queuing
+  Status = AtaDevicePassThru (AtaDevice, TaskPacket, Event);
+  if ((Status == EFI_UNSUPPORTED) && (Packet->Protocol == EFI_ATA_PASS_THRU_PROTOCOL_FPDMA)) {
+    //
+    // The host controller does not queue commands, send them as DMA commands.
+    //
+    DEBUG ((DEBUG_INFO, "AtaBus - Native command queuing not supported by the host controller\n"));
+    FreeAlignedBuffer (Packet->Asb, sizeof (EFI_ATA_STATUS_BLOCK));
+    if (Packet->Acb != NULL) {
+      FreePool (Packet->Acb);
+    }
+
+    AtaDevice->NcqValid = FALSE;
+    return TransferAtaDevice (AtaDevice, TaskPacket, Buffer, StartLba, TransferLength, IsWrite, Event);
+  }
+
+  // MU_CHANGE [END]
+  return Status;
 }
 
 /**
@@ -806,7 +860,8 @@ AccessAtaDevice (
   if ((Token != NULL) && (Token->Event != NULL)) {
     OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
 
-    if (!IsListEmpty (&AtaDevice->AtaSubTaskList)) {
+    if (!IsListEmpty (&AtaDevice->AtaSubTaskList) && !AtaDevice->NcqValid) {
+      // MU_CHANGE - AHCI native command queuing: only wait for the previous requests if commands are not queued
       AtaTask = AllocateZeroPool (sizeof (ATA_BUS_ASYN_TASK));
       if (AtaTask == NULL) {
         gBS->RestoreTPL (OldTpl);
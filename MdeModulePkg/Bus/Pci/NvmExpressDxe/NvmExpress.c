@@ -698,17 +698,13 @@ ProcessAsyncTaskList (
           PciIo->Unmap (PciIo, AsyncRequest->MapMeta);
         }
 
-        if (AsyncRequest->MapPrpList != NULL) {
-          PciIo->Unmap (PciIo, AsyncRequest->MapPrpList);
-        }
-
-        if (AsyncRequest->PrpListHost != NULL) {
-          PciIo->FreeBuffer (
-                   PciIo,
-                   AsyncRequest->PrpListNo,
-                   AsyncRequest->PrpListHost
-                   );
-        }
+        // MU_CHANGE - PRP list pool and mapping cache
+        NvmeDmaFreePrpList (
+          Private,
+          AsyncRequest->PrpListNo,
+          AsyncRequest->PrpListHost,
+          AsyncRequest->MapPrpList
+          );
 
         RemoveEntryList (Link);
         gBS->SignalEvent (AsyncRequest->CallerEvent);
@@ -1103,6 +1099,7 @@ NvmExpressDriverBindingStart (
     CopyMem (&Private->PassThruMode, &gEfiNvmExpressPassThruMode, sizeof (EFI_NVM_EXPRESS_PASS_THRU_MODE));
     InitializeListHead (&Private->AsyncPassThruQueue);
     InitializeListHead (&Private->UnsubmittedSubtasks);
+    NvmeDmaInitialize (Private); // MU_CHANGE - PRP list pool and mapping cache
 
     Status = NvmeControllerInit (Private);
     if (EFI_ERROR (Status)) {
@@ -1188,6 +1185,13 @@ NvmExpressDriverBindingStart (
   return EFI_SUCCESS;
 
 Exit:
+  // MU_CHANGE [BEGIN] - PRP list pool and mapping cache
+  if (Private != NULL) {
+    NvmeDmaCleanup (Private);
+  }
+
+  // MU_CHANGE [END]
+
   if ((Private != NULL) && (Private->Mapping != NULL)) {
     PciIo->Unmap (PciIo, Private->Mapping);
   }
@@ -1314,6 +1318,8 @@ NvmExpressDriverBindingStop (
         gBS->CloseEvent (Private->TimerEvent);
       }
 
+      NvmeDmaCleanup (Private); // MU_CHANGE - PRP list pool and mapping cache
+
       if (Private->Mapping != NULL) {
         Private->PciIo->Unmap (Private->PciIo, Private->Mapping);
       }
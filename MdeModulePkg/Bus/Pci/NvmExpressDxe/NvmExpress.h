@@ -31,6 +31,7 @@
 #include <Protocol/StorageSecurityCommand.h>
 #include <Protocol/ResetNotification.h>
 #include <Protocol/MediaSanitize.h> // MU_CHANGE - Add Media Sanitize
+#include <Protocol/IoMmu.h>         // MU_CHANGE - PRP list pool and mapping cache
 
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
@@ -52,6 +53,8 @@ typedef struct _NVME_DEVICE_PRIVATE_DATA      NVME_DEVICE_PRIVATE_DATA;
 #include "NvmExpressDiskInfo.h"
 #include "NvmExpressHci.h"
 #include "NvmExpressMediaSanitize.h" // MU_CHANGE - Add Media Sanitize
+#include "NvmExpressPipelinedIo.h"    // MU_CHANGE - Pipelined blocking I/O
+#include "NvmExpressDma.h"            // MU_CHANGE - PRP list pool and mapping cache
 
 extern EFI_DRIVER_BINDING_PROTOCOL                gNvmExpressDriverBinding;
 extern EFI_COMPONENT_NAME_PROTOCOL                gNvmExpressComponentName;
@@ -209,6 +212,11 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   EFI_EVENT      TimerEvent;
   LIST_ENTRY     AsyncPassThruQueue;
   LIST_ENTRY     UnsubmittedSubtasks;
+
+  //
+  // PRP list pool and data buffer mappings.
+  //
+  NVME_DMA_CONTEXT    Dma; // MU_CHANGE - PRP list pool and mapping cache
 };
 
 #define NVME_CONTROLLER_PRIVATE_DATA_FROM_PASS_THRU(a) \
@@ -778,6 +786,40 @@ NvmeDumpStatus (
   IN NVME_CQ  *Cq
   );
 
+// MU_CHANGE [BEGIN] - Pipelined blocking I/O
+
+/**
+  Call back function when the timer event is signaled.
+
+  @param[in]  Event     The Event this notify function registered to.
+  @param[in]  Context   Pointer to the context data registered to the
+                        Event.
+
+**/
+VOID
+EFIAPI
+ProcessAsyncTaskList (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  );
+
+/**
+  Aborts the asynchronous PassThru requests.
+
+  @param[in] Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA
+                            data structure.
+
+  @retval EFI_SUCCESS       The asynchronous PassThru requests have been aborted.
+  @return EFI_DEVICE_ERROR  Fail to abort all the asynchronous PassThru requests.
+
+**/
+EFI_STATUS
+AbortAsyncPassThruTasks (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  );
+
+// MU_CHANGE [END]
+
 /**
   Register the shutdown notification through the ResetNotification protocol.
 
@@ -195,6 +195,29 @@ NvmeRead (
     MaxTransferBlocks = 1024;
   }
 
+  // MU_CHANGE [BEGIN] - Pipelined blocking I/O
+  //
+  // Keep several commands in flight when the transfer needs more than one.
+  //
+  if (Blocks > MaxTransferBlocks) {
+    Status = NvmePipelinedReadWrite (Device, FALSE, Buffer, Lba, Blocks, MaxTransferBlocks);
+    if ((Status != EFI_OUT_OF_RESOURCES) && (Status != EFI_NOT_READY)) {
+      DEBUG ((
+        DEBUG_BLKIO,
+        "%a: Lba = 0x%08Lx, Original = 0x%08Lx, Pipelined, "
+        "BlockSize = 0x%x, Status = %r\n",
+        __func__,
+        Lba,
+        (UINT64)OrginalBlocks,
+        BlockSize,
+        Status
+        ));
+      return Status;
+    }
+  }
+
+  // MU_CHANGE [END]
+
   while (Blocks > 0) {
     if (Blocks > MaxTransferBlocks) {
       Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
@@ -281,6 +304,29 @@ NvmeWrite (
     MaxTransferBlocks = 1024;
   }
 
+  // MU_CHANGE [BEGIN] - Pipelined blocking I/O
+  //
+  // Keep several commands in flight when the transfer needs more than one.
+  //
+  if (Blocks > MaxTransferBlocks) {
+    Status = NvmePipelinedReadWrite (Device, TRUE, Buffer, Lba, Blocks, MaxTransferBlocks);
+    if ((Status != EFI_OUT_OF_RESOURCES) && (Status != EFI_NOT_READY)) {
+      DEBUG ((
+        DEBUG_BLKIO,
+        "%a: Lba = 0x%08Lx, Original = 0x%08Lx, Pipelined, "
+        "BlockSize = 0x%x, Status = %r\n",
+        __func__,
+        Lba,
+        (UINT64)OrginalBlocks,
+        BlockSize,
+        Status
+        ));
+      return Status;
+    }
+  }
+
+  // MU_CHANGE [END]
+
   while (Blocks > 0) {
     if (Blocks > MaxTransferBlocks) {
       Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
@@ -0,0 +1,508 @@
+/** @file
+  PRP list pool and data buffer mapping cache of the NVM Express controllers.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "NvmExpress.h"
+
+/**
+  Report the DMA counters of a controller when the boot manager is about to
+  boot.
+
+  @param[in]  Event     The Event this notify function registered to.
+  @param[in]  Context   The NVME_CONTROLLER_PRIVATE_DATA of the controller.
+
+**/
+STATIC
+VOID
+EFIAPI
+NvmeDmaReportStatistics (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA  *Private;
+  NVME_DMA_STATISTICS           *Statistics;
+
+  Private    = (NVME_CONTROLLER_PRIVATE_DATA *)Context;
+  Statistics = &Private->Dma.Statistics;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "NvmExpress: PRP lists allocated %Lu, from pool %Lu; data maps %Lu, reused %Lu\n",
+    Statistics->PrpListAllocations,
+    Statistics->PrpListAllocationsAvoided,
+    Statistics->DataMaps,
+    Statistics->DataMapsAvoided
+    ));
+}
+
+/**
+  Unmap the data buffer mappings kept by a controller.
+
+  @param[in] Private  The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+STATIC
+VOID
+NvmeDmaReleaseMappings (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  )
+{
+  NVME_DMA_CONTEXT          *Dma;
+  NVME_DMA_MAP_CACHE_ENTRY  MapCache[NVME_DMA_MAP_CACHE_SIZE];
+  EFI_TPL                   OldTpl;
+  UINTN                     Index;
+
+  Dma = &Private->Dma;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  CopyMem (MapCache, Dma->MapCache, sizeof (MapCache));
+  ZeroMem (Dma->MapCache, sizeof (Dma->MapCache));
+  gBS->RestoreTPL (OldTpl);
+
+  for (Index = 0; Index < NVME_DMA_MAP_CACHE_SIZE; Index++) {
+    if ((MapCache[Index].Length != 0) && (MapCache[Index].Mapping != NULL)) {
+      Private->PciIo->Unmap (Private->PciIo, MapCache[Index].Mapping);
+    }
+  }
+}
+
+/**
+  Stop keeping data buffer mappings when an IOMMU is installed.
+
+  @param[in]  Event     The Event this notify function registered to.
+  @param[in]  Context   The NVME_CONTROLLER_PRIVATE_DATA of the controller.
+
+**/
+STATIC
+VOID
+EFIAPI
+NvmeDmaIoMmuNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA  *Private;
+  NVME_DMA_CONTEXT              *Dma;
+  VOID                          *IoMmu;
+  EFI_TPL                       OldTpl;
+  EFI_STATUS                    Status;
+
+  Private = (NVME_CONTROLLER_PRIVATE_DATA *)Context;
+  Dma     = &Private->Dma;
+
+  Status = gBS->LocateProtocol (&gEdkiiIoMmuProtocolGuid, Dma->IoMmuRegistration, &IoMmu);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  gBS->CloseEvent (Event);
+  Dma->IoMmuEvent = NULL;
+
+  OldTpl            = gBS->RaiseTPL (TPL_NOTIFY);
+  Dma->KeepMappings = FALSE;
+  gBS->RestoreTPL (OldTpl);
+
+  NvmeDmaReleaseMappings (Private);
+}
+
+/**
+  Allocate the PRP list pool of a controller and decide whether data buffer
+  mappings can be kept.
+
+  The controller works without the pool if it cannot be allocated.
+
+  @param[in] Private  The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeDmaInitialize (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  )
+{
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  NVME_DMA_CONTEXT     *Dma;
+  VOID                 *IoMmu;
+  UINTN                Bytes;
+  EFI_STATUS           Status;
+
+  PciIo = Private->PciIo;
+  Dma   = &Private->Dma;
+  ZeroMem (Dma, sizeof (NVME_DMA_CONTEXT));
+
+  //
+  // With an IOMMU, a mapping grants the device access to the buffer until it
+  // is unmapped, so it must not outlive its command.
+  //
+  if (FeaturePcdGet (PcdNvmeDmaMapCacheEnable)) {
+    Status            = gBS->LocateProtocol (&gEdkiiIoMmuProtocolGuid, NULL, &IoMmu);
+    Dma->KeepMappings = EFI_ERROR (Status);
+    if (Dma->KeepMappings) {
+      Dma->IoMmuEvent = EfiCreateProtocolNotifyEvent (
+                          &gEdkiiIoMmuProtocolGuid,
+                          TPL_CALLBACK,
+                          NvmeDmaIoMmuNotify,
+                          Private,
+                          &Dma->IoMmuRegistration
+                          );
+    }
+  }
+
+  Status = PciIo->AllocateBuffer (
+                    PciIo,
+                    AllocateAnyPages,
+                    EfiBootServicesData,
+                    NVME_PRP_POOL_PAGES,
+                    (VOID **)&Dma->PrpPool,
+                    0
+                    );
+  if (!EFI_ERROR (Status)) {
+    Bytes  = EFI_PAGES_TO_SIZE (NVME_PRP_POOL_PAGES);
+    Status = PciIo->Map (
+                      PciIo,
+                      EfiPciIoOperationBusMasterCommonBuffer,
+                      Dma->PrpPool,
+                      &Bytes,
+                      &Dma->PrpPoolPciAddr,
+                      &Dma->PrpPoolMapping
+                      );
+    if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (NVME_PRP_POOL_PAGES))) {
+      if (!EFI_ERROR (Status)) {
+        PciIo->Unmap (PciIo, Dma->PrpPoolMapping);
+      }
+
+      PciIo->FreeBuffer (PciIo, NVME_PRP_POOL_PAGES, Dma->PrpPool);
+      Dma->PrpPool        = NULL;
+      Dma->PrpPoolMapping = NULL;
+    }
+  }
+
+  if (Dma->PrpPool == NULL) {
+    DEBUG ((DEBUG_WARN, "%a: no PRP list pool, PRP lists are allocated per command\n", __func__));
+  }
+
+  DEBUG_CODE_BEGIN ();
+  EfiCreateEventReadyToBootEx (TPL_CALLBACK, NvmeDmaReportStatistics, Private, &Dma->ReadyToBootEvent);
+  DEBUG_CODE_END ();
+}
+
+/**
+  Release the kept mappings and the PRP list pool of a controller.
+
+  @param[in] Private  The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeDmaCleanup (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  )
+{
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  NVME_DMA_CONTEXT     *Dma;
+
+  PciIo = Private->PciIo;
+  Dma   = &Private->Dma;
+
+  if (Dma->ReadyToBootEvent != NULL) {
+    gBS->CloseEvent (Dma->ReadyToBootEvent);
+    Dma->ReadyToBootEvent = NULL;
+  }
+
+  if (Dma->IoMmuEvent != NULL) {
+    gBS->CloseEvent (Dma->IoMmuEvent);
+    Dma->IoMmuEvent = NULL;
+  }
+
+  NvmeDmaReleaseMappings (Private);
+
+  if (Dma->PrpPool != NULL) {
+    ASSERT (Dma->PrpPoolBusy == 0);
+    PciIo->Unmap (PciIo, Dma->PrpPoolMapping);
+    PciIo->FreeBuffer (PciIo, NVME_PRP_POOL_PAGES, Dma->PrpPool);
+    Dma->PrpPool        = NULL;
+    Dma->PrpPoolMapping = NULL;
+  }
+}
+
+/**
+  Take consecutive free pages from the PRP list pool.
+
+  @param[in] Dma    The DMA state of the controller.
+  @param[in] Pages  Number of pages.
+
+  @return Index of the first page, or NVME_PRP_POOL_PAGES if there are not
+          enough consecutive free pages.
+
+**/
+STATIC
+UINTN
+NvmeDmaTakePoolPages (
+  IN NVME_DMA_CONTEXT  *Dma,
+  IN UINTN             Pages
+  )
+{
+  UINT64  Mask;
+  UINTN   First;
+
+  if ((Dma->PrpPool == NULL) || (Pages == 0) || (Pages > NVME_PRP_POOL_PAGES)) {
+    return NVME_PRP_POOL_PAGES;
+  }
+
+  Mask = (Pages == 64) ? MAX_UINT64 : (LShiftU64 (1, Pages) - 1);
+  for (First = 0; First + Pages <= NVME_PRP_POOL_PAGES; First++) {
+    if ((Dma->PrpPoolBusy & LShiftU64 (Mask, First)) == 0) {
+      Dma->PrpPoolBusy |= LShiftU64 (Mask, First);
+      return First;
+    }
+  }
+
+  return NVME_PRP_POOL_PAGES;
+}
+
+/**
+  Allocate and map PRP list pages, from the pool if possible.
+
+  @param[in]  Private      The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  Pages        Number of pages.
+  @param[out] HostAddress  The host address of the pages.
+  @param[out] PciAddress   The device address of the pages.
+  @param[out] Mapping      The mapping of the pages, or NULL if they come from
+                           the pool.
+
+  @retval EFI_SUCCESS           The pages were allocated.
+  @retval EFI_OUT_OF_RESOURCES  The pages could not be allocated or mapped.
+
+**/
+EFI_STATUS
+NvmeDmaAllocatePrpList (
+  IN  NVME_CONTROLLER_PRIVATE_DATA  *Private,
+  IN  UINTN                         Pages,
+  OUT VOID                          **HostAddress,
+  OUT EFI_PHYSICAL_ADDRESS          *PciAddress,
+  OUT VOID                          **Mapping
+  )
+{
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  NVME_DMA_CONTEXT     *Dma;
+  EFI_TPL              OldTpl;
+  UINTN                First;
+  UINTN                Bytes;
+  EFI_STATUS           Status;
+
+  PciIo = Private->PciIo;
+  Dma   = &Private->Dma;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  First  = NvmeDmaTakePoolPages (Dma, Pages);
+  DEBUG_CODE_BEGIN ();
+  if (First < NVME_PRP_POOL_PAGES) {
+    Dma->Statistics.PrpListAllocationsAvoided++;
+  } else {
+    Dma->Statistics.PrpListAllocations++;
+  }
+
+  DEBUG_CODE_END ();
+  gBS->RestoreTPL (OldTpl);
+
+  if (First < NVME_PRP_POOL_PAGES) {
+    *HostAddress = Dma->PrpPool + EFI_PAGES_TO_SIZE (First);
+    *PciAddress  = Dma->PrpPoolPciAddr + EFI_PAGES_TO_SIZE (First);
+    *Mapping     = NULL;
+    return EFI_SUCCESS;
+  }
+
+  Status = PciIo->AllocateBuffer (
+                    PciIo,
+                    AllocateAnyPages,
+                    EfiBootServicesData,
+                    Pages,
+                    HostAddress,
+                    0
+                    );
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Bytes  = EFI_PAGES_TO_SIZE (Pages);
+  Status = PciIo->Map (
+                    PciIo,
+                    EfiPciIoOperationBusMasterCommonBuffer,
+                    *HostAddress,
+                    &Bytes,
+                    PciAddress,
+                    Mapping
+                    );
+  if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (Pages))) {
+    if (!EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, *Mapping);
+    }
+
+    PciIo->FreeBuffer (PciIo, Pages, *HostAddress);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Free PRP list pages allocated by NvmeDmaAllocatePrpList().
+
+  @param[in] Private      The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in] Pages        Number of pages.
+  @param[in] HostAddress  The host address of the pages, or NULL.
+  @param[in] Mapping      The mapping of the pages, or NULL.
+
+**/
+VOID
+NvmeDmaFreePrpList (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private,
+  IN UINTN                         Pages,
+  IN VOID                          *HostAddress,
+  IN VOID                          *Mapping
+  )
+{
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  NVME_DMA_CONTEXT     *Dma;
+  EFI_TPL              OldTpl;
+  UINTN                First;
+  UINT64               Mask;
+
+  PciIo = Private->PciIo;
+  Dma   = &Private->Dma;
+
+  if (HostAddress == NULL) {
+    return;
+  }
+
+  if ((Dma->PrpPool != NULL) &&
+      ((UINT8 *)HostAddress >= Dma->PrpPool) &&
+      ((UINT8 *)HostAddress < Dma->PrpPool + EFI_PAGES_TO_SIZE (NVME_PRP_POOL_PAGES)))
+  {
+    First = EFI_SIZE_TO_PAGES ((UINTN)((UINT8 *)HostAddress - Dma->PrpPool));
+    Mask  = (Pages == 64) ? MAX_UINT64 : (LShiftU64 (1, Pages) - 1);
+
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    ASSERT ((Dma->PrpPoolBusy & LShiftU64 (Mask, First)) == LShiftU64 (Mask, First));
+    Dma->PrpPoolBusy &= ~LShiftU64 (Mask, First);
+    gBS->RestoreTPL (OldTpl);
+    return;
+  }
+
+  if (Mapping != NULL) {
+    PciIo->Unmap (PciIo, Mapping);
+  }
+
+  PciIo->FreeBuffer (PciIo, Pages, HostAddress);
+}
+
+/**
+  Map a data buffer for a command, reusing a kept mapping if possible.
+
+  The parameters are those of EFI_PCI_IO_PROTOCOL.Map(). When the mapping is
+  kept by the controller, *Mapping is set to NULL and the caller must not
+  unmap it.
+
+  @param[in]     Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]     Operation      Bus master read or bus master write.
+  @param[in]     HostAddress    The data buffer.
+  @param[in,out] NumberOfBytes  On input the number of bytes to map, on output
+                                the number of bytes mapped.
+  @param[out]    DeviceAddress  The device address of the data buffer.
+  @param[out]    Mapping        The mapping to unmap when the command is done,
+                                or NULL.
+
+  @return The status of EFI_PCI_IO_PROTOCOL.Map().
+
+**/
+EFI_STATUS
+NvmeDmaMap (
+  IN     NVME_CONTROLLER_PRIVATE_DATA   *Private,
+  IN     EFI_PCI_IO_PROTOCOL_OPERATION  Operation,
+  IN     VOID                           *HostAddress,
+  IN OUT UINTN                          *NumberOfBytes,
+  OUT    EFI_PHYSICAL_ADDRESS           *DeviceAddress,
+  OUT    VOID                           **Mapping
+  )
+{
+  EFI_PCI_IO_PROTOCOL       *PciIo;
+  NVME_DMA_CONTEXT          *Dma;
+  NVME_DMA_MAP_CACHE_ENTRY  *Entry;
+  NVME_DMA_MAP_CACHE_ENTRY  *Victim;
+  VOID                      *EvictedMapping;
+  EFI_TPL                   OldTpl;
+  UINTN                     Index;
+  UINTN                     Offset;
+  EFI_STATUS                Status;
+
+  PciIo          = Private->PciIo;
+  Dma            = &Private->Dma;
+  EvictedMapping = NULL;
+
+  if (Dma->KeepMappings) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    for (Index = 0; Index < NVME_DMA_MAP_CACHE_SIZE; Index++) {
+      Entry = &Dma->MapCache[Index];
+      if ((Entry->Length != 0) &&
+          (Entry->Operation == Operation) &&
+          ((UINT8 *)HostAddress >= (UINT8 *)Entry->HostAddress) &&
+          ((UINT8 *)HostAddress + *NumberOfBytes <= (UINT8 *)Entry->HostAddress + Entry->Length))
+      {
+        Offset         = (UINTN)((UINT8 *)HostAddress - (UINT8 *)Entry->HostAddress);
+        *DeviceAddress = Entry->DeviceAddress + Offset;
+        *Mapping       = NULL;
+        Entry->LastUse = ++Dma->MapCacheClock;
+        DEBUG_CODE (
+          Dma->Statistics.DataMapsAvoided++;
+          );
+        gBS->RestoreTPL (OldTpl);
+        return EFI_SUCCESS;
+      }
+    }
+
+    gBS->RestoreTPL (OldTpl);
+  }
+
+  Status = PciIo->Map (PciIo, Operation, HostAddress, NumberOfBytes, DeviceAddress, Mapping);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  DEBUG_CODE (
+    Dma->Statistics.DataMaps++;
+    );
+
+  //
+  // Only keep mappings that access the buffer itself. Any other mapping uses
+  // a bounce buffer, which is only copied back when it is unmapped.
+  //
+  if (Dma->KeepMappings && (*DeviceAddress == (EFI_PHYSICAL_ADDRESS)(UINTN)HostAddress)) {
+    Victim = &Dma->MapCache[0];
+    for (Index = 1; Index < NVME_DMA_MAP_CACHE_SIZE; Index++) {
+      if (Dma->MapCache[Index].LastUse < Victim->LastUse) {
+        Victim = &Dma->MapCache[Index];
+      }
+    }
+
+    EvictedMapping        = (Victim->Length != 0) ? Victim->Mapping : NULL;
+    Victim->HostAddress   = HostAddress;
+    Victim->Length        = *NumberOfBytes;
+    Victim->Operation     = Operation;
+    Victim->DeviceAddress = *DeviceAddress;
+    Victim->Mapping       = *Mapping;
+    Victim->LastUse       = ++Dma->MapCacheClock;
+    *Mapping              = NULL;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  if (EvictedMapping != NULL) {
+    PciIo->Unmap (PciIo, EvictedMapping);
+  }
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/** @file
+  PRP list pool and data buffer mapping cache of the NVM Express controllers.
+
+  Each controller keeps a pool of PRP list pages that are allocated and mapped
+  once, when the controller is started, instead of for every command that
+  needs a PRP list. It also keeps the most recent data buffer mappings, so that
+  a command on a buffer used by a previous command does not have to map it
+  again. Mappings are only kept when PcdNvmeDmaMapCacheEnable is TRUE, there
+  is no IOMMU and the device address is the host address, so that ending the
+  mapping has nothing to copy back or revoke. The kept mappings are released
+  when an IOMMU is installed later.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef NVME_DMA_H_
+#define NVME_DMA_H_
+
+//
+// Number of PRP list pages in the pool of a controller, at most 64.
+//
+#define NVME_PRP_POOL_PAGES  32
+
+//
+// Number of data buffer mappings kept by a controller.
+//
+#define NVME_DMA_MAP_CACHE_SIZE  8
+
+///
+/// A data buffer mapping kept for later commands.
+///
+typedef struct {
+  VOID                             *HostAddress;
+  UINTN                            Length;
+  EFI_PCI_IO_PROTOCOL_OPERATION    Operation;
+  EFI_PHYSICAL_ADDRESS             DeviceAddress;
+  VOID                             *Mapping;
+  UINT64                           LastUse;
+} NVME_DMA_MAP_CACHE_ENTRY;
+
+///
+/// Counters of the DMA resources used by the commands of a controller. They
+/// are only collected in DEBUG builds, and reported at ReadyToBoot.
+///
+typedef struct {
+  UINT64    PrpListAllocations;        ///< PRP lists allocated and mapped for a command.
+  UINT64    PrpListAllocationsAvoided; ///< PRP lists taken from the pool instead.
+  UINT64    DataMaps;                  ///< Data buffers mapped for a command.
+  UINT64    DataMapsAvoided;           ///< Data buffers that reused a kept mapping instead.
+} NVME_DMA_STATISTICS;
+
+///
+/// DMA state of a controller.
+///
+typedef struct {
+  UINT8                       *PrpPool;
+  EFI_PHYSICAL_ADDRESS        PrpPoolPciAddr;
+  VOID                        *PrpPoolMapping;
+  UINT64                      PrpPoolBusy;
+  BOOLEAN                     KeepMappings;
+  NVME_DMA_MAP_CACHE_ENTRY    MapCache[NVME_DMA_MAP_CACHE_SIZE];
+  UINT64                      MapCacheClock;
+  NVME_DMA_STATISTICS         Statistics;
+  EFI_EVENT                   ReadyToBootEvent;
+  EFI_EVENT                   IoMmuEvent;
+  VOID                        *IoMmuRegistration;
+} NVME_DMA_CONTEXT;
+
+/**
+  Allocate the PRP list pool of a controller and decide whether data buffer
+  mappings can be kept.
+
+  The controller works without the pool if it cannot be allocated.
+
+  @param[in] Private  The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeDmaInitialize (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  );
+
+/**
+  Release the kept mappings and the PRP list pool of a controller.
+
+  @param[in] Private  The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeDmaCleanup (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  );
+
+/**
+  Allocate and map PRP list pages, from the pool if possible.
+
+  @param[in]  Private      The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  Pages        Number of pages.
+  @param[out] HostAddress  The host address of the pages.
+  @param[out] PciAddress   The device address of the pages.
+  @param[out] Mapping      The mapping of the pages, or NULL if they come from
+                           the pool.
+
+  @retval EFI_SUCCESS           The pages were allocated.
+  @retval EFI_OUT_OF_RESOURCES  The pages could not be allocated or mapped.
+
+**/
+EFI_STATUS
+NvmeDmaAllocatePrpList (
+  IN  NVME_CONTROLLER_PRIVATE_DATA  *Private,
+  IN  UINTN                         Pages,
+  OUT VOID                          **HostAddress,
+  OUT EFI_PHYSICAL_ADDRESS          *PciAddress,
+  OUT VOID                          **Mapping
+  );
+
+/**
+  Free PRP list pages allocated by NvmeDmaAllocatePrpList().
+
+  @param[in] Private      The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in] Pages        Number of pages.
+  @param[in] HostAddress  The host address of the pages, or NULL.
+  @param[in] Mapping      The mapping of the pages, or NULL.
+
+**/
+VOID
+NvmeDmaFreePrpList (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private,
+  IN UINTN                         Pages,
+  IN VOID                          *HostAddress,
+  IN VOID                          *Mapping
+  );
+
+/**
+  Map a data buffer for a command, reusing a kept mapping if possible.
+
+  The parameters are those of EFI_PCI_IO_PROTOCOL.Map(). When the mapping is
+  kept by the controller, *Mapping is set to NULL and the caller must not
+  unmap it.
+
+  @param[in]     Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]     Operation      Bus master read or bus master write.
+  @param[in]     HostAddress    The data buffer.
+  @param[in,out] NumberOfBytes  On input the number of bytes to map, on output
+                                the number of bytes mapped.
+  @param[out]    DeviceAddress  The device address of the data buffer.
+  @param[out]    Mapping        The mapping to unmap when the command is done,
+                                or NULL.
+
+  @return The status of EFI_PCI_IO_PROTOCOL.Map().
+
+**/
+EFI_STATUS
+NvmeDmaMap (
+  IN     NVME_CONTROLLER_PRIVATE_DATA   *Private,
+  IN     EFI_PCI_IO_PROTOCOL_OPERATION  Operation,
+  IN     VOID                           *HostAddress,
+  IN OUT UINTN                          *NumberOfBytes,
+  OUT    EFI_PHYSICAL_ADDRESS           *DeviceAddress,
+  OUT    VOID                           **Mapping
+  );
+
+#endif
@@ -199,19 +199,21 @@ NvmeDumpStatus (
   Create PRP lists for data transfer which is larger than 2 memory pages.
   Note here we calcuate the number of required PRP lists and allocate them at one time.
 
-  @param[in]     PciIo               A pointer to the EFI_PCI_IO_PROTOCOL instance.
+  @param[in]     Private             The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
   @param[in]     PhysicalAddr        The physical base address of data buffer.
   @param[in]     Pages               The number of pages to be transfered.
   @param[out]    PrpListHost         The host base address of PRP lists.
   @param[in,out] PrpListNo           The number of PRP List.
-  @param[out]    Mapping             The mapping value returned from PciIo.Map().
+  @param[out]    Mapping             The mapping value returned from PciIo.Map(), or
+                                     NULL if the PRP lists come from the pool of
+                                     the controller.
 
   @retval The pointer to the first PRP List of the PRP lists.
 
 **/
 VOID *
 NvmeCreatePrpList (
-  IN     EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN     NVME_CONTROLLER_PRIVATE_DATA  *Private, // MU_CHANGE - PRP list pool and mapping cache
   IN     EFI_PHYSICAL_ADDRESS  PhysicalAddr,
   IN     UINTN                 Pages,
   OUT VOID                     **PrpListHost,
@@ -247,33 +249,15 @@ NvmeCreatePrpList (
     Remainder = PrpEntryNo - 1;
   }
 
-  Status = PciIo->AllocateBuffer (
-                    PciIo,
-                    AllocateAnyPages,
-                    EfiBootServicesData,
-                    *PrpListNo,
-                    PrpListHost,
-                    0
-                    );
-
+  // MU_CHANGE [BEGIN] - PRP list pool and mapping cache
+  Status = NvmeDmaAllocatePrpList (Private, *PrpListNo, PrpListHost, &PrpListPhyAddr, Mapping);
   if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "NvmeCreatePrpList: create PrpList failure!\n"));
     return NULL;
   }
 
-  Bytes  = EFI_PAGES_TO_SIZE (*PrpListNo);
-  Status = PciIo->Map (
-                    PciIo,
-                    EfiPciIoOperationBusMasterCommonBuffer,
-                    *PrpListHost,
-                    &Bytes,
-                    &PrpListPhyAddr,
-                    Mapping
-                    );
-
-  if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (*PrpListNo))) {
-    DEBUG ((DEBUG_ERROR, "NvmeCreatePrpList: create PrpList failure!\n"));
-    goto EXIT;
-  }
+  Bytes = EFI_PAGES_TO_SIZE (*PrpListNo);
+  // MU_CHANGE [END]
 
   //
   // Fill all PRP lists except of last one.
@@ -308,10 +292,6 @@ NvmeCreatePrpList (
   }
 
   return (VOID *)(UINTN)PrpListPhyAddr;
-
-EXIT:
-  PciIo->FreeBuffer (PciIo, *PrpListNo, *PrpListHost);
-  return NULL;
 }
 
 /**
@@ -384,17 +364,13 @@ AbortAsyncPassThruTasks (
       PciIo->Unmap (PciIo, AsyncRequest->MapMeta);
     }
 
-    if (AsyncRequest->MapPrpList != NULL) {
-      PciIo->Unmap (PciIo, AsyncRequest->MapPrpList);
-    }
-
-    if (AsyncRequest->PrpListHost != NULL) {
-      PciIo->FreeBuffer (
-               PciIo,
-               AsyncRequest->PrpListNo,
-               AsyncRequest->PrpListHost
-               );
-    }
+    // MU_CHANGE - PRP list pool and mapping cache
+    NvmeDmaFreePrpList (
+      Private,
+      AsyncRequest->PrpListNo,
+      AsyncRequest->PrpListHost,
+      AsyncRequest->MapPrpList
+      );
 
     RemoveEntryList (Link);
     gBS->SignalEvent (AsyncRequest->CallerEvent);
@@ -645,14 +621,15 @@ NvmExpressPassThru (
 
     if ((Packet->TransferLength != 0) && (Packet->TransferBuffer != NULL)) {
       MapLength = Packet->TransferLength;
-      Status    = PciIo->Map (
-                           PciIo,
-                           Flag,
-                           Packet->TransferBuffer,
-                           &MapLength,
-                           &PhyAddr,
-                           &MapData
-                           );
+      // MU_CHANGE - PRP list pool and mapping cache
+      Status = NvmeDmaMap (
+                 Private,
+                 Flag,
+                 Packet->TransferBuffer,
+                 &MapLength,
+                 &PhyAddr,
+                 &MapData
+                 );
       if (EFI_ERROR (Status) || (Packet->TransferLength != MapLength)) {
         return EFI_OUT_OF_RESOURCES;
       }
@@ -672,10 +649,13 @@ NvmExpressPassThru (
                            &MapMeta
                            );
       if (EFI_ERROR (Status) || (Packet->MetadataLength != MapLength)) {
-        PciIo->Unmap (
-                 PciIo,
-                 MapData
-                 );
+        // MU_CHANGE - A kept data mapping has no MapData
+        if (MapData != NULL) {
+          PciIo->Unmap (
+                   PciIo,
+                   MapData
+                   );
+        }
 
         return EFI_OUT_OF_RESOURCES;
       }
@@ -696,7 +676,7 @@ NvmExpressPassThru (
     // Create PrpList for remaining data buffer.
     //
     PhyAddr = (Sq->Prp[0] + EFI_PAGE_SIZE) & ~(EFI_PAGE_SIZE - 1);
-    Prp     = NvmeCreatePrpList (PciIo, PhyAddr, EFI_SIZE_TO_PAGES (Offset + Bytes) - 1, &PrpListHost, &PrpListNo, &MapPrpList);
+    Prp     = NvmeCreatePrpList (Private, PhyAddr, EFI_SIZE_TO_PAGES (Offset + Bytes) - 1, &PrpListHost, &PrpListNo, &MapPrpList);
     if (Prp == NULL) {
       Status = EFI_OUT_OF_RESOURCES;
       goto EXIT;
@@ -940,17 +920,13 @@ EXIT:
              );
   }
 
-  if (MapPrpList != NULL) {
-    PciIo->Unmap (
-             PciIo,
-             MapPrpList
-             );
-  }
-
+  // MU_CHANGE [BEGIN] - PRP list pool and mapping cache
   if (Prp != NULL) {
-    PciIo->FreeBuffer (PciIo, PrpListNo, PrpListHost);
+    NvmeDmaFreePrpList (Private, PrpListNo, PrpListHost, MapPrpList);
   }
 
+  // MU_CHANGE [END]
+
   if (TimerEvent != NULL) {
     gBS->CloseEvent (TimerEvent);
   }
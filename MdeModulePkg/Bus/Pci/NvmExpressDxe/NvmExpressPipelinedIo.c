@@ -0,0 +1,299 @@
+/** @file
+  Pipelined blocking read and write for the NVM Express namespaces.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "NvmExpress.h"
+
+///
+/// One read or write command of a pipelined request.
+///
+typedef struct {
+  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET    CommandPacket;
+  EFI_NVM_EXPRESS_COMMAND                     Command;
+  EFI_NVM_EXPRESS_COMPLETION                  Completion;
+  EFI_EVENT                                   Event;
+  BOOLEAN                                     InFlight;
+} NVME_PIPELINED_IO_SLOT;
+
+/**
+  Build the read or write command of a slot.
+
+  @param[in]  Device   The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+  @param[out] Slot     The slot to fill.
+  @param[in]  Write    TRUE for a write command, FALSE for a read command.
+  @param[in]  Buffer   The data buffer of the command.
+  @param[in]  Lba      The start block number.
+  @param[in]  Blocks   Number of blocks to transfer.
+
+**/
+STATIC
+VOID
+NvmePipelinedIoBuildCommand (
+  IN  NVME_DEVICE_PRIVATE_DATA  *Device,
+  OUT NVME_PIPELINED_IO_SLOT    *Slot,
+  IN  BOOLEAN                   Write,
+  IN  VOID                      *Buffer,
+  IN  UINT64                    Lba,
+  IN  UINT32                    Blocks
+  )
+{
+  ZeroMem (&Slot->CommandPacket, sizeof (EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
+  ZeroMem (&Slot->Command, sizeof (EFI_NVM_EXPRESS_COMMAND));
+  ZeroMem (&Slot->Completion, sizeof (EFI_NVM_EXPRESS_COMPLETION));
+
+  Slot->CommandPacket.NvmeCmd        = &Slot->Command;
+  Slot->CommandPacket.NvmeCompletion = &Slot->Completion;
+  Slot->CommandPacket.TransferBuffer = Buffer;
+  Slot->CommandPacket.TransferLength = Blocks * Device->Media.BlockSize;
+  Slot->CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
+  Slot->CommandPacket.QueueType      = NVME_IO_QUEUE;
+
+  Slot->Command.Cdw0.Opcode = Write ? NVME_IO_WRITE_OPC : NVME_IO_READ_OPC;
+  Slot->Command.Nsid        = Device->NamespaceId;
+  Slot->Command.Cdw10       = (UINT32)Lba;
+  Slot->Command.Cdw11       = (UINT32)RShiftU64 (Lba, 32);
+  Slot->Command.Cdw12       = (Blocks - 1) & 0xFFFF;
+  if (Write) {
+    //
+    // Set Force Unit Access bit (bit 30) to use write-through behaviour,
+    // the same as WriteSectors().
+    //
+    Slot->Command.Cdw12 |= BIT30;
+  }
+
+  Slot->Command.Flags = CDW10_VALID | CDW11_VALID | CDW12_VALID;
+}
+
+/**
+  Reset the controller after a pipelined command timed out, the same way
+  NvmExpressPassThru() does for a blocking command.
+
+  @param[in] Private  The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_TIMEOUT       The controller was reset and the outstanding
+                            asynchronous commands were aborted.
+  @retval EFI_DEVICE_ERROR  The controller could not be reset.
+
+**/
+STATIC
+EFI_STATUS
+NvmePipelinedIoRecover (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  )
+{
+  EFI_STATUS  Status;
+
+  DEBUG ((DEBUG_ERROR, "%a: Timeout occurs for a pipelined NVMe command.\n", __func__));
+
+  Status = gBS->SetTimer (Private->TimerEvent, TimerCancel, 0);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = NvmeControllerInit (Private);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Status = AbortAsyncPassThruTasks (Private);
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->SetTimer (Private->TimerEvent, TimerPeriodic, NVME_HC_ASYNC_TIMER);
+  }
+
+  return EFI_ERROR (Status) ? Status : EFI_TIMEOUT;
+}
+
+/**
+  Read or write blocks with several commands in flight.
+
+  The commands are sent on the asynchronous I/O queue of the controller, so
+  nothing else may use that queue until they are done. The request is refused
+  if the queue already holds asynchronous requests, such as BlockIo2 requests.
+
+  @param[in]      Device             The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+  @param[in]      Write              TRUE to write Buffer to the device, FALSE to read it.
+  @param[in, out] Buffer             The data buffer.
+  @param[in]      Lba                The start block number.
+  @param[in]      Blocks             Total number of blocks to transfer.
+  @param[in]      MaxTransferBlocks  Maximum number of blocks of one command.
+
+  @retval EFI_SUCCESS            All the blocks were transferred.
+  @retval EFI_OUT_OF_RESOURCES   Nothing was transferred because of a lack of
+                                 resources. The caller may fall back to
+                                 sending one command at a time.
+  @retval EFI_NOT_READY          Nothing was transferred because the
+                                 asynchronous I/O queue is in use. The caller
+                                 may fall back to sending one command at a time.
+  @retval EFI_TIMEOUT            A command timed out and the controller was reset.
+  @retval Others                 Failed to transfer all the blocks.
+
+**/
+EFI_STATUS
+NvmePipelinedReadWrite (
+  IN     NVME_DEVICE_PRIVATE_DATA  *Device,
+  IN     BOOLEAN                   Write,
+  IN OUT VOID                      *Buffer,
+  IN     UINT64                    Lba,
+  IN     UINTN                     Blocks,
+  IN     UINT32                    MaxTransferBlocks
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA  *Private;
+  NVME_PIPELINED_IO_SLOT        *Slots;
+  NVME_PIPELINED_IO_SLOT        *Slot;
+  NVME_CQ                       *Completion;
+  EFI_EVENT                     TimerEvent;
+  EFI_TPL                       OldTpl;
+  EFI_STATUS                    Status;
+  EFI_STATUS                    SubmitStatus;
+  UINTN                         Index;
+  UINTN                         InFlight;
+  UINT32                        TransferBlocks;
+  BOOLEAN                       Progress;
+  BOOLEAN                       QueueBusy;
+
+  Private    = Device->Controller;
+  TimerEvent = NULL;
+
+  //
+  // The slots only track their own commands, and a timeout aborts every
+  // asynchronous request of the controller.
+  //
+  OldTpl    = gBS->RaiseTPL (TPL_NOTIFY);
+  QueueBusy = !IsListEmpty (&Private->AsyncPassThruQueue) || !IsListEmpty (&Private->UnsubmittedSubtasks);
+  gBS->RestoreTPL (OldTpl);
+  if (QueueBusy) {
+    return EFI_NOT_READY;
+  }
+
+  Slots = AllocateZeroPool (NVME_PIPELINED_IO_DEPTH * sizeof (NVME_PIPELINED_IO_SLOT));
+  if (Slots == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = gBS->CreateEvent (EVT_TIMER, TPL_CALLBACK, NULL, NULL, &TimerEvent);
+  for (Index = 0; Index < NVME_PIPELINED_IO_DEPTH && !EFI_ERROR (Status); Index++) {
+    Status = gBS->CreateEvent (0, 0, NULL, NULL, &Slots[Index].Event);
+  }
+
+  if (EFI_ERROR (Status)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Exit;
+  }
+
+  //
+  // The timeout restarts whenever a command completes, so it bounds the time
+  // the controller may go without progress rather than the whole transfer.
+  //
+  Status = gBS->SetTimer (TimerEvent, TimerRelative, NVME_GENERIC_TIMEOUT);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  InFlight = 0;
+  while (TRUE) {
+    //
+    // Fill the free slots. Stop submitting after the first failure, but keep
+    // reaping so that no command still refers to a slot when they are freed.
+    //
+    for (Index = 0; Index < NVME_PIPELINED_IO_DEPTH; Index++) {
+      if ((Blocks == 0) || EFI_ERROR (Status)) {
+        break;
+      }
+
+      Slot = &Slots[Index];
+      if (Slot->InFlight) {
+        continue;
+      }
+
+      TransferBlocks = (UINT32)MIN (Blocks, MaxTransferBlocks);
+      NvmePipelinedIoBuildCommand (Device, Slot, Write, Buffer, Lba, TransferBlocks);
+      SubmitStatus = Private->Passthru.PassThru (
+                                         &Private->Passthru,
+                                         Device->NamespaceId,
+                                         &Slot->CommandPacket,
+                                         Slot->Event
+                                         );
+      if (SubmitStatus == EFI_NOT_READY) {
+        //
+        // The asynchronous submission queue is full, reap completions first.
+        //
+        break;
+      }
+
+      if (EFI_ERROR (SubmitStatus)) {
+        Status = SubmitStatus;
+        break;
+      }
+
+      Slot->InFlight = TRUE;
+      InFlight++;
+      Blocks -= TransferBlocks;
+      Lba    += TransferBlocks;
+      Buffer  = (UINT8 *)Buffer + TransferBlocks * Device->Media.BlockSize;
+    }
+
+    if ((InFlight == 0) && ((Blocks == 0) || EFI_ERROR (Status))) {
+      break;
+    }
+
+    //
+    // Reap all the completions posted so far. Raise the TPL so that the
+    // periodic timer of the controller does not reap them at the same time.
+    //
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    ProcessAsyncTaskList (NULL, Private);
+    gBS->RestoreTPL (OldTpl);
+
+    Progress = FALSE;
+    for (Index = 0; Index < NVME_PIPELINED_IO_DEPTH; Index++) {
+      Slot = &Slots[Index];
+      if (!Slot->InFlight || EFI_ERROR (gBS->CheckEvent (Slot->Event))) {
+        continue;
+      }
+
+      Slot->InFlight = FALSE;
+      InFlight--;
+      Progress = TRUE;
+
+      Completion = (NVME_CQ *)&Slot->Completion;
+      if ((Completion->Sct != 0) || (Completion->Sc != 0)) {
+        DEBUG_CODE_BEGIN ();
+        NvmeDumpStatus (Completion);
+        DEBUG_CODE_END ();
+        if (!EFI_ERROR (Status)) {
+          Status = EFI_DEVICE_ERROR;
+        }
+      }
+    }
+
+    if (Progress) {
+      gBS->SetTimer (TimerEvent, TimerRelative, NVME_GENERIC_TIMEOUT);
+    } else if (!EFI_ERROR (gBS->CheckEvent (TimerEvent))) {
+      //
+      // Resetting the controller aborts and signals every outstanding
+      // asynchronous command, so none of the slots is in flight afterwards.
+      //
+      Status = NvmePipelinedIoRecover (Private);
+      break;
+    }
+  }
+
+Exit:
+  for (Index = 0; Index < NVME_PIPELINED_IO_DEPTH; Index++) {
+    if (Slots[Index].Event != NULL) {
+      gBS->CloseEvent (Slots[Index].Event);
+    }
+  }
+
+  if (TimerEvent != NULL) {
+    gBS->CloseEvent (TimerEvent);
+  }
+
+  FreePool (Slots);
+  return Status;
+}
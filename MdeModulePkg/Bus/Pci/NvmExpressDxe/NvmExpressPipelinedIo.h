@@ -0,0 +1,60 @@
+/** @file
+  Pipelined blocking read and write for the NVM Express namespaces.
+
+  A blocking BlockIo read or write larger than the maximum data transfer size
+  of the controller is split into several commands. Instead of waiting for each
+  of them on the one-deep blocking I/O queue, they are sent on the asynchronous
+  I/O queue with up to NVME_PIPELINED_IO_DEPTH commands in flight, and their
+  completions are reaped in batches.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef NVME_PIPELINED_IO_H_
+#define NVME_PIPELINED_IO_H_
+
+//
+// Number of read or write commands a blocking BlockIo request keeps in flight
+// on the asynchronous I/O queue. It must be less than the number of
+// asynchronous submission queue entries.
+//
+#define NVME_PIPELINED_IO_DEPTH  16
+
+/**
+  Read or write blocks with several commands in flight.
+
+  The commands are sent on the asynchronous I/O queue of the controller, so
+  nothing else may use that queue until they are done. The request is refused
+  if the queue already holds asynchronous requests, such as BlockIo2 requests.
+
+  @param[in]      Device             The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+  @param[in]      Write              TRUE to write Buffer to the device, FALSE to read it.
+  @param[in, out] Buffer             The data buffer.
+  @param[in]      Lba                The start block number.
+  @param[in]      Blocks             Total number of blocks to transfer.
+  @param[in]      MaxTransferBlocks  Maximum number of blocks of one command.
+
+  @retval EFI_SUCCESS            All the blocks were transferred.
+  @retval EFI_OUT_OF_RESOURCES   Nothing was transferred because of a lack of
+                                 resources. The caller may fall back to
+                                 sending one command at a time.
+  @retval EFI_NOT_READY          Nothing was transferred because the
+                                 asynchronous I/O queue is in use. The caller
+                                 may fall back to sending one command at a time.
+  @retval EFI_TIMEOUT            A command timed out and the controller was reset.
+  @retval Others                 Failed to transfer all the blocks.
+
+**/
+EFI_STATUS
+NvmePipelinedReadWrite (
+  IN     NVME_DEVICE_PRIVATE_DATA  *Device,
+  IN     BOOLEAN                   Write,
+  IN OUT VOID                      *Buffer,
+  IN     UINT64                    Lba,
+  IN     UINTN                     Blocks,
+  IN     UINT32                    MaxTransferBlocks
+  );
+
+#endif
@@ -0,0 +1,507 @@
+/** @file -- DmaUnitTest.c
+  Host based unit tests of the PRP list pool and the data buffer mapping cache
+  of NvmExpressDxe.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../NvmExpress.h"
+
+#define UNIT_TEST_NAME     "NVM Express DMA Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Buffers at or above this address are mapped through a bounce buffer.
+//
+#define TEST_BOUNCE_OFFSET  0x100000000ULL
+
+///
+/// Calls made to the emulated PCI I/O protocol.
+///
+typedef struct {
+  UINTN      AllocateBufferCalls;
+  UINTN      FreeBufferCalls;
+  UINTN      MapCalls;
+  UINTN      UnmapCalls;
+  UINTN      NextMapping;
+  BOOLEAN    Bounce;
+  BOOLEAN    IoMmu;
+} EMULATED_PCI_IO;
+
+STATIC EMULATED_PCI_IO               mEmulatedPciIo;
+STATIC EFI_PCI_IO_PROTOCOL           mPciIo;
+STATIC EFI_BOOT_SERVICES             mBootServices;
+STATIC NVME_CONTROLLER_PRIVATE_DATA  mPrivate;
+
+EFI_BOOT_SERVICES  *gBS = &mBootServices;
+
+EFI_STATUS
+EFIAPI
+EmulatedAllocateBuffer (
+  IN  EFI_PCI_IO_PROTOCOL  *This,
+  IN  EFI_ALLOCATE_TYPE    Type,
+  IN  EFI_MEMORY_TYPE      MemoryType,
+  IN  UINTN                Pages,
+  OUT VOID                 **HostAddress,
+  IN  UINT64               Attributes
+  )
+{
+  mEmulatedPciIo.AllocateBufferCalls++;
+  *HostAddress = AllocateAlignedPages (Pages, EFI_PAGE_SIZE);
+  return (*HostAddress == NULL) ? EFI_OUT_OF_RESOURCES : EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedFreeBuffer (
+  IN  EFI_PCI_IO_PROTOCOL  *This,
+  IN  UINTN                Pages,
+  IN  VOID                 *HostAddress
+  )
+{
+  mEmulatedPciIo.FreeBufferCalls++;
+  FreeAlignedPages (HostAddress, Pages);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedMap (
+  IN     EFI_PCI_IO_PROTOCOL            *This,
+  IN     EFI_PCI_IO_PROTOCOL_OPERATION  Operation,
+  IN     VOID                           *HostAddress,
+  IN OUT UINTN                          *NumberOfBytes,
+  OUT    EFI_PHYSICAL_ADDRESS           *DeviceAddress,
+  OUT    VOID                           **Mapping
+  )
+{
+  mEmulatedPciIo.MapCalls++;
+  *DeviceAddress = (EFI_PHYSICAL_ADDRESS)(UINTN)HostAddress;
+  if (mEmulatedPciIo.Bounce && (Operation != EfiPciIoOperationBusMasterCommonBuffer)) {
+    *DeviceAddress += TEST_BOUNCE_OFFSET;
+  }
+
+  *Mapping = (VOID *)++mEmulatedPciIo.NextMapping;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedUnmap (
+  IN  EFI_PCI_IO_PROTOCOL  *This,
+  IN  VOID                 *Mapping
+  )
+{
+  mEmulatedPciIo.UnmapCalls++;
+  return EFI_SUCCESS;
+}
+
+EFI_TPL
+EFIAPI
+EmulatedRaiseTpl (
+  IN EFI_TPL  NewTpl
+  )
+{
+  return TPL_APPLICATION;
+}
+
+VOID
+EFIAPI
+EmulatedRestoreTpl (
+  IN EFI_TPL  OldTpl
+  )
+{
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedLocateProtocol (
+  IN  EFI_GUID  *Protocol,
+  IN  VOID      *Registration OPTIONAL,
+  OUT VOID      **Interface
+  )
+{
+  if (CompareGuid (Protocol, &gEdkiiIoMmuProtocolGuid) && mEmulatedPciIo.IoMmu) {
+    *Interface = &mEmulatedPciIo;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Create an event group triggered when the boot manager is about to boot.
+  No event is needed by the tests.
+
+  @param[in]  NotifyTpl         Not used.
+  @param[in]  NotifyFunction    Not used.
+  @param[in]  NotifyContext     Not used.
+  @param[out] ReadyToBootEvent  Returns NULL.
+
+  @retval EFI_SUCCESS  Always.
+
+**/
+EFI_STATUS
+EFIAPI
+EfiCreateEventReadyToBootEx (
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction  OPTIONAL,
+  IN  VOID              *NotifyContext  OPTIONAL,
+  OUT EFI_EVENT         *ReadyToBootEvent
+  )
+{
+  *ReadyToBootEvent = NULL;
+  return EFI_SUCCESS;
+}
+
+/**
+  Reset the emulated PCI I/O protocol and boot services, and create a
+  controller without an IOMMU.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED  Always.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+DmaTestSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ZeroMem (&mEmulatedPciIo, sizeof (mEmulatedPciIo));
+
+  ZeroMem (&mPciIo, sizeof (mPciIo));
+  mPciIo.AllocateBuffer = EmulatedAllocateBuffer;
+  mPciIo.FreeBuffer     = EmulatedFreeBuffer;
+  mPciIo.Map            = EmulatedMap;
+  mPciIo.Unmap          = EmulatedUnmap;
+
+  ZeroMem (&mBootServices, sizeof (mBootServices));
+  mBootServices.RaiseTPL       = EmulatedRaiseTpl;
+  mBootServices.RestoreTPL     = EmulatedRestoreTpl;
+  mBootServices.LocateProtocol = EmulatedLocateProtocol;
+
+  ZeroMem (&mPrivate, sizeof (mPrivate));
+  mPrivate.Signature = NVME_CONTROLLER_PRIVATE_DATA_SIGNATURE;
+  mPrivate.PciIo     = &mPciIo;
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  PRP lists of consecutive commands come from the pool, which is allocated
+  and mapped once.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The pool was reused.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PrpListPoolReuse (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  VOID                  *Host;
+  EFI_PHYSICAL_ADDRESS  PciAddress;
+  VOID                  *Mapping;
+  UINTN                 Index;
+  EFI_STATUS            Status;
+
+  NvmeDmaInitialize (&mPrivate);
+  UT_ASSERT_NOT_NULL (mPrivate.Dma.PrpPool);
+
+  for (Index = 0; Index < 100; Index++) {
+    Status = NvmeDmaAllocatePrpList (&mPrivate, 1 + Index % 3, &Host, &PciAddress, &Mapping);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_EQUAL (Mapping, NULL);
+    UT_ASSERT_EQUAL (PciAddress, (UINTN)Host);
+    UT_ASSERT_EQUAL ((UINTN)Host & EFI_PAGE_MASK, 0);
+    NvmeDmaFreePrpList (&mPrivate, 1 + Index % 3, Host, Mapping);
+  }
+
+  UT_ASSERT_EQUAL (mPrivate.Dma.PrpPoolBusy, 0);
+  UT_ASSERT_EQUAL (mPrivate.Dma.Statistics.PrpListAllocationsAvoided, 100);
+  UT_ASSERT_EQUAL (mPrivate.Dma.Statistics.PrpListAllocations, 0);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.AllocateBufferCalls, 1);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.MapCalls, 1);
+
+  NvmeDmaCleanup (&mPrivate);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.FreeBufferCalls, 1);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.UnmapCalls, 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  PRP lists are allocated per command once the pool is used up, and the pool
+  pages are given out in consecutive runs.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The fallback and the pool both worked.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PrpListPoolExhausted (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  VOID                  *Host[NVME_PRP_POOL_PAGES + 1];
+  VOID                  *Mapping[NVME_PRP_POOL_PAGES + 1];
+  EFI_PHYSICAL_ADDRESS  PciAddress;
+  VOID                  *Run;
+  VOID                  *RunMapping;
+  UINTN                 Index;
+  EFI_STATUS            Status;
+
+  NvmeDmaInitialize (&mPrivate);
+
+  for (Index = 0; Index <= NVME_PRP_POOL_PAGES; Index++) {
+    Status = NvmeDmaAllocatePrpList (&mPrivate, 1, &Host[Index], &PciAddress, &Mapping[Index]);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  UT_ASSERT_EQUAL (mPrivate.Dma.Statistics.PrpListAllocationsAvoided, NVME_PRP_POOL_PAGES);
+  UT_ASSERT_EQUAL (mPrivate.Dma.Statistics.PrpListAllocations, 1);
+  UT_ASSERT_NOT_NULL (Mapping[NVME_PRP_POOL_PAGES]);
+
+  //
+  // Free every other pool page: no run of two pages is free.
+  //
+  for (Index = 0; Index < NVME_PRP_POOL_PAGES; Index += 2) {
+    NvmeDmaFreePrpList (&mPrivate, 1, Host[Index], Mapping[Index]);
+  }
+
+  Status = NvmeDmaAllocatePrpList (&mPrivate, 2, &Run, &PciAddress, &RunMapping);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_NOT_NULL (RunMapping);
+  NvmeDmaFreePrpList (&mPrivate, 2, Run, RunMapping);
+
+  NvmeDmaFreePrpList (&mPrivate, 1, Host[1], Mapping[1]);
+  Status = NvmeDmaAllocatePrpList (&mPrivate, 3, &Run, &PciAddress, &RunMapping);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (RunMapping, NULL);
+  UT_ASSERT_EQUAL (Run, mPrivate.Dma.PrpPool);
+  NvmeDmaFreePrpList (&mPrivate, 3, Run, RunMapping);
+
+  for (Index = 3; Index <= NVME_PRP_POOL_PAGES; Index += 2) {
+    NvmeDmaFreePrpList (&mPrivate, 1, Host[Index], Mapping[Index]);
+  }
+
+  NvmeDmaFreePrpList (&mPrivate, 1, Host[NVME_PRP_POOL_PAGES], Mapping[NVME_PRP_POOL_PAGES]);
+  UT_ASSERT_EQUAL (mPrivate.Dma.PrpPoolBusy, 0);
+
+  NvmeDmaCleanup (&mPrivate);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.FreeBufferCalls, mEmulatedPciIo.AllocateBufferCalls);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.UnmapCalls, mEmulatedPciIo.MapCalls);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Data buffers that are mapped again reuse the kept mapping, and the least
+  recently used mapping is unmapped to make room.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The mappings were reused.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+DataMapCacheReuse (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8                 *Buffer;
+  UINTN                 Bytes;
+  EFI_PHYSICAL_ADDRESS  DeviceAddress;
+  VOID                  *Mapping;
+  UINTN                 Index;
+  UINTN                 MapCalls;
+  EFI_STATUS            Status;
+
+  NvmeDmaInitialize (&mPrivate);
+  UT_ASSERT_TRUE (mPrivate.Dma.KeepMappings);
+
+  Buffer   = AllocatePool (SIZE_64KB);
+  MapCalls = mEmulatedPciIo.MapCalls;
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  for (Index = 0; Index < 10; Index++) {
+    Bytes  = SIZE_4KB;
+    Status = NvmeDmaMap (&mPrivate, EfiPciIoOperationBusMasterWrite, Buffer, &Bytes, &DeviceAddress, &Mapping);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_EQUAL (Mapping, NULL);
+    UT_ASSERT_EQUAL (DeviceAddress, (UINTN)Buffer);
+  }
+
+  UT_ASSERT_EQUAL (mEmulatedPciIo.MapCalls - MapCalls, 1);
+  UT_ASSERT_EQUAL (mPrivate.Dma.Statistics.DataMaps, 1);
+  UT_ASSERT_EQUAL (mPrivate.Dma.Statistics.DataMapsAvoided, 9);
+
+  //
+  // A part of a kept mapping is served by it, a different direction is not.
+  //
+  Bytes  = 512;
+  Status = NvmeDmaMap (&mPrivate, EfiPciIoOperationBusMasterWrite, Buffer + 1024, &Bytes, &DeviceAddress, &Mapping);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (DeviceAddress, (UINTN)Buffer + 1024);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.MapCalls - MapCalls, 1);
+
+  Bytes  = 512;
+  Status = NvmeDmaMap (&mPrivate, EfiPciIoOperationBusMasterRead, Buffer, &Bytes, &DeviceAddress, &Mapping);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.MapCalls - MapCalls, 2);
+
+  //
+  // Filling the cache with other buffers unmaps the least recently used.
+  //
+  for (Index = 1; Index < NVME_DMA_MAP_CACHE_SIZE; Index++) {
+    Bytes  = SIZE_4KB;
+    Status = NvmeDmaMap (&mPrivate, EfiPciIoOperationBusMasterRead, Buffer + Index * SIZE_4KB, &Bytes, &DeviceAddress, &Mapping);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  UT_ASSERT_EQUAL (mEmulatedPciIo.UnmapCalls, 1);
+
+  Bytes  = SIZE_4KB;
+  Status = NvmeDmaMap (&mPrivate, EfiPciIoOperationBusMasterWrite, Buffer, &Bytes, &DeviceAddress, &Mapping);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.MapCalls - MapCalls, 2 + NVME_DMA_MAP_CACHE_SIZE);
+
+  NvmeDmaCleanup (&mPrivate);
+  UT_ASSERT_EQUAL (mEmulatedPciIo.UnmapCalls, mEmulatedPciIo.MapCalls);
+
+  FreePool (Buffer);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Mappings through a bounce buffer, or made while an IOMMU is present, are
+  never kept.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             No mapping was kept.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+DataMapNotKept (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8                 Buffer[512];
+  UINTN                 Bytes;
+  EFI_PHYSICAL_ADDRESS  DeviceAddress;
+  VOID                  *Mapping;
+  UINTN                 Pass;
+  UINTN                 Index;
+  EFI_STATUS            Status;
+
+  for (Pass = 0; Pass < 2; Pass++) {
+    DmaTestSetup (NULL);
+    mEmulatedPciIo.Bounce = (BOOLEAN)(Pass == 0);
+    mEmulatedPciIo.IoMmu  = (BOOLEAN)(Pass == 1);
+    NvmeDmaInitialize (&mPrivate);
+
+    for (Index = 0; Index < 4; Index++) {
+      Bytes  = sizeof (Buffer);
+      Status = NvmeDmaMap (&mPrivate, EfiPciIoOperationBusMasterWrite, Buffer, &Bytes, &DeviceAddress, &Mapping);
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_NOT_NULL (Mapping);
+      mPciIo.Unmap (&mPciIo, Mapping);
+    }
+
+    UT_ASSERT_EQUAL (mPrivate.Dma.Statistics.DataMaps, 4);
+    UT_ASSERT_EQUAL (mPrivate.Dma.Statistics.DataMapsAvoided, 0);
+
+    NvmeDmaCleanup (&mPrivate);
+    UT_ASSERT_EQUAL (mEmulatedPciIo.UnmapCalls, mEmulatedPciIo.MapCalls);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the DMA
+  resources of NvmExpressDxe and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+DmaUnitTestEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      DmaTestSuite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &DmaTestSuite,
+             Framework,
+             "NVM Express DMA Test Suite",
+             "Nvm.Express.Dma",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for DmaTestSuite. Status = %r\n", Status));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (DmaTestSuite, "PRP lists come from the pool", "PrpListPoolReuse", PrpListPoolReuse, DmaTestSetup, NULL, NULL);
+  AddTestCase (DmaTestSuite, "PRP lists are allocated when the pool is used up", "PrpListPoolExhausted", PrpListPoolExhausted, DmaTestSetup, NULL, NULL);
+  AddTestCase (DmaTestSuite, "Data buffer mappings are reused", "DataMapCacheReuse", DataMapCacheReuse, DmaTestSetup, NULL, NULL);
+  AddTestCase (DmaTestSuite, "Bounce and IOMMU mappings are not kept", "DataMapNotKept", DataMapNotKept, DmaTestSetup, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return DmaUnitTestEntry ();
+}
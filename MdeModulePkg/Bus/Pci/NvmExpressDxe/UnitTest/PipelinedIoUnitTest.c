@@ -0,0 +1,929 @@
+/** @file -- PipelinedIoUnitTest.c
+  Host based unit tests of the pipelined blocking read and write of
+  NvmExpressDxe, against an emulated controller.
+
+  The emulated controller keeps a virtual clock. Every command costs a fixed
+  access latency, which overlaps between commands in flight, plus the time to
+  move its data over a link that only serves one command at a time. A blocking
+  command advances the clock until it completes; a command on the asynchronous
+  queue completes when the clock reaches its completion time, which happens
+  when the driver reaps completions. The throughput figures are in virtual
+  time, so they do not depend on the machine running the test.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../NvmExpress.h"
+
+#define UNIT_TEST_NAME     "NVM Express Pipelined I/O Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+#define TEST_BLOCK_SIZE           512
+#define TEST_MAX_TRANSFER_BLOCKS  256                                  // 128 KiB commands
+#define TEST_READ_SIZE            SIZE_64MB
+#define TEST_LBA                  0x1000
+
+//
+// Emulated controller timing, in 100 ns units like the UEFI timers.
+//
+#define TEST_ACCESS_LATENCY       800                                  // 80 us per command
+#define TEST_LINK_BYTES_PER_TICK  320                                  // 3.2 GB/s
+#define TEST_POLL_INTERVAL        10                                   // 1 us per poll that finds nothing
+
+///
+/// A command posted to the asynchronous queue of the emulated controller.
+///
+typedef struct {
+  BOOLEAN                                     InUse;
+  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET    *Packet;
+  EFI_EVENT                                   Event;
+  UINT64                                      CompleteAt;
+} EMULATED_COMMAND;
+
+///
+/// A boot services event.
+///
+typedef struct {
+  UINT32     Type;
+  BOOLEAN    Signaled;
+  BOOLEAN    Armed;
+  UINT64     TriggerTime;
+} EMULATED_EVENT;
+
+///
+/// State of the emulated controller.
+///
+typedef struct {
+  UINT64              Clock;
+  UINT64              LinkFreeAt;
+  UINTN               AsyncQueueSize;
+  EMULATED_COMMAND    Pending[NVME_ASYNC_CSQ_SIZE];
+  UINTN               PendingCount;
+  UINTN               MaxPendingCount;
+  UINTN               Commands;
+  UINTN               BadCommands;
+  UINTN               DataErrors;
+  UINTN               FailCommand;
+  BOOLEAN             Hang;
+  UINTN               ControllerResets;
+} EMULATED_CONTROLLER;
+
+STATIC EMULATED_CONTROLLER  mController;
+STATIC EFI_BOOT_SERVICES    mBootServices;
+
+EFI_BOOT_SERVICES  *gBS = &mBootServices;
+
+/**
+  Get the test pattern of the 64-bit word at a byte offset of the namespace.
+
+  @param[in] Offset  Byte offset of the word.
+
+  @return The pattern.
+
+**/
+STATIC
+UINT64
+TestPattern (
+  IN UINT64  Offset
+  )
+{
+  return (Offset >> 3) ^ 0x5A5AA5A5C3C33C3CULL;
+}
+
+/**
+  Fill a buffer with the test pattern of the blocks it is read from.
+
+  @param[out] Buffer  The buffer.
+  @param[in]  Lba     The first block.
+  @param[in]  Size    Size of the buffer in bytes.
+
+**/
+STATIC
+VOID
+TestFillPattern (
+  OUT VOID    *Buffer,
+  IN  UINT64  Lba,
+  IN  UINTN   Size
+  )
+{
+  UINT64  *Word;
+  UINTN   Index;
+
+  Word = Buffer;
+  for (Index = 0; Index < Size / sizeof (UINT64); Index++) {
+    Word[Index] = TestPattern (Lba * TEST_BLOCK_SIZE + Index * sizeof (UINT64));
+  }
+}
+
+/**
+  Count the words of a buffer that do not match the test pattern.
+
+  @param[in] Buffer  The buffer.
+  @param[in] Lba     The first block.
+  @param[in] Size    Size of the buffer in bytes.
+
+  @return Number of mismatching words.
+
+**/
+STATIC
+UINTN
+TestCheckPattern (
+  IN VOID    *Buffer,
+  IN UINT64  Lba,
+  IN UINTN   Size
+  )
+{
+  UINT64  *Word;
+  UINTN   Index;
+  UINTN   Errors;
+
+  Word   = Buffer;
+  Errors = 0;
+  for (Index = 0; Index < Size / sizeof (UINT64); Index++) {
+    if (Word[Index] != TestPattern (Lba * TEST_BLOCK_SIZE + Index * sizeof (UINT64))) {
+      Errors++;
+    }
+  }
+
+  return Errors;
+}
+
+/**
+  Move the data of a read or write command, as the controller would.
+
+  @param[in, out] Packet  The command packet.
+
+**/
+STATIC
+VOID
+EmulatedTransfer (
+  IN OUT EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET  *Packet
+  )
+{
+  UINT64  Lba;
+  UINTN   Blocks;
+
+  Lba    = LShiftU64 (Packet->NvmeCmd->Cdw11, 32) | Packet->NvmeCmd->Cdw10;
+  Blocks = (Packet->NvmeCmd->Cdw12 & 0xFFFF) + 1;
+
+  if ((Blocks > TEST_MAX_TRANSFER_BLOCKS) ||
+      (Packet->TransferLength != Blocks * TEST_BLOCK_SIZE) ||
+      (Packet->QueueType != NVME_IO_QUEUE))
+  {
+    mController.BadCommands++;
+    return;
+  }
+
+  if (Packet->NvmeCmd->Cdw0.Opcode == NVME_IO_READ_OPC) {
+    TestFillPattern (Packet->TransferBuffer, Lba, Packet->TransferLength);
+  } else if (Packet->NvmeCmd->Cdw0.Opcode == NVME_IO_WRITE_OPC) {
+    if ((Packet->NvmeCmd->Cdw12 & BIT30) == 0) {
+      mController.BadCommands++;
+    }
+
+    mController.DataErrors += TestCheckPattern (Packet->TransferBuffer, Lba, Packet->TransferLength);
+  } else {
+    mController.BadCommands++;
+  }
+}
+
+/**
+  Get the time a command posted now completes, and occupy the link for it.
+
+  @param[in] Bytes  Size of the data of the command.
+
+  @return The completion time.
+
+**/
+STATIC
+UINT64
+EmulatedSchedule (
+  IN UINT32  Bytes
+  )
+{
+  UINT64  Start;
+
+  Start                  = MAX (mController.Clock + TEST_ACCESS_LATENCY, mController.LinkFreeAt);
+  mController.LinkFreeAt = Start + Bytes / TEST_LINK_BYTES_PER_TICK;
+  return mController.LinkFreeAt;
+}
+
+/**
+  Complete a command, with an error if it is the one selected to fail.
+
+  @param[in, out] Packet  The command packet.
+
+**/
+STATIC
+VOID
+EmulatedComplete (
+  IN OUT EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET  *Packet
+  )
+{
+  NVME_CQ  *Cq;
+
+  EmulatedTransfer (Packet);
+
+  mController.Commands++;
+  Cq = (NVME_CQ *)Packet->NvmeCompletion;
+  ZeroMem (Cq, sizeof (EFI_NVM_EXPRESS_COMPLETION));
+  if (mController.Commands == mController.FailCommand) {
+    Cq->Sct = NVME_CQE_SCT_MEDIA_DATA_INTEGRITY_ERRORS_STATUS;
+    Cq->Sc  = 0x81;                                                   // Unrecovered Read Error
+  }
+}
+
+/**
+  PassThru() of the emulated controller.
+
+  @param[in]     This         The EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL instance.
+  @param[in]     NamespaceId  The namespace of the command.
+  @param[in,out] Packet       The command packet.
+  @param[in]     Event        NULL for a blocking command, otherwise the
+                              event to signal when the command completes.
+
+  @retval EFI_SUCCESS    The command was completed or posted.
+  @retval EFI_NOT_READY  The asynchronous queue is full.
+
+**/
+EFI_STATUS
+EFIAPI
+EmulatedPassThru (
+  IN     EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL        *This,
+  IN     UINT32                                    NamespaceId,
+  IN OUT EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET  *Packet,
+  IN     EFI_EVENT                                 Event OPTIONAL
+  )
+{
+  UINTN  Index;
+
+  if (Event == NULL) {
+    mController.Clock = EmulatedSchedule (Packet->TransferLength);
+    EmulatedComplete (Packet);
+    return EFI_SUCCESS;
+  }
+
+  if (mController.PendingCount >= mController.AsyncQueueSize) {
+    return EFI_NOT_READY;
+  }
+
+  for (Index = 0; mController.Pending[Index].InUse; Index++) {
+  }
+
+  mController.Pending[Index].InUse      = TRUE;
+  mController.Pending[Index].Packet     = Packet;
+  mController.Pending[Index].Event      = Event;
+  mController.Pending[Index].CompleteAt = EmulatedSchedule (Packet->TransferLength);
+  mController.PendingCount++;
+  mController.MaxPendingCount = MAX (mController.MaxPendingCount, mController.PendingCount);
+  return EFI_SUCCESS;
+}
+
+/**
+  Reap the completions of the asynchronous queue of the emulated controller.
+
+  If no command has completed yet, the clock moves to the next completion,
+  which stands for the time the driver spends polling the completion queue.
+
+  @param[in]  Event     Not used.
+  @param[in]  Context   Not used.
+
+**/
+VOID
+EFIAPI
+ProcessAsyncTaskList (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  UINTN   Index;
+  UINT64  Next;
+
+  Next = MAX_UINT64;
+  for (Index = 0; Index < ARRAY_SIZE (mController.Pending); Index++) {
+    if (mController.Pending[Index].InUse) {
+      Next = MIN (Next, mController.Pending[Index].CompleteAt);
+    }
+  }
+
+  if (mController.Hang || (Next == MAX_UINT64)) {
+    mController.Clock += TEST_POLL_INTERVAL;
+    return;
+  }
+
+  mController.Clock = MAX (mController.Clock, Next);
+  for (Index = 0; Index < ARRAY_SIZE (mController.Pending); Index++) {
+    if (mController.Pending[Index].InUse && (mController.Pending[Index].CompleteAt <= mController.Clock)) {
+      EmulatedComplete (mController.Pending[Index].Packet);
+      mController.Pending[Index].InUse = FALSE;
+      mController.PendingCount--;
+      gBS->SignalEvent (mController.Pending[Index].Event);
+    }
+  }
+}
+
+/**
+  Reset the emulated controller.
+
+  @param[in] Private  Not used.
+
+  @retval EFI_SUCCESS  Always.
+
+**/
+EFI_STATUS
+NvmeControllerInit (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  )
+{
+  mController.ControllerResets++;
+  mController.Hang = FALSE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Abort the commands posted to the asynchronous queue, signaling their events
+  without completing them.
+
+  @param[in] Private  Not used.
+
+  @retval EFI_SUCCESS  Always.
+
+**/
+EFI_STATUS
+AbortAsyncPassThruTasks (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < ARRAY_SIZE (mController.Pending); Index++) {
+    if (mController.Pending[Index].InUse) {
+      mController.Pending[Index].InUse = FALSE;
+      mController.PendingCount--;
+      gBS->SignalEvent (mController.Pending[Index].Event);
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Dump the execution status from a given completion queue entry.
+
+  @param[in]     Cq               A pointer to the NVME_CQ item.
+
+**/
+VOID
+NvmeDumpStatus (
+  IN NVME_CQ  *Cq
+  )
+{
+  UT_LOG_INFO ("Completion Sct = 0x%x, Sc = 0x%x\n", Cq->Sct, Cq->Sc);
+}
+
+EFI_TPL
+EFIAPI
+EmulatedRaiseTpl (
+  IN EFI_TPL  NewTpl
+  )
+{
+  return TPL_APPLICATION;
+}
+
+VOID
+EFIAPI
+EmulatedRestoreTpl (
+  IN EFI_TPL  OldTpl
+  )
+{
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedCreateEvent (
+  IN  UINT32            Type,
+  IN  EFI_TPL           NotifyTpl,
+  IN  EFI_EVENT_NOTIFY  NotifyFunction OPTIONAL,
+  IN  VOID              *NotifyContext OPTIONAL,
+  OUT EFI_EVENT         *Event
+  )
+{
+  EMULATED_EVENT  *NewEvent;
+
+  NewEvent = AllocateZeroPool (sizeof (EMULATED_EVENT));
+  if (NewEvent == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  NewEvent->Type = Type;
+  *Event         = NewEvent;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedCloseEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  FreePool (Event);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedSignalEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  ((EMULATED_EVENT *)Event)->Signaled = TRUE;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedCheckEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  EMULATED_EVENT  *EmulatedEvent;
+
+  EmulatedEvent = Event;
+  if (EmulatedEvent->Armed && (mController.Clock >= EmulatedEvent->TriggerTime)) {
+    EmulatedEvent->Armed    = FALSE;
+    EmulatedEvent->Signaled = TRUE;
+  }
+
+  if (!EmulatedEvent->Signaled) {
+    return EFI_NOT_READY;
+  }
+
+  EmulatedEvent->Signaled = FALSE;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedSetTimer (
+  IN EFI_EVENT        Event,
+  IN EFI_TIMER_DELAY  Type,
+  IN UINT64           TriggerTime
+  )
+{
+  EMULATED_EVENT  *EmulatedEvent;
+
+  //
+  // Only the relative timers of the pipelined requests are emulated. The
+  // periodic timer of the controller is not, as the tests reap on their own.
+  //
+  if (Event == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  EmulatedEvent              = Event;
+  EmulatedEvent->Armed       = (BOOLEAN)(Type == TimerRelative);
+  EmulatedEvent->TriggerTime = mController.Clock + TriggerTime;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+EmulatedStall (
+  IN UINTN  Microseconds
+  )
+{
+  mController.Clock += MultU64x32 (Microseconds, 10);
+  return EFI_SUCCESS;
+}
+
+/**
+  Reset the emulated controller and the emulated boot services.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED  Always.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PipelinedIoSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ZeroMem (&mController, sizeof (mController));
+  mController.AsyncQueueSize = NVME_ASYNC_CSQ_SIZE;
+
+  ZeroMem (&mBootServices, sizeof (mBootServices));
+  mBootServices.RaiseTPL    = EmulatedRaiseTpl;
+  mBootServices.RestoreTPL  = EmulatedRestoreTpl;
+  mBootServices.CreateEvent = EmulatedCreateEvent;
+  mBootServices.CloseEvent  = EmulatedCloseEvent;
+  mBootServices.SignalEvent = EmulatedSignalEvent;
+  mBootServices.CheckEvent  = EmulatedCheckEvent;
+  mBootServices.SetTimer    = EmulatedSetTimer;
+  mBootServices.Stall       = EmulatedStall;
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Create a namespace on the emulated controller.
+
+  @return The namespace, or NULL.
+
+**/
+STATIC
+NVME_DEVICE_PRIVATE_DATA *
+CreateDevice (
+  VOID
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA  *Private;
+  NVME_DEVICE_PRIVATE_DATA      *Device;
+
+  Private = AllocateZeroPool (sizeof (NVME_CONTROLLER_PRIVATE_DATA));
+  Device  = AllocateZeroPool (sizeof (NVME_DEVICE_PRIVATE_DATA));
+  if ((Private == NULL) || (Device == NULL)) {
+    return NULL;
+  }
+
+  Private->Signature         = NVME_CONTROLLER_PRIVATE_DATA_SIGNATURE;
+  Private->Passthru.PassThru = EmulatedPassThru;
+  InitializeListHead (&Private->AsyncPassThruQueue);
+  InitializeListHead (&Private->UnsubmittedSubtasks);
+
+  Device->Signature       = NVME_DEVICE_PRIVATE_DATA_SIGNATURE;
+  Device->NamespaceId     = 1;
+  Device->Controller      = Private;
+  Device->Media.BlockSize = TEST_BLOCK_SIZE;
+  Device->Media.LastBlock = TEST_LBA + TEST_READ_SIZE / TEST_BLOCK_SIZE;
+
+  return Device;
+}
+
+/**
+  Free a namespace created by CreateDevice().
+
+  @param[in] Device  The namespace.
+
+**/
+STATIC
+VOID
+DestroyDevice (
+  IN NVME_DEVICE_PRIVATE_DATA  *Device
+  )
+{
+  FreePool (Device->Controller);
+  FreePool (Device);
+}
+
+/**
+  Get a throughput in MiB/s.
+
+  @param[in] Bytes  Bytes transferred.
+  @param[in] Ticks  Virtual time taken, in 100 ns units.
+
+  @return The throughput.
+
+**/
+STATIC
+UINT64
+Throughput (
+  IN UINT64  Bytes,
+  IN UINT64  Ticks
+  )
+{
+  return DivU64x64Remainder (MultU64x32 (Bytes, 10000000), MultU64x32 (Ticks, SIZE_1MB), NULL);
+}
+
+/**
+  Read 64 MiB one command at a time, as ReadSectors() does, and then with the
+  pipelined read, and compare the throughput.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The pipelined read is correct and faster.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PipelinedRead64MiB (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA                  *Device;
+  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET  Packet;
+  EFI_NVM_EXPRESS_COMMAND                   Command;
+  EFI_NVM_EXPRESS_COMPLETION                Completion;
+  UINT8                                     *Buffer;
+  UINT64                                    Lba;
+  UINTN                                     Offset;
+  UINT64                                    SerialTicks;
+  UINT64                                    PipelinedTicks;
+  EFI_STATUS                                Status;
+
+  Device = CreateDevice ();
+  Buffer = AllocatePool (TEST_READ_SIZE);
+  UT_ASSERT_NOT_NULL (Device);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  //
+  // One command at a time.
+  //
+  for (Offset = 0; Offset < TEST_READ_SIZE; Offset += TEST_MAX_TRANSFER_BLOCKS * TEST_BLOCK_SIZE) {
+    Lba = TEST_LBA + Offset / TEST_BLOCK_SIZE;
+    ZeroMem (&Packet, sizeof (Packet));
+    ZeroMem (&Command, sizeof (Command));
+    Packet.NvmeCmd        = &Command;
+    Packet.NvmeCompletion = &Completion;
+    Packet.TransferBuffer = Buffer + Offset;
+    Packet.TransferLength = TEST_MAX_TRANSFER_BLOCKS * TEST_BLOCK_SIZE;
+    Packet.QueueType      = NVME_IO_QUEUE;
+    Command.Cdw0.Opcode   = NVME_IO_READ_OPC;
+    Command.Cdw10         = (UINT32)Lba;
+    Command.Cdw11         = (UINT32)RShiftU64 (Lba, 32);
+    Command.Cdw12         = TEST_MAX_TRANSFER_BLOCKS - 1;
+    Status                = EmulatedPassThru (&Device->Controller->Passthru, Device->NamespaceId, &Packet, NULL);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  SerialTicks = mController.Clock;
+  UT_ASSERT_EQUAL (TestCheckPattern (Buffer, TEST_LBA, TEST_READ_SIZE), 0);
+
+  //
+  // Pipelined.
+  //
+  SetMem (Buffer, TEST_READ_SIZE, 0xAF);
+  mController.Clock      = 0;
+  mController.LinkFreeAt = 0;
+  Status                 = NvmePipelinedReadWrite (
+                             Device,
+                             FALSE,
+                             Buffer,
+                             TEST_LBA,
+                             TEST_READ_SIZE / TEST_BLOCK_SIZE,
+                             TEST_MAX_TRANSFER_BLOCKS
+                             );
+  PipelinedTicks = mController.Clock;
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mController.BadCommands, 0);
+  UT_ASSERT_EQUAL (mController.PendingCount, 0);
+  UT_ASSERT_EQUAL (mController.MaxPendingCount, NVME_PIPELINED_IO_DEPTH);
+  UT_ASSERT_EQUAL (TestCheckPattern (Buffer, TEST_LBA, TEST_READ_SIZE), 0);
+
+  UT_LOG_INFO (
+    "64 MiB read: one command at a time %ld MiB/s, pipelined %ld MiB/s\n",
+    Throughput (TEST_READ_SIZE, SerialTicks),
+    Throughput (TEST_READ_SIZE, PipelinedTicks)
+    );
+
+  //
+  // With the access latency hidden, the read is bound by the link.
+  //
+  UT_ASSERT_TRUE (PipelinedTicks * 2 < SerialTicks);
+
+  FreePool (Buffer);
+  DestroyDevice (Device);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Write a transfer that does not end on a command boundary, with a queue
+  shallower than the pipeline.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The data reached the controller intact.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PipelinedWriteQueueFull (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA  *Device;
+  UINT8                     *Buffer;
+  UINTN                     Blocks;
+  EFI_STATUS                Status;
+
+  Device = CreateDevice ();
+  Blocks = 10 * TEST_MAX_TRANSFER_BLOCKS + 7;
+  Buffer = AllocatePool (Blocks * TEST_BLOCK_SIZE);
+  UT_ASSERT_NOT_NULL (Device);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  TestFillPattern (Buffer, TEST_LBA, Blocks * TEST_BLOCK_SIZE);
+  mController.AsyncQueueSize = 3;
+
+  Status = NvmePipelinedReadWrite (Device, TRUE, Buffer, TEST_LBA, Blocks, TEST_MAX_TRANSFER_BLOCKS);
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mController.Commands, 11);
+  UT_ASSERT_EQUAL (mController.BadCommands, 0);
+  UT_ASSERT_EQUAL (mController.DataErrors, 0);
+  UT_ASSERT_EQUAL (mController.MaxPendingCount, 3);
+
+  FreePool (Buffer);
+  DestroyDevice (Device);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Fail one command in the middle of a read.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The read failed, and no command was left
+                                       in flight.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PipelinedReadDeviceError (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA  *Device;
+  UINT8                     *Buffer;
+  UINTN                     Blocks;
+  EFI_STATUS                Status;
+
+  Device = CreateDevice ();
+  Blocks = 64 * TEST_MAX_TRANSFER_BLOCKS;
+  Buffer = AllocatePool (Blocks * TEST_BLOCK_SIZE);
+  UT_ASSERT_NOT_NULL (Device);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  mController.FailCommand = 20;
+
+  Status = NvmePipelinedReadWrite (Device, FALSE, Buffer, TEST_LBA, Blocks, TEST_MAX_TRANSFER_BLOCKS);
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_EQUAL (mController.PendingCount, 0);
+  UT_ASSERT_TRUE (mController.Commands < 64);
+
+  FreePool (Buffer);
+  DestroyDevice (Device);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Stop the controller in the middle of a read.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The read timed out and the controller
+                                       was reset.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PipelinedReadTimeout (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA  *Device;
+  UINT8                     *Buffer;
+  UINTN                     Blocks;
+  EFI_STATUS                Status;
+
+  Device = CreateDevice ();
+  Blocks = 64 * TEST_MAX_TRANSFER_BLOCKS;
+  Buffer = AllocatePool (Blocks * TEST_BLOCK_SIZE);
+  UT_ASSERT_NOT_NULL (Device);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  mController.Hang = TRUE;
+
+  Status = NvmePipelinedReadWrite (Device, FALSE, Buffer, TEST_LBA, Blocks, TEST_MAX_TRANSFER_BLOCKS);
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_TIMEOUT);
+  UT_ASSERT_EQUAL (mController.ControllerResets, 1);
+  UT_ASSERT_EQUAL (mController.PendingCount, 0);
+  UT_ASSERT_TRUE (mController.Clock >= NVME_GENERIC_TIMEOUT);
+
+  FreePool (Buffer);
+  DestroyDevice (Device);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Read while a BlockIo2 request is queued on the asynchronous queue.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The read was refused without sending a
+                                       command.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PipelinedReadAsyncQueueBusy (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA  *Device;
+  UINT8                     *Buffer;
+  UINTN                     Blocks;
+  LIST_ENTRY                Subtask;
+  EFI_STATUS                Status;
+
+  Device = CreateDevice ();
+  Blocks = 64 * TEST_MAX_TRANSFER_BLOCKS;
+  Buffer = AllocatePool (Blocks * TEST_BLOCK_SIZE);
+  UT_ASSERT_NOT_NULL (Device);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  InsertTailList (&Device->Controller->UnsubmittedSubtasks, &Subtask);
+
+  Status = NvmePipelinedReadWrite (Device, FALSE, Buffer, TEST_LBA, Blocks, TEST_MAX_TRANSFER_BLOCKS);
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_READY);
+  UT_ASSERT_EQUAL (mController.Commands, 0);
+
+  FreePool (Buffer);
+  DestroyDevice (Device);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the pipelined
+  I/O of NvmExpressDxe and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+PipelinedIoUnitTestEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      PipelinedIoTestSuite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &PipelinedIoTestSuite,
+             Framework,
+             "NVM Express Pipelined I/O Test Suite",
+             "Nvm.Express.PipelinedIo",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for PipelinedIoTestSuite. Status = %r\n", Status));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (PipelinedIoTestSuite, "Read 64 MiB, one command at a time and pipelined", "Read64MiB", PipelinedRead64MiB, PipelinedIoSetup, NULL, NULL);
+  AddTestCase (PipelinedIoTestSuite, "Write with a full asynchronous queue", "WriteQueueFull", PipelinedWriteQueueFull, PipelinedIoSetup, NULL, NULL);
+  AddTestCase (PipelinedIoTestSuite, "Read with a failing command", "ReadDeviceError", PipelinedReadDeviceError, PipelinedIoSetup, NULL, NULL);
+  AddTestCase (PipelinedIoTestSuite, "Read from a controller that stops", "ReadTimeout", PipelinedReadTimeout, PipelinedIoSetup, NULL, NULL);
+  AddTestCase (PipelinedIoTestSuite, "Read while the asynchronous queue is busy", "ReadAsyncQueueBusy", PipelinedReadAsyncQueueBusy, PipelinedIoSetup, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return PipelinedIoUnitTestEntry ();
+}
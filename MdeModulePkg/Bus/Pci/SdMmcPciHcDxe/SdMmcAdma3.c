@@ -0,0 +1,915 @@
+/** @file
+  Queuing of several requests to the SD/MMC host controller with ADMA3.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "SdMmcPciHcDxe.h"
+
+/**
+  Initialize the ADMA3 state of a controller.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+
+**/
+VOID
+SdMmcAdma3Initialize (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private
+  )
+{
+  ZeroMem (&Private->Adma3, sizeof (SD_MMC_ADMA3_CONTEXT));
+  Private->Adma3.Depth = (UINT8)MIN (PcdGet8 (PcdSdMmcAdma3QueueDepth), SD_MMC_ADMA3_MAX_DEPTH);
+}
+
+/**
+  Check if the requests of a slot can be queued with ADMA3.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Slot     The slot number.
+
+  @retval TRUE   The requests of the slot can be queued.
+  @retval FALSE  Otherwise.
+
+**/
+BOOLEAN
+SdMmcAdma3Supported (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT8                   Slot
+  )
+{
+  return (BOOLEAN)((Private->Adma3.Depth > 1) &&
+                   (Private->ControllerVersion[Slot] >= SD_MMC_HC_CTRL_VER_410) &&
+                   (Private->Capability[Slot].Adma2 != 0) &&
+                   (Private->Capability[Slot].Adma3 != 0));
+}
+
+/**
+  Check if a TRB is a block read or write that can be part of a batch.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Trb      The pointer to the SD_MMC_HC_TRB instance.
+
+  @retval TRUE   The TRB can be part of a batch.
+  @retval FALSE  Otherwise.
+
+**/
+STATIC
+BOOLEAN
+SdMmcAdma3IsDataTrb (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN SD_MMC_HC_TRB           *Trb
+  )
+{
+  EFI_SD_MMC_COMMAND_BLOCK  *CmdBlk;
+
+  if (Trb->Started || Trb->Adma3Fallback) {
+    return FALSE;
+  }
+
+  if ((Trb->Mode != SdMmcAdma32bMode) && (Trb->Mode != SdMmcAdma64bV4Mode)) {
+    return FALSE;
+  }
+
+  if ((Trb->BlockSize == 0) || ((Trb->DataLen % Trb->BlockSize) != 0)) {
+    return FALSE;
+  }
+
+  CmdBlk = Trb->Packet->SdMmcCmdBlk;
+  if ((CmdBlk->CommandType != SdMmcCommandTypeAdtc) || (CmdBlk->ResponseType != SdMmcResponseTypeR1)) {
+    return FALSE;
+  }
+
+  if (Private->Slot[Trb->Slot].CardType == EmmcCardType) {
+    return (BOOLEAN)((CmdBlk->CommandIndex == EMMC_READ_SINGLE_BLOCK) ||
+                     (CmdBlk->CommandIndex == EMMC_READ_MULTIPLE_BLOCK) ||
+                     (CmdBlk->CommandIndex == EMMC_WRITE_BLOCK) ||
+                     (CmdBlk->CommandIndex == EMMC_WRITE_MULTIPLE_BLOCK));
+  }
+
+  if (Private->Slot[Trb->Slot].CardType == SdCardType) {
+    return (BOOLEAN)((CmdBlk->CommandIndex == SD_READ_SINGLE_BLOCK) ||
+                     (CmdBlk->CommandIndex == SD_READ_MULTIPLE_BLOCK) ||
+                     (CmdBlk->CommandIndex == SD_WRITE_SINGLE_BLOCK) ||
+                     (CmdBlk->CommandIndex == SD_WRITE_MULTIPLE_BLOCK));
+  }
+
+  return FALSE;
+}
+
+/**
+  Check if a TRB is a SET_BLOCK_COUNT of an eMMC device that the host
+  controller can send as the Auto CMD23 of the next TRB.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Trb      The pointer to the SD_MMC_HC_TRB instance.
+  @param[in] NextTrb  The pointer to the next TRB of the queue.
+
+  @retval TRUE   The TRB can be folded into the next one.
+  @retval FALSE  Otherwise.
+
+**/
+STATIC
+BOOLEAN
+SdMmcAdma3IsAutoCmd23 (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN SD_MMC_HC_TRB           *Trb,
+  IN SD_MMC_HC_TRB           *NextTrb
+  )
+{
+  EFI_SD_MMC_COMMAND_BLOCK  *CmdBlk;
+  EFI_SD_MMC_COMMAND_BLOCK  *NextCmdBlk;
+
+  if (Trb->Started || Trb->Adma3Fallback || (Trb->Mode != SdMmcNoData)) {
+    return FALSE;
+  }
+
+  if ((Private->Slot[Trb->Slot].CardType != EmmcCardType) || (NextTrb->Slot != Trb->Slot)) {
+    return FALSE;
+  }
+
+  CmdBlk = Trb->Packet->SdMmcCmdBlk;
+  if ((CmdBlk->CommandIndex != EMMC_SET_BLOCK_COUNT) || (CmdBlk->ResponseType != SdMmcResponseTypeR1)) {
+    return FALSE;
+  }
+
+  if (!SdMmcAdma3IsDataTrb (Private, NextTrb)) {
+    return FALSE;
+  }
+
+  //
+  // The Auto CMD23 argument is the 32-bit Block Count, so the flags of the
+  // argument, such as reliable write, cannot be sent.
+  //
+  NextCmdBlk = NextTrb->Packet->SdMmcCmdBlk;
+  return (BOOLEAN)(((NextCmdBlk->CommandIndex == EMMC_READ_MULTIPLE_BLOCK) ||
+                    (NextCmdBlk->CommandIndex == EMMC_WRITE_MULTIPLE_BLOCK)) &&
+                   (CmdBlk->CommandArgument == NextTrb->DataLen / NextTrb->BlockSize));
+}
+
+/**
+  Find the TRBs at the head of the queue that can be started together.
+
+  The TRBs are taken in order, up to the first one that cannot be part of the
+  batch. A multiple block read or write of an eMMC device must follow its
+  SET_BLOCK_COUNT.
+
+  @param[in]  Private   A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[out] Commands  The number of commands of the batch.
+
+  @return The number of TRBs of the batch.
+
+**/
+UINT32
+SdMmcAdma3CollectTrbs (
+  IN  SD_MMC_HC_PRIVATE_DATA  *Private,
+  OUT UINT32                  *Commands
+  )
+{
+  LIST_ENTRY     *Link;
+  LIST_ENTRY     *NextLink;
+  SD_MMC_HC_TRB  *Trb;
+  SD_MMC_HC_TRB  *NextTrb;
+  UINT8          Slot;
+  UINT32         Trbs;
+
+  Trbs      = 0;
+  *Commands = 0;
+
+  Link = GetFirstNode (&Private->Queue);
+  if (IsNull (&Private->Queue, Link)) {
+    return 0;
+  }
+
+  Trb  = SD_MMC_HC_TRB_FROM_THIS (Link);
+  Slot = Trb->Slot;
+
+  while (!IsNull (&Private->Queue, Link) && (*Commands < Private->Adma3.Depth)) {
+    Trb = SD_MMC_HC_TRB_FROM_THIS (Link);
+    if (Trb->Slot != Slot) {
+      break;
+    }
+
+    NextLink = GetNextNode (&Private->Queue, Link);
+    if (!IsNull (&Private->Queue, NextLink)) {
+      NextTrb = SD_MMC_HC_TRB_FROM_THIS (NextLink);
+      if (SdMmcAdma3IsAutoCmd23 (Private, Trb, NextTrb)) {
+        Trbs     += 2;
+        Link      = GetNextNode (&Private->Queue, NextLink);
+        *Commands = *Commands + 1;
+        continue;
+      }
+    }
+
+    if (!SdMmcAdma3IsDataTrb (Private, Trb)) {
+      break;
+    }
+
+    //
+    // An eMMC multiple block transfer without SET_BLOCK_COUNT is open-ended
+    // and needs a STOP_TRANSMISSION that is not part of the request.
+    //
+    if ((Private->Slot[Slot].CardType == EmmcCardType) && ((Trb->DataLen / Trb->BlockSize) > 1)) {
+      break;
+    }
+
+    Trbs     += 1;
+    Link      = NextLink;
+    *Commands = *Commands + 1;
+  }
+
+  return Trbs;
+}
+
+/**
+  Return the number of lines of the ADMA2 descriptor table of a TRB.
+
+  @param[in] Trb       The pointer to the SD_MMC_HC_TRB instance.
+  @param[in] DescSize  The size of an ADMA2 descriptor line.
+
+  @return The number of lines, up to the one that ends the table.
+
+**/
+STATIC
+UINTN
+SdMmcAdma3Adma2Lines (
+  IN SD_MMC_HC_TRB  *Trb,
+  IN UINTN          DescSize
+  )
+{
+  UINT8                        *Line;
+  UINTN                        Lines;
+  SD_MMC_HC_ADMA_32_DESC_LINE  *Adma2;
+
+  if (Trb->Mode == SdMmcAdma32bMode) {
+    Line = (UINT8 *)Trb->Adma32Desc;
+  } else {
+    Line = (UINT8 *)Trb->Adma64V4Desc;
+  }
+
+  //
+  // The lines of both addressing modes start with the same attribute field.
+  //
+  for (Lines = 1; ; Lines++, Line += DescSize) {
+    Adma2 = (SD_MMC_HC_ADMA_32_DESC_LINE *)Line;
+    if (Adma2->End != 0) {
+      return Lines;
+    }
+  }
+}
+
+/**
+  Write an entry of an ADMA3 command descriptor.
+
+  @param[in] Entry  The entry.
+  @param[in] End    TRUE for the last entry of the command descriptor.
+  @param[in] Data   The value of the register that the entry sets.
+
+**/
+STATIC
+VOID
+SdMmcAdma3WriteCmdEntry (
+  IN SD_MMC_HC_ADMA3_CMD_DESC_LINE  *Entry,
+  IN BOOLEAN                        End,
+  IN UINT32                         Data
+  )
+{
+  ZeroMem (Entry, sizeof (SD_MMC_HC_ADMA3_CMD_DESC_LINE));
+  Entry->Attr.Valid = 1;
+  Entry->Attr.End   = End ? 1 : 0;
+  Entry->Attr.Act   = SD_MMC_ADMA3_ACT_CMD;
+  Entry->Data       = Data;
+}
+
+/**
+  Write a line of the ADMA3 integrated descriptor table.
+
+  @param[in] Line      The line.
+  @param[in] End       TRUE for the last line of the table.
+  @param[in] Address   The address of the command descriptor of the line.
+  @param[in] LineSize  The size of an integrated descriptor line.
+
+**/
+STATIC
+VOID
+SdMmcAdma3WriteIntegratedLine (
+  IN UINT8    *Line,
+  IN BOOLEAN  End,
+  IN UINT64   Address,
+  IN UINTN    LineSize
+  )
+{
+  SD_MMC_HC_ADMA3_INTEGRATED_32_DESC_LINE  *Line32;
+  SD_MMC_HC_ADMA3_INTEGRATED_64_DESC_LINE  *Line64;
+
+  ZeroMem (Line, LineSize);
+  if (LineSize == sizeof (SD_MMC_HC_ADMA3_INTEGRATED_32_DESC_LINE)) {
+    Line32             = (SD_MMC_HC_ADMA3_INTEGRATED_32_DESC_LINE *)Line;
+    Line32->Attr.Valid = 1;
+    Line32->Attr.End   = End ? 1 : 0;
+    Line32->Attr.Act   = SD_MMC_ADMA3_ACT_INTEGRATED;
+    Line32->Address    = (UINT32)Address;
+  } else {
+    Line64               = (SD_MMC_HC_ADMA3_INTEGRATED_64_DESC_LINE *)Line;
+    Line64->Attr.Valid   = 1;
+    Line64->Attr.End     = End ? 1 : 0;
+    Line64->Attr.Act     = SD_MMC_ADMA3_ACT_INTEGRATED;
+    Line64->LowerAddress = (UINT32)Address;
+    Line64->UpperAddress = (UINT32)RShiftU64 (Address, 32);
+  }
+}
+
+/**
+  Build the descriptors of a batch: the integrated descriptor table, then the
+  command descriptor of each command followed by its ADMA2 descriptor table.
+
+  The entries of the command descriptors are 64-bit. The lines of the
+  integrated descriptor table have the size of the ADMA2 descriptor lines of
+  the addressing mode.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Trbs     The number of TRBs of the batch at the head of the queue.
+
+  @retval EFI_SUCCESS           The descriptors were built.
+  @retval EFI_OUT_OF_RESOURCES  The descriptors could not be allocated.
+  @retval EFI_DEVICE_ERROR      The descriptors are out of reach of the host controller.
+
+**/
+EFI_STATUS
+SdMmcAdma3BuildDescTable (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT32                  Trbs
+  )
+{
+  SD_MMC_ADMA3_CONTEXT           *Adma3;
+  EFI_PCI_IO_PROTOCOL            *PciIo;
+  LIST_ENTRY                     *Link;
+  SD_MMC_HC_TRB                  *Trb;
+  UINT32                         Index;
+  UINT32                         Commands;
+  UINT32                         Command;
+  UINTN                          DescSize;
+  UINTN                          Adma2Lines;
+  UINTN                          TableSize;
+  UINTN                          Bytes;
+  UINT8                          *Integrated;
+  UINT8                          *Line;
+  UINT8                          *Adma2Desc;
+  SD_MMC_HC_ADMA3_CMD_DESC_LINE  *CmdDesc;
+  UINT32                         BlkCount;
+  UINT16                         TransMode;
+  UINT16                         Cmd;
+  BOOLEAN                        AutoCmd23;
+  EFI_STATUS                     Status;
+
+  Adma3 = &Private->Adma3;
+  PciIo = Private->PciIo;
+
+  //
+  // The TRBs of a batch are all of the same slot, so of the same addressing
+  // mode.
+  //
+  DescSize  = sizeof (SD_MMC_HC_ADMA_32_DESC_LINE);
+  TableSize = 0;
+  Commands  = 0;
+
+  //
+  // Size the descriptors.
+  //
+  Link = GetFirstNode (&Private->Queue);
+  for (Index = 0; Index < Trbs; Index++, Link = GetNextNode (&Private->Queue, Link)) {
+    Trb = SD_MMC_HC_TRB_FROM_THIS (Link);
+    if (Trb->Mode == SdMmcNoData) {
+      continue;
+    }
+
+    if (Trb->Mode == SdMmcAdma64bV4Mode) {
+      DescSize = sizeof (SD_MMC_HC_ADMA_64_V4_DESC_LINE);
+    }
+
+    Commands++;
+    TableSize += SD_MMC_ADMA3_CMD_DESC_ENTRIES * sizeof (SD_MMC_HC_ADMA3_CMD_DESC_LINE) +
+                 SdMmcAdma3Adma2Lines (Trb, DescSize) * DescSize;
+  }
+
+  TableSize       += Commands * DescSize;
+  Adma3->DescPages = EFI_SIZE_TO_PAGES (TableSize);
+  Status           = PciIo->AllocateBuffer (
+                              PciIo,
+                              AllocateAnyPages,
+                              EfiBootServicesData,
+                              Adma3->DescPages,
+                              &Adma3->Desc,
+                              0
+                              );
+  if (EFI_ERROR (Status)) {
+    Adma3->Desc = NULL;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (Adma3->Desc, TableSize);
+  Bytes  = TableSize;
+  Status = PciIo->Map (
+                    PciIo,
+                    EfiPciIoOperationBusMasterCommonBuffer,
+                    Adma3->Desc,
+                    &Bytes,
+                    &Adma3->DescPhy,
+                    &Adma3->DescMap
+                    );
+  if (EFI_ERROR (Status) || (Bytes != TableSize)) {
+    if (!EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, Adma3->DescMap);
+    }
+
+    PciIo->FreeBuffer (PciIo, Adma3->DescPages, Adma3->Desc);
+    Adma3->Desc    = NULL;
+    Adma3->DescMap = NULL;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if ((DescSize == sizeof (SD_MMC_HC_ADMA_32_DESC_LINE)) &&
+      ((Adma3->DescPhy + TableSize) > 0x100000000ul))
+  {
+    SdMmcAdma3FreeDescTable (Private);
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // The integrated descriptor table comes first, one line per command.
+  //
+  Integrated = (UINT8 *)Adma3->Desc;
+  Line       = Integrated + Commands * DescSize;
+  Command    = 0;
+  AutoCmd23  = FALSE;
+
+  Link = GetFirstNode (&Private->Queue);
+  for (Index = 0; Index < Trbs; Index++, Link = GetNextNode (&Private->Queue, Link)) {
+    Trb = SD_MMC_HC_TRB_FROM_THIS (Link);
+    if (Trb->Mode == SdMmcNoData) {
+      AutoCmd23 = TRUE;
+      continue;
+    }
+
+    SdMmcAdma3WriteIntegratedLine (
+      Integrated + Command * DescSize,
+      (BOOLEAN)(Command == Commands - 1),
+      Adma3->DescPhy + (UINTN)(Line - Integrated),
+      DescSize
+      );
+
+    //
+    // The host controller checks the R1 response of the command, and raises
+    // no Command Complete for it.
+    //
+    BlkCount  = Trb->DataLen / Trb->BlockSize;
+    TransMode = BIT8 | BIT7 | BIT0;
+    if (Trb->Read) {
+      TransMode |= BIT4;
+    }
+
+    if (BlkCount > 1) {
+      TransMode |= BIT5 | BIT1;
+      if (AutoCmd23) {
+        TransMode |= BIT3;
+      } else if (Private->Slot[Trb->Slot].CardType == SdCardType) {
+        TransMode |= BIT2;
+      }
+    }
+
+    Cmd = (UINT16)((Trb->Packet->SdMmcCmdBlk->CommandIndex << 8) | BIT5 | BIT4 | BIT3 | BIT1);
+
+    CmdDesc = (SD_MMC_HC_ADMA3_CMD_DESC_LINE *)Line;
+    SdMmcAdma3WriteCmdEntry (&CmdDesc[0], FALSE, BlkCount);
+    SdMmcAdma3WriteCmdEntry (&CmdDesc[1], FALSE, Trb->BlockSize);
+    SdMmcAdma3WriteCmdEntry (&CmdDesc[2], FALSE, Trb->Packet->SdMmcCmdBlk->CommandArgument);
+    SdMmcAdma3WriteCmdEntry (&CmdDesc[3], TRUE, TransMode | ((UINT32)Cmd << 16));
+    Line += SD_MMC_ADMA3_CMD_DESC_ENTRIES * sizeof (SD_MMC_HC_ADMA3_CMD_DESC_LINE);
+
+    //
+    // The ADMA2 descriptor table of the TRB holds the addresses of its data,
+    // so it is used as is.
+    //
+    if (Trb->Mode == SdMmcAdma32bMode) {
+      Adma2Desc = (UINT8 *)Trb->Adma32Desc;
+    } else {
+      Adma2Desc = (UINT8 *)Trb->Adma64V4Desc;
+    }
+
+    Adma2Lines = SdMmcAdma3Adma2Lines (Trb, DescSize);
+    CopyMem (Line, Adma2Desc, Adma2Lines * DescSize);
+    Line += Adma2Lines * DescSize;
+
+    AutoCmd23 = FALSE;
+    Command++;
+  }
+
+  //
+  // Raise the DMA interrupt once the data of the last command is moved.
+  //
+  ((SD_MMC_HC_ADMA_32_DESC_LINE *)(Line - DescSize))->Int = 1;
+
+  Adma3->Commands = Commands;
+  return EFI_SUCCESS;
+}
+
+/**
+  Free the descriptors of the batch in flight.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+
+**/
+VOID
+SdMmcAdma3FreeDescTable (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private
+  )
+{
+  SD_MMC_ADMA3_CONTEXT  *Adma3;
+  EFI_PCI_IO_PROTOCOL   *PciIo;
+
+  Adma3 = &Private->Adma3;
+  PciIo = Private->PciIo;
+
+  if (Adma3->DescMap != NULL) {
+    PciIo->Unmap (PciIo, Adma3->DescMap);
+    Adma3->DescMap = NULL;
+  }
+
+  if (Adma3->Desc != NULL) {
+    PciIo->FreeBuffer (PciIo, Adma3->DescPages, Adma3->Desc);
+    Adma3->Desc = NULL;
+  }
+}
+
+/**
+  Start the batch whose descriptors were built.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Slot     The slot number.
+
+  @retval EFI_SUCCESS  The batch was started.
+  @retval Others       The registers of the host controller could not be set.
+
+**/
+STATIC
+EFI_STATUS
+SdMmcAdma3Start (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT8                   Slot
+  )
+{
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  EFI_STATUS           Status;
+  UINT16               IntStatus;
+  UINT8                HostCtrl1;
+  UINT64               IdAddr;
+
+  PciIo = Private->PciIo;
+
+  IntStatus = 0xFFFF;
+  Status    = SdMmcHcRwMmio (PciIo, Slot, SD_MMC_HC_ERR_INT_STS, FALSE, sizeof (IntStatus), &IntStatus);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  IntStatus = 0xFF3F;
+  Status    = SdMmcHcRwMmio (PciIo, Slot, SD_MMC_HC_NOR_INT_STS, FALSE, sizeof (IntStatus), &IntStatus);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // DMA Select 11b selects ADMA3 when Host Version 4 is enabled.
+  //
+  HostCtrl1 = BIT4 | BIT3;
+  Status    = SdMmcHcOrMmio (PciIo, Slot, SD_MMC_HC_HOST_CTRL1, sizeof (HostCtrl1), &HostCtrl1);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  SdMmcHcLedOnOff (PciIo, Slot, TRUE);
+
+  IdAddr = Private->Adma3.DescPhy;
+  if (Private->Capability[Slot].SysBus64V4 != 0) {
+    Status = SdMmcHcRwMmio (PciIo, Slot, SD_MMC_HC_ADMA3_ID_ADDR, FALSE, sizeof (IdAddr), &IdAddr);
+  } else {
+    Status = SdMmcHcRwMmio (PciIo, Slot, SD_MMC_HC_ADMA3_ID_ADDR, FALSE, sizeof (UINT32), &IdAddr);
+  }
+
+  return Status;
+}
+
+/**
+  Check the result of the batch in flight.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Slot     The slot number.
+
+  @retval EFI_SUCCESS    All the commands of the batch are done.
+  @retval EFI_NOT_READY  The batch is still running.
+  @retval Others         The batch failed and the host controller was recovered.
+
+**/
+STATIC
+EFI_STATUS
+SdMmcAdma3CheckResult (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT8                   Slot
+  )
+{
+  EFI_STATUS  Status;
+  UINT16      IntStatus;
+
+  Status = SdMmcHcRwMmio (Private->PciIo, Slot, SD_MMC_HC_NOR_INT_STS, TRUE, sizeof (IntStatus), &IntStatus);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = SdMmcCheckAndRecoverErrors (Private, Slot, IntStatus);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // The last ADMA2 descriptor raises the DMA interrupt, and the Transfer
+  // Complete of the last command follows.
+  //
+  if ((IntStatus & (BIT3 | BIT1)) != (BIT3 | BIT1)) {
+    return EFI_NOT_READY;
+  }
+
+  IntStatus = BIT3 | BIT1 | BIT0;
+  return SdMmcHcRwMmio (Private->PciIo, Slot, SD_MMC_HC_NOR_INT_STS, FALSE, sizeof (IntStatus), &IntStatus);
+}
+
+/**
+  Read the response of the last command of the batch in flight, and check its
+  R1 card status.
+
+  The response registers only hold the response of the last command. The host
+  controller checked the responses of the other commands, as their Response
+  Error Check is enabled, and stopped the batch with a Response Error if one
+  of them reported an error.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+
+  @retval EFI_SUCCESS       The last command reported no error.
+  @retval EFI_DEVICE_ERROR  The card status of the last command reports an error.
+  @retval Others            The response could not be read.
+
+**/
+STATIC
+EFI_STATUS
+SdMmcAdma3CheckResponse (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private
+  )
+{
+  LIST_ENTRY     *Link;
+  SD_MMC_HC_TRB  *LastTrb;
+  UINT32         Index;
+  UINT32         CardStatus;
+  EFI_STATUS     Status;
+
+  Link = GetFirstNode (&Private->Queue);
+  for (Index = 1; Index < Private->Adma3.Trbs; Index++) {
+    Link = GetNextNode (&Private->Queue, Link);
+  }
+
+  LastTrb = SD_MMC_HC_TRB_FROM_THIS (Link);
+  Status  = SdMmcGetResponse (Private, LastTrb);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CardStatus = LastTrb->Packet->SdMmcStatusBlk->Resp0;
+  if ((CardStatus & SD_MMC_ADMA3_R1_ERRORS) != 0) {
+    DEBUG ((DEBUG_ERROR, "SdMmcAdma3: last command of the batch reports card status 0x%x\n", CardStatus));
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Complete the batch in flight.
+
+  On success, and if the card status of the last command reports no error,
+  the TRBs of the batch are completed. Otherwise they are left at the head of
+  the queue, to be executed again one at a time.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Status   The result of the batch.
+
+**/
+STATIC
+VOID
+SdMmcAdma3Complete (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN EFI_STATUS              Status
+  )
+{
+  SD_MMC_ADMA3_CONTEXT  *Adma3;
+  LIST_ENTRY            *Link;
+  SD_MMC_HC_TRB         *Trb;
+  EFI_EVENT             TrbEvent;
+  UINT32                Index;
+  UINT8                 HostCtrl1;
+
+  Adma3 = &Private->Adma3;
+
+  SdMmcHcLedOnOff (Private->PciIo, Adma3->Slot, FALSE);
+  SdMmcAdma3FreeDescTable (Private);
+
+  //
+  // Select ADMA2 again for the requests executed one at a time.
+  //
+  HostCtrl1 = (UINT8) ~BIT3;
+  SdMmcHcAndMmio (Private->PciIo, Adma3->Slot, SD_MMC_HC_HOST_CTRL1, sizeof (HostCtrl1), &HostCtrl1);
+
+  if (!EFI_ERROR (Status)) {
+    Status = SdMmcAdma3CheckResponse (Private);
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "SdMmcAdma3: batch of %d commands failed with %r, executing them one at a time\n", Adma3->Commands, Status));
+    Adma3->Statistics.Fallbacks++;
+    Link = GetFirstNode (&Private->Queue);
+    for (Index = 0; Index < Adma3->Trbs; Index++) {
+      Trb                = SD_MMC_HC_TRB_FROM_THIS (Link);
+      Trb->Started       = FALSE;
+      Trb->Adma3Fallback = TRUE;
+      Link               = GetNextNode (&Private->Queue, Link);
+    }
+
+    Adma3->Trbs = 0;
+    return;
+  }
+
+  for (Index = 0; Index < Adma3->Trbs; Index++) {
+    Link = GetFirstNode (&Private->Queue);
+    Trb  = SD_MMC_HC_TRB_FROM_THIS (Link);
+    RemoveEntryList (Link);
+    Trb->Packet->TransactionStatus = EFI_SUCCESS;
+    TrbEvent                       = Trb->Event;
+    SdMmcFreeTrb (Trb);
+    DEBUG ((DEBUG_VERBOSE, "SdMmcAdma3: Signal Event %p with %r\n", TrbEvent, EFI_SUCCESS));
+    gBS->SignalEvent (TrbEvent);
+  }
+
+  Adma3->Trbs = 0;
+}
+
+/**
+  Start or check a batch of the requests at the head of the non-blocking
+  queue, on a tick of the non-blocking timer.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+
+  @retval TRUE   The tick was used by a batch.
+  @retval FALSE  The request at the head of the queue is executed alone.
+
+**/
+BOOLEAN
+SdMmcAdma3ProcessQueue (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private
+  )
+{
+  SD_MMC_ADMA3_CONTEXT  *Adma3;
+  LIST_ENTRY            *Link;
+  SD_MMC_HC_TRB         *Trb;
+  UINT32                Trbs;
+  UINT32                Commands;
+  UINT32                Index;
+  UINT64                Timeout;
+  BOOLEAN               InfiniteWait;
+  EFI_STATUS            Status;
+
+  Adma3 = &Private->Adma3;
+
+  if (Adma3->Trbs != 0) {
+    if (!Private->Slot[Adma3->Slot].MediaPresent) {
+      Status = EFI_NO_MEDIA;
+    } else {
+      Status = SdMmcAdma3CheckResult (Private, Adma3->Slot);
+    }
+
+    if (Status == EFI_NOT_READY) {
+      if ((Adma3->Timeout == 0) || (--Adma3->Timeout != 0)) {
+        return TRUE;
+      }
+
+      //
+      // Reset the CMD and DAT lines of the timed out batch.
+      //
+      SdMmcSoftwareReset (Private, Adma3->Slot, BIT0 | BIT4);
+      Status = EFI_TIMEOUT;
+    }
+
+    SdMmcAdma3Complete (Private, Status);
+    return TRUE;
+  }
+
+  if (Adma3->Depth == 0) {
+    return FALSE;
+  }
+
+  Link = GetFirstNode (&Private->Queue);
+  if (IsNull (&Private->Queue, Link)) {
+    return FALSE;
+  }
+
+  Trb = SD_MMC_HC_TRB_FROM_THIS (Link);
+  if (Trb->Started || !Private->Slot[Trb->Slot].MediaPresent || !SdMmcAdma3Supported (Private, Trb->Slot)) {
+    return FALSE;
+  }
+
+  Trbs = SdMmcAdma3CollectTrbs (Private, &Commands);
+  if (Commands < 2) {
+    return FALSE;
+  }
+
+  //
+  // Wait for the CMD and DAT lines to be free.
+  //
+  Status = SdMmcHcCheckMmioSet (Private->PciIo, Trb->Slot, SD_MMC_HC_PRESENT_STATE, sizeof (UINT32), BIT0 | BIT1, 0);
+  if (Status == EFI_NOT_READY) {
+    return TRUE;
+  }
+
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  Status = SdMmcAdma3BuildDescTable (Private, Trbs);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  //
+  // The batch is given the sum of the timeouts of its requests, and no
+  // timeout if one of them waits forever.
+  //
+  Adma3->Slot  = Trb->Slot;
+  Timeout      = 0;
+  InfiniteWait = FALSE;
+  for (Index = 0; Index < Trbs; Index++) {
+    Trb = SD_MMC_HC_TRB_FROM_THIS (Link);
+    if (Trb->Packet->Timeout == 0) {
+      InfiniteWait = TRUE;
+    }
+
+    Timeout     += Trb->Timeout;
+    Trb->Started = TRUE;
+    Link         = GetNextNode (&Private->Queue, Link);
+  }
+
+  Adma3->Trbs    = Trbs;
+  Adma3->Timeout = InfiniteWait ? 0 : MAX (Timeout, 1);
+  Adma3->Statistics.Batches++;
+  Adma3->Statistics.Commands += Adma3->Commands;
+  if (Adma3->Commands > Adma3->Statistics.MaxCommands) {
+    Adma3->Statistics.MaxCommands = Adma3->Commands;
+  }
+
+  Status = SdMmcAdma3Start (Private, Adma3->Slot);
+  if (EFI_ERROR (Status)) {
+    SdMmcAdma3Complete (Private, Status);
+  }
+
+  return TRUE;
+}
+
+/**
+  Free the ADMA3 resources of a controller that is stopped.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+
+**/
+VOID
+SdMmcAdma3Cleanup (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private
+  )
+{
+  UINT8  HostCtrl1;
+
+  if (Private->Adma3.Trbs != 0) {
+    SdMmcHcLedOnOff (Private->PciIo, Private->Adma3.Slot, FALSE);
+    HostCtrl1 = (UINT8) ~BIT3;
+    SdMmcHcAndMmio (Private->PciIo, Private->Adma3.Slot, SD_MMC_HC_HOST_CTRL1, sizeof (HostCtrl1), &HostCtrl1);
+  }
+
+  SdMmcAdma3FreeDescTable (Private);
+  Private->Adma3.Trbs = 0;
+
+  if (Private->Adma3.Statistics.Batches != 0) {
+    DEBUG ((
+      DEBUG_INFO,
+      "SdMmcAdma3: %Lu batches, %Lu commands, at most %d in a batch, %Lu fallbacks\n",
+      Private->Adma3.Statistics.Batches,
+      Private->Adma3.Statistics.Commands,
+      Private->Adma3.Statistics.MaxCommands,
+      Private->Adma3.Statistics.Fallbacks
+      ));
+  }
+}
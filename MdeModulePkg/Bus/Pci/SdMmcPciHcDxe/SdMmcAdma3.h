@@ -0,0 +1,125 @@
+/** @file
+  Queuing of several requests to the SD/MMC host controller with ADMA3.
+
+  When PcdSdMmcAdma3QueueDepth is not zero and a slot supports ADMA3, the read
+  and write requests at the head of the non-blocking queue are started
+  together. Each request becomes a command descriptor followed by a copy of
+  its ADMA2 descriptor table, and an integrated descriptor table chains the
+  command descriptors, so the host controller issues the commands one after
+  the other without waiting for the driver. The SET_BLOCK_COUNT request that
+  EmmcDxe sends before each multiple block read or write is folded into the
+  following command as an Auto CMD23.
+
+  The host controller checks the R1 response of each command of a batch and
+  stops the batch with a Response Error when one reports an error. The driver
+  also checks the response of the last command, which the response registers
+  hold once the batch is done.
+
+  The requests of a batch complete together. When a batch fails, the host
+  controller is recovered and its requests are executed again one at a time,
+  so that each of them gets its own status.
+
+  Refer to SD Host Controller Simplified spec 4.20 Section 1.13 for details.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _SD_MMC_ADMA3_H_
+#define _SD_MMC_ADMA3_H_
+
+//
+// ADMA3 Integrated Descriptor Address register, writing it starts ADMA3.
+//
+#define SD_MMC_HC_ADMA3_ID_ADDR  0x78
+
+//
+// Maximum number of commands of a batch.
+//
+#define SD_MMC_ADMA3_MAX_DEPTH  32
+
+//
+// Act field of the ADMA3 descriptors.
+//
+#define SD_MMC_ADMA3_ACT_TRAN        4
+#define SD_MMC_ADMA3_ACT_CMD         1
+#define SD_MMC_ADMA3_ACT_INTEGRATED  7
+
+//
+// Entries of a command descriptor, in the order of the registers they set:
+// 32-bit Block Count, Block Size and 16-bit Block Count, Argument, Transfer
+// Mode and Command.
+//
+#define SD_MMC_ADMA3_CMD_DESC_ENTRIES  4
+
+//
+// Error bits of the R1 card status.
+//
+#define SD_MMC_ADMA3_R1_ERRORS  0xFDF90000
+
+///
+/// Attribute field of the ADMA3 descriptor lines.
+///
+typedef struct {
+  UINT32    Valid    : 1;
+  UINT32    End      : 1;
+  UINT32    Int      : 1;
+  UINT32    Act      : 3;
+  UINT32    Reserved : 26;
+} SD_MMC_HC_ADMA3_DESC_ATTR;
+
+///
+/// Entry of a command descriptor, 64 bits in every addressing mode.
+///
+typedef struct {
+  SD_MMC_HC_ADMA3_DESC_ATTR    Attr;
+  UINT32                       Data;
+} SD_MMC_HC_ADMA3_CMD_DESC_LINE;
+
+///
+/// Line of the integrated descriptor table for 32-bit addressing.
+///
+typedef struct {
+  SD_MMC_HC_ADMA3_DESC_ATTR    Attr;
+  UINT32                       Address;
+} SD_MMC_HC_ADMA3_INTEGRATED_32_DESC_LINE;
+
+///
+/// Line of the integrated descriptor table for 64-bit addressing, with the
+/// 128-bit size of the ADMA2 descriptor lines of Host Version 4.
+///
+typedef struct {
+  SD_MMC_HC_ADMA3_DESC_ATTR    Attr;
+  UINT32                       LowerAddress;
+  UINT32                       UpperAddress;
+  UINT32                       Reserved;
+} SD_MMC_HC_ADMA3_INTEGRATED_64_DESC_LINE;
+
+///
+/// Counters of the ADMA3 batches of a controller.
+///
+typedef struct {
+  UINT64    Batches;                  ///< Batches started.
+  UINT64    Commands;                 ///< Commands started in batches, Auto CMD23 excepted.
+  UINT64    Fallbacks;                ///< Batches that failed and were executed one request at a time.
+  UINT32    MaxCommands;              ///< Most commands of a batch.
+} SD_MMC_ADMA3_STATISTICS;
+
+///
+/// ADMA3 state of a controller. One batch is in flight at a time.
+///
+typedef struct {
+  UINT8                      Depth;             ///< Most commands of a batch, 0 if ADMA3 is disabled.
+  UINT8                      Slot;              ///< Slot of the batch in flight.
+  UINT32                     Trbs;              ///< TRBs of the batch at the head of the queue, 0 if none.
+  UINT32                     Commands;          ///< Commands of the batch in flight.
+  UINT64                     Timeout;           ///< Timer ticks left to the batch, 0 to wait forever.
+  VOID                       *Desc;             ///< Descriptors of the batch in flight.
+  EFI_PHYSICAL_ADDRESS       DescPhy;
+  VOID                       *DescMap;
+  UINTN                      DescPages;
+  SD_MMC_ADMA3_STATISTICS    Statistics;
+} SD_MMC_ADMA3_CONTEXT;
+
+#endif
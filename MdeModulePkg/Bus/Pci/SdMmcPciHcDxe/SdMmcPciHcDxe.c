@@ -164,6 +164,13 @@ ProcessAsyncTaskList (
 
   Private = (SD_MMC_HC_PRIVATE_DATA *)Context;
 
+  // MU_CHANGE [BEGIN] - Queue requests with ADMA3
+  if (SdMmcAdma3ProcessQueue (Private)) {
+    return;
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Check if the first entry in the async I/O queue is done or not.
   //
@@ -269,6 +276,12 @@ SdMmcPciHcEnumerateDevice (
         // Signal all async task events at the slot with EFI_NO_MEDIA status.
         //
         OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+        // MU_CHANGE [BEGIN] - Queue requests with ADMA3
+        if ((Private->Adma3.Trbs != 0) && (Private->Adma3.Slot == Slot)) {
+          SdMmcAdma3Cleanup (Private);
+        }
+
+        // MU_CHANGE [END]
         for (Link = GetFirstNode (&Private->Queue);
              !IsNull (&Private->Queue, Link);
              Link = NextLink)
@@ -618,6 +631,7 @@ SdMmcPciHcDriverBindingStart (
   Private->PciIo            = PciIo;
   Private->PciAttributes    = PciAttributes;
   InitializeListHead (&Private->Queue);
+  SdMmcAdma3Initialize (Private); // MU_CHANGE - Queue requests with ADMA3
 
   //
   // Get SD/MMC Pci Host Controller Slot info
@@ -964,6 +978,7 @@ SdMmcPciHcDriverBindingStop (
   // As the timer is closed, there is no needs to use TPL lock to
   // protect the critical region "queue".
   //
+  SdMmcAdma3Cleanup (Private); // MU_CHANGE - Queue requests with ADMA3
   for (Link = GetFirstNode (&Private->Queue);
        !IsNull (&Private->Queue, Link);
        Link = NextLink)
@@ -1451,6 +1466,8 @@ SdMmcPassThruResetDevice (
   //
   OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
 
+  SdMmcAdma3Cleanup (Private); // MU_CHANGE - Queue requests with ADMA3
+
   for (Link = GetFirstNode (&Private->Queue);
        !IsNull (&Private->Queue, Link);
        Link = NextLink)
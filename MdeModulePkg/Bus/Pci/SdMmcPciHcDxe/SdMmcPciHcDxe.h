@@ -36,6 +36,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Protocol/SdMmcPassThru.h>
 
 #include "SdMmcPciHci.h"
+#include "SdMmcAdma3.h" // MU_CHANGE - Queue requests with ADMA3
 
 extern EFI_COMPONENT_NAME_PROTOCOL   gSdMmcPciHcComponentName;
 extern EFI_COMPONENT_NAME2_PROTOCOL  gSdMmcPciHcComponentName2;
@@ -122,6 +123,8 @@ typedef struct {
   // value stored in Capabilities Register 1.
   //
   UINT32                           BaseClkFreq[SD_MMC_HC_MAX_SLOT];
+
+  SD_MMC_ADMA3_CONTEXT             Adma3; // MU_CHANGE - Queue requests with ADMA3
 } SD_MMC_HC_PRIVATE_DATA;
 
 typedef struct {
@@ -170,6 +173,13 @@ typedef struct {
   VOID                                   *AdmaMap;
   UINT32                                 AdmaPages;
 
+  // MU_CHANGE [BEGIN] - Queue requests with ADMA3
+  //
+  // Set when the batch the TRB was part of failed, so that it is executed alone.
+  //
+  BOOLEAN                                Adma3Fallback;
+  // MU_CHANGE [END]
+
   SD_MMC_HC_PRIVATE_DATA                 *Private;
 } SD_MMC_HC_TRB;
 
@@ -866,4 +876,159 @@ SdMmcHcInitHost (
   IN UINT8                   Slot
   );
 
+// MU_CHANGE [BEGIN] - Queue requests with ADMA3
+
+/**
+  Performs SW reset based on passed error status mask.
+
+  @param[in]  Private       Pointer to driver private data.
+  @param[in]  Slot          Index of the slot to reset.
+  @param[in]  ErrIntStatus  Error interrupt status mask.
+
+  @retval EFI_SUCCESS  Software reset performed successfully.
+  @retval Other        Software reset failed.
+**/
+EFI_STATUS
+SdMmcSoftwareReset (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT8                   Slot,
+  IN UINT16                  ErrIntStatus
+  );
+
+/**
+  Checks the error status in error status register
+  and issues appropriate software reset as described in
+  SD specification section 3.10.
+
+  @param[in] Private    Pointer to driver private data.
+  @param[in] Slot       Index of the slot for device.
+  @param[in] IntStatus  Normal interrupt status mask.
+
+  @retval EFI_CRC_ERROR  CRC error happened during CMD execution.
+  @retval EFI_SUCCESS    No error reported.
+  @retval Others         Some other error happened.
+
+**/
+EFI_STATUS
+SdMmcCheckAndRecoverErrors (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT8                   Slot,
+  IN UINT16                  IntStatus
+  );
+
+/**
+  Reads the response data into the TRB buffer.
+  This function assumes that caller made sure that
+  command has completed.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Trb      The pointer to the SD_MMC_HC_TRB instance.
+
+  @retval EFI_SUCCESS  Response read successfully.
+  @retval Others       Failed to get response.
+**/
+EFI_STATUS
+SdMmcGetResponse (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN SD_MMC_HC_TRB           *Trb
+  );
+
+/**
+  Initialize the ADMA3 state of a controller.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+
+**/
+VOID
+SdMmcAdma3Initialize (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private
+  );
+
+/**
+  Check if the requests of a slot can be queued with ADMA3.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Slot     The slot number.
+
+  @retval TRUE   The requests of the slot can be queued.
+  @retval FALSE  Otherwise.
+
+**/
+BOOLEAN
+SdMmcAdma3Supported (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT8                   Slot
+  );
+
+/**
+  Find the TRBs at the head of the queue that can be started together.
+
+  @param[in]  Private   A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[out] Commands  The number of commands of the batch.
+
+  @return The number of TRBs of the batch.
+
+**/
+UINT32
+SdMmcAdma3CollectTrbs (
+  IN  SD_MMC_HC_PRIVATE_DATA  *Private,
+  OUT UINT32                  *Commands
+  );
+
+/**
+  Build the descriptors of a batch.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Trbs     The number of TRBs of the batch at the head of the queue.
+
+  @retval EFI_SUCCESS           The descriptors were built.
+  @retval EFI_OUT_OF_RESOURCES  The descriptors could not be allocated.
+  @retval EFI_DEVICE_ERROR      The descriptors are out of reach of the host controller.
+
+**/
+EFI_STATUS
+SdMmcAdma3BuildDescTable (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT32                  Trbs
+  );
+
+/**
+  Free the descriptors of the batch in flight.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+
+**/
+VOID
+SdMmcAdma3FreeDescTable (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private
+  );
+
+/**
+  Start or check a batch of the requests at the head of the non-blocking
+  queue, on a tick of the non-blocking timer.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+
+  @retval TRUE   The tick was used by a batch.
+  @retval FALSE  The request at the head of the queue is executed alone.
+
+**/
+BOOLEAN
+SdMmcAdma3ProcessQueue (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private
+  );
+
+/**
+  Free the ADMA3 resources of a controller that is stopped.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+
+**/
+VOID
+SdMmcAdma3Cleanup (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private
+  );
+
+// MU_CHANGE [END]
+
 #endif
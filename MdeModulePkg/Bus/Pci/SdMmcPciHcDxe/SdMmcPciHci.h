@@ -184,7 +184,11 @@ typedef struct {
   UINT32    TuningSDR50   : 1; // bit 45
   UINT32    RetuningMod   : 2; // bit 46:47
   UINT32    ClkMultiplier : 8; // bit 48:55
-  UINT32    Reserved5     : 7; // bit 56:62
+  // MU_CHANGE [BEGIN] - Queue requests with ADMA3
+  UINT32    Reserved5     : 3; // bit 56:58
+  UINT32    Adma3         : 1; // bit 59
+  UINT32    Reserved6     : 3; // bit 60:62
+  // MU_CHANGE [END]
   UINT32    Hs400         : 1; // bit 63
 } SD_MMC_HC_SLOT_CAP;
 
@@ -607,4 +611,56 @@ SdMmcSetDriverStrength (
   IN SD_DRIVER_STRENGTH_TYPE  DriverStrength
   );
 
+// MU_CHANGE [BEGIN] - Queue requests with ADMA3
+
+/**
+  Check the value of the specified MMIO register against the test value.
+
+  @param[in]  PciIo         The PCI IO protocol instance.
+  @param[in]  BarIndex      The BAR index of the standard PCI Configuration
+                            header to use as the base address for the memory
+                            operation to perform.
+  @param[in]  Offset        The offset within the selected BAR to start the
+                            memory operation.
+  @param[in]  Count         The width of the mmio register in bytes.
+                            Must be 1, 2, 4 or 8 bytes.
+  @param[in]  MaskValue     The mask value of memory.
+  @param[in]  TestValue     The test value of memory.
+
+  @retval EFI_NOT_READY     The MMIO register hasn't set to the expected value.
+  @retval EFI_SUCCESS       The MMIO register has expected value.
+  @retval Others            The MMIO operation fails.
+
+**/
+EFI_STATUS
+EFIAPI
+SdMmcHcCheckMmioSet (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                BarIndex,
+  IN  UINT32               Offset,
+  IN  UINT8                Count,
+  IN  UINT64               MaskValue,
+  IN  UINT64               TestValue
+  );
+
+/**
+  Turn on/off LED.
+
+  @param[in] PciIo          The PCI IO protocol instance.
+  @param[in] Slot           The slot number of the SD card to send the command to.
+  @param[in] On             The boolean to turn on/off LED.
+
+  @retval EFI_SUCCESS       The LED is turned on/off successfully.
+  @retval Others            The LED isn't turned on/off successfully.
+
+**/
+EFI_STATUS
+SdMmcHcLedOnOff (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT8                Slot,
+  IN BOOLEAN              On
+  );
+
+// MU_CHANGE [END]
+
 #endif
@@ -0,0 +1,1500 @@
+/** @file -- SdMmcAdma3UnitTest.c
+  Host based unit tests of the ADMA3 queuing of SdMmcPciHcDxe, against a
+  simulated SD host controller with an eMMC device.
+
+  The simulated host controller keeps a virtual clock in microseconds that
+  advances by one period of the non-blocking timer of SdMmcPciHcDxe on each
+  tick of the test. The device takes TEST_COMMAND_LATENCY to start a command
+  and then moves its data at TEST_BYTES_PER_US. A batch started through the
+  ADMA3 Integrated Descriptor Address register runs its commands back to back;
+  a request executed alone is started on a tick and found done on the next
+  one, as ProcessAsyncTaskList() does.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../SdMmcPciHcDxe.h"
+
+#define UNIT_TEST_NAME     "SD/MMC ADMA3 Queuing Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Simulated device timing.
+//
+#define TEST_TICK             1000                                  // 1 ms, the non-blocking timer period
+#define TEST_COMMAND_LATENCY  50                                    // 50 us
+#define TEST_BYTES_PER_US     200                                   // 200 MB/s
+
+#define TEST_BLOCK_SIZE      512
+#define TEST_REQUEST_BLOCKS  128                                    // 64 KB
+#define TEST_LINE_SIZE       SIZE_32KB                              // Data of an ADMA2 descriptor line
+#define TEST_REQUESTS        64
+#define TEST_NO_LBA          MAX_UINT32
+#define TEST_CARD_STATUS     0x900                                  // READY_FOR_DATA, tran state
+#define TEST_OUT_OF_RANGE    BIT31                                  // Error bit of the card status
+
+///
+/// A command of a batch, as the simulated host controller read it.
+///
+typedef struct {
+  UINT8     Index;
+  UINT32    Argument;
+  UINT32    Blocks;
+  UINT16    TransMode;
+  UINT8     *Buffer;
+} SIMULATED_COMMAND;
+
+///
+/// State of the simulated host controller.
+///
+typedef struct {
+  UINT64               Clock;
+  UINT16               NorIntSts;
+  UINT16               ErrIntSts;
+  UINT8                HostCtrl1;
+  BOOLEAN              Busy;                                        ///< A batch or a request is running.
+  UINT64               CompleteAt;
+  UINT32               FailLba;                                     ///< LBA of the command that fails, or TEST_NO_LBA.
+  UINT32               HangLba;                                     ///< LBA of the command that never completes, or TEST_NO_LBA.
+  UINT32               R1ErrorLba;                                  ///< LBA of the command whose R1 response reports an error, or TEST_NO_LBA.
+  UINT32               CardStatus;                                  ///< Card status of the last response.
+  UINT32               Commands;
+  SIMULATED_COMMAND    Batch[SD_MMC_ADMA3_MAX_DEPTH];
+  UINTN                Batches;
+  UINTN                SingleCommands;
+  UINTN                AutoCmd23;
+  UINTN                AutoCmd12;
+  UINT64               BlocksWritten;
+  UINTN                Resets;
+  UINTN                Responses;
+  UINTN                Maps;
+  UINTN                Unmaps;
+  UINTN                BadAccesses;
+} SIMULATED_HC;
+
+///
+/// A packet sent through the simulated non-blocking queue.
+///
+typedef struct {
+  EFI_SD_MMC_PASS_THRU_COMMAND_PACKET    Packet;
+  EFI_SD_MMC_COMMAND_BLOCK               CmdBlk;
+  EFI_SD_MMC_STATUS_BLOCK                StatusBlk;
+  BOOLEAN                                Done;
+  UINT64                                 DoneAt;
+  EFI_STATUS                             Status;
+} TEST_PACKET;
+
+///
+/// A read or write request, with the SET_BLOCK_COUNT that EmmcDxe sends first.
+///
+typedef struct {
+  TEST_PACKET    SetBlkCount;
+  TEST_PACKET    Data;
+} TEST_REQUEST;
+
+STATIC SIMULATED_HC            mHc;
+STATIC EFI_PCI_IO_PROTOCOL     mPciIo;
+STATIC EFI_BOOT_SERVICES       mBootServices;
+STATIC SD_MMC_HC_PRIVATE_DATA  mPrivate;
+STATIC TEST_REQUEST            *mRequests;
+STATIC UINT8                   *mData;
+
+EFI_BOOT_SERVICES  *gBS = &mBootServices;
+
+/**
+  Move the data of a command of the simulated device.
+
+  @param[in] Command  The command.
+
+**/
+STATIC
+VOID
+TestCardTransfer (
+  IN SIMULATED_COMMAND  *Command
+  )
+{
+  UINT32  Block;
+
+  if ((Command->TransMode & BIT4) != 0) {
+    for (Block = 0; Block < Command->Blocks; Block++) {
+      SetMem (Command->Buffer + Block * TEST_BLOCK_SIZE, TEST_BLOCK_SIZE, (UINT8)(Command->Argument + Block));
+    }
+  } else {
+    mHc.BlocksWritten += Command->Blocks;
+  }
+}
+
+/**
+  Complete the batch of the simulated host controller once its commands are
+  done.
+
+**/
+STATIC
+VOID
+TestHcUpdate (
+  VOID
+  )
+{
+  UINT32  Index;
+
+  if (!mHc.Busy || (mHc.Commands == 0) || (mHc.CompleteAt > mHc.Clock)) {
+    return;
+  }
+
+  for (Index = 0; Index < mHc.Commands; Index++) {
+    if (mHc.Batch[Index].Argument == mHc.FailLba) {
+      mHc.NorIntSts |= BIT15;
+      mHc.ErrIntSts |= BIT5;
+      return;
+    }
+
+    //
+    // The Response Error Check of the command stops the batch on an error of
+    // its R1 response.
+    //
+    if ((mHc.Batch[Index].Argument == mHc.R1ErrorLba) && ((mHc.Batch[Index].TransMode & BIT7) != 0)) {
+      mHc.NorIntSts |= BIT15;
+      mHc.ErrIntSts |= BIT11;
+      return;
+    }
+
+    TestCardTransfer (&mHc.Batch[Index]);
+  }
+
+  mHc.Busy       = FALSE;
+  mHc.Commands   = 0;
+  mHc.NorIntSts |= BIT3 | BIT1 | BIT0;
+}
+
+/**
+  Parse a command descriptor and the ADMA2 descriptor table that follows it.
+
+  @param[in]  Line     The first line of the command descriptor.
+  @param[in]  Last     TRUE for the last command of the batch.
+  @param[out] Command  The command.
+
+  @retval TRUE   The descriptors are valid.
+  @retval FALSE  Otherwise.
+
+**/
+STATIC
+BOOLEAN
+TestParseCommand (
+  IN  UINT8              *Line,
+  IN  BOOLEAN            Last,
+  OUT SIMULATED_COMMAND  *Command
+  )
+{
+  SD_MMC_HC_ADMA3_CMD_DESC_LINE   *CmdDesc;
+  SD_MMC_HC_ADMA_64_V4_DESC_LINE  *Adma2;
+  UINT32                          Entry;
+  UINT32                          Data[SD_MMC_ADMA3_CMD_DESC_ENTRIES];
+  UINT32                          Bytes;
+  UINT32                          Length;
+  UINT8                           *Next;
+
+  //
+  // The entries of the command descriptor are 64-bit in every addressing
+  // mode.
+  //
+  CmdDesc = (SD_MMC_HC_ADMA3_CMD_DESC_LINE *)Line;
+  for (Entry = 0; Entry < SD_MMC_ADMA3_CMD_DESC_ENTRIES; Entry++) {
+    if ((CmdDesc[Entry].Attr.Valid != 1) || (CmdDesc[Entry].Attr.Act != SD_MMC_ADMA3_ACT_CMD) ||
+        (CmdDesc[Entry].Attr.End != ((Entry == SD_MMC_ADMA3_CMD_DESC_ENTRIES - 1) ? 1 : 0)))
+    {
+      return FALSE;
+    }
+
+    Data[Entry] = CmdDesc[Entry].Data;
+  }
+
+  Line += SD_MMC_ADMA3_CMD_DESC_ENTRIES * sizeof (SD_MMC_HC_ADMA3_CMD_DESC_LINE);
+
+  //
+  // 32-bit Block Count, Block Size with a 16-bit Block Count of 0, Argument,
+  // Transfer Mode and Command.
+  //
+  if (Data[1] != TEST_BLOCK_SIZE) {
+    return FALSE;
+  }
+
+  Command->Blocks    = Data[0];
+  Command->Argument  = Data[2];
+  Command->TransMode = (UINT16)Data[3];
+  Command->Index     = (UINT8)(Data[3] >> 24);
+  Command->Buffer    = NULL;
+
+  Bytes = 0;
+  Next  = NULL;
+  for (Adma2 = (SD_MMC_HC_ADMA_64_V4_DESC_LINE *)Line; ; Adma2++) {
+    if ((Adma2->Valid != 1) || (Adma2->Act != 2)) {
+      return FALSE;
+    }
+
+    Length = (Adma2->UpperLength << 16) | Adma2->LowerLength;
+    if (Command->Buffer == NULL) {
+      Command->Buffer = (UINT8 *)(UINTN)(LShiftU64 (Adma2->UpperAddress, 32) | Adma2->LowerAddress);
+    } else if ((UINT8 *)(UINTN)(LShiftU64 (Adma2->UpperAddress, 32) | Adma2->LowerAddress) != Next) {
+      return FALSE;
+    }
+
+    Bytes += Length;
+    Next   = Command->Buffer + Bytes;
+    if (Adma2->End == 1) {
+      break;
+    }
+
+    if (Adma2->Int != 0) {
+      return FALSE;
+    }
+  }
+
+  return (BOOLEAN)((Bytes == Command->Blocks * TEST_BLOCK_SIZE) && (Adma2->Int == (Last ? 1 : 0)));
+}
+
+/**
+  Start the batch of an integrated descriptor table, as a host controller does
+  when the ADMA3 Integrated Descriptor Address register is written.
+
+  @param[in] Table  The integrated descriptor table.
+
+**/
+STATIC
+VOID
+TestHcStartBatch (
+  IN UINT8  *Table
+  )
+{
+  SD_MMC_HC_ADMA3_INTEGRATED_64_DESC_LINE  *IdLine;
+  SIMULATED_COMMAND                        *Command;
+  UINT32                                   Index;
+  UINT16                                   Expected;
+  BOOLEAN                                  Last;
+
+  if (mHc.Busy || ((mHc.HostCtrl1 & (BIT4 | BIT3)) != (BIT4 | BIT3)) || ((mHc.HostCtrl1 & BIT0) == 0)) {
+    mHc.BadAccesses++;
+    return;
+  }
+
+  mHc.CompleteAt = mHc.Clock;
+  for (Index = 0, Last = FALSE; !Last; Index++) {
+    IdLine = (SD_MMC_HC_ADMA3_INTEGRATED_64_DESC_LINE *)Table + Index;
+    Last   = (BOOLEAN)(IdLine->Attr.End == 1);
+    if ((Index == SD_MMC_ADMA3_MAX_DEPTH) || (IdLine->Attr.Valid != 1) || (IdLine->Attr.Act != SD_MMC_ADMA3_ACT_INTEGRATED)) {
+      mHc.BadAccesses++;
+      return;
+    }
+
+    Command = &mHc.Batch[Index];
+    if (!TestParseCommand ((UINT8 *)(UINTN)(LShiftU64 (IdLine->UpperAddress, 32) | IdLine->LowerAddress), Last, Command)) {
+      mHc.BadAccesses++;
+      return;
+    }
+
+    //
+    // Block reads and writes with the Response Error Check of their R1
+    // response, and the Auto CMD23 or Auto CMD12 that ends the multiple block
+    // transfers of the device.
+    //
+    Expected = BIT8 | BIT7 | BIT0;
+    if ((Command->Index == EMMC_READ_SINGLE_BLOCK) || (Command->Index == EMMC_READ_MULTIPLE_BLOCK)) {
+      Expected |= BIT4;
+    }
+
+    if (Command->Blocks > 1) {
+      Expected |= BIT5 | BIT1;
+      Expected |= (mPrivate.Slot[0].CardType == EmmcCardType) ? BIT3 : BIT2;
+    }
+
+    if ((Command->TransMode != Expected) ||
+        (((Command->Index == EMMC_READ_MULTIPLE_BLOCK) || (Command->Index == EMMC_WRITE_MULTIPLE_BLOCK)) != (Command->Blocks > 1)))
+    {
+      mHc.BadAccesses++;
+      return;
+    }
+
+    if ((Command->TransMode & BIT3) != 0) {
+      mHc.AutoCmd23++;
+    } else if ((Command->TransMode & BIT2) != 0) {
+      mHc.AutoCmd12++;
+    }
+
+    if (Command->Argument == mHc.HangLba) {
+      mHc.CompleteAt = MAX_UINT64;
+    } else if (mHc.CompleteAt != MAX_UINT64) {
+      mHc.CompleteAt += TEST_COMMAND_LATENCY + Command->Blocks * TEST_BLOCK_SIZE / TEST_BYTES_PER_US;
+    }
+  }
+
+  mHc.Busy     = TRUE;
+  mHc.Commands = Index;
+  mHc.Batches++;
+}
+
+/**
+  Read or write a register of the simulated host controller.
+
+  @param[in]      PciIo     The PCI IO protocol instance.
+  @param[in]      BarIndex  The slot.
+  @param[in]      Offset    The register offset.
+  @param[in]      Read      A boolean to indicate it's read or write operation.
+  @param[in]      Count     The width of the register in bytes.
+  @param[in, out] Data      The register value.
+
+  @retval EFI_SUCCESS  The register was accessed.
+
+**/
+EFI_STATUS
+EFIAPI
+SdMmcHcRwMmio (
+  IN     EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN     UINT8                BarIndex,
+  IN     UINT32               Offset,
+  IN     BOOLEAN              Read,
+  IN     UINT8                Count,
+  IN OUT VOID                 *Data
+  )
+{
+  TestHcUpdate ();
+
+  switch (Offset) {
+    case SD_MMC_HC_NOR_INT_STS:
+      if (Read) {
+        *(UINT16 *)Data = mHc.NorIntSts;
+      } else {
+        mHc.NorIntSts &= ~*(UINT16 *)Data;
+      }
+
+      break;
+
+    case SD_MMC_HC_ERR_INT_STS:
+      if (Read) {
+        *(UINT16 *)Data = mHc.ErrIntSts;
+      } else {
+        mHc.ErrIntSts &= ~*(UINT16 *)Data;
+      }
+
+      break;
+
+    case SD_MMC_HC_HOST_CTRL1:
+      if (Read) {
+        *(UINT8 *)Data = mHc.HostCtrl1;
+      } else {
+        mHc.HostCtrl1 = *(UINT8 *)Data;
+      }
+
+      break;
+
+    case SD_MMC_HC_PRESENT_STATE:
+      *(UINT32 *)Data = mHc.Busy ? (BIT0 | BIT1) : 0;
+      break;
+
+    case SD_MMC_HC_ADMA3_ID_ADDR:
+      if (Read || (Count != sizeof (UINT64))) {
+        mHc.BadAccesses++;
+        break;
+      }
+
+      TestHcStartBatch ((UINT8 *)(UINTN)*(UINT64 *)Data);
+      break;
+
+    default:
+      mHc.BadAccesses++;
+      break;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Do OR operation with the value of a register of the simulated host controller.
+
+  @param[in] PciIo     The PCI IO protocol instance.
+  @param[in] BarIndex  The slot.
+  @param[in] Offset    The register offset.
+  @param[in] Count     The width of the register in bytes.
+  @param[in] OrData    The data used to do OR operation.
+
+  @retval EFI_SUCCESS  The register was updated.
+
+**/
+EFI_STATUS
+EFIAPI
+SdMmcHcOrMmio (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                BarIndex,
+  IN  UINT32               Offset,
+  IN  UINT8                Count,
+  IN  VOID                 *OrData
+  )
+{
+  UINT8  Value;
+
+  if ((Offset != SD_MMC_HC_HOST_CTRL1) || (Count != sizeof (UINT8))) {
+    mHc.BadAccesses++;
+    return EFI_SUCCESS;
+  }
+
+  SdMmcHcRwMmio (PciIo, BarIndex, Offset, TRUE, Count, &Value);
+  Value |= *(UINT8 *)OrData;
+  return SdMmcHcRwMmio (PciIo, BarIndex, Offset, FALSE, Count, &Value);
+}
+
+/**
+  Do AND operation with the value of a register of the simulated host controller.
+
+  @param[in] PciIo     The PCI IO protocol instance.
+  @param[in] BarIndex  The slot.
+  @param[in] Offset    The register offset.
+  @param[in] Count     The width of the register in bytes.
+  @param[in] AndData   The data used to do AND operation.
+
+  @retval EFI_SUCCESS  The register was updated.
+
+**/
+EFI_STATUS
+EFIAPI
+SdMmcHcAndMmio (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                BarIndex,
+  IN  UINT32               Offset,
+  IN  UINT8                Count,
+  IN  VOID                 *AndData
+  )
+{
+  UINT8  Value;
+
+  if ((Offset != SD_MMC_HC_HOST_CTRL1) || (Count != sizeof (UINT8))) {
+    mHc.BadAccesses++;
+    return EFI_SUCCESS;
+  }
+
+  SdMmcHcRwMmio (PciIo, BarIndex, Offset, TRUE, Count, &Value);
+  Value &= *(UINT8 *)AndData;
+  return SdMmcHcRwMmio (PciIo, BarIndex, Offset, FALSE, Count, &Value);
+}
+
+/**
+  Check the value of a register of the simulated host controller.
+
+  @param[in]  PciIo      The PCI IO protocol instance.
+  @param[in]  BarIndex   The slot.
+  @param[in]  Offset     The register offset.
+  @param[in]  Count      The width of the register in bytes.
+  @param[in]  MaskValue  The mask value of the register.
+  @param[in]  TestValue  The test value of the register.
+
+  @retval EFI_NOT_READY  The register hasn't set to the expected value.
+  @retval EFI_SUCCESS    The register has expected value.
+
+**/
+EFI_STATUS
+EFIAPI
+SdMmcHcCheckMmioSet (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                BarIndex,
+  IN  UINT32               Offset,
+  IN  UINT8                Count,
+  IN  UINT64               MaskValue,
+  IN  UINT64               TestValue
+  )
+{
+  UINT32  Value;
+
+  SdMmcHcRwMmio (PciIo, BarIndex, Offset, TRUE, sizeof (Value), &Value);
+  return ((Value & MaskValue) == TestValue) ? EFI_SUCCESS : EFI_NOT_READY;
+}
+
+/**
+  Turn on/off the LED of the simulated host controller.
+
+  @param[in] PciIo  The PCI IO protocol instance.
+  @param[in] Slot   The slot.
+  @param[in] On     The boolean to turn on/off LED.
+
+  @retval EFI_SUCCESS  The LED is turned on/off.
+
+**/
+EFI_STATUS
+SdMmcHcLedOnOff (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT8                Slot,
+  IN BOOLEAN              On
+  )
+{
+  UINT8  HostCtrl1;
+
+  if (On) {
+    HostCtrl1 = BIT0;
+    return SdMmcHcOrMmio (PciIo, Slot, SD_MMC_HC_HOST_CTRL1, sizeof (HostCtrl1), &HostCtrl1);
+  }
+
+  HostCtrl1 = (UINT8) ~BIT0;
+  return SdMmcHcAndMmio (PciIo, Slot, SD_MMC_HC_HOST_CTRL1, sizeof (HostCtrl1), &HostCtrl1);
+}
+
+/**
+  Reset the CMD and DAT lines of the simulated host controller.
+
+  @param[in]  Private       Pointer to driver private data.
+  @param[in]  Slot          Index of the slot to reset.
+  @param[in]  ErrIntStatus  Error interrupt status mask.
+
+  @retval EFI_SUCCESS  Software reset performed successfully.
+**/
+EFI_STATUS
+SdMmcSoftwareReset (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT8                   Slot,
+  IN UINT16                  ErrIntStatus
+  )
+{
+  mHc.Resets++;
+  mHc.Busy      = FALSE;
+  mHc.Commands  = 0;
+  mHc.NorIntSts = 0;
+  mHc.ErrIntSts = 0;
+  return EFI_SUCCESS;
+}
+
+/**
+  Check the error status of the simulated host controller and reset it on an
+  error, as SdMmcPciHci.c does.
+
+  @param[in] Private    Pointer to driver private data.
+  @param[in] Slot       Index of the slot for device.
+  @param[in] IntStatus  Normal interrupt status mask.
+
+  @retval EFI_SUCCESS       No error reported.
+  @retval EFI_DEVICE_ERROR  An error happened.
+
+**/
+EFI_STATUS
+SdMmcCheckAndRecoverErrors (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN UINT8                   Slot,
+  IN UINT16                  IntStatus
+  )
+{
+  if ((IntStatus & BIT15) == 0) {
+    return EFI_SUCCESS;
+  }
+
+  SdMmcSoftwareReset (Private, Slot, mHc.ErrIntSts);
+  return EFI_DEVICE_ERROR;
+}
+
+/**
+  Read the response of the last command of the simulated host controller.
+
+  @param[in] Private  A pointer to the SD_MMC_HC_PRIVATE_DATA instance.
+  @param[in] Trb      The pointer to the SD_MMC_HC_TRB instance.
+
+  @retval EFI_SUCCESS  Response read successfully.
+**/
+EFI_STATUS
+SdMmcGetResponse (
+  IN SD_MMC_HC_PRIVATE_DATA  *Private,
+  IN SD_MMC_HC_TRB           *Trb
+  )
+{
+  mHc.Responses++;
+  Trb->Packet->SdMmcStatusBlk->Resp0 = mHc.CardStatus;
+  return EFI_SUCCESS;
+}
+
+/**
+  Free a TRB queued by TestQueuePacket().
+
+  @param[in] Trb  The pointer to the SD_MMC_HC_TRB instance.
+
+**/
+VOID
+SdMmcFreeTrb (
+  IN SD_MMC_HC_TRB  *Trb
+  )
+{
+  if (Trb->Adma64V4Desc != NULL) {
+    FreePool (Trb->Adma64V4Desc);
+  }
+
+  FreePool (Trb);
+}
+
+/**
+  Allocate pages for a common buffer.
+
+  @retval EFI_SUCCESS           The pages were allocated.
+  @retval EFI_OUT_OF_RESOURCES  The pages could not be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+TestAllocateBuffer (
+  IN  EFI_PCI_IO_PROTOCOL  *This,
+  IN  EFI_ALLOCATE_TYPE    Type,
+  IN  EFI_MEMORY_TYPE      MemoryType,
+  IN  UINTN                Pages,
+  OUT VOID                 **HostAddress,
+  IN  UINT64               Attributes
+  )
+{
+  *HostAddress = AllocateAlignedPages (Pages, EFI_PAGE_SIZE);
+  return (*HostAddress == NULL) ? EFI_OUT_OF_RESOURCES : EFI_SUCCESS;
+}
+
+/**
+  Free pages allocated by TestAllocateBuffer().
+
+  @retval EFI_SUCCESS  The pages were freed.
+
+**/
+EFI_STATUS
+EFIAPI
+TestFreeBuffer (
+  IN  EFI_PCI_IO_PROTOCOL  *This,
+  IN  UINTN                Pages,
+  IN  VOID                 *HostAddress
+  )
+{
+  FreeAlignedPages (HostAddress, Pages);
+  return EFI_SUCCESS;
+}
+
+/**
+  Map a buffer at its host address.
+
+  @retval EFI_SUCCESS  The buffer was mapped.
+
+**/
+EFI_STATUS
+EFIAPI
+TestMap (
+  IN     EFI_PCI_IO_PROTOCOL            *This,
+  IN     EFI_PCI_IO_PROTOCOL_OPERATION  Operation,
+  IN     VOID                           *HostAddress,
+  IN OUT UINTN                          *NumberOfBytes,
+  OUT    EFI_PHYSICAL_ADDRESS           *DeviceAddress,
+  OUT    VOID                           **Mapping
+  )
+{
+  *DeviceAddress = (EFI_PHYSICAL_ADDRESS)(UINTN)HostAddress;
+  *Mapping       = HostAddress;
+  mHc.Maps++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Unmap a buffer mapped by TestMap().
+
+  @retval EFI_SUCCESS  The buffer was unmapped.
+
+**/
+EFI_STATUS
+EFIAPI
+TestUnmap (
+  IN  EFI_PCI_IO_PROTOCOL  *This,
+  IN  VOID                 *Mapping
+  )
+{
+  mHc.Unmaps++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Record the completion of a packet.
+
+  @param[in] Event  The packet.
+
+  @retval EFI_SUCCESS  The event was signaled.
+
+**/
+EFI_STATUS
+EFIAPI
+TestSignalEvent (
+  IN EFI_EVENT  Event
+  )
+{
+  TEST_PACKET  *Packet;
+
+  Packet         = (TEST_PACKET *)Event;
+  Packet->Done   = TRUE;
+  Packet->DoneAt = mHc.Clock;
+  Packet->Status = Packet->Packet.TransactionStatus;
+  return EFI_SUCCESS;
+}
+
+/**
+  Queue a packet in the non-blocking queue, as SdMmcCreateTrb() does with the
+  64-bit ADMA2 descriptors of SdMmcHcDxe.
+
+  @param[in] Packet   The packet.
+  @param[in] Index    The command index.
+  @param[in] Arg      The command argument.
+  @param[in] Buffer   The data buffer, or NULL.
+  @param[in] Blocks   The number of blocks.
+  @param[in] Read     TRUE for a read.
+  @param[in] Timeout  The timeout of the packet.
+
+**/
+STATIC
+VOID
+TestQueuePacket (
+  IN TEST_PACKET  *Packet,
+  IN UINT8        Index,
+  IN UINT32       Arg,
+  IN UINT8        *Buffer,
+  IN UINT32       Blocks,
+  IN BOOLEAN      Read,
+  IN UINT64       Timeout
+  )
+{
+  SD_MMC_HC_TRB  *Trb;
+  UINT32         Bytes;
+  UINT32         Lines;
+  UINT32         Line;
+
+  ZeroMem (Packet, sizeof (TEST_PACKET));
+  Packet->CmdBlk.CommandIndex    = Index;
+  Packet->CmdBlk.CommandArgument = Arg;
+  Packet->CmdBlk.CommandType     = (Buffer == NULL) ? SdMmcCommandTypeAc : SdMmcCommandTypeAdtc;
+  Packet->CmdBlk.ResponseType    = SdMmcResponseTypeR1;
+  Packet->Packet.SdMmcCmdBlk     = &Packet->CmdBlk;
+  Packet->Packet.SdMmcStatusBlk  = &Packet->StatusBlk;
+  Packet->Packet.Timeout         = Timeout;
+
+  Trb            = AllocateZeroPool (sizeof (SD_MMC_HC_TRB));
+  Trb->Signature = SD_MMC_HC_TRB_SIG;
+  Trb->Slot      = 0;
+  Trb->BlockSize = TEST_BLOCK_SIZE;
+  Trb->Packet    = &Packet->Packet;
+  Trb->Event     = (EFI_EVENT)Packet;
+  Trb->Timeout   = Timeout;
+  Trb->Retries   = SD_MMC_TRB_RETRIES;
+  Trb->Private   = &mPrivate;
+  Trb->Mode      = SdMmcNoData;
+
+  if (Buffer != NULL) {
+    Bytes        = Blocks * TEST_BLOCK_SIZE;
+    Trb->Data    = Buffer;
+    Trb->DataLen = Bytes;
+    Trb->DataPhy = (EFI_PHYSICAL_ADDRESS)(UINTN)Buffer;
+    Trb->Read    = Read;
+    Trb->Mode    = SdMmcAdma64bV4Mode;
+    if (Read) {
+      Packet->Packet.InDataBuffer     = Buffer;
+      Packet->Packet.InTransferLength = Bytes;
+    } else {
+      Packet->Packet.OutDataBuffer     = Buffer;
+      Packet->Packet.OutTransferLength = Bytes;
+    }
+
+    Lines             = (Bytes + TEST_LINE_SIZE - 1) / TEST_LINE_SIZE;
+    Trb->Adma64V4Desc = AllocateZeroPool (Lines * sizeof (SD_MMC_HC_ADMA_64_V4_DESC_LINE));
+    for (Line = 0; Line < Lines; Line++) {
+      Trb->Adma64V4Desc[Line].Valid        = 1;
+      Trb->Adma64V4Desc[Line].Act          = 2;
+      Trb->Adma64V4Desc[Line].LowerLength  = (UINT16)MIN (TEST_LINE_SIZE, Bytes - Line * TEST_LINE_SIZE);
+      Trb->Adma64V4Desc[Line].LowerAddress = (UINT32)(UINTN)(Buffer + Line * TEST_LINE_SIZE);
+      Trb->Adma64V4Desc[Line].UpperAddress = (UINT32)RShiftU64 ((UINTN)(Buffer + Line * TEST_LINE_SIZE), 32);
+    }
+
+    Trb->Adma64V4Desc[Lines - 1].End = 1;
+  }
+
+  InsertTailList (&mPrivate.Queue, &Trb->TrbList);
+}
+
+/**
+  Queue a block read or write, as EmmcReadWrite() or SdReadWrite() does.
+
+  @param[in] Index    The index of the request.
+  @param[in] Write    TRUE for a write.
+  @param[in] Lba      The first block.
+  @param[in] Blocks   The number of blocks.
+  @param[in] Timeout  The timeout of the packets.
+
+**/
+STATIC
+VOID
+TestQueueRequest (
+  IN UINTN    Index,
+  IN BOOLEAN  Write,
+  IN UINT32   Lba,
+  IN UINT32   Blocks,
+  IN UINT64   Timeout
+  )
+{
+  TEST_REQUEST  *Request;
+  UINT8         *Buffer;
+  UINT8         Command;
+
+  Request = &mRequests[Index];
+  Buffer  = mData + Index * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE;
+
+  if (Blocks == 1) {
+    Command = Write ? EMMC_WRITE_BLOCK : EMMC_READ_SINGLE_BLOCK;
+  } else {
+    Command = Write ? EMMC_WRITE_MULTIPLE_BLOCK : EMMC_READ_MULTIPLE_BLOCK;
+  }
+
+  ZeroMem (&Request->SetBlkCount, sizeof (TEST_PACKET));
+  if ((mPrivate.Slot[0].CardType == EmmcCardType) && (Blocks > 1)) {
+    TestQueuePacket (&Request->SetBlkCount, EMMC_SET_BLOCK_COUNT, Blocks, NULL, 0, FALSE, Timeout);
+  }
+
+  TestQueuePacket (&Request->Data, Command, Lba, Buffer, Blocks, (BOOLEAN) !Write, Timeout);
+}
+
+/**
+  Run one period of the non-blocking timer, as ProcessAsyncTaskList() does. A
+  request executed alone is found done on the tick after the one it is
+  started on.
+
+**/
+STATIC
+VOID
+TestTimerTick (
+  VOID
+  )
+{
+  LIST_ENTRY         *Link;
+  SD_MMC_HC_TRB      *Trb;
+  SIMULATED_COMMAND  Command;
+  EFI_STATUS         Status;
+
+  mHc.Clock += TEST_TICK;
+
+  if (SdMmcAdma3ProcessQueue (&mPrivate)) {
+    return;
+  }
+
+  Link = GetFirstNode (&mPrivate.Queue);
+  if (IsNull (&mPrivate.Queue, Link)) {
+    return;
+  }
+
+  Trb = SD_MMC_HC_TRB_FROM_THIS (Link);
+  if (!Trb->Started) {
+    if (mHc.Busy) {
+      mHc.BadAccesses++;
+      return;
+    }
+
+    Trb->Started = TRUE;
+    mHc.Busy     = TRUE;
+    mHc.SingleCommands++;
+    if ((Trb->DataLen != 0) && (Trb->Packet->SdMmcCmdBlk->CommandArgument == mHc.HangLba)) {
+      mHc.CompleteAt = MAX_UINT64;
+    } else {
+      mHc.CompleteAt = mHc.Clock + TEST_COMMAND_LATENCY + Trb->DataLen / TEST_BYTES_PER_US;
+    }
+
+    return;
+  }
+
+  if (mHc.CompleteAt > mHc.Clock) {
+    if ((Trb->Packet->Timeout == 0) || (Trb->Timeout-- != 0)) {
+      return;
+    }
+
+    Status = EFI_TIMEOUT;
+  } else if ((Trb->DataLen != 0) &&
+             ((Trb->Packet->SdMmcCmdBlk->CommandArgument == mHc.FailLba) ||
+              (Trb->Packet->SdMmcCmdBlk->CommandArgument == mHc.R1ErrorLba)))
+  {
+    Status = EFI_DEVICE_ERROR;
+  } else {
+    if (Trb->DataLen != 0) {
+      Command.Argument  = Trb->Packet->SdMmcCmdBlk->CommandArgument;
+      Command.Blocks    = Trb->DataLen / Trb->BlockSize;
+      Command.TransMode = Trb->Read ? BIT4 : 0;
+      Command.Buffer    = Trb->Data;
+      TestCardTransfer (&Command);
+    }
+
+    Status = EFI_SUCCESS;
+  }
+
+  mHc.Busy = FALSE;
+  RemoveEntryList (Link);
+  Trb->Packet->TransactionStatus = Status;
+  TestSignalEvent (Trb->Event);
+  SdMmcFreeTrb (Trb);
+}
+
+/**
+  Run the non-blocking timer until all the requests are done.
+
+  @param[in] MaxTicks  The number of ticks after which the requests are given up.
+
+  @return The time the requests took, in microseconds.
+
+**/
+STATIC
+UINT64
+TestRunRequests (
+  IN UINTN  MaxTicks
+  )
+{
+  UINT64  Start;
+  UINTN   Tick;
+
+  Start = mHc.Clock;
+  for (Tick = 0; Tick < MaxTicks && !IsListEmpty (&mPrivate.Queue); Tick++) {
+    TestTimerTick ();
+  }
+
+  return mHc.Clock - Start;
+}
+
+/**
+  Reset the simulated host controller and enable ADMA3 on it.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED                      The simulated host controller was reset.
+  @retval UNIT_TEST_ERROR_PREREQUISITE_NOT_MET  The buffers could not be allocated.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+Adma3TestSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ZeroMem (&mHc, sizeof (mHc));
+  mHc.HostCtrl1  = BIT4;
+  mHc.FailLba    = TEST_NO_LBA;
+  mHc.HangLba    = TEST_NO_LBA;
+  mHc.R1ErrorLba = TEST_NO_LBA;
+  mHc.CardStatus = TEST_CARD_STATUS;
+
+  ZeroMem (&mPciIo, sizeof (mPciIo));
+  mPciIo.AllocateBuffer = TestAllocateBuffer;
+  mPciIo.FreeBuffer     = TestFreeBuffer;
+  mPciIo.Map            = TestMap;
+  mPciIo.Unmap          = TestUnmap;
+
+  ZeroMem (&mBootServices, sizeof (mBootServices));
+  mBootServices.SignalEvent = TestSignalEvent;
+
+  ZeroMem (&mPrivate, sizeof (mPrivate));
+  mPrivate.Signature = SD_MMC_HC_PRIVATE_SIGNATURE;
+  mPrivate.PciIo     = &mPciIo;
+  InitializeListHead (&mPrivate.Queue);
+  mPrivate.Slot[0].Enable           = TRUE;
+  mPrivate.Slot[0].MediaPresent     = TRUE;
+  mPrivate.Slot[0].Initialized      = TRUE;
+  mPrivate.Slot[0].CardType         = EmmcCardType;
+  mPrivate.ControllerVersion[0]     = SD_MMC_HC_CTRL_VER_420;
+  mPrivate.Capability[0].Adma2      = 1;
+  mPrivate.Capability[0].Adma3      = 1;
+  mPrivate.Capability[0].SysBus64V4 = 1;
+
+  mRequests = AllocateZeroPool (TEST_REQUESTS * sizeof (TEST_REQUEST));
+  mData     = AllocatePool (TEST_REQUESTS * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE);
+  if ((mRequests == NULL) || (mData == NULL)) {
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  SdMmcAdma3Initialize (&mPrivate);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the buffers of the test and the descriptors of the controller.
+
+  @param[in]  Context  Not used.
+
+**/
+VOID
+EFIAPI
+Adma3TestCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  LIST_ENTRY  *Link;
+
+  SdMmcAdma3Cleanup (&mPrivate);
+  while (!IsListEmpty (&mPrivate.Queue)) {
+    Link = GetFirstNode (&mPrivate.Queue);
+    RemoveEntryList (Link);
+    SdMmcFreeTrb (SD_MMC_HC_TRB_FROM_THIS (Link));
+  }
+
+  if (mRequests != NULL) {
+    FreePool (mRequests);
+    mRequests = NULL;
+  }
+
+  if (mData != NULL) {
+    FreePool (mData);
+    mData = NULL;
+  }
+}
+
+/**
+  Check the data read by a request.
+
+  @param[in] Index  The index of the request.
+  @param[in] Lba    The first block read.
+
+  @retval TRUE   Each block holds the low byte of its LBA.
+  @retval FALSE  Otherwise.
+
+**/
+STATIC
+BOOLEAN
+TestCheckRead (
+  IN UINTN   Index,
+  IN UINT32  Lba
+  )
+{
+  UINT8   *Buffer;
+  UINT32  Block;
+
+  Buffer = mRequests[Index].Data.Packet.InDataBuffer;
+  for (Block = 0; Block < mRequests[Index].Data.Packet.InTransferLength / TEST_BLOCK_SIZE; Block++) {
+    if ((Buffer[Block * TEST_BLOCK_SIZE] != (UINT8)(Lba + Block)) ||
+        (Buffer[(Block + 1) * TEST_BLOCK_SIZE - 1] != (UINT8)(Lba + Block)))
+    {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Sequential 64 KB reads of an eMMC device complete a batch at a time with
+  ADMA3, and take four timer periods each when they are executed one command
+  at a time.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The batched reads were faster.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+BatchedReadsOutrunOneAtATime (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN   Index;
+  UINT64  BatchedTime;
+  UINT64  SerialTime;
+
+  UT_ASSERT_EQUAL (mPrivate.Adma3.Depth, SD_MMC_ADMA3_MAX_DEPTH);
+  UT_ASSERT_TRUE (SdMmcAdma3Supported (&mPrivate, 0));
+
+  for (Index = 0; Index < TEST_REQUESTS; Index++) {
+    TestQueueRequest (Index, FALSE, (UINT32)(Index * TEST_REQUEST_BLOCKS), TEST_REQUEST_BLOCKS, EFI_TIMER_PERIOD_SECONDS (1));
+  }
+
+  BatchedTime = TestRunRequests (TEST_REQUESTS * 8);
+  UT_ASSERT_TRUE (IsListEmpty (&mPrivate.Queue));
+  for (Index = 0; Index < TEST_REQUESTS; Index++) {
+    UT_ASSERT_TRUE (mRequests[Index].SetBlkCount.Done);
+    UT_ASSERT_TRUE (mRequests[Index].Data.Done);
+    UT_ASSERT_STATUS_EQUAL (mRequests[Index].SetBlkCount.Status, EFI_SUCCESS);
+    UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_SUCCESS);
+    UT_ASSERT_TRUE (TestCheckRead (Index, (UINT32)(Index * TEST_REQUEST_BLOCKS)));
+  }
+
+  //
+  // Two batches of 32 reads, each with its Auto CMD23, and the response of the
+  // last read of each batch.
+  //
+  UT_ASSERT_EQUAL (mHc.Batches, TEST_REQUESTS / SD_MMC_ADMA3_MAX_DEPTH);
+  UT_ASSERT_EQUAL (mHc.SingleCommands, 0);
+  UT_ASSERT_EQUAL (mHc.AutoCmd23, TEST_REQUESTS);
+  UT_ASSERT_EQUAL (mHc.Responses, mHc.Batches);
+  UT_ASSERT_EQUAL (mRequests[SD_MMC_ADMA3_MAX_DEPTH - 1].Data.StatusBlk.Resp0, TEST_CARD_STATUS);
+  UT_ASSERT_EQUAL (mPrivate.Adma3.Statistics.Batches, mHc.Batches);
+  UT_ASSERT_EQUAL (mPrivate.Adma3.Statistics.Commands, TEST_REQUESTS);
+  UT_ASSERT_EQUAL (mPrivate.Adma3.Statistics.MaxCommands, SD_MMC_ADMA3_MAX_DEPTH);
+  UT_ASSERT_EQUAL (mPrivate.Adma3.Statistics.Fallbacks, 0);
+  UT_ASSERT_EQUAL (mHc.Maps, mHc.Unmaps);
+  UT_ASSERT_EQUAL (mHc.BadAccesses, 0);
+
+  //
+  // ADMA2 is selected again and the LED is off once the batches are done.
+  //
+  UT_ASSERT_EQUAL (mHc.HostCtrl1 & (BIT4 | BIT3 | BIT0), BIT4);
+  UT_ASSERT_TRUE (mPrivate.Adma3.Desc == NULL);
+
+  //
+  // The same reads one command at a time.
+  //
+  mPrivate.Adma3.Depth = 0;
+  SetMem (mData, TEST_REQUESTS * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE, 0);
+  for (Index = 0; Index < TEST_REQUESTS; Index++) {
+    TestQueueRequest (Index, FALSE, (UINT32)(Index * TEST_REQUEST_BLOCKS), TEST_REQUEST_BLOCKS, EFI_TIMER_PERIOD_SECONDS (1));
+  }
+
+  SerialTime = TestRunRequests (TEST_REQUESTS * 8);
+  UT_ASSERT_TRUE (IsListEmpty (&mPrivate.Queue));
+  for (Index = 0; Index < TEST_REQUESTS; Index++) {
+    UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_SUCCESS);
+    UT_ASSERT_TRUE (TestCheckRead (Index, (UINT32)(Index * TEST_REQUEST_BLOCKS)));
+  }
+
+  UT_ASSERT_EQUAL (mHc.SingleCommands, TEST_REQUESTS * 2);
+  UT_ASSERT_EQUAL (SerialTime, TEST_REQUESTS * 4 * TEST_TICK);
+  UT_ASSERT_TRUE (BatchedTime * 4 <= SerialTime);
+
+  UT_LOG_INFO (
+    "%d reads of 64 KB: %Lu us in batches of %d (%Lu MB/s), %Lu us one command at a time (%Lu MB/s)\n",
+    TEST_REQUESTS,
+    BatchedTime,
+    SD_MMC_ADMA3_MAX_DEPTH,
+    DivU64x32 (TEST_REQUESTS * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE, (UINT32)BatchedTime),
+    SerialTime,
+    DivU64x32 (TEST_REQUESTS * TEST_REQUEST_BLOCKS * TEST_BLOCK_SIZE, (UINT32)SerialTime)
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A batch takes the reads and writes at the head of the queue up to the first
+  request it cannot take. The multiple block transfers of an SD card end with
+  an Auto CMD12.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The batches were built as expected.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+BatchStopsAtRequestItCannotTake (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN   Index;
+  UINT32  Trbs;
+  UINT32  Commands;
+
+  //
+  // Writes of 8 blocks, a single block read, then a multiple block read whose
+  // SET_BLOCK_COUNT asks for more blocks than it reads.
+  //
+  for (Index = 0; Index < 4; Index++) {
+    TestQueueRequest (Index, TRUE, (UINT32)(Index * 8), 8, EFI_TIMER_PERIOD_SECONDS (1));
+  }
+
+  TestQueueRequest (4, FALSE, 100, 1, EFI_TIMER_PERIOD_SECONDS (1));
+  TestQueueRequest (5, FALSE, 200, 8, EFI_TIMER_PERIOD_SECONDS (1));
+  mRequests[5].SetBlkCount.CmdBlk.CommandArgument = 16;
+  TestQueueRequest (6, FALSE, 300, 8, EFI_TIMER_PERIOD_SECONDS (1));
+
+  Trbs = SdMmcAdma3CollectTrbs (&mPrivate, &Commands);
+  UT_ASSERT_EQUAL (Trbs, 9);
+  UT_ASSERT_EQUAL (Commands, 5);
+
+  TestRunRequests (100);
+  UT_ASSERT_TRUE (IsListEmpty (&mPrivate.Queue));
+  for (Index = 0; Index < 7; Index++) {
+    UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_SUCCESS);
+  }
+
+  //
+  // The SET_BLOCK_COUNT that does not match runs alone, and its read after it,
+  // then the last read cannot form a batch on its own.
+  //
+  UT_ASSERT_EQUAL (mHc.Batches, 1);
+  UT_ASSERT_EQUAL (mHc.AutoCmd23, 4);
+  UT_ASSERT_EQUAL (mHc.SingleCommands, 4);
+  UT_ASSERT_EQUAL (mHc.BlocksWritten, 4 * 8);
+  UT_ASSERT_TRUE (TestCheckRead (4, 100));
+  UT_ASSERT_TRUE (TestCheckRead (6, 300));
+  UT_ASSERT_EQUAL (mHc.BadAccesses, 0);
+
+  //
+  // An SD card reads without SET_BLOCK_COUNT and ends each read with an Auto
+  // CMD12.
+  //
+  mPrivate.Slot[0].CardType = SdCardType;
+  for (Index = 0; Index < 8; Index++) {
+    TestQueueRequest (Index, FALSE, (UINT32)(Index * 16), 16, EFI_TIMER_PERIOD_SECONDS (1));
+  }
+
+  TestRunRequests (100);
+  UT_ASSERT_TRUE (IsListEmpty (&mPrivate.Queue));
+  for (Index = 0; Index < 8; Index++) {
+    UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_SUCCESS);
+    UT_ASSERT_FALSE (mRequests[Index].SetBlkCount.Done);
+    UT_ASSERT_TRUE (TestCheckRead (Index, (UINT32)(Index * 16)));
+  }
+
+  UT_ASSERT_EQUAL (mHc.Batches, 2);
+  UT_ASSERT_EQUAL (mHc.AutoCmd12, 8);
+  UT_ASSERT_EQUAL (mHc.Maps, mHc.Unmaps);
+  UT_ASSERT_EQUAL (mHc.BadAccesses, 0);
+
+  //
+  // A controller without ADMA3 executes the requests one at a time.
+  //
+  mPrivate.Capability[0].Adma3 = 0;
+  UT_ASSERT_FALSE (SdMmcAdma3Supported (&mPrivate, 0));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  When a command of a batch fails, the requests of the batch are executed
+  again one at a time, so that only the failed request reports the error.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The requests got their own status.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FailedBatchFallsBackToOneAtATime (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  mHc.FailLba = 5 * TEST_REQUEST_BLOCKS;
+  for (Index = 0; Index < 8; Index++) {
+    TestQueueRequest (Index, FALSE, (UINT32)(Index * TEST_REQUEST_BLOCKS), TEST_REQUEST_BLOCKS, EFI_TIMER_PERIOD_SECONDS (1));
+  }
+
+  TestRunRequests (1000);
+  UT_ASSERT_TRUE (IsListEmpty (&mPrivate.Queue));
+  for (Index = 0; Index < 8; Index++) {
+    UT_ASSERT_TRUE (mRequests[Index].Data.Done);
+    UT_ASSERT_STATUS_EQUAL (mRequests[Index].SetBlkCount.Status, EFI_SUCCESS);
+    if (Index == 5) {
+      UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_DEVICE_ERROR);
+    } else {
+      UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_SUCCESS);
+      UT_ASSERT_TRUE (TestCheckRead (Index, (UINT32)(Index * TEST_REQUEST_BLOCKS)));
+    }
+  }
+
+  UT_ASSERT_EQUAL (mHc.Batches, 1);
+  UT_ASSERT_EQUAL (mHc.Resets, 1);
+  UT_ASSERT_EQUAL (mHc.SingleCommands, 16);
+  UT_ASSERT_EQUAL (mPrivate.Adma3.Statistics.Fallbacks, 1);
+  UT_ASSERT_EQUAL (mHc.HostCtrl1 & (BIT4 | BIT3 | BIT0), BIT4);
+  UT_ASSERT_EQUAL (mHc.Maps, mHc.Unmaps);
+  UT_ASSERT_EQUAL (mHc.BadAccesses, 0);
+
+  //
+  // The next requests are batched again.
+  //
+  mHc.FailLba = TEST_NO_LBA;
+  for (Index = 0; Index < 4; Index++) {
+    TestQueueRequest (Index, TRUE, (UINT32)(Index * TEST_REQUEST_BLOCKS), TEST_REQUEST_BLOCKS, EFI_TIMER_PERIOD_SECONDS (1));
+  }
+
+  TestRunRequests (100);
+  UT_ASSERT_TRUE (IsListEmpty (&mPrivate.Queue));
+  UT_ASSERT_EQUAL (mHc.Batches, 2);
+  UT_ASSERT_EQUAL (mHc.BlocksWritten, 4 * TEST_REQUEST_BLOCKS);
+  UT_ASSERT_EQUAL (mHc.BadAccesses, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A command of a batch whose R1 response reports an error stops the batch
+  with a Response Error, and an error in the card status of the last command
+  fails the batch. In both cases the requests of the batch are executed again
+  one at a time.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The R1 errors were caught.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+R1ErrorFailsBatch (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  mHc.R1ErrorLba = 3 * TEST_REQUEST_BLOCKS;
+  for (Index = 0; Index < 8; Index++) {
+    TestQueueRequest (Index, FALSE, (UINT32)(Index * TEST_REQUEST_BLOCKS), TEST_REQUEST_BLOCKS, EFI_TIMER_PERIOD_SECONDS (1));
+  }
+
+  TestRunRequests (1000);
+  UT_ASSERT_TRUE (IsListEmpty (&mPrivate.Queue));
+  for (Index = 0; Index < 8; Index++) {
+    UT_ASSERT_TRUE (mRequests[Index].Data.Done);
+    if (Index == 3) {
+      UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_DEVICE_ERROR);
+    } else {
+      UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_SUCCESS);
+      UT_ASSERT_TRUE (TestCheckRead (Index, (UINT32)(Index * TEST_REQUEST_BLOCKS)));
+    }
+  }
+
+  UT_ASSERT_EQUAL (mHc.Batches, 1);
+  UT_ASSERT_EQUAL (mHc.Resets, 1);
+  UT_ASSERT_EQUAL (mHc.Responses, 0);
+  UT_ASSERT_EQUAL (mPrivate.Adma3.Statistics.Fallbacks, 1);
+
+  //
+  // The last response of a batch reports an error.
+  //
+  mHc.R1ErrorLba = TEST_NO_LBA;
+  mHc.CardStatus = TEST_CARD_STATUS | TEST_OUT_OF_RANGE;
+  for (Index = 0; Index < 4; Index++) {
+    TestQueueRequest (Index, TRUE, (UINT32)(Index * TEST_REQUEST_BLOCKS), TEST_REQUEST_BLOCKS, EFI_TIMER_PERIOD_SECONDS (1));
+  }
+
+  TestRunRequests (1000);
+  UT_ASSERT_TRUE (IsListEmpty (&mPrivate.Queue));
+  for (Index = 0; Index < 4; Index++) {
+    UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_SUCCESS);
+  }
+
+  UT_ASSERT_EQUAL (mHc.Batches, 2);
+  UT_ASSERT_EQUAL (mHc.Responses, 1);
+  UT_ASSERT_EQUAL (mHc.SingleCommands, 16 + 8);
+  UT_ASSERT_EQUAL (mPrivate.Adma3.Statistics.Fallbacks, 2);
+  UT_ASSERT_EQUAL (mHc.HostCtrl1 & (BIT4 | BIT3 | BIT0), BIT4);
+  UT_ASSERT_EQUAL (mHc.Maps, mHc.Unmaps);
+  UT_ASSERT_EQUAL (mHc.BadAccesses, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A batch that never completes times out after the sum of the timeouts of its
+  requests, and its requests are executed again one at a time.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             Only the hung request timed out.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+HungBatchTimesOut (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN   Index;
+  UINT64  Elapsed;
+
+  mHc.HangLba = 2 * TEST_REQUEST_BLOCKS;
+  for (Index = 0; Index < 4; Index++) {
+    TestQueueRequest (Index, FALSE, (UINT32)(Index * TEST_REQUEST_BLOCKS), TEST_REQUEST_BLOCKS, 10);
+  }
+
+  Elapsed = TestRunRequests (1000);
+  UT_ASSERT_TRUE (IsListEmpty (&mPrivate.Queue));
+  for (Index = 0; Index < 4; Index++) {
+    UT_ASSERT_TRUE (mRequests[Index].Data.Done);
+    if (Index == 2) {
+      UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_TIMEOUT);
+    } else {
+      UT_ASSERT_STATUS_EQUAL (mRequests[Index].Data.Status, EFI_SUCCESS);
+      UT_ASSERT_TRUE (TestCheckRead (Index, (UINT32)(Index * TEST_REQUEST_BLOCKS)));
+    }
+  }
+
+  //
+  // The batch is started on the first timer period and given the 80 periods
+  // of its 8 packets.
+  //
+  UT_ASSERT_TRUE (Elapsed >= 81 * TEST_TICK);
+  UT_ASSERT_EQUAL (mHc.Resets, 1);
+  UT_ASSERT_EQUAL (mPrivate.Adma3.Statistics.Fallbacks, 1);
+  UT_ASSERT_EQUAL (mHc.Maps, mHc.Unmaps);
+  UT_ASSERT_EQUAL (mHc.BadAccesses, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the ADMA3
+  queuing of SdMmcPciHcDxe and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+SdMmcAdma3UnitTestEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Adma3TestSuite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &Adma3TestSuite,
+             Framework,
+             "SD/MMC ADMA3 Queuing Test Suite",
+             "SdMmc.Adma3",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for Adma3TestSuite. Status = %r\n", Status));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (Adma3TestSuite, "Batched reads outrun reads one command at a time", "BatchedReadsOutrunOneAtATime", BatchedReadsOutrunOneAtATime, Adma3TestSetup, Adma3TestCleanup, NULL);
+  AddTestCase (Adma3TestSuite, "A batch stops at a request it cannot take", "BatchStopsAtRequestItCannotTake", BatchStopsAtRequestItCannotTake, Adma3TestSetup, Adma3TestCleanup, NULL);
+  AddTestCase (Adma3TestSuite, "A failed batch falls back to one request at a time", "FailedBatchFallsBackToOneAtATime", FailedBatchFallsBackToOneAtATime, Adma3TestSetup, Adma3TestCleanup, NULL);
+  AddTestCase (Adma3TestSuite, "An R1 error fails a batch", "R1ErrorFailsBatch", R1ErrorFailsBatch, Adma3TestSetup, Adma3TestCleanup, NULL);
+  AddTestCase (Adma3TestSuite, "A hung batch times out", "HungBatchTimesOut", HungBatchTimesOut, Adma3TestSetup, Adma3TestCleanup, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return SdMmcAdma3UnitTestEntry ();
+}
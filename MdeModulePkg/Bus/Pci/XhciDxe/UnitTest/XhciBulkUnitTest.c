@@ -0,0 +1,308 @@
+/** @file -- XhciBulkUnitTest.c
+  Host based unit tests of the chained TDs of the XhciDxe bulk transfers,
+  against a simulated transfer ring.
+
+  The TDs are built into the ring the way XhcCreateTransferTrb() does, across
+  the Link TRB at the end of the ring, and completed with the transfer events
+  that a controller reports for them.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../Xhci.h"
+
+#define UNIT_TEST_NAME     "XHCI Chained Bulk TD Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// A small ring, so that the TDs wrap around it.
+//
+#define TEST_RING_TRBS  16
+
+//
+// A 200KB transfer whose buffer starts 4KB before a 64KB boundary, so that it
+// takes TRBs of 4KB, 64KB, 64KB, 64KB and 4KB.
+//
+#define TEST_DATA_PHY    0x1234F000
+#define TEST_DATA_LEN    0x32000
+#define TEST_TD_TRBS     5
+#define TEST_MAX_PACKET  512
+#define TEST_FIRST_TRB   (TEST_RING_TRBS - 3)
+
+///
+/// The simulated transfer ring.
+///
+typedef struct {
+  TRB_TEMPLATE     Trbs[TEST_RING_TRBS];
+  TRANSFER_RING    Ring;
+} SIMULATED_TRANSFER_RING;
+
+STATIC SIMULATED_TRANSFER_RING  mTransferRing;
+STATIC TRB_TEMPLATE             *mTd[TEST_TD_TRBS];
+
+STATIC CONST UINT32  mTdLengths[TEST_TD_TRBS] = { 0x1000, 0x10000, 0x10000, 0x10000, 0x1000 };
+
+/**
+  Initialize the simulated transfer ring as XhcCreateTransferRing() does, with
+  its enqueue pointer a few TRBs before the Link TRB.
+
+**/
+VOID
+TestInitTransferRing (
+  VOID
+  )
+{
+  LINK_TRB  *EndTrb;
+
+  ZeroMem (&mTransferRing, sizeof (mTransferRing));
+
+  mTransferRing.Ring.RingSeg0    = mTransferRing.Trbs;
+  mTransferRing.Ring.TrbNumber   = TEST_RING_TRBS;
+  mTransferRing.Ring.RingEnqueue = &mTransferRing.Trbs[TEST_FIRST_TRB];
+  mTransferRing.Ring.RingDequeue = &mTransferRing.Trbs[TEST_FIRST_TRB];
+  mTransferRing.Ring.RingPCS     = 1;
+
+  EndTrb       = (LINK_TRB *)&mTransferRing.Trbs[TEST_RING_TRBS - 1];
+  EndTrb->Type = TRB_TYPE_LINK;
+  EndTrb->TC   = 1;
+}
+
+/**
+  Build a chained bulk TD into the simulated transfer ring.
+
+  @param[in] DataLen     The length of the data of the transfer.
+  @param[in] HciVersion  The version of the xHCI specification of the controller.
+
+  @return The number of TRBs of the TD, at most TEST_TD_TRBS.
+
+**/
+UINTN
+TestBuildTd (
+  IN UINTN   DataLen,
+  IN UINT16  HciVersion
+  )
+{
+  TRB_TEMPLATE  *Trb;
+  UINTN         TotalLen;
+  UINTN         TrbNum;
+
+  TotalLen = 0;
+  TrbNum   = 0;
+  Trb      = mTransferRing.Ring.RingEnqueue;
+  while ((TotalLen < DataLen) && (TrbNum < TEST_TD_TRBS)) {
+    mTd[TrbNum] = Trb;
+    TotalLen   += XhcInitChainedBulkTrb ((TRANSFER_TRB_NORMAL *)Trb, TEST_DATA_PHY, DataLen, TotalLen, TEST_MAX_PACKET, HciVersion);
+    TrbNum++;
+
+    Trb++;
+    if (Trb->Type == TRB_TYPE_LINK) {
+      Trb = mTransferRing.Ring.RingSeg0;
+    }
+  }
+
+  return TrbNum;
+}
+
+/**
+  Reset the simulated transfer ring before each test.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED  Always.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+BulkTestSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TestInitTransferRing ();
+  ZeroMem (mTd, sizeof (mTd));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A bulk transfer is one TD whose TRBs stop at the 64KB boundaries. All its
+  TRBs but the last are chained, only the last one interrupts, and each one
+  reports the packets of the TD after it.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The TD is right.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+ChainedTdLayout (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TRANSFER_TRB_NORMAL  *Trb;
+  UINT64               DataPhy;
+  UINTN                Index;
+
+  UT_ASSERT_EQUAL (TestBuildTd (TEST_DATA_LEN, 0x110), TEST_TD_TRBS);
+
+  DataPhy = TEST_DATA_PHY;
+  for (Index = 0; Index < TEST_TD_TRBS; Index++) {
+    Trb = (TRANSFER_TRB_NORMAL *)mTd[Index];
+    UT_ASSERT_EQUAL (Trb->Type, TRB_TYPE_NORMAL);
+    UT_ASSERT_EQUAL (Trb->TRBPtrLo | LShiftU64 (Trb->TRBPtrHi, 32), DataPhy);
+    UT_ASSERT_EQUAL (Trb->Length, mTdLengths[Index]);
+    UT_ASSERT_EQUAL (Trb->ISP, 1);
+    UT_ASSERT_EQUAL (Trb->CH, (Index < TEST_TD_TRBS - 1) ? 1 : 0);
+    UT_ASSERT_EQUAL (Trb->IOC, (Index < TEST_TD_TRBS - 1) ? 0 : 1);
+    DataPhy += Trb->Length;
+  }
+
+  //
+  // The TD Size saturates at 31 packets, and the last TRB has 8 packets left.
+  //
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[0])->TDSize, 31);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[3])->TDSize, 8);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[4])->TDSize, 0);
+
+  //
+  // A partial last packet counts as a packet.
+  //
+  TestInitTransferRing ();
+  UT_ASSERT_EQUAL (TestBuildTd (TEST_DATA_LEN + 0x100, 0x110), TEST_TD_TRBS);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[3])->TDSize, 9);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[4])->Length, 0x1100);
+
+  //
+  // Controllers older than xHCI 1.0 count the KB left instead.
+  //
+  TestInitTransferRing ();
+  UT_ASSERT_EQUAL (TestBuildTd (TEST_DATA_LEN, 0x96), TEST_TD_TRBS);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[0])->TDSize, 31);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[3])->TDSize, 4);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[4])->TDSize, 0);
+
+  //
+  // A transfer inside a 64KB block is a single TRB.
+  //
+  TestInitTransferRing ();
+  UT_ASSERT_EQUAL (TestBuildTd (0x1000, 0x110), 1);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[0])->CH, 0);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[0])->IOC, 1);
+  UT_ASSERT_EQUAL (((TRANSFER_TRB_NORMAL *)mTd[0])->TDSize, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The bytes transferred by a TD are counted from the event that ends it, for a
+  short packet in any of its TRBs, across the end of the ring.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The counts are right.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+ShortPacketCompletion (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TRANSFER_RING  *Ring;
+
+  Ring = &mTransferRing.Ring;
+  UT_ASSERT_EQUAL (TestBuildTd (TEST_DATA_LEN, 0x110), TEST_TD_TRBS);
+
+  //
+  // The third TRB is the first one after the Link TRB.
+  //
+  UT_ASSERT_TRUE (mTd[2] == &mTransferRing.Trbs[0]);
+
+  //
+  // The event of the last TRB of a complete transfer.
+  //
+  UT_ASSERT_EQUAL (XhcGetChainedBulkCompleted (Ring, mTd[0], TEST_TD_TRBS, mTd[4], 0), TEST_DATA_LEN);
+
+  //
+  // A short packet in the first TRB, in a TRB after the Link TRB, and in the
+  // last TRB.
+  //
+  UT_ASSERT_EQUAL (XhcGetChainedBulkCompleted (Ring, mTd[0], TEST_TD_TRBS, mTd[0], 0x1000), 0);
+  UT_ASSERT_EQUAL (XhcGetChainedBulkCompleted (Ring, mTd[0], TEST_TD_TRBS, mTd[0], 0x200), 0xE00);
+  UT_ASSERT_EQUAL (XhcGetChainedBulkCompleted (Ring, mTd[0], TEST_TD_TRBS, mTd[2], 0x800), 0x1000 + 0x10000 + 0xF800);
+  UT_ASSERT_EQUAL (XhcGetChainedBulkCompleted (Ring, mTd[0], TEST_TD_TRBS, mTd[4], 0x1000), TEST_DATA_LEN - 0x1000);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the chained
+  bulk TDs of XhciDxe and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+XhciBulkUnitTestEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      BulkTestSuite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &BulkTestSuite,
+             Framework,
+             "XHCI Chained Bulk TD Test Suite",
+             "Usb.Xhci.Bulk",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for BulkTestSuite. Status = %r\n", Status));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (BulkTestSuite, "A bulk transfer is one chained TD", "ChainedTdLayout", ChainedTdLayout, BulkTestSetup, NULL, NULL);
+  AddTestCase (BulkTestSuite, "A short packet completes the TD with its length", "ShortPacketCompletion", ShortPacketCompletion, BulkTestSetup, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return XhciBulkUnitTestEntry ();
+}
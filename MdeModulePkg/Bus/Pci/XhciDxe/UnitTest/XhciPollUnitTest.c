@@ -0,0 +1,457 @@
+/** @file -- XhciPollUnitTest.c
+  Host based unit tests of the adaptive async transfer timer of XhciDxe,
+  against a simulated event ring.
+
+  The simulated controller writes transfer events into an event ring with the
+  cycle bit protocol of the xHCI specification, and the simulated driver runs
+  the async transfer timer on a virtual clock, consuming the events the way
+  XhcCheckUrbResult() does. The figures are in virtual time, so they do not
+  depend on the machine running the test.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../Xhci.h"
+
+#define UNIT_TEST_NAME     "XHCI Async Transfer Timer Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// A small ring, so that the tests wrap around it.
+//
+#define TEST_RING_TRBS  16
+
+//
+// Simulated HID device, in 100 ns units like the UEFI timers: a burst of
+// reports every 10 ms for 200 ms, then an idle time of 10 s and a last report.
+//
+#define TEST_REPORT_PERIOD  EFI_TIMER_PERIOD_MILLISECONDS (10)
+#define TEST_BURST_REPORTS  20
+#define TEST_IDLE_TIME      EFI_TIMER_PERIOD_SECONDS (10)
+
+///
+/// The simulated event ring.
+///
+typedef struct {
+  TRB_TEMPLATE    Trbs[TEST_RING_TRBS];
+  UINTN           ProducerIndex;
+  UINT32          ProducerCycle;
+  EVENT_RING      Ring;
+} SIMULATED_EVENT_RING;
+
+STATIC SIMULATED_EVENT_RING  mEventRing;
+STATIC XHC_POLL_STATE        mPoll;
+
+/**
+  Initialize the simulated event ring as XhcCreateEventRing() does.
+
+**/
+VOID
+TestInitEventRing (
+  VOID
+  )
+{
+  ZeroMem (&mEventRing, sizeof (mEventRing));
+
+  mEventRing.ProducerCycle         = 1;
+  mEventRing.Ring.EventRingSeg0    = mEventRing.Trbs;
+  mEventRing.Ring.TrbNumber        = TEST_RING_TRBS;
+  mEventRing.Ring.EventRingEnqueue = mEventRing.Trbs;
+  mEventRing.Ring.EventRingDequeue = mEventRing.Trbs;
+  mEventRing.Ring.EventRingCCS     = 1;
+}
+
+/**
+  Write events into the simulated event ring, as the controller does.
+
+  @param[in] Count  The number of events.
+
+**/
+VOID
+TestProduceEvents (
+  IN UINTN  Count
+  )
+{
+  TRB_TEMPLATE  *Trb;
+
+  while (Count-- > 0) {
+    Trb           = &mEventRing.Trbs[mEventRing.ProducerIndex];
+    Trb->Type     = TRB_TYPE_TRANS_EVENT;
+    Trb->CycleBit = mEventRing.ProducerCycle;
+
+    mEventRing.ProducerIndex++;
+    if (mEventRing.ProducerIndex == TEST_RING_TRBS) {
+      mEventRing.ProducerIndex = 0;
+      mEventRing.ProducerCycle ^= 1;
+    }
+  }
+}
+
+/**
+  Find the new events of the simulated event ring, as XhcSyncEventRing() does.
+
+**/
+VOID
+TestSyncEventRing (
+  VOID
+  )
+{
+  EVENT_RING    *EvtRing;
+  TRB_TEMPLATE  *EvtTrb;
+  UINTN         Index;
+
+  EvtRing = &mEventRing.Ring;
+  EvtTrb  = EvtRing->EventRingDequeue;
+
+  for (Index = 0; Index < EvtRing->TrbNumber; Index++) {
+    if (EvtTrb->CycleBit != EvtRing->EventRingCCS) {
+      break;
+    }
+
+    EvtTrb++;
+    if (EvtTrb >= mEventRing.Trbs + TEST_RING_TRBS) {
+      EvtTrb                = EvtRing->EventRingSeg0;
+      EvtRing->EventRingCCS = (EvtRing->EventRingCCS) ? 0 : 1;
+    }
+  }
+
+  EvtRing->EventRingEnqueue = EvtTrb;
+}
+
+/**
+  Consume events found by TestSyncEventRing(), as XhcCheckNewEvent() does.
+
+  @param[in] Count  The number of events to consume.
+
+  @return The number of events consumed.
+
+**/
+UINTN
+TestConsumeEvents (
+  IN UINTN  Count
+  )
+{
+  EVENT_RING  *EvtRing;
+  UINTN       Consumed;
+
+  EvtRing = &mEventRing.Ring;
+
+  for (Consumed = 0; Consumed < Count; Consumed++) {
+    if (EvtRing->EventRingDequeue == EvtRing->EventRingEnqueue) {
+      break;
+    }
+
+    EvtRing->EventRingDequeue++;
+    if (EvtRing->EventRingDequeue >= mEventRing.Trbs + TEST_RING_TRBS) {
+      EvtRing->EventRingDequeue = EvtRing->EventRingSeg0;
+    }
+  }
+
+  return Consumed;
+}
+
+/**
+  Reset the simulated event ring and the timer state before each test.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED  Always.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PollTestSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TestInitEventRing ();
+  XhcPollInitialize (&mPoll);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The new events are counted across the end of the ring, including the ones
+  found by the last sync of the ring and not consumed yet.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The counts are right.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+CountEventsAcrossRingWrap (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UT_ASSERT_EQUAL (XhcPollCountEvents (&mEventRing.Ring), 0);
+
+  TestProduceEvents (10);
+  UT_ASSERT_EQUAL (XhcPollCountEvents (&mEventRing.Ring), 10);
+  TestSyncEventRing ();
+  UT_ASSERT_EQUAL (TestConsumeEvents (10), 10);
+  UT_ASSERT_EQUAL (XhcPollCountEvents (&mEventRing.Ring), 0);
+
+  //
+  // Wrap around the end of the ring.
+  //
+  TestProduceEvents (12);
+  UT_ASSERT_EQUAL (XhcPollCountEvents (&mEventRing.Ring), 12);
+
+  //
+  // A check that stops early leaves found events behind.
+  //
+  TestSyncEventRing ();
+  UT_ASSERT_EQUAL (mEventRing.Ring.EventRingCCS, 0);
+  UT_ASSERT_EQUAL (TestConsumeEvents (5), 5);
+  UT_ASSERT_EQUAL (XhcPollCountEvents (&mEventRing.Ring), 7);
+
+  TestProduceEvents (3);
+  UT_ASSERT_EQUAL (XhcPollCountEvents (&mEventRing.Ring), 10);
+  UT_ASSERT_EQUAL (TestConsumeEvents (TEST_RING_TRBS), 7);
+  UT_ASSERT_EQUAL (XhcPollCountEvents (&mEventRing.Ring), 3);
+  TestSyncEventRing ();
+  UT_ASSERT_EQUAL (TestConsumeEvents (TEST_RING_TRBS), 3);
+  UT_ASSERT_EQUAL (XhcPollCountEvents (&mEventRing.Ring), 0);
+
+  //
+  // A ring with a single free TRB.
+  //
+  TestProduceEvents (TEST_RING_TRBS - 1);
+  UT_ASSERT_EQUAL (XhcPollCountEvents (&mEventRing.Ring), TEST_RING_TRBS - 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The timer is cancelled without async transfers, returns to its shortest
+  period when one is submitted, and keeps that period while the transfers are
+  idle.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The periods are right.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TimerPeriodFollowsActivity (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  UT_ASSERT_EQUAL (mPoll.Interval, 0);
+  UT_ASSERT_TRUE (XhcPollWake (&mPoll));
+  UT_ASSERT_FALSE (XhcPollWake (&mPoll));
+  UT_ASSERT_EQUAL (mPoll.Interval, XHC_ASYNC_TIMER_INTERVAL);
+
+  UT_ASSERT_EQUAL (XhcPollTick (&mPoll, FALSE, 0), 0);
+  UT_ASSERT_EQUAL (mPoll.Interval, 0);
+  UT_ASSERT_TRUE (XhcPollWake (&mPoll));
+
+  //
+  // An idle async transfer does not back off the timer.
+  //
+  for (Index = 0; Index < 1000; Index++) {
+    UT_ASSERT_EQUAL (XhcPollTick (&mPoll, TRUE, 0), XHC_ASYNC_TIMER_INTERVAL);
+  }
+
+  UT_ASSERT_EQUAL (XhcPollTick (&mPoll, TRUE, 3), XHC_ASYNC_TIMER_INTERVAL);
+  UT_ASSERT_EQUAL (XhcPollTick (&mPoll, TRUE, 1), XHC_ASYNC_TIMER_INTERVAL);
+  UT_ASSERT_FALSE (XhcPollWake (&mPoll));
+
+  UT_ASSERT_EQUAL (mPoll.Statistics.Ticks, 1003);
+  UT_ASSERT_EQUAL (mPoll.Statistics.IdleTicks, 1001);
+  UT_ASSERT_EQUAL (mPoll.Statistics.EventsHandled, 4);
+  UT_ASSERT_EQUAL (mPoll.Statistics.MaxEventsPerTick, 3);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A HID device that reports in bursts then stays idle has every report picked
+  up within XHC_ASYNC_TIMER_INTERVAL, and the timer stops once its driver
+  removes the async transfer.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The reports were picked up in time.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IdleDeviceReportLatency (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT64  Clock;
+  UINT64  EndTime;
+  UINT64  RemoveTime;
+  UINT64  Interval;
+  UINT64  Reports[TEST_BURST_REPORTS + 1];
+  UINTN   ReportCount;
+  UINTN   NextReport;
+  UINTN   Handled;
+  UINTN   Events;
+  UINT64  Latency;
+  UINT64  MaxLatency;
+  UINT64  Ticks;
+  UINT64  CheckedTicks;
+  UINTN   Index;
+
+  for (Index = 0; Index < TEST_BURST_REPORTS; Index++) {
+    Reports[Index] = Index * TEST_REPORT_PERIOD + 3;
+  }
+
+  Reports[Index] = Reports[Index - 1] + TEST_IDLE_TIME;
+  ReportCount    = Index + 1;
+
+  //
+  // The HID driver removes its async transfer 1 s after the last report, and
+  // the test runs 1 s longer.
+  //
+  RemoveTime = Reports[Index] + EFI_TIMER_PERIOD_SECONDS (1);
+  EndTime    = RemoveTime + EFI_TIMER_PERIOD_SECONDS (1);
+
+  //
+  // A HID driver submits its async interrupt transfer.
+  //
+  XhcPollWake (&mPoll);
+  Interval     = mPoll.Interval;
+  Clock        = 0;
+  NextReport   = 0;
+  Handled      = 0;
+  MaxLatency   = 0;
+  Ticks        = 0;
+  CheckedTicks = 0;
+
+  while ((Interval != 0) && (Clock < EndTime)) {
+    UT_ASSERT_EQUAL (Interval, XHC_ASYNC_TIMER_INTERVAL);
+    Clock += Interval;
+    Ticks++;
+
+    //
+    // The device completes the transfers whose time has come, and the driver
+    // resubmits them from the callbacks of the tick.
+    //
+    while ((NextReport < ReportCount) && (Reports[NextReport] <= Clock)) {
+      TestProduceEvents (1);
+      NextReport++;
+    }
+
+    Events = XhcPollCountEvents (&mEventRing.Ring);
+    if (Events != 0) {
+      CheckedTicks++;
+      TestSyncEventRing ();
+      UT_ASSERT_EQUAL (TestConsumeEvents (Events), Events);
+      for (Index = Handled; Index < Handled + Events; Index++) {
+        Latency    = Clock - Reports[Index];
+        MaxLatency = MAX (MaxLatency, Latency);
+      }
+
+      Handled += Events;
+    }
+
+    Interval = XhcPollTick (&mPoll, (BOOLEAN)(Clock < RemoveTime), Events);
+  }
+
+  UT_ASSERT_EQUAL (Handled, ReportCount);
+  UT_ASSERT_TRUE (MaxLatency <= XHC_ASYNC_TIMER_INTERVAL);
+
+  //
+  // The timer stopped with the async transfer, and only the ticks that found
+  // a report checked the transfers.
+  //
+  UT_ASSERT_EQUAL (Interval, 0);
+  UT_ASSERT_EQUAL (Ticks, DivU64x32 (RemoveTime + XHC_ASYNC_TIMER_INTERVAL - 1, XHC_ASYNC_TIMER_INTERVAL));
+  UT_ASSERT_TRUE (CheckedTicks <= ReportCount);
+  UT_ASSERT_EQUAL (mPoll.Statistics.Ticks, Ticks);
+  UT_ASSERT_EQUAL (mPoll.Statistics.IdleTicks, Ticks - CheckedTicks);
+  UT_ASSERT_EQUAL (mPoll.Statistics.EventsHandled, ReportCount);
+
+  UT_LOG_INFO (
+    "%Lu ms: %Lu ticks, %Lu checked the transfers, worst latency %Lu us\n",
+    DivU64x32 (EndTime, (UINT32)EFI_TIMER_PERIOD_MILLISECONDS (1)),
+    Ticks,
+    CheckedTicks,
+    DivU64x32 (MaxLatency, 10)
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the async
+  transfer timer of XhciDxe and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+XhciPollUnitTestEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      PollTestSuite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &PollTestSuite,
+             Framework,
+             "XHCI Async Transfer Timer Test Suite",
+             "Usb.Xhci.Poll",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for PollTestSuite. Status = %r\n", Status));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (PollTestSuite, "New events are counted across the end of the ring", "CountEventsAcrossRingWrap", CountEventsAcrossRingWrap, PollTestSetup, NULL, NULL);
+  AddTestCase (PollTestSuite, "The timer period follows the activity", "TimerPeriodFollowsActivity", TimerPeriodFollowsActivity, PollTestSetup, NULL, NULL);
+  AddTestCase (PollTestSuite, "An idle device has its reports picked up in time", "IdleDeviceReportLatency", IdleDeviceReportLatency, PollTestSetup, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return XhciPollUnitTestEntry ();
+}
@@ -1343,6 +1343,100 @@ ON_EXIT:
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - Queue several bulk transfers
+
+/**
+  Queue bulk transfers to the endpoints of a USB device and wait for them.
+
+  @param  This                  This EDKII_USB2_HC_BULK_QUEUE_PROTOCOL instance.
+  @param  DeviceAddress         Target device address.
+  @param  DeviceSpeed           Device speed, Low speed device doesn't support bulk
+                                transfer.
+  @param  Count                 Number of transfers.
+  @param  Transfers             The transfers to queue.
+  @param  Timeout               Indicates the maximum time, in millisecond, which
+                                the transfers are allowed to complete.
+  @param  Translator            A pointr to the transaction translator data.
+
+  @retval EFI_SUCCESS           All the transfers completed successfully.
+  @retval EFI_INVALID_PARAMETER Some parameters are invalid.
+  @retval EFI_OUT_OF_RESOURCES  The transfers could not be queued.
+  @retval EFI_TIMEOUT           The transfers failed due to timeout.
+  @retval EFI_DEVICE_ERROR      A transfer failed due to host controller or device error.
+
+**/
+EFI_STATUS
+EFIAPI
+XhcBulkQueueTransfer (
+  IN     EDKII_USB2_HC_BULK_QUEUE_PROTOCOL   *This,
+  IN     UINT8                               DeviceAddress,
+  IN     UINT8                               DeviceSpeed,
+  IN     UINTN                               Count,
+  IN OUT EDKII_USB_BULK_QUEUE_TRANSFER       *Transfers,
+  IN     UINTN                               Timeout,
+  IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR  *Translator
+  )
+{
+  USB_XHCI_INSTANCE  *Xhc;
+  EFI_STATUS         Status;
+  EFI_TPL            OldTpl;
+  UINTN              Index;
+  UINTN              DebugErrorLevel;
+
+  //
+  // Validate the parameters
+  //
+  if ((Transfers == NULL) || (Count == 0) || (Count > EDKII_USB_BULK_QUEUE_MAX_TRANSFERS) ||
+      (DeviceSpeed == EFI_USB_SPEED_LOW))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    if ((Transfers[Index].Data == NULL) || (Transfers[Index].DataLength == 0) ||
+        ((Transfers[Index].EndpointAddress & 0x0F) == 0))
+    {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Transfers[Index].TransferResult = EFI_USB_ERR_NOTEXECUTE;
+  }
+
+  OldTpl = gBS->RaiseTPL (XHC_TPL);
+
+  Xhc    = XHC_FROM_BULK_QUEUE (This);
+  Status = EFI_DEVICE_ERROR;
+
+  if (XhcIsHalt (Xhc) || XhcIsSysError (Xhc)) {
+    DEBUG ((DEBUG_ERROR, "XhcBulkQueueTransfer: HC is halted\n"));
+    goto ON_EXIT;
+  }
+
+  //
+  // Create the URBs of all the transfers, then poll them together.
+  //
+  Status = XhcExecBulkQueue (Xhc, DeviceAddress, DeviceSpeed, Count, Transfers, Timeout);
+
+ON_EXIT:
+  if (EFI_ERROR (Status)) {
+    if (Status == EFI_TIMEOUT) {
+      DebugErrorLevel = DEBUG_VERBOSE;
+    } else {
+      DebugErrorLevel = DEBUG_ERROR;
+    }
+
+    DEBUG ((DebugErrorLevel, "XhcBulkQueueTransfer: error - %r\n", Status));
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+// MU_CHANGE [END]
+
 /**
   Submits an asynchronous interrupt transfer to an
   interrupt endpoint of a USB device.
@@ -1835,11 +1929,19 @@ XhcCreateUsbHc (
   }
 
   InitializeListHead (&Xhc->AsyncIntTransfers);
+  XhcPollInitialize (&Xhc->Poll); // MU_CHANGE
+
+  // MU_CHANGE [BEGIN] - Queue several bulk transfers
+  Xhc->BulkQueue.Revision     = EDKII_USB_BULK_QUEUE_PROTOCOL_REVISION;
+  Xhc->BulkQueue.BulkTransfer = XhcBulkQueueTransfer;
+  InitializeListHead (&Xhc->QueuedUrbs);
+  // MU_CHANGE [END]
 
   //
   // Be caution that the Offset passed to XhcReadCapReg() should be Dword align
   //
   Xhc->CapLength        = XhcReadCapReg8 (Xhc, XHC_CAPLENGTH_OFFSET);
+  Xhc->HciVersion       = (UINT16)(XhcReadCapReg (Xhc, XHC_CAPLENGTH_OFFSET) >> 16); // MU_CHANGE
   Xhc->HcSParams1.Dword = XhcReadCapReg (Xhc, XHC_HCSPARAMS1_OFFSET);
   Xhc->HcSParams2.Dword = XhcReadCapReg (Xhc, XHC_HCSPARAMS2_OFFSET);
   Xhc->HcCParams.Dword  = XhcReadCapReg (Xhc, XHC_HCCPARAMS_OFFSET);
@@ -1926,6 +2028,7 @@ XhcExitBootService (
   // and uninstall the XHCI protocl.
   //
   gBS->SetTimer (Xhc->PollTimer, TimerCancel, 0);
+  XhcPollReport (&Xhc->Poll);  // MU_CHANGE
   XhcHaltHC (Xhc, XHC_GENERIC_TIMEOUT);
 
   if (Xhc->PollTimer != NULL) {
@@ -2099,6 +2202,7 @@ XhcDriverBindingStart (
   //
   // Start the asynchronous interrupt monitor
   //
+  XhcPollWake (&Xhc->Poll); // MU_CHANGE
   Status = gBS->SetTimer (Xhc->PollTimer, TimerPeriodic, XHC_ASYNC_TIMER_INTERVAL);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "XhcDriverBindingStart: failed to start async interrupt monitor\n"));
@@ -2140,12 +2244,16 @@ XhcDriverBindingStart (
     FALSE
     );
 
-  Status = gBS->InstallProtocolInterface (
+  // MU_CHANGE [BEGIN] - Queue several bulk transfers
+  Status = gBS->InstallMultipleProtocolInterfaces (
                   &Controller,
                   &gEfiUsb2HcProtocolGuid,
-                  EFI_NATIVE_INTERFACE,
-                  &Xhc->Usb2Hc
+                  &Xhc->Usb2Hc,
+                  &gEdkiiUsb2HcBulkQueueProtocolGuid,
+                  &Xhc->BulkQueue,
+                  NULL
                   );
+  // MU_CHANGE [END]
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "XhcDriverBindingStart: failed to install USB2_HC Protocol\n"));
     goto FREE_POOL;
@@ -2228,17 +2336,22 @@ XhcDriverBindingStop (
     return Status;
   }
 
-  Status = gBS->UninstallProtocolInterface (
+  // MU_CHANGE [BEGIN] - Queue several bulk transfers
+  Xhc    = XHC_FROM_THIS (Usb2Hc);
+  Status = gBS->UninstallMultipleProtocolInterfaces (
                   Controller,
                   &gEfiUsb2HcProtocolGuid,
-                  Usb2Hc
+                  Usb2Hc,
+                  &gEdkiiUsb2HcBulkQueueProtocolGuid,
+                  &Xhc->BulkQueue,
+                  NULL
                   );
+  // MU_CHANGE [END]
 
   if (EFI_ERROR (Status)) {
     return Status;
   }
 
-  Xhc   = XHC_FROM_THIS (Usb2Hc);
   PciIo = Xhc->PciIo;
 
   //
@@ -2246,6 +2359,7 @@ XhcDriverBindingStop (
   // and uninstall the XHCI protocl.
   //
   gBS->SetTimer (Xhc->PollTimer, TimerCancel, 0);
+  XhcPollReport (&Xhc->Poll);  // MU_CHANGE
 
   //
   // Disable the device slots occupied by these devices on its downstream ports.
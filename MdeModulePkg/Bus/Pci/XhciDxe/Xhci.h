@@ -16,6 +16,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include <Protocol/Usb2HostController.h>
 #include <Protocol/PciIo.h>
+#include <Protocol/UsbBulkQueue.h> // MU_CHANGE
 
 #include <Guid/EventGroup.h>
 
@@ -39,6 +40,8 @@ typedef struct _USB_DEV_CONTEXT    USB_DEV_CONTEXT;
 #include "XhciSched.h"
 #include "ComponentName.h"
 #include "UsbHcMem.h"
+#include "XhciPoll.h" // MU_CHANGE
+#include "XhciBulk.h" // MU_CHANGE
 
 //
 // Converts a count from microseconds to nanoseconds
@@ -104,6 +107,8 @@ typedef struct _USB_DEV_CONTEXT    USB_DEV_CONTEXT;
 
 #define XHCI_INSTANCE_SIG  SIGNATURE_32 ('x', 'h', 'c', 'i')
 #define XHC_FROM_THIS(a)  CR(a, USB_XHCI_INSTANCE, Usb2Hc, XHCI_INSTANCE_SIG)
+// MU_CHANGE - Queue several bulk transfers
+#define XHC_FROM_BULK_QUEUE(a)  CR(a, USB_XHCI_INSTANCE, BulkQueue, XHCI_INSTANCE_SIG)
 
 #define USB_DESC_TYPE_HUB              0x29
 #define USB_DESC_TYPE_HUB_SUPER_SPEED  0x2a
@@ -208,6 +213,13 @@ struct _USB_XHCI_INSTANCE {
   USBHC_MEM_POOL              *MemPool;
 
   EFI_USB2_HC_PROTOCOL        Usb2Hc;
+  // MU_CHANGE [BEGIN] - Queue several bulk transfers
+  EDKII_USB2_HC_BULK_QUEUE_PROTOCOL    BulkQueue;
+  //
+  // URBs of the bulk queue being executed
+  //
+  LIST_ENTRY                           QueuedUrbs;
+  // MU_CHANGE [END]
 
   EFI_DEVICE_PATH_PROTOCOL    *DevicePath;
 
@@ -217,9 +229,11 @@ struct _USB_XHCI_INSTANCE {
   //
   EFI_EVENT                   ExitBootServiceEvent;
   EFI_EVENT                   PollTimer;
+  XHC_POLL_STATE              Poll; // MU_CHANGE - Adaptive async transfer timer
   LIST_ENTRY                  AsyncIntTransfers;
 
   UINT8                       CapLength;  ///< Capability Register Length
+  UINT16                      HciVersion; ///< Interface Version Number // MU_CHANGE
   XHC_HCSPARAMS1              HcSParams1; ///< Structural Parameters 1
   XHC_HCSPARAMS2              HcSParams2; ///< Structural Parameters 2
   XHC_HCCPARAMS               HcCParams;  ///< Capability Parameters
@@ -564,6 +578,42 @@ XhcBulkTransfer (
   OUT    UINT32                              *TransferResult
   );
 
+// MU_CHANGE [BEGIN] - Queue several bulk transfers
+
+/**
+  Queue bulk transfers to the endpoints of a USB device and wait for them.
+
+  @param  This                  This EDKII_USB2_HC_BULK_QUEUE_PROTOCOL instance.
+  @param  DeviceAddress         Target device address.
+  @param  DeviceSpeed           Device speed, Low speed device doesn't support bulk
+                                transfer.
+  @param  Count                 Number of transfers.
+  @param  Transfers             The transfers to queue.
+  @param  Timeout               Indicates the maximum time, in millisecond, which
+                                the transfers are allowed to complete.
+  @param  Translator            A pointr to the transaction translator data.
+
+  @retval EFI_SUCCESS           All the transfers completed successfully.
+  @retval EFI_INVALID_PARAMETER Some parameters are invalid.
+  @retval EFI_OUT_OF_RESOURCES  The transfers could not be queued.
+  @retval EFI_TIMEOUT           The transfers failed due to timeout.
+  @retval EFI_DEVICE_ERROR      A transfer failed due to host controller or device error.
+
+**/
+EFI_STATUS
+EFIAPI
+XhcBulkQueueTransfer (
+  IN     EDKII_USB2_HC_BULK_QUEUE_PROTOCOL   *This,
+  IN     UINT8                               DeviceAddress,
+  IN     UINT8                               DeviceSpeed,
+  IN     UINTN                               Count,
+  IN OUT EDKII_USB_BULK_QUEUE_TRANSFER       *Transfers,
+  IN     UINTN                               Timeout,
+  IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR  *Translator
+  );
+
+// MU_CHANGE [END]
+
 /**
   Submits an asynchronous interrupt transfer to an
   interrupt endpoint of a USB device.
@@ -0,0 +1,115 @@
+/** @file
+  Chained TDs of the XHCI bulk transfers.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "Xhci.h"
+
+/**
+  Fill a Normal TRB of a chained bulk TD. The cycle bit is left to the caller.
+
+  @param[out] Trb         The TRB.
+  @param[in]  DataPhy     The PCI address of the data of the transfer.
+  @param[in]  DataLen     The length of the data of the transfer.
+  @param[in]  Offset      The offset of the data of the TRB in the transfer.
+  @param[in]  MaxPacket   The maximum packet size of the endpoint.
+  @param[in]  HciVersion  The version of the xHCI specification of the controller.
+
+  @return The number of bytes of the data of the TRB.
+
+**/
+UINTN
+XhcInitChainedBulkTrb (
+  OUT TRANSFER_TRB_NORMAL   *Trb,
+  IN  EFI_PHYSICAL_ADDRESS  DataPhy,
+  IN  UINTN                 DataLen,
+  IN  UINTN                 Offset,
+  IN  UINTN                 MaxPacket,
+  IN  UINT16                HciVersion
+  )
+{
+  UINTN  Len;
+  UINTN  Remaining;
+  UINTN  TdSize;
+
+  ASSERT (Offset < DataLen);
+
+  MaxPacket = MAX (MaxPacket, 1);
+  Len       = SIZE_64KB - (UINTN)((DataPhy + Offset) & (SIZE_64KB - 1));
+  if (Len > DataLen - Offset) {
+    Len = DataLen - Offset;
+  }
+
+  //
+  // TD Size is the number of packets of the TD after this TRB, or the number
+  // of KB after it for controllers older than xHCI 1.0.
+  //
+  Remaining = DataLen - Offset - Len;
+  if (Remaining == 0) {
+    TdSize = 0;
+  } else if (HciVersion < 0x100) {
+    TdSize = Remaining >> 10;
+  } else {
+    TdSize = (DataLen + MaxPacket - 1) / MaxPacket - (Offset + Len) / MaxPacket;
+  }
+
+  Trb->TRBPtrLo  = XHC_LOW_32BIT (DataPhy + Offset);
+  Trb->TRBPtrHi  = XHC_HIGH_32BIT (DataPhy + Offset);
+  Trb->Length    = (UINT32)Len;
+  Trb->TDSize    = (UINT32)MIN (TdSize, 31);
+  Trb->IntTarget = 0;
+  Trb->ISP       = 1;
+  Trb->CH        = (Remaining != 0) ? 1 : 0;
+  Trb->IOC       = (Remaining == 0) ? 1 : 0;
+  Trb->Type      = TRB_TYPE_NORMAL;
+
+  return Len;
+}
+
+/**
+  Get the number of bytes that a chained bulk TD transferred, from the
+  transfer event that ended it.
+
+  @param[in] Ring      The transfer ring of the TD.
+  @param[in] TrbStart  The first TRB of the TD.
+  @param[in] TrbNum    The number of TRBs of the TD.
+  @param[in] Trb       The TRB that the event reports.
+  @param[in] Residual  The number of bytes of Trb that were not transferred.
+
+  @return The number of bytes transferred.
+
+**/
+UINTN
+XhcGetChainedBulkCompleted (
+  IN TRANSFER_RING  *Ring,
+  IN TRB_TEMPLATE   *TrbStart,
+  IN UINTN          TrbNum,
+  IN TRB_TEMPLATE   *Trb,
+  IN UINT32         Residual
+  )
+{
+  TRB_TEMPLATE  *CheckedTrb;
+  UINTN         Index;
+  UINTN         Completed;
+
+  Completed  = 0;
+  CheckedTrb = TrbStart;
+  for (Index = 0; (Index < TrbNum) && (CheckedTrb != Trb); Index++) {
+    Completed += ((TRANSFER_TRB_NORMAL *)CheckedTrb)->Length;
+    CheckedTrb++;
+    //
+    // The Link TRB at the end of a transfer ring points back to its start.
+    //
+    if (CheckedTrb->Type == TRB_TYPE_LINK) {
+      CheckedTrb = (TRB_TEMPLATE *)Ring->RingSeg0;
+    }
+  }
+
+  ASSERT (CheckedTrb == Trb);
+  ASSERT (Residual <= ((TRANSFER_TRB_NORMAL *)Trb)->Length);
+
+  return Completed + ((TRANSFER_TRB_NORMAL *)Trb)->Length - Residual;
+}
@@ -0,0 +1,62 @@
+/** @file
+  Chained TDs of the XHCI bulk transfers.
+
+  The TRBs of a bulk transfer are chained into a single TD, so that a short
+  packet ends the whole transfer and only the last TRB interrupts. The buffer
+  of a TRB must not cross a 64KB boundary, so a transfer takes a TRB per 64KB
+  boundary it crosses.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _EFI_XHCI_BULK_H_
+#define _EFI_XHCI_BULK_H_
+
+/**
+  Fill a Normal TRB of a chained bulk TD. The cycle bit is left to the caller.
+
+  @param[out] Trb         The TRB.
+  @param[in]  DataPhy     The PCI address of the data of the transfer.
+  @param[in]  DataLen     The length of the data of the transfer.
+  @param[in]  Offset      The offset of the data of the TRB in the transfer.
+  @param[in]  MaxPacket   The maximum packet size of the endpoint.
+  @param[in]  HciVersion  The version of the xHCI specification of the controller.
+
+  @return The number of bytes of the data of the TRB.
+
+**/
+UINTN
+XhcInitChainedBulkTrb (
+  OUT TRANSFER_TRB_NORMAL   *Trb,
+  IN  EFI_PHYSICAL_ADDRESS  DataPhy,
+  IN  UINTN                 DataLen,
+  IN  UINTN                 Offset,
+  IN  UINTN                 MaxPacket,
+  IN  UINT16                HciVersion
+  );
+
+/**
+  Get the number of bytes that a chained bulk TD transferred, from the
+  transfer event that ended it.
+
+  @param[in] Ring      The transfer ring of the TD.
+  @param[in] TrbStart  The first TRB of the TD.
+  @param[in] TrbNum    The number of TRBs of the TD.
+  @param[in] Trb       The TRB that the event reports.
+  @param[in] Residual  The number of bytes of Trb that were not transferred.
+
+  @return The number of bytes transferred.
+
+**/
+UINTN
+XhcGetChainedBulkCompleted (
+  IN TRANSFER_RING  *Ring,
+  IN TRB_TEMPLATE   *TrbStart,
+  IN UINTN          TrbNum,
+  IN TRB_TEMPLATE   *Trb,
+  IN UINT32         Residual
+  );
+
+#endif
@@ -0,0 +1,150 @@
+/** @file
+  Adaptive period of the XHCI async transfer timer.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "Xhci.h"
+
+/**
+  Initialize the state of the async transfer timer, cancelled.
+
+  @param[out] Poll  The state of the timer.
+
+**/
+VOID
+XhcPollInitialize (
+  OUT XHC_POLL_STATE  *Poll
+  )
+{
+  ZeroMem (Poll, sizeof (XHC_POLL_STATE));
+}
+
+/**
+  Count the new events of an event ring, without consuming them.
+
+  @param[in] EvtRing  The event ring.
+
+  @return The number of events that the controller wrote after the dequeue
+          pointer of the ring.
+
+**/
+UINTN
+XhcPollCountEvents (
+  IN EVENT_RING  *EvtRing
+  )
+{
+  TRB_TEMPLATE  *EvtTrb;
+  TRB_TEMPLATE  *RingEnd;
+  UINT32        Ccs;
+  UINTN         Count;
+  UINTN         Index;
+
+  //
+  // The events between the dequeue and enqueue pointers were found by the
+  // last XhcSyncEventRing() and are not consumed yet. EventRingCCS is the
+  // cycle state of the TRB at the enqueue pointer.
+  //
+  if (EvtRing->EventRingEnqueue >= EvtRing->EventRingDequeue) {
+    Count = EvtRing->EventRingEnqueue - EvtRing->EventRingDequeue;
+  } else {
+    Count = EvtRing->TrbNumber - (EvtRing->EventRingDequeue - EvtRing->EventRingEnqueue);
+  }
+
+  EvtTrb  = EvtRing->EventRingEnqueue;
+  RingEnd = (TRB_TEMPLATE *)EvtRing->EventRingSeg0 + EvtRing->TrbNumber;
+  Ccs     = EvtRing->EventRingCCS;
+
+  for (Index = Count; Index < EvtRing->TrbNumber; Index++) {
+    if (EvtTrb->CycleBit != Ccs) {
+      break;
+    }
+
+    Count++;
+    EvtTrb++;
+    if (EvtTrb >= RingEnd) {
+      EvtTrb = EvtRing->EventRingSeg0;
+      Ccs   ^= 1;
+    }
+  }
+
+  return Count;
+}
+
+/**
+  Account for a tick of the async transfer timer and compute its next period.
+
+  The timer keeps its shortest period while there is an async transfer, idle
+  or not, so that the next report of an idle device is not picked up late.
+
+  @param[in, out] Poll         The state of the timer.
+  @param[in]      AsyncActive  TRUE if there is an async transfer after the tick.
+  @param[in]      Events       The number of new events found by the tick.
+
+  @return The next period of the timer in 100ns units, zero to cancel it.
+
+**/
+UINT64
+XhcPollTick (
+  IN OUT XHC_POLL_STATE  *Poll,
+  IN     BOOLEAN         AsyncActive,
+  IN     UINTN           Events
+  )
+{
+  Poll->Statistics.Ticks++;
+  Poll->Statistics.EventsHandled += Events;
+  if (Events == 0) {
+    Poll->Statistics.IdleTicks++;
+  } else if (Events > Poll->Statistics.MaxEventsPerTick) {
+    Poll->Statistics.MaxEventsPerTick = (UINT32)MIN (Events, MAX_UINT32);
+  }
+
+  Poll->Interval = AsyncActive ? XHC_ASYNC_TIMER_INTERVAL : 0;
+  return Poll->Interval;
+}
+
+/**
+  Return the async transfer timer to its shortest period, when an async
+  transfer is submitted.
+
+  @param[in, out] Poll  The state of the timer.
+
+  @retval TRUE   The period changed and the timer must be set again.
+  @retval FALSE  The timer already runs at its shortest period.
+
+**/
+BOOLEAN
+XhcPollWake (
+  IN OUT XHC_POLL_STATE  *Poll
+  )
+{
+  if (Poll->Interval == XHC_ASYNC_TIMER_INTERVAL) {
+    return FALSE;
+  }
+
+  Poll->Interval = XHC_ASYNC_TIMER_INTERVAL;
+  return TRUE;
+}
+
+/**
+  Print the counters of the async transfer timer.
+
+  @param[in] Poll  The state of the timer.
+
+**/
+VOID
+XhcPollReport (
+  IN XHC_POLL_STATE  *Poll
+  )
+{
+  DEBUG ((
+    DEBUG_INFO,
+    "XhcPollReport: async timer ticks %Lu, idle %Lu, events %Lu, max events per tick %u\n",
+    Poll->Statistics.Ticks,
+    Poll->Statistics.IdleTicks,
+    Poll->Statistics.EventsHandled,
+    Poll->Statistics.MaxEventsPerTick
+    ));
+}
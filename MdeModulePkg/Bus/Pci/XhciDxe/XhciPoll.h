@@ -0,0 +1,108 @@
+/** @file
+  Adaptive period of the XHCI async transfer timer.
+
+  UEFI drivers cannot take the interrupts of the controller, so the events of
+  the async interrupt transfers are harvested by a periodic timer. The timer
+  runs every XHC_ASYNC_TIMER_INTERVAL while there is an async transfer, so that
+  a report waits at most XHC_ASYNC_TIMER_INTERVAL. It is cancelled while there
+  is no async transfer and armed again when one is submitted.
+
+  Each tick first looks for new events in the event ring, in memory, and only
+  checks the async transfers when there is one. The ticks and the events they
+  find are counted, and the counters are printed when the controller stops.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _EFI_XHCI_POLL_H_
+#define _EFI_XHCI_POLL_H_
+
+///
+/// Counters of the async transfer timer.
+///
+typedef struct {
+  UINT64    Ticks;                 ///< Ticks of the timer.
+  UINT64    IdleTicks;             ///< Ticks that found no new event.
+  UINT64    EventsHandled;         ///< Events found by the ticks.
+  UINT32    MaxEventsPerTick;      ///< Most events found by one tick.
+} XHC_POLL_STATISTICS;
+
+///
+/// State of the async transfer timer.
+///
+typedef struct {
+  UINT64                 Interval;      ///< Period of the timer in 100ns units, zero if cancelled.
+  XHC_POLL_STATISTICS    Statistics;
+} XHC_POLL_STATE;
+
+/**
+  Initialize the state of the async transfer timer, cancelled.
+
+  @param[out] Poll  The state of the timer.
+
+**/
+VOID
+XhcPollInitialize (
+  OUT XHC_POLL_STATE  *Poll
+  );
+
+/**
+  Count the new events of an event ring, without consuming them.
+
+  @param[in] EvtRing  The event ring.
+
+  @return The number of events that the controller wrote after the dequeue
+          pointer of the ring.
+
+**/
+UINTN
+XhcPollCountEvents (
+  IN EVENT_RING  *EvtRing
+  );
+
+/**
+  Account for a tick of the async transfer timer and compute its next period.
+
+  @param[in, out] Poll         The state of the timer.
+  @param[in]      AsyncActive  TRUE if there is an async transfer after the tick.
+  @param[in]      Events       The number of new events found by the tick.
+
+  @return The next period of the timer in 100ns units, zero to cancel it.
+
+**/
+UINT64
+XhcPollTick (
+  IN OUT XHC_POLL_STATE  *Poll,
+  IN     BOOLEAN         AsyncActive,
+  IN     UINTN           Events
+  );
+
+/**
+  Return the async transfer timer to its shortest period, when an async
+  transfer is submitted.
+
+  @param[in, out] Poll  The state of the timer.
+
+  @retval TRUE   The period changed and the timer must be set again.
+  @retval FALSE  The timer already runs at its shortest period.
+
+**/
+BOOLEAN
+XhcPollWake (
+  IN OUT XHC_POLL_STATE  *Poll
+  );
+
+/**
+  Print the counters of the async transfer timer.
+
+  @param[in] Poll  The state of the timer.
+
+**/
+VOID
+XhcPollReport (
+  IN XHC_POLL_STATE  *Poll
+  );
+
+#endif
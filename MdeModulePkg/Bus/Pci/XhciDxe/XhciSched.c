@@ -233,6 +233,7 @@ XhcCreateTransferTrb (
   EFI_PHYSICAL_ADDRESS           PhyAddr;
   VOID                           *Map;
   EFI_STATUS                     Status;
+  UINTN                          MaxPacket; // MU_CHANGE
 
   SlotId = XhcBusDevAddrToSlotId (Xhc, Urb->Ep.BusAddr);
   if (SlotId == 0) {
@@ -386,6 +387,43 @@ XhcCreateTransferTrb (
 
     case ED_BULK_OUT:
     case ED_BULK_IN:
+      // MU_CHANGE [BEGIN] - Chain the TRBs of a bulk transfer into one TD
+      if (FeaturePcdGet (PcdXhciChainedBulkTd)) {
+        if (Xhc->HcCParams.Data.Csz == 0) {
+          MaxPacket = ((DEVICE_CONTEXT *)OutputContext)->EP[Dci-1].MaxPacketSize;
+        } else {
+          MaxPacket = ((DEVICE_CONTEXT_64 *)OutputContext)->EP[Dci-1].MaxPacketSize;
+        }
+
+        TotalLen = 0;
+        TrbNum   = 0;
+        TrbStart = (TRB *)(UINTN)EPRing->RingEnqueue;
+        while (TotalLen < Urb->DataLen) {
+          TrbStart  = (TRB *)(UINTN)EPRing->RingEnqueue;
+          TotalLen += XhcInitChainedBulkTrb (
+                        &TrbStart->TrbNormal,
+                        (EFI_PHYSICAL_ADDRESS)(UINTN)Urb->DataPhy,
+                        Urb->DataLen,
+                        TotalLen,
+                        MaxPacket,
+                        Xhc->HciVersion
+                        );
+          //
+          // Update the cycle bit
+          //
+          TrbStart->TrbNormal.CycleBit = EPRing->RingPCS & BIT0;
+
+          XhcSyncTrsRing (Xhc, EPRing);
+          TrbNum++;
+        }
+
+        Urb->TrbNum  = TrbNum;
+        Urb->TrbEnd  = (TRB_TEMPLATE *)(UINTN)TrbStart;
+        Urb->Chained = TRUE;
+        break;
+      }
+
+      // MU_CHANGE [END]
       TotalLen = 0;
       Len      = 0;
       TrbNum   = 0;
@@ -1115,6 +1153,41 @@ IsAsyncIntTrb (
   return FALSE;
 }
 
+// MU_CHANGE [BEGIN] - Queue several bulk transfers
+/**
+  Check if the Trb is a transaction of the URBs of a bulk queue.
+
+  @param Xhc    The XHCI Instance.
+  @param Trb    The TRB to be checked.
+  @param Urb    The pointer to the matched Urb.
+
+  @retval TRUE  The Trb is matched with a transaction of the queued URBs.
+  @retval FALSE The Trb is not matched with any queued URB.
+
+**/
+BOOLEAN
+IsQueuedUrbTrb (
+  IN  USB_XHCI_INSTANCE  *Xhc,
+  IN  TRB_TEMPLATE       *Trb,
+  OUT URB                **Urb
+  )
+{
+  LIST_ENTRY  *Entry;
+  URB         *CheckedUrb;
+
+  BASE_LIST_FOR_EACH (Entry, &Xhc->QueuedUrbs) {
+    CheckedUrb = EFI_LIST_CONTAINER (Entry, URB, UrbList);
+    if (IsTransferRingTrb (Xhc, Trb, CheckedUrb)) {
+      *Urb = CheckedUrb;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+// MU_CHANGE [END]
+
 /**
   Check the URB's execution result and update the URB's
   result accordingly.
@@ -1197,12 +1270,25 @@ XhcCheckUrbResult (
       CheckedUrb = Urb;
     } else if (IsAsyncIntTrb (Xhc, TRBPtr, &AsyncUrb)) {
       CheckedUrb = AsyncUrb;
+    } else if (IsQueuedUrbTrb (Xhc, TRBPtr, &AsyncUrb)) {
+      CheckedUrb = AsyncUrb;                        // MU_CHANGE - Queue several bulk transfers
     } else {
       continue;
     }
 
     CheckedUrb->Ring->RingDequeue = TRBPtr;         // MU_CHANGE - 274185
 
+    // MU_CHANGE [BEGIN] - Chain the TRBs of a bulk transfer into one TD
+    //
+    // Some hosts report the last TRB of a chained TD again after a short
+    // packet ended the TD.
+    //
+    if (CheckedUrb->Chained && CheckedUrb->Finished) {
+      continue;
+    }
+
+    // MU_CHANGE [END]
+
     switch (EvtTrb->Completecode) {
       case TRB_COMPLETION_STALL_ERROR:
         CheckedUrb->Result  |= EFI_USB_ERR_STALL;
@@ -1249,6 +1335,26 @@ XhcCheckUrbResult (
         // }
         // MU_CHANGE [END]
 
+        // MU_CHANGE [BEGIN] - Chain the TRBs of a bulk transfer into one TD
+        //
+        // Only the last TRB of a chained TD and a TRB that received a short
+        // packet report an event, and either one ends the TD.
+        //
+        if (CheckedUrb->Chained) {
+          CheckedUrb->Completed = XhcGetChainedBulkCompleted (
+                                    CheckedUrb->Ring,
+                                    CheckedUrb->TrbStart,
+                                    CheckedUrb->TrbNum,
+                                    TRBPtr,
+                                    EvtTrb->Length
+                                    );
+          CheckedUrb->Finished = TRUE;
+          CheckedUrb->EvtTrb   = (TRB_TEMPLATE *)EvtTrb;
+          continue;
+        }
+
+        // MU_CHANGE [END]
+
         TRBType = (UINT8)(TRBPtr->Type);
         if ((TRBType == TRB_TYPE_DATA_STAGE) ||
             (TRBType == TRB_TYPE_NORMAL) ||
@@ -1397,6 +1503,235 @@ XhcExecTransfer (
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - Queue several bulk transfers
+/**
+  Queue bulk transfers to the endpoints of a device and poll them until all of
+  them complete, one of them fails or the queue times out.
+
+  The TDs of all the transfers are written to the transfer rings before any
+  doorbell is rung, so the host controller never fetches a partial TD. The
+  transfers that did not complete when a transfer fails or the queue times
+  out are removed from the transfer rings.
+
+  @param  Xhc               The XHCI Instance.
+  @param  BusAddr           The logical device address assigned by UsbBus driver.
+  @param  DevSpeed          The device speed.
+  @param  Count             The number of transfers.
+  @param  Transfers         The transfers to queue.
+  @param  Timeout           The time to wait before abort, in millisecond.
+
+  @return EFI_SUCCESS           All the transfers completed.
+  @return EFI_INVALID_PARAMETER An endpoint is not a bulk endpoint of the device.
+  @return EFI_OUT_OF_RESOURCES  The transfers could not be queued.
+  @return EFI_TIMEOUT           The transfers did not complete in time.
+  @return EFI_DEVICE_ERROR      A transfer failed.
+
+**/
+EFI_STATUS
+XhcExecBulkQueue (
+  IN     USB_XHCI_INSTANCE              *Xhc,
+  IN     UINT8                          BusAddr,
+  IN     UINT8                          DevSpeed,
+  IN     UINTN                          Count,
+  IN OUT EDKII_USB_BULK_QUEUE_TRANSFER  *Transfers,
+  IN     UINTN                          Timeout
+  )
+{
+  URB         *Urbs[EDKII_USB_BULK_QUEUE_MAX_TRANSFERS];
+  URB         *Urb;
+  EFI_STATUS  Status;
+  UINT8       SlotId;
+  UINT8       Dci;
+  UINT8       EPType;
+  UINTN       TrbCount[32];
+  UINT32      StoppedEndpoints;
+  UINTN       Index;
+  UINTN       Created;
+  UINTN       Pending;
+  BOOLEAN     Failed;
+  BOOLEAN     TimedOut;
+  UINT64      TimeoutTicks;
+  UINT64      ElapsedTicks;
+  UINT64      TicksDelta;
+  UINT64      CurrentTick;
+
+  ASSERT (Count <= EDKII_USB_BULK_QUEUE_MAX_TRANSFERS);
+
+  SlotId = XhcBusDevAddrToSlotId (Xhc, BusAddr);
+  if (SlotId == 0) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // Every endpoint must be a bulk endpoint whose transfer ring holds the TRBs
+  // of all its transfers. A transfer takes a TRB per 64KB of data, or per
+  // 64KB boundary it crosses when its TRBs are chained.
+  //
+  ZeroMem (TrbCount, sizeof (TrbCount));
+  for (Index = 0; Index < Count; Index++) {
+    Dci = XhcEndpointToDci (
+            (UINT8)(Transfers[Index].EndpointAddress & 0x0F),
+            (UINT8)(((Transfers[Index].EndpointAddress & 0x80) != 0) ? EfiUsbDataIn : EfiUsbDataOut)
+            );
+    if ((Dci >= 32) || (Xhc->UsbDevContext[SlotId].EndpointTransferRing[Dci - 1] == NULL)) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    if (Xhc->HcCParams.Data.Csz == 0) {
+      EPType = (UINT8)((DEVICE_CONTEXT *)Xhc->UsbDevContext[SlotId].OutputContext)->EP[Dci - 1].EPType;
+    } else {
+      EPType = (UINT8)((DEVICE_CONTEXT_64 *)Xhc->UsbDevContext[SlotId].OutputContext)->EP[Dci - 1].EPType;
+    }
+
+    if ((EPType != ED_BULK_IN) && (EPType != ED_BULK_OUT)) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    TrbCount[Dci] += Transfers[Index].DataLength / SIZE_64KB + 2;
+    if (TrbCount[Dci] > TR_RING_TRB_NUMBER - 2) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  //
+  // The maximum packet size is taken from the endpoint context.
+  //
+  Status = EFI_SUCCESS;
+  for (Created = 0; Created < Count; Created++) {
+    Urb = XhcCreateUrb (
+            Xhc,
+            BusAddr,
+            Transfers[Created].EndpointAddress,
+            DevSpeed,
+            0,
+            XHC_BULK_TRANSFER,
+            NULL,
+            Transfers[Created].Data,
+            Transfers[Created].DataLength,
+            NULL,
+            NULL
+            );
+    if (Urb == NULL) {
+      DEBUG ((DEBUG_ERROR, "XhcExecBulkQueue: failed to create URB %Lu!\n", (UINT64)Created));
+      Status = EFI_OUT_OF_RESOURCES;
+      break;
+    }
+
+    Urbs[Created] = Urb;
+    InsertTailList (&Xhc->QueuedUrbs, &Urb->UrbList);
+  }
+
+  Failed   = FALSE;
+  TimedOut = FALSE;
+  if (!EFI_ERROR (Status)) {
+    for (Index = 0; Index < Created; Index++) {
+      XhcRingDoorBell (Xhc, SlotId, XhcEndpointToDci (Urbs[Index]->Ep.EpAddr, (UINT8)(Urbs[Index]->Ep.Direction)));
+    }
+
+    TimeoutTicks = XhcConvertTimeToTicks (
+                     XHC_MICROSECOND_TO_NANOSECOND (
+                       Timeout * XHC_1_MILLISECOND
+                       )
+                     );
+    ElapsedTicks = 0;
+    CurrentTick  = GetPerformanceCounter ();
+
+    do {
+      Pending = 0;
+      for (Index = 0; Index < Created; Index++) {
+        Urb = Urbs[Index];
+        if (!Urb->Finished) {
+          XhcCheckUrbResult (Xhc, Urb);
+        }
+
+        if (!Urb->Finished) {
+          Pending++;
+        } else if (Urb->Result != EFI_USB_NOERROR) {
+          Failed = TRUE;
+        }
+      }
+
+      if ((Pending == 0) || Failed) {
+        break;
+      }
+
+      gBS->Stall (XHC_1_MICROSECOND);
+      TicksDelta = XhcGetElapsedTicks (&CurrentTick);
+      if (TicksDelta == 0) {
+        TicksDelta = XhcConvertTimeToTicks (XHC_MICROSECOND_TO_NANOSECOND (XHC_1_MICROSECOND));
+      }
+
+      ElapsedTicks += TicksDelta;
+    } while ((Timeout == 0) || (ElapsedTicks < TimeoutTicks));
+
+    TimedOut = (BOOLEAN)((Pending != 0) && !Failed);
+  }
+
+  //
+  // A transfer that halted its endpoint is recovered, which also removes the
+  // transfers queued after it. The other endpoints with pending transfers are
+  // stopped and their remaining TDs removed, checking the last pending transfer
+  // of each endpoint in case it completes meanwhile.
+  //
+  StoppedEndpoints = 0;
+  for (Index = 0; Index < Created; Index++) {
+    Urb = Urbs[Index];
+    if ((Urb->Result == EFI_USB_ERR_STALL) || (Urb->Result == EFI_USB_ERR_BABBLE) || (Urb->Result == EDKII_USB_ERR_TRANSACTION)) {
+      if (EFI_ERROR (XhcRecoverHaltedEndpoint (Xhc, Urb))) {
+        DEBUG ((DEBUG_ERROR, "XhcExecBulkQueue: XhcRecoverHaltedEndpoint failed!\n"));
+      }
+
+      StoppedEndpoints |= (UINT32)1 << XhcEndpointToDci (Urb->Ep.EpAddr, (UINT8)(Urb->Ep.Direction));
+    }
+  }
+
+  for (Index = Created; Index > 0; Index--) {
+    Urb = Urbs[Index - 1];
+    Dci = XhcEndpointToDci (Urb->Ep.EpAddr, (UINT8)(Urb->Ep.Direction));
+    if (Urb->Finished || ((StoppedEndpoints & ((UINT32)1 << Dci)) != 0)) {
+      continue;
+    }
+
+    StoppedEndpoints |= (UINT32)1 << Dci;
+    if (EFI_ERROR (XhcDequeueTrbFromEndpoint (Xhc, Urb)) && (Urb->Result == EFI_USB_NOERROR)) {
+      DEBUG ((DEBUG_ERROR, "XhcExecBulkQueue: XhcDequeueTrbFromEndpoint failed!\n"));
+    }
+  }
+
+  //
+  // The transfers stopped because another one failed report that they were
+  // not executed.
+  //
+  for (Index = 0; Index < Created; Index++) {
+    Urb = Urbs[Index];
+    if (TimedOut) {
+      if (!Urb->Finished) {
+        Urb->Result = EFI_USB_ERR_TIMEOUT;
+      }
+    } else if (!Urb->Finished || (Urb->Result == EFI_USB_ERR_TIMEOUT)) {
+      Urb->Result = EFI_USB_ERR_NOTEXECUTE;
+    }
+
+    Transfers[Index].TransferResult = Urb->Result;
+    Transfers[Index].DataLength     = Urb->Completed;
+    if (!EFI_ERROR (Status) && (Urb->Result != EFI_USB_NOERROR)) {
+      Status = TimedOut ? EFI_TIMEOUT : EFI_DEVICE_ERROR;
+    }
+
+    RemoveEntryList (&Urb->UrbList);
+    XhcFreeUrb (Xhc, Urb);
+  }
+
+  for (Index = Created; Index < Count; Index++) {
+    Transfers[Index].DataLength = 0;
+  }
+
+  Xhc->PciIo->Flush (Xhc->PciIo);
+  return Status;
+}
+
+// MU_CHANGE [END]
+
 /**
   Delete a single asynchronous interrupt transfer for
   the device and endpoint.
@@ -1548,6 +1883,16 @@ XhciInsertAsyncIntTransfer (
   //
   InsertHeadList (&Xhc->AsyncIntTransfers, &Urb->UrbList);
 
+  // MU_CHANGE [BEGIN] - Adaptive async transfer timer
+  //
+  // Harvest the new transfer at the shortest period of the timer.
+  //
+  if (XhcPollWake (&Xhc->Poll)) {
+    gBS->SetTimer (Xhc->PollTimer, TimerPeriodic, Xhc->Poll.Interval);
+  }
+
+  // MU_CHANGE [END]
+
   return Urb;
 }
 
@@ -1656,11 +2001,23 @@ XhcMonitorAsyncRequests (
   UINT8              SlotId;
   EFI_STATUS         Status;
   EFI_TPL            OldTpl;
+  UINTN              Events;      // MU_CHANGE
+  UINT64             OldInterval; // MU_CHANGE
+  UINT64             Interval;    // MU_CHANGE
 
   OldTpl = gBS->RaiseTPL (XHC_TPL);
 
   Xhc = (USB_XHCI_INSTANCE *)Context;
 
+  // MU_CHANGE [BEGIN] - Adaptive async transfer timer
+  //
+  // The URBs only change with the events of the event ring, or when a
+  // synchronous transfer handles their events, so skip the checks of the
+  // URBs when there is no new event.
+  //
+  Events = XhcPollCountEvents (&Xhc->EventRing);
+  // MU_CHANGE [END]
+
   BASE_LIST_FOR_EACH_SAFE (Entry, Next, &Xhc->AsyncIntTransfers) {
     Urb = EFI_LIST_CONTAINER (Entry, URB, UrbList);
 
@@ -1676,7 +2033,12 @@ XhcMonitorAsyncRequests (
     // Check the result of URB execution. If it is still
     // active, check the next one.
     //
-    XhcCheckUrbResult (Xhc, Urb);
+    // MU_CHANGE [BEGIN] - Adaptive async transfer timer
+    if (Events != 0) {
+      XhcCheckUrbResult (Xhc, Urb);
+    }
+
+    // MU_CHANGE [END]
 
     if (!Urb->Finished) {
       continue;
@@ -1739,6 +2101,15 @@ XhcMonitorAsyncRequests (
 
     XhcUpdateAsyncRequest (Xhc, Urb);
   }
+
+  // MU_CHANGE [BEGIN] - Adaptive async transfer timer
+  OldInterval = Xhc->Poll.Interval;
+  Interval    = XhcPollTick (&Xhc->Poll, (BOOLEAN) !IsListEmpty (&Xhc->AsyncIntTransfers), Events);
+  if (Interval != OldInterval) {
+    gBS->SetTimer (Xhc->PollTimer, (Interval == 0) ? TimerCancel : TimerPeriodic, Interval);
+  }
+
+  // MU_CHANGE [END]
   gBS->RestoreTPL (OldTpl);
 }
 
@@ -2022,6 +2393,12 @@ XhcSyncTrsRing (
     TrsTrb++;
     if ((UINT8)TrsTrb->Type == TRB_TYPE_LINK) {
       ASSERT (((LINK_TRB *)TrsTrb)->TC != 0);
+      // MU_CHANGE [BEGIN] - Keep the chain of a TD across the Link TRB
+      //
+      // The Link TRB is part of the TD of the TRB before it if that one is chained.
+      //
+      ((LINK_TRB *)TrsTrb)->CH = ((TRANSFER_TRB_NORMAL *)(TrsTrb - 1))->CH;
+      // MU_CHANGE [END]
       //
       // set cycle bit in Link TRB as normal
       //
@@ -198,6 +198,7 @@ typedef struct _URB {
   BOOLEAN                            StartDone;
   BOOLEAN                            EndDone;
   BOOLEAN                            Finished;
+  BOOLEAN                            Chained;   // MU_CHANGE - TRBs chained into one TD
 
   TRB_TEMPLATE                       *EvtTrb;
 } URB;
@@ -1480,4 +1481,36 @@ XhcCreateTransferTrb (
   IN URB                *Urb
   );
 
+// MU_CHANGE [BEGIN] - Queue several bulk transfers
+
+/**
+  Queue bulk transfers to the endpoints of a device and poll them until all of
+  them complete, one of them fails or the queue times out.
+
+  @param  Xhc               The XHCI Instance.
+  @param  BusAddr           The logical device address assigned by UsbBus driver.
+  @param  DevSpeed          The device speed.
+  @param  Count             The number of transfers.
+  @param  Transfers         The transfers to queue.
+  @param  Timeout           The time to wait before abort, in millisecond.
+
+  @return EFI_SUCCESS           All the transfers completed.
+  @return EFI_INVALID_PARAMETER An endpoint is not a bulk endpoint of the device.
+  @return EFI_OUT_OF_RESOURCES  The transfers could not be queued.
+  @return EFI_TIMEOUT           The transfers did not complete in time.
+  @return EFI_DEVICE_ERROR      A transfer failed.
+
+**/
+EFI_STATUS
+XhcExecBulkQueue (
+  IN     USB_XHCI_INSTANCE              *Xhc,
+  IN     UINT8                          BusAddr,
+  IN     UINT8                          DevSpeed,
+  IN     UINTN                          Count,
+  IN OUT EDKII_USB_BULK_QUEUE_TRANSFER  *Transfers,
+  IN     UINTN                          Timeout
+  );
+
+// MU_CHANGE [END]
+
 #endif
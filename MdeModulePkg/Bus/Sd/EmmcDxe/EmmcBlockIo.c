@@ -820,6 +820,7 @@ EmmcReadWrite (
   UINTN               Remaining;
   UINT32              MaxBlock;
   BOOLEAN             LastRw;
+  EFI_TPL             OldTpl; // MU_CHANGE - Queue requests with ADMA3
 
   Status = EFI_SUCCESS;
   Device = Partition->Device;
@@ -890,6 +891,19 @@ EmmcReadWrite (
   Remaining = BlockNum;
   MaxBlock  = 0xFFFF;
 
+  // MU_CHANGE [BEGIN] - Queue requests with ADMA3
+  //
+  // Queue all the commands of a non-blocking request before the host controller
+  // driver looks at its queue again, so that each SET_BLOCK_COUNT is seen with
+  // the read or write that follows it.
+  //
+  OldTpl = TPL_APPLICATION;
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  }
+
+  // MU_CHANGE [END]
+
   while (Remaining > 0) {
     if (Remaining <= MaxBlock) {
       BlockNum = Remaining;
@@ -900,13 +914,13 @@ EmmcReadWrite (
 
     Status = EmmcSetBlkCount (Partition, (UINT16)BlockNum, Token, FALSE);
     if (EFI_ERROR (Status)) {
-      return Status;
+      break; // MU_CHANGE - Queue requests with ADMA3
     }
 
     BufferSize = BlockNum * BlockSize;
     Status     = EmmcRwMultiBlocks (Partition, Lba, Buffer, BufferSize, IsRead, Token, LastRw);
     if (EFI_ERROR (Status)) {
-      return Status;
+      break; // MU_CHANGE - Queue requests with ADMA3
     }
 
     DEBUG ((
@@ -925,6 +939,13 @@ EmmcReadWrite (
     Remaining -= BlockNum;
   }
 
+  // MU_CHANGE [BEGIN] - Queue requests with ADMA3
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    gBS->RestoreTPL (OldTpl);
+  }
+
+  // MU_CHANGE [END]
+
   return Status;
 }
 
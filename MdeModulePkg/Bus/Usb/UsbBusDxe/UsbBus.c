@@ -328,6 +328,97 @@ ON_EXIT:
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - Queue several bulk transfers
+
+/**
+  Queue bulk transfers to the endpoints of the interface and wait for them.
+
+  @param  This                   The USB IO bulk queue instance.
+  @param  Count                  Number of transfers.
+  @param  Transfers              The transfers to queue.
+  @param  Timeout                Time to wait before timeout.
+
+  @retval EFI_SUCCESS            All the transfers completed.
+  @retval EFI_INVALID_PARAMETER  Some parameters are invalid.
+  @retval Others                 Failed to execute the transfers, reason
+                                 returned in their TransferResult.
+
+**/
+EFI_STATUS
+EFIAPI
+UsbIoBulkQueueTransfer (
+  IN     EDKII_USB_IO_BULK_QUEUE_PROTOCOL  *This,
+  IN     UINTN                             Count,
+  IN OUT EDKII_USB_BULK_QUEUE_TRANSFER     *Transfers,
+  IN     UINTN                             Timeout
+  )
+{
+  USB_DEVICE         *Dev;
+  USB_INTERFACE      *UsbIf;
+  USB_ENDPOINT_DESC  *EpDesc;
+  EFI_TPL            OldTpl;
+  EFI_STATUS         Status;
+  UINTN              Index;
+
+  if ((Transfers == NULL) || (Count == 0) || (Count > EDKII_USB_BULK_QUEUE_MAX_TRANSFERS)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = gBS->RaiseTPL (USB_BUS_TPL);
+
+  UsbIf = USB_INTERFACE_FROM_BULK_QUEUE (This);
+  Dev   = UsbIf->Device;
+
+  if (Dev->Connected == FALSE) {
+    Status = EFI_DEVICE_ERROR;
+    DEBUG ((DEBUG_ERROR, "UsbIoBulkQueueTransfer No media\n"));
+    goto ON_EXIT;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    EpDesc = UsbGetEndpointDesc (UsbIf, Transfers[Index].EndpointAddress);
+
+    if ((USB_ENDPOINT_ADDR (Transfers[Index].EndpointAddress) == 0) ||
+        (EpDesc == NULL) || (USB_ENDPOINT_TYPE (&EpDesc->Desc) != USB_ENDPOINT_BULK))
+    {
+      Status = EFI_INVALID_PARAMETER;
+      goto ON_EXIT;
+    }
+  }
+
+  Status = Dev->Bus->BulkQueue->BulkTransfer (
+                                  Dev->Bus->BulkQueue,
+                                  Dev->Address,
+                                  Dev->Speed,
+                                  Count,
+                                  Transfers,
+                                  Timeout,
+                                  &Dev->Translator
+                                  );
+
+  if (EFI_ERROR (Status) && (Status != EFI_INVALID_PARAMETER)) {
+    //
+    // Clear the TRANSLATOR TT buffer as UsbIoBulkTransfer does.
+    //
+    ASSERT (Dev->Translator.TranslatorHubAddress < Dev->Bus->MaxDevices);
+    if (Dev->Translator.TranslatorHubAddress != 0) {
+      UsbHubCtrlClearTTBuffer (
+        Dev->Bus->Devices[Dev->Translator.TranslatorHubAddress],
+        Dev->Translator.TranslatorPortNumber,
+        Dev->Address,
+        0,
+        USB_ENDPOINT_BULK
+        );
+    }
+  }
+
+ON_EXIT:
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+// MU_CHANGE [END]
+
 /**
   Execute a synchronous interrupt transfer.
 
@@ -1102,6 +1193,27 @@ UsbBusBuildProtocol (
     if (UsbBus->Usb2Hc->MajorRevision == 0x3) {
       UsbBus->MaxDevices = 256;
     }
+
+    // MU_CHANGE [BEGIN] - Queue several bulk transfers
+    //
+    // The host controller driver installs the bulk queue protocol with
+    // EFI_USB2_HC_PROTOCOL and removes them together.
+    //
+    Status = gBS->OpenProtocol (
+                    Controller,
+                    &gEdkiiUsb2HcBulkQueueProtocolGuid,
+                    (VOID **)&UsbBus->BulkQueue,
+                    This->DriverBindingHandle,
+                    Controller,
+                    EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                    );
+    if (EFI_ERROR (Status) ||
+        (UsbBus->BulkQueue->Revision < EDKII_USB_BULK_QUEUE_PROTOCOL_REVISION))
+    {
+      UsbBus->BulkQueue = NULL;
+    }
+
+    // MU_CHANGE [END]
   }
 
   //
@@ -15,6 +15,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Protocol/Usb2HostController.h>
 #include <Protocol/UsbHostController.h>
 #include <Protocol/UsbIo.h>
+#include <Protocol/UsbBulkQueue.h> // MU_CHANGE
 #include <Protocol/DevicePath.h>
 
 #include <Library/BaseLib.h>
@@ -26,6 +27,8 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/DevicePathLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/ReportStatusCodeLib.h>
+#include <Library/PerformanceLib.h>   // MU_CHANGE
+#include <Library/PcdLib.h>           // MU_CHANGE
 
 #include <IndustryStandard/Usb.h>
 
@@ -152,6 +155,11 @@ typedef struct _USB_HUB_API    USB_HUB_API;
 #define USB_BUS_FROM_THIS(a) \
           CR(a, USB_BUS, BusId, USB_BUS_SIGNATURE)
 
+// MU_CHANGE [BEGIN] - Queue several bulk transfers
+#define USB_INTERFACE_FROM_BULK_QUEUE(a) \
+          CR(a, USB_INTERFACE, BulkQueue, USB_INTERFACE_SIGNATURE)
+// MU_CHANGE [END]
+
 //
 // Used to locate USB_BUS
 // UsbBusProtocol is the private protocol.
@@ -216,6 +224,13 @@ struct _USB_INTERFACE {
   EFI_USB_IO_PROTOCOL         UsbIo;
   EFI_DEVICE_PATH_PROTOCOL    *DevicePath;
   BOOLEAN                     IsManaged;
+  // MU_CHANGE [BEGIN] - Queue several bulk transfers
+  //
+  // Installed only when the host controller can queue bulk transfers
+  //
+  EDKII_USB_IO_BULK_QUEUE_PROTOCOL    BulkQueue;
+  BOOLEAN                             HasBulkQueue;
+  // MU_CHANGE [END]
 
   //
   // Hub device special data
@@ -259,6 +274,12 @@ struct _USB_BUS {
   EFI_DEVICE_PATH_PROTOCOL    *DevicePath;
   EFI_USB2_HC_PROTOCOL        *Usb2Hc;
   EFI_USB_HC_PROTOCOL         *UsbHc;
+  // MU_CHANGE [BEGIN] - Queue several bulk transfers
+  //
+  // NULL if the host controller cannot queue bulk transfers
+  //
+  EDKII_USB2_HC_BULK_QUEUE_PROTOCOL    *BulkQueue;
+  // MU_CHANGE [END]
 
   //
   // Recorded the max supported usb devices.
@@ -434,6 +455,33 @@ UsbIoBulkTransfer (
   OUT UINT32               *UsbStatus
   );
 
+// MU_CHANGE [BEGIN] - Queue several bulk transfers
+
+/**
+  Queue bulk transfers to the endpoints of the interface and wait for them.
+
+  @param  This                   The USB IO bulk queue instance.
+  @param  Count                  Number of transfers.
+  @param  Transfers              The transfers to queue.
+  @param  Timeout                Time to wait before timeout.
+
+  @retval EFI_SUCCESS            All the transfers completed.
+  @retval EFI_INVALID_PARAMETER  Some parameters are invalid.
+  @retval Others                 Failed to execute the transfers, reason
+                                 returned in their TransferResult.
+
+**/
+EFI_STATUS
+EFIAPI
+UsbIoBulkQueueTransfer (
+  IN     EDKII_USB_IO_BULK_QUEUE_PROTOCOL  *This,
+  IN     UINTN                             Count,
+  IN OUT EDKII_USB_BULK_QUEUE_TRANSFER     *Transfers,
+  IN     UINTN                             Timeout
+  );
+
+// MU_CHANGE [END]
+
 /**
   Execute a synchronous interrupt transfer.
 
@@ -67,6 +67,16 @@ UsbFreeInterface (
                   NULL
                   );
   if (!EFI_ERROR (Status)) {
+    // MU_CHANGE [BEGIN] - Queue several bulk transfers
+    if (UsbIf->HasBulkQueue) {
+      gBS->UninstallProtocolInterface (
+             UsbIf->Handle,
+             &gEdkiiUsbIoBulkQueueProtocolGuid,
+             &UsbIf->BulkQueue
+             );
+    }
+
+    // MU_CHANGE [END]
     if (UsbIf->DevicePath != NULL) {
       FreePool (UsbIf->DevicePath);
     }
@@ -140,6 +150,26 @@ UsbCreateInterface (
     goto ON_ERROR;
   }
 
+  // MU_CHANGE [BEGIN] - Queue several bulk transfers
+  //
+  // Install the bulk queue first, so that it is found by the drivers started
+  // on the UsbIo protocol.
+  //
+  if (Device->Bus->BulkQueue != NULL) {
+    UsbIf->BulkQueue.Revision     = EDKII_USB_BULK_QUEUE_PROTOCOL_REVISION;
+    UsbIf->BulkQueue.BulkTransfer = UsbIoBulkQueueTransfer;
+
+    Status = gBS->InstallProtocolInterface (
+                    &UsbIf->Handle,
+                    &gEdkiiUsbIoBulkQueueProtocolGuid,
+                    EFI_NATIVE_INTERFACE,
+                    &UsbIf->BulkQueue
+                    );
+    UsbIf->HasBulkQueue = (BOOLEAN) !EFI_ERROR (Status);
+  }
+
+  // MU_CHANGE [END]
+
   Status = gBS->InstallMultipleProtocolInterfaces (
                   &UsbIf->Handle,
                   &gEfiDevicePathProtocolGuid,
@@ -176,6 +206,16 @@ UsbCreateInterface (
   return UsbIf;
 
 ON_ERROR:
+  // MU_CHANGE [BEGIN] - Queue several bulk transfers
+  if (UsbIf->HasBulkQueue) {
+    gBS->UninstallProtocolInterface (
+           UsbIf->Handle,
+           &gEdkiiUsbIoBulkQueueProtocolGuid,
+           &UsbIf->BulkQueue
+           );
+  }
+
+  // MU_CHANGE [END]
   if (UsbIf->DevicePath != NULL) {
     FreePool (UsbIf->DevicePath);
   }
@@ -687,7 +727,7 @@ UsbEnumerateNewDev (
   HubApi  = HubIf->HubApi;
   Address = Bus->MaxDevices;
 
-  gBS->Stall (USB_WAIT_PORT_STABLE_STALL);
+  // MU_CHANGE - The port debounce stall is done by the callers, see UsbEnumeratePort()
 
   //
   // Hub resets the device for at least 10 milliseconds.
@@ -883,22 +923,32 @@ ON_ERROR:
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - Split the port events from the enumeration of the new device
+
 /**
-  Process the events on the port.
+  Process the events on the port, up to the enumeration of a new device.
+
+  The device that was connected to the port is removed. If a new device is
+  connected, the port changes are left for the caller to clear once the
+  device is enumerated.
 
   @param  HubIf                 The HUB that has the device connected.
   @param  Port                  The port index of the hub (started with zero).
+  @param  ResetIsNeeded         Returns whether the port must be reset before
+                                the new device is enumerated.
 
-  @retval EFI_SUCCESS           The device is enumerated (added or removed).
-  @retval EFI_OUT_OF_RESOURCES  Failed to allocate resource for the device.
-  @retval Others                Failed to enumerate the device.
+  @retval EFI_SUCCESS           A new device is connected to the port.
+  @retval EFI_NOT_FOUND         No new device to enumerate on the port.
+  @retval Others                Failed to process the events on the port.
 
 **/
 EFI_STATUS
-UsbEnumeratePort (
-  IN USB_INTERFACE  *HubIf,
-  IN UINT8          Port
+UsbCheckPortChange (
+  IN  USB_INTERFACE  *HubIf,
+  IN  UINT8          Port,
+  OUT BOOLEAN        *ResetIsNeeded
   )
+// MU_CHANGE [END]
 {
   USB_HUB_API          *HubApi;
   USB_DEVICE           *Child;
@@ -930,7 +980,7 @@ UsbEnumeratePort (
   // Usb super speed hub may report other changes, such as warm reset change. Ignore them.
   //
   if ((PortState.PortChangeStatus & (USB_PORT_STAT_C_CONNECTION | USB_PORT_STAT_C_ENABLE | USB_PORT_STAT_C_OVERCURRENT | USB_PORT_STAT_C_RESET)) == 0) {
-    return EFI_SUCCESS;
+    return EFI_NOT_FOUND;   // MU_CHANGE
   }
 
   DEBUG ((
@@ -1002,21 +1052,152 @@ UsbEnumeratePort (
     // Now, new device connected, enumerate and configure the device
     //
     DEBUG ((DEBUG_INFO, "UsbEnumeratePort: new device connected at port %d\n", Port));
+    // MU_CHANGE [BEGIN] - Leave the enumeration to the caller
     if (USB_BIT_IS_SET (PortState.PortChangeStatus, USB_PORT_STAT_C_RESET) &&
-        (Status != EFI_DEVICE_ERROR))     // MU_CHANGE
+        (Status != EFI_DEVICE_ERROR))
     {
-      Status = UsbEnumerateNewDev (HubIf, Port, FALSE);
+      *ResetIsNeeded = FALSE;
     } else {
-      Status = UsbEnumerateNewDev (HubIf, Port, TRUE);
+      *ResetIsNeeded = TRUE;
     }
+
+    return EFI_SUCCESS;
+    // MU_CHANGE [END]
   } else {
     DEBUG ((DEBUG_INFO, "UsbEnumeratePort: device disconnected event on port %d\n", Port));
   }
 
   HubApi->ClearPortChange (HubIf, Port);
+  return EFI_NOT_FOUND;   // MU_CHANGE
+}
+
+// MU_CHANGE [BEGIN] - Enumerate the changed ports of a hub with a shared debounce
+
+/**
+  Process the events on the port.
+
+  @param  HubIf                 The HUB that has the device connected.
+  @param  Port                  The port index of the hub (started with zero).
+
+  @retval EFI_SUCCESS           The device is enumerated (added or removed).
+  @retval EFI_OUT_OF_RESOURCES  Failed to allocate resource for the device.
+  @retval Others                Failed to enumerate the device.
+
+**/
+EFI_STATUS
+UsbEnumeratePort (
+  IN USB_INTERFACE  *HubIf,
+  IN UINT8          Port
+  )
+{
+  BOOLEAN     ResetIsNeeded;
+  EFI_STATUS  Status;
+
+  Status = UsbCheckPortChange (HubIf, Port, &ResetIsNeeded);
+  if (Status == EFI_NOT_FOUND) {
+    return EFI_SUCCESS;
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  PERF_INMODULE_BEGIN ("UsbPortDebounce");
+  gBS->Stall (USB_WAIT_PORT_STABLE_STALL);
+  PERF_INMODULE_END ("UsbPortDebounce");
+
+  PERF_INMODULE_BEGIN ("UsbPortEnumerate");
+  Status = UsbEnumerateNewDev (HubIf, Port, ResetIsNeeded);
+  PERF_INMODULE_END ("UsbPortEnumerate");
+
+  HubIf->HubApi->ClearPortChange (HubIf, Port);
   return Status;
 }
 
+/**
+  Process the events on several ports of a hub.
+
+  The events of all the ports are processed first. The new devices are then
+  given one shared debounce time before they are reset, addressed and
+  configured in port order. Only one device may answer at the default address,
+  so the ports are not reset together.
+
+  @param  HubIf                 The HUB that has the devices connected.
+  @param  ChangeMap             The bitmap of the ports to process, in the
+                                layout of the hub status change endpoint, or
+                                NULL to process all the ports.
+
+**/
+VOID
+UsbEnumerateChangedPorts (
+  IN USB_INTERFACE  *HubIf,
+  IN UINT8          *ChangeMap  OPTIONAL
+  )
+{
+  UINT8       *PortFlags;
+  BOOLEAN     ResetIsNeeded;
+  EFI_STATUS  Status;
+  UINTN       Pending;
+  UINT8       Byte;
+  UINT8       Bit;
+  UINT8       Index;
+
+  PortFlags = AllocateZeroPool (HubIf->NumOfPort);
+  Pending   = 0;
+
+  //
+  // HUB starts its port index with 1.
+  //
+  Byte = 0;
+  Bit  = 1;
+
+  for (Index = 0; Index < HubIf->NumOfPort; Index++) {
+    if ((ChangeMap == NULL) || USB_BIT_IS_SET (ChangeMap[Byte], USB_BIT (Bit))) {
+      if (PortFlags == NULL) {
+        UsbEnumeratePort (HubIf, Index);
+      } else {
+        Status = UsbCheckPortChange (HubIf, Index, &ResetIsNeeded);
+        if (!EFI_ERROR (Status)) {
+          PortFlags[Index] = USB_PORT_ENUM_PENDING | (ResetIsNeeded ? USB_PORT_ENUM_RESET : 0);
+          Pending++;
+        }
+      }
+    }
+
+    USB_NEXT_BIT (Byte, Bit);
+  }
+
+  if (Pending == 0) {
+    if (PortFlags != NULL) {
+      FreePool (PortFlags);
+    }
+
+    return;
+  }
+
+  DEBUG ((DEBUG_INFO, "UsbEnumerateChangedPorts: %Lu new devices on hub %p\n", (UINT64)Pending, HubIf));
+
+  PERF_INMODULE_BEGIN ("UsbPortDebounce");
+  gBS->Stall (USB_WAIT_PORT_STABLE_STALL);
+  PERF_INMODULE_END ("UsbPortDebounce");
+
+  for (Index = 0; Index < HubIf->NumOfPort; Index++) {
+    if ((PortFlags[Index] & USB_PORT_ENUM_PENDING) == 0) {
+      continue;
+    }
+
+    PERF_INMODULE_BEGIN ("UsbPortEnumerate");
+    UsbEnumerateNewDev (HubIf, Index, (BOOLEAN)((PortFlags[Index] & USB_PORT_ENUM_RESET) != 0));
+    PERF_INMODULE_END ("UsbPortEnumerate");
+
+    HubIf->HubApi->ClearPortChange (HubIf, Index);
+  }
+
+  FreePool (PortFlags);
+}
+
+// MU_CHANGE [END]
+
 /**
   Enumerate all the changed hub ports.
 
@@ -1059,14 +1240,21 @@ UsbHubEnumeration (
   Byte = 0;
   Bit  = 1;
 
-  for (Index = 0; Index < HubIf->NumOfPort; Index++) {
-    if (USB_BIT_IS_SET (HubIf->ChangeMap[Byte], USB_BIT (Bit))) {
-      UsbEnumeratePort (HubIf, Index);
-    }
+  // MU_CHANGE [BEGIN] - Enumerate the changed ports with a shared debounce
+  if (FeaturePcdGet (PcdUsbBatchPortEnumeration)) {
+    UsbEnumerateChangedPorts (HubIf, HubIf->ChangeMap);
+  } else {
+    for (Index = 0; Index < HubIf->NumOfPort; Index++) {
+      if (USB_BIT_IS_SET (HubIf->ChangeMap[Byte], USB_BIT (Bit))) {
+        UsbEnumeratePort (HubIf, Index);
+      }
 
-    USB_NEXT_BIT (Byte, Bit);
+      USB_NEXT_BIT (Byte, Bit);
+    }
   }
 
+  // MU_CHANGE [END]
+
   UsbHubAckHubStatus (HubIf->Device);
 
   gBS->FreePool (HubIf->ChangeMap);
@@ -1109,6 +1297,18 @@ UsbRootHubEnumeration (
       UsbRemoveDevice (Child);
     }
 
-    UsbEnumeratePort (RootHub, Index);
+    // MU_CHANGE [BEGIN] - Enumerate the changed ports with a shared debounce
+    if (!FeaturePcdGet (PcdUsbBatchPortEnumeration)) {
+      UsbEnumeratePort (RootHub, Index);
+    }
+
+    // MU_CHANGE [END]
   }
+
+  // MU_CHANGE [BEGIN] - Enumerate the changed ports with a shared debounce
+  if (FeaturePcdGet (PcdUsbBatchPortEnumeration)) {
+    UsbEnumerateChangedPorts (RootHub, NULL);
+  }
+
+  // MU_CHANGE [END]
 }
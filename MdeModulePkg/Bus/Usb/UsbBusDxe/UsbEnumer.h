@@ -22,6 +22,14 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
             }                 \
           } while (0)
 
+// MU_CHANGE [BEGIN] - Enumerate the changed ports with a shared debounce
+//
+// State of a port while the changed ports of a hub are enumerated together.
+//
+#define USB_PORT_ENUM_PENDING  0x01     // A new device waits to be enumerated.
+#define USB_PORT_ENUM_RESET    0x02     // The port must be reset first.
+// MU_CHANGE [END]
+
 //
 // Common interface used by usb bus enumeration process.
 // This interface is defined to mask the difference between
@@ -793,6 +793,36 @@ UsbBootDetectMedia (
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - Queue the command, data and status transfers
+
+/**
+  Get the maximum number of bytes carried by one read or write command.
+
+  @param  UsbMass                The USB mass storage device.
+
+  @return The maximum number of bytes of a command.
+
+**/
+UINT32
+UsbBootGetMaxCarrySize (
+  IN  USB_MASS_DEVICE  *UsbMass
+  )
+{
+  //
+  // A BOT command whose transfers are queued moves its data in one chained
+  // transfer, so it is not limited by the size of a single transfer.
+  //
+  if ((UsbMass->Transport->Protocol == USB_MASS_STORE_BOT) &&
+      (((USB_BOT_PROTOCOL *)UsbMass->Context)->BulkQueue != NULL))
+  {
+    return USB_BOOT_QUEUED_MAX_CARRY_SIZE;
+  }
+
+  return USB_BOOT_MAX_CARRY_SIZE;
+}
+
+// MU_CHANGE [END]
+
 /**
   Read or write some blocks from the device.
 
@@ -824,7 +854,7 @@ UsbBootReadWriteBlocks (
   UINT32                      Timeout;
 
   BlockSize = UsbMass->BlockIoMedia.BlockSize;
-  CountMax  = USB_BOOT_MAX_CARRY_SIZE / BlockSize;
+  CountMax  = UsbBootGetMaxCarrySize (UsbMass) / BlockSize; // MU_CHANGE
   Status    = EFI_SUCCESS;
 
   while (TotalBlock > 0) {
@@ -910,7 +940,7 @@ UsbBootReadWriteBlocks16 (
   UINT32      Timeout;
 
   BlockSize = UsbMass->BlockIoMedia.BlockSize;
-  CountMax  = USB_BOOT_MAX_CARRY_SIZE / BlockSize;
+  CountMax  = UsbBootGetMaxCarrySize (UsbMass) / BlockSize; // MU_CHANGE
   Status    = EFI_SUCCESS;
 
   while (TotalBlock > 0) {
@@ -63,6 +63,13 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 //
 #define USB_BOOT_MAX_CARRY_SIZE  SIZE_64KB
 
+// MU_CHANGE [BEGIN] - Queue the command, data and status transfers
+//
+// Max carried size of a command when the BOT transport queues its transfers.
+//
+#define USB_BOOT_QUEUED_MAX_CARRY_SIZE  SIZE_1MB
+// MU_CHANGE [END]
+
 //
 // Retry mass command times, set by experience
 //
@@ -275,6 +282,23 @@ UsbBootReadBlocks (
   OUT UINT8            *Buffer
   );
 
+// MU_CHANGE [BEGIN] - Queue the command, data and status transfers
+
+/**
+  Get the maximum number of bytes carried by one read or write command.
+
+  @param  UsbMass                The USB mass storage device.
+
+  @return The maximum number of bytes of a command.
+
+**/
+UINT32
+UsbBootGetMaxCarrySize (
+  IN  USB_MASS_DEVICE  *UsbMass
+  );
+
+// MU_CHANGE [END]
+
 /**
   Read or write some blocks from the device.
 
@@ -124,6 +124,46 @@ ON_ERROR:
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - Queue the command, data and status transfers
+
+/**
+  Fill in the Command Block Wrapper of a command.
+
+  @param  UsbBot                The USB BOT device
+  @param  Cbw                   The Command Block Wrapper to fill in
+  @param  Cmd                   The command to transfer to device
+  @param  CmdLen                The length of the command
+  @param  DataDir               The direction of the data
+  @param  TransLen              The expected length of the data
+  @param  Lun                   The number of logic unit
+
+**/
+VOID
+UsbBotFillCbw (
+  IN  USB_BOT_PROTOCOL        *UsbBot,
+  OUT USB_BOT_CBW             *Cbw,
+  IN  UINT8                   *Cmd,
+  IN  UINT8                   CmdLen,
+  IN  EFI_USB_DATA_DIRECTION  DataDir,
+  IN  UINT32                  TransLen,
+  IN  UINT8                   Lun
+  )
+{
+  ASSERT ((CmdLen > 0) && (CmdLen <= USB_BOT_MAX_CMDLEN));
+
+  Cbw->Signature = USB_BOT_CBW_SIGNATURE;
+  Cbw->Tag       = UsbBot->CbwTag;
+  Cbw->DataLen   = TransLen;
+  Cbw->Flag      = (UINT8)((DataDir == EfiUsbDataIn) ? BIT7 : 0);
+  Cbw->Lun       = Lun;
+  Cbw->CmdLen    = CmdLen;
+
+  ZeroMem (Cbw->CmdBlock, USB_BOT_MAX_CMDLEN);
+  CopyMem (Cbw->CmdBlock, Cmd, CmdLen);
+}
+
+// MU_CHANGE [END]
+
 /**
   Send the command to the device using Bulk-Out endpoint.
 
@@ -159,20 +199,10 @@ UsbBotSendCommand (
   UINTN        DataLen;
   UINTN        Timeout;
 
-  ASSERT ((CmdLen > 0) && (CmdLen <= USB_BOT_MAX_CMDLEN));
-
   //
   // Fill in the Command Block Wrapper.
   //
-  Cbw.Signature = USB_BOT_CBW_SIGNATURE;
-  Cbw.Tag       = UsbBot->CbwTag;
-  Cbw.DataLen   = TransLen;
-  Cbw.Flag      = (UINT8)((DataDir == EfiUsbDataIn) ? BIT7 : 0);
-  Cbw.Lun       = Lun;
-  Cbw.CmdLen    = CmdLen;
-
-  ZeroMem (Cbw.CmdBlock, USB_BOT_MAX_CMDLEN);
-  CopyMem (Cbw.CmdBlock, Cmd, CmdLen);
+  UsbBotFillCbw (UsbBot, &Cbw, Cmd, CmdLen, DataDir, TransLen, Lun); // MU_CHANGE
 
   Result  = 0;
   DataLen = sizeof (USB_BOT_CBW);
@@ -370,6 +400,150 @@ UsbBotGetStatus (
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - Queue the command, data and status transfers
+
+/**
+  Queue the command, data and status transfers of a command.
+
+  The device starts the data phase as soon as it receives the CBW and sends
+  the CSW as soon as the data phase ends, so the three phases are queued
+  together and the bus does not idle between them. The errors of each phase
+  are handled as UsbBotSendCommand(), UsbBotDataTransfer() and
+  UsbBotGetStatus() do.
+
+  @param  UsbBot                The USB BOT device
+  @param  Cmd                   The high level command
+  @param  CmdLen                The command length
+  @param  DataDir               The direction of the data transfer
+  @param  Data                  The buffer to hold data
+  @param  DataLen               The length of the data
+  @param  Lun                   The number of logic unit
+  @param  Timeout               The time to wait command
+  @param  CmdStatus             The result of high level command execution
+
+  @retval EFI_SUCCESS           The command is executed successfully.
+  @retval EFI_UNSUPPORTED       The transfers were not queued, nothing was
+                                sent to the device.
+  @retval Other                 Failed to execute command
+
+**/
+EFI_STATUS
+UsbBotExecQueuedCommand (
+  IN  USB_BOT_PROTOCOL        *UsbBot,
+  IN  VOID                    *Cmd,
+  IN  UINT8                   CmdLen,
+  IN  EFI_USB_DATA_DIRECTION  DataDir,
+  IN  VOID                    *Data,
+  IN  UINT32                  DataLen,
+  IN  UINT8                   Lun,
+  IN  UINT32                  Timeout,
+  OUT UINT8                   *CmdStatus
+  )
+{
+  USB_BOT_CBW                    Cbw;
+  USB_BOT_CSW                    Csw;
+  EDKII_USB_BULK_QUEUE_TRANSFER  Transfers[3];
+  EDKII_USB_BULK_QUEUE_TRANSFER  *DataTransfer;
+  EDKII_USB_BULK_QUEUE_TRANSFER  *CswTransfer;
+  UINTN                          Count;
+  EFI_STATUS                     Status;
+
+  *CmdStatus = USB_BOT_COMMAND_ERROR;
+
+  UsbBotFillCbw (UsbBot, &Cbw, Cmd, CmdLen, DataDir, DataLen, Lun);
+  ZeroMem (&Csw, sizeof (USB_BOT_CSW));
+
+  Count                        = 0;
+  Transfers[0].EndpointAddress = UsbBot->BulkOutEndpoint->EndpointAddress;
+  Transfers[0].Data            = &Cbw;
+  Transfers[0].DataLength      = sizeof (USB_BOT_CBW);
+  Count++;
+
+  DataTransfer = NULL;
+  if ((DataDir != EfiUsbNoData) && (DataLen != 0)) {
+    DataTransfer = &Transfers[Count++];
+    if (DataDir == EfiUsbDataIn) {
+      DataTransfer->EndpointAddress = UsbBot->BulkInEndpoint->EndpointAddress;
+    } else {
+      DataTransfer->EndpointAddress = UsbBot->BulkOutEndpoint->EndpointAddress;
+    }
+
+    DataTransfer->Data       = Data;
+    DataTransfer->DataLength = DataLen;
+  }
+
+  CswTransfer                  = &Transfers[Count++];
+  CswTransfer->EndpointAddress = UsbBot->BulkInEndpoint->EndpointAddress;
+  CswTransfer->Data            = &Csw;
+  CswTransfer->DataLength      = sizeof (USB_BOT_CSW);
+
+  Status = UsbBot->BulkQueue->BulkTransfer (
+                                UsbBot->BulkQueue,
+                                Count,
+                                Transfers,
+                                (USB_BOT_SEND_CBW_TIMEOUT + Timeout + USB_BOT_RECV_CSW_TIMEOUT) / USB_MASS_1_MILLISECOND
+                                );
+  if (EFI_ERROR (Status) && (Transfers[0].TransferResult == EFI_USB_ERR_NOTEXECUTE)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Command phase.
+  //
+  if (Transfers[0].TransferResult != EFI_USB_NOERROR) {
+    if (USB_IS_ERROR (Transfers[0].TransferResult, EFI_USB_ERR_STALL) && (DataDir == EfiUsbDataOut)) {
+      UsbBotResetDevice (UsbBot, FALSE);
+    } else if (USB_IS_ERROR (Transfers[0].TransferResult, EFI_USB_ERR_NAK)) {
+      return EFI_NOT_READY;
+    }
+
+    return EFI_ERROR (Status) ? Status : EFI_DEVICE_ERROR;
+  }
+
+  //
+  // Data phase. The CSW is read even if the data transfer fails.
+  //
+  if ((DataTransfer != NULL) && (DataTransfer->TransferResult != EFI_USB_NOERROR)) {
+    if (USB_IS_ERROR (DataTransfer->TransferResult, EFI_USB_ERR_STALL)) {
+      DEBUG ((DEBUG_INFO, "UsbBotExecQueuedCommand: Data Stall\n"));
+      UsbClearEndpointStall (UsbBot->UsbIo, DataTransfer->EndpointAddress);
+    } else {
+      DEBUG ((DEBUG_ERROR, "UsbBotExecQueuedCommand: Data transfer result 0x%x\n", DataTransfer->TransferResult));
+      if (USB_IS_ERROR (DataTransfer->TransferResult, EFI_USB_ERR_TIMEOUT)) {
+        UsbBotResetDevice (UsbBot, FALSE);
+      }
+    }
+  }
+
+  //
+  // Status phase.
+  //
+  if ((CswTransfer->TransferResult == EFI_USB_NOERROR) &&
+      (Csw.Signature == USB_BOT_CSW_SIGNATURE) &&
+      (Csw.CmdStatus != USB_BOT_COMMAND_ERROR))
+  {
+    *CmdStatus = Csw.CmdStatus;
+    UsbBot->CbwTag++;
+    return EFI_SUCCESS;
+  }
+
+  if (USB_IS_ERROR (CswTransfer->TransferResult, EFI_USB_ERR_STALL)) {
+    UsbClearEndpointStall (UsbBot->UsbIo, CswTransfer->EndpointAddress);
+  } else if (CswTransfer->TransferResult == EFI_USB_NOERROR) {
+    //
+    // CSW is invalid or reports a phase error, so perform reset recovery
+    //
+    UsbBotResetDevice (UsbBot, FALSE);
+  }
+
+  //
+  // Retry to read the CSW on its own.
+  //
+  return UsbBotGetStatus (UsbBot, DataLen, CmdStatus);
+}
+
+// MU_CHANGE [END]
+
 /**
   Call the USB Mass Storage Class BOT protocol to issue
   the command/data/status circle to execute the commands.
@@ -410,6 +584,25 @@ UsbBotExecCommand (
   *CmdStatus = USB_MASS_CMD_FAIL;
   UsbBot     = (USB_BOT_PROTOCOL *)Context;
 
+  // MU_CHANGE [BEGIN] - Queue the command, data and status transfers
+  if (UsbBot->BulkQueue != NULL) {
+    Status = UsbBotExecQueuedCommand (UsbBot, Cmd, CmdLen, DataDir, Data, DataLen, Lun, Timeout, &Result);
+    if (Status != EFI_UNSUPPORTED) {
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "UsbBotExecCommand: UsbBotExecQueuedCommand (%r)\n", Status));
+        return Status;
+      }
+
+      if (Result == 0) {
+        *CmdStatus = USB_MASS_CMD_SUCCESS;
+      }
+
+      return EFI_SUCCESS;
+    }
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Send the command to the device. Return immediately if device
   // rejects the command.
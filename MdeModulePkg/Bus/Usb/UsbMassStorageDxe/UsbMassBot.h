@@ -81,6 +81,12 @@ typedef struct {
   EFI_USB_ENDPOINT_DESCRIPTOR     *BulkOutEndpoint;
   UINT32                          CbwTag;
   EFI_USB_IO_PROTOCOL             *UsbIo;
+  // MU_CHANGE [BEGIN] - Queue the command, data and status transfers
+  //
+  // NULL if the transfers of a command cannot be queued
+  //
+  EDKII_USB_IO_BULK_QUEUE_PROTOCOL    *BulkQueue;
+  // MU_CHANGE [END]
 } USB_BOT_PROTOCOL;
 
 /**
@@ -443,6 +443,26 @@ UsbMassInitTransport (
   //
   if ((*Transport)->Protocol == USB_MASS_STORE_BOT) {
     (*Transport)->GetMaxLun (*Context, MaxLun);
+
+    // MU_CHANGE [BEGIN] - Queue the command, data and status transfers
+    //
+    // The bus driver installs the bulk queue with the USB I/O protocol when
+    // the host controller can queue bulk transfers.
+    //
+    Status = gBS->OpenProtocol (
+                    Controller,
+                    &gEdkiiUsbIoBulkQueueProtocolGuid,
+                    (VOID **)&((USB_BOT_PROTOCOL *)*Context)->BulkQueue,
+                    This->DriverBindingHandle,
+                    Controller,
+                    EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                    );
+    if (EFI_ERROR (Status)) {
+      ((USB_BOT_PROTOCOL *)*Context)->BulkQueue = NULL;
+    }
+
+    Status = EFI_SUCCESS;
+    // MU_CHANGE [END]
   }
 
 ON_EXIT:
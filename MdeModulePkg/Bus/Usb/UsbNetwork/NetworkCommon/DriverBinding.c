@@ -403,6 +403,39 @@ NetworkCommonDriverStart (
     return EFI_DEVICE_ERROR;
   }
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // Pass the transmit offloads of the USB network driver through to the
+  // child, where the SNP driver installs the Simple Network Protocol.
+  //
+  Status = gBS->OpenProtocol (
+                  ControllerHandle,
+                  &gEdkiiNetworkOffloadProtocolGuid,
+                  (VOID **)&NicDevice->UsbNetworkOffload,
+                  This->DriverBindingHandle,
+                  ControllerHandle,
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                  );
+  if (!EFI_ERROR (Status)) {
+    CopyMem (&NicDevice->NetworkOffload, NicDevice->UsbNetworkOffload, sizeof (NicDevice->NetworkOffload));
+    NicDevice->NetworkOffload.Capabilities &= EDKII_NETWORK_OFFLOAD_TX_MASK;
+    NicDevice->NetworkOffload.Transmit      = NetworkCommonOffloadTransmit;
+    NicDevice->NetworkOffload.Receive       = NULL;
+
+    Status = gBS->InstallProtocolInterface (
+                    &NicDevice->DeviceHandle,
+                    &gEdkiiNetworkOffloadProtocolGuid,
+                    EFI_NATIVE_INTERFACE,
+                    &NicDevice->NetworkOffload
+                    );
+  }
+
+  if (EFI_ERROR (Status)) {
+    NicDevice->UsbNetworkOffload = NULL;
+  }
+
+  // MU_CHANGE [END]
+
   Status = gBS->OpenProtocol (
                   ControllerHandle,
                   &gEdkIIUsbEthProtocolGuid,
@@ -526,6 +559,17 @@ NetworkCommonDriverStop (
            ChildHandleBuffer[Index]
            );
 
+    // MU_CHANGE [BEGIN] - Network offloads
+    if (NicDevice->UsbNetworkOffload != NULL) {
+      gBS->UninstallProtocolInterface (
+             ChildHandleBuffer[Index],
+             &gEdkiiNetworkOffloadProtocolGuid,
+             &NicDevice->NetworkOffload
+             );
+    }
+
+    // MU_CHANGE [END]
+
     Status = gBS->UninstallMultipleProtocolInterfaces (
                     ChildHandleBuffer[Index],
                     &gEfiNetworkInterfaceIdentifierProtocolGuid_31,
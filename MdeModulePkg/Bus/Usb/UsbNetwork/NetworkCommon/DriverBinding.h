@@ -20,6 +20,7 @@
 #include <Protocol/UsbIo.h>
 #include <Protocol/NetworkInterfaceIdentifier.h>
 #include <Protocol/UsbEthernetProtocol.h>
+#include <Protocol/NetworkOffload.h> // MU_CHANGE - Network offloads
 
 #define NETWORK_COMMON_DRIVER_VERSION    1
 #define NETWORK_COMMON_POLLING_INTERVAL  0x10
@@ -31,6 +32,8 @@
 #define UNDI_DEV_FROM_THIS(a)  CR(a, NIC_DEVICE, NiiProtocol, UNDI_DEV_SIGNATURE)
 #define UNDI_DEV_FROM_NIC(a)   CR(a, NIC_DEVICE, NicInfo, UNDI_DEV_SIGNATURE)
 
+#define UNDI_DEV_FROM_OFFLOAD(a)  CR(a, NIC_DEVICE, NetworkOffload, UNDI_DEV_SIGNATURE) // MU_CHANGE - Network offloads
+
 #pragma pack(1)
 typedef struct {
   UINT8     DestAddr[PXE_HWADDR_LEN_ETHER];
@@ -47,6 +50,10 @@ typedef struct {
   EFI_DEVICE_PATH_PROTOCOL                     *DevPath;
   NIC_DATA                                     NicInfo;
   VOID                                         *ReceiveBuffer;
+  // MU_CHANGE [BEGIN] - Network offloads
+  EDKII_NETWORK_OFFLOAD_PROTOCOL               NetworkOffload;
+  EDKII_NETWORK_OFFLOAD_PROTOCOL               *UsbNetworkOffload;
+  // MU_CHANGE [END]
 } NIC_DEVICE;
 
 typedef VOID (*API_FUNC)(
@@ -263,4 +270,16 @@ Statistics (
   IN UINT16    DbSize
   );
 
+// MU_CHANGE [BEGIN] - Network offloads
+EFI_STATUS
+EFIAPI
+NetworkCommonOffloadTransmit (
+  IN EDKII_NETWORK_OFFLOAD_PROTOCOL       *This,
+  IN CONST EDKII_NETWORK_OFFLOAD_TX_INFO  *TxInfo,
+  IN UINTN                                BufferSize,
+  IN VOID                                 *Buffer
+  );
+
+// MU_CHANGE [END]
+
 #endif
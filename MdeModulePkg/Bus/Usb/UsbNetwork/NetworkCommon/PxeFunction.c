@@ -1461,6 +1461,60 @@ Transmit (
   return StatCode;
 }
 
+// MU_CHANGE [BEGIN] - Network offloads
+
+/**
+  Transmit a frame with offloads through the USB network driver.
+
+  @param[in]  This          A pointer to the EDKII_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in]  TxInfo        The offloads to apply.
+  @param[in]  BufferSize    The size of the frame.
+  @param[in]  Buffer        The frame, media header included.
+
+  @retval EFI_SUCCESS           The frame was sent.
+  @retval EFI_NOT_STARTED       The UNDI is not initialized.
+  @retval EFI_NOT_READY         A transmit is in progress.
+  @retval Others                As returned by the USB network driver.
+
+**/
+EFI_STATUS
+EFIAPI
+NetworkCommonOffloadTransmit (
+  IN EDKII_NETWORK_OFFLOAD_PROTOCOL       *This,
+  IN CONST EDKII_NETWORK_OFFLOAD_TX_INFO  *TxInfo,
+  IN UINTN                                BufferSize,
+  IN VOID                                 *Buffer
+  )
+{
+  EFI_STATUS  Status;
+  NIC_DEVICE  *NicDevice;
+  NIC_DATA    *Nic;
+
+  NicDevice = UNDI_DEV_FROM_OFFLOAD (This);
+  Nic       = &NicDevice->NicInfo;
+
+  if (Nic->State != PXE_STATFLAGS_GET_STATE_INITIALIZED) {
+    return EFI_NOT_STARTED;
+  }
+
+  if (Nic->CanTransmit) {
+    return EFI_NOT_READY;
+  }
+
+  Nic->CanTransmit = TRUE;
+
+  Status = NicDevice->UsbNetworkOffload->Transmit (NicDevice->UsbNetworkOffload, TxInfo, BufferSize, Buffer);
+  if (!EFI_ERROR (Status)) {
+    Nic->TxFrame++;
+  }
+
+  Nic->CanTransmit = FALSE;
+
+  return Status;
+}
+
+// MU_CHANGE [END]
+
 /**
   When the network adapter has received a frame, this command is used
   to copy the frame into driver/application storage.
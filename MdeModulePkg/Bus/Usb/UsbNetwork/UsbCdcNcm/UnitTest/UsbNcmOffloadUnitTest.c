@@ -0,0 +1,809 @@
+/** @file -- UsbNcmOffloadUnitTest.c
+  Host based unit tests of the checksum and large send offloads of UsbCdcNcm,
+  against a simulated NCM function.
+
+  The simulated function reports its NTB parameters through the
+  GET_NTB_PARAMETERS request and keeps a copy of every NTB sent to its bulk
+  OUT endpoint. The tests walk the datagram tables of the NTBs and check the
+  segments and the checksums of the frames in them.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../UsbCdcNcm.h"
+
+#define UNIT_TEST_NAME     "USB NCM Network Offload Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// NTB parameters of the simulated function.
+//
+#define TEST_NTB_OUT_MAX_SIZE  SIZE_16KB
+#define TEST_NDP_DIVISOR       4
+#define TEST_NDP_REMAINDER     2
+#define TEST_BULK_OUT          0x02
+#define TEST_MAX_NTBS          16
+
+//
+// Frame layout: an Ethernet header, an IPv4 header without options and a
+// TCP header with 12 bytes of options.
+//
+#define TEST_MEDIA_HEADER_SIZE  14
+#define TEST_IP4_HEADER_SIZE    20
+#define TEST_TCP_HEADER_SIZE    32
+#define TEST_UDP_HEADER_SIZE    8
+#define TEST_NETWORK_OFFSET     TEST_MEDIA_HEADER_SIZE
+#define TEST_TRANSPORT_OFFSET   (TEST_MEDIA_HEADER_SIZE + TEST_IP4_HEADER_SIZE)
+#define TEST_TCP_HEADERS_SIZE   (TEST_TRANSPORT_OFFSET + TEST_TCP_HEADER_SIZE)
+#define TEST_SEGMENT_SIZE       1460
+#define TEST_SEQUENCE           0xFFFFFE00                          // Wraps around during the send
+#define TEST_IDENTIFICATION     0x1234
+#define TEST_IP_PROTO_TCP       6
+#define TEST_IP_PROTO_UDP       17
+#define TEST_TCP_FLAG_FIN       BIT0
+#define TEST_TCP_FLAG_PSH       BIT3
+#define TEST_TCP_FLAG_ACK       BIT4
+
+#define TEST_TX_ALL  (EDKII_NETWORK_OFFLOAD_TX_IP4_CHECKSUM  | \
+                      EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM | \
+                      EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND)
+
+///
+/// An NTB received by the simulated function.
+///
+typedef struct {
+  UINT8    Data[TEST_NTB_OUT_MAX_SIZE];
+  UINTN    Length;
+} TEST_NTB;
+
+///
+/// State of the simulated function.
+///
+typedef struct {
+  TEST_NTB    Ntbs[TEST_MAX_NTBS];
+  UINTN       NtbCount;
+  UINTN       FailTransfer;                                         // Bulk transfer to fail, 1-based, 0 for none
+  UINTN       Transfers;
+  UINTN       BadAccesses;
+} SIMULATED_FUNCTION;
+
+STATIC SIMULATED_FUNCTION   mFunction;
+STATIC EFI_USB_IO_PROTOCOL  mUsbIo;
+STATIC EFI_BOOT_SERVICES    mBootServices;
+STATIC USB_ETHERNET_DRIVER  mUsbEthDriver;
+STATIC UINT8                mFrame[USB_NCM_MAX_LARGE_SEND_SIZE];
+
+EFI_BOOT_SERVICES  *gBS = &mBootServices;
+
+/**
+  Read a 16-bit value in network byte order.
+
+  @param[in]  Data    A pointer to the value.
+
+  @return The value in host byte order.
+
+**/
+STATIC
+UINT16
+TestReadNet16 (
+  IN CONST UINT8  *Data
+  )
+{
+  return (UINT16)((Data[0] << 8) | Data[1]);
+}
+
+/**
+  Write a 16-bit value in network byte order.
+
+  @param[out]  Data     A pointer to the value.
+  @param[in]   Value    The value in host byte order.
+
+**/
+STATIC
+VOID
+TestWriteNet16 (
+  OUT UINT8   *Data,
+  IN  UINT16  Value
+  )
+{
+  Data[0] = (UINT8)(Value >> 8);
+  Data[1] = (UINT8)Value;
+}
+
+/**
+  Read a 32-bit value in network byte order.
+
+  @param[in]  Data    A pointer to the value.
+
+  @return The value in host byte order.
+
+**/
+STATIC
+UINT32
+TestReadNet32 (
+  IN CONST UINT8  *Data
+  )
+{
+  return ((UINT32)TestReadNet16 (Data) << 16) | TestReadNet16 (Data + 2);
+}
+
+/**
+  Add the bytes of a buffer, as 16-bit words in network byte order, to a one's
+  complement sum, independently of the driver.
+
+  @param[in]  Data      A pointer to the buffer.
+  @param[in]  Length    The length of the buffer.
+  @param[in]  Sum       The sum of the previous words.
+
+  @return The one's complement sum, not complemented.
+
+**/
+STATIC
+UINT16
+TestChecksum (
+  IN CONST UINT8  *Data,
+  IN UINTN        Length,
+  IN UINT32       Sum
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Length; Index++) {
+    Sum += ((Index & 1) == 0) ? ((UINT32)Data[Index] << 8) : Data[Index];
+    Sum  = (Sum & 0xFFFF) + (Sum >> 16);
+  }
+
+  return (UINT16)Sum;
+}
+
+/**
+  Sum the IPv4 pseudo-header of a segment.
+
+  @param[in]  Ip        The IPv4 header.
+  @param[in]  Length    The length of the TCP or UDP segment, or 0 for the
+                        sum that the network stack leaves in the checksum
+                        field.
+
+  @return The one's complement sum, not complemented.
+
+**/
+STATIC
+UINT16
+TestPseudoHeaderChecksum (
+  IN CONST UINT8  *Ip,
+  IN UINT16       Length
+  )
+{
+  return TestChecksum (Ip + 12, 8, (UINT32)Ip[9] + Length);
+}
+
+/**
+  Simulated UsbControlTransfer() of the NCM function. Only GET_NTB_PARAMETERS
+  is expected.
+
+  @retval EFI_SUCCESS       The NTB parameters are returned.
+  @retval EFI_UNSUPPORTED   The request is not expected.
+
+**/
+EFI_STATUS
+EFIAPI
+TestUsbControlTransfer (
+  IN     EFI_USB_IO_PROTOCOL     *This,
+  IN     EFI_USB_DEVICE_REQUEST  *Request,
+  IN     EFI_USB_DATA_DIRECTION  Direction,
+  IN     UINT32                  Timeout,
+  IN OUT VOID                    *Data OPTIONAL,
+  IN     UINTN                   DataLength OPTIONAL,
+  OUT    UINT32                  *Status
+  )
+{
+  USB_NCM_NTB_PARAMETERS  *Parameters;
+
+  if ((Request->Request != USB_NCM_GET_NTB_PARAMETERS_REQ) || (DataLength != sizeof (USB_NCM_NTB_PARAMETERS))) {
+    mFunction.BadAccesses++;
+    return EFI_UNSUPPORTED;
+  }
+
+  Parameters = Data;
+  ZeroMem (Parameters, sizeof (*Parameters));
+  Parameters->Length                 = sizeof (*Parameters);
+  Parameters->NtbFormatsSupported    = BIT0;
+  Parameters->NtbOutMaxSize          = TEST_NTB_OUT_MAX_SIZE;
+  Parameters->NdpOutDivisor          = TEST_NDP_DIVISOR;
+  Parameters->NdpOutPayloadRemainder = TEST_NDP_REMAINDER;
+  Parameters->NdpOutAlignment        = 4;
+  Parameters->NtbOutMaxDatagrams     = 0;
+  *Status                            = EFI_USB_NOERROR;
+  return EFI_SUCCESS;
+}
+
+/**
+  Simulated UsbBulkTransfer() of the NCM function. The NTB is copied so that
+  the driver can reuse its buffer.
+
+  @retval EFI_SUCCESS       The NTB was received.
+  @retval EFI_DEVICE_ERROR  The transfer was selected to fail.
+
+**/
+EFI_STATUS
+EFIAPI
+TestUsbBulkTransfer (
+  IN     EFI_USB_IO_PROTOCOL  *This,
+  IN     UINT8                DeviceEndpoint,
+  IN OUT VOID                 *Data,
+  IN OUT UINTN                *DataLength,
+  IN     UINTN                Timeout,
+  OUT    UINT32               *Status
+  )
+{
+  mFunction.Transfers++;
+  if (mFunction.Transfers == mFunction.FailTransfer) {
+    *Status = EFI_USB_ERR_TIMEOUT;
+    return EFI_DEVICE_ERROR;
+  }
+
+  if ((DeviceEndpoint != TEST_BULK_OUT) || (*DataLength > TEST_NTB_OUT_MAX_SIZE) || (mFunction.NtbCount == TEST_MAX_NTBS)) {
+    mFunction.BadAccesses++;
+    return EFI_DEVICE_ERROR;
+  }
+
+  CopyMem (mFunction.Ntbs[mFunction.NtbCount].Data, Data, *DataLength);
+  mFunction.Ntbs[mFunction.NtbCount].Length = *DataLength;
+  mFunction.NtbCount++;
+  *Status = EFI_USB_NOERROR;
+  return EFI_SUCCESS;
+}
+
+/**
+  Simulated gBS->HandleProtocol(), returning the USB I/O protocol of the data
+  interface.
+
+  @retval EFI_SUCCESS       The protocol is returned.
+
+**/
+EFI_STATUS
+EFIAPI
+TestHandleProtocol (
+  IN  EFI_HANDLE  Handle,
+  IN  EFI_GUID    *Protocol,
+  OUT VOID        **Interface
+  )
+{
+  *Interface = &mUsbIo;
+  return EFI_SUCCESS;
+}
+
+/**
+  Stub of the endpoint discovery of UsbNcmFunction.c.
+
+  @param[in]      UsbIo         A pointer to the EFI_USB_IO_PROTOCOL instance.
+  @param[in, out] UsbEthDriver  A pointer to the USB_ETHERNET_DRIVER instance.
+
+**/
+VOID
+GetEndpoint (
+  IN      EFI_USB_IO_PROTOCOL  *UsbIo,
+  IN OUT  USB_ETHERNET_DRIVER  *UsbEthDriver
+  )
+{
+  UsbEthDriver->BulkOutEndpoint = TEST_BULK_OUT;
+}
+
+/**
+  Build an IPv4 frame in mFrame, with the checksum fields as the network
+  stack leaves them for the offloads.
+
+  @param[in]  Protocol          TEST_IP_PROTO_TCP or TEST_IP_PROTO_UDP.
+  @param[in]  PayloadLength     The length of the TCP or UDP payload.
+  @param[in]  TcpFlags          The TCP flags.
+
+  @return The size of the frame.
+
+**/
+STATIC
+UINTN
+TestBuildFrame (
+  IN UINT8  Protocol,
+  IN UINTN  PayloadLength,
+  IN UINT8  TcpFlags
+  )
+{
+  UINT8  *Ip;
+  UINT8  *Transport;
+  UINTN  TransportHeaderSize;
+  UINTN  Index;
+
+  TransportHeaderSize = (Protocol == TEST_IP_PROTO_TCP) ? TEST_TCP_HEADER_SIZE : TEST_UDP_HEADER_SIZE;
+
+  ZeroMem (mFrame, sizeof (mFrame));
+  TestWriteNet16 (mFrame + 12, 0x0800);
+
+  Ip    = mFrame + TEST_NETWORK_OFFSET;
+  Ip[0] = 0x45;
+  TestWriteNet16 (Ip + 2, (UINT16)(TEST_IP4_HEADER_SIZE + TransportHeaderSize + PayloadLength));
+  TestWriteNet16 (Ip + 4, TEST_IDENTIFICATION);
+  Ip[8]  = 64;
+  Ip[9]  = Protocol;
+  Ip[12] = 192;
+  Ip[13] = 168;
+  Ip[15] = 1;
+  Ip[16] = 192;
+  Ip[17] = 168;
+  Ip[19] = 2;
+
+  Transport = mFrame + TEST_TRANSPORT_OFFSET;
+  TestWriteNet16 (Transport, 49152);
+  TestWriteNet16 (Transport + 2, 80);
+  if (Protocol == TEST_IP_PROTO_TCP) {
+    Transport[4]  = (UINT8)(TEST_SEQUENCE >> 24);
+    Transport[5]  = (UINT8)(TEST_SEQUENCE >> 16);
+    Transport[6]  = (UINT8)(TEST_SEQUENCE >> 8);
+    Transport[7]  = (UINT8)TEST_SEQUENCE;
+    Transport[12] = (TEST_TCP_HEADER_SIZE / 4) << 4;
+    Transport[13] = TcpFlags;
+    TestWriteNet16 (Transport + 14, 0xFFFF);
+    TestWriteNet16 (Transport + 16, TestPseudoHeaderChecksum (Ip, 0));
+  } else {
+    TestWriteNet16 (Transport + 4, (UINT16)(TEST_UDP_HEADER_SIZE + PayloadLength));
+    TestWriteNet16 (Transport + 6, TestPseudoHeaderChecksum (Ip, 0));
+  }
+
+  for (Index = 0; Index < PayloadLength; Index++) {
+    Transport[TransportHeaderSize + Index] = (UINT8)(Index * 7 + Index / 251);
+  }
+
+  return TEST_TRANSPORT_OFFSET + TransportHeaderSize + PayloadLength;
+}
+
+/**
+  Get a datagram of an NTB received by the simulated function, after checking
+  the NTB headers.
+
+  @param[in]   Ntb        The NTB.
+  @param[in]   Index      The index of the datagram.
+  @param[out]  Length     The length of the datagram.
+
+  @return The datagram, or NULL if the datagram table ends before Index or an
+          NTB header is not valid.
+
+**/
+STATIC
+UINT8 *
+TestGetDatagram (
+  IN  TEST_NTB  *Ntb,
+  IN  UINTN     Index,
+  OUT UINTN     *Length
+  )
+{
+  USB_NCM_TRANSFER_HEADER_16   *Nth;
+  USB_NCM_DATAGRAM_POINTER_16  *Ndp;
+  USB_NCM_DATA_GRAM            *Datagram;
+
+  Nth = (USB_NCM_TRANSFER_HEADER_16 *)Ntb->Data;
+  if ((Nth->Signature != USB_NCM_NTH_SIGN_16) || (Nth->BlockLength != Ntb->Length) ||
+      (Nth->NdpIndex + sizeof (USB_NCM_DATAGRAM_POINTER_16) > Ntb->Length))
+  {
+    return NULL;
+  }
+
+  Ndp = (USB_NCM_DATAGRAM_POINTER_16 *)(Ntb->Data + Nth->NdpIndex);
+  if ((Ndp->Signature != USB_NCM_NDP_SIGN_16) ||
+      ((Index + 1) * sizeof (USB_NCM_DATA_GRAM) + sizeof (USB_NCM_DATAGRAM_POINTER_16) > Ndp->Length))
+  {
+    return NULL;
+  }
+
+  Datagram = (USB_NCM_DATA_GRAM *)(Ndp + 1) + Index;
+  if ((Datagram->DatagramIndex == 0) || ((UINTN)Datagram->DatagramIndex + Datagram->DatagramLength > Ntb->Length)) {
+    return NULL;
+  }
+
+  *Length = Datagram->DatagramLength;
+  return Ntb->Data + Datagram->DatagramIndex;
+}
+
+/**
+  Set up the simulated function and the offloads of the driver.
+
+  @param[in]  Context   Unused.
+
+  @retval UNIT_TEST_PASSED              The offloads are set up.
+  @retval UNIT_TEST_ERROR_PREREQUISITE_NOT_MET  UsbEthNcmOffloadInit() failed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+UsbNcmOffloadTestSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ZeroMem (&mFunction, sizeof (mFunction));
+  ZeroMem (&mUsbIo, sizeof (mUsbIo));
+  ZeroMem (&mBootServices, sizeof (mBootServices));
+  ZeroMem (&mUsbEthDriver, sizeof (mUsbEthDriver));
+
+  mUsbIo.UsbControlTransfer    = TestUsbControlTransfer;
+  mUsbIo.UsbBulkTransfer       = TestUsbBulkTransfer;
+  mBootServices.HandleProtocol = TestHandleProtocol;
+
+  mUsbEthDriver.Signature = USB_ETHERNET_SIGNATURE;
+  mUsbEthDriver.UsbIo     = &mUsbIo;
+
+  if (EFI_ERROR (UsbEthNcmOffloadInit (&mUsbEthDriver))) {
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the NTB buffer of the driver.
+
+  @param[in]  Context   Unused.
+
+**/
+VOID
+EFIAPI
+UsbNcmOffloadTestCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  if (mUsbEthDriver.NtbOutBuffer != NULL) {
+    FreePool (mUsbEthDriver.NtbOutBuffer);
+    mUsbEthDriver.NtbOutBuffer = NULL;
+  }
+}
+
+/**
+  A large send is cut into segments of the segment size, with consecutive
+  sequence numbers and IPv4 identifications, valid checksums, and the FIN and
+  PSH flags on the last segment only. The segments are packed into NTBs no
+  larger than the function accepts, at the offsets it asks for.
+
+  @param[in]  Context   Unused.
+
+  @retval UNIT_TEST_PASSED    The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+LargeSendIsSegmented (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                     Status;
+  EDKII_NETWORK_OFFLOAD_TX_INFO  TxInfo;
+  UINTN                          PayloadLength;
+  UINTN                          FrameSize;
+  UINTN                          NtbIndex;
+  UINTN                          DatagramIndex;
+  UINTN                          DatagramLength;
+  UINTN                          Segments;
+  UINTN                          Sent;
+  UINTN                          SegmentLength;
+  UINT8                          *Frame;
+  UINT8                          *Ip;
+  UINT8                          *Tcp;
+  UINT16                         TotalLength;
+
+  PayloadLength = 40000;
+  FrameSize     = TestBuildFrame (TEST_IP_PROTO_TCP, PayloadLength, TEST_TCP_FLAG_ACK | TEST_TCP_FLAG_PSH | TEST_TCP_FLAG_FIN);
+
+  TxInfo.Flags           = TEST_TX_ALL;
+  TxInfo.NetworkOffset   = TEST_NETWORK_OFFSET;
+  TxInfo.TransportOffset = TEST_TRANSPORT_OFFSET;
+  TxInfo.SegmentSize     = TEST_SEGMENT_SIZE;
+
+  Status = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize, mFrame);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  //
+  // 28 segments of 1518 bytes at most need three NTBs of 16 KB.
+  //
+  UT_ASSERT_EQUAL (mFunction.NtbCount, 3);
+  UT_ASSERT_EQUAL (mFunction.BadAccesses, 0);
+
+  Segments = 0;
+  Sent     = 0;
+  for (NtbIndex = 0; NtbIndex < mFunction.NtbCount; NtbIndex++) {
+    UT_ASSERT_EQUAL (((USB_NCM_TRANSFER_HEADER_16 *)mFunction.Ntbs[NtbIndex].Data)->Sequence, NtbIndex);
+
+    for (DatagramIndex = 0; ; DatagramIndex++) {
+      Frame = TestGetDatagram (&mFunction.Ntbs[NtbIndex], DatagramIndex, &DatagramLength);
+      if (Frame == NULL) {
+        break;
+      }
+
+      UT_ASSERT_EQUAL ((Frame - mFunction.Ntbs[NtbIndex].Data) % TEST_NDP_DIVISOR, TEST_NDP_REMAINDER);
+
+      Ip            = Frame + TEST_NETWORK_OFFSET;
+      Tcp           = Frame + TEST_TRANSPORT_OFFSET;
+      SegmentLength = MIN (TEST_SEGMENT_SIZE, PayloadLength - Sent);
+      TotalLength   = TestReadNet16 (Ip + 2);
+
+      UT_ASSERT_EQUAL (DatagramLength, TEST_TCP_HEADERS_SIZE + SegmentLength);
+      UT_ASSERT_EQUAL (TotalLength, TEST_IP4_HEADER_SIZE + TEST_TCP_HEADER_SIZE + SegmentLength);
+      UT_ASSERT_EQUAL (TestReadNet16 (Ip + 4), (UINT16)(TEST_IDENTIFICATION + Segments));
+      UT_ASSERT_EQUAL (TestReadNet32 (Tcp + 4), (UINT32)(TEST_SEQUENCE + Sent));
+      UT_ASSERT_MEM_EQUAL (Frame, mFrame, TEST_MEDIA_HEADER_SIZE);
+      UT_ASSERT_MEM_EQUAL (Tcp + TEST_TCP_HEADER_SIZE, mFrame + TEST_TCP_HEADERS_SIZE + Sent, SegmentLength);
+
+      UT_ASSERT_EQUAL (TestChecksum (Ip, TEST_IP4_HEADER_SIZE, 0), 0xFFFF);
+      UT_ASSERT_EQUAL (
+        TestChecksum (Tcp, TotalLength - TEST_IP4_HEADER_SIZE, TestPseudoHeaderChecksum (Ip, TotalLength - TEST_IP4_HEADER_SIZE)),
+        0xFFFF
+        );
+
+      Sent += SegmentLength;
+      Segments++;
+
+      if (Sent < PayloadLength) {
+        UT_ASSERT_EQUAL (Tcp[13], TEST_TCP_FLAG_ACK);
+      } else {
+        UT_ASSERT_EQUAL (Tcp[13], TEST_TCP_FLAG_ACK | TEST_TCP_FLAG_PSH | TEST_TCP_FLAG_FIN);
+      }
+    }
+
+    UT_ASSERT_TRUE (DatagramIndex > 0);
+    UT_ASSERT_TRUE (DatagramIndex <= USB_NCM_MAX_OUT_DATAGRAMS);
+  }
+
+  UT_ASSERT_EQUAL (Segments, (PayloadLength + TEST_SEGMENT_SIZE - 1) / TEST_SEGMENT_SIZE);
+  UT_ASSERT_EQUAL (Sent, PayloadLength);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The TCP and UDP checksums of a frame sent without large send are completed,
+  and a UDP checksum is never left zero.
+
+  @param[in]  Context   Unused.
+
+  @retval UNIT_TEST_PASSED    The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+ChecksumsAreCompleted (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                     Status;
+  EDKII_NETWORK_OFFLOAD_TX_INFO  TxInfo;
+  UINTN                          FrameSize;
+  UINTN                          DatagramLength;
+  UINT8                          *Frame;
+  UINT8                          *Ip;
+
+  //
+  // A TCP frame with an odd payload length.
+  //
+  FrameSize = TestBuildFrame (TEST_IP_PROTO_TCP, 101, TEST_TCP_FLAG_ACK | TEST_TCP_FLAG_PSH);
+
+  TxInfo.Flags           = EDKII_NETWORK_OFFLOAD_TX_IP4_CHECKSUM | EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM;
+  TxInfo.NetworkOffset   = TEST_NETWORK_OFFSET;
+  TxInfo.TransportOffset = TEST_TRANSPORT_OFFSET;
+  TxInfo.SegmentSize     = 0;
+
+  Status = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize, mFrame);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mFunction.NtbCount, 1);
+
+  Frame = TestGetDatagram (&mFunction.Ntbs[0], 0, &DatagramLength);
+  UT_ASSERT_NOT_NULL (Frame);
+  UT_ASSERT_EQUAL (DatagramLength, FrameSize);
+  UT_ASSERT_TRUE (TestGetDatagram (&mFunction.Ntbs[0], 1, &DatagramLength) == NULL);
+
+  Ip = Frame + TEST_NETWORK_OFFSET;
+  UT_ASSERT_EQUAL (TestChecksum (Ip, TEST_IP4_HEADER_SIZE, 0), 0xFFFF);
+  UT_ASSERT_EQUAL (
+    TestChecksum (Frame + TEST_TRANSPORT_OFFSET, TEST_TCP_HEADER_SIZE + 101, TestPseudoHeaderChecksum (Ip, TEST_TCP_HEADER_SIZE + 101)),
+    0xFFFF
+    );
+  UT_ASSERT_MEM_EQUAL (Frame + TEST_TCP_HEADERS_SIZE, mFrame + TEST_TCP_HEADERS_SIZE, 101);
+
+  //
+  // A UDP frame, with the IPv4 checksum left to the network stack.
+  //
+  FrameSize = TestBuildFrame (TEST_IP_PROTO_UDP, 257, 0);
+
+  TxInfo.Flags = EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM;
+
+  Status = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize, mFrame);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mFunction.NtbCount, 2);
+
+  Frame = TestGetDatagram (&mFunction.Ntbs[1], 0, &DatagramLength);
+  UT_ASSERT_NOT_NULL (Frame);
+  UT_ASSERT_EQUAL (DatagramLength, FrameSize);
+
+  Ip = Frame + TEST_NETWORK_OFFSET;
+  UT_ASSERT_EQUAL (TestReadNet16 (Ip + 10), 0);
+  UT_ASSERT_NOT_EQUAL (TestReadNet16 (Frame + TEST_TRANSPORT_OFFSET + 6), 0);
+  UT_ASSERT_EQUAL (
+    TestChecksum (Frame + TEST_TRANSPORT_OFFSET, TEST_UDP_HEADER_SIZE + 257, TestPseudoHeaderChecksum (Ip, TEST_UDP_HEADER_SIZE + 257)),
+    0xFFFF
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Frames that do not match the offloads requested for them are rejected
+  before anything is sent.
+
+  @param[in]  Context   Unused.
+
+  @retval UNIT_TEST_PASSED    The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+MismatchedFramesAreRejected (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                     Status;
+  EDKII_NETWORK_OFFLOAD_TX_INFO  TxInfo;
+  UINTN                          FrameSize;
+
+  FrameSize = TestBuildFrame (TEST_IP_PROTO_TCP, 4000, TEST_TCP_FLAG_ACK);
+
+  TxInfo.Flags           = TEST_TX_ALL | EDKII_NETWORK_OFFLOAD_RX_TCP4_CHECKSUM;
+  TxInfo.NetworkOffset   = TEST_NETWORK_OFFSET;
+  TxInfo.TransportOffset = TEST_TRANSPORT_OFFSET;
+  TxInfo.SegmentSize     = TEST_SEGMENT_SIZE;
+
+  Status = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize, mFrame);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_UNSUPPORTED);
+
+  TxInfo.Flags = EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM;
+  Status       = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize, mFrame);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+  TxInfo.Flags       = TEST_TX_ALL;
+  TxInfo.SegmentSize = 0;
+  Status             = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize, mFrame);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+  TxInfo.SegmentSize     = TEST_SEGMENT_SIZE;
+  TxInfo.TransportOffset = TEST_TRANSPORT_OFFSET + 4;
+  Status                 = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize, mFrame);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+  TxInfo.TransportOffset = TEST_TRANSPORT_OFFSET;
+  Status                 = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize - 1, mFrame);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+  Status = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, USB_NCM_MAX_LARGE_SEND_SIZE + 1, mFrame);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+  UT_ASSERT_EQUAL (mFunction.Transfers, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A failed bulk transfer in the middle of a large send fails the send and
+  drops the NTB being built, so that the next send starts with an empty NTB.
+
+  @param[in]  Context   Unused.
+
+  @retval UNIT_TEST_PASSED    The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FailedTransferDropsTheNtb (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                     Status;
+  EDKII_NETWORK_OFFLOAD_TX_INFO  TxInfo;
+  UINTN                          FrameSize;
+  UINTN                          DatagramLength;
+  UINT8                          *Frame;
+
+  FrameSize = TestBuildFrame (TEST_IP_PROTO_TCP, 40000, TEST_TCP_FLAG_ACK);
+
+  TxInfo.Flags           = TEST_TX_ALL;
+  TxInfo.NetworkOffset   = TEST_NETWORK_OFFSET;
+  TxInfo.TransportOffset = TEST_TRANSPORT_OFFSET;
+  TxInfo.SegmentSize     = TEST_SEGMENT_SIZE;
+
+  mFunction.FailTransfer = 2;
+
+  Status = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize, mFrame);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_EQUAL (mFunction.Transfers, 2);
+  UT_ASSERT_EQUAL (mFunction.NtbCount, 1);
+
+  FrameSize    = TestBuildFrame (TEST_IP_PROTO_TCP, 100, TEST_TCP_FLAG_ACK);
+  TxInfo.Flags = EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM;
+
+  Status = mUsbEthDriver.NetworkOffload.Transmit (&mUsbEthDriver.NetworkOffload, &TxInfo, FrameSize, mFrame);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mFunction.NtbCount, 2);
+
+  Frame = TestGetDatagram (&mFunction.Ntbs[1], 0, &DatagramLength);
+  UT_ASSERT_NOT_NULL (Frame);
+  UT_ASSERT_EQUAL (DatagramLength, FrameSize);
+  UT_ASSERT_TRUE (TestGetDatagram (&mFunction.Ntbs[1], 1, &DatagramLength) == NULL);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the network
+  offloads of UsbCdcNcm and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+UsbNcmOffloadUnitTestEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      OffloadTestSuite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &OffloadTestSuite,
+             Framework,
+             "USB NCM Network Offload Test Suite",
+             "UsbNcm.Offload",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for OffloadTestSuite. Status = %r\n", Status));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (OffloadTestSuite, "A large send is segmented", "LargeSendIsSegmented", LargeSendIsSegmented, UsbNcmOffloadTestSetup, UsbNcmOffloadTestCleanup, NULL);
+  AddTestCase (OffloadTestSuite, "Checksums are completed", "ChecksumsAreCompleted", ChecksumsAreCompleted, UsbNcmOffloadTestSetup, UsbNcmOffloadTestCleanup, NULL);
+  AddTestCase (OffloadTestSuite, "Mismatched frames are rejected", "MismatchedFramesAreRejected", MismatchedFramesAreRejected, UsbNcmOffloadTestSetup, UsbNcmOffloadTestCleanup, NULL);
+  AddTestCase (OffloadTestSuite, "A failed transfer drops the NTB", "FailedTransferDropsTheNtb", FailedTransferDropsTheNtb, UsbNcmOffloadTestSetup, UsbNcmOffloadTestCleanup, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UsbNcmOffloadUnitTestEntry ();
+}
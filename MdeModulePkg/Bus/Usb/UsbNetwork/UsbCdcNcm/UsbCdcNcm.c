@@ -409,6 +409,37 @@ UsbNcmDriverStart (
     return Status;
   }
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // The network stack works without the offloads, so a failure here does
+  // not fail the driver.
+  //
+  if (!FeaturePcdGet (PcdUsbNcmNetworkOffloadEnable)) {
+    return Status;
+  }
+
+  Status = UsbEthNcmOffloadInit (UsbEthDriver);
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->InstallProtocolInterface (
+                    &ControllerHandle,
+                    &gEdkiiNetworkOffloadProtocolGuid,
+                    EFI_NATIVE_INTERFACE,
+                    &UsbEthDriver->NetworkOffload
+                    );
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "%a:No network offloads, status = %r\n", __func__, Status));
+    if (UsbEthDriver->NtbOutBuffer != NULL) {
+      FreePool (UsbEthDriver->NtbOutBuffer);
+      UsbEthDriver->NtbOutBuffer = NULL;
+    }
+
+    Status = EFI_SUCCESS;
+  }
+
+  // MU_CHANGE [END]
+
   return Status;
 }
 
@@ -467,6 +498,18 @@ UsbNcmDriverStop (
                   This->DriverBindingHandle,
                   ControllerHandle
                   );
+  // MU_CHANGE [BEGIN] - Network offloads
+  if (UsbEthDriver->NtbOutBuffer != NULL) {
+    gBS->UninstallProtocolInterface (
+           ControllerHandle,
+           &gEdkiiNetworkOffloadProtocolGuid,
+           &UsbEthDriver->NetworkOffload
+           );
+    FreePool (UsbEthDriver->NtbOutBuffer);
+  }
+
+  // MU_CHANGE [END]
+
   FreePool (UsbEthDriver->Config);
   FreePool (UsbEthDriver->BulkBuffer);
   FreePool (UsbEthDriver);
@@ -16,24 +16,37 @@
 #include <Library/MemoryAllocationLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/UefiUsbLib.h>
+#include <Library/PcdLib.h> // MU_CHANGE - Network offloads
 #include <Protocol/UsbIo.h>
 #include <Protocol/UsbEthernetProtocol.h>
+#include <Protocol/NetworkOffload.h> // MU_CHANGE - Network offloads
 
 typedef struct {
-  UINTN                          Signature;
-  EDKII_USB_ETHERNET_PROTOCOL    UsbEth;
-  EFI_HANDLE                     UsbCdcDataHandle;
-  EFI_USB_IO_PROTOCOL            *UsbIo;
-  EFI_USB_CONFIG_DESCRIPTOR      *Config;
-  UINT8                          NumOfInterface;
-  UINT8                          BulkInEndpoint;
-  UINT8                          BulkOutEndpoint;
-  UINT8                          InterruptEndpoint;
-  EFI_MAC_ADDRESS                MacAddress;
-  UINT16                         BulkOutSequence;
-  UINT8                          *BulkBuffer;
-  UINT8                          TotalDatagram;
-  UINT8                          NowDatagram;
+  UINTN                             Signature;
+  EDKII_USB_ETHERNET_PROTOCOL       UsbEth;
+  EFI_HANDLE                        UsbCdcDataHandle;
+  EFI_USB_IO_PROTOCOL               *UsbIo;
+  EFI_USB_CONFIG_DESCRIPTOR         *Config;
+  UINT8                             NumOfInterface;
+  UINT8                             BulkInEndpoint;
+  UINT8                             BulkOutEndpoint;
+  UINT8                             InterruptEndpoint;
+  EFI_MAC_ADDRESS                   MacAddress;
+  UINT16                            BulkOutSequence;
+  UINT8                             *BulkBuffer;
+  UINT8                             TotalDatagram;
+  UINT8                             NowDatagram;
+  // MU_CHANGE [BEGIN] - Network offloads
+  EDKII_NETWORK_OFFLOAD_PROTOCOL    NetworkOffload;
+  UINT8                             *NtbOutBuffer;
+  UINT32                            NtbOutMaxSize;
+  UINT16                            NtbOutMaxDatagrams;
+  UINT16                            NdpOutDivisor;
+  UINT16                            NdpOutRemainder;
+  UINT16                            NdpOutIndex;
+  UINT16                            NtbOutLength;
+  UINT16                            NtbOutDatagrams;
+  // MU_CHANGE [END]
 } USB_ETHERNET_DRIVER;
 
 #define USB_NCM_DRIVER_VERSION         1
@@ -71,8 +84,39 @@ typedef struct {
   UINT16    DatagramLength;
 } USB_NCM_DATA_GRAM;
 
+// MU_CHANGE [BEGIN] - Network offloads
+// Defined in USB NCM 1.0 spec., section 6.2.1
+#define USB_NCM_GET_NTB_PARAMETERS_REQ  0x80
+
+#pragma pack(1)
+typedef struct {
+  UINT16    Length;
+  UINT16    NtbFormatsSupported;
+  UINT32    NtbInMaxSize;
+  UINT16    NdpInDivisor;
+  UINT16    NdpInPayloadRemainder;
+  UINT16    NdpInAlignment;
+  UINT16    Reserved;
+  UINT32    NtbOutMaxSize;
+  UINT16    NdpOutDivisor;
+  UINT16    NdpOutPayloadRemainder;
+  UINT16    NdpOutAlignment;
+  UINT16    NtbOutMaxDatagrams;
+} USB_NCM_NTB_PARAMETERS;
+#pragma pack()
+
+//
+// The datagrams of a large send are packed into NTBs of at most this many
+// datagrams, and of the largest size the function accepts.
+//
+#define USB_NCM_MAX_OUT_DATAGRAMS    32
+#define USB_NCM_MIN_NTB_OUT_SIZE     2048
+#define USB_NCM_MAX_LARGE_SEND_SIZE  SIZE_64KB
+// MU_CHANGE [END]
+
 #define USB_ETHERNET_SIGNATURE  SIGNATURE_32('u', 'e', 't', 'h')
 #define USB_ETHERNET_DEV_FROM_THIS(a)  CR (a, USB_ETHERNET_DRIVER, UsbEth, USB_ETHERNET_SIGNATURE)
+#define USB_ETHERNET_DEV_FROM_OFFLOAD(a)  CR (a, USB_ETHERNET_DRIVER, NetworkOffload, USB_ETHERNET_SIGNATURE) // MU_CHANGE - Network offloads
 
 typedef struct {
   UINT16    Src;
@@ -242,4 +286,21 @@ GetUsbEthStatistic (
   OUT VOID                         *Statistic
   );
 
+// MU_CHANGE [BEGIN] - Network offloads
+EFI_STATUS
+UsbEthNcmOffloadInit (
+  IN OUT USB_ETHERNET_DRIVER  *UsbEthDriver
+  );
+
+EFI_STATUS
+EFIAPI
+UsbEthNcmOffloadTransmit (
+  IN EDKII_NETWORK_OFFLOAD_PROTOCOL       *This,
+  IN CONST EDKII_NETWORK_OFFLOAD_TX_INFO  *TxInfo,
+  IN UINTN                                BufferSize,
+  IN VOID                                 *Buffer
+  );
+
+// MU_CHANGE [END]
+
 #endif
@@ -0,0 +1,617 @@
+/** @file
+  This file contains the checksum and large send offloads of the USB NCM
+  driver.
+
+  The NCM function does not compute checksums, so the driver completes them
+  while it copies the frames into the NTB. What the offloads save is the work
+  of the network stack and the bulk transfers: a large TCP send is cut into
+  segments here, and the segments are packed together into NTBs of up to the
+  size the function accepts, each sent with one bulk transfer.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "UsbCdcNcm.h"
+
+#define USB_NCM_IP4_VERSION            4
+#define USB_NCM_IP4_MIN_HEADER_SIZE    20
+#define USB_NCM_IP4_TOTAL_LENGTH       2
+#define USB_NCM_IP4_IDENTIFICATION     4
+#define USB_NCM_IP4_CHECKSUM           10
+#define USB_NCM_TCP_MIN_HEADER_SIZE    20
+#define USB_NCM_TCP_SEQUENCE           4
+#define USB_NCM_TCP_HEADER_LENGTH      12
+#define USB_NCM_TCP_FLAGS              13
+#define USB_NCM_TCP_CHECKSUM           16
+#define USB_NCM_TCP_FLAG_FIN           BIT0
+#define USB_NCM_TCP_FLAG_PSH           BIT3
+#define USB_NCM_UDP_HEADER_SIZE        8
+#define USB_NCM_UDP_CHECKSUM           6
+#define USB_NCM_DEFAULT_NDP_DIVISOR    4
+#define USB_NCM_DEFAULT_NDP_ALIGNMENT  4
+
+#define USB_NCM_TX_CAPABILITIES  (EDKII_NETWORK_OFFLOAD_TX_IP4_CHECKSUM  | \
+                                  EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM | \
+                                  EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM | \
+                                  EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND)
+
+/**
+  Read a 16-bit value in network byte order.
+
+  @param[in]  Data    A pointer to the value.
+
+  @return The value in host byte order.
+
+**/
+STATIC
+UINT16
+ReadNet16 (
+  IN CONST UINT8  *Data
+  )
+{
+  return (UINT16)((Data[0] << 8) | Data[1]);
+}
+
+/**
+  Write a 16-bit value in network byte order.
+
+  @param[out]  Data     A pointer to the value.
+  @param[in]   Value    The value in host byte order.
+
+**/
+STATIC
+VOID
+WriteNet16 (
+  OUT UINT8   *Data,
+  IN  UINT16  Value
+  )
+{
+  Data[0] = (UINT8)(Value >> 8);
+  Data[1] = (UINT8)Value;
+}
+
+/**
+  Add the bytes of a buffer, as 16-bit words in network byte order, to a one's
+  complement sum.
+
+  @param[in]  Data      A pointer to the buffer.
+  @param[in]  Length    The length of the buffer.
+  @param[in]  Sum       The sum of the previous words.
+
+  @return The one's complement sum, not complemented.
+
+**/
+STATIC
+UINT16
+UsbNcmChecksum (
+  IN CONST UINT8  *Data,
+  IN UINTN        Length,
+  IN UINT32       Sum
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index + 1 < Length; Index += 2) {
+    Sum += ((UINT32)Data[Index] << 8) | Data[Index + 1];
+  }
+
+  if ((Length & 1) != 0) {
+    Sum += (UINT32)Data[Length - 1] << 8;
+  }
+
+  while ((Sum >> 16) != 0) {
+    Sum = (Sum & 0xFFFF) + (Sum >> 16);
+  }
+
+  return (UINT16)Sum;
+}
+
+/**
+  Check that a frame matches the offloads requested for it.
+
+  @param[in]  TxInfo        The offloads to apply.
+  @param[in]  BufferSize    The size of the frame.
+  @param[in]  Frame         The frame, media header included.
+
+  @retval EFI_SUCCESS           The offloads can be applied to the frame.
+  @retval EFI_INVALID_PARAMETER The frame does not match TxInfo.
+
+**/
+STATIC
+EFI_STATUS
+UsbNcmCheckFrame (
+  IN CONST EDKII_NETWORK_OFFLOAD_TX_INFO  *TxInfo,
+  IN UINTN                                BufferSize,
+  IN CONST UINT8                          *Frame
+  )
+{
+  CONST UINT8  *Ip;
+  UINTN        IpEnd;
+  UINTN        TransportHeaderSize;
+
+  if (TxInfo->Flags == 0) {
+    return EFI_SUCCESS;
+  }
+
+  if ((TxInfo->Flags & (EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM)) ==
+      (EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((UINTN)TxInfo->NetworkOffset + USB_NCM_IP4_MIN_HEADER_SIZE > BufferSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Ip = Frame + TxInfo->NetworkOffset;
+  if (((Ip[0] >> 4) != USB_NCM_IP4_VERSION) ||
+      ((Ip[0] & 0x0F) * 4 < USB_NCM_IP4_MIN_HEADER_SIZE) ||
+      ((UINTN)TxInfo->NetworkOffset + (Ip[0] & 0x0F) * 4 != TxInfo->TransportOffset))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IpEnd = TxInfo->NetworkOffset + ReadNet16 (Ip + USB_NCM_IP4_TOTAL_LENGTH);
+  if ((IpEnd > BufferSize) || (IpEnd < TxInfo->TransportOffset)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((TxInfo->Flags & EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM) != 0) {
+    TransportHeaderSize = USB_NCM_UDP_HEADER_SIZE;
+  } else if ((TxInfo->Flags & (EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND)) != 0) {
+    TransportHeaderSize = USB_NCM_TCP_MIN_HEADER_SIZE;
+  } else {
+    TransportHeaderSize = 0;
+  }
+
+  if (TxInfo->TransportOffset + TransportHeaderSize > IpEnd) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((TxInfo->Flags & EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND) != 0) {
+    TransportHeaderSize = (Frame[TxInfo->TransportOffset + USB_NCM_TCP_HEADER_LENGTH] >> 4) * 4;
+    if ((TxInfo->SegmentSize == 0) ||
+        (TransportHeaderSize < USB_NCM_TCP_MIN_HEADER_SIZE) ||
+        (TxInfo->TransportOffset + TransportHeaderSize > IpEnd))
+    {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Complete the checksums requested for a frame.
+
+  The checksum field of the TCP or UDP header holds the sum of the
+  pseudo-header without the length, so the length and the bytes of the
+  segment are added to it.
+
+  @param[in, out]  Frame     The frame, media header included.
+  @param[in]       TxInfo    The offloads to apply.
+
+**/
+STATIC
+VOID
+UsbNcmCompleteChecksums (
+  IN OUT UINT8                                *Frame,
+  IN     CONST EDKII_NETWORK_OFFLOAD_TX_INFO  *TxInfo
+  )
+{
+  UINT8   *Ip;
+  UINT8   *Transport;
+  UINT16  TransportLength;
+  UINT16  Checksum;
+  UINTN   ChecksumOffset;
+
+  Ip        = Frame + TxInfo->NetworkOffset;
+  Transport = Frame + TxInfo->TransportOffset;
+
+  if ((TxInfo->Flags & (EDKII_NETWORK_OFFLOAD_TX_IP4_CHECKSUM | EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND)) != 0) {
+    WriteNet16 (Ip + USB_NCM_IP4_CHECKSUM, 0);
+    Checksum = (UINT16)~UsbNcmChecksum (Ip, TxInfo->TransportOffset - TxInfo->NetworkOffset, 0);
+    WriteNet16 (Ip + USB_NCM_IP4_CHECKSUM, Checksum);
+  }
+
+  if ((TxInfo->Flags & EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM) != 0) {
+    ChecksumOffset = USB_NCM_UDP_CHECKSUM;
+  } else if ((TxInfo->Flags & (EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND)) != 0) {
+    ChecksumOffset = USB_NCM_TCP_CHECKSUM;
+  } else {
+    return;
+  }
+
+  TransportLength = (UINT16)(ReadNet16 (Ip + USB_NCM_IP4_TOTAL_LENGTH) - (TxInfo->TransportOffset - TxInfo->NetworkOffset));
+  Checksum        = (UINT16)~UsbNcmChecksum (Transport, TransportLength, TransportLength);
+
+  //
+  // A zero UDP checksum means no checksum.
+  //
+  if ((ChecksumOffset == USB_NCM_UDP_CHECKSUM) && (Checksum == 0)) {
+    Checksum = 0xFFFF;
+  }
+
+  WriteNet16 (Transport + ChecksumOffset, Checksum);
+}
+
+/**
+  Get the offset of the next datagram of the NTB being built.
+
+  @param[in]  UsbEthDriver    A pointer to the USB_ETHERNET_DRIVER instance.
+
+  @return The offset, aligned as the NCM function requires.
+
+**/
+STATIC
+UINTN
+UsbNcmNextDatagramOffset (
+  IN USB_ETHERNET_DRIVER  *UsbEthDriver
+  )
+{
+  UINTN  Offset;
+
+  Offset = UsbEthDriver->NtbOutLength;
+  return Offset + (UsbEthDriver->NdpOutRemainder + UsbEthDriver->NdpOutDivisor - Offset % UsbEthDriver->NdpOutDivisor) %
+         UsbEthDriver->NdpOutDivisor;
+}
+
+/**
+  Start a new NTB.
+
+  The NDP follows the NTH with room for the largest number of datagrams, and
+  the datagrams follow the NDP.
+
+  @param[in, out]  UsbEthDriver    A pointer to the USB_ETHERNET_DRIVER instance.
+
+**/
+STATIC
+VOID
+UsbNcmResetNtb (
+  IN OUT USB_ETHERNET_DRIVER  *UsbEthDriver
+  )
+{
+  UsbEthDriver->NtbOutDatagrams = 0;
+  UsbEthDriver->NtbOutLength    = (UINT16)(UsbEthDriver->NdpOutIndex + sizeof (USB_NCM_DATAGRAM_POINTER_16) +
+                                           (UsbEthDriver->NtbOutMaxDatagrams + 1) * sizeof (USB_NCM_DATA_GRAM));
+}
+
+/**
+  Send the NTB being built, if it holds datagrams, and start a new one.
+
+  @param[in, out]  UsbEthDriver    A pointer to the USB_ETHERNET_DRIVER instance.
+  @param[in]       UsbIo           A pointer to the EFI_USB_IO_PROTOCOL of the data interface.
+
+  @retval EFI_SUCCESS           The NTB was sent.
+  @retval Others                The bulk transfer failed.
+
+**/
+STATIC
+EFI_STATUS
+UsbNcmFlushNtb (
+  IN OUT USB_ETHERNET_DRIVER  *UsbEthDriver,
+  IN     EFI_USB_IO_PROTOCOL  *UsbIo
+  )
+{
+  EFI_STATUS                   Status;
+  UINT32                       TransStatus;
+  UINTN                        Length;
+  USB_NCM_TRANSFER_HEADER_16   *Nth;
+  USB_NCM_DATAGRAM_POINTER_16  *Ndp;
+  USB_NCM_DATA_GRAM            *Datagram;
+
+  if (UsbEthDriver->NtbOutDatagrams == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Nth               = (USB_NCM_TRANSFER_HEADER_16 *)UsbEthDriver->NtbOutBuffer;
+  Nth->Signature    = USB_NCM_NTH_SIGN_16;
+  Nth->HeaderLength = USB_NCM_NTH_LENGTH;
+  Nth->Sequence     = UsbEthDriver->BulkOutSequence++;
+  Nth->BlockLength  = UsbEthDriver->NtbOutLength;
+  Nth->NdpIndex     = UsbEthDriver->NdpOutIndex;
+
+  Ndp               = (USB_NCM_DATAGRAM_POINTER_16 *)(UsbEthDriver->NtbOutBuffer + UsbEthDriver->NdpOutIndex);
+  Ndp->Signature    = USB_NCM_NDP_SIGN_16;
+  Ndp->Length       = (UINT16)(sizeof (USB_NCM_DATAGRAM_POINTER_16) + (UsbEthDriver->NtbOutDatagrams + 1) * sizeof (USB_NCM_DATA_GRAM));
+  Ndp->NextNdpIndex = 0x00;
+
+  //
+  // The datagram table ends with a null entry.
+  //
+  Datagram                 = (USB_NCM_DATA_GRAM *)(Ndp + 1) + UsbEthDriver->NtbOutDatagrams;
+  Datagram->DatagramIndex  = 0;
+  Datagram->DatagramLength = 0;
+
+  Length = UsbEthDriver->NtbOutLength;
+  UsbNcmResetNtb (UsbEthDriver);
+
+  Status = UsbIo->UsbBulkTransfer (
+                    UsbIo,
+                    UsbEthDriver->BulkOutEndpoint,
+                    UsbEthDriver->NtbOutBuffer,
+                    &Length,
+                    USB_ETHERNET_TRANSFER_TIMEOUT,
+                    &TransStatus
+                    );
+  return Status;
+}
+
+/**
+  Add a datagram to the NTB being built, after sending the NTB if it is full.
+
+  @param[in, out]  UsbEthDriver    A pointer to the USB_ETHERNET_DRIVER instance.
+  @param[in]       UsbIo           A pointer to the EFI_USB_IO_PROTOCOL of the data interface.
+  @param[in]       Length          The length of the datagram.
+  @param[out]      Datagram        A pointer to the datagram in the NTB.
+
+  @retval EFI_SUCCESS           The datagram was added.
+  @retval EFI_INVALID_PARAMETER The datagram does not fit in an NTB.
+  @retval Others                The bulk transfer of the full NTB failed.
+
+**/
+STATIC
+EFI_STATUS
+UsbNcmAddDatagram (
+  IN OUT USB_ETHERNET_DRIVER  *UsbEthDriver,
+  IN     EFI_USB_IO_PROTOCOL  *UsbIo,
+  IN     UINTN                Length,
+  OUT    UINT8                **Datagram
+  )
+{
+  EFI_STATUS         Status;
+  UINTN              Offset;
+  USB_NCM_DATA_GRAM  *Entry;
+
+  Offset = UsbNcmNextDatagramOffset (UsbEthDriver);
+  if ((UsbEthDriver->NtbOutDatagrams == UsbEthDriver->NtbOutMaxDatagrams) ||
+      (Offset + Length > UsbEthDriver->NtbOutMaxSize))
+  {
+    Status = UsbNcmFlushNtb (UsbEthDriver, UsbIo);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Offset = UsbNcmNextDatagramOffset (UsbEthDriver);
+    if (Offset + Length > UsbEthDriver->NtbOutMaxSize) {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  Entry = (USB_NCM_DATA_GRAM *)(UsbEthDriver->NtbOutBuffer + UsbEthDriver->NdpOutIndex +
+                                sizeof (USB_NCM_DATAGRAM_POINTER_16)) + UsbEthDriver->NtbOutDatagrams;
+  Entry->DatagramIndex  = (UINT16)Offset;
+  Entry->DatagramLength = (UINT16)Length;
+
+  UsbEthDriver->NtbOutDatagrams++;
+  UsbEthDriver->NtbOutLength = (UINT16)(Offset + Length);
+
+  *Datagram = UsbEthDriver->NtbOutBuffer + Offset;
+  return EFI_SUCCESS;
+}
+
+/**
+  Retrieve the NTB parameters of the NCM function and set up the offloads.
+
+  @param[in, out]  UsbEthDriver    A pointer to the USB_ETHERNET_DRIVER instance.
+
+  @retval EFI_SUCCESS           The offloads are set up.
+  @retval EFI_OUT_OF_RESOURCES  The NTB buffer could not be allocated.
+
+**/
+EFI_STATUS
+UsbEthNcmOffloadInit (
+  IN OUT USB_ETHERNET_DRIVER  *UsbEthDriver
+  )
+{
+  EFI_STATUS              Status;
+  EFI_USB_DEVICE_REQUEST  Request;
+  UINT32                  TransStatus;
+  USB_NCM_NTB_PARAMETERS  Parameters;
+  UINT16                  NdpOutAlignment;
+
+  ZeroMem (&Parameters, sizeof (Parameters));
+
+  Request.RequestType = USB_ETHERNET_GET_REQ_TYPE;
+  Request.Request     = USB_NCM_GET_NTB_PARAMETERS_REQ;
+  Request.Value       = 0;
+  Request.Index       = UsbEthDriver->NumOfInterface;
+  Request.Length      = sizeof (Parameters);
+
+  Status = UsbEthDriver->UsbIo->UsbControlTransfer (
+                                  UsbEthDriver->UsbIo,
+                                  &Request,
+                                  EfiUsbDataIn,
+                                  USB_ETHERNET_TRANSFER_TIMEOUT,
+                                  &Parameters,
+                                  sizeof (Parameters),
+                                  &TransStatus
+                                  );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "%a:GET_NTB_PARAMETERS status = %r\n", __func__, Status));
+    ZeroMem (&Parameters, sizeof (Parameters));
+  }
+
+  //
+  // Every NCM function accepts NTBs of 2048 bytes with one datagram.
+  //
+  UsbEthDriver->NtbOutMaxSize = MIN (Parameters.NtbOutMaxSize, USB_NCM_MAX_NTB_SIZE);
+  if (UsbEthDriver->NtbOutMaxSize < USB_NCM_MIN_NTB_OUT_SIZE) {
+    UsbEthDriver->NtbOutMaxSize = USB_NCM_MIN_NTB_OUT_SIZE;
+  }
+
+  UsbEthDriver->NtbOutMaxDatagrams = Parameters.NtbOutMaxDatagrams;
+  if ((UsbEthDriver->NtbOutMaxDatagrams == 0) || (UsbEthDriver->NtbOutMaxDatagrams > USB_NCM_MAX_OUT_DATAGRAMS)) {
+    UsbEthDriver->NtbOutMaxDatagrams = USB_NCM_MAX_OUT_DATAGRAMS;
+  }
+
+  UsbEthDriver->NdpOutDivisor   = Parameters.NdpOutDivisor;
+  UsbEthDriver->NdpOutRemainder = Parameters.NdpOutPayloadRemainder;
+  if (UsbEthDriver->NdpOutDivisor == 0) {
+    UsbEthDriver->NdpOutDivisor = USB_NCM_DEFAULT_NDP_DIVISOR;
+  }
+
+  if (UsbEthDriver->NdpOutRemainder >= UsbEthDriver->NdpOutDivisor) {
+    UsbEthDriver->NdpOutRemainder = 0;
+  }
+
+  NdpOutAlignment = Parameters.NdpOutAlignment;
+  if ((NdpOutAlignment < USB_NCM_DEFAULT_NDP_ALIGNMENT) || ((NdpOutAlignment & (NdpOutAlignment - 1)) != 0)) {
+    NdpOutAlignment = USB_NCM_DEFAULT_NDP_ALIGNMENT;
+  }
+
+  UsbEthDriver->NdpOutIndex = (UINT16)ALIGN_VALUE (USB_NCM_NTH_LENGTH, NdpOutAlignment);
+
+  UsbEthDriver->NtbOutBuffer = AllocateZeroPool (UsbEthDriver->NtbOutMaxSize);
+  if (UsbEthDriver->NtbOutBuffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  UsbNcmResetNtb (UsbEthDriver);
+
+  UsbEthDriver->NetworkOffload.Revision         = EDKII_NETWORK_OFFLOAD_PROTOCOL_REVISION;
+  UsbEthDriver->NetworkOffload.Capabilities     = USB_NCM_TX_CAPABILITIES;
+  UsbEthDriver->NetworkOffload.MaxLargeSendSize = USB_NCM_MAX_LARGE_SEND_SIZE;
+  UsbEthDriver->NetworkOffload.Transmit         = UsbEthNcmOffloadTransmit;
+  UsbEthDriver->NetworkOffload.Receive          = NULL;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a:NTB out size %d, %d datagrams\n",
+    __func__,
+    UsbEthDriver->NtbOutMaxSize,
+    UsbEthDriver->NtbOutMaxDatagrams
+    ));
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Transmit a frame with offloads.
+
+  A large send is cut into segments of TxInfo->SegmentSize bytes, each with a
+  copy of the IPv4 and TCP headers. All the datagrams are packed into as few
+  NTBs as possible.
+
+  @param[in]  This          A pointer to the EDKII_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in]  TxInfo        The offloads to apply.
+  @param[in]  BufferSize    The size of the frame.
+  @param[in]  Buffer        The frame, media header included.
+
+  @retval EFI_SUCCESS           The frame was sent.
+  @retval EFI_INVALID_PARAMETER The frame does not match TxInfo or is too large.
+  @retval EFI_UNSUPPORTED       An offload is not supported.
+  @retval Others                The bulk transfer failed.
+
+**/
+EFI_STATUS
+EFIAPI
+UsbEthNcmOffloadTransmit (
+  IN EDKII_NETWORK_OFFLOAD_PROTOCOL       *This,
+  IN CONST EDKII_NETWORK_OFFLOAD_TX_INFO  *TxInfo,
+  IN UINTN                                BufferSize,
+  IN VOID                                 *Buffer
+  )
+{
+  EFI_STATUS           Status;
+  USB_ETHERNET_DRIVER  *UsbEthDriver;
+  EFI_USB_IO_PROTOCOL  *UsbIo;
+  CONST UINT8          *Frame;
+  UINT8                *Datagram;
+  UINT8                *Ip;
+  UINT8                *Tcp;
+  UINTN                HeaderSize;
+  UINTN                PayloadLength;
+  UINTN                SegmentLength;
+  UINTN                Offset;
+  UINT16               Identification;
+  UINT32               Sequence;
+
+  if ((This == NULL) || (TxInfo == NULL) || (Buffer == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  UsbEthDriver = USB_ETHERNET_DEV_FROM_OFFLOAD (This);
+  Frame        = Buffer;
+
+  if ((TxInfo->Flags & ~This->Capabilities) != 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (BufferSize > This->MaxLargeSendSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = UsbNcmCheckFrame (TxInfo, BufferSize, Frame);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->HandleProtocol (
+                  UsbEthDriver->UsbCdcDataHandle,
+                  &gEfiUsbIoProtocolGuid,
+                  (VOID **)&UsbIo
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (UsbEthDriver->BulkOutEndpoint == 0) {
+    GetEndpoint (UsbIo, UsbEthDriver);
+  }
+
+  if ((TxInfo->Flags & EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND) == 0) {
+    Status = UsbNcmAddDatagram (UsbEthDriver, UsbIo, BufferSize, &Datagram);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    CopyMem (Datagram, Frame, BufferSize);
+    UsbNcmCompleteChecksums (Datagram, TxInfo);
+    return UsbNcmFlushNtb (UsbEthDriver, UsbIo);
+  }
+
+  Ip             = (UINT8 *)Frame + TxInfo->NetworkOffset;
+  Tcp            = (UINT8 *)Frame + TxInfo->TransportOffset;
+  HeaderSize     = TxInfo->TransportOffset + (Tcp[USB_NCM_TCP_HEADER_LENGTH] >> 4) * 4;
+  PayloadLength  = TxInfo->NetworkOffset + ReadNet16 (Ip + USB_NCM_IP4_TOTAL_LENGTH) - HeaderSize;
+  Identification = ReadNet16 (Ip + USB_NCM_IP4_IDENTIFICATION);
+  Sequence       = SwapBytes32 (ReadUnaligned32 ((UINT32 *)(Tcp + USB_NCM_TCP_SEQUENCE)));
+  Offset         = 0;
+
+  do {
+    SegmentLength = MIN (TxInfo->SegmentSize, PayloadLength - Offset);
+
+    Status = UsbNcmAddDatagram (UsbEthDriver, UsbIo, HeaderSize + SegmentLength, &Datagram);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    CopyMem (Datagram, Frame, HeaderSize);
+    CopyMem (Datagram + HeaderSize, Frame + HeaderSize + Offset, SegmentLength);
+
+    Ip  = Datagram + TxInfo->NetworkOffset;
+    Tcp = Datagram + TxInfo->TransportOffset;
+    WriteNet16 (Ip + USB_NCM_IP4_TOTAL_LENGTH, (UINT16)(HeaderSize - TxInfo->NetworkOffset + SegmentLength));
+    WriteNet16 (Ip + USB_NCM_IP4_IDENTIFICATION, Identification++);
+    WriteUnaligned32 ((UINT32 *)(Tcp + USB_NCM_TCP_SEQUENCE), SwapBytes32 (Sequence + (UINT32)Offset));
+
+    //
+    // Only the last segment keeps the FIN and PSH flags.
+    //
+    Offset += SegmentLength;
+    if (Offset < PayloadLength) {
+      Tcp[USB_NCM_TCP_FLAGS] &= (UINT8) ~(USB_NCM_TCP_FLAG_FIN | USB_NCM_TCP_FLAG_PSH);
+    }
+
+    UsbNcmCompleteChecksums (Datagram, TxInfo);
+  } while (Offset < PayloadLength);
+
+  if (EFI_ERROR (Status)) {
+    UsbNcmResetNtb (UsbEthDriver);
+    return Status;
+  }
+
+  return UsbNcmFlushNtb (UsbEthDriver, UsbIo);
+}
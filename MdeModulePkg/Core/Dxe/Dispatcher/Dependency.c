@@ -19,6 +19,11 @@ BOOLEAN  *mDepexEvaluationStack        = NULL;
 BOOLEAN  *mDepexEvaluationStackEnd     = NULL;
 BOOLEAN  *mDepexEvaluationStackPointer = NULL;
 
+//
+// Number of dependency expressions evaluated since boot  // MU_CHANGE
+//
+UINT64  gDepexEvaluationCount = 0;  // MU_CHANGE
+
 //
 // Worker functions
 //
@@ -216,6 +221,8 @@ CoreIsSchedulable (
     return FALSE;
   }
 
+  gDepexEvaluationCount++;  // MU_CHANGE
+
   DEBUG ((DEBUG_DISPATCH, "Evaluate DXE DEPEX for FFS(%g)\n", &DriverEntry->FileName));
 
   if (DriverEntry->Depex == NULL) {
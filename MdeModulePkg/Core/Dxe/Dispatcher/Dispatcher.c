@@ -67,6 +67,47 @@ BOOLEAN  gDispatcherRunning = FALSE;
 EFI_EVENT  mFwVolEvent;
 VOID       *mFwVolEventRegistration;
 
+// MU_CHANGE [BEGIN] - Event driven depex evaluation
+#define DEPEX_WAIT_BUCKET_COUNT  64
+#define DEPEX_GUID_FILTER_BITS   1024
+
+//
+// Queue of drivers whose depex has to be evaluated, in mDiscoveredList order.
+// A driver whose depex is not satisfied waits on the protocols it pushes, and
+// is only placed back on this queue when one of them is installed.
+//
+LIST_ENTRY  mDepexReadyQueue = INITIALIZE_LIST_HEAD_VARIABLE (mDepexReadyQueue);
+
+//
+// DEPEX_WAIT_ENTRY lists, hashed by the GUID they wait on.
+//
+LIST_ENTRY  mDepexWaitBuckets[DEPEX_WAIT_BUCKET_COUNT];
+
+//
+// Bitmap of the hashes of the GUIDs pushed by any depex, so that installing a
+// protocol that no depex refers to does not have to take the dispatcher lock.
+//
+UINT32  mDepexGuidFilter[DEPEX_GUID_FILTER_BITS / 32];
+
+//
+// Incremented every time a protocol pushed by some depex is installed.
+//
+UINT64  mDepexWakeSequence = 0;
+
+//
+// Number of drivers added to mDiscoveredList, and number of times a protocol
+// installation placed a driver back on mDepexReadyQueue.
+//
+UINTN   mDiscoveredCount = 0;
+UINT64  mDepexWakeups    = 0;
+
+//
+// Number of depex evaluations and wake-ups already recorded as performance events.
+//
+UINT64  mDepexEvaluationsRecorded = 0;
+UINT64  mDepexWakeupsRecorded     = 0;
+// MU_CHANGE [END]
+
 //
 // List of file types supported by dispatcher
 //
@@ -220,6 +261,309 @@ CoreReleaseDispatcherLock (
   CoreReleaseLock (&mDispatcherLock);
 }
 
+// MU_CHANGE [BEGIN] - Event driven depex evaluation
+
+/**
+  Hash a GUID for mDepexWaitBuckets and mDepexGuidFilter.
+
+  @param  Guid                  The GUID to hash. It does not have to be aligned.
+
+  @return The hash of the GUID.
+
+**/
+STATIC
+UINT32
+CoreDepexGuidHash (
+  IN  CONST EFI_GUID  *Guid
+  )
+{
+  CONST UINT32  *Words;
+
+  Words = (CONST UINT32 *)Guid;
+  return ReadUnaligned32 (&Words[0]) ^ ReadUnaligned32 (&Words[1]) ^
+         ReadUnaligned32 (&Words[2]) ^ ReadUnaligned32 (&Words[3]);
+}
+
+/**
+  Place a driver on mDepexReadyQueue, so its depex is evaluated on the next
+  pass of the dispatcher. The dispatcher lock must be owned.
+
+  @param  DriverEntry           The driver to place on the queue.
+
+**/
+STATIC
+VOID
+CoreDepexMarkReady (
+  IN  EFI_CORE_DRIVER_ENTRY  *DriverEntry
+  )
+{
+  LIST_ENTRY             *Link;
+  EFI_CORE_DRIVER_ENTRY  *ReadyEntry;
+
+  if (!FeaturePcdGet (PcdDxeEventDrivenDepexEnable) || DriverEntry->DepexReady) {
+    return;
+  }
+
+  //
+  // Keep the queue in mDiscoveredList order, so that the drivers are scheduled
+  // in the same order as by a full walk of mDiscoveredList.
+  //
+  for (Link = mDepexReadyQueue.BackLink; Link != &mDepexReadyQueue; Link = Link->BackLink) {
+    ReadyEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, DepexReadyLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+    if (ReadyEntry->DiscoveredIndex < DriverEntry->DiscoveredIndex) {
+      break;
+    }
+  }
+
+  InsertHeadList (Link, &DriverEntry->DepexReadyLink);
+  DriverEntry->DepexReady = TRUE;
+}
+
+/**
+  Stop a driver from waiting on the protocols pushed by its depex. The
+  dispatcher lock must be owned.
+
+  @param  DriverEntry           The driver that stops waiting.
+
+**/
+STATIC
+VOID
+CoreDepexStopWaiting (
+  IN  EFI_CORE_DRIVER_ENTRY  *DriverEntry
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < DriverEntry->DepexWaitCount; Index++) {
+    if (DriverEntry->DepexWaits[Index].Waiting) {
+      RemoveEntryList (&DriverEntry->DepexWaits[Index].Link);
+      DriverEntry->DepexWaits[Index].Waiting = FALSE;
+    }
+  }
+}
+
+/**
+  Find the next opcode of a depex that pushes a protocol GUID.
+
+  @param  Iterator              The opcode to start the search at.
+  @param  End                   The end of the depex.
+
+  @return The next EFI_DEP_PUSH or EFI_DEP_REPLACE_TRUE opcode, or NULL if the
+          depex ends first.
+
+**/
+STATIC
+UINT8 *
+CoreDepexNextPush (
+  IN  UINT8  *Iterator,
+  IN  UINT8  *End
+  )
+{
+  while (Iterator < End) {
+    switch (*Iterator) {
+      case EFI_DEP_PUSH:
+      case EFI_DEP_REPLACE_TRUE:
+        if ((UINTN)(End - Iterator) <= sizeof (EFI_GUID)) {
+          return NULL;
+        }
+
+        return Iterator;
+
+      case EFI_DEP_BEFORE:
+      case EFI_DEP_AFTER:
+        Iterator += sizeof (EFI_GUID) + 1;
+        break;
+
+      case EFI_DEP_END:
+        return NULL;
+
+      default:
+        Iterator++;
+        break;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Compile the depex of a driver into one DEPEX_WAIT_ENTRY per protocol it
+  pushes, so the driver can wait on those protocols instead of having its
+  depex evaluated on every pass of the dispatcher. If the depex cannot be
+  compiled, the driver keeps being evaluated on every pass.
+
+  The dispatcher lock must not be owned.
+
+  @param  DriverEntry           The driver whose depex is compiled.
+
+**/
+STATIC
+VOID
+CoreCompileDepex (
+  IN  EFI_CORE_DRIVER_ENTRY  *DriverEntry
+  )
+{
+  UINT8             *Opcode;
+  UINT8             *End;
+  UINTN             Count;
+  UINT32            Hash;
+  DEPEX_WAIT_ENTRY  *Waits;
+
+  if (DriverEntry->DepexCompiled || (DriverEntry->Depex == NULL)) {
+    return;
+  }
+
+  End   = (UINT8 *)DriverEntry->Depex + DriverEntry->DepexSize;
+  Count = 0;
+  for (Opcode = CoreDepexNextPush (DriverEntry->Depex, End);
+       Opcode != NULL;
+       Opcode = CoreDepexNextPush (Opcode + sizeof (EFI_GUID) + 1, End))
+  {
+    Count++;
+  }
+
+  Waits = NULL;
+  if (Count != 0) {
+    Waits = AllocatePool (Count * sizeof (DEPEX_WAIT_ENTRY));
+    if (Waits == NULL) {
+      return;
+    }
+  }
+
+  Count = 0;
+  for (Opcode = CoreDepexNextPush (DriverEntry->Depex, End);
+       Opcode != NULL;
+       Opcode = CoreDepexNextPush (Opcode + sizeof (EFI_GUID) + 1, End))
+  {
+    Waits[Count].Signature = DEPEX_WAIT_ENTRY_SIGNATURE;
+    Waits[Count].Driver    = DriverEntry;
+    Waits[Count].Opcode    = Opcode;
+    Waits[Count].Waiting   = FALSE;
+    Count++;
+
+    //
+    // Let CoreDepexProtocolInstalled() know that some depex pushes this GUID
+    //
+    Hash = CoreDepexGuidHash ((EFI_GUID *)(Opcode + 1));
+
+    mDepexGuidFilter[(Hash % DEPEX_GUID_FILTER_BITS) / 32] |= 1U << (Hash % 32);
+  }
+
+  DriverEntry->DepexWaits     = Waits;
+  DriverEntry->DepexWaitCount = Count;
+  DriverEntry->DepexCompiled  = TRUE;
+}
+
+/**
+  Make a driver whose depex evaluated to FALSE wait on the protocols pushed by
+  its depex that are not installed yet.
+
+  The driver waits on every operand that is not installed, whether or not it
+  is under an EFI_DEP_NOT, so a NOT depex is evaluated again when any of its
+  protocols is installed. Uninstalling a protocol does not wake any driver:
+  CoreIsSchedulable() replaces an operand whose protocol it found with
+  EFI_DEP_REPLACE_TRUE, so a depex never sees the protocol go away, and one
+  that could only become TRUE after an uninstall is never scheduled. That is
+  the same as with the walk of every driver on every pass.
+
+  The dispatcher lock must not be owned.
+
+  @param  DriverEntry           The driver whose depex evaluated to FALSE.
+  @param  Sequence              mDepexWakeSequence before the depex was evaluated.
+
+  @retval TRUE                  The driver waits on the protocols, or its depex
+                                can never be satisfied.
+  @retval FALSE                 The depex of the driver is not compiled, and has
+                                to be evaluated again on the next pass.
+
+**/
+STATIC
+BOOLEAN
+CoreDepexStartWaiting (
+  IN  EFI_CORE_DRIVER_ENTRY  *DriverEntry,
+  IN  UINT64                 Sequence
+  )
+{
+  UINTN             Index;
+  UINT32            Hash;
+  DEPEX_WAIT_ENTRY  *Wait;
+
+  if (!DriverEntry->DepexCompiled) {
+    return FALSE;
+  }
+
+  CoreAcquireDispatcherLock ();
+
+  for (Index = 0; Index < DriverEntry->DepexWaitCount; Index++) {
+    Wait = &DriverEntry->DepexWaits[Index];
+    if (*Wait->Opcode == EFI_DEP_PUSH) {
+      Hash = CoreDepexGuidHash ((EFI_GUID *)(Wait->Opcode + 1));
+      InsertTailList (&mDepexWaitBuckets[Hash % DEPEX_WAIT_BUCKET_COUNT], &Wait->Link);
+      Wait->Waiting = TRUE;
+    }
+  }
+
+  if (Sequence != mDepexWakeSequence) {
+    //
+    // A protocol pushed by some depex was installed while this depex was
+    // evaluated, so the result may already be stale. Evaluate it again.
+    //
+    CoreDepexStopWaiting (DriverEntry);
+    CoreDepexMarkReady (DriverEntry);
+  }
+
+  CoreReleaseDispatcherLock ();
+
+  return TRUE;
+}
+
+/**
+  Called by the handle database every time a protocol interface is installed.
+  Places the drivers whose depex waits on the protocol back on the depex ready
+  queue, so the dispatcher evaluates their depex again.
+
+  @param  Protocol              The GUID of the protocol that was installed.
+
+**/
+VOID
+CoreDepexProtocolInstalled (
+  IN  EFI_GUID  *Protocol
+  )
+{
+  UINT32            Hash;
+  LIST_ENTRY        *Bucket;
+  LIST_ENTRY        *Link;
+  LIST_ENTRY        *NextLink;
+  DEPEX_WAIT_ENTRY  *Wait;
+
+  Hash = CoreDepexGuidHash (Protocol);
+  if ((mDepexGuidFilter[(Hash % DEPEX_GUID_FILTER_BITS) / 32] & (1U << (Hash % 32))) == 0) {
+    return;
+  }
+
+  CoreAcquireDispatcherLock ();
+
+  mDepexWakeSequence++;
+
+  Bucket = &mDepexWaitBuckets[Hash % DEPEX_WAIT_BUCKET_COUNT];
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = NextLink) {
+    NextLink = Link->ForwardLink;
+    Wait     = CR (Link, DEPEX_WAIT_ENTRY, Link, DEPEX_WAIT_ENTRY_SIGNATURE);
+    if (CompareGuid (Protocol, (EFI_GUID *)(Wait->Opcode + 1))) {
+      RemoveEntryList (&Wait->Link);
+      Wait->Waiting = FALSE;
+      if (!Wait->Driver->DepexReady) {
+        mDepexWakeups++;
+        CoreDepexMarkReady (Wait->Driver);
+      }
+    }
+  }
+
+  CoreReleaseDispatcherLock ();
+}
+
+// MU_CHANGE [END]
+
 /**
   Read Depex and pre-process the Depex for Before and After. If Section Extraction
   protocol returns an error via ReadSection defer the reading of the Depex.
@@ -322,6 +666,7 @@ CoreSchedule (
       CoreAcquireDispatcherLock ();
       DriverEntry->Unrequested = FALSE;
       DriverEntry->Dependent   = TRUE;
+      CoreDepexMarkReady (DriverEntry);  // MU_CHANGE
       CoreReleaseDispatcherLock ();
 
       DEBUG ((DEBUG_DISPATCH, "Schedule FFS(%g) - EFI_SUCCESS\n", DriverName));
@@ -382,6 +727,137 @@ CoreTrust (
   return EFI_NOT_FOUND;
 }
 
+// MU_CHANGE [BEGIN] - Event driven depex evaluation
+
+/**
+  Evaluate the depex of the drivers on mDepexReadyQueue, and place the drivers
+  whose depex is satisfied on the mScheduledQueue. This replaces the walk of
+  every driver in mDiscoveredList on every pass of the dispatcher.
+
+  @retval TRUE                  At least one driver was placed on the mScheduledQueue.
+  @retval FALSE                 No driver was placed on the mScheduledQueue.
+
+**/
+STATIC
+BOOLEAN
+CoreDispatchReadyDepex (
+  VOID
+  )
+{
+  LIST_ENTRY             RetryQueue;
+  EFI_CORE_DRIVER_ENTRY  *DriverEntry;
+  UINT64                 Sequence;
+  BOOLEAN                Retry;
+  BOOLEAN                ReadyToRun;
+
+  ReadyToRun = FALSE;
+  InitializeListHead (&RetryQueue);
+
+  CoreAcquireDispatcherLock ();
+
+  while (!IsListEmpty (&mDepexReadyQueue)) {
+    DriverEntry = CR (
+                    mDepexReadyQueue.ForwardLink,
+                    EFI_CORE_DRIVER_ENTRY,
+                    DepexReadyLink,
+                    EFI_CORE_DRIVER_ENTRY_SIGNATURE
+                    );
+    RemoveEntryList (&DriverEntry->DepexReadyLink);
+    DriverEntry->DepexReady = FALSE;
+    CoreDepexStopWaiting (DriverEntry);
+    Sequence = mDepexWakeSequence;
+
+    CoreReleaseDispatcherLock ();
+
+    if (DriverEntry->DepexProtocolError) {
+      //
+      // If Section Extraction Protocol did not let the Depex be read before retry the read
+      //
+      CoreGetDepexSectionAndPreProccess (DriverEntry);
+    }
+
+    Retry = DriverEntry->DepexProtocolError;
+    if (DriverEntry->Dependent) {
+      CoreCompileDepex (DriverEntry);
+      if (CoreIsSchedulable (DriverEntry)) {
+        CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (DriverEntry);
+        ReadyToRun = TRUE;
+      } else if (!DriverEntry->Before && !DriverEntry->After) {
+        //
+        // Before and After drivers are scheduled along with the driver they
+        // refer to, so only the other drivers wait on their depex.
+        //
+        Retry = !CoreDepexStartWaiting (DriverEntry, Sequence);
+      }
+    }
+
+    CoreAcquireDispatcherLock ();
+
+    if (Retry && !DriverEntry->DepexReady) {
+      InsertTailList (&RetryQueue, &DriverEntry->DepexReadyLink);
+      DriverEntry->DepexReady = TRUE;
+    }
+  }
+
+  //
+  // The drivers that cannot wait on a protocol are evaluated again on the next pass.
+  //
+  while (!IsListEmpty (&RetryQueue)) {
+    DriverEntry = CR (RetryQueue.ForwardLink, EFI_CORE_DRIVER_ENTRY, DepexReadyLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+    RemoveEntryList (&DriverEntry->DepexReadyLink);
+    DriverEntry->DepexReady = FALSE;
+    CoreDepexMarkReady (DriverEntry);
+  }
+
+  CoreReleaseDispatcherLock ();
+
+  return ReadyToRun;
+}
+
+/**
+  Report the depex evaluations and protocol wake-ups of the dispatcher.
+
+  Each evaluation and wake-up since the last report is recorded as a
+  "DepexEvaluation" or "DepexWakeup" performance event, so that the number of
+  records of each name gives the counts. The records are not created where the
+  counters are updated because wake-ups happen with the protocol database
+  lock held, which the performance library needs to identify the caller. The
+  time the evaluations take is measured by the "DepexEval" records of each
+  dispatcher pass, and the totals are also printed to the debug log.
+
+**/
+STATIC
+VOID
+CoreReportDepexStatistics (
+  VOID
+  )
+{
+  UINT64  Wakeups;
+
+  CoreAcquireDispatcherLock ();
+  Wakeups = mDepexWakeups;
+  CoreReleaseDispatcherLock ();
+
+  if (LogPerformanceMeasurementEnabled (PERF_GENERAL_TYPE)) {
+    for ( ; mDepexEvaluationsRecorded < gDepexEvaluationCount; mDepexEvaluationsRecorded++) {
+      PERF_EVENT ("DepexEvaluation");
+    }
+
+    for ( ; mDepexWakeupsRecorded < Wakeups; mDepexWakeupsRecorded++) {
+      PERF_EVENT ("DepexWakeup");
+    }
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "DXE dispatcher: %Lu depex evaluations, %Lu protocol wake-ups\n",
+    gDepexEvaluationCount,
+    Wakeups
+    ));
+}
+
+// MU_CHANGE [END]
+
 /**
   This is the main Dispatcher for DXE and it exits when there are no more
   drivers to run. Drain the mScheduledQueue and load and start a PE
@@ -544,6 +1020,18 @@ CoreDispatcher (
     // Search DriverList for items to place on Scheduled Queue
     //
     ReadyToRun = FALSE;
+    // MU_CHANGE [BEGIN] - Event driven depex evaluation
+    PERF_INMODULE_BEGIN ("DepexEval");
+    if (FeaturePcdGet (PcdDxeEventDrivenDepexEnable)) {
+      //
+      // Only evaluate the drivers on the depex ready queue
+      //
+      ReadyToRun = CoreDispatchReadyDepex ();
+      PERF_INMODULE_END ("DepexEval");
+      continue;
+    }
+
+    // MU_CHANGE [END]
     for (Link = mDiscoveredList.ForwardLink; Link != &mDiscoveredList; Link = Link->ForwardLink) {
       DriverEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, Link, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
 
@@ -567,6 +1055,8 @@ CoreDispatcher (
         }
       }
     }
+
+    PERF_INMODULE_END ("DepexEval");  // MU_CHANGE
   } while (ReadyToRun);
 
   //
@@ -576,6 +1066,8 @@ CoreDispatcher (
 
   gDispatcherRunning = FALSE;
 
+  CoreReportDepexStatistics ();  // MU_CHANGE
+
   PERF_FUNCTION_END ();
 
   return ReturnStatus;
@@ -899,6 +1391,8 @@ CoreAddToDriverList (
   CoreAcquireDispatcherLock ();
 
   InsertTailList (&mDiscoveredList, &DriverEntry->Link);
+  DriverEntry->DiscoveredIndex = mDiscoveredCount++;  // MU_CHANGE
+  CoreDepexMarkReady (DriverEntry);                   // MU_CHANGE
 
   CoreReleaseDispatcherLock ();
 
@@ -1465,8 +1959,17 @@ CoreInitializeDispatcher (
   VOID
   )
 {
+  UINTN  Index;  // MU_CHANGE
+
   PERF_FUNCTION_BEGIN ();
 
+  // MU_CHANGE [BEGIN] - Event driven depex evaluation
+  for (Index = 0; Index < DEPEX_WAIT_BUCKET_COUNT; Index++) {
+    InitializeListHead (&mDepexWaitBuckets[Index]);
+  }
+
+  // MU_CHANGE [END]
+
   mFwVolEvent = EfiCreateProtocolNotifyEvent (
                   &gEfiFirmwareVolume2ProtocolGuid,
                   TPL_CALLBACK,
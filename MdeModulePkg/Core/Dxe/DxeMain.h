@@ -136,6 +136,10 @@ typedef struct {
   EFI_GUID      FvNameGuid;
 } KNOWN_HANDLE;
 
+// MU_CHANGE [BEGIN] - Event driven depex evaluation
+typedef struct _DEPEX_WAIT_ENTRY DEPEX_WAIT_ENTRY;
+// MU_CHANGE [END]
+
 #define EFI_CORE_DRIVER_ENTRY_SIGNATURE  SIGNATURE_32('d','r','v','r')
 typedef struct {
   UINTN                            Signature;
@@ -164,8 +168,35 @@ typedef struct {
 
   EFI_HANDLE                       ImageHandle;
   BOOLEAN                          IsFvImage;
+
+  // MU_CHANGE [BEGIN] - Event driven depex evaluation
+  LIST_ENTRY                       DepexReadyLink;  // mDepexReadyQueue
+  UINTN                            DiscoveredIndex;
+  BOOLEAN                          DepexReady;
+  BOOLEAN                          DepexCompiled;
+  UINTN                            DepexWaitCount;
+  DEPEX_WAIT_ENTRY                 *DepexWaits;
+  // MU_CHANGE [END]
 } EFI_CORE_DRIVER_ENTRY;
 
+// MU_CHANGE [BEGIN] - Event driven depex evaluation
+#define DEPEX_WAIT_ENTRY_SIGNATURE  SIGNATURE_32('d','w','a','t')
+
+///
+/// One EFI_DEP_PUSH operand of a driver's depex. While the protocol it pushes
+/// is not installed, the entry is linked on the depex wait bucket of the
+/// protocol GUID, and installing the protocol puts the driver back on the
+/// depex ready queue.
+///
+struct _DEPEX_WAIT_ENTRY {
+  UINTN                    Signature;
+  LIST_ENTRY               Link;        // mDepexWaitBuckets
+  EFI_CORE_DRIVER_ENTRY    *Driver;
+  UINT8                    *Opcode;     // EFI_DEP_PUSH opcode, followed by the GUID
+  BOOLEAN                  Waiting;
+};
+// MU_CHANGE [END]
+
 //
 // The data structure of GCD memory map entry
 //
@@ -472,6 +503,28 @@ CoreIsSchedulable (
   IN  EFI_CORE_DRIVER_ENTRY  *DriverEntry
   );
 
+// MU_CHANGE [BEGIN] - Event driven depex evaluation
+
+///
+/// Number of dependency expressions evaluated since boot.
+///
+extern UINT64  gDepexEvaluationCount;
+
+/**
+  Called by the handle database every time a protocol interface is installed.
+  Places the drivers whose depex waits on the protocol back on the depex ready
+  queue, so the dispatcher evaluates their depex again.
+
+  @param  Protocol              The GUID of the protocol that was installed.
+
+**/
+VOID
+CoreDepexProtocolInstalled (
+  IN  EFI_GUID  *Protocol
+  );
+
+// MU_CHANGE [END]
+
 /**
   Preprocess dependency expression and update DriverEntry to reflect the
   state of  Before, After, and SOR dependencies. If DriverEntry->Before
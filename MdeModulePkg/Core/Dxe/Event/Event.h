@@ -10,6 +10,8 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #ifndef __EVENT_H__
 #define __EVENT_H__
 
+#include "TimerQueue.h"  // MU_CHANGE
+
 #define VALID_TPL(a)  ((a) <= TPL_HIGH_LEVEL)
 extern  volatile UINTN  gEventPending;             // MU_CHANGE
 
@@ -30,9 +32,13 @@ extern  volatile UINTN  gEventPending;             // MU_CHANGE
 /// Timer event information
 ///
 typedef struct {
-  LIST_ENTRY    Link;
-  UINT64        TriggerTime;
-  UINT64        Period;
+  // MU_CHANGE [BEGIN] - Queue timer events in a heap instead of a sorted list
+  ///
+  /// Timer queue linkage. Also holds the trigger time.
+  ///
+  TIMER_QUEUE_NODE    Node;
+  // MU_CHANGE [END]
+  UINT64              Period;
 } TIMER_EVENT_INFO;
 
 #define EVENT_SIGNATURE  SIGNATURE_32('e','v','n','t')
@@ -13,9 +13,9 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 // Internal data
 //
 
-LIST_ENTRY  mEfiTimerList       = INITIALIZE_LIST_HEAD_VARIABLE (mEfiTimerList);
-EFI_LOCK    mEfiTimerLock       = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL - 1);
-EFI_EVENT   mEfiCheckTimerEvent = NULL;
+TIMER_QUEUE  mEfiTimerQueue      = TIMER_QUEUE_INIT;  // MU_CHANGE
+EFI_LOCK     mEfiTimerLock       = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL - 1);
+EFI_EVENT    mEfiCheckTimerEvent = NULL;
 
 EFI_LOCK  mEfiSystemTimeLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL);
 UINT64    mEfiSystemTime     = 0;
@@ -36,29 +36,15 @@ CoreInsertEventTimer (
   IN IEVENT  *Event
   )
 {
-  UINT64      TriggerTime;
-  LIST_ENTRY  *Link;
-  IEVENT      *Event2;
-
   ASSERT_LOCKED (&mEfiTimerLock);
 
+  // MU_CHANGE [BEGIN] - Queue timer events in a heap instead of a sorted list
   //
-  // Get the timer's trigger time
-  //
-  TriggerTime = Event->Timer.TriggerTime;
-
-  //
-  // Insert the timer into the timer database in assending sorted order
+  // Insert the timer into the timer database. Timers with the same trigger
+  // time keep the order in which they were inserted.
   //
-  for (Link = mEfiTimerList.ForwardLink; Link != &mEfiTimerList; Link = Link->ForwardLink) {
-    Event2 = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
-
-    if (Event2->Timer.TriggerTime > TriggerTime) {
-      break;
-    }
-  }
-
-  InsertTailList (Link, &Event->Timer.Link);
+  TimerQueueInsert (&mEfiTimerQueue, &Event->Timer.Node);
+  // MU_CHANGE [END]
 }
 
 /**
@@ -82,7 +68,7 @@ CoreCurrentSystemTime (
 }
 
 /**
-  Checks the sorted timer list against the current system time.
+  Checks the timer queue against the current system time.
   Signals any expired event timer.
 
   @param  CheckEvent             Not used
@@ -96,8 +82,9 @@ CoreCheckTimers (
   IN VOID       *Context
   )
 {
-  UINT64  SystemTime;
-  IEVENT  *Event;
+  UINT64            SystemTime;
+  IEVENT            *Event;
+  TIMER_QUEUE_NODE  *Node;  // MU_CHANGE
 
   //
   // Check the timer database for expired timers
@@ -105,22 +92,22 @@ CoreCheckTimers (
   CoreAcquireLock (&mEfiTimerLock);
   SystemTime = CoreCurrentSystemTime ();
 
-  while (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  // MU_CHANGE [BEGIN] - Queue timer events in a heap instead of a sorted list
+  while ((Node = TimerQueueFirst (&mEfiTimerQueue)) != NULL) {
+    Event = CR (Node, IEVENT, Timer.Node, EVENT_SIGNATURE);
 
     //
     // If this timer is not expired, then we're done
     //
-    if (Event->Timer.TriggerTime > SystemTime) {
+    if (Event->Timer.Node.TriggerTime > SystemTime) {
       break;
     }
 
     //
     // Remove this timer from the timer queue
     //
-
-    RemoveEntryList (&Event->Timer.Link);
-    Event->Timer.Link.ForwardLink = NULL;
+    TimerQueueRemove (&mEfiTimerQueue, &Event->Timer.Node);
+    // MU_CHANGE [END]
 
     //
     // Signal it
@@ -134,13 +121,13 @@ CoreCheckTimers (
       //
       // Compute the timers new trigger time
       //
-      Event->Timer.TriggerTime = Event->Timer.TriggerTime + Event->Timer.Period;
+      Event->Timer.Node.TriggerTime = Event->Timer.Node.TriggerTime + Event->Timer.Period; // MU_CHANGE
 
       //
       // If that's before now, then reset the timer to start from now
       //
-      if (Event->Timer.TriggerTime <= SystemTime) {
-        Event->Timer.TriggerTime = SystemTime;
+      if (Event->Timer.Node.TriggerTime <= SystemTime) {  // MU_CHANGE
+        Event->Timer.Node.TriggerTime = SystemTime; // MU_CHANGE
         CoreSignalEvent (mEfiCheckTimerEvent);
       }
 
@@ -189,7 +176,7 @@ CoreTimerTick (
   IN UINT64  Duration
   )
 {
-  IEVENT  *Event;
+  TIMER_QUEUE_NODE  *Node;  // MU_CHANGE
 
   //
   // Check runtiem flag in case there are ticks while exiting boot services
@@ -205,14 +192,16 @@ CoreTimerTick (
   // If the head of the list is expired, fire the timer event
   // to process it
   //
-  if (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
-
-    if (Event->Timer.TriggerTime <= mEfiSystemTime) {
+  // MU_CHANGE [BEGIN] - Queue timer events in a heap instead of a sorted list
+  Node = TimerQueueFirst (&mEfiTimerQueue);
+  if (Node != NULL) {
+    if (Node->TriggerTime <= mEfiSystemTime) {
       CoreSignalEvent (mEfiCheckTimerEvent);
     }
   }
 
+  // MU_CHANGE [END]
+
   CoreReleaseLock (&mEfiSystemTimeLock);
 }
 
@@ -260,13 +249,14 @@ CoreSetTimer (
   //
   // If the timer is queued to the timer database, remove it
   //
-  if (Event->Timer.Link.ForwardLink != NULL) {
-    RemoveEntryList (&Event->Timer.Link);
-    Event->Timer.Link.ForwardLink = NULL;
+  // MU_CHANGE [BEGIN] - Queue timer events in a heap instead of a sorted list
+  if (TimerQueueIsQueued (&mEfiTimerQueue, &Event->Timer.Node)) {
+    TimerQueueRemove (&mEfiTimerQueue, &Event->Timer.Node);
   }
 
-  Event->Timer.TriggerTime = 0;
-  Event->Timer.Period      = 0;
+  Event->Timer.Node.TriggerTime = 0;
+  Event->Timer.Period           = 0;
+  // MU_CHANGE [END]
 
   if (Type != TimerCancel) {
     if (Type == TimerPeriodic) {
@@ -277,7 +267,7 @@ CoreSetTimer (
       Event->Timer.Period = TriggerTime;
     }
 
-    Event->Timer.TriggerTime = CoreCurrentSystemTime () + TriggerTime;
+    Event->Timer.Node.TriggerTime = CoreCurrentSystemTime () + TriggerTime; // MU_CHANGE
     CoreInsertEventTimer (Event);
 
     if (TriggerTime == 0) {
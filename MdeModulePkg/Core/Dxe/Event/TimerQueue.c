@@ -0,0 +1,250 @@
+/** @file
+  Priority queue of pending DXE core timer events.
+
+  Drivers such as the network stack, USB and the consoles keep hundreds of
+  periodic timers alive, and a sorted list makes every re-armed timer walk the
+  whole list. This pairing heap queues a timer in constant time and expires the
+  earliest one in amortized logarithmic time.
+
+  This file only depends on base types so that it can be built into host
+  based unit tests.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+
+#include "TimerQueue.h"
+
+/**
+  Compare the expiry order of two nodes.
+
+  @param  Node1                  The first node.
+  @param  Node2                  The second node.
+
+  @retval TRUE                   Node1 expires before Node2.
+  @retval FALSE                  Node2 expires before Node1.
+
+**/
+STATIC
+BOOLEAN
+TimerQueueBefore (
+  IN TIMER_QUEUE_NODE  *Node1,
+  IN TIMER_QUEUE_NODE  *Node2
+  )
+{
+  if (Node1->TriggerTime != Node2->TriggerTime) {
+    return (BOOLEAN)(Node1->TriggerTime < Node2->TriggerTime);
+  }
+
+  return (BOOLEAN)(Node1->Sequence < Node2->Sequence);
+}
+
+/**
+  Meld two heaps into one.
+
+  @param  Heap1                  The root of the first heap. Must not be NULL.
+  @param  Heap2                  The root of the second heap. Must not be NULL.
+
+  @return The root of the melded heap.
+
+**/
+STATIC
+TIMER_QUEUE_NODE *
+TimerQueueMeld (
+  IN TIMER_QUEUE_NODE  *Heap1,
+  IN TIMER_QUEUE_NODE  *Heap2
+  )
+{
+  TIMER_QUEUE_NODE  *Parent;
+  TIMER_QUEUE_NODE  *Child;
+
+  if (TimerQueueBefore (Heap2, Heap1)) {
+    Parent = Heap2;
+    Child  = Heap1;
+  } else {
+    Parent = Heap1;
+    Child  = Heap2;
+  }
+
+  Child->Sibling = Parent->Child;
+  if (Parent->Child != NULL) {
+    Parent->Child->Prev = Child;
+  }
+
+  Child->Prev     = Parent;
+  Parent->Child   = Child;
+  Parent->Prev    = NULL;
+  Parent->Sibling = NULL;
+  return Parent;
+}
+
+/**
+  Combine a list of sibling subheaps into a single heap using the standard
+  two pass pairing.
+
+  @param  First                  The first subheap of the sibling list, or NULL.
+
+  @return The root of the combined heap, or NULL if the list was empty.
+
+**/
+STATIC
+TIMER_QUEUE_NODE *
+TimerQueueMergePairs (
+  IN TIMER_QUEUE_NODE  *First
+  )
+{
+  TIMER_QUEUE_NODE  *Pairs;
+  TIMER_QUEUE_NODE  *Node1;
+  TIMER_QUEUE_NODE  *Node2;
+  TIMER_QUEUE_NODE  *Next;
+  TIMER_QUEUE_NODE  *Result;
+
+  //
+  // First pass, left to right: meld the subheaps in pairs, collecting the
+  // results in reverse order.
+  //
+  Pairs = NULL;
+  while (First != NULL) {
+    Node1          = First;
+    Node2          = Node1->Sibling;
+    Node1->Prev    = NULL;
+    Node1->Sibling = NULL;
+    if (Node2 == NULL) {
+      Next = NULL;
+    } else {
+      Next           = Node2->Sibling;
+      Node2->Prev    = NULL;
+      Node2->Sibling = NULL;
+      Node1          = TimerQueueMeld (Node1, Node2);
+    }
+
+    Node1->Sibling = Pairs;
+    Pairs          = Node1;
+    First          = Next;
+  }
+
+  //
+  // Second pass, right to left: meld each pair into the accumulated result.
+  //
+  Result = NULL;
+  while (Pairs != NULL) {
+    Next           = Pairs->Sibling;
+    Pairs->Sibling = NULL;
+    Result         = (Result == NULL) ? Pairs : TimerQueueMeld (Result, Pairs);
+    Pairs          = Next;
+  }
+
+  return Result;
+}
+
+/**
+  Insert a node into the timer queue.
+
+  The caller must set Node->TriggerTime, and the node must not be queued.
+
+  @param  Queue                  The timer queue.
+  @param  Node                   The node to insert.
+
+**/
+VOID
+TimerQueueInsert (
+  IN OUT TIMER_QUEUE       *Queue,
+  IN OUT TIMER_QUEUE_NODE  *Node
+  )
+{
+  ASSERT (!TimerQueueIsQueued (Queue, Node));
+
+  Node->Prev     = NULL;
+  Node->Child    = NULL;
+  Node->Sibling  = NULL;
+  Node->Sequence = Queue->NextSequence++;
+
+  Queue->Root = (Queue->Root == NULL) ? Node : TimerQueueMeld (Queue->Root, Node);
+  Queue->Count++;
+}
+
+/**
+  Remove a queued node from the timer queue.
+
+  @param  Queue                  The timer queue.
+  @param  Node                   The node to remove.
+
+**/
+VOID
+TimerQueueRemove (
+  IN OUT TIMER_QUEUE       *Queue,
+  IN OUT TIMER_QUEUE_NODE  *Node
+  )
+{
+  TIMER_QUEUE_NODE  *Subheap;
+
+  ASSERT (TimerQueueIsQueued (Queue, Node));
+
+  Subheap = TimerQueueMergePairs (Node->Child);
+
+  if (Node == Queue->Root) {
+    Queue->Root = Subheap;
+  } else {
+    //
+    // Unlink the node from its parent's child list, then put its children
+    // back into the queue.
+    //
+    if (Node->Prev->Child == Node) {
+      Node->Prev->Child = Node->Sibling;
+    } else {
+      Node->Prev->Sibling = Node->Sibling;
+    }
+
+    if (Node->Sibling != NULL) {
+      Node->Sibling->Prev = Node->Prev;
+    }
+
+    if (Subheap != NULL) {
+      Queue->Root = TimerQueueMeld (Queue->Root, Subheap);
+    }
+  }
+
+  Node->Prev    = NULL;
+  Node->Child   = NULL;
+  Node->Sibling = NULL;
+  Queue->Count--;
+}
+
+/**
+  Get the node with the earliest trigger time.
+
+  @param  Queue                  The timer queue.
+
+  @return The first node to expire, or NULL if the queue is empty.
+
+**/
+TIMER_QUEUE_NODE *
+TimerQueueFirst (
+  IN TIMER_QUEUE  *Queue
+  )
+{
+  return Queue->Root;
+}
+
+/**
+  Check whether a node is currently in the timer queue.
+
+  @param  Queue                  The timer queue.
+  @param  Node                   The node to check.
+
+  @retval TRUE                   The node is queued.
+  @retval FALSE                  The node is not queued.
+
+**/
+BOOLEAN
+TimerQueueIsQueued (
+  IN TIMER_QUEUE       *Queue,
+  IN TIMER_QUEUE_NODE  *Node
+  )
+{
+  return (BOOLEAN)(Node->Prev != NULL || Node == Queue->Root);
+}
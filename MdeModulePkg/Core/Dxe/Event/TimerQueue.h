@@ -0,0 +1,102 @@
+/** @file
+  Priority queue of pending DXE core timer events.
+
+  The queue is a pairing heap ordered by trigger time. Its linkage is embedded
+  in the timer events themselves, so queueing or cancelling a timer never has
+  to allocate memory while the timer lock is held. Timers that share the same
+  trigger time are kept in the order they were queued.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef TIMER_QUEUE_H_
+#define TIMER_QUEUE_H_
+
+typedef struct _TIMER_QUEUE_NODE TIMER_QUEUE_NODE;
+
+///
+/// Queue linkage embedded in every timer event.
+///
+struct _TIMER_QUEUE_NODE {
+  ///
+  /// Parent if this is the first child, otherwise the previous sibling.
+  /// NULL for the root and for nodes that are not queued.
+  ///
+  TIMER_QUEUE_NODE    *Prev;
+  TIMER_QUEUE_NODE    *Child;
+  TIMER_QUEUE_NODE    *Sibling;
+  UINT64              TriggerTime;
+  UINT64              Sequence;
+};
+
+///
+/// Root of the timer queue.
+///
+typedef struct {
+  TIMER_QUEUE_NODE    *Root;
+  UINTN               Count;
+  UINT64              NextSequence;
+} TIMER_QUEUE;
+
+#define TIMER_QUEUE_INIT  { NULL, 0, 0 }
+
+/**
+  Insert a node into the timer queue.
+
+  The caller must set Node->TriggerTime, and the node must not be queued.
+
+  @param  Queue                  The timer queue.
+  @param  Node                   The node to insert.
+
+**/
+VOID
+TimerQueueInsert (
+  IN OUT TIMER_QUEUE       *Queue,
+  IN OUT TIMER_QUEUE_NODE  *Node
+  );
+
+/**
+  Remove a queued node from the timer queue.
+
+  @param  Queue                  The timer queue.
+  @param  Node                   The node to remove.
+
+**/
+VOID
+TimerQueueRemove (
+  IN OUT TIMER_QUEUE       *Queue,
+  IN OUT TIMER_QUEUE_NODE  *Node
+  );
+
+/**
+  Get the node with the earliest trigger time.
+
+  @param  Queue                  The timer queue.
+
+  @return The first node to expire, or NULL if the queue is empty.
+
+**/
+TIMER_QUEUE_NODE *
+TimerQueueFirst (
+  IN TIMER_QUEUE  *Queue
+  );
+
+/**
+  Check whether a node is currently in the timer queue.
+
+  @param  Queue                  The timer queue.
+  @param  Node                   The node to check.
+
+  @retval TRUE                   The node is queued.
+  @retval FALSE                  The node is not queued.
+
+**/
+BOOLEAN
+TimerQueueIsQueued (
+  IN TIMER_QUEUE       *Queue,
+  IN TIMER_QUEUE_NODE  *Node
+  );
+
+#endif
@@ -0,0 +1,392 @@
+/** @file
+  Host based unit tests for the DXE core timer queue.
+
+  The tests drive thousands of periodic and relative timers through the timer
+  queue and through a sorted list that mirrors what the DXE core did before
+  the queue existed, check that both expire the same timers in the same order,
+  and report the insertion and tick cost of each.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/GoogleTestLib.h>
+
+#include <chrono>
+#include <set>
+#include <utility>
+#include <vector>
+
+extern "C" {
+  #include <Uefi.h>
+  #include <Library/BaseLib.h>
+  #include <Library/DebugLib.h>
+  #include "../TimerQueue.h"
+}
+
+using namespace testing;
+
+#define TEST_TIMER_COUNT  4000
+#define TEST_TICK_COUNT   1000
+#define TEST_TICK_PERIOD  100000            // 10ms in 100ns units
+#define TEST_OPERATIONS   50000
+
+///
+/// A test timer, queued both in the timer queue and in the reference list.
+///
+typedef struct {
+  TIMER_QUEUE_NODE    Node;
+  LIST_ENTRY          Link;
+  UINT64              ListTriggerTime;
+  UINT64              Period;
+  UINTN               Id;
+} TEST_TIMER;
+
+#define NODE_TO_TIMER(Ptr)  BASE_CR (Ptr, TEST_TIMER, Node)
+#define LINK_TO_TIMER(Ptr)  BASE_CR (Ptr, TEST_TIMER, Link)
+
+/**
+  Insert a timer into the sorted list, the way CoreInsertEventTimer() did.
+**/
+STATIC
+VOID
+ListInsert (
+  IN LIST_ENTRY  *List,
+  IN TEST_TIMER  *Timer
+  )
+{
+  LIST_ENTRY  *Link;
+
+  for (Link = List->ForwardLink; Link != List; Link = Link->ForwardLink) {
+    if (LINK_TO_TIMER (Link)->ListTriggerTime > Timer->ListTriggerTime) {
+      break;
+    }
+  }
+
+  InsertTailList (Link, &Timer->Link);
+}
+
+/**
+  Expire the sorted list, the way CoreCheckTimers() did.
+**/
+STATIC
+VOID
+ListTick (
+  IN     LIST_ENTRY          *List,
+  IN     UINT64              SystemTime,
+  IN OUT std::vector<UINTN>  &Fired
+  )
+{
+  TEST_TIMER  *Timer;
+
+  while (!IsListEmpty (List)) {
+    Timer = LINK_TO_TIMER (List->ForwardLink);
+    if (Timer->ListTriggerTime > SystemTime) {
+      break;
+    }
+
+    RemoveEntryList (&Timer->Link);
+    Fired.push_back (Timer->Id);
+    if (Timer->Period != 0) {
+      Timer->ListTriggerTime += Timer->Period;
+      if (Timer->ListTriggerTime <= SystemTime) {
+        Timer->ListTriggerTime = SystemTime;
+      }
+
+      ListInsert (List, Timer);
+    }
+  }
+}
+
+/**
+  Expire the timer queue, the way CoreCheckTimers() does.
+**/
+STATIC
+VOID
+QueueTick (
+  IN     TIMER_QUEUE         *Queue,
+  IN     UINT64              SystemTime,
+  IN OUT std::vector<UINTN>  &Fired
+  )
+{
+  TIMER_QUEUE_NODE  *Node;
+  TEST_TIMER        *Timer;
+
+  while ((Node = TimerQueueFirst (Queue)) != NULL) {
+    if (Node->TriggerTime > SystemTime) {
+      break;
+    }
+
+    Timer = NODE_TO_TIMER (Node);
+    TimerQueueRemove (Queue, Node);
+    Fired.push_back (Timer->Id);
+    if (Timer->Period != 0) {
+      Node->TriggerTime += Timer->Period;
+      if (Node->TriggerTime <= SystemTime) {
+        Node->TriggerTime = SystemTime;
+      }
+
+      TimerQueueInsert (Queue, Node);
+    }
+  }
+}
+
+class TimerQueueTest : public Test {
+protected:
+  TIMER_QUEUE              Queue;
+  LIST_ENTRY               List;
+  std::vector<TEST_TIMER>  Timers;
+  UINT32                   Seed;
+
+  void
+  SetUp (
+    ) override
+  {
+    TIMER_QUEUE  Empty = TIMER_QUEUE_INIT;
+
+    Queue = Empty;
+    InitializeListHead (&List);
+    Timers.assign (TEST_TIMER_COUNT, TEST_TIMER ());
+    for (UINTN Index = 0; Index < Timers.size (); Index++) {
+      Timers[Index].Id = Index;
+    }
+
+    Seed = 0x2545F491;
+  }
+
+  UINT32
+  Random (
+    )
+  {
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 17;
+    Seed ^= Seed << 5;
+    return Seed;
+  }
+
+  //
+  // Walk the heap and check that every child expires no earlier than its
+  // parent and that the back links are consistent. Returns the node count.
+  //
+  UINTN
+  CheckHeap (
+    TIMER_QUEUE_NODE  *Node
+    )
+  {
+    TIMER_QUEUE_NODE  *Child;
+    TIMER_QUEUE_NODE  *Prev;
+    UINTN             Count;
+
+    Count = 1;
+    Prev  = Node;
+    for (Child = Node->Child; Child != NULL; Child = Child->Sibling) {
+      EXPECT_EQ (Child->Prev, Prev);
+      EXPECT_TRUE (
+        (Child->TriggerTime > Node->TriggerTime) ||
+        ((Child->TriggerTime == Node->TriggerTime) && (Child->Sequence > Node->Sequence))
+        );
+      Count += CheckHeap (Child);
+      Prev   = Child;
+    }
+
+    return Count;
+  }
+
+  void
+  CheckQueue (
+    )
+  {
+    if (Queue.Root == NULL) {
+      EXPECT_EQ (Queue.Count, 0u);
+      return;
+    }
+
+    EXPECT_EQ (Queue.Root->Prev, (TIMER_QUEUE_NODE *)NULL);
+    EXPECT_EQ (Queue.Root->Sibling, (TIMER_QUEUE_NODE *)NULL);
+    EXPECT_EQ (CheckHeap (Queue.Root), Queue.Count);
+  }
+};
+
+// Timers expire in trigger time order, and equal trigger times expire in insertion order.
+TEST_F (TimerQueueTest, ExpiresInOrder) {
+  std::vector<std::pair<UINT64, UINTN> >  Expected;
+
+  for (UINTN Index = 0; Index < Timers.size (); Index++) {
+    Timers[Index].Node.TriggerTime = Random () % 64;
+    TimerQueueInsert (&Queue, &Timers[Index].Node);
+    Expected.push_back (std::make_pair (Timers[Index].Node.TriggerTime, Index));
+  }
+
+  CheckQueue ();
+  std::stable_sort (
+    Expected.begin (),
+    Expected.end (),
+    [](const std::pair<UINT64, UINTN> &A, const std::pair<UINT64, UINTN> &B) {
+    return A.first < B.first;
+  }
+    );
+
+  for (auto &Entry : Expected) {
+    TIMER_QUEUE_NODE  *Node = TimerQueueFirst (&Queue);
+
+    ASSERT_NE (Node, (TIMER_QUEUE_NODE *)NULL);
+    EXPECT_EQ (NODE_TO_TIMER (Node)->Id, Entry.second);
+    TimerQueueRemove (&Queue, Node);
+    EXPECT_FALSE (TimerQueueIsQueued (&Queue, Node));
+  }
+
+  EXPECT_EQ (TimerQueueFirst (&Queue), (TIMER_QUEUE_NODE *)NULL);
+  EXPECT_EQ (Queue.Count, 0u);
+}
+
+// Random inserts and cancels keep the queue consistent with a reference ordered set.
+TEST_F (TimerQueueTest, RandomInsertAndCancel) {
+  std::set<std::pair<UINT64, UINT64> >  Reference;
+
+  for (UINTN Step = 0; Step < TEST_OPERATIONS; Step++) {
+    TEST_TIMER  *Timer = &Timers[Random () % Timers.size ()];
+
+    if (TimerQueueIsQueued (&Queue, &Timer->Node)) {
+      EXPECT_EQ (Reference.erase (std::make_pair (Timer->Node.TriggerTime, Timer->Node.Sequence)), 1u);
+      TimerQueueRemove (&Queue, &Timer->Node);
+    } else {
+      Timer->Node.TriggerTime = Random () % 1000;
+      TimerQueueInsert (&Queue, &Timer->Node);
+      Reference.insert (std::make_pair (Timer->Node.TriggerTime, Timer->Node.Sequence));
+    }
+
+    ASSERT_EQ (Queue.Count, Reference.size ());
+    if (!Reference.empty ()) {
+      EXPECT_EQ (TimerQueueFirst (&Queue)->TriggerTime, Reference.begin ()->first);
+      EXPECT_EQ (TimerQueueFirst (&Queue)->Sequence, Reference.begin ()->second);
+    }
+
+    if (Step % 5000 == 0) {
+      CheckQueue ();
+    }
+  }
+
+  CheckQueue ();
+}
+
+// Only the root and linked nodes report as queued.
+TEST_F (TimerQueueTest, IsQueued) {
+  EXPECT_FALSE (TimerQueueIsQueued (&Queue, &Timers[0].Node));
+  TimerQueueInsert (&Queue, &Timers[0].Node);
+  EXPECT_TRUE (TimerQueueIsQueued (&Queue, &Timers[0].Node));
+  TimerQueueInsert (&Queue, &Timers[1].Node);
+  EXPECT_TRUE (TimerQueueIsQueued (&Queue, &Timers[1].Node));
+  TimerQueueRemove (&Queue, &Timers[0].Node);
+  EXPECT_FALSE (TimerQueueIsQueued (&Queue, &Timers[0].Node));
+  EXPECT_TRUE (TimerQueueIsQueued (&Queue, &Timers[1].Node));
+  TimerQueueRemove (&Queue, &Timers[1].Node);
+  EXPECT_FALSE (TimerQueueIsQueued (&Queue, &Timers[1].Node));
+  EXPECT_EQ (TimerQueueFirst (&Queue), (TIMER_QUEUE_NODE *)NULL);
+}
+
+// Run the same mix of periodic and relative timers through the sorted list
+// and the queue, check that they fire identically, and report the cost of each.
+TEST_F (TimerQueueTest, MatchesSortedListAndReportsCost) {
+  std::vector<UINTN>        ListFired;
+  std::vector<UINTN>        QueueFired;
+  std::chrono::nanoseconds  ListInsertTime (0);
+  std::chrono::nanoseconds  QueueInsertTime (0);
+  std::chrono::nanoseconds  ListTickTime (0);
+  std::chrono::nanoseconds  QueueTickTime (0);
+  UINT64                    SystemTime;
+  UINTN                     Rearmed;
+
+  //
+  // Three quarters of the timers are periodic, between 1 and 64 ticks, like
+  // the polling timers of the network, USB and console drivers. The rest are
+  // one shot relative timers that get re-armed at random as the clock runs.
+  //
+  for (UINTN Index = 0; Index < Timers.size (); Index++) {
+    Timers[Index].Period = (Index % 4 != 0) ? (1 + Random () % 64) * TEST_TICK_PERIOD : 0;
+  }
+
+  auto  Start = std::chrono::steady_clock::now ();
+
+  for (auto &Timer : Timers) {
+    Timer.ListTriggerTime = (Timer.Period != 0) ? Timer.Period : (1 + Timer.Id % 97) * TEST_TICK_PERIOD;
+    ListInsert (&List, &Timer);
+  }
+
+  auto  Middle = std::chrono::steady_clock::now ();
+
+  for (auto &Timer : Timers) {
+    Timer.Node.TriggerTime = (Timer.Period != 0) ? Timer.Period : (1 + Timer.Id % 97) * TEST_TICK_PERIOD;
+    TimerQueueInsert (&Queue, &Timer.Node);
+  }
+
+  auto  End = std::chrono::steady_clock::now ();
+
+  ListInsertTime  += Middle - Start;
+  QueueInsertTime += End - Middle;
+
+  SystemTime = 0;
+  Rearmed    = 0;
+  for (UINTN Tick = 0; Tick < TEST_TICK_COUNT; Tick++) {
+    SystemTime += TEST_TICK_PERIOD;
+
+    Start = std::chrono::steady_clock::now ();
+    ListTick (&List, SystemTime, ListFired);
+    Middle = std::chrono::steady_clock::now ();
+    QueueTick (&Queue, SystemTime, QueueFired);
+    End = std::chrono::steady_clock::now ();
+
+    ListTickTime  += Middle - Start;
+    QueueTickTime += End - Middle;
+
+    ASSERT_EQ (ListFired, QueueFired);
+
+    //
+    // Re-arm a few of the one shot timers that have expired.
+    //
+    for (UINTN Count = 0; Count < 8; Count++) {
+      TEST_TIMER  *Timer = &Timers[(Random () % (Timers.size () / 4)) * 4];
+
+      if (TimerQueueIsQueued (&Queue, &Timer->Node)) {
+        continue;
+      }
+
+      UINT64  Delay = (1 + Random () % 200) * TEST_TICK_PERIOD;
+
+      Timer->ListTriggerTime  = SystemTime + Delay;
+      Timer->Node.TriggerTime = SystemTime + Delay;
+
+      Start = std::chrono::steady_clock::now ();
+      ListInsert (&List, Timer);
+      Middle = std::chrono::steady_clock::now ();
+      TimerQueueInsert (&Queue, &Timer->Node);
+      End = std::chrono::steady_clock::now ();
+
+      ListInsertTime  += Middle - Start;
+      QueueInsertTime += End - Middle;
+      Rearmed++;
+    }
+
+    ListFired.clear ();
+    QueueFired.clear ();
+  }
+
+  CheckQueue ();
+
+  RecordProperty ("Timers", (int)Timers.size ());
+  RecordProperty ("Ticks", TEST_TICK_COUNT);
+  RecordProperty ("RearmedTimers", (int)Rearmed);
+  RecordProperty ("ListInsertMicroseconds", (int)std::chrono::duration_cast<std::chrono::microseconds>(ListInsertTime).count ());
+  RecordProperty ("QueueInsertMicroseconds", (int)std::chrono::duration_cast<std::chrono::microseconds>(QueueInsertTime).count ());
+  RecordProperty ("ListTickMicroseconds", (int)std::chrono::duration_cast<std::chrono::microseconds>(ListTickTime).count ());
+  RecordProperty ("QueueTickMicroseconds", (int)std::chrono::duration_cast<std::chrono::microseconds>(QueueTickTime).count ());
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
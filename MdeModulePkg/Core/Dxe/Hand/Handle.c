@@ -20,6 +20,96 @@ LIST_ENTRY  gHandleList           = INITIALIZE_LIST_HEAD_VARIABLE (gHandleList);
 EFI_LOCK    gProtocolDatabaseLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIFY);
 UINT64      gHandleDatabaseKey    = 0;
 
+// MU_CHANGE [BEGIN] - Hash the protocol database and the handle list
+//
+// mProtocolHashTable    - Protocol entries bucketed by protocol GUID
+// mHandleHashTable      - Handles bucketed by address, for handle validation
+//
+// Buckets are initialized on first use. Both tables are protected by
+// gProtocolDatabaseLock, the same as the lists they index.
+//
+#define PROTOCOL_HASH_BUCKETS  128
+#define HANDLE_HASH_BUCKETS    256
+
+LIST_ENTRY  mProtocolHashTable[PROTOCOL_HASH_BUCKETS];
+LIST_ENTRY  mHandleHashTable[HANDLE_HASH_BUCKETS];
+
+/**
+  Return a hash bucket, initializing it if it has never been used.
+
+  @param  Table                  The hash table
+  @param  Index                  The bucket index
+
+  @return The list head of the bucket
+
+**/
+STATIC
+LIST_ENTRY *
+CoreGetHashBucket (
+  IN LIST_ENTRY  *Table,
+  IN UINTN       Index
+  )
+{
+  if (Table[Index].ForwardLink == NULL) {
+    InitializeListHead (&Table[Index]);
+  }
+
+  return &Table[Index];
+}
+
+/**
+  Return the mProtocolHashTable bucket for a protocol GUID.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Protocol               The ID of the protocol
+
+  @return The list head of the bucket
+
+**/
+STATIC
+LIST_ENTRY *
+CoreGetProtocolHashBucket (
+  IN EFI_GUID  *Protocol
+  )
+{
+  UINT32  Hash;
+
+  Hash  = Protocol->Data1 ^ ((UINT32)Protocol->Data2 << 16) ^ Protocol->Data3;
+  Hash ^= ReadUnaligned32 ((UINT32 *)&Protocol->Data4[0]) ^ ReadUnaligned32 ((UINT32 *)&Protocol->Data4[4]);
+  Hash ^= Hash >> 16;
+  Hash ^= Hash >> 8;
+
+  return CoreGetHashBucket (mProtocolHashTable, Hash & (PROTOCOL_HASH_BUCKETS - 1));
+}
+
+/**
+  Return the mHandleHashTable bucket for a handle.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle, which does not need to be valid
+
+  @return The list head of the bucket
+
+**/
+STATIC
+LIST_ENTRY *
+CoreGetHandleHashBucket (
+  IN EFI_HANDLE  Handle
+  )
+{
+  UINTN  Hash;
+
+  //
+  // Handles are pool allocations, so the low bits carry no information.
+  //
+  Hash = (UINTN)Handle >> 3;
+  Hash ^= Hash >> 8;
+
+  return CoreGetHashBucket (mHandleHashTable, Hash & (HANDLE_HASH_BUCKETS - 1));
+}
+
+// MU_CHANGE [END]
+
 /**
   Acquire lock on gProtocolDatabaseLock.
 
@@ -61,6 +151,7 @@ CoreValidateHandle (
 {
   IHANDLE     *Handle;
   LIST_ENTRY  *Link;
+  LIST_ENTRY  *Bucket;  // MU_CHANGE
 
   if (UserHandle == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -68,13 +159,21 @@ CoreValidateHandle (
 
   ASSERT_LOCKED (&gProtocolDatabaseLock);
 
-  for (Link = gHandleList.BackLink; Link != &gHandleList; Link = Link->BackLink) {
-    Handle = CR (Link, IHANDLE, AllHandles, EFI_HANDLE_SIGNATURE);
+  // MU_CHANGE [BEGIN] - Only search the hash bucket for this handle
+  //
+  // UserHandle is only compared against, never dereferenced, so stale or
+  // garbage handles are safely rejected.
+  //
+  Bucket = CoreGetHandleHashBucket (UserHandle);
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    Handle = CR (Link, IHANDLE, HashLink, EFI_HANDLE_SIGNATURE);
     if (Handle == (IHANDLE *)UserHandle) {
       return EFI_SUCCESS;
     }
   }
 
+  // MU_CHANGE [END]
+
   return EFI_INVALID_PARAMETER;
 }
 
@@ -97,6 +196,7 @@ CoreFindProtocolEntry (
   LIST_ENTRY      *Link;
   PROTOCOL_ENTRY  *Item;
   PROTOCOL_ENTRY  *ProtEntry;
+  LIST_ENTRY      *Bucket;  // MU_CHANGE
 
   ASSERT_LOCKED (&gProtocolDatabaseLock);
 
@@ -105,11 +205,14 @@ CoreFindProtocolEntry (
   //
 
   ProtEntry = NULL;
-  for (Link = mProtocolDatabase.ForwardLink;
-       Link != &mProtocolDatabase;
+  // MU_CHANGE [BEGIN] - Only search the hash bucket for this GUID
+  Bucket = CoreGetProtocolHashBucket (Protocol);
+  for (Link = Bucket->ForwardLink;
+       Link != Bucket;
        Link = Link->ForwardLink)
   {
-    Item = CR (Link, PROTOCOL_ENTRY, AllEntries, PROTOCOL_ENTRY_SIGNATURE);
+    Item = CR (Link, PROTOCOL_ENTRY, HashLink, PROTOCOL_ENTRY_SIGNATURE);
+    // MU_CHANGE [END]
     if (CompareGuid (&Item->ProtocolID, Protocol)) {
       //
       // This is the protocol entry
@@ -140,6 +243,7 @@ CoreFindProtocolEntry (
       // Add it to protocol database
       //
       InsertTailList (&mProtocolDatabase, &ProtEntry->AllEntries);
+      InsertTailList (Bucket, &ProtEntry->HashLink);  // MU_CHANGE
     }
   }
 
@@ -469,6 +573,7 @@ CoreInstallProtocolInterfaceNotify (
     // in the system
     //
     InsertTailList (&gHandleList, &Handle->AllHandles);
+    InsertTailList (CoreGetHandleHashBucket (Handle), &Handle->HashLink);  // MU_CHANGE
   } else {
     Status = CoreValidateHandle (Handle);
     if (EFI_ERROR (Status)) {
@@ -508,6 +613,11 @@ CoreInstallProtocolInterfaceNotify (
   //
   InsertTailList (&ProtEntry->Protocols, &Prot->ByProtocol);
 
+  //
+  // Wake up the drivers whose depex waits on this protocol  // MU_CHANGE
+  //
+  CoreDepexProtocolInstalled (&ProtEntry->ProtocolID);  // MU_CHANGE
+
   //
   // Notify the notification list for this protocol
   //
@@ -826,6 +936,7 @@ CoreUninstallProtocolInterface (
   if (IsListEmpty (&Handle->Protocols)) {
     Handle->Signature = 0;
     RemoveEntryList (&Handle->AllHandles);
+    RemoveEntryList (&Handle->HashLink);  // MU_CHANGE
     CoreFreePool (Handle);
   }
 
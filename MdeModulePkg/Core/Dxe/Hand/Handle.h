@@ -23,6 +23,10 @@ typedef struct {
   UINTN         LocateRequest;
   /// The Handle Database Key value when this handle was last created or modified
   UINT64        Key;
+  // MU_CHANGE [BEGIN] - Hash the protocol database and the handle list
+  /// Link on the mHandleHashTable bucket for this handle
+  LIST_ENTRY    HashLink;
+  // MU_CHANGE [END]
 } IHANDLE;
 
 #define ASSERT_IS_HANDLE(a)  ASSERT((a)->Signature == EFI_HANDLE_SIGNATURE)
@@ -44,6 +48,10 @@ typedef struct {
   LIST_ENTRY    Protocols;
   /// Registerd notification handlers
   LIST_ENTRY    Notify;
+  // MU_CHANGE [BEGIN] - Hash the protocol database and the handle list
+  /// Link on the mProtocolHashTable bucket for this protocol ID
+  LIST_ENTRY    HashLink;
+  // MU_CHANGE [END]
 } PROTOCOL_ENTRY;
 
 #define PROTOCOL_INTERFACE_SIGNATURE  SIGNATURE_32('p','i','f','c')
@@ -9,6 +9,11 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #ifndef _IMEM_H_
 #define _IMEM_H_
 
+// MU_CHANGE [BEGIN] - Memory map index
+#include <Library/UefiLib.h> // EFI_LOCK
+#include "MemoryMapIndex.h"
+// MU_CHANGE [END]
+
 //
 // MEMORY_MAP_ENTRY
 //
@@ -25,8 +30,137 @@ typedef struct {
 
   UINT64             VirtualStart;
   UINT64             Attribute;
+
+  MEMORY_MAP_INDEX_NODE    IndexNode; // MU_CHANGE
 } MEMORY_MAP;
 
+// MU_CHANGE [BEGIN] - Ordered memory map index
+
+/**
+  Filter used to pick a free descriptor during a free range search.
+
+  @param  Entry                  A free descriptor that passed the address and
+                                 length checks of the search.
+  @param  Context                The context passed to MemoryMapIndexFindFree().
+
+  @retval TRUE                   Stop the search and return Entry.
+  @retval FALSE                  Keep searching at lower addresses.
+
+**/
+typedef
+BOOLEAN
+(*MEMORY_MAP_INDEX_FILTER)(
+  IN MEMORY_MAP  *Entry,
+  IN VOID        *Context
+  );
+
+/**
+  Add a descriptor to the memory map index.
+
+  @param  Index                  The memory map index.
+  @param  Entry                  The descriptor to add. Its range must not
+                                 overlap any descriptor already in the index.
+
+**/
+VOID
+MemoryMapIndexInsert (
+  IN OUT MEMORY_MAP_INDEX  *Index,
+  IN OUT MEMORY_MAP        *Entry
+  );
+
+/**
+  Remove a descriptor from the memory map index.
+
+  @param  Index                  The memory map index.
+  @param  Entry                  The descriptor to remove.
+
+**/
+VOID
+MemoryMapIndexRemove (
+  IN OUT MEMORY_MAP_INDEX  *Index,
+  IN OUT MEMORY_MAP        *Entry
+  );
+
+/**
+  Refresh the index after the range of a descriptor has been shrunk in place.
+
+  @param  Entry                  The descriptor that was updated.
+
+**/
+VOID
+MemoryMapIndexUpdate (
+  IN OUT MEMORY_MAP  *Entry
+  );
+
+/**
+  Find the descriptor that contains an address.
+
+  @param  Index                  The memory map index.
+  @param  Address                The address to look up.
+
+  @return The descriptor that contains Address, or NULL if there is none.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFind (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN UINT64            Address
+  );
+
+/**
+  Get the descriptor with the lowest start address.
+
+  @param  Index                  The memory map index.
+
+  @return The first descriptor, or NULL if the index is empty.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFirst (
+  IN MEMORY_MAP_INDEX  *Index
+  );
+
+/**
+  Get the descriptor that follows another one in address order.
+
+  @param  Entry                  A descriptor in the index.
+
+  @return The next descriptor, or NULL if Entry is the last one.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexNext (
+  IN MEMORY_MAP  *Entry
+  );
+
+/**
+  Search the free descriptors from the highest address down.
+
+  Only EfiConventionalMemory descriptors that start below MaxStart, end at or
+  above MinEnd and are at least MinLength bytes long are passed to Filter.
+
+  @param  Index                  The memory map index.
+  @param  MaxStart               Descriptors must start below this address.
+  @param  MinEnd                 Descriptors must end at or above this address.
+  @param  MinLength              Minimum length of the descriptors, in bytes.
+  @param  Filter                 Called for each candidate, highest first.
+  @param  Context                Passed to Filter.
+
+  @return The first descriptor accepted by Filter, or NULL if there is none.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFindFree (
+  IN MEMORY_MAP_INDEX         *Index,
+  IN UINT64                   MaxStart,
+  IN UINT64                   MinEnd,
+  IN UINT64                   MinLength,
+  IN MEMORY_MAP_INDEX_FILTER  Filter,
+  IN VOID                     *Context
+  );
+
+// MU_CHANGE [END]
+
 //
 // Internal prototypes
 //
@@ -99,6 +233,22 @@ CoreFreePoolI (
   OUT EFI_MEMORY_TYPE  *PoolType OPTIONAL
   );
 
+// MU_CHANGE [BEGIN] - Pool allocator statistics
+
+/**
+  Get a snapshot of the pool allocator statistics.
+
+  @param  Statistics             Returns the statistics, including the memory
+                                 profile record header.
+
+**/
+VOID
+CoreGetPoolStatistics (
+  OUT MEMORY_PROFILE_POOL_STATISTICS  *Statistics
+  );
+
+// MU_CHANGE [END]
+
 /**
   Enter critical section by gaining lock on gMemoryLock.
 
@@ -152,5 +302,6 @@ CoreInternalAllocatePages (
 
 extern EFI_LOCK    gMemoryLock;
 extern LIST_ENTRY  gMemoryMap;
+extern MEMORY_MAP_INDEX  gMemoryMapIndex; // MU_CHANGE
 extern LIST_ENTRY  mGcdMemorySpaceMap;
 #endif
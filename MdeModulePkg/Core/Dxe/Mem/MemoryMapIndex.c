@@ -0,0 +1,520 @@
+/** @file
+  Ordered index over the DXE core memory map descriptors.
+
+  The memory map is kept as a list of descriptors, and heap guard and memory
+  protection can split it into thousands of entries. This AVL tree indexes the
+  same descriptors by start address, so that finding the descriptor covering
+  an address, or the highest free range that satisfies an allocation, no
+  longer needs to walk the whole list.
+
+  This file only depends on base types so that it can be built into host
+  based unit tests.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Guid/MemoryProfile.h>
+#include <Library/DebugLib.h>
+
+#include "Imem.h"
+
+#define INDEX_NODE_TO_ENTRY(Node)  BASE_CR (Node, MEMORY_MAP, IndexNode)
+
+/**
+  Get the height of a subtree.
+
+  @param  Node                   The root of the subtree, or NULL.
+
+  @return The height of the subtree.
+
+**/
+STATIC
+UINTN
+NodeHeight (
+  IN MEMORY_MAP_INDEX_NODE  *Node
+  )
+{
+  return (Node == NULL) ? 0 : Node->Height;
+}
+
+/**
+  Get the largest free length in a subtree.
+
+  @param  Node                   The root of the subtree, or NULL.
+
+  @return The length of the largest free descriptor in the subtree.
+
+**/
+STATIC
+UINT64
+NodeMaxFreeLength (
+  IN MEMORY_MAP_INDEX_NODE  *Node
+  )
+{
+  return (Node == NULL) ? 0 : Node->MaxFreeLength;
+}
+
+/**
+  Recompute the height and free length of a node from its children.
+
+  @param  Node                   The node to refresh.
+
+**/
+STATIC
+VOID
+RefreshNode (
+  IN OUT MEMORY_MAP_INDEX_NODE  *Node
+  )
+{
+  MEMORY_MAP  *Entry;
+  UINT64      FreeLength;
+
+  Entry      = INDEX_NODE_TO_ENTRY (Node);
+  FreeLength = 0;
+  if ((Entry->Type == EfiConventionalMemory) && (Entry->End >= Entry->Start)) {
+    FreeLength = Entry->End - Entry->Start + 1;
+  }
+
+  FreeLength          = MAX (FreeLength, NodeMaxFreeLength (Node->Left));
+  Node->MaxFreeLength = MAX (FreeLength, NodeMaxFreeLength (Node->Right));
+  Node->Height        = 1 + MAX (NodeHeight (Node->Left), NodeHeight (Node->Right));
+}
+
+/**
+  Make New take the place of Old under Old's parent.
+
+  @param  Index                  The memory map index.
+  @param  Old                    The node being replaced.
+  @param  New                    The replacement node, or NULL.
+
+**/
+STATIC
+VOID
+ReplaceChild (
+  IN OUT MEMORY_MAP_INDEX       *Index,
+  IN     MEMORY_MAP_INDEX_NODE  *Old,
+  IN     MEMORY_MAP_INDEX_NODE  *New
+  )
+{
+  if (Old->Parent == NULL) {
+    Index->Root = New;
+  } else if (Old->Parent->Left == Old) {
+    Old->Parent->Left = New;
+  } else {
+    Old->Parent->Right = New;
+  }
+
+  if (New != NULL) {
+    New->Parent = Old->Parent;
+  }
+}
+
+/**
+  Rotate a subtree to the left.
+
+  @param  Index                  The memory map index.
+  @param  Node                   The root of the subtree.
+
+  @return The new root of the subtree.
+
+**/
+STATIC
+MEMORY_MAP_INDEX_NODE *
+RotateLeft (
+  IN OUT MEMORY_MAP_INDEX       *Index,
+  IN OUT MEMORY_MAP_INDEX_NODE  *Node
+  )
+{
+  MEMORY_MAP_INDEX_NODE  *Pivot;
+
+  Pivot       = Node->Right;
+  Node->Right = Pivot->Left;
+  if (Pivot->Left != NULL) {
+    Pivot->Left->Parent = Node;
+  }
+
+  ReplaceChild (Index, Node, Pivot);
+  Pivot->Left  = Node;
+  Node->Parent = Pivot;
+
+  RefreshNode (Node);
+  RefreshNode (Pivot);
+  return Pivot;
+}
+
+/**
+  Rotate a subtree to the right.
+
+  @param  Index                  The memory map index.
+  @param  Node                   The root of the subtree.
+
+  @return The new root of the subtree.
+
+**/
+STATIC
+MEMORY_MAP_INDEX_NODE *
+RotateRight (
+  IN OUT MEMORY_MAP_INDEX       *Index,
+  IN OUT MEMORY_MAP_INDEX_NODE  *Node
+  )
+{
+  MEMORY_MAP_INDEX_NODE  *Pivot;
+
+  Pivot      = Node->Left;
+  Node->Left = Pivot->Right;
+  if (Pivot->Right != NULL) {
+    Pivot->Right->Parent = Node;
+  }
+
+  ReplaceChild (Index, Node, Pivot);
+  Pivot->Right = Node;
+  Node->Parent = Pivot;
+
+  RefreshNode (Node);
+  RefreshNode (Pivot);
+  return Pivot;
+}
+
+/**
+  Refresh and rebalance every node from Node up to the root.
+
+  @param  Index                  The memory map index.
+  @param  Node                   The lowest node that changed, or NULL.
+
+**/
+STATIC
+VOID
+RebalanceToRoot (
+  IN OUT MEMORY_MAP_INDEX       *Index,
+  IN OUT MEMORY_MAP_INDEX_NODE  *Node
+  )
+{
+  while (Node != NULL) {
+    RefreshNode (Node);
+
+    if (NodeHeight (Node->Left) > NodeHeight (Node->Right) + 1) {
+      if (NodeHeight (Node->Left->Left) < NodeHeight (Node->Left->Right)) {
+        RotateLeft (Index, Node->Left);
+      }
+
+      Node = RotateRight (Index, Node);
+    } else if (NodeHeight (Node->Right) > NodeHeight (Node->Left) + 1) {
+      if (NodeHeight (Node->Right->Right) < NodeHeight (Node->Right->Left)) {
+        RotateRight (Index, Node->Right);
+      }
+
+      Node = RotateLeft (Index, Node);
+    }
+
+    Node = Node->Parent;
+  }
+}
+
+/**
+  Add a descriptor to the memory map index.
+
+  @param  Index                  The memory map index.
+  @param  Entry                  The descriptor to add. Its range must not
+                                 overlap any descriptor already in the index.
+
+**/
+VOID
+MemoryMapIndexInsert (
+  IN OUT MEMORY_MAP_INDEX  *Index,
+  IN OUT MEMORY_MAP        *Entry
+  )
+{
+  MEMORY_MAP_INDEX_NODE  *Parent;
+  MEMORY_MAP_INDEX_NODE  **Link;
+
+  Parent = NULL;
+  Link   = &Index->Root;
+  while (*Link != NULL) {
+    Parent = *Link;
+    ASSERT (INDEX_NODE_TO_ENTRY (Parent) != Entry);
+    if (Entry->Start < INDEX_NODE_TO_ENTRY (Parent)->Start) {
+      Link = &Parent->Left;
+    } else {
+      Link = &Parent->Right;
+    }
+  }
+
+  Entry->IndexNode.Parent = Parent;
+  Entry->IndexNode.Left   = NULL;
+  Entry->IndexNode.Right  = NULL;
+  *Link                   = &Entry->IndexNode;
+  Index->Count++;
+
+  RebalanceToRoot (Index, &Entry->IndexNode);
+}
+
+/**
+  Remove a descriptor from the memory map index.
+
+  @param  Index                  The memory map index.
+  @param  Entry                  The descriptor to remove.
+
+**/
+VOID
+MemoryMapIndexRemove (
+  IN OUT MEMORY_MAP_INDEX  *Index,
+  IN OUT MEMORY_MAP        *Entry
+  )
+{
+  MEMORY_MAP_INDEX_NODE  *Node;
+  MEMORY_MAP_INDEX_NODE  *Successor;
+  MEMORY_MAP_INDEX_NODE  *Fixup;
+
+  Node = &Entry->IndexNode;
+  ASSERT (Index->Count > 0);
+
+  if (Node->Left == NULL) {
+    Fixup = Node->Parent;
+    ReplaceChild (Index, Node, Node->Right);
+  } else if (Node->Right == NULL) {
+    Fixup = Node->Parent;
+    ReplaceChild (Index, Node, Node->Left);
+  } else {
+    //
+    // Move the in-order successor, which has no left child, into the place
+    // of the node being removed.
+    //
+    Successor = Node->Right;
+    while (Successor->Left != NULL) {
+      Successor = Successor->Left;
+    }
+
+    if (Successor->Parent != Node) {
+      Fixup = Successor->Parent;
+      ReplaceChild (Index, Successor, Successor->Right);
+      Successor->Right         = Node->Right;
+      Successor->Right->Parent = Successor;
+    } else {
+      Fixup = Successor;
+    }
+
+    ReplaceChild (Index, Node, Successor);
+    Successor->Left         = Node->Left;
+    Successor->Left->Parent = Successor;
+  }
+
+  Node->Parent = NULL;
+  Node->Left   = NULL;
+  Node->Right  = NULL;
+  Index->Count--;
+
+  RebalanceToRoot (Index, Fixup);
+}
+
+/**
+  Refresh the index after the range of a descriptor has been shrunk in place.
+
+  @param  Entry                  The descriptor that was updated.
+
+**/
+VOID
+MemoryMapIndexUpdate (
+  IN OUT MEMORY_MAP  *Entry
+  )
+{
+  MEMORY_MAP_INDEX_NODE  *Node;
+
+  //
+  // Shrinking a descriptor does not change its position relative to the
+  // others, only the free lengths on the path to the root.
+  //
+  for (Node = &Entry->IndexNode; Node != NULL; Node = Node->Parent) {
+    RefreshNode (Node);
+  }
+}
+
+/**
+  Find the descriptor that contains an address.
+
+  @param  Index                  The memory map index.
+  @param  Address                The address to look up.
+
+  @return The descriptor that contains Address, or NULL if there is none.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFind (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN UINT64            Address
+  )
+{
+  MEMORY_MAP_INDEX_NODE  *Node;
+  MEMORY_MAP             *Entry;
+
+  Node = Index->Root;
+  while (Node != NULL) {
+    Entry = INDEX_NODE_TO_ENTRY (Node);
+    if (Address < Entry->Start) {
+      Node = Node->Left;
+    } else if (Address > Entry->End) {
+      Node = Node->Right;
+    } else {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Get the descriptor with the lowest start address.
+
+  @param  Index                  The memory map index.
+
+  @return The first descriptor, or NULL if the index is empty.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFirst (
+  IN MEMORY_MAP_INDEX  *Index
+  )
+{
+  MEMORY_MAP_INDEX_NODE  *Node;
+
+  Node = Index->Root;
+  if (Node == NULL) {
+    return NULL;
+  }
+
+  while (Node->Left != NULL) {
+    Node = Node->Left;
+  }
+
+  return INDEX_NODE_TO_ENTRY (Node);
+}
+
+/**
+  Get the descriptor that follows another one in address order.
+
+  @param  Entry                  A descriptor in the index.
+
+  @return The next descriptor, or NULL if Entry is the last one.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexNext (
+  IN MEMORY_MAP  *Entry
+  )
+{
+  MEMORY_MAP_INDEX_NODE  *Node;
+
+  Node = &Entry->IndexNode;
+  if (Node->Right != NULL) {
+    Node = Node->Right;
+    while (Node->Left != NULL) {
+      Node = Node->Left;
+    }
+
+    return INDEX_NODE_TO_ENTRY (Node);
+  }
+
+  while ((Node->Parent != NULL) && (Node->Parent->Right == Node)) {
+    Node = Node->Parent;
+  }
+
+  return (Node->Parent == NULL) ? NULL : INDEX_NODE_TO_ENTRY (Node->Parent);
+}
+
+/**
+  Search a subtree for free descriptors from the highest address down.
+
+  @param  Node                   The root of the subtree, or NULL.
+  @param  MaxStart               Descriptors must start below this address.
+  @param  MinEnd                 Descriptors must end at or above this address.
+  @param  MinLength              Minimum length of the descriptors, in bytes.
+  @param  Filter                 Called for each candidate, highest first.
+  @param  Context                Passed to Filter.
+  @param  Done                   Set to TRUE when no descriptor at a lower
+                                 address can match.
+
+  @return The first descriptor accepted by Filter, or NULL if there is none.
+
+**/
+STATIC
+MEMORY_MAP *
+FindFreeInSubtree (
+  IN     MEMORY_MAP_INDEX_NODE    *Node,
+  IN     UINT64                   MaxStart,
+  IN     UINT64                   MinEnd,
+  IN     UINT64                   MinLength,
+  IN     MEMORY_MAP_INDEX_FILTER  Filter,
+  IN     VOID                     *Context,
+  IN OUT BOOLEAN                  *Done
+  )
+{
+  MEMORY_MAP  *Entry;
+  MEMORY_MAP  *Found;
+
+  //
+  // Subtrees without a large enough free descriptor are skipped entirely.
+  // The recursion depth is bounded by the height of the tree.
+  //
+  if ((Node == NULL) || (Node->MaxFreeLength < MinLength) || *Done) {
+    return NULL;
+  }
+
+  Entry = INDEX_NODE_TO_ENTRY (Node);
+  if (Entry->Start < MaxStart) {
+    Found = FindFreeInSubtree (Node->Right, MaxStart, MinEnd, MinLength, Filter, Context, Done);
+    if ((Found != NULL) || *Done) {
+      return Found;
+    }
+
+    if (Entry->End < MinEnd) {
+      //
+      // Everything left of this node is even lower.
+      //
+      *Done = TRUE;
+      return NULL;
+    }
+
+    if ((Entry->Type == EfiConventionalMemory) &&
+        (Entry->End - Entry->Start + 1 >= MinLength) &&
+        Filter (Entry, Context))
+    {
+      return Entry;
+    }
+  }
+
+  return FindFreeInSubtree (Node->Left, MaxStart, MinEnd, MinLength, Filter, Context, Done);
+}
+
+/**
+  Search the free descriptors from the highest address down.
+
+  Only EfiConventionalMemory descriptors that start below MaxStart, end at or
+  above MinEnd and are at least MinLength bytes long are passed to Filter.
+
+  @param  Index                  The memory map index.
+  @param  MaxStart               Descriptors must start below this address.
+  @param  MinEnd                 Descriptors must end at or above this address.
+  @param  MinLength              Minimum length of the descriptors, in bytes.
+  @param  Filter                 Called for each candidate, highest first.
+  @param  Context                Passed to Filter.
+
+  @return The first descriptor accepted by Filter, or NULL if there is none.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFindFree (
+  IN MEMORY_MAP_INDEX         *Index,
+  IN UINT64                   MaxStart,
+  IN UINT64                   MinEnd,
+  IN UINT64                   MinLength,
+  IN MEMORY_MAP_INDEX_FILTER  Filter,
+  IN VOID                     *Context
+  )
+{
+  BOOLEAN  Done;
+
+  Done = FALSE;
+  return FindFreeInSubtree (Index->Root, MaxStart, MinEnd, MinLength, Filter, Context, &Done);
+}
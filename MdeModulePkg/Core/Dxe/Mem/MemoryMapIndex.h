@@ -0,0 +1,39 @@
+/** @file
+  Ordered index over the DXE core memory map descriptors.
+
+  The index is an AVL tree keyed by the start address of each descriptor and
+  embedded in the descriptors themselves, so that it never needs to allocate
+  memory while the memory map is being updated. Each node also tracks the size
+  of the largest free (EfiConventionalMemory) descriptor in its subtree, which
+  lets free range searches skip whole subtrees that cannot satisfy a request.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef MEMORY_MAP_INDEX_H_
+#define MEMORY_MAP_INDEX_H_
+
+typedef struct _MEMORY_MAP_INDEX_NODE MEMORY_MAP_INDEX_NODE;
+
+///
+/// Index linkage embedded in every MEMORY_MAP descriptor.
+///
+struct _MEMORY_MAP_INDEX_NODE {
+  MEMORY_MAP_INDEX_NODE    *Parent;
+  MEMORY_MAP_INDEX_NODE    *Left;
+  MEMORY_MAP_INDEX_NODE    *Right;
+  UINTN                    Height;
+  UINT64                   MaxFreeLength;
+};
+
+///
+/// Root of the memory map index.
+///
+typedef struct {
+  MEMORY_MAP_INDEX_NODE    *Root;
+  UINTN                    Count;
+} MEMORY_MAP_INDEX;
+
+#endif
@@ -1483,6 +1483,13 @@ MemoryProfileGetDataSize (
     }
   }
 
+  // MU_CHANGE [BEGIN] - Pool allocator statistics
+  if (PcdGet32 (PcdDxePoolPageRunCacheMaxPages) != 0) {
+    TotalSize += sizeof (MEMORY_PROFILE_POOL_STATISTICS);
+  }
+
+  // MU_CHANGE [END]
+
   return TotalSize;
 }
 
@@ -1560,6 +1567,13 @@ MemoryProfileCopyData (
 
     DriverInfo = (MEMORY_PROFILE_DRIVER_INFO *)AllocInfo;
   }
+
+  // MU_CHANGE [BEGIN] - Pool allocator statistics follow the last driver
+  if (PcdGet32 (PcdDxePoolPageRunCacheMaxPages) != 0) {
+    CoreGetPoolStatistics ((MEMORY_PROFILE_POOL_STATISTICS *)DriverInfo);
+  }
+
+  // MU_CHANGE [END]
 }
 
 /**
@@ -46,6 +46,13 @@ UINTN       mFreeMapStack = 0;
 LIST_ENTRY  mFreeMemoryMapEntryList           = INITIALIZE_LIST_HEAD_VARIABLE (mFreeMemoryMapEntryList);
 BOOLEAN     mMemoryTypeInformationInitialized = FALSE;
 
+// MU_CHANGE [BEGIN] - Ordered memory map index
+///
+/// gMemoryMapIndex - the descriptors of gMemoryMap, ordered by address
+///
+MEMORY_MAP_INDEX  gMemoryMapIndex = { NULL, 0 };
+// MU_CHANGE [END]
+
 EFI_MEMORY_TYPE_STATISTICS  mMemoryTypeStatistics[EfiMaxMemoryType + 1] = {
   { 0, MAX_ALLOC_ADDRESS, 0, 0, EfiMaxMemoryType, TRUE,  FALSE },  // EfiReservedMemoryType
   { 0, MAX_ALLOC_ADDRESS, 0, 0, EfiMaxMemoryType, FALSE, FALSE },  // EfiLoaderCode
@@ -130,6 +137,7 @@ RemoveMemoryMapEntry (
   IN OUT MEMORY_MAP  *Entry
   )
 {
+  MemoryMapIndexRemove (&gMemoryMapIndex, Entry); // MU_CHANGE
   RemoveEntryList (&Entry->Link);
   Entry->Link.ForwardLink = NULL;
 
@@ -161,7 +169,6 @@ CoreAddRange (
   IN UINT64                Attribute
   )
 {
-  LIST_ENTRY  *Link;
   MEMORY_MAP  *Entry;
 
   ASSERT ((Start & EFI_PAGE_MASK) == 0);
@@ -213,28 +220,27 @@ CoreAddRange (
   // and the same Attribute
   //
 
-  Link = gMemoryMap.ForwardLink;
-  while (Link != &gMemoryMap) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    Link  = Link->ForwardLink;
-
-    if (Entry->Type != Type) {
-      continue;
-    }
-
-    if (Entry->Attribute != Attribute) {
-      continue;
-    }
-
-    if (Entry->End + 1 == Start) {
+  // MU_CHANGE [BEGIN] - Look up the adjoining descriptors in the memory map index
+  if (Start != 0) {
+    Entry = MemoryMapIndexFind (&gMemoryMapIndex, Start - 1);
+    if ((Entry != NULL) && (Entry->Type == Type) && (Entry->Attribute == Attribute)) {
+      ASSERT (Entry->End + 1 == Start);
       Start = Entry->Start;
       RemoveMemoryMapEntry (Entry);
-    } else if (Entry->Start == End + 1) {
+    }
+  }
+
+  if (End != MAX_UINT64) {
+    Entry = MemoryMapIndexFind (&gMemoryMapIndex, End + 1);
+    if ((Entry != NULL) && (Entry->Type == Type) && (Entry->Attribute == Attribute)) {
+      ASSERT (Entry->Start == End + 1);
       End = Entry->End;
       RemoveMemoryMapEntry (Entry);
     }
   }
 
+  // MU_CHANGE [END]
+
   //
   // Add descriptor
   //
@@ -247,6 +253,7 @@ CoreAddRange (
   mMapStack[mMapDepth].VirtualStart = 0;
   mMapStack[mMapDepth].Attribute    = Attribute;
   InsertTailList (&gMemoryMap, &mMapStack[mMapDepth].Link);
+  MemoryMapIndexInsert (&gMemoryMapIndex, &mMapStack[mMapDepth]); // MU_CHANGE
 
   mMapDepth += 1;
   ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -370,22 +377,28 @@ CoreFreeMemoryMapStack (
       //
       // Move this entry to general memory
       //
+      MemoryMapIndexRemove (&gMemoryMapIndex, &mMapStack[mMapDepth]); // MU_CHANGE
       RemoveEntryList (&mMapStack[mMapDepth].Link);
       mMapStack[mMapDepth].Link.ForwardLink = NULL;
 
       CopyMem (Entry, &mMapStack[mMapDepth], sizeof (MEMORY_MAP));
       Entry->FromPages = TRUE;
 
+      // MU_CHANGE [BEGIN] - Use the memory map index to find the insertion location
+      MemoryMapIndexInsert (&gMemoryMapIndex, Entry);
+
       //
-      // Find insertion location
+      // Find insertion location. Heap descriptors are kept in address order in
+      // gMemoryMap, so this is in front of the next heap descriptor by address.
       //
-      for (Link2 = gMemoryMap.ForwardLink; Link2 != &gMemoryMap; Link2 = Link2->ForwardLink) {
-        Entry2 = CR (Link2, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-        if (Entry2->FromPages && (Entry2->Start > Entry->Start)) {
-          break;
-        }
+      Entry2 = MemoryMapIndexNext (Entry);
+      while ((Entry2 != NULL) && !Entry2->FromPages) {
+        Entry2 = MemoryMapIndexNext (Entry2);
       }
 
+      Link2 = (Entry2 == NULL) ? &gMemoryMap : &Entry2->Link;
+      // MU_CHANGE [END]
+
       InsertTailList (Link2, &Entry->Link);
     } else {
       //
@@ -863,7 +876,6 @@ CoreConvertPagesEx (
   UINT64           RangeEnd;
   UINT64           Attribute;
   EFI_MEMORY_TYPE  MemType;
-  LIST_ENTRY       *Link;
   MEMORY_MAP       *Entry;
 
   Entry         = NULL;
@@ -888,15 +900,8 @@ CoreConvertPagesEx (
     //
     // Find the entry that the covers the range
     //
-    for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-
-      if ((Entry->Start <= Start) && (Entry->End > Start)) {
-        break;
-      }
-    }
-
-    if (Link == &gMemoryMap) {
+    Entry = MemoryMapIndexFind (&gMemoryMapIndex, Start); // MU_CHANGE
+    if (Entry == NULL) { // MU_CHANGE
       DEBUG ((DEBUG_ERROR | DEBUG_PAGE, "ConvertPages: failed to find range %lx - %lx\n", Start, End));
       return EFI_NOT_FOUND;
     }
@@ -982,11 +987,13 @@ CoreConvertPagesEx (
       // Clip start
       //
       Entry->Start = RangeEnd + 1;
+      MemoryMapIndexUpdate (Entry); // MU_CHANGE
     } else if (Entry->End == RangeEnd) {
       //
       // Clip end
       //
       Entry->End = Start - 1;
+      MemoryMapIndexUpdate (Entry); // MU_CHANGE
     } else {
       //
       // Pull it out of the center, clip current
@@ -1008,9 +1015,11 @@ CoreConvertPagesEx (
 
       Entry->End = Start - 1;
       ASSERT (Entry->Start < Entry->End);
+      MemoryMapIndexUpdate (Entry); // MU_CHANGE
 
       Entry = &mMapStack[mMapDepth];
       InsertTailList (&gMemoryMap, &Entry->Link);
+      MemoryMapIndexInsert (&gMemoryMapIndex, Entry); // MU_CHANGE
 
       mMapDepth += 1;
       ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -1157,6 +1166,96 @@ CoreUpdateMemoryAttributes (
   CoreReleaseMemoryLock ();
 }
 
+// MU_CHANGE [BEGIN] - Ordered memory map index
+
+///
+/// Request checked against each candidate descriptor by FreePagesFilter().
+///
+typedef struct {
+  UINT64     MaxAddress;
+  UINT64     MinAddress;
+  UINT64     NumberOfBytes;
+  UINTN      Alignment;
+  BOOLEAN    NeedGuard;
+  UINT64     Target;
+} FREE_PAGES_REQUEST;
+
+/**
+  Check if a free descriptor can satisfy a page allocation request, and where.
+
+  @param  Entry                  A free descriptor, visited from the highest
+                                 address down.
+  @param  Context                The FREE_PAGES_REQUEST. On success, Target is
+                                 set to the last byte of the range to use.
+
+  @retval TRUE                   The request fits in Entry.
+  @retval FALSE                  The request does not fit in Entry.
+
+**/
+STATIC
+BOOLEAN
+FreePagesFilter (
+  IN MEMORY_MAP  *Entry,
+  IN VOID        *Context
+  )
+{
+  FREE_PAGES_REQUEST  *Request;
+  UINT64              DescStart;
+  UINT64              DescEnd;
+  UINT64              DescNumberOfBytes;
+
+  Request   = (FREE_PAGES_REQUEST *)Context;
+  DescStart = Entry->Start;
+  DescEnd   = Entry->End;
+
+  //
+  // If desc ends past max allowed address, clip the end
+  //
+  if (DescEnd >= Request->MaxAddress) {
+    DescEnd = Request->MaxAddress;
+  }
+
+  DescEnd = ((DescEnd + 1) & (~((UINT64)Request->Alignment - 1))) - 1;
+
+  // Skip if DescEnd is less than DescStart after alignment clipping
+  if (DescEnd < DescStart) {
+    return FALSE;
+  }
+
+  //
+  // Compute the number of bytes we can used from this
+  // descriptor, and see it's enough to satisfy the request
+  //
+  DescNumberOfBytes = DescEnd - DescStart + 1;
+
+  if (DescNumberOfBytes < Request->NumberOfBytes) {
+    return FALSE;
+  }
+
+  //
+  // If the start of the allocated range is below the min address allowed, skip it
+  //
+  if ((DescEnd - Request->NumberOfBytes + 1) < Request->MinAddress) {
+    return FALSE;
+  }
+
+  if (Request->NeedGuard) {
+    DescEnd = AdjustMemoryS (
+                DescEnd + 1 - DescNumberOfBytes,
+                DescNumberOfBytes,
+                Request->NumberOfBytes
+                );
+    if (DescEnd == 0) {
+      return FALSE;
+    }
+  }
+
+  Request->Target = DescEnd;
+  return TRUE;
+}
+
+// MU_CHANGE [END]
+
 /**
   Internal function. Finds a consecutive free page range below
   the requested address.
@@ -1182,13 +1281,9 @@ CoreFindFreePagesI (
   IN BOOLEAN          NeedGuard
   )
 {
-  UINT64      NumberOfBytes;
-  UINT64      Target;
-  UINT64      DescStart;
-  UINT64      DescEnd;
-  UINT64      DescNumberOfBytes;
-  LIST_ENTRY  *Link;
-  MEMORY_MAP  *Entry;
+  UINT64              NumberOfBytes;
+  UINT64              Target;
+  FREE_PAGES_REQUEST  Request; // MU_CHANGE
 
   if ((MaxAddress < EFI_PAGE_MASK) || (NumberOfPages == 0)) {
     return 0;
@@ -1218,74 +1313,24 @@ CoreFindFreePagesI (
   NumberOfBytes = LShiftU64 (NumberOfPages, EFI_PAGE_SHIFT);
   Target        = 0;
 
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-
-    //
-    // If it's not a free entry, don't bother with it
-    //
-    if (Entry->Type != EfiConventionalMemory) {
-      continue;
-    }
-
-    DescStart = Entry->Start;
-    DescEnd   = Entry->End;
-
-    //
-    // If desc is past max allowed address or below min allowed address, skip it
-    //
-    if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
-      continue;
-    }
-
-    //
-    // If desc ends past max allowed address, clip the end
-    //
-    if (DescEnd >= MaxAddress) {
-      DescEnd = MaxAddress;
-    }
-
-    DescEnd = ((DescEnd + 1) & (~((UINT64)Alignment - 1))) - 1;
-
-    // Skip if DescEnd is less than DescStart after alignment clipping
-    if (DescEnd < DescStart) {
-      continue;
-    }
-
-    //
-    // Compute the number of bytes we can used from this
-    // descriptor, and see it's enough to satisfy the request
-    //
-    DescNumberOfBytes = DescEnd - DescStart + 1;
-
-    if (DescNumberOfBytes >= NumberOfBytes) {
-      //
-      // If the start of the allocated range is below the min address allowed, skip it
-      //
-      if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
-        continue;
-      }
-
-      //
-      // If this is the best match so far remember it
-      //
-      if (DescEnd > Target) {
-        if (NeedGuard) {
-          DescEnd = AdjustMemoryS (
-                      DescEnd + 1 - DescNumberOfBytes,
-                      DescNumberOfBytes,
-                      NumberOfBytes
-                      );
-          if (DescEnd == 0) {
-            continue;
-          }
-        }
-
-        Target = DescEnd;
-      }
-    }
+  // MU_CHANGE [BEGIN] - Ordered memory map index
+  //
+  // Free descriptors are visited from the highest address down, so the first
+  // one that fits is the best match. Descriptors past the max allowed
+  // address, below the min allowed address, or too small are never visited.
+  //
+  Request.MaxAddress    = MaxAddress;
+  Request.MinAddress    = MinAddress;
+  Request.NumberOfBytes = NumberOfBytes;
+  Request.Alignment     = Alignment;
+  Request.NeedGuard     = NeedGuard;
+  Request.Target        = 0;
+  if (MemoryMapIndexFindFree (&gMemoryMapIndex, MaxAddress, MinAddress, NumberOfBytes, FreePagesFilter, &Request) != NULL) {
+    Target = Request.Target;
   }
 
+  // MU_CHANGE [END]
+
   //
   // If this is a grow down, adjust target to be the allocation base
   //
@@ -1687,7 +1732,6 @@ CoreInternalFreePages (
   )
 {
   EFI_STATUS  Status;
-  LIST_ENTRY  *Link;
   MEMORY_MAP  *Entry;
   UINTN       Alignment;
   BOOLEAN     IsGuarded;
@@ -1701,21 +1745,9 @@ CoreInternalFreePages (
   // Find the entry that the covers the range
   //
   IsGuarded = FALSE;
-  Entry     = NULL;
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    if ((Entry->Start <= Memory) && (Entry->End > Memory)) {
-      break;
-    }
-  }
-
-  if (Link == &gMemoryMap) {
-    Status = EFI_NOT_FOUND;
-    goto Done;
-  }
-
+  Entry     = MemoryMapIndexFind (&gMemoryMapIndex, Memory); // MU_CHANGE
   if (Entry == NULL) {
-    ASSERT (Entry != NULL);
+    // MU_CHANGE - Not finding the range is an error of the caller, not of the map
     Status = EFI_NOT_FOUND;
     goto Done;
   }
@@ -1935,6 +1967,7 @@ CoreGetMemoryMap (
   EFI_MEMORY_TYPE        Type;
   EFI_MEMORY_DESCRIPTOR  *MemoryMapStart;
   EFI_MEMORY_DESCRIPTOR  *MemoryMapEnd;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapPrevious; // MU_CHANGE
 
   //
   // Make sure the parameters are valid
@@ -1983,10 +2016,7 @@ CoreGetMemoryMap (
   //
   // Compute the buffer size needed to fit the entire map
   //
-  BufferSize = Size * NumberOfEntries;
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    BufferSize += Size;
-  }
+  BufferSize = Size * (NumberOfEntries + gMemoryMapIndex.Count); // MU_CHANGE
 
   if (*MemoryMapSize < BufferSize) {
     Status = EFI_BUFFER_TOO_SMALL;
@@ -2003,8 +2033,9 @@ CoreGetMemoryMap (
   //
   ZeroMem (MemoryMap, BufferSize);
   MemoryMapStart = MemoryMap;
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+  // MU_CHANGE [BEGIN] - Walk the memory map index in address order
+  for (Entry = MemoryMapIndexFirst (&gMemoryMapIndex); Entry != NULL; Entry = MemoryMapIndexNext (Entry)) {
+    // MU_CHANGE [END]
     ASSERT (Entry->VirtualStart == 0);
 
     //
@@ -2044,7 +2075,15 @@ CoreGetMemoryMap (
     // Check to see if the new Memory Map Descriptor can be merged with an
     // existing descriptor if they are adjacent and have the same attributes
     //
-    MemoryMap = MergeMemoryMapDescriptor (MemoryMapStart, MemoryMap, Size);
+    // MU_CHANGE [BEGIN] - Descriptors are built in address order, so only the
+    //                     previous one can be adjacent.
+    MemoryMapPrevious = MemoryMap;
+    if (MemoryMap != MemoryMapStart) {
+      MemoryMapPrevious = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)MemoryMap - Size);
+    }
+
+    MemoryMap = MergeMemoryMapDescriptor (MemoryMapPrevious, MemoryMap, Size);
+    // MU_CHANGE [END]
   }
 
   ZeroMem (&MergeGcdMapEntry, sizeof (MergeGcdMapEntry));
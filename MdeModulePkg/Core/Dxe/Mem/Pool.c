@@ -59,6 +59,24 @@ STATIC CONST UINT16  mPoolSizeTable[] = {
 
 #define MAX_POOL_SIZE  (MAX_ADDRESS - POOL_OVERHEAD)
 
+// MU_CHANGE [BEGIN] - Pool page-run cache
+//
+// Pool allocations too large for the size classes above are backed by a run
+// of pages of their own, as are the pages the size classes are carved from.
+// When PcdDxePoolPageRunCacheMaxPages is not zero, freed runs of up to
+// POOL_PAGE_RUN_MAX_PAGES pages are kept on a freelist per run length and
+// handed out again before going back to the page allocator.
+//
+#define POOL_PAGE_RUN_MAX_PAGES  16
+
+#define POOL_PAGE_RUN_SIGNATURE  SIGNATURE_32('p','r','u','n')
+typedef struct {
+  UINT32        Signature;
+  UINT32        NoPages;
+  LIST_ENTRY    Link;
+} POOL_PAGE_RUN;
+// MU_CHANGE [END]
+
 //
 // Globals
 //
@@ -70,6 +88,8 @@ typedef struct {
   EFI_MEMORY_TYPE    MemoryType;
   LIST_ENTRY         FreeList[MAX_POOL_LIST];
   LIST_ENTRY         Link;
+  LIST_ENTRY         PageRunList[POOL_PAGE_RUN_MAX_PAGES]; // MU_CHANGE
+  UINTN              CachedPages;                          // MU_CHANGE
 } POOL;
 
 //
@@ -82,6 +102,11 @@ POOL  mPoolHead[EfiMaxMemoryType];
 //
 LIST_ENTRY  mPoolHeadList = INITIALIZE_LIST_HEAD_VARIABLE (mPoolHeadList);
 
+//
+// Pool allocator statistics reported through the memory profile.
+//
+STATIC MEMORY_PROFILE_POOL_STATISTICS  mPoolStatistics; // MU_CHANGE
+
 /**
   Get pool size table index from the specified size.
 
@@ -126,9 +151,148 @@ CoreInitializePool (
     for (Index = 0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&mPoolHead[Type].FreeList[Index]);
     }
+
+    // MU_CHANGE [BEGIN] - Pool page-run cache
+    mPoolHead[Type].CachedPages = 0;
+    for (Index = 0; Index < POOL_PAGE_RUN_MAX_PAGES; Index++) {
+      InitializeListHead (&mPoolHead[Type].PageRunList[Index]);
+    }
+
+    // MU_CHANGE [END]
+  }
+}
+
+// MU_CHANGE [BEGIN] - Pool page-run cache
+
+/**
+  Check if a run of pool pages can be kept in, or taken from, the page-run
+  cache of a pool.
+
+  OS and OEM memory types are not cached, because their pool head is freed
+  as soon as the last allocation of that type is freed.
+
+  @param  Pool                   The pool the run belongs to.
+  @param  NoPages                The number of pages in the run.
+
+  @retval TRUE                   The run can be cached.
+  @retval FALSE                  The run must go through the page allocator.
+
+**/
+STATIC
+BOOLEAN
+IsPageRunCacheable (
+  IN POOL   *Pool,
+  IN UINTN  NoPages
+  )
+{
+  return (PcdGet32 (PcdDxePoolPageRunCacheMaxPages) != 0) &&
+         ((UINT32)Pool->MemoryType < EfiMaxMemoryType) &&
+         (NoPages > 0) &&
+         (NoPages <= POOL_PAGE_RUN_MAX_PAGES);
+}
+
+/**
+  Take a run of pages of the requested length from the page-run cache.
+  Caller must have the pool lock held.
+
+  @param  Pool                   The pool to take the run from.
+  @param  NoPages                The number of pages in the run.
+
+  @return The cached run, or NULL if no run of that length is cached.
+
+**/
+STATIC
+VOID *
+CoreRemoveCachedPageRun (
+  IN POOL   *Pool,
+  IN UINTN  NoPages
+  )
+{
+  POOL_PAGE_RUN  *Run;
+
+  if (!IsPageRunCacheable (Pool, NoPages)) {
+    return NULL;
+  }
+
+  if (IsListEmpty (&Pool->PageRunList[NoPages - 1])) {
+    mPoolStatistics.PageRunCacheMisses++;
+    return NULL;
+  }
+
+  Run = CR (Pool->PageRunList[NoPages - 1].ForwardLink, POOL_PAGE_RUN, Link, POOL_PAGE_RUN_SIGNATURE);
+  ASSERT (Run->NoPages == NoPages);
+  RemoveEntryList (&Run->Link);
+
+  Pool->CachedPages                   -= NoPages;
+  mPoolStatistics.PageRunCachedPages -= NoPages;
+  mPoolStatistics.PageRunCacheHits++;
+
+  return Run;
+}
+
+/**
+  Keep a freed run of pool pages in the page-run cache, if there is room.
+  Caller must have the pool lock held.
+
+  @param  Pool                   The pool the run belongs to.
+  @param  Buffer                 The base address of the run.
+  @param  NoPages                The number of pages in the run.
+
+  @retval TRUE                   The run was cached and must not be freed.
+  @retval FALSE                  The run must be returned to the page allocator.
+
+**/
+STATIC
+BOOLEAN
+CoreInsertCachedPageRun (
+  IN POOL   *Pool,
+  IN VOID   *Buffer,
+  IN UINTN  NoPages
+  )
+{
+  POOL_PAGE_RUN  *Run;
+
+  if (!IsPageRunCacheable (Pool, NoPages) ||
+      (Pool->CachedPages + NoPages > PcdGet32 (PcdDxePoolPageRunCacheMaxPages)))
+  {
+    return FALSE;
   }
+
+  Run            = (POOL_PAGE_RUN *)Buffer;
+  Run->Signature = POOL_PAGE_RUN_SIGNATURE;
+  Run->NoPages   = (UINT32)NoPages;
+  InsertHeadList (&Pool->PageRunList[NoPages - 1], &Run->Link);
+
+  Pool->CachedPages                   += NoPages;
+  mPoolStatistics.PageRunCachedPages += NoPages;
+
+  return TRUE;
+}
+
+/**
+  Get a snapshot of the pool allocator statistics.
+
+  @param  Statistics             Returns the statistics, including the memory
+                                 profile record header.
+
+**/
+VOID
+CoreGetPoolStatistics (
+  OUT MEMORY_PROFILE_POOL_STATISTICS  *Statistics
+  )
+{
+  CoreAcquireLock (&mPoolMemoryLock);
+  CopyMem (Statistics, &mPoolStatistics, sizeof (MEMORY_PROFILE_POOL_STATISTICS));
+  CoreReleaseLock (&mPoolMemoryLock);
+
+  Statistics->Header.Signature    = MEMORY_PROFILE_POOL_STATISTICS_SIGNATURE;
+  Statistics->Header.Length       = sizeof (MEMORY_PROFILE_POOL_STATISTICS);
+  Statistics->Header.Revision     = MEMORY_PROFILE_POOL_STATISTICS_REVISION;
+  Statistics->PageRunCacheEnabled = (BOOLEAN)(PcdGet32 (PcdDxePoolPageRunCacheMaxPages) != 0);
 }
 
+// MU_CHANGE [END]
+
 /**
   Look up pool head for specified memory type.
 
@@ -175,6 +339,14 @@ LookupPoolHead (
       InitializeListHead (&Pool->FreeList[Index]);
     }
 
+    // MU_CHANGE [BEGIN] - Pool page-run cache
+    Pool->CachedPages = 0;
+    for (Index = 0; Index < POOL_PAGE_RUN_MAX_PAGES; Index++) {
+      InitializeListHead (&Pool->PageRunList[Index]);
+    }
+
+    // MU_CHANGE [END]
+
     InsertHeadList (&mPoolHeadList, &Pool->Link);
 
     return Pool;
@@ -321,6 +493,7 @@ CoreAllocatePoolPagesI (
   CoreReleaseMemoryLock ();
 
   if (Buffer != NULL) {
+    mPoolStatistics.PageAllocations++; // MU_CHANGE
     if (NeedGuard) {
       SetGuardForMemory ((EFI_PHYSICAL_ADDRESS)(UINTN)Buffer, NoPages);
     }
@@ -367,9 +540,13 @@ CoreAllocatePoolI (
   UINTN      Granularity;
   BOOLEAN    HasPoolTail;
   BOOLEAN    PageAsPool;
+  UINTN      RequestedSize; // MU_CHANGE
+  UINTN      ReservedSize;  // MU_CHANGE
 
   ASSERT_LOCKED (&mPoolMemoryLock);
 
+  RequestedSize = Size; // MU_CHANGE
+
   if ((PoolType == EfiReservedMemoryType) ||
       (PoolType == EfiACPIMemoryNVS) ||
       (PoolType == EfiRuntimeServicesCode) ||
@@ -428,7 +605,17 @@ CoreAllocatePoolI (
 
     NoPages  = EFI_SIZE_TO_PAGES (Size) + EFI_SIZE_TO_PAGES (Granularity) - 1;
     NoPages &= ~(UINTN)(EFI_SIZE_TO_PAGES (Granularity) - 1);
-    Head     = CoreAllocatePoolPagesI (PoolType, NoPages, Granularity, NeedGuard);
+    // MU_CHANGE [BEGIN] - Pool page-run cache
+    ReservedSize = EFI_PAGES_TO_SIZE (NoPages);
+    if (!NeedGuard && !PageAsPool) {
+      Head = CoreRemoveCachedPageRun (Pool, NoPages);
+    }
+
+    if (Head == NULL) {
+      Head = CoreAllocatePoolPagesI (PoolType, NoPages, Granularity, NeedGuard);
+    }
+
+    // MU_CHANGE [END]
     // MU_CHANGE Start - CodeQL Change
     if (Head == NULL) {
       return NULL;
@@ -442,6 +629,8 @@ CoreAllocatePoolI (
     goto Done;
   }
 
+  ReservedSize = LIST_TO_SIZE (Index); // MU_CHANGE
+
   //
   // If there's no free pool in the proper list size, go get some more pages
   //
@@ -465,12 +654,18 @@ CoreAllocatePoolI (
     //
     // Get another page
     //
-    NewPage = CoreAllocatePoolPagesI (
-                PoolType,
-                EFI_SIZE_TO_PAGES (Granularity),
-                Granularity,
-                NeedGuard
-                );
+    // MU_CHANGE [BEGIN] - Pool page-run cache
+    NewPage = CoreRemoveCachedPageRun (Pool, EFI_SIZE_TO_PAGES (Granularity));
+    if (NewPage == NULL) {
+      NewPage = CoreAllocatePoolPagesI (
+                  PoolType,
+                  EFI_SIZE_TO_PAGES (Granularity),
+                  Granularity,
+                  NeedGuard
+                  );
+    }
+
+    // MU_CHANGE [END]
     if (NewPage == NULL) {
       goto Done;
     }
@@ -521,6 +716,12 @@ Done:
     //
     Pool->Used += Size;
 
+    // MU_CHANGE [BEGIN] - Pool allocator statistics
+    mPoolStatistics.AllocateCount++;
+    mPoolStatistics.RequestedBytes += RequestedSize;
+    mPoolStatistics.ReservedBytes  += ReservedSize;
+    // MU_CHANGE [END]
+
     //
     // If we have a pool buffer, fill in the header & tail info
     //
@@ -639,6 +840,8 @@ CoreFreePoolPagesI (
   CoreFreePoolPages (Memory, NoPages);
   CoreReleaseMemoryLock ();
 
+  mPoolStatistics.PageFrees++; // MU_CHANGE
+
   GuardFreedPagesChecked (Memory, NoPages);
   ApplyMemoryProtectionPolicy (
     PoolType,
@@ -773,6 +976,7 @@ CoreFreePoolI (
   }
 
   Pool->Used -= Size;
+  mPoolStatistics.FreeCount++; // MU_CHANGE
   DEBUG ((DEBUG_POOL, "FreePool: %p (len %lx) %,ld\n", Head->Data, (UINT64)(Head->Size - POOL_OVERHEAD), (UINT64)Pool->Used));
 
   if ((Head->Type == EfiReservedMemoryType) ||
@@ -811,7 +1015,8 @@ CoreFreePoolI (
         (EFI_PHYSICAL_ADDRESS)(UINTN)Head,
         NoPages
         );
-    } else {
+    } else if (PageAsPool || !CoreInsertCachedPageRun (Pool, Head, NoPages)) {
+      // MU_CHANGE - Keep the run in the page-run cache when there is room
       CoreFreePoolPagesI (
         Pool->MemoryType,
         (EFI_PHYSICAL_ADDRESS)(UINTN)Head,
@@ -870,11 +1075,16 @@ CoreFreePoolI (
         //
         // Free the page
         //
-        CoreFreePoolPagesI (
-          Pool->MemoryType,
-          (EFI_PHYSICAL_ADDRESS)(UINTN)NewPage,
-          EFI_SIZE_TO_PAGES (Granularity)
-          );
+        // MU_CHANGE [BEGIN] - Pool page-run cache
+        if (!CoreInsertCachedPageRun (Pool, NewPage, EFI_SIZE_TO_PAGES (Granularity))) {
+          CoreFreePoolPagesI (
+            Pool->MemoryType,
+            (EFI_PHYSICAL_ADDRESS)(UINTN)NewPage,
+            EFI_SIZE_TO_PAGES (Granularity)
+            );
+        }
+
+        // MU_CHANGE [END]
       }
     }
   }
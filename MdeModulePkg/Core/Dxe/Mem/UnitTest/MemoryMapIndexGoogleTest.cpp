@@ -0,0 +1,507 @@
+/** @file
+  Host based unit tests for the DXE core memory map index.
+
+  The tests replay a synthetic allocation trace that fragments a memory map
+  into thousands of descriptors, the way heap guard and memory protection do,
+  and check every index lookup against a linear walk of the same descriptors,
+  which is what the DXE core did before the index existed.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/GoogleTestLib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+extern "C" {
+  #include <Uefi.h>
+  #include <Guid/MemoryProfile.h>
+  #include <Library/BaseLib.h>
+  #include <Library/DebugLib.h>
+  #include <Library/UefiLib.h>
+  #include "../Imem.h"
+}
+
+using namespace testing;
+
+#define TEST_MEMORY_BASE    0x100000ULL
+#define TEST_MEMORY_SIZE    SIZE_1GB
+#define TEST_TRACE_LENGTH   40000
+#define TEST_CHECK_INTERVAL 1000
+
+///
+/// A page allocation request, as seen by CoreFindFreePagesI().
+///
+typedef struct {
+  UINT64    MaxAddress;
+  UINT64    MinAddress;
+  UINT64    NumberOfBytes;
+  UINTN     Alignment;
+  UINT64    Target;
+} TEST_REQUEST;
+
+/**
+  Same placement rules as FreePagesFilter() in Page.c, without heap guard.
+**/
+STATIC
+BOOLEAN
+TestFreePagesFilter (
+  IN MEMORY_MAP  *Entry,
+  IN VOID        *Context
+  )
+{
+  TEST_REQUEST  *Request;
+  UINT64        DescEnd;
+
+  Request = (TEST_REQUEST *)Context;
+  DescEnd = MIN (Entry->End, Request->MaxAddress);
+  DescEnd = ((DescEnd + 1) & ~((UINT64)Request->Alignment - 1)) - 1;
+  if ((DescEnd < Entry->Start) ||
+      (DescEnd - Entry->Start + 1 < Request->NumberOfBytes) ||
+      (DescEnd - Request->NumberOfBytes + 1 < Request->MinAddress))
+  {
+    return FALSE;
+  }
+
+  Request->Target = DescEnd;
+  return TRUE;
+}
+
+///
+/// A memory map backed by the index, plus the unordered list of descriptors
+/// the DXE core used to walk.
+///
+class MemoryMapIndexTest : public Test {
+protected:
+  MEMORY_MAP_INDEX                           Index;
+  std::vector<std::unique_ptr<MEMORY_MAP> >  Storage;
+  std::vector<MEMORY_MAP *>                  Descriptors;
+
+  void
+  SetUp (
+    ) override
+  {
+    Index.Root  = NULL;
+    Index.Count = 0;
+  }
+
+  MEMORY_MAP *
+  NewEntry (
+    EFI_MEMORY_TYPE  Type,
+    UINT64           Start,
+    UINT64           End
+    )
+  {
+    Storage.emplace_back (new MEMORY_MAP ());
+    MEMORY_MAP  *Entry = Storage.back ().get ();
+
+    Entry->Signature = MEMORY_MAP_SIGNATURE;
+    Entry->Type      = Type;
+    Entry->Start     = Start;
+    Entry->End       = End;
+    MemoryMapIndexInsert (&Index, Entry);
+    Descriptors.push_back (Entry);
+    return Entry;
+  }
+
+  void
+  DeleteEntry (
+    MEMORY_MAP  *Entry
+    )
+  {
+    MemoryMapIndexRemove (&Index, Entry);
+    Descriptors.erase (std::find (Descriptors.begin (), Descriptors.end (), Entry));
+  }
+
+  //
+  // Mirrors CoreAddRange(): merge with same-type neighbors, then add.
+  //
+  void
+  AddRange (
+    EFI_MEMORY_TYPE  Type,
+    UINT64           Start,
+    UINT64           End
+    )
+  {
+    MEMORY_MAP  *Entry;
+
+    Entry = MemoryMapIndexFind (&Index, Start - 1);
+    if ((Entry != NULL) && (Entry->Type == Type)) {
+      Start = Entry->Start;
+      DeleteEntry (Entry);
+    }
+
+    Entry = MemoryMapIndexFind (&Index, End + 1);
+    if ((Entry != NULL) && (Entry->Type == Type)) {
+      End = Entry->End;
+      DeleteEntry (Entry);
+    }
+
+    NewEntry (Type, Start, End);
+  }
+
+  //
+  // Mirrors CoreConvertPagesEx() for a range covered by one descriptor.
+  //
+  void
+  ConvertRange (
+    UINT64           Start,
+    UINT64           NumberOfBytes,
+    EFI_MEMORY_TYPE  NewType
+    )
+  {
+    UINT64      End;
+    MEMORY_MAP  *Entry;
+
+    End   = Start + NumberOfBytes - 1;
+    Entry = MemoryMapIndexFind (&Index, Start);
+    ASSERT_NE (Entry, nullptr);
+    ASSERT_GE (Entry->End, End);
+    ASSERT_NE (Entry->Type, NewType);
+
+    if ((Entry->Start == Start) && (Entry->End == End)) {
+      DeleteEntry (Entry);
+    } else if (Entry->Start == Start) {
+      Entry->Start = End + 1;
+      MemoryMapIndexUpdate (Entry);
+    } else if (Entry->End == End) {
+      Entry->End = Start - 1;
+      MemoryMapIndexUpdate (Entry);
+    } else {
+      UINT64  TailEnd = Entry->End;
+
+      Entry->End = Start - 1;
+      MemoryMapIndexUpdate (Entry);
+      NewEntry (Entry->Type, End + 1, TailEnd);
+    }
+
+    AddRange (NewType, Start, End);
+  }
+
+  //
+  // The descriptor search CoreFindFreePagesI() did before the index.
+  //
+  UINT64
+  LinearFindFreePages (
+    TEST_REQUEST  *Request
+    )
+  {
+    UINT64  Target;
+
+    Target = 0;
+    for (MEMORY_MAP *Entry : Descriptors) {
+      if ((Entry->Type != EfiConventionalMemory) ||
+          (Entry->Start >= Request->MaxAddress) ||
+          (Entry->End < Request->MinAddress))
+      {
+        continue;
+      }
+
+      if (TestFreePagesFilter (Entry, Request) && (Request->Target > Target)) {
+        Target = Request->Target;
+      }
+    }
+
+    return Target;
+  }
+
+  UINT64
+  IndexFindFreePages (
+    TEST_REQUEST  *Request
+    )
+  {
+    if (MemoryMapIndexFindFree (
+          &Index,
+          Request->MaxAddress,
+          Request->MinAddress,
+          Request->NumberOfBytes,
+          TestFreePagesFilter,
+          Request
+          ) == NULL)
+    {
+      return 0;
+    }
+
+    return Request->Target;
+  }
+
+  MEMORY_MAP *
+  LinearFind (
+    UINT64  Address
+    )
+  {
+    for (MEMORY_MAP *Entry : Descriptors) {
+      if ((Entry->Start <= Address) && (Entry->End >= Address)) {
+        return Entry;
+      }
+    }
+
+    return NULL;
+  }
+
+  //
+  // Check ordering, parent links, balance and free lengths of a subtree.
+  // Returns the height of the subtree.
+  //
+  UINTN
+  CheckSubtree (
+    MEMORY_MAP_INDEX_NODE  *Node,
+    MEMORY_MAP_INDEX_NODE  *Parent,
+    UINT64                 *MaxFreeLength
+    )
+  {
+    UINT64  LeftFree;
+    UINT64  RightFree;
+    UINTN   LeftHeight;
+    UINTN   RightHeight;
+
+    *MaxFreeLength = 0;
+    if (Node == NULL) {
+      return 0;
+    }
+
+    MEMORY_MAP  *Entry = BASE_CR (Node, MEMORY_MAP, IndexNode);
+
+    EXPECT_EQ (Node->Parent, Parent);
+    if (Node->Left != NULL) {
+      EXPECT_LT (BASE_CR (Node->Left, MEMORY_MAP, IndexNode)->End, Entry->Start);
+    }
+
+    if (Node->Right != NULL) {
+      EXPECT_GT (BASE_CR (Node->Right, MEMORY_MAP, IndexNode)->Start, Entry->End);
+    }
+
+    LeftHeight  = CheckSubtree (Node->Left, Node, &LeftFree);
+    RightHeight = CheckSubtree (Node->Right, Node, &RightFree);
+    EXPECT_LE (MAX (LeftHeight, RightHeight) - MIN (LeftHeight, RightHeight), 1u);
+    EXPECT_EQ (Node->Height, 1 + MAX (LeftHeight, RightHeight));
+
+    *MaxFreeLength = MAX (LeftFree, RightFree);
+    if (Entry->Type == EfiConventionalMemory) {
+      *MaxFreeLength = MAX (*MaxFreeLength, Entry->End - Entry->Start + 1);
+    }
+
+    EXPECT_EQ (Node->MaxFreeLength, *MaxFreeLength);
+    return Node->Height;
+  }
+
+  void
+  CheckTree (
+    )
+  {
+    UINT64  MaxFreeLength;
+
+    CheckSubtree (Index.Root, NULL, &MaxFreeLength);
+    EXPECT_EQ (Index.Count, Descriptors.size ());
+  }
+
+  //
+  // Also check that the map is contiguous and fully merged, as it is after
+  // every step of the trace replay.
+  //
+  void
+  CheckIndex (
+    )
+  {
+    UINTN       Count;
+    MEMORY_MAP  *Previous;
+
+    CheckTree ();
+
+    Count    = 0;
+    Previous = NULL;
+    for (MEMORY_MAP *Entry = MemoryMapIndexFirst (&Index); Entry != NULL; Entry = MemoryMapIndexNext (Entry)) {
+      if (Previous != NULL) {
+        EXPECT_EQ (Previous->End + 1, Entry->Start);
+        EXPECT_NE (Previous->Type, Entry->Type);
+      }
+
+      Previous = Entry;
+      Count++;
+    }
+
+    EXPECT_EQ (Count, Descriptors.size ());
+  }
+};
+
+// Lookups by address find the covering descriptor, and nothing outside the map.
+TEST_F (MemoryMapIndexTest, FindCoveringDescriptor) {
+  NewEntry (EfiConventionalMemory, 0x1000, 0x4FFF);
+  NewEntry (EfiBootServicesData, 0x5000, 0x5FFF);
+  NewEntry (EfiConventionalMemory, 0x8000, 0x9FFF);
+
+  EXPECT_EQ (MemoryMapIndexFind (&Index, 0x0), nullptr);
+  EXPECT_EQ (MemoryMapIndexFind (&Index, 0x1000)->Start, 0x1000u);
+  EXPECT_EQ (MemoryMapIndexFind (&Index, 0x4FFF)->Start, 0x1000u);
+  EXPECT_EQ (MemoryMapIndexFind (&Index, 0x5000)->Type, EfiBootServicesData);
+  EXPECT_EQ (MemoryMapIndexFind (&Index, 0x6000), nullptr);
+  EXPECT_EQ (MemoryMapIndexFind (&Index, 0x9000)->Start, 0x8000u);
+  EXPECT_EQ (MemoryMapIndexFind (&Index, 0xA000), nullptr);
+}
+
+// The free range search returns the highest fit, honoring the address limits.
+TEST_F (MemoryMapIndexTest, FindFreeReturnsHighestFit) {
+  TEST_REQUEST  Request;
+
+  NewEntry (EfiConventionalMemory, 0x100000, 0x1FFFFF);
+  NewEntry (EfiBootServicesData, 0x200000, 0x2FFFFF);
+  NewEntry (EfiConventionalMemory, 0x300000, 0x300FFF);
+  NewEntry (EfiConventionalMemory, 0x400000, 0x4FFFFF);
+  NewEntry (EfiLoaderData, 0x500000, 0x5FFFFF);
+
+  Request = { MAX_UINT64, 0, EFI_PAGE_SIZE, EFI_PAGE_SIZE, 0 };
+  EXPECT_EQ (IndexFindFreePages (&Request), 0x4FFFFFu);
+
+  Request = { 0x3FFFFF, 0, EFI_PAGE_SIZE, EFI_PAGE_SIZE, 0 };
+  EXPECT_EQ (IndexFindFreePages (&Request), 0x300FFFu);
+
+  Request = { 0x3FFFFF, 0, 2 * EFI_PAGE_SIZE, EFI_PAGE_SIZE, 0 };
+  EXPECT_EQ (IndexFindFreePages (&Request), 0x1FFFFFu);
+
+  Request = { MAX_UINT64, 0x500000, EFI_PAGE_SIZE, EFI_PAGE_SIZE, 0 };
+  EXPECT_EQ (IndexFindFreePages (&Request), 0u);
+
+  Request = { MAX_UINT64, 0, SIZE_2MB, EFI_PAGE_SIZE, 0 };
+  EXPECT_EQ (IndexFindFreePages (&Request), 0u);
+}
+
+// Removing every descriptor, in an order unrelated to insertion, keeps the tree valid.
+TEST_F (MemoryMapIndexTest, InsertAndRemoveKeepBalance) {
+  std::vector<MEMORY_MAP *>  Entries;
+
+  for (UINT64 Page = 0; Page < 4096; Page++) {
+    Entries.push_back (
+              NewEntry (
+                (Page % 2 == 0) ? EfiConventionalMemory : EfiBootServicesData,
+                Page * EFI_PAGE_SIZE,
+                (Page + 1) * EFI_PAGE_SIZE - 1
+                )
+              );
+  }
+
+  CheckTree ();
+  EXPECT_LE (Index.Root->Height, 13u);
+
+  for (UINTN Step = 0; Step < Entries.size (); Step++) {
+    DeleteEntry (Entries[(Step * 1237) % Entries.size ()]);
+    if (Step % 256 == 0) {
+      CheckTree ();
+    }
+  }
+
+  EXPECT_EQ (Index.Root, nullptr);
+  EXPECT_EQ (Index.Count, 0u);
+}
+
+// Replay an allocate/free trace and compare every lookup against the linear walk.
+TEST_F (MemoryMapIndexTest, ReplayTraceMatchesLinearWalk) {
+  struct Allocation {
+    UINT64             Start;
+    UINT64             NumberOfBytes;
+    EFI_MEMORY_TYPE    Type;
+  };
+
+  static CONST EFI_MEMORY_TYPE  Types[] = { EfiBootServicesData, EfiBootServicesCode, EfiLoaderData, EfiRuntimeServicesData };
+  std::vector<Allocation>       Allocations;
+  std::chrono::nanoseconds      LinearTime (0);
+  std::chrono::nanoseconds      IndexTime (0);
+  UINT32                        Seed;
+  UINTN                         Lookups;
+
+  NewEntry (EfiConventionalMemory, TEST_MEMORY_BASE, TEST_MEMORY_BASE + TEST_MEMORY_SIZE - 1);
+
+  Seed    = 0x4D4D4150;
+  Lookups = 0;
+  for (UINTN Step = 0; Step < TEST_TRACE_LENGTH; Step++) {
+    Seed = Seed * 1103515245 + 12345;
+    if (((Seed >> 16) % 10 < 7) || Allocations.empty ()) {
+      TEST_REQUEST  LinearRequest;
+      TEST_REQUEST  IndexRequest;
+      UINT64        LinearTarget;
+      UINT64        IndexTarget;
+
+      LinearRequest.NumberOfBytes = EFI_PAGES_TO_SIZE (1 + (Seed >> 8) % 16);
+      LinearRequest.Alignment     = ((Seed >> 4) % 8 == 0) ? SIZE_64KB : EFI_PAGE_SIZE;
+      LinearRequest.MaxAddress    = ((Seed >> 12) % 4 == 0) ? TEST_MEMORY_BASE + TEST_MEMORY_SIZE / 2 - 1 : MAX_UINT64;
+      LinearRequest.MinAddress    = 0;
+      LinearRequest.Target        = 0;
+      IndexRequest                = LinearRequest;
+
+      auto  Start = std::chrono::steady_clock::now ();
+
+      LinearTarget = LinearFindFreePages (&LinearRequest);
+      auto  Middle = std::chrono::steady_clock::now ();
+
+      IndexTarget = IndexFindFreePages (&IndexRequest);
+      auto  End = std::chrono::steady_clock::now ();
+
+      LinearTime += Middle - Start;
+      IndexTime  += End - Middle;
+      Lookups++;
+
+      ASSERT_EQ (IndexTarget, LinearTarget);
+      if (IndexTarget == 0) {
+        continue;
+      }
+
+      Allocation  New = {
+        IndexTarget - LinearRequest.NumberOfBytes + 1,
+        LinearRequest.NumberOfBytes,
+        Types[(Seed >> 20) % ARRAY_SIZE (Types)]
+      };
+
+      ConvertRange (New.Start, New.NumberOfBytes, New.Type);
+      Allocations.push_back (New);
+    } else {
+      UINTN       Victim;
+      UINT64      Address;
+      MEMORY_MAP  *LinearEntry;
+      MEMORY_MAP  *IndexEntry;
+
+      Victim  = (Seed >> 8) % Allocations.size ();
+      Address = Allocations[Victim].Start;
+
+      auto  Start = std::chrono::steady_clock::now ();
+
+      LinearEntry = LinearFind (Address);
+      auto  Middle = std::chrono::steady_clock::now ();
+
+      IndexEntry = MemoryMapIndexFind (&Index, Address);
+      auto  End = std::chrono::steady_clock::now ();
+
+      LinearTime += Middle - Start;
+      IndexTime  += End - Middle;
+      Lookups++;
+
+      ASSERT_EQ (IndexEntry, LinearEntry);
+      ConvertRange (Address, Allocations[Victim].NumberOfBytes, EfiConventionalMemory);
+      Allocations[Victim] = Allocations.back ();
+      Allocations.pop_back ();
+    }
+
+    if (Step % TEST_CHECK_INTERVAL == 0) {
+      CheckIndex ();
+    }
+  }
+
+  CheckIndex ();
+
+  RecordProperty ("Descriptors", (int)Descriptors.size ());
+  RecordProperty ("Lookups", (int)Lookups);
+  RecordProperty ("LinearLookupsPerSecond", (int)(Lookups * 1000000000ULL / MAX (LinearTime.count (), 1)));
+  RecordProperty ("IndexLookupsPerSecond", (int)(Lookups * 1000000000ULL / MAX (IndexTime.count (), 1)));
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
@@ -592,11 +592,13 @@ CustomGuidedSectionExtract (
   UINT32      ScratchBufferSize;
   UINT32      OutputBufferSize;
   UINT16      SectionAttribute;
+  VOID        *AllocatedOutputBuffer;   // MU_CHANGE
 
   //
   // Init local variable
   //
-  ScratchBuffer = NULL;
+  ScratchBuffer         = NULL;
+  AllocatedOutputBuffer = NULL;         // MU_CHANGE
 
   //
   // Call GetInfo to get the size and attribute of input guided section data.
@@ -633,6 +635,7 @@ CustomGuidedSectionExtract (
     }
 
     DEBUG ((DEBUG_INFO, "Customized Guided section Memory Size required is 0x%x and address is 0x%p\n", OutputBufferSize, *OutputBuffer));
+    AllocatedOutputBuffer = *OutputBuffer;  // MU_CHANGE
   }
 
   Status = ExtractGuidedSectionDecode (
@@ -649,6 +652,13 @@ CustomGuidedSectionExtract (
     return Status;
   }
 
+  // MU_CHANGE [BEGIN] - Release the output buffer when the handler returns its own buffer in place.
+  if ((AllocatedOutputBuffer != NULL) && (*OutputBuffer != AllocatedOutputBuffer)) {
+    FreePages (AllocatedOutputBuffer, EFI_SIZE_TO_PAGES (OutputBufferSize));
+  }
+
+  // MU_CHANGE [END]
+
   *OutputSize = (UINTN)OutputBufferSize;
 
   return EFI_SUCCESS;
@@ -179,6 +179,36 @@ typedef struct {
   // MEMORY_PROFILE_DESCRIPTOR     MemoryDescriptor[MemoryRangeCount];
 } MEMORY_PROFILE_MEMORY_RANGE;
 
+// MU_CHANGE [BEGIN] - Pool allocator statistics
+#define MEMORY_PROFILE_POOL_STATISTICS_SIGNATURE  SIGNATURE_32 ('M','P','P','S')
+#define MEMORY_PROFILE_POOL_STATISTICS_REVISION   0x0001
+
+///
+/// DXE core pool allocator statistics, appended after the last ALLOC_INFO of
+/// the UEFI memory profile when the pool page-run cache is enabled
+/// (PcdDxePoolPageRunCacheMaxPages is not zero), so PageRunCacheEnabled is
+/// always TRUE in a record found in a profile. Consumers should find the
+/// record by its signature. All counters are cumulative since the DXE core
+/// started, so the waste of a pool configuration is
+/// (ReservedBytes - RequestedBytes) and its cost in calls to the page
+/// allocator is PageAllocations + PageFrees.
+///
+typedef struct {
+  MEMORY_PROFILE_COMMON_HEADER    Header;
+  BOOLEAN                         PageRunCacheEnabled;
+  UINT8                           Reserved[7];
+  UINT64                          AllocateCount;
+  UINT64                          FreeCount;
+  UINT64                          RequestedBytes;
+  UINT64                          ReservedBytes;
+  UINT64                          PageAllocations;
+  UINT64                          PageFrees;
+  UINT64                          PageRunCacheHits;
+  UINT64                          PageRunCacheMisses;
+  UINT64                          PageRunCachedPages;
+} MEMORY_PROFILE_POOL_STATISTICS;
+// MU_CHANGE [END]
+
 //
 // UEFI memory profile layout:
 // +--------------------------------+
@@ -198,6 +228,13 @@ typedef struct {
 // +--------------------------------+
 //
 
+// MU_CHANGE [BEGIN] - Pool allocator statistics
+//
+// When the DXE core pool page-run cache is enabled, the DXE core profile
+// ends with a POOL_STATISTICS record after ALLOC_INFO(n, mn).
+//
+// MU_CHANGE [END]
+
 typedef struct _EDKII_MEMORY_PROFILE_PROTOCOL EDKII_MEMORY_PROFILE_PROTOCOL;
 
 /**
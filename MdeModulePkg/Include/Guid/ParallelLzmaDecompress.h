@@ -27,10 +27,42 @@ extern GUID  gParallelLzmaCustomDecompressGuid;
 
 extern GUID  gParallelLzmaCustomDecompressHobGuid;
 
+///
+/// Describes one section that has already been decompressed. SourceBuffer is
+/// the start of the compressed data inside the GUIDed section, which is what
+/// the extraction handler uses to match a section to its HOB. These HOBs are
+/// produced by a platform PEIM such as UefiCpuPkg/ParallelLzmaDecompressPei.
+///
 typedef struct {
   VOID     *SourceBuffer;
   VOID     *DecompressedBuffer;
   UINTN    DecompressedSize;
 } PARALLEL_DECOMPRESSED_BUFFER;
 
+#define PARALLEL_LZMA_CUSTOM_DECOMPRESS_INDEX_HOB_GUID \
+  { 0x54a9a0b2, 0x3672, 0x4769, { 0xae, 0x36, 0x77, 0x75, 0xf1, 0x41, 0xf3, 0x39 } }
+
+extern GUID  gParallelLzmaCustomDecompressIndexHobGuid;
+
+///
+/// Open addressed hash index of the decompressed sections, keyed by
+/// SourceBuffer. The producer of the gParallelLzmaCustomDecompressHobGuid HOBs
+/// publishes it once, after the last of them. BucketCount is a power of two
+/// and at least twice EntryCount, so a probe sequence always reaches an empty
+/// bucket, which has a NULL SourceBuffer.
+///
+typedef struct {
+  UINT32                          BucketCount;
+  UINT32                          EntryCount;
+  PARALLEL_DECOMPRESSED_BUFFER    Buckets[1];
+} PARALLEL_DECOMPRESSED_BUFFER_INDEX;
+
+///
+/// The bucket to start probing from for a SourceBuffer. Section data is at
+/// least 4 byte aligned, so the low bits are dropped before a multiplicative
+/// hash.
+///
+#define PARALLEL_DECOMPRESSED_BUFFER_HASH(SourceBuffer, BucketCount) \
+  ((UINT32)(((UINTN)(SourceBuffer) >> 2) * 0x9E3779B1) & ((BucketCount) - 1))
+
 #endif
@@ -77,6 +77,12 @@ typedef struct {
 // The payload for this function is SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO
 //
 #define SMM_VARIABLE_FUNCTION_GET_RUNTIME_CACHE_INFO  14
+// MU_CHANGE [BEGIN] - Batched SetVariable
+//
+// The payload for this function is SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH.
+//
+#define SMM_VARIABLE_FUNCTION_SET_VARIABLE_BATCH  15
+// MU_CHANGE [END]
 
 ///
 /// Size of SMM communicate header, without including the payload.
@@ -140,6 +146,18 @@ typedef struct {
   VARIABLE_STORE_HEADER    *RuntimeVolatileCache;
 } SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT;
 
+// MU_CHANGE [BEGIN] - Batched SetVariable
+///
+/// This structure is used to communicate with SMI handler by a batch of SetVariable.
+/// It is followed by VariableCount SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE
+/// records, each one starting at an offset aligned to sizeof (UINTN).
+///
+typedef struct {
+  UINTN    VariableCount;
+  UINTN    FailedIndex;     // Return index of the variable that failed, or VariableCount
+} SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH;
+// MU_CHANGE [END]
+
 typedef struct {
   UINTN      TotalHobStorageSize;
   UINTN      TotalNvStorageSize;
@@ -0,0 +1,179 @@
+/** @file
+  Network Offload Protocols let the IPv4 network stack hand the checksums of
+  the IPv4, TCP and UDP headers and the segmentation of large TCP sends to the
+  network interface.
+
+  EFI_SIMPLE_NETWORK_PROTOCOL transmits and receives complete frames, so the
+  stack computes every checksum in software and builds one TCP segment, with
+  its own pass through TCP, IPv4 and MNP, per maximum segment size. An
+  interface that can compute the checksums or segment a large send, in
+  hardware or in its driver, installs EDKII_NETWORK_OFFLOAD_PROTOCOL next to
+  EFI_SIMPLE_NETWORK_PROTOCOL. The Managed Network and IPv4 drivers of
+  NetworkPkg pass the offloads up to their children through the protocols of
+  ManagedNetworkOffload.h and Ip4Offload.h.
+
+  A user only requests the offloads reported in Capabilities and computes
+  everything else itself, so the stack works as before on the interfaces that
+  do not install EDKII_NETWORK_OFFLOAD_PROTOCOL.
+
+  When a transmit requests an offload, the packet is prepared as follows:
+  - EDKII_NETWORK_OFFLOAD_TX_IP4_CHECKSUM: the checksum of the IPv4 header is
+    zero.
+  - EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM and
+    EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM: the checksum field of the TCP or
+    UDP header holds the one's complement sum, not complemented, of the IPv4
+    pseudo-header with a zero length. The interface adds the length and the
+    bytes of the segment, and stores the complement of the sum.
+  - EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND: the TCP payload may be larger
+    than SegmentSize. The interface sends it in segments of SegmentSize bytes,
+    the last one possibly shorter, each with a copy of the IPv4 and TCP headers
+    where the total length and the sequence number are updated and the
+    identification is incremented. Only the last segment keeps the FIN and PSH
+    flags. The IPv4 and TCP checksums are requested too, and computed for each
+    segment.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef NETWORK_OFFLOAD_H_
+#define NETWORK_OFFLOAD_H_
+
+#define EDKII_NETWORK_OFFLOAD_PROTOCOL_GUID \
+  { \
+    0x3a79929d, 0x8dcf, 0x499b, { 0x91, 0xcf, 0x38, 0xdc, 0x4d, 0x07, 0xd9, 0x31 } \
+  }
+
+#define EDKII_NETWORK_OFFLOAD_PROTOCOL_REVISION  0x00010000
+
+///
+/// Transmit offloads.
+///
+#define EDKII_NETWORK_OFFLOAD_TX_IP4_CHECKSUM     BIT0
+#define EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM    BIT1
+#define EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM    BIT2
+#define EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND  BIT3
+
+///
+/// Receive offloads. A received frame carries the flag of a checksum only when
+/// the interface verified that the checksum is correct.
+///
+#define EDKII_NETWORK_OFFLOAD_RX_IP4_CHECKSUM   BIT16
+#define EDKII_NETWORK_OFFLOAD_RX_TCP4_CHECKSUM  BIT17
+#define EDKII_NETWORK_OFFLOAD_RX_UDP4_CHECKSUM  BIT18
+
+#define EDKII_NETWORK_OFFLOAD_TX_MASK  0x0000FFFF
+#define EDKII_NETWORK_OFFLOAD_RX_MASK  0xFFFF0000
+
+typedef struct _EDKII_NETWORK_OFFLOAD_PROTOCOL EDKII_NETWORK_OFFLOAD_PROTOCOL;
+
+///
+/// The offloads requested for a transmitted packet. The offsets are counted
+/// from the first byte of the data passed to the protocol.
+///
+typedef struct {
+  ///
+  /// EDKII_NETWORK_OFFLOAD_TX_* flags.
+  ///
+  UINT32    Flags;
+  ///
+  /// Offset of the IPv4 header.
+  ///
+  UINT16    NetworkOffset;
+  ///
+  /// Offset of the TCP or UDP header.
+  ///
+  UINT16    TransportOffset;
+  ///
+  /// Largest TCP payload of a segment for EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND.
+  ///
+  UINT16    SegmentSize;
+} EDKII_NETWORK_OFFLOAD_TX_INFO;
+
+/**
+  Transmit a frame with offloads.
+
+  The frame is sent, or copied by the driver, before the function returns, so
+  the caller keeps the ownership of Buffer and does not recycle it through
+  EFI_SIMPLE_NETWORK_PROTOCOL.GetStatus().
+
+  @param[in]  This         The EDKII_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in]  TxInfo       The offloads to apply, all reported in Capabilities.
+  @param[in]  BufferSize   The size of the frame, at most MaxLargeSendSize
+                           with EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND, or the
+                           media header size plus the MaxPacketSize of the
+                           EFI_SIMPLE_NETWORK_MODE otherwise.
+  @param[in]  Buffer       The frame, media header included.
+
+  @retval EFI_SUCCESS            The frame was sent.
+  @retval EFI_NOT_STARTED        The network interface is not initialized.
+  @retval EFI_INVALID_PARAMETER  The frame does not match TxInfo or is too large.
+  @retval EFI_UNSUPPORTED        An offload is not supported.
+  @retval EFI_NOT_READY          The interface is too busy to accept the frame.
+  @retval EFI_DEVICE_ERROR       The frame could not be sent.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_NETWORK_OFFLOAD_TRANSMIT)(
+  IN EDKII_NETWORK_OFFLOAD_PROTOCOL       *This,
+  IN CONST EDKII_NETWORK_OFFLOAD_TX_INFO  *TxInfo,
+  IN UINTN                                BufferSize,
+  IN VOID                                 *Buffer
+  );
+
+/**
+  Receive a frame with the checksums verified by the interface.
+
+  It replaces EFI_SIMPLE_NETWORK_PROTOCOL.Receive() for a caller that uses the
+  receive offloads.
+
+  @param[in]       This         The EDKII_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in, out]  BufferSize   On input, the size of Buffer. On output, the
+                                size of the frame received.
+  @param[out]      Buffer       The frame, media header included.
+  @param[out]      Flags        The EDKII_NETWORK_OFFLOAD_RX_* flags of the
+                                checksums verified.
+
+  @retval EFI_SUCCESS            A frame was received.
+  @retval EFI_NOT_STARTED        The network interface is not initialized.
+  @retval EFI_NOT_READY          No frame was received.
+  @retval EFI_BUFFER_TOO_SMALL   BufferSize is too small for the frame.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+  @retval EFI_DEVICE_ERROR       The interface failed.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_NETWORK_OFFLOAD_RECEIVE)(
+  IN     EDKII_NETWORK_OFFLOAD_PROTOCOL  *This,
+  IN OUT UINTN                           *BufferSize,
+  OUT    VOID                            *Buffer,
+  OUT    UINT32                          *Flags
+  );
+
+///
+/// Network Offload Protocol, installed next to EFI_SIMPLE_NETWORK_PROTOCOL.
+///
+struct _EDKII_NETWORK_OFFLOAD_PROTOCOL {
+  UINT64                            Revision;
+  ///
+  /// EDKII_NETWORK_OFFLOAD_TX_* and EDKII_NETWORK_OFFLOAD_RX_* flags of the
+  /// offloads supported by the interface.
+  ///
+  UINT32                            Capabilities;
+  ///
+  /// Largest frame, media header included, of a large send.
+  ///
+  UINT32                            MaxLargeSendSize;
+  EDKII_NETWORK_OFFLOAD_TRANSMIT    Transmit;
+  ///
+  /// NULL when the interface supports no receive offload.
+  ///
+  EDKII_NETWORK_OFFLOAD_RECEIVE     Receive;
+};
+
+extern EFI_GUID  gEdkiiNetworkOffloadProtocolGuid;
+
+#endif
@@ -0,0 +1,167 @@
+/** @file
+  USB Bulk Queue Protocols queue several bulk transfers to the endpoints of a
+  USB device in one request.
+
+  EFI_USB_IO_PROTOCOL and EFI_USB2_HC_PROTOCOL execute one bulk transfer at a
+  time, so the bus idles while the caller handles each completion and sets up
+  the next transfer. A class driver whose transfers follow a fixed sequence,
+  such as the command, data and status phases of the USB mass storage
+  Bulk-Only Transport, queues the whole sequence at once and lets the host
+  controller start each transfer as soon as the previous one on the same
+  endpoint completes.
+
+  A host controller driver that can queue several transfers on an endpoint
+  installs EDKII_USB2_HC_BULK_QUEUE_PROTOCOL on the controller handle, next to
+  EFI_USB2_HC_PROTOCOL. The USB bus driver then installs
+  EDKII_USB_IO_BULK_QUEUE_PROTOCOL next to EFI_USB_IO_PROTOCOL on the handles
+  of the interfaces of the devices of that controller.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef USB_BULK_QUEUE_H_
+#define USB_BULK_QUEUE_H_
+
+#include <Protocol/Usb2HostController.h>
+
+#define EDKII_USB2_HC_BULK_QUEUE_PROTOCOL_GUID \
+  { \
+    0xaac15079, 0x6cd5, 0x4235, { 0xa4, 0x30, 0xef, 0x23, 0xfc, 0xae, 0xb7, 0x7d } \
+  }
+
+#define EDKII_USB_IO_BULK_QUEUE_PROTOCOL_GUID \
+  { \
+    0x56773161, 0x2dbe, 0x40c5, { 0x9d, 0x36, 0xd3, 0xda, 0x71, 0x2e, 0x29, 0x52 } \
+  }
+
+#define EDKII_USB_BULK_QUEUE_PROTOCOL_REVISION  0x00010000
+
+///
+/// Maximum number of transfers queued by one request.
+///
+#define EDKII_USB_BULK_QUEUE_MAX_TRANSFERS  8
+
+typedef struct _EDKII_USB2_HC_BULK_QUEUE_PROTOCOL  EDKII_USB2_HC_BULK_QUEUE_PROTOCOL;
+typedef struct _EDKII_USB_IO_BULK_QUEUE_PROTOCOL   EDKII_USB_IO_BULK_QUEUE_PROTOCOL;
+
+///
+/// One bulk transfer of a queue.
+///
+typedef struct {
+  ///
+  /// Endpoint number with the direction in bit 7.
+  ///
+  UINT8     EndpointAddress;
+  VOID      *Data;
+  ///
+  /// On input, the size in bytes of Data. On output, the number of bytes
+  /// transferred.
+  ///
+  UINTN     DataLength;
+  ///
+  /// Returns the EFI_USB_ERR_* result of the transfer. EFI_USB_ERR_NOTEXECUTE
+  /// if the transfer was not executed because an earlier one failed.
+  ///
+  UINT32    TransferResult;
+} EDKII_USB_BULK_QUEUE_TRANSFER;
+
+/**
+  Queue bulk transfers to the endpoints of a USB device and wait for them.
+
+  The transfers of an endpoint are executed in the order of the array, each
+  one as soon as the previous one completes. The transfers of different
+  endpoints run concurrently, so the caller must only queue transfers whose
+  order across endpoints is enforced by the device, as the phases of a
+  Bulk-Only Transport command are. When a transfer fails or the queue times
+  out, the transfers that did not complete are cancelled.
+
+  @param[in]      This             The EDKII_USB2_HC_BULK_QUEUE_PROTOCOL instance.
+  @param[in]      DeviceAddress    Target device address.
+  @param[in]      DeviceSpeed      Device speed. Low speed devices do not support
+                                   bulk transfers.
+  @param[in]      Count            Number of transfers, at most
+                                   EDKII_USB_BULK_QUEUE_MAX_TRANSFERS.
+  @param[in, out] Transfers        The transfers to queue. The DataLength and
+                                   TransferResult of every transfer are updated.
+  @param[in]      Timeout          Time in milliseconds allowed to complete all
+                                   the transfers, or zero to wait indefinitely.
+  @param[in]      Translator       Transaction translator of the device.
+
+  @retval EFI_SUCCESS            All the transfers completed.
+  @retval EFI_INVALID_PARAMETER  Some parameters are invalid. No transfer was
+                                 queued.
+  @retval EFI_OUT_OF_RESOURCES   The transfers could not be queued.
+  @retval EFI_TIMEOUT            The transfers did not complete in time.
+  @retval EFI_DEVICE_ERROR       A transfer failed, as reported by its
+                                 TransferResult.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_USB2_HC_BULK_QUEUE_TRANSFER)(
+  IN     EDKII_USB2_HC_BULK_QUEUE_PROTOCOL   *This,
+  IN     UINT8                               DeviceAddress,
+  IN     UINT8                               DeviceSpeed,
+  IN     UINTN                               Count,
+  IN OUT EDKII_USB_BULK_QUEUE_TRANSFER       *Transfers,
+  IN     UINTN                               Timeout,
+  IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR  *Translator
+  );
+
+/**
+  Queue bulk transfers to the endpoints of a USB interface and wait for them.
+
+  The transfers are executed as described for
+  EDKII_USB2_HC_BULK_QUEUE_PROTOCOL.BulkTransfer(). A caller falls back to
+  EFI_USB_IO_PROTOCOL.UsbBulkTransfer() when the transfers cannot be queued.
+
+  @param[in]      This       The EDKII_USB_IO_BULK_QUEUE_PROTOCOL instance.
+  @param[in]      Count      Number of transfers, at most
+                             EDKII_USB_BULK_QUEUE_MAX_TRANSFERS.
+  @param[in, out] Transfers  The transfers to queue, to bulk endpoints of the
+                             interface. The DataLength and TransferResult of
+                             every transfer are updated.
+  @param[in]      Timeout    Time in milliseconds allowed to complete all the
+                             transfers, or zero to wait indefinitely.
+
+  @retval EFI_SUCCESS            All the transfers completed.
+  @retval EFI_INVALID_PARAMETER  Some parameters are invalid. No transfer was
+                                 queued.
+  @retval EFI_OUT_OF_RESOURCES   The transfers could not be queued.
+  @retval EFI_TIMEOUT            The transfers did not complete in time.
+  @retval EFI_DEVICE_ERROR       A transfer failed, as reported by its
+                                 TransferResult, or the device is gone.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_USB_IO_BULK_QUEUE_TRANSFER)(
+  IN     EDKII_USB_IO_BULK_QUEUE_PROTOCOL  *This,
+  IN     UINTN                             Count,
+  IN OUT EDKII_USB_BULK_QUEUE_TRANSFER     *Transfers,
+  IN     UINTN                             Timeout
+  );
+
+///
+/// USB2 Host Controller Bulk Queue Protocol queues several bulk transfers to
+/// a device.
+///
+struct _EDKII_USB2_HC_BULK_QUEUE_PROTOCOL {
+  UINT64                               Revision;
+  EDKII_USB2_HC_BULK_QUEUE_TRANSFER    BulkTransfer;
+};
+
+///
+/// USB I/O Bulk Queue Protocol queues several bulk transfers to an interface.
+///
+struct _EDKII_USB_IO_BULK_QUEUE_PROTOCOL {
+  UINT64                              Revision;
+  EDKII_USB_IO_BULK_QUEUE_TRANSFER    BulkTransfer;
+};
+
+extern EFI_GUID  gEdkiiUsb2HcBulkQueueProtocolGuid;
+extern EFI_GUID  gEdkiiUsbIoBulkQueueProtocolGuid;
+
+#endif
@@ -0,0 +1,110 @@
+/** @file
+  Variable Batch Write Protocol is related to EDK II-specific implementation of
+  variables and allows a caller to set several variables in one request to the
+  variable driver.
+
+  When the variable services are implemented in SMM, every SetVariable() call
+  costs an SMI. Writing the variables of a batch through this protocol costs a
+  single SMI for as many variables as fit in the SMM communication buffer.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef VARIABLE_BATCH_WRITE_H_
+#define VARIABLE_BATCH_WRITE_H_
+
+#define EDKII_VARIABLE_BATCH_WRITE_PROTOCOL_GUID \
+  { \
+    0xc9539393, 0x1b62, 0x419e, { 0x8a, 0x3d, 0xd3, 0x9e, 0xfd, 0x1d, 0x47, 0xae } \
+  }
+
+#define EDKII_VARIABLE_BATCH_WRITE_PROTOCOL_REVISION  0x00010000
+
+typedef struct _EDKII_VARIABLE_BATCH_WRITE_PROTOCOL EDKII_VARIABLE_BATCH_WRITE_PROTOCOL;
+
+///
+/// One variable write of a batch. The fields match the parameters of SetVariable().
+///
+typedef struct {
+  CHAR16        *VariableName;
+  EFI_GUID      *VendorGuid;
+  UINT32        Attributes;
+  UINTN         DataSize;
+  VOID          *Data;
+  ///
+  /// Returns the status of the write, or EFI_NOT_STARTED if the batch stopped
+  /// at an earlier entry.
+  ///
+  EFI_STATUS    Status;
+} EDKII_VARIABLE_BATCH_WRITE_ENTRY;
+
+///
+/// Counters of the batches written through the protocol.
+///
+typedef struct {
+  UINT64    Batches;       ///< Calls to SetVariables() with at least one entry.
+  UINT64    Variables;     ///< Variables written by those calls.
+  UINT64    Requests;      ///< Requests (SMIs, if the variable driver is in SMM) sent to write them.
+  UINT64    RequestsSaved; ///< Requests saved compared to one SetVariable() per variable.
+} EDKII_VARIABLE_BATCH_WRITE_STATISTICS;
+
+/**
+  Set a batch of variables.
+
+  The entries are written in order. Entries sent to the variable driver in the
+  same request are applied without any other variable request in between, and
+  the runtime variable cache is synchronized once per request. The batch stops
+  at the first entry that fails, but the entries written before it are not
+  undone.
+
+  @param[in]      This     The EDKII_VARIABLE_BATCH_WRITE_PROTOCOL instance.
+  @param[in]      Count    Number of entries.
+  @param[in, out] Entries  The variables to write. The Status of every entry
+                           is updated.
+
+  @retval EFI_SUCCESS            All the variables were written.
+  @retval EFI_INVALID_PARAMETER  Entries is NULL and Count is not zero, or an
+                                 entry is invalid. No variable was written.
+  @retval Others                 The status of the first entry that failed.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_VARIABLE_BATCH_WRITE_SET_VARIABLES)(
+  IN CONST EDKII_VARIABLE_BATCH_WRITE_PROTOCOL  *This,
+  IN       UINTN                                Count,
+  IN OUT   EDKII_VARIABLE_BATCH_WRITE_ENTRY     *Entries
+  );
+
+/**
+  Get the counters of the batches written through the protocol.
+
+  @param[in]  This        The EDKII_VARIABLE_BATCH_WRITE_PROTOCOL instance.
+  @param[out] Statistics  Returns the counters.
+
+  @retval EFI_SUCCESS            The counters were returned.
+  @retval EFI_INVALID_PARAMETER  Statistics is NULL.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_VARIABLE_BATCH_WRITE_GET_STATISTICS)(
+  IN CONST EDKII_VARIABLE_BATCH_WRITE_PROTOCOL    *This,
+  OUT      EDKII_VARIABLE_BATCH_WRITE_STATISTICS  *Statistics
+  );
+
+///
+/// Variable Batch Write Protocol writes several variables in one request to
+/// the variable driver.
+///
+struct _EDKII_VARIABLE_BATCH_WRITE_PROTOCOL {
+  UINT64                                       Revision;
+  EDKII_VARIABLE_BATCH_WRITE_SET_VARIABLES     SetVariables;
+  EDKII_VARIABLE_BATCH_WRITE_GET_STATISTICS    GetStatistics;
+};
+
+extern EFI_GUID  gEdkiiVariableBatchWriteProtocolGuid;
+
+#endif
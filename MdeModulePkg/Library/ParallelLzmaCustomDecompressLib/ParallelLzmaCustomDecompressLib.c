@@ -11,6 +11,7 @@
 #include <Library/DebugLib.h>
 #include <Library/ExtractGuidedSectionLib.h>
 #include <Library/HobLib.h>
+#include <Library/PcdLib.h>
 
 #include <Guid/ParallelLzmaDecompress.h>
 
@@ -35,6 +36,100 @@ LzmaUefiDecompress (
   IN OUT VOID    *Scratch
   );
 
+/**
+  Looks up a source buffer with a linear walk of the decompressed buffer HOBs.
+
+  @param[in]  SourceBuffer  The compressed data to look for.
+
+  @return The matching HOB data, or NULL if there is none.
+
+**/
+STATIC
+PARALLEL_DECOMPRESSED_BUFFER *
+FindDecompressedBufferLinear (
+  IN CONST VOID  *SourceBuffer
+  )
+{
+  EFI_HOB_GUID_TYPE             *GuidHob;
+  PARALLEL_DECOMPRESSED_BUFFER  *DecompBufferInfo;
+
+  for (GuidHob = GetFirstGuidHob (&gParallelLzmaCustomDecompressHobGuid);
+       GuidHob != NULL;
+       GuidHob = GetNextGuidHob (&gParallelLzmaCustomDecompressHobGuid, GET_NEXT_HOB (GuidHob)))
+  {
+    DecompBufferInfo = (PARALLEL_DECOMPRESSED_BUFFER *)GET_GUID_HOB_DATA (GuidHob);
+    if (DecompBufferInfo->SourceBuffer == SourceBuffer) {
+      return DecompBufferInfo;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Finds the decompressed buffer of a source buffer.
+
+  The hash index HOB published with the decompressed buffer HOBs is used when
+  present. It lives in the HOB list, so it is shared by PEI and DXE without any
+  module global, which a PEIM executing in place cannot write. A miss in the
+  index falls back to a linear walk, which finds the HOBs that another
+  producer published without an index.
+
+  @param[in] SourceBuffer  The compressed data to look for.
+
+  @return The matching decompressed buffer, or NULL if there is none.
+
+**/
+STATIC
+PARALLEL_DECOMPRESSED_BUFFER *
+FindDecompressedBuffer (
+  IN CONST VOID  *SourceBuffer
+  )
+{
+  EFI_HOB_GUID_TYPE                   *GuidHob;
+  PARALLEL_DECOMPRESSED_BUFFER_INDEX  *BufferIndex;
+  UINT32                              Bucket;
+
+  GuidHob = GetFirstGuidHob (&gParallelLzmaCustomDecompressIndexHobGuid);
+  if (GuidHob != NULL) {
+    BufferIndex = (PARALLEL_DECOMPRESSED_BUFFER_INDEX *)GET_GUID_HOB_DATA (GuidHob);
+    Bucket      = PARALLEL_DECOMPRESSED_BUFFER_HASH (SourceBuffer, BufferIndex->BucketCount);
+    while (BufferIndex->Buckets[Bucket].SourceBuffer != NULL) {
+      if (BufferIndex->Buckets[Bucket].SourceBuffer == SourceBuffer) {
+        return &BufferIndex->Buckets[Bucket];
+      }
+
+      Bucket = (Bucket + 1) & (BufferIndex->BucketCount - 1);
+    }
+  }
+
+  return FindDecompressedBufferLinear (SourceBuffer);
+}
+
+/**
+  Checks whether a decompressed buffer may be handed to the caller in place.
+
+  A section that requires processing is decoded into a buffer apart from the
+  section, so the shared decompressed buffer can stand in for it. A section
+  with a valid authentication status is always copied, as its status must be
+  produced by each extraction.
+
+  @param[in] SectionAttribute  The Attributes field of the GUIDed section.
+
+  @retval TRUE   The buffer may be returned in place.
+  @retval FALSE  The buffer must be copied.
+
+**/
+STATIC
+BOOLEAN
+IsZeroCopyAllowed (
+  IN UINT16  SectionAttribute
+  )
+{
+  return (BOOLEAN)(((SectionAttribute & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) != 0) &&
+                   ((SectionAttribute & EFI_GUIDED_SECTION_AUTH_STATUS_VALID) == 0));
+}
+
 /**
   Examines a GUIDed section and returns the size of the decoded buffer and the
   size of an optional scratch buffer required to actually decode the data in a GUIDed section.
@@ -160,9 +255,9 @@ ParallelLzmaGuidedSectionExtraction (
   )
 {
   PARALLEL_DECOMPRESSED_BUFFER  *DecompBufferInfo;
-  EFI_HOB_GUID_TYPE             *GuidHob;
   VOID                          *DataOffset;
   UINTN                         DataSize;
+  UINT16                        SectionAttribute;
 
   ASSERT (OutputBuffer != NULL);
   ASSERT (InputSection != NULL);
@@ -186,8 +281,9 @@ ParallelLzmaGuidedSectionExtraction (
       return RETURN_UNSUPPORTED;
     }
 
-    DataOffset = (UINT8 *)InputSection + ((EFI_GUID_DEFINED_SECTION2 *)InputSection)->DataOffset;
-    DataSize   = SECTION2_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION2 *)InputSection)->DataOffset;
+    DataOffset       = (UINT8 *)InputSection + ((EFI_GUID_DEFINED_SECTION2 *)InputSection)->DataOffset;
+    DataSize         = SECTION2_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION2 *)InputSection)->DataOffset;
+    SectionAttribute = ((EFI_GUID_DEFINED_SECTION2 *)InputSection)->Attributes;
   } else {
     if (!CompareGuid (
            &gParallelLzmaCustomDecompressGuid,
@@ -197,31 +293,46 @@ ParallelLzmaGuidedSectionExtraction (
       return RETURN_UNSUPPORTED;
     }
 
-    DataOffset = (UINT8 *)InputSection + ((EFI_GUID_DEFINED_SECTION *)InputSection)->DataOffset;
-    DataSize   = SECTION_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION *)InputSection)->DataOffset;
+    DataOffset       = (UINT8 *)InputSection + ((EFI_GUID_DEFINED_SECTION *)InputSection)->DataOffset;
+    DataSize         = SECTION_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION *)InputSection)->DataOffset;
+    SectionAttribute = ((EFI_GUID_DEFINED_SECTION *)InputSection)->Attributes;
   }
 
   //
-  // Iterate over any previously decompressed buffers. Copy and return if found.
+  // Look for a previously decompressed buffer. Hand it off or copy it if found.
   //
-  for (GuidHob = GetFirstGuidHob (&gParallelLzmaCustomDecompressHobGuid);
-       GuidHob != NULL;
-       GuidHob = GetNextGuidHob (&gParallelLzmaCustomDecompressHobGuid, GET_NEXT_HOB (GuidHob)))
-  {
-    DecompBufferInfo = (PARALLEL_DECOMPRESSED_BUFFER *)GET_GUID_HOB_DATA (GuidHob);
-
-    if (DecompBufferInfo->SourceBuffer == DataOffset) {
+  DecompBufferInfo = FindDecompressedBuffer (DataOffset);
+  if (DecompBufferInfo != NULL) {
+    //
+    // The OutputBuffer contract of ExtractGuidedSectionLib allows the handler
+    // to point the caller at a buffer it does not own. Do that in zero-copy
+    // mode when the section attributes allow it, or when the caller did not
+    // provide a buffer to copy into.
+    //
+    if ((FeaturePcdGet (PcdParallelLzmaZeroCopyEnable) && IsZeroCopyAllowed (SectionAttribute)) ||
+        (*OutputBuffer == NULL))
+    {
       DEBUG ((
         DEBUG_INFO,
-        "[%a] Matched source buffer %p. Copying decompressed buffer %p to ouput %p\n",
-        __FUNCTION__,
+        "[%a] Matched source buffer %p. Returning decompressed buffer %p in place\n",
+        __func__,
         DecompBufferInfo->SourceBuffer,
-        DecompBufferInfo->DecompressedBuffer,
-        *OutputBuffer
+        DecompBufferInfo->DecompressedBuffer
         ));
-      CopyMem (*OutputBuffer, DecompBufferInfo->DecompressedBuffer, DecompBufferInfo->DecompressedSize);
+      *OutputBuffer = DecompBufferInfo->DecompressedBuffer;
       return RETURN_SUCCESS;
     }
+
+    DEBUG ((
+      DEBUG_INFO,
+      "[%a] Matched source buffer %p. Copying decompressed buffer %p to ouput %p\n",
+      __func__,
+      DecompBufferInfo->SourceBuffer,
+      DecompBufferInfo->DecompressedBuffer,
+      *OutputBuffer
+      ));
+    CopyMem (*OutputBuffer, DecompBufferInfo->DecompressedBuffer, DecompBufferInfo->DecompressedSize);
+    return RETURN_SUCCESS;
   }
 
   //
@@ -8,6 +8,59 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include "InternalBm.h"
 
+// MU_CHANGE [BEGIN] - Per-controller connect timing
+
+/**
+  Connect the drivers to a controller and its child controllers.
+
+  When performance measurement is enabled, the time taken is recorded with
+  PERF_START_EX() and PERF_END_EX() on the controller handle. The token is the
+  end of the text of the device path of the controller, which tells apart the
+  controllers under the same bridge even though the records keep only
+  FPDT_STRING_EVENT_RECORD_NAME_LENGTH - 1 characters. The controllers
+  without a device path are connected without a record.
+
+  @param[in] ControllerHandle  The handle of the controller.
+**/
+STATIC
+VOID
+BmConnectControllerMeasured (
+  IN EFI_HANDLE  ControllerHandle
+  )
+{
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  CHAR16                    *DevicePathText;
+  UINTN                     Length;
+  CHAR8                     Token[FPDT_STRING_EVENT_RECORD_NAME_LENGTH];
+
+  DevicePathText = NULL;
+  if (PerformanceMeasurementEnabled ()) {
+    DevicePath = DevicePathFromHandle (ControllerHandle);
+    if (DevicePath != NULL) {
+      DevicePathText = ConvertDevicePathToText (DevicePath, FALSE, FALSE);
+    }
+  }
+
+  if (DevicePathText == NULL) {
+    gBS->ConnectController (ControllerHandle, NULL, NULL, TRUE);
+    return;
+  }
+
+  Length = StrLen (DevicePathText);
+  UnicodeStrToAsciiStrS (
+    DevicePathText + Length - MIN (Length, sizeof (Token) - 1),
+    Token,
+    sizeof (Token)
+    );
+  FreePool (DevicePathText);
+
+  PERF_START_EX (ControllerHandle, Token, NULL, 0, 0);
+  gBS->ConnectController (ControllerHandle, NULL, NULL, TRUE);
+  PERF_END_EX (ControllerHandle, Token, NULL, 0, 0);
+}
+
+// MU_CHANGE [END]
+
 /**
   Connect all the drivers to all the controllers.
 
@@ -38,7 +91,7 @@ BmConnectAllDriversToAllControllers (
            );
 
     for (Index = 0; Index < HandleCount; Index++) {
-      gBS->ConnectController (HandleBuffer[Index], NULL, NULL, TRUE);
+      BmConnectControllerMeasured (HandleBuffer[Index]); // MU_CHANGE
     }
 
     if (HandleBuffer != NULL) {
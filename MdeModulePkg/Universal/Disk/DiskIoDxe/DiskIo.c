@@ -186,6 +186,8 @@ DiskIoDriverBindingStart (
     goto ErrorExit;
   }
 
+  DiskIoCacheInitialize (&Instance->Cache, Instance->BlockIo); // MU_CHANGE - Block cache
+
   //
   // Install protocol interfaces for the Disk IO device.
   //
@@ -217,6 +219,7 @@ ErrorExit:
     }
 
     if (Instance != NULL) {
+      DiskIoCacheFree (&Instance->Cache); // MU_CHANGE - Block cache
       FreePool (Instance);
     }
 
@@ -325,6 +328,8 @@ DiskIoDriverBindingStop (
       EfiReleaseLock (&Instance->TaskQueueLock);
     } while (!AllTaskDone);
 
+    DiskIoCacheFree (&Instance->Cache); // MU_CHANGE - Block cache
+
     FreeAlignedPages (
       Instance->SharedWorkingBuffer,
       EFI_SIZE_TO_PAGES (PcdGet32 (PcdDiskIoDataBufferBlockNum) * Instance->BlockIo->Media->BlockSize)
@@ -866,6 +871,13 @@ DiskIo2ReadWriteDisk (
     while (!DiskIo2RemoveCompletedTask (Instance)) {
     }
 
+    // MU_CHANGE [BEGIN] - Block cache
+    if (!Write && DiskIoCacheRead (&Instance->Cache, MediaId, Offset, BufferSize, Buffer)) {
+      return EFI_SUCCESS;
+    }
+
+    // MU_CHANGE [END]
+
     SubtasksPtr = &Subtasks;
   } else {
     DiskIo2RemoveCompletedTask (Instance);
@@ -886,6 +898,13 @@ DiskIo2ReadWriteDisk (
     SubtasksPtr = &Task->Subtasks;
   }
 
+  // MU_CHANGE [BEGIN] - Block cache
+  if (Write) {
+    DiskIoCacheInvalidate (&Instance->Cache, Offset, BufferSize);
+  }
+
+  // MU_CHANGE [END]
+
   InitializeListHead (SubtasksPtr);
   if (!DiskIoCreateSubtaskList (Instance, Write, Offset, BufferSize, Buffer, Blocking, Instance->SharedWorkingBuffer, SubtasksPtr)) {
     if (Task != NULL) {
@@ -1160,6 +1179,8 @@ DiskIo2FlushDiskEx (
 
   Private = DISK_IO_PRIVATE_DATA_FROM_DISK_IO2 (This);
 
+  DiskIoCacheInvalidateAll (&Private->Cache); // MU_CHANGE - Block cache
+
   if ((Token != NULL) && (Token->Event != NULL)) {
     Task = AllocatePool (sizeof (DISK_IO2_FLUSH_TASK));
     if (Task == NULL) {
@@ -1300,6 +1321,7 @@ InitializeDiskIo (
   )
 {
   EFI_STATUS  Status;
+  EFI_EVENT   ReadyToBootEvent; // MU_CHANGE - Block cache
 
   //
   // Install driver model protocol(s).
@@ -1314,5 +1336,16 @@ InitializeDiskIo (
              );
   ASSERT_EFI_ERROR (Status);
 
+  // MU_CHANGE [BEGIN] - Block cache
+  //
+  // The block caches only see the accesses made through Disk I/O. Drop them
+  // before a boot option may write the devices through Block I/O.
+  //
+  if (PcdGet32 (PcdDiskIoCacheLineNum) != 0) {
+    EfiCreateEventReadyToBootEx (TPL_CALLBACK, DiskIoCacheOnReadyToBoot, NULL, &ReadyToBootEvent);
+  }
+
+  // MU_CHANGE [END]
+
   return Status;
 }
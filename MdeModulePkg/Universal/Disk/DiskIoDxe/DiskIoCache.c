@@ -0,0 +1,456 @@
+/** @file
+  Block cache of the Disk I/O devices.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DiskIo.h"
+
+//
+// Block caches of the devices, and whether the ReadyToBoot event has dropped them.
+//
+LIST_ENTRY  mDiskIoCacheList        = INITIALIZE_LIST_HEAD_VARIABLE (mDiskIoCacheList);
+BOOLEAN     mDiskIoCacheReadyToBoot = FALSE;
+
+/**
+  Allocate the block cache of a device.
+
+  The device works without a cache if PcdDiskIoCacheLineNum is zero, if the
+  ReadyToBoot event has been signaled or if the cache cannot be allocated.
+
+  @param[out] Cache    The block cache.
+  @param[in]  BlockIo  The Block I/O protocol of the device.
+
+**/
+VOID
+DiskIoCacheInitialize (
+  OUT DISK_IO_CACHE          *Cache,
+  IN  EFI_BLOCK_IO_PROTOCOL  *BlockIo
+  )
+{
+  EFI_BLOCK_IO_MEDIA  *Media;
+  UINTN               EntryCount;
+  UINTN               Index;
+  EFI_TPL             OldTpl;
+
+  Media = BlockIo->Media;
+
+  ZeroMem (Cache, sizeof (DISK_IO_CACHE));
+  Cache->BlockIo = BlockIo;
+  EntryCount = PcdGet32 (PcdDiskIoCacheLineNum);
+  if ((EntryCount == 0) || mDiskIoCacheReadyToBoot || (Media->BlockSize == 0)) {
+    return;
+  }
+
+  //
+  // A partition is read through the Disk I/O protocol of its parent device,
+  // which caches it already.
+  //
+  if (Media->LogicalPartition) {
+    return;
+  }
+
+  //
+  // The lines read by a miss must not replace each other.
+  //
+  EntryCount           = MAX (EntryCount, DISK_IO_CACHE_READ_AHEAD_LINES);
+  Cache->BlockSize     = Media->BlockSize;
+  Cache->BlocksPerLine = MAX (1, DISK_IO_CACHE_LINE_SIZE / Media->BlockSize);
+  Cache->LineSize      = Cache->BlocksPerLine * Media->BlockSize;
+  Cache->MediaId       = Media->MediaId;
+  Cache->NextLine      = MAX_UINT64;
+  Cache->ReadAhead     = 1;
+
+  Cache->Entries = AllocateZeroPool (EntryCount * sizeof (DISK_IO_CACHE_ENTRY));
+  if (Cache->Entries == NULL) {
+    return;
+  }
+
+  //
+  // The read-ahead buffer comes first so that it gets the alignment required
+  // by the device.
+  //
+  Cache->DataPages = EFI_SIZE_TO_PAGES ((EntryCount + DISK_IO_CACHE_READ_AHEAD_LINES) * Cache->LineSize);
+  Cache->Data      = AllocateAlignedPages (Cache->DataPages, Media->IoAlign);
+  if (Cache->Data == NULL) {
+    FreePool (Cache->Entries);
+    Cache->Entries = NULL;
+    return;
+  }
+
+  Cache->ReadAheadBuffer = Cache->Data;
+  Cache->EntryCount      = EntryCount;
+  for (Index = 0; Index < EntryCount; Index++) {
+    Cache->Entries[Index].Data = Cache->Data + (DISK_IO_CACHE_READ_AHEAD_LINES + Index) * Cache->LineSize;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  InsertTailList (&mDiskIoCacheList, &Cache->Link);
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+  Free the block cache of a device.
+
+  @param[in] Cache  The block cache.
+
+**/
+VOID
+DiskIoCacheFree (
+  IN DISK_IO_CACHE  *Cache
+  )
+{
+  EFI_TPL  OldTpl;
+
+  if (Cache->Entries == NULL) {
+    return;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  RemoveEntryList (&Cache->Link);
+  gBS->RestoreTPL (OldTpl);
+
+  FreeAlignedPages (Cache->Data, Cache->DataPages);
+  FreePool (Cache->Entries);
+  Cache->Entries    = NULL;
+  Cache->EntryCount = 0;
+}
+
+/**
+  Drop the cache lines in a range of line numbers.
+
+  @param[in] Cache      The block cache.
+  @param[in] FirstLine  The first line to drop.
+  @param[in] LastLine   The last line to drop.
+
+**/
+STATIC
+VOID
+DiskIoCacheDrop (
+  IN DISK_IO_CACHE  *Cache,
+  IN UINT64         FirstLine,
+  IN UINT64         LastLine
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Cache->EntryCount; Index++) {
+    if ((Cache->Entries[Index].LastUse != 0) &&
+        (Cache->Entries[Index].Line >= FirstLine) &&
+        (Cache->Entries[Index].Line <= LastLine))
+    {
+      Cache->Entries[Index].LastUse = 0;
+      Cache->Statistics.Invalidations++;
+    }
+  }
+
+  Cache->NextLine  = MAX_UINT64;
+  Cache->ReadAhead = 1;
+}
+
+/**
+  Find a line in the cache.
+
+  @param[in] Cache  The block cache.
+  @param[in] Line   The line number.
+
+  @return The entry holding the line, or NULL if the line is not cached.
+
+**/
+STATIC
+DISK_IO_CACHE_ENTRY *
+DiskIoCacheLookup (
+  IN DISK_IO_CACHE  *Cache,
+  IN UINT64         Line
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Cache->EntryCount; Index++) {
+    if ((Cache->Entries[Index].LastUse != 0) && (Cache->Entries[Index].Line == Line)) {
+      return &Cache->Entries[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Read missing lines from the device into the cache.
+
+  The lines read start at Line and cover the lines of the request up to
+  LastLine, or more when the miss follows the previous one. They stop at the
+  first line already cached and at the end of the media.
+
+  @param[in] Cache     The block cache.
+  @param[in] MediaId   ID of the medium to read.
+  @param[in] Line      The missing line.
+  @param[in] LastLine  The last line of the request.
+
+  @return The entry holding Line, or NULL if the device failed to read it.
+
+**/
+STATIC
+DISK_IO_CACHE_ENTRY *
+DiskIoCacheFill (
+  IN DISK_IO_CACHE  *Cache,
+  IN UINT32         MediaId,
+  IN UINT64         Line,
+  IN UINT64         LastLine
+  )
+{
+  EFI_STATUS           Status;
+  DISK_IO_CACHE_ENTRY  *Entry;
+  DISK_IO_CACHE_ENTRY  *Victim;
+  UINT64               MediaLines;
+  UINTN                Requested;
+  UINTN                Count;
+  UINTN                Index;
+  UINTN                EntryIndex;
+
+  Requested = (UINTN)(LastLine - Line + 1);
+
+  if (Line == Cache->NextLine) {
+    Cache->ReadAhead = MIN (Cache->ReadAhead * 2, DISK_IO_CACHE_READ_AHEAD_LINES);
+  } else {
+    Cache->ReadAhead = 1;
+  }
+
+  Count      = MIN (MAX (Requested, Cache->ReadAhead), DISK_IO_CACHE_READ_AHEAD_LINES);
+  MediaLines = DivU64x32 (Cache->BlockIo->Media->LastBlock + 1, Cache->BlocksPerLine);
+  if (MediaLines - Line < Count) {
+    Count = (UINTN)(MediaLines - Line);
+  }
+
+  for (Index = 1; Index < Count; Index++) {
+    if (DiskIoCacheLookup (Cache, Line + Index) != NULL) {
+      break;
+    }
+  }
+
+  Count  = Index;
+  Status = Cache->BlockIo->ReadBlocks (
+                                Cache->BlockIo,
+                                MediaId,
+                                MultU64x32 (Line, Cache->BlocksPerLine),
+                                Count * Cache->LineSize,
+                                Cache->ReadAheadBuffer
+                                );
+  if (EFI_ERROR (Status)) {
+    if ((Status == EFI_MEDIA_CHANGED) || (Status == EFI_NO_MEDIA)) {
+      DiskIoCacheDrop (Cache, 0, MAX_UINT64);
+    }
+
+    return NULL;
+  }
+
+  Entry = NULL;
+  for (Index = 0; Index < Count; Index++) {
+    Victim = &Cache->Entries[0];
+    for (EntryIndex = 1; EntryIndex < Cache->EntryCount; EntryIndex++) {
+      if (Cache->Entries[EntryIndex].LastUse < Victim->LastUse) {
+        Victim = &Cache->Entries[EntryIndex];
+      }
+    }
+
+    Victim->Line    = Line + Index;
+    Victim->LastUse = ++Cache->Clock;
+    CopyMem (Victim->Data, Cache->ReadAheadBuffer + Index * Cache->LineSize, Cache->LineSize);
+    if (Index == 0) {
+      Entry = Victim;
+    }
+  }
+
+  Cache->NextLine                   = Line + Count;
+  Cache->Statistics.Misses         += MIN (Count, Requested);
+  Cache->Statistics.ReadAheadLines += Count - MIN (Count, Requested);
+  return Entry;
+}
+
+/**
+  Read from the block cache of a device, filling it from the device on a miss.
+
+  @param[in]  Cache       The block cache.
+  @param[in]  MediaId     ID of the medium to read.
+  @param[in]  Offset      The starting byte offset on the device to read from.
+  @param[in]  BufferSize  The number of bytes to read.
+  @param[out] Buffer      The destination buffer.
+
+  @retval TRUE   The data was read into Buffer.
+  @retval FALSE  The request is not served by the cache and must be sent to
+                 the device.
+
+**/
+BOOLEAN
+DiskIoCacheRead (
+  IN  DISK_IO_CACHE  *Cache,
+  IN  UINT32         MediaId,
+  IN  UINT64         Offset,
+  IN  UINTN          BufferSize,
+  OUT UINT8          *Buffer
+  )
+{
+  DISK_IO_CACHE_ENTRY  *Entry;
+  EFI_BLOCK_IO_MEDIA   *Media;
+  UINT64               FirstLine;
+  UINT64               LastLine;
+  UINT64               Line;
+  UINT64               LineStart;
+  UINT64               Start;
+  UINT64               End;
+  EFI_TPL              OldTpl;
+
+  if (Cache->Entries == NULL) {
+    return FALSE;
+  }
+
+  Media  = Cache->BlockIo->Media;
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  //
+  // Let the device report a missing or changed medium.
+  //
+  if (!Media->MediaPresent || (Media->MediaId != Cache->MediaId) || (Media->BlockSize != Cache->BlockSize)) {
+    DiskIoCacheDrop (Cache, 0, MAX_UINT64);
+    Cache->MediaId = Media->MediaId;
+    goto Bypass;
+  }
+
+  if ((MediaId != Media->MediaId) || (BufferSize == 0) ||
+      (BufferSize > DISK_IO_CACHE_READ_AHEAD_LINES * Cache->LineSize) ||
+      (Offset > MAX_UINT64 - BufferSize))
+  {
+    goto Bypass;
+  }
+
+  FirstLine = DivU64x32 (Offset, Cache->LineSize);
+  LastLine  = DivU64x32 (Offset + BufferSize - 1, Cache->LineSize);
+  if (LastLine >= DivU64x32 (Media->LastBlock + 1, Cache->BlocksPerLine)) {
+    //
+    // The last line of the media is partial, it is not cached.
+    //
+    goto Bypass;
+  }
+
+  for (Line = FirstLine; Line <= LastLine; Line++) {
+    Entry = DiskIoCacheLookup (Cache, Line);
+    if (Entry == NULL) {
+      Entry = DiskIoCacheFill (Cache, MediaId, Line, LastLine);
+      if (Entry == NULL) {
+        goto Bypass;
+      }
+    } else {
+      Cache->Statistics.Hits++;
+    }
+
+    Entry->LastUse = ++Cache->Clock;
+    LineStart      = MultU64x32 (Line, Cache->LineSize);
+    Start          = MAX (Offset, LineStart);
+    End            = MIN (Offset + BufferSize, LineStart + Cache->LineSize);
+    CopyMem (Buffer + (UINTN)(Start - Offset), Entry->Data + (UINTN)(Start - LineStart), (UINTN)(End - Start));
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return TRUE;
+
+Bypass:
+  Cache->Statistics.Bypassed++;
+  gBS->RestoreTPL (OldTpl);
+  return FALSE;
+}
+
+/**
+  Drop the cache lines holding any byte of a range of a device.
+
+  @param[in] Cache       The block cache.
+  @param[in] Offset      The starting byte offset of the range.
+  @param[in] BufferSize  The size in bytes of the range.
+
+**/
+VOID
+DiskIoCacheInvalidate (
+  IN DISK_IO_CACHE  *Cache,
+  IN UINT64         Offset,
+  IN UINTN          BufferSize
+  )
+{
+  UINT64   LastLine;
+  EFI_TPL  OldTpl;
+
+  if ((Cache->Entries == NULL) || (BufferSize == 0)) {
+    return;
+  }
+
+  if (Offset > MAX_UINT64 - BufferSize) {
+    LastLine = MAX_UINT64;
+  } else {
+    LastLine = DivU64x32 (Offset + BufferSize - 1, Cache->LineSize);
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  DiskIoCacheDrop (Cache, DivU64x32 (Offset, Cache->LineSize), LastLine);
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+  Drop all the cache lines of a device.
+
+  @param[in] Cache  The block cache.
+
+**/
+VOID
+DiskIoCacheInvalidateAll (
+  IN DISK_IO_CACHE  *Cache
+  )
+{
+  EFI_TPL  OldTpl;
+
+  if (Cache->Entries == NULL) {
+    return;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  DiskIoCacheDrop (Cache, 0, MAX_UINT64);
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+  Report the statistics of the block caches and free them, once the ReadyToBoot
+  event is signaled.
+
+  @param[in] Event    The ReadyToBoot event.
+  @param[in] Context  Not used.
+
+**/
+VOID
+EFIAPI
+DiskIoCacheOnReadyToBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  DISK_IO_CACHE  *Cache;
+
+  mDiskIoCacheReadyToBoot = TRUE;
+
+  while (!IsListEmpty (&mDiskIoCacheList)) {
+    Cache    = BASE_CR (GetFirstNode (&mDiskIoCacheList), DISK_IO_CACHE, Link);
+    DEBUG ((
+      DEBUG_INFO,
+      "DiskIo: BlockIo %p cache: %Lu line hits, %Lu line misses, %Lu lines read ahead, %Lu reads bypassed, %Lu lines invalidated\n",
+      Cache->BlockIo,
+      Cache->Statistics.Hits,
+      Cache->Statistics.Misses,
+      Cache->Statistics.ReadAheadLines,
+      Cache->Statistics.Bypassed,
+      Cache->Statistics.Invalidations
+      ));
+    DiskIoCacheFree (Cache);
+  }
+
+  if (Event != NULL) {
+    gBS->CloseEvent (Event);
+  }
+}
@@ -0,0 +1,167 @@
+/** @file
+  Block cache of the Disk I/O devices.
+
+  Partition and file system drivers probing a device read the same few sectors
+  many times through the Disk I/O protocol. When PcdDiskIoCacheLineNum is not
+  zero, each device keeps that many cache lines of DISK_IO_CACHE_LINE_SIZE
+  bytes, replaced in LRU order, and serves small blocking reads from them.
+  A miss that follows the previous one reads ahead the next lines in the same
+  BlockIo request, doubling the read-ahead up to DISK_IO_CACHE_READ_AHEAD_LINES
+  lines while the reads stay sequential.
+
+  The cache only sees the accesses made through the Disk I/O protocol of the
+  device, so it is dropped when the ReadyToBoot event is signaled, before boot
+  options that may write the device through Block I/O are started.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef DISK_IO_CACHE_H_
+#define DISK_IO_CACHE_H_
+
+//
+// Size in bytes of a cache line, rounded down to a whole number of blocks.
+//
+#define DISK_IO_CACHE_LINE_SIZE  SIZE_4KB
+
+//
+// Maximum number of lines read by one BlockIo request on a miss. Blocking
+// reads larger than this are not cached.
+//
+#define DISK_IO_CACHE_READ_AHEAD_LINES  8
+
+///
+/// A cache line.
+///
+typedef struct {
+  UINT64    Line;                  ///< Line number, the first LBA divided by the blocks per line.
+  UINT64    LastUse;               ///< Zero if the entry does not hold a line.
+  UINT8     *Data;
+} DISK_IO_CACHE_ENTRY;
+
+///
+/// Counters of the reads served by the cache.
+///
+typedef struct {
+  UINT64    Hits;                  ///< Lines copied from the cache.
+  UINT64    Misses;                ///< Lines read from the device for a request.
+  UINT64    ReadAheadLines;        ///< Lines read from the device ahead of a request.
+  UINT64    Bypassed;              ///< Blocking reads that were not served by the cache.
+  UINT64    Invalidations;         ///< Lines dropped because of a write, a flush or a media change.
+} DISK_IO_CACHE_STATISTICS;
+
+///
+/// Block cache of a device.
+///
+typedef struct {
+  LIST_ENTRY                  Link;
+  EFI_BLOCK_IO_PROTOCOL       *BlockIo;
+  DISK_IO_CACHE_ENTRY         *Entries;     ///< NULL if the cache is disabled.
+  UINTN                       EntryCount;
+  UINT8                       *Data;        ///< Lines and read-ahead buffer.
+  UINTN                       DataPages;
+  UINT8                       *ReadAheadBuffer;
+  UINT32                      BlockSize;
+  UINT32                      BlocksPerLine;
+  UINT32                      LineSize;
+  UINT32                      MediaId;
+  UINT64                      Clock;
+  UINT64                      NextLine;     ///< Line following the last miss.
+  UINTN                       ReadAhead;    ///< Lines to read on the next sequential miss.
+  DISK_IO_CACHE_STATISTICS    Statistics;
+} DISK_IO_CACHE;
+
+/**
+  Allocate the block cache of a device.
+
+  The device works without a cache if PcdDiskIoCacheLineNum is zero, if the
+  ReadyToBoot event has been signaled or if the cache cannot be allocated.
+
+  @param[out] Cache    The block cache.
+  @param[in]  BlockIo  The Block I/O protocol of the device.
+
+**/
+VOID
+DiskIoCacheInitialize (
+  OUT DISK_IO_CACHE          *Cache,
+  IN  EFI_BLOCK_IO_PROTOCOL  *BlockIo
+  );
+
+/**
+  Free the block cache of a device.
+
+  @param[in] Cache  The block cache.
+
+**/
+VOID
+DiskIoCacheFree (
+  IN DISK_IO_CACHE  *Cache
+  );
+
+/**
+  Read from the block cache of a device, filling it from the device on a miss.
+
+  @param[in]  Cache       The block cache.
+  @param[in]  MediaId     ID of the medium to read.
+  @param[in]  Offset      The starting byte offset on the device to read from.
+  @param[in]  BufferSize  The number of bytes to read.
+  @param[out] Buffer      The destination buffer.
+
+  @retval TRUE   The data was read into Buffer.
+  @retval FALSE  The request is not served by the cache and must be sent to
+                 the device.
+
+**/
+BOOLEAN
+DiskIoCacheRead (
+  IN  DISK_IO_CACHE  *Cache,
+  IN  UINT32         MediaId,
+  IN  UINT64         Offset,
+  IN  UINTN          BufferSize,
+  OUT UINT8          *Buffer
+  );
+
+/**
+  Drop the cache lines holding any byte of a range of a device.
+
+  @param[in] Cache       The block cache.
+  @param[in] Offset      The starting byte offset of the range.
+  @param[in] BufferSize  The size in bytes of the range.
+
+**/
+VOID
+DiskIoCacheInvalidate (
+  IN DISK_IO_CACHE  *Cache,
+  IN UINT64         Offset,
+  IN UINTN          BufferSize
+  );
+
+/**
+  Drop all the cache lines of a device.
+
+  @param[in] Cache  The block cache.
+
+**/
+VOID
+DiskIoCacheInvalidateAll (
+  IN DISK_IO_CACHE  *Cache
+  );
+
+/**
+  Report the statistics of the block caches and free them, once the ReadyToBoot
+  event is signaled.
+
+  @param[in] Event    The ReadyToBoot event.
+  @param[in] Context  Not used.
+
+**/
+VOID
+EFIAPI
+DiskIoCacheOnReadyToBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  );
+
+#endif
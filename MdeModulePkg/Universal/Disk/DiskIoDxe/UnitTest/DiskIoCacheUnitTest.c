@@ -0,0 +1,452 @@
+/** @file -- DiskIoCacheUnitTest.c
+  Host based unit tests of the block cache of DiskIoDxe.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../DiskIo.h"
+
+#define UNIT_TEST_NAME     "Disk I/O Block Cache Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// The emulated disk has 512-byte blocks and does not end on a cache line.
+//
+#define TEST_BLOCK_SIZE   512
+#define TEST_BLOCK_COUNT  1001
+#define TEST_LINE_SIZE    DISK_IO_CACHE_LINE_SIZE
+
+///
+/// Calls made to the emulated Block I/O protocol.
+///
+typedef struct {
+  UINTN    ReadBlocksCalls;
+  UINTN    BlocksRead;
+} EMULATED_BLOCK_IO;
+
+STATIC EMULATED_BLOCK_IO      mEmulatedBlockIo;
+STATIC EFI_BLOCK_IO_MEDIA     mMedia;
+STATIC EFI_BLOCK_IO_PROTOCOL  mBlockIo;
+STATIC EFI_BOOT_SERVICES      mBootServices;
+STATIC UINT8                  *mDisk;
+STATIC DISK_IO_CACHE          mCache;
+
+EFI_BOOT_SERVICES  *gBS = &mBootServices;
+
+extern BOOLEAN  mDiskIoCacheReadyToBoot;
+
+EFI_STATUS
+EFIAPI
+EmulatedReadBlocks (
+  IN  EFI_BLOCK_IO_PROTOCOL  *This,
+  IN  UINT32                 MediaId,
+  IN  EFI_LBA                Lba,
+  IN  UINTN                  BufferSize,
+  OUT VOID                   *Buffer
+  )
+{
+  if (MediaId != mMedia.MediaId) {
+    return EFI_MEDIA_CHANGED;
+  }
+
+  if ((BufferSize % TEST_BLOCK_SIZE != 0) || (Lba + BufferSize / TEST_BLOCK_SIZE > TEST_BLOCK_COUNT)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  mEmulatedBlockIo.ReadBlocksCalls++;
+  mEmulatedBlockIo.BlocksRead += BufferSize / TEST_BLOCK_SIZE;
+  CopyMem (Buffer, mDisk + Lba * TEST_BLOCK_SIZE, BufferSize);
+  return EFI_SUCCESS;
+}
+
+EFI_TPL
+EFIAPI
+EmulatedRaiseTpl (
+  IN EFI_TPL  NewTpl
+  )
+{
+  return TPL_APPLICATION;
+}
+
+VOID
+EFIAPI
+EmulatedRestoreTpl (
+  IN EFI_TPL  OldTpl
+  )
+{
+}
+
+/**
+  Read through the cache and check the data against the emulated disk.
+
+  @param[in] Offset      The starting byte offset to read from.
+  @param[in] BufferSize  The number of bytes to read.
+
+  @retval TRUE   The cache served the read with the data of the disk.
+  @retval FALSE  Otherwise.
+
+**/
+STATIC
+BOOLEAN
+ReadAndCheck (
+  IN UINT64  Offset,
+  IN UINTN   BufferSize
+  )
+{
+  UINT8    *Buffer;
+  BOOLEAN  Served;
+
+  Buffer = AllocatePool (BufferSize);
+  if (Buffer == NULL) {
+    return FALSE;
+  }
+
+  Served = DiskIoCacheRead (&mCache, mMedia.MediaId, Offset, BufferSize, Buffer);
+  if (Served) {
+    Served = (BOOLEAN)(CompareMem (Buffer, mDisk + Offset, BufferSize) == 0);
+  }
+
+  FreePool (Buffer);
+  return Served;
+}
+
+/**
+  Reset the emulated disk and boot services, and create the cache of the disk.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED  Always.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+CacheTestSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  ZeroMem (&mEmulatedBlockIo, sizeof (mEmulatedBlockIo));
+
+  if (mDisk == NULL) {
+    mDisk = AllocatePool (TEST_BLOCK_COUNT * TEST_BLOCK_SIZE);
+  }
+
+  for (Index = 0; Index < TEST_BLOCK_COUNT * TEST_BLOCK_SIZE; Index++) {
+    mDisk[Index] = (UINT8)(Index * 7 + Index / TEST_BLOCK_SIZE);
+  }
+
+  ZeroMem (&mMedia, sizeof (mMedia));
+  mMedia.MediaId      = 1;
+  mMedia.MediaPresent = TRUE;
+  mMedia.BlockSize    = TEST_BLOCK_SIZE;
+  mMedia.LastBlock    = TEST_BLOCK_COUNT - 1;
+
+  ZeroMem (&mBlockIo, sizeof (mBlockIo));
+  mBlockIo.Media      = &mMedia;
+  mBlockIo.ReadBlocks = EmulatedReadBlocks;
+
+  ZeroMem (&mBootServices, sizeof (mBootServices));
+  mBootServices.RaiseTPL   = EmulatedRaiseTpl;
+  mBootServices.RestoreTPL = EmulatedRestoreTpl;
+
+  mDiskIoCacheReadyToBoot = FALSE;
+  DiskIoCacheInitialize (&mCache, &mBlockIo);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the cache of the disk.
+
+  @param[in]  Context  Not used.
+
+**/
+VOID
+EFIAPI
+CacheTestCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DiskIoCacheFree (&mCache);
+}
+
+/**
+  Small reads of the same sectors are read from the disk once.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The reads hit the cache.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+RepeatedReadsHit (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  UT_ASSERT_NOT_NULL (mCache.Entries);
+
+  for (Index = 0; Index < 20; Index++) {
+    UT_ASSERT_TRUE (ReadAndCheck (TEST_LINE_SIZE + 3 + Index * 17, 100));
+    UT_ASSERT_TRUE (ReadAndCheck (TEST_LINE_SIZE + 512, 92));
+  }
+
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.ReadBlocksCalls, 1);
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.BlocksRead, TEST_LINE_SIZE / TEST_BLOCK_SIZE);
+  UT_ASSERT_EQUAL (mCache.Statistics.Misses, 1);
+  UT_ASSERT_EQUAL (mCache.Statistics.Hits, 39);
+
+  //
+  // A read across two lines reads the missing line only.
+  //
+  UT_ASSERT_TRUE (ReadAndCheck (2 * TEST_LINE_SIZE - 10, 20));
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.ReadBlocksCalls, 2);
+  UT_ASSERT_EQUAL (mCache.Statistics.Misses, 2);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Sequential reads read ahead, doubling the number of lines read up to
+  DISK_IO_CACHE_READ_AHEAD_LINES.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The reads were served with fewer BlockIo reads.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+SequentialReadsReadAhead (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Line;
+
+  for (Line = 0; Line < 23; Line++) {
+    UT_ASSERT_TRUE (ReadAndCheck (Line * TEST_LINE_SIZE + 100, 1000));
+  }
+
+  //
+  // Lines 0, 1-2, 3-6, 7-14 and 15-22.
+  //
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.ReadBlocksCalls, 5);
+  UT_ASSERT_EQUAL (mCache.Statistics.Misses, 5);
+  UT_ASSERT_EQUAL (mCache.Statistics.ReadAheadLines, 18);
+  UT_ASSERT_EQUAL (mCache.Statistics.Hits, 18);
+
+  //
+  // A random read does not read ahead.
+  //
+  UT_ASSERT_TRUE (ReadAndCheck (100 * TEST_LINE_SIZE, 512));
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.BlocksRead, 23 * TEST_LINE_SIZE / TEST_BLOCK_SIZE + TEST_LINE_SIZE / TEST_BLOCK_SIZE);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Writes, flushes and media changes drop the cached lines.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             Reads after the change returned the new data.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+CacheInvalidation (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8  Buffer[16];
+
+  UT_ASSERT_TRUE (ReadAndCheck (0, 2 * TEST_LINE_SIZE));
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.ReadBlocksCalls, 1);
+
+  //
+  // A write in the second line drops it only.
+  //
+  SetMem (mDisk + TEST_LINE_SIZE + 10, 4, 0xA5);
+  DiskIoCacheInvalidate (&mCache, TEST_LINE_SIZE + 10, 4);
+  UT_ASSERT_EQUAL (mCache.Statistics.Invalidations, 1);
+  UT_ASSERT_TRUE (ReadAndCheck (0, 2 * TEST_LINE_SIZE));
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.ReadBlocksCalls, 2);
+
+  //
+  // A flush drops every line.
+  //
+  DiskIoCacheInvalidateAll (&mCache);
+  UT_ASSERT_EQUAL (mCache.Statistics.Invalidations, 3);
+  UT_ASSERT_TRUE (ReadAndCheck (0, 2 * TEST_LINE_SIZE));
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.ReadBlocksCalls, 3);
+
+  //
+  // A new medium is left to the device to report, then cached again.
+  //
+  mMedia.MediaId++;
+  SetMem (mDisk, TEST_LINE_SIZE, 0x5A);
+  UT_ASSERT_FALSE (DiskIoCacheRead (&mCache, mMedia.MediaId - 1, 0, sizeof (Buffer), Buffer));
+  UT_ASSERT_EQUAL (mCache.Statistics.Invalidations, 5);
+  UT_ASSERT_TRUE (ReadAndCheck (0, 16));
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.ReadBlocksCalls, 4);
+
+  //
+  // A medium removed.
+  //
+  mMedia.MediaPresent = FALSE;
+  UT_ASSERT_FALSE (ReadAndCheck (0, 16));
+  UT_ASSERT_EQUAL (mCache.Statistics.Invalidations, 6);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Large reads, reads of the partial last line and reads with a stale media ID
+  are not served by the cache.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The reads were bypassed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+CacheBypass (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8  Buffer[16];
+
+  UT_ASSERT_FALSE (ReadAndCheck (0, DISK_IO_CACHE_READ_AHEAD_LINES * TEST_LINE_SIZE + 1));
+  UT_ASSERT_FALSE (ReadAndCheck ((TEST_BLOCK_COUNT - 1) * TEST_BLOCK_SIZE, TEST_BLOCK_SIZE));
+  UT_ASSERT_FALSE (DiskIoCacheRead (&mCache, mMedia.MediaId + 1, 0, sizeof (Buffer), Buffer));
+  UT_ASSERT_FALSE (DiskIoCacheRead (&mCache, mMedia.MediaId, MAX_UINT64 - 4, sizeof (Buffer), Buffer));
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.ReadBlocksCalls, 0);
+  UT_ASSERT_EQUAL (mCache.Statistics.Bypassed, 4);
+
+  //
+  // The last whole line is cached, and read-ahead stops at the end of the media.
+  //
+  UT_ASSERT_TRUE (ReadAndCheck ((TEST_BLOCK_COUNT / 8 - 2) * TEST_LINE_SIZE, 16));
+  UT_ASSERT_TRUE (ReadAndCheck ((TEST_BLOCK_COUNT / 8 - 1) * TEST_LINE_SIZE, 16));
+  UT_ASSERT_EQUAL (mEmulatedBlockIo.ReadBlocksCalls, 2);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The ReadyToBoot event frees the caches, and no cache is created after it.
+
+  @param[in]  Context  Not used.
+
+  @retval UNIT_TEST_PASSED             The caches were dropped.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+CacheDroppedAtReadyToBoot (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UT_ASSERT_TRUE (ReadAndCheck (0, 16));
+
+  DiskIoCacheOnReadyToBoot (NULL, NULL);
+  UT_ASSERT_EQUAL (mCache.Entries, NULL);
+  UT_ASSERT_FALSE (ReadAndCheck (0, 16));
+
+  DiskIoCacheInitialize (&mCache, &mBlockIo);
+  UT_ASSERT_EQUAL (mCache.Entries, NULL);
+
+  //
+  // Partitions are cached through their parent.
+  //
+  mDiskIoCacheReadyToBoot = FALSE;
+  mMedia.LogicalPartition = TRUE;
+  DiskIoCacheInitialize (&mCache, &mBlockIo);
+  UT_ASSERT_EQUAL (mCache.Entries, NULL);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the block
+  cache of DiskIoDxe and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+DiskIoCacheUnitTestEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      CacheTestSuite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &CacheTestSuite,
+             Framework,
+             "Disk I/O Block Cache Test Suite",
+             "Disk.Io.Cache",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for CacheTestSuite. Status = %r\n", Status));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (CacheTestSuite, "Repeated small reads hit the cache", "RepeatedReadsHit", RepeatedReadsHit, CacheTestSetup, CacheTestCleanup, NULL);
+  AddTestCase (CacheTestSuite, "Sequential reads read ahead", "SequentialReadsReadAhead", SequentialReadsReadAhead, CacheTestSetup, CacheTestCleanup, NULL);
+  AddTestCase (CacheTestSuite, "Writes, flushes and media changes drop lines", "CacheInvalidation", CacheInvalidation, CacheTestSetup, CacheTestCleanup, NULL);
+  AddTestCase (CacheTestSuite, "Some reads bypass the cache", "CacheBypass", CacheBypass, CacheTestSetup, CacheTestCleanup, NULL);
+  AddTestCase (CacheTestSuite, "ReadyToBoot drops the caches", "CacheDroppedAtReadyToBoot", CacheDroppedAtReadyToBoot, CacheTestSetup, CacheTestCleanup, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return DiskIoCacheUnitTestEntry ();
+}
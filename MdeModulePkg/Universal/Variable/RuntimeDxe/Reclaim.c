@@ -155,3 +155,194 @@ FtwVariableSpace (
 
   return Status;
 }
+
+// MU_CHANGE [BEGIN] - Incremental variable reclaim
+
+/**
+  Find the blocks of a variable store that differ between two images of it.
+
+  @param[in]  Current      The store as it is now.
+  @param[in]  Updated      The store as it should be.
+  @param[in]  Size         Size of the store.
+  @param[in]  BlockOffset  Offset of the store in its first block.
+  @param[in]  BlockSize    Size of the blocks.
+  @param[out] Start        Returns the offset in the store of the first changed block,
+                           clipped to the store.
+  @param[out] End          Returns the offset in the store of the end of the last
+                           changed block, clipped to the store. Equal to Start if
+                           nothing changed.
+
+**/
+VOID
+GetChangedVariableSpace (
+  IN  CONST UINT8  *Current,
+  IN  CONST UINT8  *Updated,
+  IN  UINTN        Size,
+  IN  UINTN        BlockOffset,
+  IN  UINTN        BlockSize,
+  OUT UINTN        *Start,
+  OUT UINTN        *End
+  )
+{
+  UINTN  BlockStart;
+  UINTN  BlockEnd;
+
+  ASSERT (BlockSize != 0);
+
+  *Start = 0;
+  *End   = 0;
+  for (BlockStart = 0; BlockStart < Size; BlockStart = BlockEnd) {
+    BlockEnd = MIN (Size, ((BlockOffset + BlockStart) / BlockSize + 1) * BlockSize - BlockOffset);
+    if (CompareMem (Current + BlockStart, Updated + BlockStart, BlockEnd - BlockStart) != 0) {
+      if (*End == 0) {
+        *Start = BlockStart;
+      }
+
+      *End = BlockEnd;
+    }
+  }
+
+  if (*End == 0) {
+    *Start = 0;
+  }
+}
+
+/**
+  Writes a reclaimed variable store over the variable storage space.
+
+  If PcdVariableIncrementalReclaimEnable is TRUE, only the span of blocks that
+  differ from the store in flash is written, in a single Fault Tolerant Write
+  so that the update stays atomic. Otherwise the whole store is written, like
+  FtwVariableSpace().
+
+  @param[in]  VariableBase    Base address of the variable store.
+  @param[in]  VariableBuffer  The reclaimed variable store.
+  @param[out] BytesWritten    Returns the number of bytes written.
+  @param[out] BytesErased     Returns the size of the blocks the write erased.
+
+  @retval EFI_SUCCESS    The function completed successfully.
+  @retval EFI_NOT_FOUND  Fail to locate Fault Tolerant Write protocol.
+  @retval EFI_ABORTED    The function could not complete successfully.
+
+**/
+EFI_STATUS
+FtwReclaimedVariableSpace (
+  IN  EFI_PHYSICAL_ADDRESS   VariableBase,
+  IN  VARIABLE_STORE_HEADER  *VariableBuffer,
+  OUT UINTN                  *BytesWritten,
+  OUT UINTN                  *BytesErased
+  )
+{
+  EFI_STATUS                          Status;
+  EFI_HANDLE                          FvbHandle;
+  EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb;
+  EFI_LBA                             VarLba;
+  UINTN                               VarOffset;
+  UINTN                               BlockSize;
+  UINTN                               NumberOfBlocks;
+  UINTN                               Start;
+  UINTN                               End;
+  EFI_FAULT_TOLERANT_WRITE_PROTOCOL   *FtwProtocol;
+
+  *BytesWritten = 0;
+  *BytesErased  = 0;
+
+  Status = GetFtwProtocol ((VOID **)&FtwProtocol);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = GetFvbInfoByAddress (VariableBase, &FvbHandle, &Fvb);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = GetLbaAndOffsetByAddress (VariableBase, &VarLba, &VarOffset);
+  if (EFI_ERROR (Status)) {
+    return EFI_ABORTED;
+  }
+
+  //
+  // GetLbaAndOffsetByAddress() already assumes that all the blocks of the FV
+  // have the same size.
+  //
+  Status = Fvb->GetBlockSize (Fvb, VarLba, &BlockSize, &NumberOfBlocks);
+  if (EFI_ERROR (Status) || (BlockSize == 0)) {
+    return EFI_ABORTED;
+  }
+
+  ASSERT (((VARIABLE_STORE_HEADER *)(UINTN)VariableBase)->Size == VariableBuffer->Size);
+
+  if (FeaturePcdGet (PcdVariableIncrementalReclaimEnable)) {
+    //
+    // Reclaim keeps the variables in order, so the blocks before the first
+    // deleted variable are unchanged, and the blocks past the end of both the
+    // old and the new variables are still erased.
+    //
+    GetChangedVariableSpace (
+      (UINT8 *)(UINTN)VariableBase,
+      (UINT8 *)VariableBuffer,
+      VariableBuffer->Size,
+      VarOffset,
+      BlockSize,
+      &Start,
+      &End
+      );
+    if (Start == End) {
+      return EFI_SUCCESS;
+    }
+  } else {
+    Start = 0;
+    End   = VariableBuffer->Size;
+  }
+
+  Status = FtwProtocol->Write (
+                          FtwProtocol,
+                          VarLba + (VarOffset + Start) / BlockSize, // LBA
+                          (VarOffset + Start) % BlockSize,          // Offset
+                          End - Start,                              // NumBytes
+                          NULL,                                     // PrivateData NULL
+                          FvbHandle,                                // Fvb Handle
+                          (UINT8 *)VariableBuffer + Start           // write buffer
+                          );
+  if (!EFI_ERROR (Status)) {
+    *BytesWritten = End - Start;
+    *BytesErased  = ((VarOffset + End + BlockSize - 1) / BlockSize - (VarOffset + Start) / BlockSize) * BlockSize;
+  }
+
+  return Status;
+}
+
+/**
+  Record the flash work done by a reclaim of the non-volatile variable store.
+
+  @param[in] BytesWritten  Bytes written by the reclaim.
+  @param[in] BytesErased   Bytes erased by the reclaim.
+
+**/
+VOID
+RecordReclaimStatistics (
+  IN UINTN  BytesWritten,
+  IN UINTN  BytesErased
+  )
+{
+  VARIABLE_RECLAIM_STATISTICS  *Statistics;
+
+  Statistics = &mVariableModuleGlobal->ReclaimStatistics;
+  Statistics->ReclaimCount++;
+  Statistics->LastBytesWritten   = BytesWritten;
+  Statistics->LastBytesErased    = BytesErased;
+  Statistics->TotalBytesWritten += BytesWritten;
+  Statistics->TotalBytesErased  += BytesErased;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a Reclaim %u wrote 0x%Lx bytes, erased 0x%Lx bytes.\n",
+    __func__,
+    Statistics->ReclaimCount,
+    (UINT64)BytesWritten,
+    (UINT64)BytesErased
+    ));
+}
+
+// MU_CHANGE [END]
@@ -11,8 +11,11 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/UnitTestLib.h>
 #include <Library/DebugLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/PrintLib.h>  // MU_CHANGE
 
 #include "../Variable.h"
+#include "../VariableParsing.h"   // MU_CHANGE
+#include "../VariableIndex.h"     // MU_CHANGE
 #include "BlackBoxTest/VariableServicesBBTestMain.h"
 
 #define UNIT_TEST_NAME     "RuntimeVariableDxe Host-Based Unit Test"
@@ -245,6 +248,163 @@ ReleaseLockOnlyAtBootTime (
   }
 }
 
+// MU_CHANGE [BEGIN] - Incremental variable reclaim
+#define MOCK_FLASH_BLOCK_SIZE  0x100
+#define MOCK_FLASH_BLOCKS      18
+
+//
+// A firmware volume in memory, and the last Fault Tolerant Write to it. The FTW
+// and FVB protocols are only available while mMockFlash is set.
+//
+UINT8    *mMockFlash = NULL;
+UINTN    mMockFtwWrites;
+EFI_LBA  mMockFtwLba;
+UINTN    mMockFtwOffset;
+UINTN    mMockFtwLength;
+
+EFI_STATUS
+EFIAPI
+MockFvbGetAttributes (
+  IN  CONST EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  OUT EFI_FVB_ATTRIBUTES_2                      *Attributes
+  )
+{
+  *Attributes = EFI_FVB2_READ_STATUS | EFI_FVB2_WRITE_STATUS;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MockFvbGetPhysicalAddress (
+  IN  CONST EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  OUT EFI_PHYSICAL_ADDRESS                      *Address
+  )
+{
+  *Address = (EFI_PHYSICAL_ADDRESS)(UINTN)mMockFlash;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MockFvbGetBlockSize (
+  IN  CONST EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN  EFI_LBA                                   Lba,
+  OUT UINTN                                     *BlockSize,
+  OUT UINTN                                     *NumberOfBlocks
+  )
+{
+  if (Lba >= MOCK_FLASH_BLOCKS) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *BlockSize      = MOCK_FLASH_BLOCK_SIZE;
+  *NumberOfBlocks = MOCK_FLASH_BLOCKS - (UINTN)Lba;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MockFtwWrite (
+  IN EFI_FAULT_TOLERANT_WRITE_PROTOCOL  *This,
+  IN EFI_LBA                            Lba,
+  IN UINTN                              Offset,
+  IN UINTN                              Length,
+  IN VOID                               *PrivateData,
+  IN EFI_HANDLE                         FvbHandle,
+  IN VOID                               *Buffer
+  )
+{
+  if (Lba * MOCK_FLASH_BLOCK_SIZE + Offset + Length > MOCK_FLASH_BLOCKS * MOCK_FLASH_BLOCK_SIZE) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  mMockFtwWrites++;
+  mMockFtwLba    = Lba;
+  mMockFtwOffset = Offset;
+  mMockFtwLength = Length;
+  CopyMem (mMockFlash + Lba * MOCK_FLASH_BLOCK_SIZE + Offset, Buffer, Length);
+  return EFI_SUCCESS;
+}
+
+EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  mMockFvb = {
+  MockFvbGetAttributes,         // GetAttributes
+  NULL,                         // SetAttributes
+  MockFvbGetPhysicalAddress,    // GetPhysicalAddress
+  MockFvbGetBlockSize,          // GetBlockSize
+  NULL,                         // Read
+  NULL,                         // Write
+  NULL,                         // EraseBlocks
+  NULL                          // ParentHandle
+};
+
+EFI_FAULT_TOLERANT_WRITE_PROTOCOL  mMockFtw = {
+  NULL,            // GetMaxBlockSize
+  NULL,            // Allocate
+  MockFtwWrite,    // Write
+  NULL,            // Restart
+  NULL,            // Abort
+  NULL             // GetLastWrite
+};
+
+/**
+  Create the mock flash, an erased firmware volume with a variable store.
+
+  @param[in] StoreOffset  Offset of the variable store in the firmware volume.
+  @param[in] StoreSize    Size of the variable store.
+
+  @return The variable store, or NULL if the flash could not be allocated.
+**/
+VARIABLE_STORE_HEADER *
+CreateMockFlash (
+  IN UINTN  StoreOffset,
+  IN UINTN  StoreSize
+  )
+{
+  EFI_FIRMWARE_VOLUME_HEADER  *FvHeader;
+  VARIABLE_STORE_HEADER       *Store;
+
+  ASSERT (StoreOffset + StoreSize <= MOCK_FLASH_BLOCKS * MOCK_FLASH_BLOCK_SIZE);
+
+  mMockFlash = AllocatePool (MOCK_FLASH_BLOCKS * MOCK_FLASH_BLOCK_SIZE);
+  if (mMockFlash == NULL) {
+    return NULL;
+  }
+
+  SetMem (mMockFlash, MOCK_FLASH_BLOCKS * MOCK_FLASH_BLOCK_SIZE, 0xFF);
+  FvHeader                        = (EFI_FIRMWARE_VOLUME_HEADER *)mMockFlash;
+  FvHeader->FvLength              = MOCK_FLASH_BLOCKS * MOCK_FLASH_BLOCK_SIZE;
+  FvHeader->HeaderLength          = (UINT16)(sizeof (EFI_FIRMWARE_VOLUME_HEADER) + sizeof (EFI_FV_BLOCK_MAP_ENTRY));
+  FvHeader->BlockMap[0].NumBlocks = MOCK_FLASH_BLOCKS;
+  FvHeader->BlockMap[0].Length    = MOCK_FLASH_BLOCK_SIZE;
+
+  Store = (VARIABLE_STORE_HEADER *)(mMockFlash + StoreOffset);
+  CopyMem (
+    Store,
+    (VOID *)(UINTN)mVariableModuleGlobal->VariableGlobal.VolatileVariableBase,
+    sizeof (VARIABLE_STORE_HEADER)
+    );
+  Store->Size = (UINT32)StoreSize;
+
+  mMockFtwWrites = 0;
+  return Store;
+}
+
+/**
+  Free the mock flash. The FTW and FVB protocols are unavailable again.
+**/
+VOID
+DestroyMockFlash (
+  VOID
+  )
+{
+  if (mMockFlash != NULL) {
+    FreePool (mMockFlash);
+    mMockFlash = NULL;
+  }
+}
+
+// MU_CHANGE [END]
+
 /**
   Retrieve the Fault Tolerent Write protocol interface.
 
@@ -260,6 +420,13 @@ GetFtwProtocol (
   OUT VOID  **FtwProtocol
   )
 {
+  // MU_CHANGE [BEGIN] - Incremental variable reclaim
+  if (mMockFlash != NULL) {
+    *FtwProtocol = &mMockFtw;
+    return EFI_SUCCESS;
+  }
+
+  // MU_CHANGE [END]
   // TODO: Create a mocked version.
   return EFI_UNSUPPORTED;
 }
@@ -285,6 +452,13 @@ GetFvbByHandle (
   //
   // To get the FVB protocol interface on the handle
   //
+  // MU_CHANGE [BEGIN] - Incremental variable reclaim
+  if ((mMockFlash != NULL) && (FvBlockHandle == (EFI_HANDLE)&mMockFvb)) {
+    *FvBlock = &mMockFvb;
+    return EFI_SUCCESS;
+  }
+
+  // MU_CHANGE [END]
   // TODO: Create a mocked version.
   return EFI_UNSUPPORTED;
 }
@@ -313,6 +487,19 @@ GetFvbCountAndBuffer (
   //
   // Locate all handles of Fvb protocol
   //
+  // MU_CHANGE [BEGIN] - Incremental variable reclaim
+  if (mMockFlash != NULL) {
+    *NumberHandles = 1;
+    *Buffer        = AllocatePool (sizeof (EFI_HANDLE));
+    if (*Buffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    (*Buffer)[0] = (EFI_HANDLE)&mMockFvb;
+    return EFI_SUCCESS;
+  }
+
+  // MU_CHANGE [END]
   // TODO: Create a mocked version.
   return EFI_UNSUPPORTED;
 }
@@ -365,6 +552,558 @@ Cleanup:
   return TestResult;
 }
 
+// MU_CHANGE [BEGIN] - Hashed variable lookup index
+#define LOOKUP_INDEX_TEST_VARIABLES  256
+
+STATIC EFI_GUID  mLookupIndexTestGuid = {
+  0x3c5d7f0a, 0x9e61, 0x4b1c, { 0x8a, 0x2f, 0x47, 0x6d, 0x15, 0xe3, 0xb0, 0x9c }
+};
+
+/**
+  Check that lookups served by the variable lookup index find the same headers
+  as a walk of the store, and that they examine fewer headers than the walk.
+
+  The volatile store is indexed. A copy of it is not registered with the index,
+  so looking a variable up in the copy walks the copy.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+LookupIndexTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UNIT_TEST_STATUS           TestResult = UNIT_TEST_PASSED;
+  CHAR16                     Name[32];
+  UINT32                     Data;
+  UINTN                      Index;
+  UINTN                      Created;
+  BOOLEAN                    AuthFormat;
+  VARIABLE_STORE_HEADER      *Store;
+  VARIABLE_STORE_HEADER      *Copy;
+  VARIABLE_POINTER_TRACK     Indexed;
+  VARIABLE_POINTER_TRACK     Walked;
+  EFI_STATUS                 IndexedStatus;
+  EFI_STATUS                 WalkedStatus;
+  VARIABLE_HEADER            *Variable;
+  UINT64                     StoreHeaders;
+  UINT64                     HeadersWalked;
+  VARIABLE_INDEX_STATISTICS  Before;
+  VARIABLE_INDEX_STATISTICS  After;
+
+  Created    = 0;
+  Copy       = NULL;
+  AuthFormat = mVariableModuleGlobal->VariableGlobal.AuthFormat;
+
+  for (Index = 0; Index < LOOKUP_INDEX_TEST_VARIABLES; Index++) {
+    UnicodeSPrint (Name, sizeof (Name), L"LookupIndex%03u", Index);
+    Data = (UINT32)Index;
+    UT_CLEANUP_ASSERT_NOT_EFI_ERROR (
+      VariableServiceSetVariable (Name, &mLookupIndexTestGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, sizeof (Data), &Data)
+      );
+    Created++;
+  }
+
+  //
+  // Update some of the variables so that the store also holds deleted headers.
+  //
+  for (Index = 0; Index < LOOKUP_INDEX_TEST_VARIABLES; Index += 7) {
+    UnicodeSPrint (Name, sizeof (Name), L"LookupIndex%03u", Index);
+    Data = ~(UINT32)Index;
+    UT_CLEANUP_ASSERT_NOT_EFI_ERROR (
+      VariableServiceSetVariable (Name, &mLookupIndexTestGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, sizeof (Data), &Data)
+      );
+  }
+
+  Store = (VARIABLE_STORE_HEADER *)(UINTN)mVariableModuleGlobal->VariableGlobal.VolatileVariableBase;
+  Copy  = AllocateCopyPool (Store->Size, Store);
+  UT_CLEANUP_ASSERT_NOT_NULL (Copy);
+
+  StoreHeaders = 0;
+  for (Variable = GetStartPointer (Copy); IsValidVariableHeader (Variable, GetEndPointer (Copy)); Variable = GetNextVariablePtr (Variable, AuthFormat)) {
+    StoreHeaders++;
+  }
+
+  VariableIndexGetStatistics (&Before);
+  HeadersWalked = 0;
+
+  //
+  // The last name was never set, so it also checks a lookup that fails.
+  //
+  for (Index = 0; Index <= LOOKUP_INDEX_TEST_VARIABLES; Index++) {
+    UnicodeSPrint (Name, sizeof (Name), L"LookupIndex%03u", Index);
+
+    Indexed.StartPtr = GetStartPointer (Store);
+    Indexed.EndPtr   = GetEndPointer (Store);
+    IndexedStatus    = FindVariableEx (Name, &mLookupIndexTestGuid, FALSE, &Indexed, AuthFormat);
+
+    Walked.StartPtr = GetStartPointer (Copy);
+    Walked.EndPtr   = GetEndPointer (Copy);
+    WalkedStatus    = FindVariableEx (Name, &mLookupIndexTestGuid, FALSE, &Walked, AuthFormat);
+
+    UT_CLEANUP_ASSERT_STATUS_EQUAL (IndexedStatus, WalkedStatus);
+    if (EFI_ERROR (WalkedStatus)) {
+      UT_CLEANUP_ASSERT_EQUAL (Index, LOOKUP_INDEX_TEST_VARIABLES);
+      HeadersWalked += StoreHeaders;
+      continue;
+    }
+
+    UT_CLEANUP_ASSERT_EQUAL ((UINTN)Indexed.CurrPtr - (UINTN)Store, (UINTN)Walked.CurrPtr - (UINTN)Copy);
+    UT_CLEANUP_ASSERT_EQUAL (Indexed.InDeletedTransitionPtr == NULL, Walked.InDeletedTransitionPtr == NULL);
+    for (Variable = Walked.StartPtr; Variable != Walked.CurrPtr; Variable = GetNextVariablePtr (Variable, AuthFormat)) {
+      HeadersWalked++;
+    }
+
+    HeadersWalked++;
+  }
+
+  VariableIndexGetStatistics (&After);
+  UT_LOG_INFO (
+    "Lookup index: %ld lookups examined %ld entries, a store walk examined %ld headers\n",
+    After.Lookups - Before.Lookups,
+    After.EntriesVisited - Before.EntriesVisited,
+    HeadersWalked
+    );
+
+  UT_CLEANUP_ASSERT_EQUAL (After.Lookups - Before.Lookups, LOOKUP_INDEX_TEST_VARIABLES + 1);
+  UT_CLEANUP_ASSERT_EQUAL (After.Fallbacks, Before.Fallbacks);
+  UT_CLEANUP_ASSERT_TRUE (After.EntriesVisited - Before.EntriesVisited < HeadersWalked);
+
+Cleanup:
+  if (Copy != NULL) {
+    FreePool (Copy);
+  }
+
+  for (Index = 0; Index < Created; Index++) {
+    UnicodeSPrint (Name, sizeof (Name), L"LookupIndex%03u", Index);
+    VariableServiceSetVariable (Name, &mLookupIndexTestGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, 0, NULL);
+  }
+
+  return TestResult;
+}
+
+/**
+  Check that the index of a store registered with DetectRewrite notices when
+  the store is overwritten by a compacted copy, as the MM variable driver does
+  to the runtime caches after a reclaim, and that the index leaves the store
+  header alone.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+LookupIndexRewriteTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UNIT_TEST_STATUS           TestResult = UNIT_TEST_PASSED;
+  CHAR16                     Name[32];
+  UINT32                     Data;
+  UINTN                      Index;
+  UINTN                      Created;
+  UINTN                      Size;
+  BOOLEAN                    AuthFormat;
+  VARIABLE_STORE_HEADER      *Store;
+  VARIABLE_STORE_HEADER      *Cache;
+  VARIABLE_STORE_HEADER      *Compacted;
+  VARIABLE_HEADER            *Variable;
+  UINT8                      *Next;
+  VARIABLE_POINTER_TRACK     Indexed;
+  VARIABLE_POINTER_TRACK     Walked;
+  EFI_STATUS                 IndexedStatus;
+  EFI_STATUS                 WalkedStatus;
+  VARIABLE_INDEX_STATISTICS  Before;
+  VARIABLE_INDEX_STATISTICS  After;
+
+  Created    = 0;
+  Cache      = NULL;
+  Compacted  = NULL;
+  AuthFormat = mVariableModuleGlobal->VariableGlobal.AuthFormat;
+
+  for (Index = 0; Index < LOOKUP_INDEX_TEST_VARIABLES; Index++) {
+    UnicodeSPrint (Name, sizeof (Name), L"LookupIndex%03u", Index);
+    Data = (UINT32)Index;
+    UT_CLEANUP_ASSERT_NOT_EFI_ERROR (
+      VariableServiceSetVariable (Name, &mLookupIndexTestGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, sizeof (Data), &Data)
+      );
+    Created++;
+  }
+
+  for (Index = 0; Index < LOOKUP_INDEX_TEST_VARIABLES; Index += 7) {
+    UnicodeSPrint (Name, sizeof (Name), L"LookupIndex%03u", Index);
+    Data = ~(UINT32)Index;
+    UT_CLEANUP_ASSERT_NOT_EFI_ERROR (
+      VariableServiceSetVariable (Name, &mLookupIndexTestGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, sizeof (Data), &Data)
+      );
+  }
+
+  Store = (VARIABLE_STORE_HEADER *)(UINTN)mVariableModuleGlobal->VariableGlobal.VolatileVariableBase;
+  Cache = AllocateCopyPool (Store->Size, Store);
+  UT_CLEANUP_ASSERT_NOT_NULL (Cache);
+  VariableIndexRegister (Cache, AuthFormat, TRUE);
+
+  //
+  // Index the whole cache.
+  //
+  Indexed.StartPtr = GetStartPointer (Cache);
+  Indexed.EndPtr   = GetEndPointer (Cache);
+  UT_CLEANUP_ASSERT_NOT_EFI_ERROR (FindVariableEx (L"LookupIndex000", &mLookupIndexTestGuid, FALSE, &Indexed, AuthFormat));
+  UT_CLEANUP_ASSERT_MEM_EQUAL (Cache, Store, sizeof (VARIABLE_STORE_HEADER));
+
+  //
+  // Drop the deleted headers, which moves every variable after the first one.
+  //
+  Compacted = AllocatePool (Store->Size);
+  UT_CLEANUP_ASSERT_NOT_NULL (Compacted);
+  SetMem (Compacted, Store->Size, 0xFF);
+  CopyMem (Compacted, Store, sizeof (VARIABLE_STORE_HEADER));
+  Next = (UINT8 *)GetStartPointer (Compacted);
+  for (Variable = GetStartPointer (Store); IsValidVariableHeader (Variable, GetEndPointer (Store)); Variable = GetNextVariablePtr (Variable, AuthFormat)) {
+    if (Variable->State == VAR_ADDED) {
+      Size = (UINTN)GetNextVariablePtr (Variable, AuthFormat) - (UINTN)Variable;
+      CopyMem (Next, Variable, Size);
+      Next += Size;
+    }
+  }
+
+  CopyMem (Cache, Compacted, Store->Size);
+
+  VariableIndexGetStatistics (&Before);
+  for (Index = 0; Index <= LOOKUP_INDEX_TEST_VARIABLES; Index++) {
+    UnicodeSPrint (Name, sizeof (Name), L"LookupIndex%03u", Index);
+
+    Indexed.StartPtr = GetStartPointer (Cache);
+    Indexed.EndPtr   = GetEndPointer (Cache);
+    IndexedStatus    = FindVariableEx (Name, &mLookupIndexTestGuid, FALSE, &Indexed, AuthFormat);
+
+    Walked.StartPtr = GetStartPointer (Compacted);
+    Walked.EndPtr   = GetEndPointer (Compacted);
+    WalkedStatus    = FindVariableEx (Name, &mLookupIndexTestGuid, FALSE, &Walked, AuthFormat);
+
+    UT_CLEANUP_ASSERT_STATUS_EQUAL (IndexedStatus, WalkedStatus);
+    if (!EFI_ERROR (WalkedStatus)) {
+      UT_CLEANUP_ASSERT_EQUAL ((UINTN)Indexed.CurrPtr - (UINTN)Cache, (UINTN)Walked.CurrPtr - (UINTN)Compacted);
+    }
+  }
+
+  VariableIndexGetStatistics (&After);
+  UT_CLEANUP_ASSERT_EQUAL (After.Rebuilds - Before.Rebuilds, 1);
+  UT_CLEANUP_ASSERT_EQUAL (After.Lookups - Before.Lookups, LOOKUP_INDEX_TEST_VARIABLES + 1);
+  UT_CLEANUP_ASSERT_MEM_EQUAL (Cache, Compacted, Store->Size);
+
+Cleanup:
+  if (Cache != NULL) {
+    VariableIndexUnregister (Cache);
+    FreePool (Cache);
+  }
+
+  if (Compacted != NULL) {
+    FreePool (Compacted);
+  }
+
+  for (Index = 0; Index < Created; Index++) {
+    UnicodeSPrint (Name, sizeof (Name), L"LookupIndex%03u", Index);
+    VariableServiceSetVariable (Name, &mLookupIndexTestGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, 0, NULL);
+  }
+
+  return TestResult;
+}
+
+// MU_CHANGE [END]
+
+// MU_CHANGE [BEGIN] - Incremental variable reclaim
+
+/**
+  Check that an incremental reclaim only rewrites the blocks that changed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+ChangedVariableSpaceTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8  Current[0x100];
+  UINT8  Updated[0x100];
+  UINTN  Start;
+  UINTN  End;
+
+  SetMem (Current, sizeof (Current), 0xA5);
+  CopyMem (Updated, Current, sizeof (Updated));
+
+  //
+  // The store starts 0x10 bytes into a 0x40 byte block, so its blocks cover the
+  // store offsets 0x0-0x30, 0x30-0x70, 0x70-0xB0, 0xB0-0xF0 and 0xF0-0x100.
+  //
+  GetChangedVariableSpace (Current, Updated, sizeof (Current), 0x10, 0x40, &Start, &End);
+  UT_ASSERT_EQUAL (Start, End);
+
+  Updated[0x31] = 0;
+  Updated[0x90] = 0;
+  GetChangedVariableSpace (Current, Updated, sizeof (Current), 0x10, 0x40, &Start, &End);
+  UT_ASSERT_EQUAL (Start, 0x30);
+  UT_ASSERT_EQUAL (End, 0xB0);
+
+  Updated[0x2F] = 0;
+  Updated[0xFF] = 0;
+  GetChangedVariableSpace (Current, Updated, sizeof (Current), 0x10, 0x40, &Start, &End);
+  UT_ASSERT_EQUAL (Start, 0);
+  UT_ASSERT_EQUAL (End, sizeof (Current));
+
+  return UNIT_TEST_PASSED;
+}
+
+#define RECLAIM_TEST_STORE_OFFSET  0x90
+#define RECLAIM_TEST_VARIABLES     8
+#define RECLAIM_TEST_UPDATED       3
+
+STATIC EFI_GUID  mReclaimTestGuid = {
+  0x7f2e4b19, 0xc3a8, 0x4d5e, { 0x91, 0x6b, 0x2a, 0xd0, 0x58, 0xe7, 0x14, 0xc3 }
+};
+
+/**
+  Check that writing a reclaimed store only writes the span of the blocks that
+  changed, with a single Fault Tolerant Write.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IncrementalReclaimWriteTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UNIT_TEST_STATUS       TestResult = UNIT_TEST_PASSED;
+  VARIABLE_STORE_HEADER  *Store;
+  UINT8                  *Buffer;
+  UINTN                  BytesWritten;
+  UINTN                  BytesErased;
+
+  Buffer = NULL;
+  Store  = CreateMockFlash (RECLAIM_TEST_STORE_OFFSET, 0x500);
+  UT_CLEANUP_ASSERT_NOT_NULL (Store);
+  SetMem ((UINT8 *)(Store + 1), 0x300 - sizeof (VARIABLE_STORE_HEADER), 0xA5);
+
+  Buffer = AllocateCopyPool (Store->Size, Store);
+  UT_CLEANUP_ASSERT_NOT_NULL (Buffer);
+
+  //
+  // An unchanged store is not written.
+  //
+  UT_CLEANUP_ASSERT_NOT_EFI_ERROR (FtwReclaimedVariableSpace ((UINTN)Store, (VARIABLE_STORE_HEADER *)Buffer, &BytesWritten, &BytesErased));
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwWrites, 0);
+  UT_CLEANUP_ASSERT_EQUAL (BytesWritten, 0);
+  UT_CLEANUP_ASSERT_EQUAL (BytesErased, 0);
+
+  //
+  // The store starts 0x90 bytes into the first block, so the store offsets
+  // 0x170-0x270 are the third block.
+  //
+  Buffer[0x200] = 0;
+  Buffer[0x210] = 0;
+  UT_CLEANUP_ASSERT_NOT_EFI_ERROR (FtwReclaimedVariableSpace ((UINTN)Store, (VARIABLE_STORE_HEADER *)Buffer, &BytesWritten, &BytesErased));
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwWrites, 1);
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwLba, 2);
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwOffset, 0);
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwLength, MOCK_FLASH_BLOCK_SIZE);
+  UT_CLEANUP_ASSERT_EQUAL (BytesWritten, MOCK_FLASH_BLOCK_SIZE);
+  UT_CLEANUP_ASSERT_EQUAL (BytesErased, MOCK_FLASH_BLOCK_SIZE);
+  UT_CLEANUP_ASSERT_MEM_EQUAL (Store, Buffer, Store->Size);
+
+  //
+  // Changes in the first and the last block of the store write all of it.
+  //
+  Buffer[0x60]  = 0;
+  Buffer[0x4F0] = 0;
+  UT_CLEANUP_ASSERT_NOT_EFI_ERROR (FtwReclaimedVariableSpace ((UINTN)Store, (VARIABLE_STORE_HEADER *)Buffer, &BytesWritten, &BytesErased));
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwWrites, 2);
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwLba, 0);
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwOffset, RECLAIM_TEST_STORE_OFFSET);
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwLength, Store->Size);
+  UT_CLEANUP_ASSERT_EQUAL (BytesWritten, Store->Size);
+
+  //
+  // The write also erases the parts of the first and last blocks outside the store.
+  //
+  UT_CLEANUP_ASSERT_EQUAL (BytesErased, ALIGN_VALUE (RECLAIM_TEST_STORE_OFFSET + Store->Size, MOCK_FLASH_BLOCK_SIZE));
+  UT_CLEANUP_ASSERT_MEM_EQUAL (Store, Buffer, Store->Size);
+
+Cleanup:
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+
+  DestroyMockFlash ();
+  return TestResult;
+}
+
+/**
+  Check that a reclaim of the non-volatile store keeps the variables ahead of
+  the first deleted one in place, compacts the rest, and only writes the blocks
+  from the first deleted variable to the old end of the store.
+
+  The host test runs in emulated NV mode, so the store is built in the mock
+  flash from volatile variables, and the NV cache and the driver globals are
+  swapped for the duration of the test.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IncrementalReclaimTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UNIT_TEST_STATUS        TestResult = UNIT_TEST_PASSED;
+  CHAR16                  Name[32];
+  UINT8                   Data[0x40];
+  UINTN                   Index;
+  UINTN                   Created;
+  BOOLEAN                 AuthFormat;
+  VARIABLE_STORE_HEADER   *Volatile;
+  VARIABLE_STORE_HEADER   *Store;
+  VARIABLE_STORE_HEADER   *Cache;
+  VARIABLE_STORE_HEADER   *SavedCache;
+  VARIABLE_MODULE_GLOBAL  SavedGlobal;
+  BOOLEAN                 Swapped;
+  VARIABLE_HEADER         *Variable;
+  VARIABLE_HEADER         *NextVariable;
+  UINT8                   *CurrPtr;
+  UINTN                   DeletedOffset;
+  UINTN                   OldEnd;
+  UINTN                   LastVariableOffset;
+  UINTN                   Start;
+  UINTN                   End;
+  UINTN                   Count;
+  UINTN                   Expected;
+
+  Created    = 0;
+  Cache      = NULL;
+  SavedCache = mNvVariableCache;
+  Swapped    = FALSE;
+  AuthFormat = mVariableModuleGlobal->VariableGlobal.AuthFormat;
+
+  for (Index = 0; Index < RECLAIM_TEST_VARIABLES; Index++) {
+    UnicodeSPrint (Name, sizeof (Name), L"Reclaim%u", Index);
+    SetMem (Data, sizeof (Data), (UINT8)Index);
+    UT_CLEANUP_ASSERT_NOT_EFI_ERROR (
+      VariableServiceSetVariable (Name, &mReclaimTestGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, sizeof (Data), Data)
+      );
+    Created++;
+  }
+
+  //
+  // Updating a variable deletes its header and adds a new one at the end.
+  //
+  UnicodeSPrint (Name, sizeof (Name), L"Reclaim%u", RECLAIM_TEST_UPDATED);
+  SetMem (Data, sizeof (Data), 0xEE);
+  UT_CLEANUP_ASSERT_NOT_EFI_ERROR (
+    VariableServiceSetVariable (Name, &mReclaimTestGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, sizeof (Data), Data)
+    );
+
+  //
+  // Copy the headers of the test variables to a store in the mock flash.
+  //
+  Store = CreateMockFlash (RECLAIM_TEST_STORE_OFFSET, 0x1000);
+  UT_CLEANUP_ASSERT_NOT_NULL (Store);
+
+  Volatile      = (VARIABLE_STORE_HEADER *)(UINTN)mVariableModuleGlobal->VariableGlobal.VolatileVariableBase;
+  CurrPtr       = (UINT8 *)GetStartPointer (Store);
+  DeletedOffset = 0;
+  for (Variable = GetStartPointer (Volatile); IsValidVariableHeader (Variable, GetEndPointer (Volatile)); Variable = NextVariable) {
+    NextVariable = GetNextVariablePtr (Variable, AuthFormat);
+    if (!CompareGuid (GetVendorGuidPtr (Variable, AuthFormat), &mReclaimTestGuid)) {
+      continue;
+    }
+
+    if ((Variable->State != VAR_ADDED) && (DeletedOffset == 0)) {
+      DeletedOffset = (UINTN)CurrPtr - (UINTN)Store;
+    }
+
+    CopyMem (CurrPtr, Variable, (UINTN)NextVariable - (UINTN)Variable);
+    CurrPtr += (UINTN)NextVariable - (UINTN)Variable;
+  }
+
+  OldEnd = (UINTN)CurrPtr - (UINTN)Store;
+  UT_CLEANUP_ASSERT_NOT_EQUAL (DeletedOffset, 0);
+  UT_CLEANUP_ASSERT_TRUE (OldEnd < Store->Size);
+
+  Cache = AllocateCopyPool (Store->Size, Store);
+  UT_CLEANUP_ASSERT_NOT_NULL (Cache);
+
+  //
+  // Reclaim the store as the NV store of a driver on real flash.
+  //
+  CopyMem (&SavedGlobal, mVariableModuleGlobal, sizeof (SavedGlobal));
+  Swapped                                         = TRUE;
+  mNvVariableCache                                = Cache;
+  mVariableModuleGlobal->VariableGlobal.EmuNvMode = FALSE;
+
+  mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache.Store = NULL;
+
+  UT_CLEANUP_ASSERT_NOT_EFI_ERROR (Reclaim ((UINTN)Store, &LastVariableOffset, FALSE, NULL, NULL, 0));
+
+  //
+  // The reclaim accounted for the variables it left in place.
+  //
+  UT_CLEANUP_ASSERT_EQUAL (
+    mVariableModuleGlobal->CommonVariableTotalSize,
+    LastVariableOffset - ((UINTN)GetStartPointer (Store) - (UINTN)Store)
+    );
+  UT_CLEANUP_ASSERT_MEM_EQUAL (Cache, Store, Store->Size);
+
+  //
+  // Only the blocks from the first deleted variable to the old end were written.
+  //
+  Start = (RECLAIM_TEST_STORE_OFFSET + DeletedOffset) / MOCK_FLASH_BLOCK_SIZE * MOCK_FLASH_BLOCK_SIZE - RECLAIM_TEST_STORE_OFFSET;
+  End   = ALIGN_VALUE (RECLAIM_TEST_STORE_OFFSET + OldEnd, MOCK_FLASH_BLOCK_SIZE) - RECLAIM_TEST_STORE_OFFSET;
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwWrites, 1);
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwLba * MOCK_FLASH_BLOCK_SIZE + mMockFtwOffset, RECLAIM_TEST_STORE_OFFSET + Start);
+  UT_CLEANUP_ASSERT_EQUAL (mMockFtwLength, End - Start);
+  UT_CLEANUP_ASSERT_EQUAL (mVariableModuleGlobal->ReclaimStatistics.ReclaimCount, SavedGlobal.ReclaimStatistics.ReclaimCount + 1);
+  UT_CLEANUP_ASSERT_EQUAL (mVariableModuleGlobal->ReclaimStatistics.LastBytesWritten, End - Start);
+  UT_CLEANUP_ASSERT_EQUAL (mVariableModuleGlobal->ReclaimStatistics.LastBytesErased, End - Start);
+  UT_CLEANUP_ASSERT_EQUAL (
+    mVariableModuleGlobal->ReclaimStatistics.TotalBytesWritten,
+    SavedGlobal.ReclaimStatistics.TotalBytesWritten + End - Start
+    );
+
+  //
+  // The updated variable moved to the end, and no deleted header is left.
+  //
+  Count = 0;
+  for (Variable = GetStartPointer (Store); IsValidVariableHeader (Variable, GetEndPointer (Store)); Variable = GetNextVariablePtr (Variable, AuthFormat)) {
+    UT_CLEANUP_ASSERT_EQUAL (Variable->State, VAR_ADDED);
+    if (Count == RECLAIM_TEST_VARIABLES - 1) {
+      Expected = RECLAIM_TEST_UPDATED;
+    } else if (Count >= RECLAIM_TEST_UPDATED) {
+      Expected = Count + 1;
+    } else {
+      Expected = Count;
+    }
+
+    UnicodeSPrint (Name, sizeof (Name), L"Reclaim%u", Expected);
+    UT_CLEANUP_ASSERT_MEM_EQUAL (GetVariableNamePtr (Variable, AuthFormat), Name, StrSize (Name));
+    Count++;
+  }
+
+  UT_CLEANUP_ASSERT_EQUAL (Count, RECLAIM_TEST_VARIABLES);
+  UT_CLEANUP_ASSERT_EQUAL ((UINTN)Variable - (UINTN)Store, LastVariableOffset);
+
+Cleanup:
+  if (Swapped) {
+    CopyMem (mVariableModuleGlobal, &SavedGlobal, sizeof (SavedGlobal));
+  }
+
+  mNvVariableCache = SavedCache;
+  if (Cache != NULL) {
+    FreePool (Cache);
+  }
+
+  DestroyMockFlash ();
+
+  for (Index = 0; Index < Created; Index++) {
+    UnicodeSPrint (Name, sizeof (Name), L"Reclaim%u", Index);
+    VariableServiceSetVariable (Name, &mReclaimTestGuid, EFI_VARIABLE_BOOTSERVICE_ACCESS, 0, NULL);
+  }
+
+  return TestResult;
+}
+
+// MU_CHANGE [END]
+
 #define SCT_TEST_WRAPPER_FUNCTION(TestName)    \
   UNIT_TEST_STATUS                              \
   EFIAPI                                        \
@@ -482,6 +1221,11 @@ UefiTestMain (
   }
 
   AddTestCase (GenericTests, "Dummy Test", "Dummy", DummyTest, NULL, NULL, NULL);
+  AddTestCase (GenericTests, "Lookup Index Test", "LookupIndex", LookupIndexTest, NULL, NULL, NULL);                          // MU_CHANGE
+  AddTestCase (GenericTests, "Lookup Index Rewrite Test", "LookupIndexRewrite", LookupIndexRewriteTest, NULL, NULL, NULL);     // MU_CHANGE
+  AddTestCase (GenericTests, "Changed Variable Space Test", "ChangedVariableSpace", ChangedVariableSpaceTest, NULL, NULL, NULL); // MU_CHANGE
+  AddTestCase (GenericTests, "Incremental Reclaim Write Test", "IncrementalReclaimWrite", IncrementalReclaimWriteTest, NULL, NULL, NULL); // MU_CHANGE
+  AddTestCase (GenericTests, "Incremental Reclaim Test", "IncrementalReclaim", IncrementalReclaimTest, NULL, NULL, NULL);             // MU_CHANGE
 
   //
   // Populate the SCT Conformance TDS 3.1-3.4 Unit Test Suite
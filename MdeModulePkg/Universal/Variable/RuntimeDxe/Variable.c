@@ -29,6 +29,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include "VariableNonVolatile.h"
 #include "VariableParsing.h"
 #include "VariableRuntimeCache.h"
+#include "VariableIndex.h"  // MU_CHANGE
 
 #include <Library/VariablePolicyLib.h>  // MU_CHANGE - Enable simple delete when VarPol is disabled
 
@@ -617,6 +618,8 @@ Reclaim (
   VARIABLE_HEADER        *UpdatingVariable;
   VARIABLE_HEADER        *UpdatingInDeletedTransition;
   BOOLEAN                AuthFormat;
+  UINTN                  BytesWritten; // MU_CHANGE
+  UINTN                  BytesErased;  // MU_CHANGE
 
   AuthFormat                  = mVariableModuleGlobal->VariableGlobal.AuthFormat;
   UpdatingVariable            = NULL;
@@ -681,18 +684,51 @@ Reclaim (
     ValidBuffer       = (UINT8 *)mNvVariableCache;
   }
 
-  SetMem (ValidBuffer, MaximumBufferSize, 0xff);
+  // MU_CHANGE [BEGIN] - Incremental variable reclaim
+  Variable = GetStartPointer (VariableStoreHeader);
+  if (!IsVolatile && !mVariableModuleGlobal->VariableGlobal.EmuNvMode && FeaturePcdGet (PcdVariableIncrementalReclaimEnable)) {
+    //
+    // mNvVariableCache already holds the store, and the variables before the
+    // first deleted or updating one keep their place, so only account for them.
+    //
+    while (IsValidVariableHeader (Variable, GetEndPointer (VariableStoreHeader)) &&
+           (Variable != UpdatingVariable) && (Variable->State == VAR_ADDED))
+    {
+      NextVariable = GetNextVariablePtr (Variable, AuthFormat);
+      VariableSize = (UINTN)NextVariable - (UINTN)Variable;
+      if ((Variable->Attributes & EFI_VARIABLE_HARDWARE_ERROR_RECORD) == EFI_VARIABLE_HARDWARE_ERROR_RECORD) {
+        HwErrVariableTotalSize += VariableSize;
+      } else {
+        CommonVariableTotalSize += VariableSize;
+        if (IsUserVariable (Variable)) {
+          CommonUserVariableTotalSize += VariableSize;
+        }
+      }
+
+      Variable = NextVariable;
+    }
+
+    if (CompareMem (ValidBuffer, VariableStoreHeader, (UINTN)Variable - (UINTN)VariableStoreHeader) != 0) {
+      DEBUG ((DEBUG_WARN, "%a NV variable cache is out of sync, reclaiming the whole store.\n", __func__));
+      Variable                    = GetStartPointer (VariableStoreHeader);
+      CommonVariableTotalSize     = 0;
+      CommonUserVariableTotalSize = 0;
+      HwErrVariableTotalSize      = 0;
+    }
+  }
+
+  CurrPtr = ValidBuffer + ((UINTN)Variable - (UINTN)VariableStoreHeader);
+  SetMem (CurrPtr, MaximumBufferSize - ((UINTN)CurrPtr - (UINTN)ValidBuffer), 0xff);
+  // MU_CHANGE [END]
 
   //
   // Copy variable store header.
   //
   CopyMem (ValidBuffer, VariableStoreHeader, sizeof (VARIABLE_STORE_HEADER));
-  CurrPtr = (UINT8 *)GetStartPointer ((VARIABLE_STORE_HEADER *)ValidBuffer);
 
   //
   // Reinstall all ADDED variables as long as they are not identical to Updating Variable.
   //
-  Variable = GetStartPointer (VariableStoreHeader);
   while (IsValidVariableHeader (Variable, GetEndPointer (VariableStoreHeader))) {
     NextVariable = GetNextVariablePtr (Variable, AuthFormat);
     if ((Variable != UpdatingVariable) && (Variable->State == VAR_ADDED)) {
@@ -833,11 +869,27 @@ Reclaim (
     //
     // If non-volatile variable store, perform FTW here.
     //
-    Status = FtwVariableSpace (
+    // MU_CHANGE [BEGIN] - Incremental variable reclaim
+    //
+    // The performance library cannot be called once the OS owns the platform.
+    //
+    if (!AtRuntime ()) {
+      PERF_INMODULE_BEGIN ("VarReclaim");
+    }
+
+    Status = FtwReclaimedVariableSpace (
                VariableBase,
-               (VARIABLE_STORE_HEADER *)ValidBuffer
+               (VARIABLE_STORE_HEADER *)ValidBuffer,
+               &BytesWritten,
+               &BytesErased
                );
+    if (!AtRuntime ()) {
+      PERF_INMODULE_END ("VarReclaim");
+    }
+
+    // MU_CHANGE [END]
     if (!EFI_ERROR (Status)) {
+      RecordReclaimStatistics (BytesWritten, BytesErased); // MU_CHANGE
       *LastVariableOffset                                = (UINTN)CurrPtr - (UINTN)ValidBuffer;
       mVariableModuleGlobal->HwErrVariableTotalSize      = HwErrVariableTotalSize;
       mVariableModuleGlobal->CommonVariableTotalSize     = CommonVariableTotalSize;
@@ -867,6 +919,16 @@ Reclaim (
   }
 
 Done:
+  // MU_CHANGE [BEGIN] - Hashed variable lookup index
+  //
+  // The variables have moved, so their index must be rebuilt.
+  //
+  VariableIndexInvalidate ((VARIABLE_STORE_HEADER *)(UINTN)VariableBase);
+  if (!IsVolatile) {
+    VariableIndexInvalidate (mNvVariableCache);
+  }
+
+  // MU_CHANGE [END]
   DoneStatus = EFI_SUCCESS;
   if (IsVolatile || mVariableModuleGlobal->VariableGlobal.EmuNvMode) {
     DoneStatus = SynchronizeRuntimeVariableCache (
@@ -3948,6 +4010,12 @@ VariableCommonInitialize (
   VolatileVariableStore->Reserved  = 0;
   VolatileVariableStore->Reserved1 = 0;
 
+  // MU_CHANGE [BEGIN] - Hashed variable lookup index
+  VariableIndexRegister (VolatileVariableStore, mVariableModuleGlobal->VariableGlobal.AuthFormat, FALSE);
+  VariableIndexRegister ((VARIABLE_STORE_HEADER *)(UINTN)mVariableModuleGlobal->VariableGlobal.HobVariableBase, mVariableModuleGlobal->VariableGlobal.AuthFormat, FALSE);
+  VariableIndexRegister (mNvVariableCache, mVariableModuleGlobal->VariableGlobal.AuthFormat, FALSE);
+  // MU_CHANGE [END]
+
   return EFI_SUCCESS;
 }
 
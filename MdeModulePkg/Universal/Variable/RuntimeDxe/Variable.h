@@ -33,6 +33,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/VarCheckLib.h>
 #include <Library/VariableFlashInfoLib.h>
 #include <Library/SafeIntLib.h>
+#include <Library/PerformanceLib.h>             // MU_CHANGE
 #include <Guid/GlobalVariable.h>
 #include <Guid/EventGroup.h>
 #include <Guid/VariableFormat.h>
@@ -102,6 +103,21 @@ typedef struct {
   BOOLEAN                           EmuNvMode;
 } VARIABLE_GLOBAL;
 
+// MU_CHANGE [BEGIN] - Incremental variable reclaim
+///
+/// Flash work done by the reclaims of the non-volatile variable store. The
+/// time of the flash write of each reclaim is measured by its "VarReclaim"
+/// performance records.
+///
+typedef struct {
+  UINT32    ReclaimCount;
+  UINT64    LastBytesWritten;
+  UINT64    LastBytesErased;
+  UINT64    TotalBytesWritten;
+  UINT64    TotalBytesErased;
+} VARIABLE_RECLAIM_STATISTICS;
+// MU_CHANGE [END]
+
 typedef struct {
   VARIABLE_GLOBAL                       VariableGlobal;
   UINTN                                 VolatileLastVariableOffset;
@@ -121,6 +137,7 @@ typedef struct {
   CHAR8                                 *PlatformLang;
   CHAR8                                 Lang[ISO_639_2_ENTRY_SIZE + 1];
   EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL    *FvbInstance;
+  VARIABLE_RECLAIM_STATISTICS           ReclaimStatistics; // MU_CHANGE - Incremental variable reclaim
 } VARIABLE_MODULE_GLOBAL;
 
 /**
@@ -157,6 +174,102 @@ FtwVariableSpace (
   IN VARIABLE_STORE_HEADER  *VariableBuffer
   );
 
+// MU_CHANGE [BEGIN] - Incremental variable reclaim
+
+/**
+  Find the blocks of a variable store that differ between two images of it.
+
+  @param[in]  Current      The store as it is now.
+  @param[in]  Updated      The store as it should be.
+  @param[in]  Size         Size of the store.
+  @param[in]  BlockOffset  Offset of the store in its first block.
+  @param[in]  BlockSize    Size of the blocks.
+  @param[out] Start        Returns the offset in the store of the first changed block,
+                           clipped to the store.
+  @param[out] End          Returns the offset in the store of the end of the last
+                           changed block, clipped to the store. Equal to Start if
+                           nothing changed.
+
+**/
+VOID
+GetChangedVariableSpace (
+  IN  CONST UINT8  *Current,
+  IN  CONST UINT8  *Updated,
+  IN  UINTN        Size,
+  IN  UINTN        BlockOffset,
+  IN  UINTN        BlockSize,
+  OUT UINTN        *Start,
+  OUT UINTN        *End
+  );
+
+/**
+  Writes a reclaimed variable store over the variable storage space.
+
+  If PcdVariableIncrementalReclaimEnable is TRUE, only the span of blocks that
+  differ from the store in flash is written, in a single Fault Tolerant Write
+  so that the update stays atomic. Otherwise the whole store is written, like
+  FtwVariableSpace().
+
+  @param[in]  VariableBase    Base address of the variable store.
+  @param[in]  VariableBuffer  The reclaimed variable store.
+  @param[out] BytesWritten    Returns the number of bytes written.
+  @param[out] BytesErased     Returns the size of the blocks the write erased.
+
+  @retval EFI_SUCCESS    The function completed successfully.
+  @retval EFI_NOT_FOUND  Fail to locate Fault Tolerant Write protocol.
+  @retval EFI_ABORTED    The function could not complete successfully.
+
+**/
+EFI_STATUS
+FtwReclaimedVariableSpace (
+  IN  EFI_PHYSICAL_ADDRESS   VariableBase,
+  IN  VARIABLE_STORE_HEADER  *VariableBuffer,
+  OUT UINTN                  *BytesWritten,
+  OUT UINTN                  *BytesErased
+  );
+
+/**
+  Record the flash work done by a reclaim of the non-volatile variable store.
+
+  @param[in] BytesWritten  Bytes written by the reclaim.
+  @param[in] BytesErased   Bytes erased by the reclaim.
+
+**/
+VOID
+RecordReclaimStatistics (
+  IN UINTN  BytesWritten,
+  IN UINTN  BytesErased
+  );
+
+/**
+
+  Variable store garbage collection and reclaim operation.
+
+  @param[in]      VariableBase            Base address of variable store.
+  @param[out]     LastVariableOffset      Offset of last variable.
+  @param[in]      IsVolatile              The variable store is volatile or not;
+                                          if it is non-volatile, need FTW.
+  @param[in, out] UpdatingPtrTrack        Pointer to updating variable pointer track structure.
+  @param[in]      NewVariable             Pointer to new variable.
+  @param[in]      NewVariableSize         New variable size.
+
+  @return EFI_SUCCESS                  Reclaim operation has finished successfully.
+  @return EFI_OUT_OF_RESOURCES         No enough memory resources or variable space.
+  @return Others                       Unexpect error happened during reclaim operation.
+
+**/
+EFI_STATUS
+Reclaim (
+  IN     EFI_PHYSICAL_ADDRESS    VariableBase,
+  OUT    UINTN                   *LastVariableOffset,
+  IN     BOOLEAN                 IsVolatile,
+  IN OUT VARIABLE_POINTER_TRACK  *UpdatingPtrTrack,
+  IN     VARIABLE_HEADER         *NewVariable,
+  IN     UINTN                   NewVariableSize
+  );
+
+// MU_CHANGE [END]
+
 /**
   Finds variable in storage blocks of volatile and non-volatile storage areas.
 
@@ -16,6 +16,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/VariablePolicyLib.h>
 
 #include "VariablePolicyLockingCommon.h"        // MU_CHANGE - Isolate the VariablePolicy locking event into its own code.
+#include "VariableIndex.h"                      // MU_CHANGE
 
 EFI_STATUS
 EFIAPI
@@ -269,6 +270,7 @@ VariableClassAddressChangeEvent (
   EfiConvertPointer (0x0, (VOID **)&mVariableModuleGlobal);
   EfiConvertPointer (0x0, (VOID **)&mNvVariableCache);
   EfiConvertPointer (0x0, (VOID **)&mNvFvHeaderCache);
+  VariableIndexConvertPointers (EfiConvertPointer);  // MU_CHANGE
 
   if (mAuthContextOut.AddressPointer != NULL) {
     for (Index = 0; Index < mAuthContextOut.AddressPointerCount; Index++) {
@@ -0,0 +1,525 @@
+/** @file
+  Hashed lookup index over the variable stores.
+
+  With a large number of variables (db/dbx, boot options, vendor data),
+  walking the whole store on every GetVariable()/SetVariable() call shows up
+  in boot traces. Each registered store gets a hash table of the offsets of
+  its variable headers, bucketed by (VendorGuid, VariableName) and kept in
+  store order inside each bucket, so that a lookup only compares the
+  variables sharing its hash.
+
+  Variables are only ever appended to a store between two reclaims, and their
+  name and GUID never change in place, so the index is brought up to date by
+  indexing the headers appended since the last lookup. A reclaim moves the
+  variables, so it must invalidate the index, which is then rebuilt on the
+  next lookup. Stores that are copies updated by another agent, such as the
+  runtime caches the MM variable driver keeps in sync, are registered with
+  DetectRewrite: before each update the index checks that the last variable
+  it indexed is still in place, and rebuilds itself when it is not. A reclaim
+  only drops variables or moves them towards the end of the store, so the
+  last indexed variable keeps its offset only if none of the variables
+  before it has moved.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "VariableParsing.h"
+#include "VariableIndex.h"
+
+#define VARIABLE_INDEX_MAX_STORES  VariableStoreTypeMax
+
+typedef struct {
+  UINT32    Offset;   ///< Offset of the variable header from the store header.
+  UINT32    Hash;
+  UINT32    Next;     ///< Next entry in the same bucket plus one, 0 ends the bucket.
+} VARIABLE_INDEX_ENTRY;
+
+typedef struct {
+  VARIABLE_STORE_HEADER    *Store;
+  BOOLEAN                  AuthFormat;
+  BOOLEAN                  DetectRewrite;
+  ///
+  /// The store cannot be indexed until the next invalidation, so lookups walk it.
+  ///
+  BOOLEAN                  Disabled;
+  UINT32                   IndexedEnd;
+  UINT32                   EntryCount;
+  UINT32                   MaxEntries;
+  UINT32                   BucketCount;
+  UINT32                   *BucketHead;
+  UINT32                   *BucketTail;
+  VARIABLE_INDEX_ENTRY     *Entries;
+} VARIABLE_STORE_INDEX;
+
+STATIC VARIABLE_STORE_INDEX       mVariableStoreIndex[VARIABLE_INDEX_MAX_STORES];
+STATIC VARIABLE_INDEX_STATISTICS  mVariableIndexStatistics;
+
+/**
+  Hash a variable name and vendor GUID (32-bit FNV-1a).
+
+  @param[in] VendorGuid  The vendor GUID.
+  @param[in] Name        The variable name.
+  @param[in] NameSize    The size of the name in bytes, including the terminator.
+
+  @return The hash value.
+
+**/
+STATIC
+UINT32
+VariableIndexHash (
+  IN CONST EFI_GUID  *VendorGuid,
+  IN CONST VOID      *Name,
+  IN UINTN           NameSize
+  )
+{
+  CONST UINT8  *Bytes;
+  UINT32       Hash;
+  UINTN        Index;
+
+  Hash  = 0x811C9DC5;
+  Bytes = (CONST UINT8 *)VendorGuid;
+  for (Index = 0; Index < sizeof (EFI_GUID); Index++) {
+    Hash = (Hash ^ Bytes[Index]) * 0x01000193;
+  }
+
+  Bytes = (CONST UINT8 *)Name;
+  for (Index = 0; Index < NameSize; Index++) {
+    Hash = (Hash ^ Bytes[Index]) * 0x01000193;
+  }
+
+  return Hash;
+}
+
+/**
+  Find the index of a store.
+
+  @param[in] Store  The variable store.
+
+  @return The index, or NULL if the store is not registered.
+
+**/
+STATIC
+VARIABLE_STORE_INDEX *
+VariableIndexLookupStore (
+  IN VARIABLE_STORE_HEADER  *Store
+  )
+{
+  UINTN  Index;
+
+  if (Store == NULL) {
+    return NULL;
+  }
+
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    if (mVariableStoreIndex[Index].Store == Store) {
+      return &mVariableStoreIndex[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Empty an index so that it is rebuilt from the start of its store.
+
+  @param[in, out] StoreIndex  The index.
+
+**/
+STATIC
+VOID
+VariableIndexReset (
+  IN OUT VARIABLE_STORE_INDEX  *StoreIndex
+  )
+{
+  ZeroMem (StoreIndex->BucketHead, StoreIndex->BucketCount * sizeof (UINT32));
+  ZeroMem (StoreIndex->BucketTail, StoreIndex->BucketCount * sizeof (UINT32));
+  StoreIndex->EntryCount = 0;
+  StoreIndex->IndexedEnd = (UINT32)((UINTN)GetStartPointer (StoreIndex->Store) - (UINTN)StoreIndex->Store);
+  StoreIndex->Disabled   = FALSE;
+}
+
+/**
+  Check whether the variables an index covers are still where it found them.
+
+  @param[in] StoreIndex  The index.
+
+  @retval TRUE   The last indexed variable still ends where the index stopped,
+                 with the same name and GUID.
+  @retval FALSE  The store has been rewritten since it was indexed.
+
+**/
+STATIC
+BOOLEAN
+VariableIndexIsCurrent (
+  IN VARIABLE_STORE_INDEX  *StoreIndex
+  )
+{
+  VARIABLE_INDEX_ENTRY  *Entry;
+  VARIABLE_HEADER       *Variable;
+  VARIABLE_HEADER       *EndPtr;
+  UINT8                 *Name;
+  UINTN                 NameSize;
+
+  if (StoreIndex->EntryCount == 0) {
+    return TRUE;
+  }
+
+  Entry    = &StoreIndex->Entries[StoreIndex->EntryCount - 1];
+  EndPtr   = GetEndPointer (StoreIndex->Store);
+  Variable = (VARIABLE_HEADER *)((UINTN)StoreIndex->Store + Entry->Offset);
+  if (!IsValidVariableHeader (Variable, EndPtr)) {
+    return FALSE;
+  }
+
+  Name     = (UINT8 *)GetVariableNamePtr (Variable, StoreIndex->AuthFormat);
+  NameSize = NameSizeOfVariable (Variable, StoreIndex->AuthFormat);
+  if ((NameSize > (UINTN)EndPtr - (UINTN)Name) ||
+      ((UINTN)GetNextVariablePtr (Variable, StoreIndex->AuthFormat) != (UINTN)StoreIndex->Store + StoreIndex->IndexedEnd))
+  {
+    return FALSE;
+  }
+
+  return (BOOLEAN)(VariableIndexHash (GetVendorGuidPtr (Variable, StoreIndex->AuthFormat), Name, NameSize) == Entry->Hash);
+}
+
+/**
+  Index the variables appended to a store since the last update.
+
+  @param[in, out] StoreIndex  The index.
+
+  @retval TRUE   The index covers every variable in the store.
+  @retval FALSE  The store cannot be indexed and must be walked.
+
+**/
+STATIC
+BOOLEAN
+VariableIndexUpdate (
+  IN OUT VARIABLE_STORE_INDEX  *StoreIndex
+  )
+{
+  VARIABLE_HEADER       *Variable;
+  VARIABLE_HEADER       *EndPtr;
+  VARIABLE_INDEX_ENTRY  *Entry;
+  UINT8                 *Name;
+  UINTN                 NameSize;
+  UINT32                Bucket;
+
+  if (StoreIndex->Disabled) {
+    return FALSE;
+  }
+
+  if (StoreIndex->DetectRewrite && !VariableIndexIsCurrent (StoreIndex)) {
+    //
+    // The store has been copied over since it was indexed.
+    //
+    VariableIndexReset (StoreIndex);
+    mVariableIndexStatistics.Rebuilds++;
+  }
+
+  EndPtr   = GetEndPointer (StoreIndex->Store);
+  Variable = (VARIABLE_HEADER *)((UINTN)StoreIndex->Store + StoreIndex->IndexedEnd);
+  while (IsValidVariableHeader (Variable, EndPtr)) {
+    Name     = (UINT8 *)GetVariableNamePtr (Variable, StoreIndex->AuthFormat);
+    NameSize = NameSizeOfVariable (Variable, StoreIndex->AuthFormat);
+    if ((NameSize > (UINTN)EndPtr - (UINTN)Name) || (StoreIndex->EntryCount == StoreIndex->MaxEntries)) {
+      StoreIndex->Disabled = TRUE;
+      return FALSE;
+    }
+
+    Entry         = &StoreIndex->Entries[StoreIndex->EntryCount];
+    Entry->Offset = (UINT32)((UINTN)Variable - (UINTN)StoreIndex->Store);
+    Entry->Hash   = VariableIndexHash (GetVendorGuidPtr (Variable, StoreIndex->AuthFormat), Name, NameSize);
+    Entry->Next   = 0;
+    StoreIndex->EntryCount++;
+
+    //
+    // Append to the bucket so that each bucket stays in store order.
+    //
+    Bucket = Entry->Hash & (StoreIndex->BucketCount - 1);
+    if (StoreIndex->BucketTail[Bucket] == 0) {
+      StoreIndex->BucketHead[Bucket] = StoreIndex->EntryCount;
+    } else {
+      StoreIndex->Entries[StoreIndex->BucketTail[Bucket] - 1].Next = StoreIndex->EntryCount;
+    }
+
+    StoreIndex->BucketTail[Bucket] = StoreIndex->EntryCount;
+
+    Variable = GetNextVariablePtr (Variable, StoreIndex->AuthFormat);
+  }
+
+  StoreIndex->IndexedEnd = (UINT32)((UINTN)Variable - (UINTN)StoreIndex->Store);
+  return TRUE;
+}
+
+/**
+  Start indexing a variable store.
+
+  Memory for the index is allocated here, sized from the store, so this must
+  be called before ExitBootServices. Does nothing if
+  PcdVariableLookupIndexEnable is FALSE or the store is already registered.
+
+  @param[in] Store          The variable store to index.
+  @param[in] AuthFormat     TRUE if the store uses authenticated variable headers.
+  @param[in] DetectRewrite  TRUE if the store is a copy that another agent may
+                            rewrite without calling VariableIndexInvalidate().
+                            The index then checks that the variables it
+                            covers have not moved before each lookup.
+
+**/
+VOID
+VariableIndexRegister (
+  IN VARIABLE_STORE_HEADER  *Store,
+  IN BOOLEAN                AuthFormat,
+  IN BOOLEAN                DetectRewrite
+  )
+{
+  VARIABLE_STORE_INDEX  *StoreIndex;
+  UINTN                 Index;
+  UINT32                MaxEntries;
+
+  if (!FeaturePcdGet (PcdVariableLookupIndexEnable) || (Store == NULL) ||
+      (Store->Size <= sizeof (VARIABLE_STORE_HEADER)) || (VariableIndexLookupStore (Store) != NULL))
+  {
+    return;
+  }
+
+  StoreIndex = NULL;
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    if (mVariableStoreIndex[Index].Store == NULL) {
+      StoreIndex = &mVariableStoreIndex[Index];
+      break;
+    }
+  }
+
+  if (StoreIndex == NULL) {
+    DEBUG ((DEBUG_WARN, "%a: no free index for variable store %p\n", __func__, Store));
+    return;
+  }
+
+  //
+  // The smallest variable is a header, a one character name and one byte of
+  // data, each padded, which bounds the number of variables the store holds.
+  //
+  MaxEntries = (UINT32)((Store->Size - sizeof (VARIABLE_STORE_HEADER)) / (GetVariableHeaderSize (AuthFormat) + 8));
+  if (MaxEntries == 0) {
+    return;
+  }
+
+  StoreIndex->BucketCount = GetPowerOfTwo32 (MaxEntries);
+  StoreIndex->MaxEntries  = MaxEntries;
+  StoreIndex->BucketHead  = AllocateRuntimePool (StoreIndex->BucketCount * sizeof (UINT32));
+  StoreIndex->BucketTail  = AllocateRuntimePool (StoreIndex->BucketCount * sizeof (UINT32));
+  StoreIndex->Entries     = AllocateRuntimePool (MaxEntries * sizeof (VARIABLE_INDEX_ENTRY));
+  if ((StoreIndex->BucketHead == NULL) || (StoreIndex->BucketTail == NULL) || (StoreIndex->Entries == NULL)) {
+    DEBUG ((DEBUG_WARN, "%a: out of resources indexing variable store %p\n", __func__, Store));
+    if (StoreIndex->BucketHead != NULL) {
+      FreePool (StoreIndex->BucketHead);
+    }
+
+    if (StoreIndex->BucketTail != NULL) {
+      FreePool (StoreIndex->BucketTail);
+    }
+
+    if (StoreIndex->Entries != NULL) {
+      FreePool (StoreIndex->Entries);
+    }
+
+    ZeroMem (StoreIndex, sizeof (*StoreIndex));
+    return;
+  }
+
+  StoreIndex->Store         = Store;
+  StoreIndex->AuthFormat    = AuthFormat;
+  StoreIndex->DetectRewrite = DetectRewrite;
+  VariableIndexReset (StoreIndex);
+}
+
+/**
+  Stop indexing a variable store and free its index.
+
+  @param[in] Store  The variable store, or NULL.
+
+**/
+VOID
+VariableIndexUnregister (
+  IN VARIABLE_STORE_HEADER  *Store
+  )
+{
+  VARIABLE_STORE_INDEX  *StoreIndex;
+
+  StoreIndex = VariableIndexLookupStore (Store);
+  if (StoreIndex == NULL) {
+    return;
+  }
+
+  if (!AtRuntime ()) {
+    FreePool (StoreIndex->BucketHead);
+    FreePool (StoreIndex->BucketTail);
+    FreePool (StoreIndex->Entries);
+  }
+
+  ZeroMem (StoreIndex, sizeof (*StoreIndex));
+}
+
+/**
+  Discard the index of a store whose variables have been moved, for example
+  by a reclaim. The index is rebuilt on the next lookup.
+
+  @param[in] Store  The variable store, or NULL.
+
+**/
+VOID
+VariableIndexInvalidate (
+  IN VARIABLE_STORE_HEADER  *Store
+  )
+{
+  VARIABLE_STORE_INDEX  *StoreIndex;
+
+  StoreIndex = VariableIndexLookupStore (Store);
+  if (StoreIndex != NULL) {
+    VariableIndexReset (StoreIndex);
+    mVariableIndexStatistics.Rebuilds++;
+  }
+}
+
+/**
+  Find a variable through the index of the store described by PtrTrack.
+
+  Gives the same result as the store walk in FindVariableEx(). Variables
+  appended to the store since the last lookup are indexed first.
+
+  @param[in]       VariableName   Name of the variable to be found. Must not be empty.
+  @param[in]       VendorGuid     Vendor GUID to be found.
+  @param[in]       IgnoreRtCheck  Ignore EFI_VARIABLE_RUNTIME_ACCESS attribute
+                                  check at runtime when searching variable.
+  @param[in, out]  PtrTrack       Variable Track Pointer structure that contains Variable Information.
+  @param[in]       AuthFormat     TRUE indicates authenticated variables are used.
+                                  FALSE indicates authenticated variables are not used.
+
+  @retval EFI_SUCCESS      Variable found successfully.
+  @retval EFI_NOT_FOUND    Variable not found.
+  @retval EFI_UNSUPPORTED  The store is not indexed, and must be walked instead.
+
+**/
+EFI_STATUS
+VariableIndexFindVariable (
+  IN     CHAR16                  *VariableName,
+  IN     EFI_GUID                *VendorGuid,
+  IN     BOOLEAN                 IgnoreRtCheck,
+  IN OUT VARIABLE_POINTER_TRACK  *PtrTrack,
+  IN     BOOLEAN                 AuthFormat
+  )
+{
+  VARIABLE_STORE_INDEX  *StoreIndex;
+  VARIABLE_INDEX_ENTRY  *Entry;
+  VARIABLE_HEADER       *Variable;
+  VARIABLE_HEADER       *InDeletedVariable;
+  UINTN                 NameSize;
+  UINT32                Hash;
+  UINT32                Next;
+  UINTN                 Index;
+
+  StoreIndex = NULL;
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    if ((mVariableStoreIndex[Index].Store != NULL) &&
+        (GetStartPointer (mVariableStoreIndex[Index].Store) == PtrTrack->StartPtr) &&
+        (GetEndPointer (mVariableStoreIndex[Index].Store) == PtrTrack->EndPtr))
+    {
+      StoreIndex = &mVariableStoreIndex[Index];
+      break;
+    }
+  }
+
+  if ((StoreIndex == NULL) || (StoreIndex->AuthFormat != AuthFormat)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (!VariableIndexUpdate (StoreIndex)) {
+    mVariableIndexStatistics.Fallbacks++;
+    return EFI_UNSUPPORTED;
+  }
+
+  mVariableIndexStatistics.Lookups++;
+
+  //
+  // Variables are stored with their terminator, so hashing the whole name
+  // covers the same bytes the store walk compares.
+  //
+  NameSize          = StrSize (VariableName);
+  Hash              = VariableIndexHash (VendorGuid, VariableName, NameSize);
+  InDeletedVariable = NULL;
+
+  for (Next = StoreIndex->BucketHead[Hash & (StoreIndex->BucketCount - 1)]; Next != 0; Next = Entry->Next) {
+    Entry = &StoreIndex->Entries[Next - 1];
+    mVariableIndexStatistics.EntriesVisited++;
+    if (Entry->Hash != Hash) {
+      continue;
+    }
+
+    Variable = (VARIABLE_HEADER *)((UINTN)StoreIndex->Store + Entry->Offset);
+    if ((Variable->State != VAR_ADDED) && (Variable->State != (VAR_IN_DELETED_TRANSITION & VAR_ADDED))) {
+      continue;
+    }
+
+    if (!IgnoreRtCheck && AtRuntime () && ((Variable->Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0)) {
+      continue;
+    }
+
+    if ((NameSizeOfVariable (Variable, AuthFormat) != NameSize) ||
+        !CompareGuid (VendorGuid, GetVendorGuidPtr (Variable, AuthFormat)) ||
+        (CompareMem (VariableName, GetVariableNamePtr (Variable, AuthFormat), NameSize) != 0))
+    {
+      continue;
+    }
+
+    if (Variable->State == (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) {
+      InDeletedVariable = Variable;
+    } else {
+      PtrTrack->CurrPtr                = Variable;
+      PtrTrack->InDeletedTransitionPtr = InDeletedVariable;
+      return EFI_SUCCESS;
+    }
+  }
+
+  PtrTrack->CurrPtr = InDeletedVariable;
+  return (PtrTrack->CurrPtr == NULL) ? EFI_NOT_FOUND : EFI_SUCCESS;
+}
+
+/**
+  Convert the pointers held by the index to virtual addresses.
+
+  @param[in] ConvertPointer  EfiConvertPointer() or an equivalent.
+
+**/
+VOID
+VariableIndexConvertPointers (
+  IN VARIABLE_INDEX_CONVERT_POINTER  ConvertPointer
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    if (mVariableStoreIndex[Index].Store != NULL) {
+      ConvertPointer (0x0, (VOID **)&mVariableStoreIndex[Index].Store);
+      ConvertPointer (0x0, (VOID **)&mVariableStoreIndex[Index].BucketHead);
+      ConvertPointer (0x0, (VOID **)&mVariableStoreIndex[Index].BucketTail);
+      ConvertPointer (0x0, (VOID **)&mVariableStoreIndex[Index].Entries);
+    }
+  }
+}
+
+/**
+  Get the lookup counters.
+
+  @param[out] Statistics  Receives the counters.
+
+**/
+VOID
+VariableIndexGetStatistics (
+  OUT VARIABLE_INDEX_STATISTICS  *Statistics
+  )
+{
+  CopyMem (Statistics, &mVariableIndexStatistics, sizeof (*Statistics));
+}
@@ -0,0 +1,132 @@
+/** @file
+  Hashed lookup index over the variable stores.
+
+  Each registered store gets a (VendorGuid, VariableName) hash table of the
+  offsets of its variable headers, so that FindVariableEx() only has to look
+  at the variables sharing the hash of the requested name instead of walking
+  the whole store. The index is optional and controlled by
+  PcdVariableLookupIndexEnable.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef VARIABLE_INDEX_H_
+#define VARIABLE_INDEX_H_
+
+#include "Variable.h"
+
+///
+/// Lookup counters, used to compare the index with a linear walk.
+///
+typedef struct {
+  UINT64    Lookups;           ///< Lookups served by the index.
+  UINT64    Fallbacks;         ///< Lookups on a registered store that had to walk the store.
+  UINT64    EntriesVisited;    ///< Index entries examined by the served lookups.
+  UINT64    Rebuilds;          ///< Times an index was discarded because its store was rewritten.
+} VARIABLE_INDEX_STATISTICS;
+
+typedef
+EFI_STATUS
+(EFIAPI *VARIABLE_INDEX_CONVERT_POINTER)(
+  IN     UINTN  DebugDisposition,
+  IN OUT VOID   **Address
+  );
+
+/**
+  Start indexing a variable store.
+
+  Memory for the index is allocated here, sized from the store, so this must
+  be called before ExitBootServices. Does nothing if
+  PcdVariableLookupIndexEnable is FALSE or the store is already registered.
+
+  @param[in] Store          The variable store to index.
+  @param[in] AuthFormat     TRUE if the store uses authenticated variable headers.
+  @param[in] DetectRewrite  TRUE if the store is a copy that another agent may
+                            rewrite without calling VariableIndexInvalidate().
+                            The index then checks that the variables it
+                            covers have not moved before each lookup.
+
+**/
+VOID
+VariableIndexRegister (
+  IN VARIABLE_STORE_HEADER  *Store,
+  IN BOOLEAN                AuthFormat,
+  IN BOOLEAN                DetectRewrite
+  );
+
+/**
+  Stop indexing a variable store and free its index.
+
+  @param[in] Store  The variable store, or NULL.
+
+**/
+VOID
+VariableIndexUnregister (
+  IN VARIABLE_STORE_HEADER  *Store
+  );
+
+/**
+  Discard the index of a store whose variables have been moved, for example
+  by a reclaim. The index is rebuilt on the next lookup.
+
+  @param[in] Store  The variable store, or NULL.
+
+**/
+VOID
+VariableIndexInvalidate (
+  IN VARIABLE_STORE_HEADER  *Store
+  );
+
+/**
+  Find a variable through the index of the store described by PtrTrack.
+
+  Gives the same result as the store walk in FindVariableEx(). Variables
+  appended to the store since the last lookup are indexed first.
+
+  @param[in]       VariableName   Name of the variable to be found. Must not be empty.
+  @param[in]       VendorGuid     Vendor GUID to be found.
+  @param[in]       IgnoreRtCheck  Ignore EFI_VARIABLE_RUNTIME_ACCESS attribute
+                                  check at runtime when searching variable.
+  @param[in, out]  PtrTrack       Variable Track Pointer structure that contains Variable Information.
+  @param[in]       AuthFormat     TRUE indicates authenticated variables are used.
+                                  FALSE indicates authenticated variables are not used.
+
+  @retval EFI_SUCCESS      Variable found successfully.
+  @retval EFI_NOT_FOUND    Variable not found.
+  @retval EFI_UNSUPPORTED  The store is not indexed, and must be walked instead.
+
+**/
+EFI_STATUS
+VariableIndexFindVariable (
+  IN     CHAR16                  *VariableName,
+  IN     EFI_GUID                *VendorGuid,
+  IN     BOOLEAN                 IgnoreRtCheck,
+  IN OUT VARIABLE_POINTER_TRACK  *PtrTrack,
+  IN     BOOLEAN                 AuthFormat
+  );
+
+/**
+  Convert the pointers held by the index to virtual addresses.
+
+  @param[in] ConvertPointer  EfiConvertPointer() or an equivalent.
+
+**/
+VOID
+VariableIndexConvertPointers (
+  IN VARIABLE_INDEX_CONVERT_POINTER  ConvertPointer
+  );
+
+/**
+  Get the lookup counters.
+
+  @param[out] Statistics  Receives the counters.
+
+**/
+VOID
+VariableIndexGetStatistics (
+  OUT VARIABLE_INDEX_STATISTICS  *Statistics
+  );
+
+#endif
@@ -8,6 +8,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 **/
 
 #include "VariableParsing.h"
+#include "VariableIndex.h"  // MU_CHANGE
 
 /**
 
@@ -470,9 +471,20 @@ FindVariableEx (
 {
   VARIABLE_HEADER  *InDeletedVariable;
   VOID             *Point;
+  EFI_STATUS       Status;                     // MU_CHANGE
 
   PtrTrack->InDeletedTransitionPtr = NULL;
 
+  // MU_CHANGE [BEGIN] - Hashed variable lookup index
+  if (VariableName[0] != 0) {
+    Status = VariableIndexFindVariable (VariableName, VendorGuid, IgnoreRtCheck, PtrTrack, AuthFormat);
+    if (Status != EFI_UNSUPPORTED) {
+      return Status;
+    }
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Find the variable by walk through HOB, volatile and non-volatile variable store.
   //
@@ -18,6 +18,8 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 extern VARIABLE_MODULE_GLOBAL  *mVariableModuleGlobal;
 extern VARIABLE_STORE_HEADER   *mNvVariableCache;
 
+STATIC BOOLEAN  mDeferRuntimeVariableCacheFlush = FALSE; // MU_CHANGE - Batched SetVariable
+
 /**
   Copies any pending updates to runtime variable caches.
 
@@ -150,9 +152,50 @@ SynchronizeRuntimeVariableCache (
 
   *(mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.PendingUpdate) = TRUE;
 
-  if (*(mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.ReadLock) == FALSE) {
+  // MU_CHANGE - Batched SetVariable
+  if ((*(mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.ReadLock) == FALSE) && !mDeferRuntimeVariableCacheFlush) {
     return FlushPendingRuntimeVariableCacheUpdates ();
   }
 
   return EFI_SUCCESS;
 }
+
+// MU_CHANGE [BEGIN] - Batched SetVariable
+
+/**
+  Defers or resumes flushing updates to the runtime variable caches.
+
+  While flushes are deferred, SynchronizeRuntimeVariableCache() only records the pending updates, so that a
+  batch of variable updates is copied to the runtime caches once. Resuming flushes the pending updates if the
+  ReadLock is available.
+
+  @param[in] Defer                TRUE to defer the flushes, FALSE to resume them.
+
+  @retval EFI_SUCCESS             The flushes were deferred, or resumed and any pending update was flushed.
+  @retval EFI_UNSUPPORTED         The volatile store to be updated is not initialized properly.
+
+**/
+EFI_STATUS
+DeferRuntimeVariableCacheFlush (
+  IN  BOOLEAN  Defer
+  )
+{
+  VARIABLE_RUNTIME_CACHE_CONTEXT  *VariableRuntimeCacheContext;
+
+  mDeferRuntimeVariableCacheFlush = Defer;
+
+  VariableRuntimeCacheContext = &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext;
+  if ((VariableRuntimeCacheContext->PendingUpdate == NULL) ||
+      (VariableRuntimeCacheContext->ReadLock == NULL))
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (Defer || !*(VariableRuntimeCacheContext->PendingUpdate) || *(VariableRuntimeCacheContext->ReadLock)) {
+    return EFI_SUCCESS;
+  }
+
+  return FlushPendingRuntimeVariableCacheUpdates ();
+}
+
+// MU_CHANGE [END]
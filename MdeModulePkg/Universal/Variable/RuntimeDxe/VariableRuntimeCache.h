@@ -48,4 +48,26 @@ SynchronizeRuntimeVariableCache (
   IN  UINTN                   Length
   );
 
+// MU_CHANGE [BEGIN] - Batched SetVariable
+
+/**
+  Defers or resumes flushing updates to the runtime variable caches.
+
+  While flushes are deferred, SynchronizeRuntimeVariableCache() only records the pending updates, so that a
+  batch of variable updates is copied to the runtime caches once. Resuming flushes the pending updates if the
+  ReadLock is available.
+
+  @param[in] Defer                TRUE to defer the flushes, FALSE to resume them.
+
+  @retval EFI_SUCCESS             The flushes were deferred, or resumed and any pending update was flushed.
+  @retval EFI_UNSUPPORTED         The volatile store to be updated is not initialized properly.
+
+**/
+EFI_STATUS
+DeferRuntimeVariableCacheFlush (
+  IN  BOOLEAN  Defer
+  );
+
+// MU_CHANGE [END]
+
 #endif
@@ -427,6 +427,112 @@ SmmVariableGetStatistics (
   return EFI_SUCCESS;
 }
 
+// MU_CHANGE [BEGIN] - Batched SetVariable
+
+/**
+  Sets a batch of variables received through the SMM communicate buffer.
+
+  Caution: This function may receive untrusted input.
+  The batch is external input, so every record is validated before any variable is set, and a malformed
+  batch does not change any variable. The variables are then set in order, stopping at the first failure.
+  The runtime variable caches are synchronized once, after the last variable.
+
+  @param[in, out] Batch           The batch, copied out of the communicate buffer. FailedIndex returns the
+                                  index of the first variable that failed, or VariableCount.
+  @param[in]      PayloadSize     Size of the batch in bytes.
+
+  @retval EFI_SUCCESS             All the variables were set.
+  @retval EFI_ACCESS_DENIED       The batch is malformed, or a variable may not be set through the batch.
+  @retval Others                  The status of setting the variable at FailedIndex.
+
+**/
+STATIC
+EFI_STATUS
+SmmSetVariableBatch (
+  IN OUT SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH  *Batch,
+  IN     UINTN                                        PayloadSize
+  )
+{
+  EFI_STATUS                                Status;
+  UINTN                                     Index;
+  UINTN                                     Offset;
+  UINTN                                     RecordSize;
+  SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE  *Variable;
+
+  Batch->FailedIndex = 0;
+
+  Offset = sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH);
+  for (Index = 0; Index < Batch->VariableCount; Index++) {
+    if ((Offset > PayloadSize) || (PayloadSize - Offset < OFFSET_OF (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE, Name))) {
+      DEBUG ((DEBUG_ERROR, "SetVariableBatch: Variable %Lu exceeds communication buffer size limit!\n", (UINT64)Index));
+      return EFI_ACCESS_DENIED;
+    }
+
+    RecordSize = PayloadSize - Offset - OFFSET_OF (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE, Name);
+    Variable   = (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE *)((UINT8 *)Batch + Offset);
+    if ((Variable->NameSize > RecordSize) || (Variable->DataSize > RecordSize - Variable->NameSize)) {
+      DEBUG ((DEBUG_ERROR, "SetVariableBatch: Variable %Lu exceeds communication buffer size limit!\n", (UINT64)Index));
+      return EFI_ACCESS_DENIED;
+    }
+
+    //
+    // The VariableSpeculationBarrier() call here is to ensure the previous
+    // range/content checks for the CommBuffer have been completed before the
+    // subsequent consumption of the CommBuffer content.
+    //
+    VariableSpeculationBarrier ();
+    if ((Variable->NameSize < sizeof (CHAR16)) || (Variable->Name[Variable->NameSize/sizeof (CHAR16) - 1] != L'\0')) {
+      //
+      // Make sure VariableName is A Null-terminated string.
+      //
+      return EFI_ACCESS_DENIED;
+    }
+
+    RecordSize = OFFSET_OF (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE, Name) + Variable->NameSize + Variable->DataSize;
+    Offset    += ALIGN_VALUE (RecordSize, sizeof (UINTN));
+  }
+
+  //
+  // Copy the updates of the whole batch to the runtime caches at once.
+  //
+  DeferRuntimeVariableCacheFlush (TRUE);
+
+  Status = EFI_SUCCESS;
+  Offset = sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH);
+  for (Index = 0; Index < Batch->VariableCount; Index++) {
+    Variable = (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE *)((UINT8 *)Batch + Offset);
+
+    //
+    // The advanced logger variables can only be read, like in SMM_VARIABLE_FUNCTION_SET_VARIABLE.
+    //
+    if (CompareGuid (&Variable->Guid, &gAdvLoggerAccessGuid)) {
+      Status = EFI_ACCESS_DENIED;
+    } else {
+      Status = VariableServiceSetVariable (
+                 Variable->Name,
+                 &Variable->Guid,
+                 Variable->Attributes,
+                 Variable->DataSize,
+                 (UINT8 *)Variable->Name + Variable->NameSize
+                 );
+    }
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    RecordSize = OFFSET_OF (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE, Name) + Variable->NameSize + Variable->DataSize;
+    Offset    += ALIGN_VALUE (RecordSize, sizeof (UINTN));
+  }
+
+  Batch->FailedIndex = Index;
+  DeferRuntimeVariableCacheFlush (FALSE);
+
+  return Status;
+}
+
+// MU_CHANGE [END]
+
 /**
   Communication service SMI Handler entry.
 
@@ -697,6 +803,26 @@ SmmVariableHandler (
       // MU_CHANGE End -------------------------------------
       break;
 
+    // MU_CHANGE [BEGIN] - Batched SetVariable
+    case SMM_VARIABLE_FUNCTION_SET_VARIABLE_BATCH:
+      if (CommBufferPayloadSize < sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH)) {
+        DEBUG ((DEBUG_ERROR, "SetVariableBatch: SMM communication buffer size invalid!\n"));
+        return EFI_SUCCESS;
+      }
+
+      //
+      // Copy the input communicate buffer payload to pre-allocated SMM variable buffer payload.
+      //
+      CopyMem (mVariableBufferPayload, SmmVariableFunctionHeader->Data, CommBufferPayloadSize);
+      Status = SmmSetVariableBatch (
+                 (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH *)mVariableBufferPayload,
+                 CommBufferPayloadSize
+                 );
+      ((SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH *)SmmVariableFunctionHeader->Data)->FailedIndex =
+        ((SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH *)mVariableBufferPayload)->FailedIndex;
+      break;
+    // MU_CHANGE [END]
+
     case SMM_VARIABLE_FUNCTION_QUERY_VARIABLE_INFO:
       if (CommBufferPayloadSize < sizeof (SMM_VARIABLE_COMMUNICATE_QUERY_VARIABLE_INFO)) {
         DEBUG ((DEBUG_ERROR, "QueryVariableInfo: SMM communication buffer size invalid!\n"));
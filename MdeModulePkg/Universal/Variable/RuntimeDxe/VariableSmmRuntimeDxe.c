@@ -25,6 +25,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Protocol/SmmVariable.h>
 #include <Protocol/VariableLock.h>
 #include <Protocol/VarCheck.h>
+#include <Protocol/VariableBatchWrite.h>  // MU_CHANGE
 
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
@@ -42,6 +43,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include "PrivilegePolymorphic.h"
 #include "VariableParsing.h"
+#include "VariableIndex.h"  // MU_CHANGE
 
 EFI_HANDLE                      mHandle                              = NULL;
 EFI_SMM_VARIABLE_PROTOCOL       *mSmmVariable                        = NULL;
@@ -65,6 +67,10 @@ BOOLEAN                         mHobFlushComplete;
 EFI_LOCK                        mVariableServicesLock;
 EDKII_VARIABLE_LOCK_PROTOCOL    mVariableLock;
 EDKII_VAR_CHECK_PROTOCOL        mVarCheck;
+// MU_CHANGE [BEGIN] - Batched SetVariable
+EDKII_VARIABLE_BATCH_WRITE_PROTOCOL    mVariableBatchWrite;
+EDKII_VARIABLE_BATCH_WRITE_STATISTICS  mVariableBatchWriteStatistics;
+// MU_CHANGE [END]
 
 /**
   The logic to initialize the VariablePolicy engine is in its own file.
@@ -580,6 +586,7 @@ CheckForRuntimeCacheSync (
   // The HOB variable data may have finished being flushed in the runtime cache sync update
   //
   if (mHobFlushComplete && (mVariableRuntimeHobCacheBuffer != NULL)) {
+    VariableIndexUnregister (mVariableRuntimeHobCacheBuffer);  // MU_CHANGE
     if (!EfiAtRuntime ()) {
       FreePages (mVariableRuntimeHobCacheBuffer, EFI_SIZE_TO_PAGES (mVariableRuntimeHobCacheBufferSize));
     }
@@ -1256,6 +1263,189 @@ Done:
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - Batched SetVariable
+
+/**
+  Set a batch of variables.
+
+  The entries are packed into as few SMM communicate buffers as they fit in,
+  and every buffer is written by a single SMI.
+
+  @param[in]      This     The EDKII_VARIABLE_BATCH_WRITE_PROTOCOL instance.
+  @param[in]      Count    Number of entries.
+  @param[in, out] Entries  The variables to write. The Status of every entry
+                           is updated.
+
+  @retval EFI_SUCCESS            All the variables were written.
+  @retval EFI_INVALID_PARAMETER  Entries is NULL and Count is not zero, or an
+                                 entry is invalid. No variable was written.
+  @retval Others                 The status of the first entry that failed.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableBatchWriteSetVariables (
+  IN CONST EDKII_VARIABLE_BATCH_WRITE_PROTOCOL  *This,
+  IN       UINTN                                Count,
+  IN OUT   EDKII_VARIABLE_BATCH_WRITE_ENTRY     *Entries
+  )
+{
+  EFI_STATUS                                   Status;
+  UINTN                                        Index;
+  UINTN                                        First;
+  UINTN                                        Failed;
+  UINTN                                        VariableNameSize;
+  UINTN                                        MaxRecordSize;
+  UINTN                                        RecordSize;
+  UINTN                                        PayloadSize;
+  UINTN                                        RecordOffset;
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH  *SmmBatchHeader;
+  SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE     *SmmVariableHeader;
+
+  if ((Entries == NULL) && (Count != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Check all the entries before writing any of them. Every entry must fit in
+  // a communicate buffer on its own.
+  //
+  MaxRecordSize = mVariableBufferPayloadSize - sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH) - OFFSET_OF (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE, Name);
+  Status        = EFI_SUCCESS;
+  for (Index = 0; Index < Count; Index++) {
+    Entries[Index].Status = EFI_NOT_STARTED;
+    if ((Entries[Index].VariableName == NULL) || (Entries[Index].VariableName[0] == 0) || (Entries[Index].VendorGuid == NULL) ||
+        ((Entries[Index].DataSize != 0) && (Entries[Index].Data == NULL)))
+    {
+      Entries[Index].Status = EFI_INVALID_PARAMETER;
+      Status                = EFI_INVALID_PARAMETER;
+      continue;
+    }
+
+    VariableNameSize = StrSize (Entries[Index].VariableName);
+    if ((VariableNameSize > MaxRecordSize) || (Entries[Index].DataSize > MaxRecordSize - VariableNameSize)) {
+      Entries[Index].Status = EFI_INVALID_PARAMETER;
+      Status                = EFI_INVALID_PARAMETER;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AcquireLockOnlyAtBootTime (&mVariableServicesLock);
+
+  SmmBatchHeader = NULL;
+  Index          = 0;
+  while (Index < Count) {
+    //
+    // Init the communicate buffer, then pack as many entries as fit in it.
+    //
+    Status = InitCommunicateBuffer ((VOID **)&SmmBatchHeader, mVariableBufferPayloadSize, SMM_VARIABLE_FUNCTION_SET_VARIABLE_BATCH);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    ASSERT (SmmBatchHeader != NULL);
+
+    First        = Index;
+    PayloadSize  = sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH);
+    RecordOffset = PayloadSize;
+    while (Index < Count) {
+      VariableNameSize = StrSize (Entries[Index].VariableName);
+      RecordSize       = OFFSET_OF (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE, Name) + VariableNameSize + Entries[Index].DataSize;
+      if ((RecordOffset > mVariableBufferPayloadSize) || (RecordSize > mVariableBufferPayloadSize - RecordOffset)) {
+        break;
+      }
+
+      SmmVariableHeader = (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE *)((UINT8 *)SmmBatchHeader + RecordOffset);
+      CopyGuid (&SmmVariableHeader->Guid, Entries[Index].VendorGuid);
+      SmmVariableHeader->DataSize   = Entries[Index].DataSize;
+      SmmVariableHeader->NameSize   = VariableNameSize;
+      SmmVariableHeader->Attributes = Entries[Index].Attributes;
+      CopyMem (SmmVariableHeader->Name, Entries[Index].VariableName, VariableNameSize);
+      CopyMem ((UINT8 *)SmmVariableHeader->Name + VariableNameSize, Entries[Index].Data, Entries[Index].DataSize);
+
+      PayloadSize   = RecordOffset + RecordSize;
+      RecordOffset += ALIGN_VALUE (RecordSize, sizeof (UINTN));
+      Index++;
+    }
+
+    ASSERT (Index > First);
+    SmmBatchHeader->VariableCount = Index - First;
+    SmmBatchHeader->FailedIndex   = 0;
+
+    //
+    // Send data to SMM.
+    //
+    InitCommunicateBuffer (NULL, PayloadSize, SMM_VARIABLE_FUNCTION_SET_VARIABLE_BATCH);
+    Status = SendCommunicateBuffer (PayloadSize);
+
+    mVariableBatchWriteStatistics.Requests++;
+    mVariableBatchWriteStatistics.RequestsSaved += Index - First - 1;
+
+    Failed = First + MIN (SmmBatchHeader->FailedIndex, Index - First);
+    mVariableBatchWriteStatistics.Variables += Failed - First;
+    for ( ; First < Failed; First++) {
+      Entries[First].Status = EFI_SUCCESS;
+    }
+
+    if (EFI_ERROR (Status)) {
+      if (Failed < Index) {
+        Entries[Failed].Status = Status;
+      }
+
+      break;
+    }
+  }
+
+  if (Count != 0) {
+    mVariableBatchWriteStatistics.Batches++;
+  }
+
+  ReleaseLockOnlyAtBootTime (&mVariableServicesLock);
+
+  if (!EfiAtRuntime ()) {
+    for (Index = 0; Index < Count; Index++) {
+      if (Entries[Index].Status == EFI_SUCCESS) {
+        SecureBootHook (
+          Entries[Index].VariableName,
+          Entries[Index].VendorGuid
+          );
+      }
+    }
+  }
+
+  return Status;
+}
+
+/**
+  Get the counters of the batches written through the protocol.
+
+  @param[in]  This        The EDKII_VARIABLE_BATCH_WRITE_PROTOCOL instance.
+  @param[out] Statistics  Returns the counters.
+
+  @retval EFI_SUCCESS            The counters were returned.
+  @retval EFI_INVALID_PARAMETER  Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableBatchWriteGetStatistics (
+  IN CONST EDKII_VARIABLE_BATCH_WRITE_PROTOCOL    *This,
+  OUT      EDKII_VARIABLE_BATCH_WRITE_STATISTICS  *Statistics
+  )
+{
+  if (Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Statistics, &mVariableBatchWriteStatistics, sizeof (*Statistics));
+  return EFI_SUCCESS;
+}
+
+// MU_CHANGE [END]
+
 /**
   This code returns information about the EFI variables.
 
@@ -1419,6 +1609,7 @@ VariableAddressChangeEvent (
   EfiConvertPointer (EFI_OPTIONAL_PTR, (VOID **)&mVariableRuntimeHobCacheBuffer);
   EfiConvertPointer (EFI_OPTIONAL_PTR, (VOID **)&mVariableRuntimeNvCacheBuffer);
   EfiConvertPointer (EFI_OPTIONAL_PTR, (VOID **)&mVariableRuntimeVolatileCacheBuffer);
+  VariableIndexConvertPointers (EfiConvertPointer);  // MU_CHANGE
 }
 
 /**
@@ -1736,6 +1927,15 @@ SmmVariableReady (
             Status = SendRuntimeVariableCacheContextToSmm ();
             if (!EFI_ERROR (Status)) {
               SyncRuntimeCache ();
+              // MU_CHANGE [BEGIN] - Hashed variable lookup index
+              //
+              // The MM variable driver copies whole stores over these caches
+              // after a reclaim, so let the index detect the rewrites.
+              //
+              VariableIndexRegister (mVariableRuntimeHobCacheBuffer, mVariableAuthFormat, TRUE);
+              VariableIndexRegister (mVariableRuntimeNvCacheBuffer, mVariableAuthFormat, TRUE);
+              VariableIndexRegister (mVariableRuntimeVolatileCacheBuffer, mVariableAuthFormat, TRUE);
+              // MU_CHANGE [END]
             }
           }
         }
@@ -1831,6 +2031,19 @@ SmmVariableWriteReady (
                   );
   ASSERT_EFI_ERROR (Status);
 
+  // MU_CHANGE [BEGIN] - Batched SetVariable
+  mVariableBatchWrite.Revision      = EDKII_VARIABLE_BATCH_WRITE_PROTOCOL_REVISION;
+  mVariableBatchWrite.SetVariables  = VariableBatchWriteSetVariables;
+  mVariableBatchWrite.GetStatistics = VariableBatchWriteGetStatistics;
+  Status                            = gBS->InstallMultipleProtocolInterfaces (
+                                             &mHandle,
+                                             &gEdkiiVariableBatchWriteProtocolGuid,
+                                             &mVariableBatchWrite,
+                                             NULL
+                                             );
+  ASSERT_EFI_ERROR (Status);
+  // MU_CHANGE [END]
+
   gBS->CloseEvent (Event);
 }
 
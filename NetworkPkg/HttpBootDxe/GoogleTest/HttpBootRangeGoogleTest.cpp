@@ -0,0 +1,584 @@
+/** @file
+  Tests for HttpBootRange.c.
+
+  The connections are served by a loopback server that emulates the HTTP
+  instances: each connection delivers at most one TCP window per round trip,
+  and a virtual clock advances when no connection has data ready.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+extern "C" {
+  #include <Uefi.h>
+  #include <Library/BaseLib.h>
+  #include <Library/BaseMemoryLib.h>
+  #include <Library/DebugLib.h>
+  #include <Library/MemoryAllocationLib.h>
+  #include "../HttpBootRange.h"
+}
+
+////////////////////////////////////////////////////////////////////////
+// Defines
+////////////////////////////////////////////////////////////////////////
+
+#define LOOPBACK_RTT_MS     50
+#define LOOPBACK_WINDOW     SIZE_64KB
+#define LOOPBACK_TIMEOUT    5000
+#define LOOPBACK_GUARD      0xA5
+#define LOOPBACK_GUARD_LEN  64
+
+////////////////////////////////////////////////////////////////////////
+// Loopback server
+////////////////////////////////////////////////////////////////////////
+
+class LoopbackServer;
+
+//
+// A HTTP instance of the loopback server, the protocol must be first.
+//
+typedef struct {
+  EFI_HTTP_PROTOCOL    Protocol;
+  LoopbackServer       *Server;
+  HTTP_IO              *HttpIo;
+  UINT64               First;
+  UINT64               Last;
+  UINT64               Position;
+  BOOLEAN              HeaderSent;
+  EFI_HTTP_TOKEN       *Pending;
+  UINT64               ReadyTime;
+  BOOLEAN              Stalled;
+  UINTN                Cancelled;
+} LOOPBACK_HTTP;
+
+class LoopbackServer {
+public:
+  std::vector<UINT8>            File;
+  std::vector<LOOPBACK_HTTP>    Http;
+  std::vector<HTTP_IO>          HttpIo;
+  volatile UINT64               Clock;
+  BOOLEAN                       IgnoreRange;
+  BOOLEAN                       WrongRange;
+  BOOLEAN                       WrongSize;
+
+  LoopbackServer (
+    UINTN  FileSize,
+    UINTN  Count
+    ) : File (FileSize), Http (Count), HttpIo (Count), Clock (0), IgnoreRange (FALSE), WrongRange (FALSE), WrongSize (FALSE)
+  {
+    UINT32  Seed;
+    UINTN   Index;
+
+    Seed = 0x12345678;
+    for (Index = 0; Index < FileSize; Index++) {
+      Seed        = Seed * 1103515245 + 12345;
+      File[Index] = (UINT8)(Seed >> 16);
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+      ZeroMem (&Http[Index], sizeof (LOOPBACK_HTTP));
+      ZeroMem (&HttpIo[Index], sizeof (HTTP_IO));
+      Http[Index].Protocol.Request  = Request;
+      Http[Index].Protocol.Cancel   = Cancel;
+      Http[Index].Protocol.Response = Response;
+      Http[Index].Protocol.Poll     = Poll;
+      Http[Index].Server            = this;
+      Http[Index].HttpIo            = &HttpIo[Index];
+      HttpIo[Index].Http             = &Http[Index].Protocol;
+      HttpIo[Index].ReqToken.Message = &HttpIo[Index].ReqMessage;
+      HttpIo[Index].RspToken.Message = &HttpIo[Index].RspMessage;
+    }
+  }
+
+  //
+  // Point the connections at the HTTP instances of the server.
+  //
+  void
+  Attach (
+    HTTP_BOOT_RANGE_CONNECTION  *Connections
+    )
+  {
+    for (UINTN Index = 0; Index < Http.size (); Index++) {
+      Connections[Index].HttpIo = &HttpIo[Index];
+    }
+  }
+
+  BOOLEAN
+  AnyPending (
+    )
+  {
+    for (UINTN Index = 0; Index < Http.size (); Index++) {
+      if (Http[Index].Pending != NULL) {
+        return TRUE;
+      }
+    }
+
+    return FALSE;
+  }
+
+private:
+  static CHAR8 *
+  CopyString (
+    CONST CHAR8  *String
+    )
+  {
+    return (CHAR8 *)AllocateCopyPool (strlen (String) + 1, String);
+  }
+
+  static EFI_STATUS
+  EFIAPI
+  Request (
+    IN EFI_HTTP_PROTOCOL  *This,
+    IN EFI_HTTP_TOKEN     *Token
+    )
+  {
+    LOOPBACK_HTTP       *Http;
+    EFI_HTTP_HEADER     *Header;
+    unsigned long long  First;
+    unsigned long long  Last;
+
+    Http   = (LOOPBACK_HTTP *)This;
+    Header = NULL;
+    for (UINTN Index = 0; Index < Token->Message->HeaderCount; Index++) {
+      if (strcmp (Token->Message->Headers[Index].FieldName, HTTP_BOOT_HEADER_RANGE) == 0) {
+        Header = &Token->Message->Headers[Index];
+      }
+    }
+
+    if ((Header == NULL) || (sscanf (Header->FieldValue, "bytes=%llu-%llu", &First, &Last) != 2)) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Http->First      = First;
+    Http->Last       = Last;
+    Http->Position   = First;
+    Http->HeaderSent = FALSE;
+
+    //
+    // The request is sent at once, emulate the notification of the token event.
+    //
+    Token->Status          = EFI_SUCCESS;
+    Http->HttpIo->IsTxDone = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  static EFI_STATUS
+  EFIAPI
+  Response (
+    IN EFI_HTTP_PROTOCOL  *This,
+    IN EFI_HTTP_TOKEN     *Token
+    )
+  {
+    LOOPBACK_HTTP  *Http;
+
+    Http = (LOOPBACK_HTTP *)This;
+    if (Http->Pending != NULL) {
+      return EFI_ACCESS_DENIED;
+    }
+
+    Http->Pending   = Token;
+    Http->ReadyTime = Http->Server->Clock + LOOPBACK_RTT_MS;
+    return EFI_SUCCESS;
+  }
+
+  static EFI_STATUS
+  EFIAPI
+  Cancel (
+    IN EFI_HTTP_PROTOCOL  *This,
+    IN EFI_HTTP_TOKEN     *Token
+    )
+  {
+    LOOPBACK_HTTP  *Http;
+
+    Http = (LOOPBACK_HTTP *)This;
+    if ((Http->Pending == NULL) || ((Token != NULL) && (Token != Http->Pending))) {
+      return EFI_NOT_FOUND;
+    }
+
+    Http->Pending = NULL;
+    Http->Cancelled++;
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Advance the clock to the next round trip when no connection has data ready.
+  //
+  void
+  AdvanceClock (
+    )
+  {
+    UINT64  Next;
+
+    Next = MAX_UINT64;
+    for (UINTN Index = 0; Index < Http.size (); Index++) {
+      if ((Http[Index].Pending != NULL) && !Http[Index].Stalled) {
+        if (Http[Index].ReadyTime <= Clock) {
+          return;
+        }
+
+        Next = MIN (Next, Http[Index].ReadyTime);
+      }
+    }
+
+    Clock = (Next == MAX_UINT64) ? Clock + LOOPBACK_RTT_MS : Next;
+  }
+
+  void
+  SendHeader (
+    LOOPBACK_HTTP   *Http,
+    EFI_HTTP_TOKEN  *Token
+    )
+  {
+    EFI_HTTP_HEADER  *Headers;
+    CHAR8            Value[64];
+    UINT64           First;
+
+    First   = WrongRange ? Http->First + 1 : Http->First;
+    Headers = (EFI_HTTP_HEADER *)AllocatePool (2 * sizeof (EFI_HTTP_HEADER));
+    if (IgnoreRange) {
+      snprintf (Value, sizeof (Value), "%llu", (unsigned long long)File.size ());
+      Token->Message->Data.Response->StatusCode = HTTP_STATUS_200_OK;
+      Headers[0].FieldName                      = CopyString ("Content-Length");
+      Headers[0].FieldValue                     = CopyString (Value);
+      Token->Message->HeaderCount               = 1;
+    } else {
+      snprintf (
+        Value,
+        sizeof (Value),
+        "bytes %llu-%llu/%llu",
+        (unsigned long long)First,
+        (unsigned long long)Http->Last,
+        (unsigned long long)(WrongSize ? File.size () + 1 : File.size ())
+        );
+      Token->Message->Data.Response->StatusCode = HTTP_STATUS_206_PARTIAL_CONTENT;
+      Headers[0].FieldName                      = CopyString (HTTP_BOOT_HEADER_CONTENT_RANGE);
+      Headers[0].FieldValue                     = CopyString (Value);
+      snprintf (Value, sizeof (Value), "%llu", (unsigned long long)(Http->Last - Http->First + 1));
+      Headers[1].FieldName        = CopyString ("Content-Length");
+      Headers[1].FieldValue       = CopyString (Value);
+      Token->Message->HeaderCount = 2;
+    }
+
+    Token->Message->Headers = Headers;
+    Http->HeaderSent        = TRUE;
+  }
+
+  static EFI_STATUS
+  EFIAPI
+  Poll (
+    IN EFI_HTTP_PROTOCOL  *This
+    )
+  {
+    LOOPBACK_HTTP   *Http;
+    LoopbackServer  *Server;
+    EFI_HTTP_TOKEN  *Token;
+    UINT64          Length;
+
+    Http   = (LOOPBACK_HTTP *)This;
+    Server = Http->Server;
+    Token  = Http->Pending;
+    if (Token == NULL) {
+      return EFI_SUCCESS;
+    }
+
+    Server->AdvanceClock ();
+    if (Http->Stalled || (Http->ReadyTime > Server->Clock)) {
+      return EFI_SUCCESS;
+    }
+
+    if (Token->Message->Data.Response != NULL) {
+      Server->SendHeader (Http, Token);
+    } else {
+      Length = MIN (MIN ((UINT64)Token->Message->BodyLength, LOOPBACK_WINDOW), Http->Last + 1 - Http->Position);
+      CopyMem (Token->Message->Body, &Server->File[Http->Position], Length);
+      Http->Position             += Length;
+      Token->Message->BodyLength  = Length;
+    }
+
+    //
+    // Emulate the notification of the token event.
+    //
+    Http->Pending          = NULL;
+    Token->Status          = EFI_SUCCESS;
+    Http->HttpIo->IsRxDone = TRUE;
+    return EFI_SUCCESS;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////
+// HttpBootRange Tests
+////////////////////////////////////////////////////////////////////////
+
+class HttpBootRangeTest : public ::testing::Test {
+protected:
+  EFI_HTTP_REQUEST_DATA  Request;
+  EFI_HTTP_HEADER        Headers[2];
+  UINT8                  *Buffer;
+  UINTN                  BufferSize;
+  UINTN                  CallbackBytes;
+  UINTN                  AbortAfter;
+
+  virtual void
+  SetUp (
+    )
+  {
+    Request.Method        = HttpMethodGet;
+    Request.Url           = (CHAR16 *)u"http://192.168.0.1/boot.iso";
+    Headers[0].FieldName  = (CHAR8 *)"Host";
+    Headers[0].FieldValue = (CHAR8 *)"192.168.0.1";
+    Headers[1].FieldName  = (CHAR8 *)"Accept";
+    Headers[1].FieldValue = (CHAR8 *)"*/*";
+    Buffer                = NULL;
+    CallbackBytes         = 0;
+    AbortAfter            = MAX_UINTN;
+  }
+
+  virtual void
+  TearDown (
+    )
+  {
+    if (Buffer != NULL) {
+      FreePool (Buffer);
+    }
+  }
+
+  //
+  // Allocate the destination buffer followed by guard bytes.
+  //
+  void
+  AllocateBuffer (
+    UINTN  Size
+    )
+  {
+    BufferSize = Size;
+    Buffer     = (UINT8 *)AllocatePool (Size + LOOPBACK_GUARD_LEN);
+    ASSERT_NE (Buffer, nullptr);
+    SetMem (Buffer, Size + LOOPBACK_GUARD_LEN, LOOPBACK_GUARD);
+  }
+
+  BOOLEAN
+  GuardIntact (
+    )
+  {
+    for (UINTN Index = 0; Index < LOOPBACK_GUARD_LEN; Index++) {
+      if (Buffer[BufferSize + Index] != LOOPBACK_GUARD) {
+        return FALSE;
+      }
+    }
+
+    return TRUE;
+  }
+
+  static EFI_STATUS
+  EFIAPI
+  Callback (
+    IN VOID   *Context,
+    IN UINTN  Length,
+    IN UINT8  *Data
+    )
+  {
+    HttpBootRangeTest  *Test;
+
+    Test                 = (HttpBootRangeTest *)Context;
+    Test->CallbackBytes += Length;
+    return (Test->CallbackBytes >= Test->AbortAfter) ? EFI_ABORTED : EFI_SUCCESS;
+  }
+
+  EFI_STATUS
+  Download (
+    LoopbackServer              &Server,
+    HTTP_BOOT_RANGE_CONNECTION  *Connections,
+    UINTN                       Count
+    )
+  {
+    Server.Attach (Connections);
+    HttpBootRangeSplit (Connections, Count, Server.File.size (), Buffer);
+    return HttpBootRangeDownload (
+             Connections,
+             Count,
+             &Request,
+             ARRAY_SIZE (Headers),
+             Headers,
+             &Server.Clock,
+             LOOPBACK_TIMEOUT,
+             Callback,
+             this
+             );
+  }
+};
+
+// Test Description:
+// Only "Accept-Ranges: bytes" allows a ranged download.
+TEST_F (HttpBootRangeTest, AcceptRangesBytesShouldBeSupported) {
+  EFI_HTTP_HEADER  Response[2];
+
+  Response[0].FieldName  = (CHAR8 *)"Content-Length";
+  Response[0].FieldValue = (CHAR8 *)"1048576";
+  Response[1].FieldName  = (CHAR8 *)"Accept-Ranges";
+  Response[1].FieldValue = (CHAR8 *)"bytes";
+  EXPECT_TRUE (HttpBootRangeSupported (2, Response));
+
+  Response[1].FieldValue = (CHAR8 *)"none";
+  EXPECT_FALSE (HttpBootRangeSupported (2, Response));
+  EXPECT_FALSE (HttpBootRangeSupported (1, Response));
+}
+
+// Test Description:
+// The slices are disjoint, cover the file and the last one takes the remainder.
+TEST_F (HttpBootRangeTest, SlicesShouldCoverTheFile) {
+  HTTP_BOOT_RANGE_CONNECTION  Connections[4];
+  UINT8                       File[10];
+
+  ZeroMem (Connections, sizeof (Connections));
+  HttpBootRangeSplit (Connections, 4, sizeof (File), File);
+  for (UINTN Index = 0; Index < 4; Index++) {
+    EXPECT_EQ (Connections[Index].Offset, Index * 2);
+    EXPECT_EQ (Connections[Index].Buffer, File + Index * 2);
+    EXPECT_EQ (Connections[Index].State, HttpBootRangeIdle);
+  }
+
+  EXPECT_EQ (Connections[0].Length, 2U);
+  EXPECT_EQ (Connections[3].Length, 4U);
+}
+
+// Test Description:
+// The slices received over the connections are reassembled in the buffer.
+TEST_F (HttpBootRangeTest, SlicesShouldBeReassembled) {
+  HTTP_BOOT_RANGE_CONNECTION  Connections[4];
+  LoopbackServer              Server (3 * SIZE_1MB + 12345, 4);
+
+  AllocateBuffer (Server.File.size ());
+  ASSERT_EQ (Download (Server, Connections, 4), EFI_SUCCESS);
+
+  EXPECT_EQ (CompareMem (Buffer, Server.File.data (), BufferSize), 0);
+  EXPECT_TRUE (GuardIntact ());
+  EXPECT_EQ (CallbackBytes, BufferSize);
+  for (UINTN Index = 0; Index < 4; Index++) {
+    EXPECT_EQ (Connections[Index].State, HttpBootRangeDone);
+    EXPECT_EQ (Connections[Index].Received, Connections[Index].Length);
+    EXPECT_EQ (Server.Http[Index].First, Connections[Index].Offset);
+    EXPECT_EQ (Server.Http[Index].Last, Connections[Index].Offset + Connections[Index].Length - 1);
+    EXPECT_EQ (Connections[Index].Headers, nullptr);
+  }
+
+  EXPECT_FALSE (Server.AnyPending ());
+}
+
+// Test Description:
+// A server that ignores the Range header fails the download before any body is received.
+TEST_F (HttpBootRangeTest, ServerIgnoringRangesShouldBeUnsupported) {
+  HTTP_BOOT_RANGE_CONNECTION  Connections[4];
+  LoopbackServer              Server (4 * SIZE_1MB, 4);
+
+  Server.IgnoreRange = TRUE;
+  AllocateBuffer (Server.File.size ());
+  EXPECT_EQ (Download (Server, Connections, 4), EFI_UNSUPPORTED);
+
+  EXPECT_TRUE (GuardIntact ());
+  EXPECT_EQ (CallbackBytes, 0U);
+  EXPECT_FALSE (Server.AnyPending ());
+  for (UINTN Index = 0; Index < 4; Index++) {
+    EXPECT_EQ (Connections[Index].State, HttpBootRangeFailed);
+  }
+}
+
+// Test Description:
+// A Content-Range that differs from the requested range fails the download.
+TEST_F (HttpBootRangeTest, WrongContentRangeShouldFail) {
+  HTTP_BOOT_RANGE_CONNECTION  Connections[2];
+  LoopbackServer              Server (2 * SIZE_1MB, 2);
+
+  Server.WrongRange = TRUE;
+  AllocateBuffer (Server.File.size ());
+  EXPECT_EQ (Download (Server, Connections, 2), EFI_PROTOCOL_ERROR);
+  EXPECT_EQ (CallbackBytes, 0U);
+  EXPECT_FALSE (Server.AnyPending ());
+}
+
+// Test Description:
+// A Content-Range of a file of another size fails the download.
+TEST_F (HttpBootRangeTest, WrongContentRangeSizeShouldFail) {
+  HTTP_BOOT_RANGE_CONNECTION  Connections[2];
+  LoopbackServer              Server (2 * SIZE_1MB, 2);
+
+  Server.WrongSize = TRUE;
+  AllocateBuffer (Server.File.size ());
+  EXPECT_EQ (Download (Server, Connections, 2), EFI_PROTOCOL_ERROR);
+  EXPECT_EQ (CallbackBytes, 0U);
+  EXPECT_FALSE (Server.AnyPending ());
+}
+
+// Test Description:
+// A stalled connection times out and the tokens of the other connections are cancelled.
+TEST_F (HttpBootRangeTest, StalledConnectionShouldTimeOut) {
+  HTTP_BOOT_RANGE_CONNECTION  Connections[4];
+  LoopbackServer              Server (16 * SIZE_1MB, 4);
+
+  Server.Http[2].Stalled = TRUE;
+  AllocateBuffer (Server.File.size ());
+  EXPECT_EQ (Download (Server, Connections, 4), EFI_TIMEOUT);
+
+  EXPECT_EQ (Connections[2].Status, EFI_TIMEOUT);
+  EXPECT_EQ (Server.Http[2].Cancelled, 1U);
+  EXPECT_FALSE (Server.AnyPending ());
+  EXPECT_GE (Server.Clock, (UINT64)LOOPBACK_TIMEOUT);
+  EXPECT_TRUE (GuardIntact ());
+}
+
+// Test Description:
+// The callback aborts the download.
+TEST_F (HttpBootRangeTest, CallbackShouldAbortTheDownload) {
+  HTTP_BOOT_RANGE_CONNECTION  Connections[4];
+  LoopbackServer              Server (4 * SIZE_1MB, 4);
+
+  AbortAfter = SIZE_1MB;
+  AllocateBuffer (Server.File.size ());
+  EXPECT_EQ (Download (Server, Connections, 4), EFI_ABORTED);
+  EXPECT_FALSE (Server.AnyPending ());
+}
+
+// Test Description:
+// Connections limited to one window per round trip download the file faster together.
+TEST_F (HttpBootRangeTest, ConcurrentConnectionsShouldBeFaster) {
+  HTTP_BOOT_RANGE_CONNECTION  Single[1];
+  HTTP_BOOT_RANGE_CONNECTION  Concurrent[4];
+  LoopbackServer              SingleServer (8 * SIZE_1MB, 1);
+  LoopbackServer              ConcurrentServer (8 * SIZE_1MB, 4);
+  UINT64                      SingleTime;
+  UINT64                      ConcurrentTime;
+
+  AllocateBuffer (SingleServer.File.size ());
+  ASSERT_EQ (Download (SingleServer, Single, 1), EFI_SUCCESS);
+  SingleTime = Single[0].EndTime - Single[0].StartTime;
+
+  ASSERT_EQ (Download (ConcurrentServer, Concurrent, 4), EFI_SUCCESS);
+  EXPECT_EQ (CompareMem (Buffer, ConcurrentServer.File.data (), BufferSize), 0);
+  ConcurrentTime = 0;
+  for (UINTN Index = 0; Index < 4; Index++) {
+    ConcurrentTime = MAX (ConcurrentTime, Concurrent[Index].EndTime - Concurrent[Index].StartTime);
+
+    //
+    // Each connection runs at one window per round trip.
+    //
+    EXPECT_NEAR (
+      (double)HttpBootRangeThroughput (Concurrent[Index].Received, Concurrent[Index].EndTime - Concurrent[Index].StartTime),
+      (double)LOOPBACK_WINDOW / SIZE_1KB * 1000 / LOOPBACK_RTT_MS,
+      100
+      );
+  }
+
+  printf (
+    "8 MB at %u KB per %u ms: %llu ms (%llu KB/s) over 1 connection, %llu ms (%llu KB/s) over 4\n",
+    LOOPBACK_WINDOW / SIZE_1KB,
+    LOOPBACK_RTT_MS,
+    (unsigned long long)SingleTime,
+    (unsigned long long)HttpBootRangeThroughput (BufferSize, SingleTime),
+    (unsigned long long)ConcurrentTime,
+    (unsigned long long)HttpBootRangeThroughput (BufferSize, ConcurrentTime)
+    );
+  EXPECT_GT (SingleTime, 3 * ConcurrentTime);
+}
@@ -596,18 +596,22 @@ HttpBootHttpIoCallback (
   return EFI_SUCCESS;
 }
 
+// MU_CHANGE [BEGIN] - Download the boot file over several connections
+
 /**
-  Create a HttpIo instance for the file download.
+  Create and configure a HttpIo instance on the station address of the driver.
 
   @param[in]    Private        The pointer to the driver's private data.
+  @param[out]   HttpIo         The HttpIo instance to create.
 
   @retval EFI_SUCCESS          Successfully created.
   @retval Others               Failed to create HttpIo.
 
 **/
 EFI_STATUS
-HttpBootCreateHttpIo (
-  IN     HTTP_BOOT_PRIVATE_DATA  *Private
+HttpBootCreateHttpIoInstance (
+  IN     HTTP_BOOT_PRIVATE_DATA  *Private,
+  OUT    HTTP_IO                 *HttpIo
   )
 {
   HTTP_IO_CONFIG_DATA  ConfigData;
@@ -643,8 +647,30 @@ HttpBootCreateHttpIo (
              &ConfigData,
              HttpBootHttpIoCallback,
              (VOID *)Private,
-             &Private->HttpIo
+             HttpIo
              );
+  return Status;
+}
+
+/**
+  Create a HttpIo instance for the file download.
+
+  @param[in]    Private        The pointer to the driver's private data.
+
+  @retval EFI_SUCCESS          Successfully created.
+  @retval Others               Failed to create HttpIo.
+
+**/
+EFI_STATUS
+HttpBootCreateHttpIo (
+  IN     HTTP_BOOT_PRIVATE_DATA  *Private
+  )
+{
+  EFI_STATUS  Status;
+
+  ASSERT (Private != NULL);
+
+  Status = HttpBootCreateHttpIoInstance (Private, &Private->HttpIo);
   if (EFI_ERROR (Status)) {
     return Status;
   }
@@ -653,6 +679,8 @@ HttpBootCreateHttpIo (
   return EFI_SUCCESS;
 }
 
+// MU_CHANGE [END]
+
 /**
   Release all the resource of a cache item.
 
@@ -901,6 +929,197 @@ HttpBootGetBootFileCallback (
   return EFI_SUCCESS;
 }
 
+// MU_CHANGE [BEGIN] - Download the boot file over several connections
+
+/**
+  Notify function of the timer that counts the milliseconds of a ranged download.
+
+  @param[in]    Event              The timer event.
+  @param[in]    Context            Pointer to the milliseconds counter.
+
+**/
+VOID
+EFIAPI
+HttpBootRangeTick (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  *(volatile UINT64 *)Context += HTTP_BOOT_RANGE_TICK_MS;
+}
+
+/**
+  Report each block received by a ranged download to the HTTP Boot callback.
+
+  @param[in]    Context            The pointer to the driver's private data.
+  @param[in]    Length             Length in bytes of the block.
+  @param[in]    Data               The block.
+
+  @retval EFI_SUCCESS              Continue the download.
+  @retval Others                   Abort the download.
+
+**/
+EFI_STATUS
+EFIAPI
+HttpBootRangeCallback (
+  IN VOID   *Context,
+  IN UINTN  Length,
+  IN UINT8  *Data
+  )
+{
+  HTTP_BOOT_PRIVATE_DATA  *Private;
+
+  Private = (HTTP_BOOT_PRIVATE_DATA *)Context;
+  if (Private->HttpBootCallback == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  return Private->HttpBootCallback->Callback (
+                                      Private->HttpBootCallback,
+                                      HttpBootHttpEntityBody,
+                                      TRUE,
+                                      (UINT32)Length,
+                                      Data
+                                      );
+}
+
+/**
+  Download the boot file with concurrent range requests over several HttpIo
+  instances, each of them receiving a slice of the file in Buffer.
+
+  @param[in]       Private         The pointer to the driver's private data.
+  @param[in]       HttpIoHeader    Headers of the request of the boot file.
+  @param[in]       Url             The boot file URL.
+  @param[in, out]  BufferSize      On input the size of Buffer in bytes. On output with a return
+                                   code of EFI_SUCCESS, the size of the file.
+  @param[out]      Buffer          The memory buffer to transfer the file to.
+
+  @retval EFI_SUCCESS              The file was loaded.
+  @retval EFI_UNSUPPORTED          The ranged download is disabled, the file is too small or
+                                   the server does not accept range requests.
+  @retval EFI_ABORTED              The HTTP Boot callback aborted the download.
+  @retval Others                   The ranged download failed, the file has to be downloaded
+                                   over a single connection.
+
+**/
+EFI_STATUS
+HttpBootGetBootFileRanges (
+  IN     HTTP_BOOT_PRIVATE_DATA  *Private,
+  IN     HTTP_IO_HEADER          *HttpIoHeader,
+  IN     CHAR16                  *Url,
+  IN OUT UINTN                   *BufferSize,
+  OUT UINT8                      *Buffer
+  )
+{
+  EFI_STATUS                  Status;
+  UINTN                       Count;
+  UINTN                       Created;
+  UINTN                       Index;
+  HTTP_IO                     *HttpIo;
+  HTTP_BOOT_RANGE_CONNECTION  *Connections;
+  EFI_HTTP_REQUEST_DATA       RequestData;
+  EFI_EVENT                   TimerEvent;
+  volatile UINT64             Clock;
+
+  Count = MIN (PcdGet8 (PcdHttpBootRangeConnections), HTTP_BOOT_RANGE_MAX_CONNECTIONS);
+  Count = MIN (Count, Private->BootFileSize / HTTP_BOOT_RANGE_MIN_SLICE_SIZE);
+  if ((Count < 2) || !Private->AcceptRanges || (*BufferSize < Private->BootFileSize)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  HttpIo      = AllocateZeroPool (Count * sizeof (HTTP_IO));
+  Connections = AllocateZeroPool (Count * sizeof (HTTP_BOOT_RANGE_CONNECTION));
+  TimerEvent  = NULL;
+  Created     = 0;
+  if ((HttpIo == NULL) || (Connections == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto ON_EXIT;
+  }
+
+  //
+  // The connection of the driver is left idle, so that the file can still be
+  // downloaded over it when the ranged download fails half way.
+  //
+  for (Created = 0; Created < Count; Created++) {
+    Status = HttpBootCreateHttpIoInstance (Private, &HttpIo[Created]);
+    if (EFI_ERROR (Status)) {
+      goto ON_EXIT;
+    }
+
+    Connections[Created].HttpIo = &HttpIo[Created];
+  }
+
+  HttpBootRangeSplit (Connections, Count, Private->BootFileSize, Buffer);
+
+  Clock  = 0;
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  HttpBootRangeTick,
+                  (VOID *)&Clock,
+                  &TimerEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    goto ON_EXIT;
+  }
+
+  Status = gBS->SetTimer (TimerEvent, TimerPeriodic, HTTP_BOOT_RANGE_TICK_MS * TICKS_PER_MS);
+  if (EFI_ERROR (Status)) {
+    goto ON_EXIT;
+  }
+
+  //
+  // The partial responses are not reported to the HTTP Boot callback, set the
+  // progress of the default callback to the size of the whole file.
+  //
+  Private->FileSize     = Private->BootFileSize;
+  Private->ReceivedSize = 0;
+  Private->Percentage   = 0;
+
+  RequestData.Method = HttpMethodGet;
+  RequestData.Url    = Url;
+  Status             = HttpBootRangeDownload (
+                         Connections,
+                         Count,
+                         &RequestData,
+                         HttpIoHeader->HeaderCount,
+                         HttpIoHeader->Headers,
+                         &Clock,
+                         PcdGet32 (PcdHttpIoTimeout),
+                         HttpBootRangeCallback,
+                         Private
+                         );
+  if (!EFI_ERROR (Status)) {
+    HttpBootRangeReport (Connections, Count);
+    *BufferSize = Private->BootFileSize;
+  }
+
+ON_EXIT:
+  if (TimerEvent != NULL) {
+    gBS->CloseEvent (TimerEvent);
+  }
+
+  for (Index = 0; Index < Created; Index++) {
+    HttpIoDestroyIo (&HttpIo[Index]);
+  }
+
+  if (Connections != NULL) {
+    FreePool (Connections);
+  }
+
+  if (HttpIo != NULL) {
+    FreePool (HttpIo);
+  }
+
+  if (EFI_ERROR (Status) && (Status != EFI_ABORTED)) {
+    DEBUG ((DEBUG_WARN, "HttpBootGetBootFileRanges: %r, download over a single connection\n", Status));
+  }
+
+  return Status;
+}
+
+// MU_CHANGE [END]
+
 /**
   This function download the boot file by using UEFI HTTP protocol.
 
@@ -1097,6 +1316,23 @@ HttpBootGetBootFile (
     }
   }
 
+  // MU_CHANGE [BEGIN] - Download the boot file over several connections
+  //
+  // Download the file with concurrent range requests when it is enabled and
+  // the server accepts them, or else over the connection of the driver.
+  //
+  if (!HeaderOnly && (Buffer != NULL)) {
+    Status = HttpBootGetBootFileRanges (Private, HttpIoHeader, Url, BufferSize, Buffer);
+    if (!EFI_ERROR (Status) || (Status == EFI_ABORTED)) {
+      *ImageType = Private->ImageType;
+      HttpIoFreeHeader (HttpIoHeader);
+      FreePool (Url);
+      return Status;
+    }
+  }
+
+  // MU_CHANGE [END]
+
   //
   // 2.2 Build the rest of HTTP request info.
   //
@@ -1223,6 +1459,11 @@ HttpBootGetBootFile (
     goto ERROR_5;
   }
 
+  //
+  // Record whether the server accepts range requests for the file.
+  //
+  Private->AcceptRanges = HttpBootRangeSupported (ResponseData->HeaderCount, ResponseData->Headers);   // MU_CHANGE - Download the boot file over several connections
+
   //
   // Check the image type according to server's response.
   //
@@ -108,6 +108,7 @@ typedef enum  {
 #include "HttpBootImpl.h"
 #include "HttpBootSupport.h"
 #include "HttpBootClient.h"
+#include "HttpBootRange.h"   // MU_CHANGE - Download the boot file over several connections
 #include "HttpBootConfig.h"
 
 typedef union {
@@ -214,6 +215,7 @@ struct _HTTP_BOOT_PRIVATE_DATA {
   CHAR8                                        *BootFileUri;
   VOID                                         *BootFileUriParser;
   UINTN                                        BootFileSize;
+  BOOLEAN                                      AcceptRanges;   // MU_CHANGE - Download the boot file over several connections
   BOOLEAN                                      NoGateway;
   HTTP_BOOT_IMAGE_TYPE                         ImageType;
 
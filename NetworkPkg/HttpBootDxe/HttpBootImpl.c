@@ -471,6 +471,7 @@ HttpBootStop (
   Private->BootFileUri       = NULL;
   Private->BootFileUriParser = NULL;
   Private->BootFileSize      = 0;
+  Private->AcceptRanges      = FALSE;   // MU_CHANGE - Download the boot file over several connections
   Private->SelectIndex       = 0;
   Private->SelectProxyType   = HttpOfferTypeMax;
 
@@ -0,0 +1,622 @@
+/** @file
+  Download of the boot file over several HTTP connections with range requests.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <IndustryStandard/Http11.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HttpLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+
+#include "HttpBootRange.h"
+
+/**
+  Check whether the server accepts byte range requests for the file.
+
+  @param[in]    HeaderCount        Number of HTTP header structures in Headers.
+  @param[in]    Headers            Headers of the response to a request of the file.
+
+  @retval TRUE                     The response carries "Accept-Ranges: bytes".
+  @retval FALSE                    Range requests are not accepted.
+
+**/
+BOOLEAN
+HttpBootRangeSupported (
+  IN UINTN            HeaderCount,
+  IN EFI_HTTP_HEADER  *Headers
+  )
+{
+  EFI_HTTP_HEADER  *Header;
+
+  Header = HttpFindHeader (HeaderCount, Headers, HTTP_HEADER_ACCEPT_RANGES);
+  if ((Header == NULL) || (Header->FieldValue == NULL)) {
+    return FALSE;
+  }
+
+  return (BOOLEAN)(AsciiStrStr (Header->FieldValue, "bytes") != NULL);
+}
+
+/**
+  Split the file in one slice per connection, in the order of the connections.
+
+  @param[in, out]  Connections     The connections, their HttpIo is kept.
+  @param[in]       Count           Number of connections.
+  @param[in]       FileSize        Size in bytes of the file.
+  @param[in]       Buffer          Destination buffer of FileSize bytes.
+
+**/
+VOID
+HttpBootRangeSplit (
+  IN OUT HTTP_BOOT_RANGE_CONNECTION  *Connections,
+  IN     UINTN                       Count,
+  IN     UINTN                       FileSize,
+  IN     UINT8                       *Buffer
+  )
+{
+  UINTN    Index;
+  UINTN    SliceSize;
+  HTTP_IO  *HttpIo;
+
+  ASSERT (Count != 0 && FileSize >= Count);
+
+  SliceSize = FileSize / Count;
+  for (Index = 0; Index < Count; Index++) {
+    HttpIo = Connections[Index].HttpIo;
+    ZeroMem (&Connections[Index], sizeof (HTTP_BOOT_RANGE_CONNECTION));
+    Connections[Index].HttpIo   = HttpIo;
+    Connections[Index].State    = HttpBootRangeIdle;
+    Connections[Index].Offset   = Index * SliceSize;
+    Connections[Index].Length   = SliceSize;
+    Connections[Index].FileSize = FileSize;
+    Connections[Index].Buffer   = Buffer + Connections[Index].Offset;
+  }
+
+  //
+  // The last slice takes the remainder of the division.
+  //
+  Connections[Count - 1].Length = FileSize - Connections[Count - 1].Offset;
+}
+
+/**
+  Parse a decimal number of a Content-Range header value.
+
+  @param[in, out]  String          On input the number, on output the character after it.
+  @param[out]      Value           The number.
+
+  @retval EFI_SUCCESS              The number is parsed.
+  @retval EFI_PROTOCOL_ERROR       There is no number at String.
+
+**/
+STATIC
+EFI_STATUS
+HttpBootRangeParseNumber (
+  IN OUT CHAR8   **String,
+  OUT    UINT64  *Value
+  )
+{
+  EFI_STATUS  Status;
+  CHAR8       *End;
+
+  Status = AsciiStrDecimalToUint64S (*String, &End, Value);
+  if (EFI_ERROR (Status) || (End == *String)) {
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  *String = End;
+  return EFI_SUCCESS;
+}
+
+/**
+  Check that the response header carries the slice requested by the connection.
+
+  @param[in]    Connection         The connection.
+  @param[in]    Message            The response message.
+
+  @retval EFI_SUCCESS              The server answered with the requested range.
+  @retval EFI_UNSUPPORTED          The server answered with the whole file.
+  @retval EFI_PROTOCOL_ERROR       The server answered with another range, or
+                                   with the range of a file of another size.
+  @retval EFI_HTTP_ERROR           The server answered with an error status.
+
+**/
+STATIC
+EFI_STATUS
+HttpBootRangeCheckResponse (
+  IN HTTP_BOOT_RANGE_CONNECTION  *Connection,
+  IN EFI_HTTP_MESSAGE            *Message
+  )
+{
+  EFI_HTTP_HEADER  *Header;
+  CHAR8            *String;
+  UINT64           First;
+  UINT64           Last;
+  UINT64           Size;
+
+  if (Connection->Response.StatusCode == HTTP_STATUS_200_OK) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (Connection->Response.StatusCode != HTTP_STATUS_206_PARTIAL_CONTENT) {
+    return EFI_HTTP_ERROR;
+  }
+
+  //
+  // Content-Range: bytes <First>-<Last>/<Size>
+  //
+  Header = HttpFindHeader (Message->HeaderCount, Message->Headers, HTTP_BOOT_HEADER_CONTENT_RANGE);
+  if ((Header == NULL) || (Header->FieldValue == NULL)) {
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  String = Header->FieldValue;
+  if (AsciiStrnCmp (String, "bytes ", 6) != 0) {
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  String += 6;
+  if (EFI_ERROR (HttpBootRangeParseNumber (&String, &First)) || (*String != '-')) {
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  String++;
+  if (EFI_ERROR (HttpBootRangeParseNumber (&String, &Last)) || (*String != '/')) {
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  //
+  // An unknown size ("*") or another size means the file changed since its
+  // size was queried, so the slices would not assemble into one file.
+  //
+  String++;
+  if (EFI_ERROR (HttpBootRangeParseNumber (&String, &Size)) || (Size != Connection->FileSize)) {
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  if ((First != Connection->Offset) || (Last != Connection->Offset + Connection->Length - 1)) {
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Queue a response token on the connection.
+
+  @param[in, out]  Connection      The connection.
+  @param[in]       RecvMsgHeader   TRUE to receive the response header, FALSE to
+                                   receive the rest of the slice.
+
+  @retval EFI_SUCCESS              The token is queued.
+  @retval Others                   The HTTP instance refused the token.
+
+**/
+STATIC
+EFI_STATUS
+HttpBootRangeRecv (
+  IN OUT HTTP_BOOT_RANGE_CONNECTION  *Connection,
+  IN     BOOLEAN                     RecvMsgHeader
+  )
+{
+  HTTP_IO  *HttpIo;
+
+  HttpIo                                = Connection->HttpIo;
+  HttpIo->RspToken.Status               = EFI_NOT_READY;
+  HttpIo->IsRxDone                      = FALSE;
+  HttpIo->RspToken.Message->HeaderCount = 0;
+  HttpIo->RspToken.Message->Headers     = NULL;
+  if (RecvMsgHeader) {
+    HttpIo->RspToken.Message->Data.Response = &Connection->Response;
+    HttpIo->RspToken.Message->BodyLength    = 0;
+    HttpIo->RspToken.Message->Body          = NULL;
+  } else {
+    HttpIo->RspToken.Message->Data.Response = NULL;
+    HttpIo->RspToken.Message->BodyLength    = Connection->Length - Connection->Received;
+    HttpIo->RspToken.Message->Body          = Connection->Buffer + Connection->Received;
+  }
+
+  return HttpIo->Http->Response (HttpIo->Http, &HttpIo->RspToken);
+}
+
+/**
+  Send the range request of the connection.
+
+  @param[in, out]  Connection      The connection.
+  @param[in]       Request         The GET request of the file.
+  @param[in]       HeaderCount     Number of HTTP header structures in Headers.
+  @param[in]       Headers         Headers of the request, without the Range header.
+  @param[in]       Now             Current time in milliseconds.
+
+  @retval EFI_SUCCESS              The request is queued.
+  @retval EFI_OUT_OF_RESOURCES     Could not allocate the request headers.
+  @retval Others                   The HTTP instance refused the request.
+
+**/
+STATIC
+EFI_STATUS
+HttpBootRangeSend (
+  IN OUT HTTP_BOOT_RANGE_CONNECTION  *Connection,
+  IN     EFI_HTTP_REQUEST_DATA       *Request,
+  IN     UINTN                       HeaderCount,
+  IN     EFI_HTTP_HEADER             *Headers,
+  IN     UINT64                      Now
+  )
+{
+  EFI_STATUS  Status;
+  HTTP_IO     *HttpIo;
+
+  //
+  // The header array is copied to append the Range header, the names and
+  // values of the other headers are shared with the caller.
+  //
+  Connection->Headers = AllocatePool ((HeaderCount + 1) * sizeof (EFI_HTTP_HEADER));
+  if (Connection->Headers == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  CopyMem (Connection->Headers, Headers, HeaderCount * sizeof (EFI_HTTP_HEADER));
+  AsciiSPrint (
+    Connection->RangeValue,
+    sizeof (Connection->RangeValue),
+    "bytes=%lu-%lu",
+    (UINT64)Connection->Offset,
+    (UINT64)(Connection->Offset + Connection->Length - 1)
+    );
+  Connection->Headers[HeaderCount].FieldName  = HTTP_BOOT_HEADER_RANGE;
+  Connection->Headers[HeaderCount].FieldValue = Connection->RangeValue;
+
+  HttpIo                                 = Connection->HttpIo;
+  HttpIo->ReqToken.Status                = EFI_NOT_READY;
+  HttpIo->ReqToken.Message->Data.Request = Request;
+  HttpIo->ReqToken.Message->HeaderCount  = HeaderCount + 1;
+  HttpIo->ReqToken.Message->Headers      = Connection->Headers;
+  HttpIo->ReqToken.Message->BodyLength   = 0;
+  HttpIo->ReqToken.Message->Body         = NULL;
+
+  if (HttpIo->Callback != NULL) {
+    Status = HttpIo->Callback (HttpIoRequest, HttpIo->ReqToken.Message, HttpIo->Context);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  HttpIo->IsTxDone = FALSE;
+  Status           = HttpIo->Http->Request (HttpIo->Http, &HttpIo->ReqToken);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Connection->State        = HttpBootRangeSendRequest;
+  Connection->StartTime    = Now;
+  Connection->LastActivity = Now;
+  return EFI_SUCCESS;
+}
+
+/**
+  Poll the connection and move it to its next state when its token completed.
+
+  @param[in, out]  Connection      The connection.
+  @param[in]       Now             Current time in milliseconds.
+  @param[in]       Timeout         Milliseconds the connection may go without completing a token.
+  @param[in]       Callback        Optional function invoked for each received block.
+  @param[in]       Context         Context passed to Callback.
+
+  @retval EFI_NOT_READY            The slice is being received.
+  @retval EFI_SUCCESS              The slice is received.
+  @retval Others                   The connection failed.
+
+**/
+STATIC
+EFI_STATUS
+HttpBootRangePoll (
+  IN OUT HTTP_BOOT_RANGE_CONNECTION  *Connection,
+  IN     UINT64                      Now,
+  IN     UINT32                      Timeout,
+  IN     HTTP_BOOT_RANGE_CALLBACK    Callback  OPTIONAL,
+  IN     VOID                        *Context
+  )
+{
+  EFI_STATUS        Status;
+  HTTP_IO           *HttpIo;
+  EFI_HTTP_MESSAGE  *Message;
+  UINT8             *Data;
+
+  HttpIo  = Connection->HttpIo;
+  Message = HttpIo->RspToken.Message;
+  HttpIo->Http->Poll (HttpIo->Http);
+
+  Status = EFI_NOT_READY;
+  switch (Connection->State) {
+    case HttpBootRangeSendRequest:
+      if (!HttpIo->IsTxDone) {
+        break;
+      }
+
+      FreePool (Connection->Headers);
+      Connection->Headers = NULL;
+      Status              = HttpIo->ReqToken.Status;
+      if (!EFI_ERROR (Status)) {
+        Status = HttpBootRangeRecv (Connection, TRUE);
+      }
+
+      Connection->State        = HttpBootRangeRecvHeader;
+      Connection->LastActivity = Now;
+      break;
+
+    case HttpBootRangeRecvHeader:
+      if (!HttpIo->IsRxDone) {
+        break;
+      }
+
+      //
+      // The response header is not reported to the HttpIo callback, its
+      // Content-Length is the length of the slice and not of the file.
+      //
+      Status = HttpIo->RspToken.Status;
+      if (!EFI_ERROR (Status) || (Status == EFI_HTTP_ERROR)) {
+        Status = HttpBootRangeCheckResponse (Connection, Message);
+      }
+
+      if (Message->Headers != NULL) {
+        HttpFreeHeaderFields (Message->Headers, Message->HeaderCount);
+        Message->Headers = NULL;
+      }
+
+      if (!EFI_ERROR (Status)) {
+        Status = HttpBootRangeRecv (Connection, FALSE);
+      }
+
+      Connection->State        = HttpBootRangeRecvBody;
+      Connection->LastActivity = Now;
+      break;
+
+    case HttpBootRangeRecvBody:
+      if (!HttpIo->IsRxDone) {
+        break;
+      }
+
+      Status = HttpIo->RspToken.Status;
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+
+      Data                      = Connection->Buffer + Connection->Received;
+      Connection->Received     += Message->BodyLength;
+      Connection->LastActivity  = Now;
+      if (Callback != NULL) {
+        Status = Callback (Context, Message->BodyLength, Data);
+        if (EFI_ERROR (Status)) {
+          break;
+        }
+      }
+
+      if (Connection->Received >= Connection->Length) {
+        Connection->State   = HttpBootRangeDone;
+        Connection->EndTime = Now;
+        Status              = EFI_SUCCESS;
+      } else {
+        Status = HttpBootRangeRecv (Connection, FALSE);
+      }
+
+      break;
+
+    case HttpBootRangeDone:
+      return EFI_SUCCESS;
+
+    default:
+      return Connection->Status;
+  }
+
+  if (Status == EFI_SUCCESS) {
+    Status = (Connection->State == HttpBootRangeDone) ? EFI_SUCCESS : EFI_NOT_READY;
+  } else if ((Status == EFI_NOT_READY) && (Timeout != 0) && (Now - Connection->LastActivity > Timeout)) {
+    Status = EFI_TIMEOUT;
+  }
+
+  if ((Status != EFI_NOT_READY) && (Status != EFI_SUCCESS)) {
+    Connection->Status = Status;
+  }
+
+  return Status;
+}
+
+/**
+  Cancel the token outstanding on the connection, if any.
+
+  @param[in, out]  Connection      The connection.
+
+**/
+STATIC
+VOID
+HttpBootRangeCancel (
+  IN OUT HTTP_BOOT_RANGE_CONNECTION  *Connection
+  )
+{
+  HTTP_IO  *HttpIo;
+
+  HttpIo = Connection->HttpIo;
+  switch (Connection->State) {
+    case HttpBootRangeSendRequest:
+      if (!HttpIo->IsTxDone) {
+        HttpIo->Http->Cancel (HttpIo->Http, &HttpIo->ReqToken);
+      }
+
+      break;
+
+    case HttpBootRangeRecvHeader:
+    case HttpBootRangeRecvBody:
+      if (!HttpIo->IsRxDone) {
+        HttpIo->Http->Cancel (HttpIo->Http, &HttpIo->RspToken);
+      }
+
+      break;
+
+    default:
+      break;
+  }
+
+  if (Connection->Headers != NULL) {
+    FreePool (Connection->Headers);
+    Connection->Headers = NULL;
+  }
+
+  if (Connection->State != HttpBootRangeDone) {
+    Connection->State = HttpBootRangeFailed;
+    if (!EFI_ERROR (Connection->Status)) {
+      Connection->Status = EFI_ABORTED;
+    }
+  }
+}
+
+/**
+  Download the slices of all the connections concurrently.
+
+  The requests are sent on all the connections, then the connections are
+  polled in turn until all of the slices are received or one of them fails.
+  When a connection fails, the tokens outstanding on the others are cancelled.
+
+  @param[in, out]  Connections     The connections, as set by HttpBootRangeSplit().
+  @param[in]       Count           Number of connections.
+  @param[in]       Request         The GET request of the file.
+  @param[in]       HeaderCount     Number of HTTP header structures in Headers.
+  @param[in]       Headers         Headers of the request, without the Range header.
+  @param[in]       Clock           Milliseconds counter that advances during the download.
+  @param[in]       Timeout         Milliseconds a connection may go without completing a token.
+  @param[in]       Callback        Optional function invoked for each received block.
+  @param[in]       Context         Context passed to Callback.
+
+  @retval EFI_SUCCESS              All the slices are received.
+  @retval EFI_UNSUPPORTED          The server did not answer with the requested range.
+  @retval EFI_TIMEOUT              A connection timed out.
+  @retval EFI_OUT_OF_RESOURCES     Could not allocate the request headers.
+  @retval Others                   A connection failed, or Callback aborted the download.
+
+**/
+EFI_STATUS
+HttpBootRangeDownload (
+  IN OUT HTTP_BOOT_RANGE_CONNECTION  *Connections,
+  IN     UINTN                       Count,
+  IN     EFI_HTTP_REQUEST_DATA       *Request,
+  IN     UINTN                       HeaderCount,
+  IN     EFI_HTTP_HEADER             *Headers,
+  IN     volatile UINT64             *Clock,
+  IN     UINT32                      Timeout,
+  IN     HTTP_BOOT_RANGE_CALLBACK    Callback  OPTIONAL,
+  IN     VOID                        *Context
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+  UINTN       Active;
+
+  Status = EFI_SUCCESS;
+  for (Index = 0; Index < Count; Index++) {
+    Status = HttpBootRangeSend (&Connections[Index], Request, HeaderCount, Headers, *Clock);
+    if (EFI_ERROR (Status)) {
+      Connections[Index].Status = Status;
+      goto ON_EXIT;
+    }
+  }
+
+  Active = Count;
+  while (Active > 0) {
+    for (Index = 0; Index < Count; Index++) {
+      if (Connections[Index].State == HttpBootRangeDone) {
+        continue;
+      }
+
+      Status = HttpBootRangePoll (&Connections[Index], *Clock, Timeout, Callback, Context);
+      if (Status == EFI_SUCCESS) {
+        Active--;
+      } else if (Status != EFI_NOT_READY) {
+        DEBUG ((
+          DEBUG_WARN,
+          "HttpBootRange: connection %Lu failed at %lu of %lu bytes - %r\n",
+          (UINT64)Index,
+          (UINT64)Connections[Index].Received,
+          (UINT64)Connections[Index].Length,
+          Status
+          ));
+        goto ON_EXIT;
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+
+ON_EXIT:
+  for (Index = 0; Index < Count; Index++) {
+    HttpBootRangeCancel (&Connections[Index]);
+  }
+
+  return Status;
+}
+
+/**
+  Compute a throughput in KB per second.
+
+  @param[in]    Bytes              Bytes transferred.
+  @param[in]    Milliseconds       Duration of the transfer.
+
+  @return The throughput in KB/s.
+
+**/
+UINT64
+HttpBootRangeThroughput (
+  IN UINT64  Bytes,
+  IN UINT64  Milliseconds
+  )
+{
+  return DivU64x64Remainder (MultU64x32 (Bytes, 1000), MultU64x32 (MAX (Milliseconds, 1), SIZE_1KB), NULL);
+}
+
+/**
+  Report the throughput of each connection and of the whole download.
+
+  @param[in]    Connections        The connections of a completed download.
+  @param[in]    Count              Number of connections.
+
+**/
+VOID
+HttpBootRangeReport (
+  IN HTTP_BOOT_RANGE_CONNECTION  *Connections,
+  IN UINTN                       Count
+  )
+{
+  UINTN   Index;
+  UINT64  Start;
+  UINT64  End;
+  UINT64  Total;
+
+  Start = MAX_UINT64;
+  End   = 0;
+  Total = 0;
+  for (Index = 0; Index < Count; Index++) {
+    DEBUG ((
+      DEBUG_INFO,
+      "HttpBootRange: connection %Lu received %lu bytes at offset %lu in %lu ms, %lu KB/s\n",
+      (UINT64)Index,
+      (UINT64)Connections[Index].Received,
+      (UINT64)Connections[Index].Offset,
+      Connections[Index].EndTime - Connections[Index].StartTime,
+      HttpBootRangeThroughput (Connections[Index].Received, Connections[Index].EndTime - Connections[Index].StartTime)
+      ));
+    Start  = MIN (Start, Connections[Index].StartTime);
+    End    = MAX (End, Connections[Index].EndTime);
+    Total += Connections[Index].Received;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "HttpBootRange: %lu bytes over %Lu connections in %lu ms, %lu KB/s\n",
+    Total,
+    (UINT64)Count,
+    End - Start,
+    HttpBootRangeThroughput (Total, End - Start)
+    ));
+}
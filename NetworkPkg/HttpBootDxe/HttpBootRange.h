@@ -0,0 +1,192 @@
+/** @file
+  Download of the boot file over several HTTP connections with range requests.
+
+  When PcdHttpBootRangeConnections is greater than one and the server announces
+  "Accept-Ranges: bytes", the boot file is split in as many slices as there are
+  connections, and each connection receives its slice with a "Range" request
+  directly into the destination buffer. The requests of all the connections are
+  outstanding at the same time, so the download is not bounded by the window of
+  a single TCP connection on a long distance link.
+
+  A server that answers a range request with anything but the expected partial
+  content fails the ranged download, and the caller downloads the file again
+  over a single connection.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __EFI_HTTP_BOOT_RANGE_H__
+#define __EFI_HTTP_BOOT_RANGE_H__
+
+#include <Uefi.h>
+#include <Protocol/Http.h>
+#include <Library/HttpIoLib.h>
+
+#define HTTP_BOOT_RANGE_MAX_CONNECTIONS  8
+
+//
+// Smallest slice worth a connection of its own.
+//
+#define HTTP_BOOT_RANGE_MIN_SLICE_SIZE  SIZE_1MB
+
+//
+// Period in milliseconds of the clock that times the connections.
+//
+#define HTTP_BOOT_RANGE_TICK_MS  10
+
+#define HTTP_BOOT_HEADER_RANGE          "Range"
+#define HTTP_BOOT_HEADER_CONTENT_RANGE  "Content-Range"
+
+typedef enum {
+  HttpBootRangeIdle,
+  HttpBootRangeSendRequest,
+  HttpBootRangeRecvHeader,
+  HttpBootRangeRecvBody,
+  HttpBootRangeDone,
+  HttpBootRangeFailed
+} HTTP_BOOT_RANGE_STATE;
+
+/**
+  Callback function invoked for each block of the message-body received by a
+  connection.
+
+  @param[in]    Context            Context passed to HttpBootRangeDownload().
+  @param[in]    Length             Length in bytes of the block.
+  @param[in]    Data               The block, in the destination buffer.
+
+  @retval EFI_SUCCESS              Continue the download.
+  @retval Others                   Abort the download.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *HTTP_BOOT_RANGE_CALLBACK)(
+  IN VOID   *Context,
+  IN UINTN  Length,
+  IN UINT8  *Data
+  );
+
+///
+/// A connection of the ranged download and the slice of the file it receives.
+///
+typedef struct {
+  HTTP_IO                   *HttpIo;
+  HTTP_BOOT_RANGE_STATE     State;
+  EFI_STATUS                Status;
+
+  UINT8                     *Buffer;          ///< Slice of the destination buffer.
+  UINTN                     Offset;           ///< Offset of the slice in the file.
+  UINTN                     Length;           ///< Length of the slice.
+  UINTN                     Received;
+  UINTN                     FileSize;         ///< Size of the whole file.
+
+  EFI_HTTP_HEADER           *Headers;         ///< Request headers with the Range header appended.
+  CHAR8                     RangeValue[48];
+  EFI_HTTP_RESPONSE_DATA    Response;
+
+  UINT64                    StartTime;        ///< Milliseconds, when the request was sent.
+  UINT64                    LastActivity;     ///< Milliseconds, when the last token completed.
+  UINT64                    EndTime;          ///< Milliseconds, when the slice was received.
+} HTTP_BOOT_RANGE_CONNECTION;
+
+/**
+  Check whether the server accepts byte range requests for the file.
+
+  @param[in]    HeaderCount        Number of HTTP header structures in Headers.
+  @param[in]    Headers            Headers of the response to a request of the file.
+
+  @retval TRUE                     The response carries "Accept-Ranges: bytes".
+  @retval FALSE                    Range requests are not accepted.
+
+**/
+BOOLEAN
+HttpBootRangeSupported (
+  IN UINTN            HeaderCount,
+  IN EFI_HTTP_HEADER  *Headers
+  );
+
+/**
+  Split the file in one slice per connection, in the order of the connections.
+
+  @param[in, out]  Connections     The connections, their HttpIo is kept.
+  @param[in]       Count           Number of connections.
+  @param[in]       FileSize        Size in bytes of the file.
+  @param[in]       Buffer          Destination buffer of FileSize bytes.
+
+**/
+VOID
+HttpBootRangeSplit (
+  IN OUT HTTP_BOOT_RANGE_CONNECTION  *Connections,
+  IN     UINTN                       Count,
+  IN     UINTN                       FileSize,
+  IN     UINT8                       *Buffer
+  );
+
+/**
+  Download the slices of all the connections concurrently.
+
+  The requests are sent on all the connections, then the connections are
+  polled in turn until all of the slices are received or one of them fails.
+  When a connection fails, the tokens outstanding on the others are cancelled.
+
+  @param[in, out]  Connections     The connections, as set by HttpBootRangeSplit().
+  @param[in]       Count           Number of connections.
+  @param[in]       Request         The GET request of the file.
+  @param[in]       HeaderCount     Number of HTTP header structures in Headers.
+  @param[in]       Headers         Headers of the request, without the Range header.
+  @param[in]       Clock           Milliseconds counter that advances during the download.
+  @param[in]       Timeout         Milliseconds a connection may go without completing a token.
+  @param[in]       Callback        Optional function invoked for each received block.
+  @param[in]       Context         Context passed to Callback.
+
+  @retval EFI_SUCCESS              All the slices are received.
+  @retval EFI_UNSUPPORTED          The server did not answer with the requested range.
+  @retval EFI_TIMEOUT              A connection timed out.
+  @retval EFI_OUT_OF_RESOURCES     Could not allocate the request headers.
+  @retval Others                   A connection failed, or Callback aborted the download.
+
+**/
+EFI_STATUS
+HttpBootRangeDownload (
+  IN OUT HTTP_BOOT_RANGE_CONNECTION  *Connections,
+  IN     UINTN                       Count,
+  IN     EFI_HTTP_REQUEST_DATA       *Request,
+  IN     UINTN                       HeaderCount,
+  IN     EFI_HTTP_HEADER             *Headers,
+  IN     volatile UINT64             *Clock,
+  IN     UINT32                      Timeout,
+  IN     HTTP_BOOT_RANGE_CALLBACK    Callback  OPTIONAL,
+  IN     VOID                        *Context
+  );
+
+/**
+  Compute a throughput in KB per second.
+
+  @param[in]    Bytes              Bytes transferred.
+  @param[in]    Milliseconds       Duration of the transfer.
+
+  @return The throughput in KB/s.
+
+**/
+UINT64
+HttpBootRangeThroughput (
+  IN UINT64  Bytes,
+  IN UINT64  Milliseconds
+  );
+
+/**
+  Report the throughput of each connection and of the whole download.
+
+  @param[in]    Connections        The connections of a completed download.
+  @param[in]    Count              Number of connections.
+
+**/
+VOID
+HttpBootRangeReport (
+  IN HTTP_BOOT_RANGE_CONNECTION  *Connections,
+  IN UINTN                       Count
+  );
+
+#endif
@@ -26,6 +26,7 @@
 #include <Library/NetLib.h>
 #include <Library/HttpLib.h>
 #include <Library/DpcLib.h>
+#include <Library/PcdLib.h> // MU_CHANGE - SACK and CUBIC congestion control
 
 //
 // UEFI Driver Model Protocols
@@ -12,6 +12,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include <Protocol/Ip4.h>
 #include <Protocol/Ip6.h>
+#include <Protocol/Ip4Offload.h> // MU_CHANGE - Network offloads
 
 #include <Library/NetLib.h>
 
@@ -163,6 +164,10 @@ typedef struct _EFI_NET_SESSION_DATA {
                                     ///< IPv4, it includes the IP4 header length
                                     ///< and options length.
   UINT8              IpVersion;     ///< The IP version of the received packet.
+  // MU_CHANGE [BEGIN] - Network offloads
+  UINT32             OffloadFlags;  ///< The EDKII_IP4_OFFLOAD_RX_* checksums verified
+                                    ///< by the interface for an IPv4 packet.
+  // MU_CHANGE [END]
 } EFI_NET_SESSION_DATA;
 
 /**
@@ -214,47 +219,53 @@ typedef struct _IP_IO {
   ///
   /// The node used to link this IpIo to the active IpIo list.
   ///
-  LIST_ENTRY                   Entry;
+  LIST_ENTRY                    Entry;
 
   ///
   /// The list used to maintain the IP instance for different sending purpose.
   ///
-  LIST_ENTRY                   IpList;
+  LIST_ENTRY                    IpList;
 
-  EFI_HANDLE                   Controller;
-  EFI_HANDLE                   Image;
-  EFI_HANDLE                   ChildHandle;
+  EFI_HANDLE                    Controller;
+  EFI_HANDLE                    Image;
+  EFI_HANDLE                    ChildHandle;
   //
   // The IP instance consumed by this IP_IO
   //
-  IP_IO_IP_PROTOCOL            Ip;
-  BOOLEAN                      IsConfigured;
+  IP_IO_IP_PROTOCOL             Ip;
+  BOOLEAN                       IsConfigured;
 
   ///
   /// Some ip configuration data can be changed.
   ///
-  UINT8                        Protocol;
+  UINT8                         Protocol;
 
   ///
   /// Token and event used to get data from IP.
   ///
-  IP_IO_IP_COMPLETION_TOKEN    RcvToken;
+  IP_IO_IP_COMPLETION_TOKEN     RcvToken;
 
   ///
   /// List entry used to link the token passed to IP_IO.
   ///
-  LIST_ENTRY                   PendingSndList;
+  LIST_ENTRY                    PendingSndList;
 
   //
   // User interface used to get notify from IP_IO
   //
-  VOID                         *RcvdContext;     ///< See IP_IO_OPEN_DATA::RcvdContext.
-  VOID                         *SndContext;      ///< See IP_IO_OPEN_DATA::SndContext.
-  PKT_RCVD_NOTIFY              PktRcvdNotify;    ///< See IP_IO_OPEN_DATA::PktRcvdNotify.
-  PKT_SENT_NOTIFY              PktSentNotify;    ///< See IP_IO_OPEN_DATA::PktSentNotify.
-  UINT8                        IpVersion;
-  IP4_ADDR                     StationIp;
-  IP4_ADDR                     SubnetMask;
+  VOID                          *RcvdContext;     ///< See IP_IO_OPEN_DATA::RcvdContext.
+  VOID                          *SndContext;      ///< See IP_IO_OPEN_DATA::SndContext.
+  PKT_RCVD_NOTIFY               PktRcvdNotify;    ///< See IP_IO_OPEN_DATA::PktRcvdNotify.
+  PKT_SENT_NOTIFY               PktSentNotify;    ///< See IP_IO_OPEN_DATA::PktSentNotify.
+  UINT8                         IpVersion;
+  IP4_ADDR                      StationIp;
+  IP4_ADDR                      SubnetMask;
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // The offloads of the IPv4 instance, NULL if IP does not provide them.
+  //
+  EDKII_IP4_OFFLOAD_PROTOCOL    *Ip4Offload;
+  // MU_CHANGE [END]
 } IP_IO;
 
 ///
@@ -290,14 +301,15 @@ typedef struct _IP_IO_SEND_ENTRY {
 /// in IP_IO.
 ///
 typedef struct _IP_IO_IP_INFO {
-  EFI_IP_ADDRESS               Addr;
-  IP_IO_IP_MASK                PreMask;
-  LIST_ENTRY                   Entry;
-  EFI_HANDLE                   ChildHandle;
-  IP_IO_IP_PROTOCOL            Ip;
-  IP_IO_IP_COMPLETION_TOKEN    DummyRcvToken;
-  INTN                         RefCnt;
-  UINT8                        IpVersion;
+  EFI_IP_ADDRESS                Addr;
+  IP_IO_IP_MASK                 PreMask;
+  LIST_ENTRY                    Entry;
+  EFI_HANDLE                    ChildHandle;
+  IP_IO_IP_PROTOCOL             Ip;
+  IP_IO_IP_COMPLETION_TOKEN     DummyRcvToken;
+  INTN                          RefCnt;
+  UINT8                         IpVersion;
+  EDKII_IP4_OFFLOAD_PROTOCOL    *Ip4Offload; // MU_CHANGE - Network offloads
 } IP_IO_IP_INFO;
 
 /**
@@ -434,6 +446,77 @@ IpIoSend (
   IN     IP_IO_OVERRIDE  *OverrideData  OPTIONAL
   );
 
+// MU_CHANGE [BEGIN] - Network offloads
+
+/**
+  Send out an IP packet with checksum or segmentation offloads.
+
+  It works as IpIoSend(), and asks the interface to complete the checksums
+  or to segment the packet as specified by OffloadFlags. OffloadFlags may
+  only contain offloads returned by IpIoGetOffloadCapabilities() for the
+  same Sender. When OffloadFlags is zero, it is the same as IpIoSend().
+
+  @param[in, out]  IpIo                  Pointer to an IP_IO instance used for sending IP
+                                         packet.
+  @param[in, out]  Pkt                   Pointer to the IP packet to be sent.
+  @param[in]       Sender                The IP protocol instance used for sending.
+  @param[in]       Context               Optional context data.
+  @param[in]       NotifyData            Optional notify data.
+  @param[in]       Dest                  The destination IP address to send this packet to.
+                                         This parameter is optional when using IPv6.
+  @param[in]       OverrideData          The data to override some configuration of the IP
+                                         instance used for sending.
+  @param[in]       OffloadFlags          The EDKII_IP4_OFFLOAD_TX_* flags.
+  @param[in]       SegmentSize           The largest TCP payload of a segment when
+                                         OffloadFlags has EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND.
+
+  @retval          EFI_SUCCESS           The operation is completed successfully.
+  @retval          EFI_INVALID_PARAMETER The input parameter is not correct.
+  @retval          EFI_NOT_STARTED       The IpIo is not configured.
+  @retval          EFI_UNSUPPORTED       An offload is not available, the packet is not sent.
+  @retval          EFI_OUT_OF_RESOURCES  Failed due to resource limit.
+  @retval          Others                Error condition occurred.
+
+**/
+EFI_STATUS
+EFIAPI
+IpIoSendWithOffload (
+  IN OUT IP_IO           *IpIo,
+  IN OUT NET_BUF         *Pkt,
+  IN     IP_IO_IP_INFO   *Sender        OPTIONAL,
+  IN     VOID            *Context       OPTIONAL,
+  IN     VOID            *NotifyData    OPTIONAL,
+  IN     EFI_IP_ADDRESS  *Dest          OPTIONAL,
+  IN     IP_IO_OVERRIDE  *OverrideData  OPTIONAL,
+  IN     UINT32          OffloadFlags,
+  IN     UINT16          SegmentSize
+  );
+
+/**
+  Get the offloads IpIoSendWithOffload() can use with the IP instance.
+
+  @param[in]   IpIo                  Pointer to an IP_IO instance.
+  @param[in]   Sender                The IP instance used for sending, or NULL for
+                                     the IP instance of IpIo.
+  @param[out]  Capabilities          The EDKII_IP4_OFFLOAD_* flags supported,
+                                     zero if none is.
+  @param[out]  MaxLargeSendSize      The largest TCP segment of a large send.
+
+  @retval      EFI_SUCCESS           The capabilities are returned.
+  @retval      EFI_INVALID_PARAMETER A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+IpIoGetOffloadCapabilities (
+  IN  IP_IO          *IpIo,
+  IN  IP_IO_IP_INFO  *Sender OPTIONAL,
+  OUT UINT32         *Capabilities,
+  OUT UINT32         *MaxLargeSendSize
+  );
+
+// MU_CHANGE [END]
+
 /**
   Cancel the IP transmit token that wraps this Packet.
 
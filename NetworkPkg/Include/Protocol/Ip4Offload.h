@@ -0,0 +1,152 @@
+/** @file
+  The IPv4 Offload Protocol lets the TCP and UDP drivers hand their checksums
+  and the segmentation of large TCP sends to the network interface.
+
+  The IPv4 driver installs EDKII_IP4_OFFLOAD_PROTOCOL next to EFI_IP4_PROTOCOL
+  on its children. It reports in GetCapabilities() the offloads of the network
+  interface that it can pass through, and none when the interface does not
+  have them. A user only requests the reported offloads and computes
+  everything else itself.
+
+  When a transmit requests an offload, the packet is prepared as follows:
+  - EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM and EDKII_IP4_OFFLOAD_TX_UDP4_CHECKSUM:
+    the checksum field of the TCP or UDP header holds the one's complement
+    sum, not complemented, of the IPv4 pseudo-header with a zero length. The
+    interface adds the length and the bytes of the segment, and stores the
+    complement of the sum.
+  - EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND: the TCP payload may be larger than
+    SegmentSize. The interface sends it in segments of SegmentSize bytes, the
+    last one possibly shorter, each with a copy of the IPv4 and TCP headers
+    where the total length and the sequence number are updated. Only the last
+    segment keeps the FIN and PSH flags. The TCP checksum is requested too,
+    and computed for each segment.
+
+  The flags have the values of the EDKII_NETWORK_OFFLOAD_* flags of the same
+  name in MdeModulePkg, so that the IPv4 driver passes them through unchanged.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef IP4_OFFLOAD_H_
+#define IP4_OFFLOAD_H_
+
+#include <Protocol/Ip4.h>
+
+#define EDKII_IP4_OFFLOAD_PROTOCOL_GUID \
+  { \
+    0xf1d9af38, 0xac9b, 0x4592, { 0xb5, 0xa5, 0xf0, 0x79, 0xb8, 0xa5, 0x89, 0x12 } \
+  }
+
+#define EDKII_IP4_OFFLOAD_PROTOCOL_REVISION  0x00010000
+
+///
+/// Transmit offloads.
+///
+#define EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM    BIT1
+#define EDKII_IP4_OFFLOAD_TX_UDP4_CHECKSUM    BIT2
+#define EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND  BIT3
+
+///
+/// Receive offloads. A received packet carries the flag of a checksum only
+/// when the interface verified that the checksum is correct.
+///
+#define EDKII_IP4_OFFLOAD_RX_TCP4_CHECKSUM  BIT17
+#define EDKII_IP4_OFFLOAD_RX_UDP4_CHECKSUM  BIT18
+
+typedef struct _EDKII_IP4_OFFLOAD_PROTOCOL EDKII_IP4_OFFLOAD_PROTOCOL;
+
+/**
+  Get the offloads available to the child.
+
+  @param[in]   This               The EDKII_IP4_OFFLOAD_PROTOCOL instance.
+  @param[out]  Capabilities       The EDKII_IP4_OFFLOAD_TX_TCP4_*,
+                                  EDKII_IP4_OFFLOAD_TX_UDP4_CHECKSUM and
+                                  EDKII_IP4_OFFLOAD_RX_* flags supported.
+  @param[out]  MaxLargeSendSize   Largest TotalDataLength of a large send. Zero
+                                  without EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND.
+
+  @retval EFI_SUCCESS            The capabilities are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_IP4_OFFLOAD_GET_CAPABILITIES)(
+  IN  EDKII_IP4_OFFLOAD_PROTOCOL  *This,
+  OUT UINT32                      *Capabilities,
+  OUT UINT32                      *MaxLargeSendSize
+  );
+
+/**
+  Queue a packet for transmission with offloads, as EFI_IP4_PROTOCOL.Transmit()
+  does.
+
+  The IPv4 header is built by the driver, so only the offloads of the TCP and
+  UDP checksums and of the large send are requested. The packet is never
+  fragmented with EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND. Otherwise, when
+  the packet has to be fragmented, the driver computes the requested checksum
+  itself.
+
+  @param[in]  This          The EDKII_IP4_OFFLOAD_PROTOCOL instance.
+  @param[in]  Token         The transmit token, as for
+                            EFI_IP4_PROTOCOL.Transmit(). The TotalDataLength may
+                            reach the MaxLargeSendSize reported by
+                            GetCapabilities() with a large send.
+  @param[in]  Flags         The EDKII_IP4_OFFLOAD_TX_* flags.
+  @param[in]  SegmentSize   Largest TCP payload of a segment, for
+                            EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND.
+
+  @retval EFI_SUCCESS            The packet was queued.
+  @retval EFI_NOT_STARTED        The instance is not configured.
+  @retval EFI_INVALID_PARAMETER  A parameter is invalid.
+  @retval EFI_UNSUPPORTED        An offload is not available.
+  @retval Others                 As returned by EFI_IP4_PROTOCOL.Transmit().
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_IP4_OFFLOAD_TRANSMIT)(
+  IN EDKII_IP4_OFFLOAD_PROTOCOL  *This,
+  IN EFI_IP4_COMPLETION_TOKEN    *Token,
+  IN UINT32                      Flags,
+  IN UINT16                      SegmentSize
+  );
+
+/**
+  Get the checksums verified by the interface for a received packet.
+
+  @param[in]   This      The EDKII_IP4_OFFLOAD_PROTOCOL instance.
+  @param[in]   RxData    The receive data of a token completed by the
+                         EFI_IP4_PROTOCOL of the same child and not recycled
+                         yet.
+  @param[out]  Flags     The EDKII_IP4_OFFLOAD_RX_TCP4_CHECKSUM and
+                         EDKII_IP4_OFFLOAD_RX_UDP4_CHECKSUM flags.
+
+  @retval EFI_SUCCESS            The flags are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_IP4_OFFLOAD_GET_RECEIVE_FLAGS)(
+  IN  EDKII_IP4_OFFLOAD_PROTOCOL  *This,
+  IN  EFI_IP4_RECEIVE_DATA        *RxData,
+  OUT UINT32                      *Flags
+  );
+
+///
+/// IPv4 Offload Protocol, installed next to EFI_IP4_PROTOCOL on the children of
+/// the IPv4 driver.
+///
+struct _EDKII_IP4_OFFLOAD_PROTOCOL {
+  UINT64                                 Revision;
+  EDKII_IP4_OFFLOAD_GET_CAPABILITIES     GetCapabilities;
+  EDKII_IP4_OFFLOAD_TRANSMIT             Transmit;
+  EDKII_IP4_OFFLOAD_GET_RECEIVE_FLAGS    GetReceiveFlags;
+};
+
+extern EFI_GUID  gEdkiiIp4OffloadProtocolGuid;
+
+#endif
@@ -0,0 +1,115 @@
+/** @file
+  The Managed Network Offload Protocol passes the offloads of
+  EDKII_NETWORK_OFFLOAD_PROTOCOL through the Managed Network driver.
+
+  The Managed Network driver installs EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL
+  next to EFI_MANAGED_NETWORK_PROTOCOL on its children. It reports in
+  GetCapabilities() the offloads of the interface, and none when the interface
+  does not install EDKII_NETWORK_OFFLOAD_PROTOCOL. The packets are prepared for
+  the offloads as described in NetworkOffload.h.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef MANAGED_NETWORK_OFFLOAD_H_
+#define MANAGED_NETWORK_OFFLOAD_H_
+
+#include <Protocol/ManagedNetwork.h>
+#include <Protocol/NetworkOffload.h>
+
+#define EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL_GUID \
+  { \
+    0x072b7f9a, 0xc5b8, 0x49e0, { 0xa1, 0xef, 0x2f, 0xc9, 0x41, 0x96, 0x0c, 0x73 } \
+  }
+
+#define EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL_REVISION  0x00010000
+
+typedef struct _EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL;
+
+/**
+  Get the offloads available to the child.
+
+  @param[in]   This               The EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[out]  Capabilities       The EDKII_NETWORK_OFFLOAD_TX_* and
+                                  EDKII_NETWORK_OFFLOAD_RX_* flags supported.
+  @param[out]  MaxLargeSendSize   Largest DataLength of a large send. Zero
+                                  without EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND.
+
+  @retval EFI_SUCCESS            The capabilities are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_MANAGED_NETWORK_OFFLOAD_GET_CAPABILITIES)(
+  IN  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *This,
+  OUT UINT32                                  *Capabilities,
+  OUT UINT32                                  *MaxLargeSendSize
+  );
+
+/**
+  Queue a packet for transmission with offloads, as
+  EFI_MANAGED_NETWORK_PROTOCOL.Transmit() does.
+
+  The DataLength of the transmit data may exceed the MTU of the instance with
+  EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND, up to the MaxLargeSendSize reported
+  by GetCapabilities().
+
+  @param[in]  This     The EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in]  Token    The transmit token, as for
+                       EFI_MANAGED_NETWORK_PROTOCOL.Transmit().
+  @param[in]  TxInfo   The offloads to apply. The offsets are counted from the
+                       first byte of the fragment table.
+
+  @retval EFI_SUCCESS            The packet was queued.
+  @retval EFI_NOT_STARTED        The instance is not configured.
+  @retval EFI_INVALID_PARAMETER  A parameter is invalid.
+  @retval EFI_UNSUPPORTED        An offload is not available.
+  @retval EFI_OUT_OF_RESOURCES   The packet could not be queued.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_MANAGED_NETWORK_OFFLOAD_TRANSMIT)(
+  IN EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *This,
+  IN EFI_MANAGED_NETWORK_COMPLETION_TOKEN    *Token,
+  IN CONST EDKII_NETWORK_OFFLOAD_TX_INFO     *TxInfo
+  );
+
+/**
+  Get the checksums verified by the interface for a received packet.
+
+  @param[in]   This      The EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in]   RxData    The receive data of a token completed by the
+                         EFI_MANAGED_NETWORK_PROTOCOL of the same child and not
+                         recycled yet.
+  @param[out]  Flags     The EDKII_NETWORK_OFFLOAD_RX_* flags.
+
+  @retval EFI_SUCCESS            The flags are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_MANAGED_NETWORK_OFFLOAD_GET_RECEIVE_FLAGS)(
+  IN  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *This,
+  IN  EFI_MANAGED_NETWORK_RECEIVE_DATA        *RxData,
+  OUT UINT32                                  *Flags
+  );
+
+///
+/// Managed Network Offload Protocol, installed next to
+/// EFI_MANAGED_NETWORK_PROTOCOL on the children of the Managed Network driver.
+///
+struct _EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL {
+  UINT64                                             Revision;
+  EDKII_MANAGED_NETWORK_OFFLOAD_GET_CAPABILITIES     GetCapabilities;
+  EDKII_MANAGED_NETWORK_OFFLOAD_TRANSMIT             Transmit;
+  EDKII_MANAGED_NETWORK_OFFLOAD_GET_RECEIVE_FLAGS    GetReceiveFlags;
+};
+
+extern EFI_GUID  gEdkiiManagedNetworkOffloadProtocolGuid;
+
+#endif
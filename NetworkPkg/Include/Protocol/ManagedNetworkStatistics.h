@@ -0,0 +1,107 @@
+/** @file
+  The Managed Network Statistics Protocol reports the receive counters of the
+  Managed Network driver for a network interface.
+
+  The Managed Network driver polls the Simple Network Protocol for received
+  frames from a timer and from EFI_MANAGED_NETWORK_PROTOCOL.Poll(). Each poll
+  receives a batch of frames, until the interface has no more frames or the
+  batch is full, and the period of the timer shortens while the batches come
+  back full. The protocol is installed on the controller handle of the
+  interface, next to EFI_VLAN_CONFIG_PROTOCOL.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef MANAGED_NETWORK_STATISTICS_H_
+#define MANAGED_NETWORK_STATISTICS_H_
+
+#define EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL_GUID \
+  { \
+    0xf1febe47, 0x1ef9, 0x46ae, { 0xa5, 0xc5, 0xed, 0x0f, 0x35, 0x27, 0xad, 0x1b } \
+  }
+
+#define EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL_REVISION  0x00010000
+
+typedef struct _EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL;
+
+///
+/// The receive counters of an interface.
+///
+typedef struct {
+  ///
+  /// Frames received from the interface.
+  ///
+  UINT64    RxFrames;
+  ///
+  /// Polls that received at least one frame.
+  ///
+  UINT64    RxBatches;
+  ///
+  /// Polls that stopped because the batch was full, with frames possibly
+  /// left in the interface.
+  ///
+  UINT64    RxFullBatches;
+  ///
+  /// Largest number of frames received by a single poll.
+  ///
+  UINT32    RxLargestBatch;
+  ///
+  /// Number of frames that a poll receives at most.
+  ///
+  UINT32    RxBatchSize;
+  ///
+  /// Frames dropped because the receive queue of an instance was full.
+  ///
+  UINT64    RxDroppedQueueFull;
+  ///
+  /// Frames dropped because no instance received them before their timeout.
+  ///
+  UINT64    RxDroppedTimeout;
+  ///
+  /// Polls that stopped because no buffer was available for a frame.
+  ///
+  UINT64    RxNoBuffer;
+  ///
+  /// Receive errors reported by the interface.
+  ///
+  UINT64    RxErrors;
+  ///
+  /// Current period of the poll timer, in 100 ns units. Zero when the timer
+  /// is stopped.
+  ///
+  UINT64    PollInterval;
+} EDKII_MANAGED_NETWORK_STATISTICS;
+
+/**
+  Get the receive counters of the interface.
+
+  @param[in]   This         The EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL instance.
+  @param[in]   Reset        TRUE to reset the counters after they are read.
+                            RxBatchSize and PollInterval are not reset.
+  @param[out]  Statistics   The counters.
+
+  @retval EFI_SUCCESS            The counters are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_MANAGED_NETWORK_GET_STATISTICS)(
+  IN  EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL  *This,
+  IN  BOOLEAN                                    Reset,
+  OUT EDKII_MANAGED_NETWORK_STATISTICS           *Statistics
+  );
+
+///
+/// Managed Network Statistics Protocol.
+///
+struct _EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL {
+  UINT64                                  Revision;
+  EDKII_MANAGED_NETWORK_GET_STATISTICS    GetStatistics;
+};
+
+extern EFI_GUID  gEdkiiManagedNetworkStatisticsProtocolGuid;
+
+#endif
@@ -22,6 +22,14 @@ typedef struct _IP4_SERVICE    IP4_SERVICE;
 #define IP4_LINK_MULTICAST  0x00000002
 #define IP4_LINK_PROMISC    0x00000004
 
+// MU_CHANGE [BEGIN] - Network offloads
+//
+// The EDKII_NETWORK_OFFLOAD_RX_* flags of the checksums verified by the
+// interface are carried in the upper half of the link flags.
+//
+#define IP4_LINK_OFFLOAD_L4_MASK  (EDKII_NETWORK_OFFLOAD_RX_TCP4_CHECKSUM | EDKII_NETWORK_OFFLOAD_RX_UDP4_CHECKSUM)
+// MU_CHANGE [END]
+
 //
 // IP4 address cast type classification. Keep it true that any
 // type bigger than or equal to LOCAL_BROADCAST is broadcast.
@@ -234,6 +234,12 @@ Ip4CreateService (
   IpSb->MnpChildHandle = NULL;
   IpSb->Mnp            = NULL;
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  IpSb->MnpOffload          = NULL;
+  IpSb->OffloadCapabilities = 0;
+  IpSb->MaxLargeSendSize    = 0;
+  // MU_CHANGE [END]
+
   IpSb->MnpConfigData.ReceivedQueueTimeoutValue = 0;
   IpSb->MnpConfigData.TransmitQueueTimeoutValue = 0;
   IpSb->MnpConfigData.ProtocolTypeFilter        = IP4_ETHER_PROTO;
@@ -327,6 +333,36 @@ Ip4CreateService (
     goto ON_ERROR;
   }
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // The offloads are optional, the packets are completed in software
+  // when the MNP child doesn't have them.
+  //
+  Status = gBS->OpenProtocol (
+                  IpSb->MnpChildHandle,
+                  &gEdkiiManagedNetworkOffloadProtocolGuid,
+                  (VOID **)&IpSb->MnpOffload,
+                  ImageHandle,
+                  Controller,
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                  );
+
+  if (!EFI_ERROR (Status)) {
+    Status = IpSb->MnpOffload->GetCapabilities (
+                                 IpSb->MnpOffload,
+                                 &IpSb->OffloadCapabilities,
+                                 &IpSb->MaxLargeSendSize
+                                 );
+  }
+
+  if (EFI_ERROR (Status)) {
+    IpSb->MnpOffload          = NULL;
+    IpSb->OffloadCapabilities = 0;
+    IpSb->MaxLargeSendSize    = 0;
+  }
+
+  // MU_CHANGE [END]
+
   Status = Ip4ServiceConfigMnp (IpSb, TRUE);
 
   if (EFI_ERROR (Status)) {
@@ -352,7 +388,7 @@ Ip4CreateService (
     goto ON_ERROR;
   }
 
-  IpSb->DefaultInterface = Ip4CreateInterface (IpSb->Mnp, Controller, ImageHandle);
+  IpSb->DefaultInterface = Ip4CreateInterface (IpSb->Mnp, IpSb->MnpOffload, Controller, ImageHandle); // MU_CHANGE - Network offloads
 
   if (IpSb->DefaultInterface == NULL) {
     Status = EFI_OUT_OF_RESOURCES;
@@ -451,7 +487,8 @@ Ip4CleanService (
              IpSb->Controller
              );
 
-      IpSb->Mnp = NULL;
+      IpSb->Mnp        = NULL;
+      IpSb->MnpOffload = NULL; // MU_CHANGE - Network offloads
     }
 
     NetLibDestroyServiceChild (
@@ -774,7 +811,7 @@ Ip4DriverBindingStop (
     Ip4FreeInterface (IpSb->DefaultInterface, NULL);
     Ip4FreeRouteTable (IpSb->DefaultRouteTable);
 
-    IpIf = Ip4CreateInterface (IpSb->Mnp, IpSb->Controller, IpSb->Image);
+    IpIf = Ip4CreateInterface (IpSb->Mnp, IpSb->MnpOffload, IpSb->Controller, IpSb->Image); // MU_CHANGE - Network offloads
     if (IpIf == NULL) {
       goto ON_ERROR;
     }
@@ -875,6 +912,8 @@ Ip4ServiceBindingCreateChild (
                   ChildHandle,
                   &gEfiIp4ProtocolGuid,
                   &IpInstance->Ip4Proto,
+                  &gEdkiiIp4OffloadProtocolGuid,  // MU_CHANGE - Network offloads
+                  &IpInstance->Ip4Offload,        // MU_CHANGE - Network offloads
                   NULL
                   );
 
@@ -900,6 +939,8 @@ Ip4ServiceBindingCreateChild (
            *ChildHandle,
            &gEfiIp4ProtocolGuid,
            &IpInstance->Ip4Proto,
+           &gEdkiiIp4OffloadProtocolGuid,  // MU_CHANGE - Network offloads
+           &IpInstance->Ip4Offload,        // MU_CHANGE - Network offloads
            NULL
            );
 
@@ -1035,11 +1076,16 @@ Ip4ServiceBindingDestroyChild (
   // that means there is a resource leak.
   //
   gBS->RestoreTPL (OldTpl);
-  Status = gBS->UninstallProtocolInterface (
+  // MU_CHANGE [BEGIN] - Network offloads
+  Status = gBS->UninstallMultipleProtocolInterfaces (
                   ChildHandle,
                   &gEfiIp4ProtocolGuid,
-                  &IpInstance->Ip4Proto
+                  &IpInstance->Ip4Proto,
+                  &gEdkiiIp4OffloadProtocolGuid,
+                  &IpInstance->Ip4Offload,
+                  NULL
                   );
+  // MU_CHANGE [END]
   OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
   if (EFI_ERROR (Status)) {
     IpInstance->InDestroy = FALSE;
@@ -1052,6 +1098,8 @@ Ip4ServiceBindingDestroyChild (
            &ChildHandle,
            &gEfiIp4ProtocolGuid,
            Ip4,
+           &gEdkiiIp4OffloadProtocolGuid,  // MU_CHANGE - Network offloads
+           &IpInstance->Ip4Offload,        // MU_CHANGE - Network offloads
            NULL
            );
 
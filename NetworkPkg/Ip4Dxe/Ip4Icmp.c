@@ -262,7 +262,9 @@ Ip4IcmpReplyEcho (
              0,
              IP4_ALLZERO_ADDRESS,
              Ip4SysPacketSent,
-             NULL
+             NULL,
+             0,         // MU_CHANGE - Network offloads
+             0          // MU_CHANGE - Network offloads
              );
   if (EFI_ERROR (Status)) {
     NetbufFree (Data);
@@ -173,6 +173,7 @@ Ip4WrapLinkTxToken (
   Token->Context    = Context;
   CopyMem (&Token->DstMac, &mZeroMacAddress, sizeof (Token->DstMac));
   CopyMem (&Token->SrcMac, &Interface->Mac, sizeof (Token->SrcMac));
+  ZeroMem (&Token->Offload, sizeof (Token->Offload)); // MU_CHANGE - Network offloads
 
   MnpToken         = &(Token->MnpToken);
   MnpToken->Status = EFI_NOT_READY;
@@ -225,6 +226,38 @@ Ip4FreeLinkTxToken (
   FreePool (Token);
 }
 
+// MU_CHANGE [BEGIN] - Network offloads
+
+/**
+  Transmit the link layer transmit token through MNP, with its offloads
+  if it has any.
+
+  @param[in]  Token                 Token to transmit.
+
+  @retval EFI_SUCCESS           The frame is queued for transmission.
+  @retval Others                As returned by MNP.
+
+**/
+STATIC
+EFI_STATUS
+Ip4TransmitLinkTxToken (
+  IN IP4_LINK_TX_TOKEN  *Token
+  )
+{
+  IP4_INTERFACE  *Interface;
+
+  Interface = Token->Interface;
+
+  if (Token->Offload.Flags != 0) {
+    ASSERT (Interface->MnpOffload != NULL);
+    return Interface->MnpOffload->Transmit (Interface->MnpOffload, &Token->MnpToken, &Token->Offload);
+  }
+
+  return Interface->Mnp->Transmit (Interface->Mnp, &Token->MnpToken);
+}
+
+// MU_CHANGE [END]
+
 /**
   Create an IP_ARP_QUE structure to request ARP service.
 
@@ -466,6 +499,8 @@ Ip4CancelFrames (
 
   @param[in]  Mnp               The shared MNP child of this IP4 service binding
                                 instance.
+  @param[in]  MnpOffload        The offloads of the shared MNP child, NULL if it
+                                has none.
   @param[in]  Controller        The controller this IP4 service binding instance
                                 is installed. Most like the UNDI handle.
   @param[in]  ImageHandle       This driver's image handle.
@@ -475,9 +510,10 @@ Ip4CancelFrames (
 **/
 IP4_INTERFACE *
 Ip4CreateInterface (
-  IN  EFI_MANAGED_NETWORK_PROTOCOL  *Mnp,
-  IN  EFI_HANDLE                    Controller,
-  IN  EFI_HANDLE                    ImageHandle
+  IN  EFI_MANAGED_NETWORK_PROTOCOL            *Mnp,
+  IN  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *MnpOffload   OPTIONAL, // MU_CHANGE - Network offloads
+  IN  EFI_HANDLE                              Controller,
+  IN  EFI_HANDLE                              ImageHandle
   )
 {
   IP4_INTERFACE            *Interface;
@@ -504,6 +540,7 @@ Ip4CreateInterface (
   Interface->Controller = Controller;
   Interface->Image      = ImageHandle;
   Interface->Mnp        = Mnp;
+  Interface->MnpOffload = MnpOffload; // MU_CHANGE - Network offloads
   Interface->Arp        = NULL;
   Interface->ArpHandle  = NULL;
 
@@ -846,7 +883,7 @@ Ip4SendFrameToDefaultRoute (
     }
 
     RtCacheEntry->NextHop = Gateway;
-    Status                = Ip4SendFrame (Token->Interface, Token->IpInstance, Token->Packet, Gateway, Token->CallBack, Token->Context, Token->IpSb);
+    Status                = Ip4SendFrame (Token->Interface, Token->IpInstance, Token->Packet, Gateway, Token->CallBack, Token->Context, Token->IpSb, &Token->Offload); // MU_CHANGE - Network offloads
     if (EFI_ERROR (Status)) {
       Status = EFI_NO_MAPPING;
       goto ON_ERROR;
@@ -939,7 +976,7 @@ Ip4OnArpResolvedDpc (
     //
     InsertTailList (&Interface->SentFrames, &Token->Link);
 
-    Status = Interface->Mnp->Transmit (Interface->Mnp, &Token->MnpToken);
+    Status = Ip4TransmitLinkTxToken (Token); // MU_CHANGE - Network offloads
     if (EFI_ERROR (Status)) {
       RemoveEntryList (&Token->Link);
       Token->CallBack (Token->IpInstance, Token->Packet, Status, 0, Token->Context);
@@ -1041,6 +1078,7 @@ Ip4OnFrameSent (
   @param[in]  CallBack          Function to call back when transmit finished.
   @param[in]  Context           Opaque parameter to the call back.
   @param[in]  IpSb              The pointer to the IP4 service binding instance.
+  @param[in]  Offload           The offloads of the frame, NULL if none.
 
   @retval EFI_OUT_OF_RESOURCES  Failed to allocate resource to send the frame
   @retval EFI_NO_MAPPING        Can't resolve the MAC for the nexthop
@@ -1050,13 +1088,14 @@ Ip4OnFrameSent (
 **/
 EFI_STATUS
 Ip4SendFrame (
-  IN  IP4_INTERFACE       *Interface,
-  IN  IP4_PROTOCOL        *IpInstance       OPTIONAL,
-  IN  NET_BUF             *Packet,
-  IN  IP4_ADDR            NextHop,
-  IN  IP4_FRAME_CALLBACK  CallBack,
-  IN  VOID                *Context,
-  IN IP4_SERVICE          *IpSb
+  IN  IP4_INTERFACE                        *Interface,
+  IN  IP4_PROTOCOL                         *IpInstance       OPTIONAL,
+  IN  NET_BUF                              *Packet,
+  IN  IP4_ADDR                             NextHop,
+  IN  IP4_FRAME_CALLBACK                   CallBack,
+  IN  VOID                                 *Context,
+  IN IP4_SERVICE                           *IpSb,
+  IN  CONST EDKII_NETWORK_OFFLOAD_TX_INFO  *Offload          OPTIONAL // MU_CHANGE - Network offloads
   )
 {
   IP4_LINK_TX_TOKEN  *Token;
@@ -1073,6 +1112,13 @@ Ip4SendFrame (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  if (Offload != NULL) {
+    CopyMem (&Token->Offload, Offload, sizeof (Token->Offload));
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Get the destination MAC address for multicast and broadcasts.
   // Don't depend on ARP to solve the address since there maybe no
@@ -1161,7 +1207,7 @@ SEND_NOW:
   // Remove it if the returned status is not EFI_SUCCESS.
   //
   InsertTailList (&Interface->SentFrames, &Token->Link);
-  Status = Interface->Mnp->Transmit (Interface->Mnp, &Token->MnpToken);
+  Status = Ip4TransmitLinkTxToken (Token); // MU_CHANGE - Network offloads
   if (EFI_ERROR (Status)) {
     RemoveEntryList (&Token->Link);
     goto ON_ERROR;
@@ -1219,6 +1265,7 @@ Ip4OnFrameReceivedDpc (
   NET_FRAGMENT                          Netfrag;
   NET_BUF                               *Packet;
   UINT32                                Flag;
+  UINT32                                OffloadFlags; // MU_CHANGE - Network offloads
 
   Token = (IP4_LINK_RX_TOKEN *)Context;
   NET_CHECK_SIGNATURE (Token, IP4_FRAME_RX_SIGNATURE);
@@ -1261,6 +1308,18 @@ Ip4OnFrameReceivedDpc (
   Flag |= (MnpRxData->MulticastFlag ? IP4_LINK_MULTICAST : 0);
   Flag |= (MnpRxData->PromiscuousFlag ? IP4_LINK_PROMISC : 0);
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // The checksums verified by the interface travel with the link flags.
+  //
+  if ((Token->Interface->MnpOffload != NULL) &&
+      !EFI_ERROR (Token->Interface->MnpOffload->GetReceiveFlags (Token->Interface->MnpOffload, MnpRxData, &OffloadFlags)))
+  {
+    Flag |= (OffloadFlags & EDKII_NETWORK_OFFLOAD_RX_MASK);
+  }
+
+  // MU_CHANGE [END]
+
   Token->CallBack (Token->IpInstance, Packet, EFI_SUCCESS, Flag, Token->Context);
 }
 
@@ -82,6 +82,7 @@ typedef struct {
 
   EFI_MAC_ADDRESS                         DstMac;
   EFI_MAC_ADDRESS                         SrcMac;
+  EDKII_NETWORK_OFFLOAD_TX_INFO           Offload; // MU_CHANGE - Network offloads
 
   EFI_MANAGED_NETWORK_COMPLETION_TOKEN    MnpToken;
   EFI_MANAGED_NETWORK_TRANSMIT_DATA       MnpTxData;
@@ -133,53 +134,54 @@ BOOLEAN
 // with 0.0.0.0/0.0.0.0.
 //
 struct _IP4_INTERFACE {
-  UINT32                          Signature;
-  LIST_ENTRY                      Link;
-  INTN                            RefCnt;
+  UINT32                                    Signature;
+  LIST_ENTRY                                Link;
+  INTN                                      RefCnt;
 
   //
   // IP address and subnet mask of the interface. It also contains
   // the subnet/net broadcast address for quick access. The fields
   // are invalid if (Configured == FALSE)
   //
-  IP4_ADDR                        Ip;
-  IP4_ADDR                        SubnetMask;
-  IP4_ADDR                        SubnetBrdcast;
-  IP4_ADDR                        NetBrdcast;
-  BOOLEAN                         Configured;
+  IP4_ADDR                                  Ip;
+  IP4_ADDR                                  SubnetMask;
+  IP4_ADDR                                  SubnetBrdcast;
+  IP4_ADDR                                  NetBrdcast;
+  BOOLEAN                                   Configured;
 
   //
   // Handle used to create/destroy ARP child. All the IP children
   // share one MNP which is owned by IP service binding.
   //
-  EFI_HANDLE                      Controller;
-  EFI_HANDLE                      Image;
+  EFI_HANDLE                                Controller;
+  EFI_HANDLE                                Image;
 
-  EFI_MANAGED_NETWORK_PROTOCOL    *Mnp;
-  EFI_ARP_PROTOCOL                *Arp;
-  EFI_HANDLE                      ArpHandle;
+  EFI_MANAGED_NETWORK_PROTOCOL              *Mnp;
+  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL    *MnpOffload; // MU_CHANGE - Network offloads
+  EFI_ARP_PROTOCOL                          *Arp;
+  EFI_HANDLE                                ArpHandle;
 
   //
   // Queues to keep the frames sent and waiting ARP request.
   //
-  LIST_ENTRY                      ArpQues;
-  LIST_ENTRY                      SentFrames;
-  IP4_LINK_RX_TOKEN               *RecvRequest;
+  LIST_ENTRY                                ArpQues;
+  LIST_ENTRY                                SentFrames;
+  IP4_LINK_RX_TOKEN                         *RecvRequest;
 
   //
   // The interface's MAC and broadcast MAC address.
   //
-  EFI_MAC_ADDRESS                 Mac;
-  EFI_MAC_ADDRESS                 BroadcastMac;
-  UINT32                          HwaddrLen;
+  EFI_MAC_ADDRESS                           Mac;
+  EFI_MAC_ADDRESS                           BroadcastMac;
+  UINT32                                    HwaddrLen;
 
   //
   // All the IP instances that have the same IP/SubnetMask are linked
   // together through IpInstances. If any of the instance enables
   // promiscuous receive, PromiscRecv is true.
   //
-  LIST_ENTRY                      IpInstances;
-  BOOLEAN                         PromiscRecv;
+  LIST_ENTRY                                IpInstances;
+  BOOLEAN                                   PromiscRecv;
 };
 
 /**
@@ -188,6 +190,8 @@ struct _IP4_INTERFACE {
 
   @param[in]  Mnp               The shared MNP child of this IP4 service binding
                                 instance.
+  @param[in]  MnpOffload        The offloads of the shared MNP child, NULL if it
+                                has none.
   @param[in]  Controller        The controller this IP4 service binding instance
                                 is installed. Most like the UNDI handle.
   @param[in]  ImageHandle       This driver's image handle.
@@ -197,9 +201,10 @@ struct _IP4_INTERFACE {
 **/
 IP4_INTERFACE *
 Ip4CreateInterface (
-  IN  EFI_MANAGED_NETWORK_PROTOCOL  *Mnp,
-  IN  EFI_HANDLE                    Controller,
-  IN  EFI_HANDLE                    ImageHandle
+  IN  EFI_MANAGED_NETWORK_PROTOCOL            *Mnp,
+  IN  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *MnpOffload   OPTIONAL, // MU_CHANGE - Network offloads
+  IN  EFI_HANDLE                              Controller,
+  IN  EFI_HANDLE                              ImageHandle
   );
 
 /**
@@ -258,6 +263,7 @@ Ip4FreeInterface (
   @param[in]  CallBack          Function to call back when transmit finished.
   @param[in]  Context           Opaque parameter to the call back.
   @param[in]  IpSb              The pointer to the IP4 service binding instance.
+  @param[in]  Offload           The offloads of the frame, NULL if none.
 
   @retval EFI_OUT_OF_RESOURCES  Failed to allocate resource to send the frame
   @retval EFI_NO_MAPPING        Can't resolve the MAC for the nexthop
@@ -267,13 +273,14 @@ Ip4FreeInterface (
 **/
 EFI_STATUS
 Ip4SendFrame (
-  IN  IP4_INTERFACE       *Interface,
-  IN  IP4_PROTOCOL        *IpInstance       OPTIONAL,
-  IN  NET_BUF             *Packet,
-  IN  IP4_ADDR            NextHop,
-  IN  IP4_FRAME_CALLBACK  CallBack,
-  IN  VOID                *Context,
-  IN IP4_SERVICE          *IpSb
+  IN  IP4_INTERFACE                        *Interface,
+  IN  IP4_PROTOCOL                         *IpInstance       OPTIONAL,
+  IN  NET_BUF                              *Packet,
+  IN  IP4_ADDR                             NextHop,
+  IN  IP4_FRAME_CALLBACK                   CallBack,
+  IN  VOID                                 *Context,
+  IN IP4_SERVICE                           *IpSb,
+  IN  CONST EDKII_NETWORK_OFFLOAD_TX_INFO  *Offload          OPTIONAL // MU_CHANGE - Network offloads
   );
 
 /**
@@ -208,7 +208,9 @@ Ip4SendIgmpMessage (
            sizeof (UINT32),
            IP4_ALLZERO_ADDRESS,
            Ip4SysPacketSent,
-           NULL
+           NULL,
+           0,         // MU_CHANGE - Network offloads
+           0          // MU_CHANGE - Network offloads
            );
 }
 
@@ -540,6 +540,7 @@ Ip4InitProtocol (
 
   IpInstance->Signature = IP4_PROTOCOL_SIGNATURE;
   CopyMem (&IpInstance->Ip4Proto, &mEfiIp4ProtocolTemplete, sizeof (IpInstance->Ip4Proto));
+  CopyMem (&IpInstance->Ip4Offload, &mIp4OffloadProtocolTemplate, sizeof (IpInstance->Ip4Offload)); // MU_CHANGE - Network offloads
   IpInstance->State     = IP4_STATE_UNCONFIGED;
   IpInstance->InDestroy = FALSE;
   IpInstance->Service   = IpSb;
@@ -643,7 +644,7 @@ Ip4ConfigProtocol (
     if (IpIf != NULL) {
       NET_GET_REF (IpIf);
     } else {
-      IpIf = Ip4CreateInterface (IpSb->Mnp, IpSb->Controller, IpSb->Image);
+      IpIf = Ip4CreateInterface (IpSb->Mnp, IpSb->MnpOffload, IpSb->Controller, IpSb->Image); // MU_CHANGE - Network offloads
 
       if (IpIf == NULL) {
         goto ON_ERROR;
@@ -1566,8 +1567,38 @@ EfiIp4Transmit (
   IN EFI_IP4_COMPLETION_TOKEN  *Token
   )
 {
+  // MU_CHANGE [BEGIN] - Network offloads
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return Ip4TransmitWithOffload (IP4_INSTANCE_FROM_PROTOCOL (This), Token, 0, 0);
+}
+
+/**
+  Places outgoing data packets into the transmit queue, with the offloads
+  requested by the upper layer. This is EfiIp4Transmit() for the IP4 child.
+
+  @param[in]  IpInstance    The IP4 child that issues the transmission.
+  @param[in]  Token         Pointer to the transmit token.
+  @param[in]  OffloadFlags  The EDKII_IP4_OFFLOAD_TX_* flags, validated by
+                            the caller.
+  @param[in]  SegmentSize   Largest TCP payload of a segment of a large send.
+
+  @retval  EFI_SUCCESS           The data has been queued for transmission.
+  @retval  Others                As returned by EfiIp4Transmit().
+
+**/
+EFI_STATUS
+Ip4TransmitWithOffload (
+  IN IP4_PROTOCOL              *IpInstance,
+  IN EFI_IP4_COMPLETION_TOKEN  *Token,
+  IN UINT32                    OffloadFlags,
+  IN UINT16                    SegmentSize
+  )
+{
+  // MU_CHANGE [END]
   IP4_SERVICE            *IpSb;
-  IP4_PROTOCOL           *IpInstance;
   IP4_INTERFACE          *IpIf;
   IP4_TXTOKEN_WRAP       *Wrap;
   EFI_IP4_TRANSMIT_DATA  *TxData;
@@ -1584,12 +1615,6 @@ EfiIp4Transmit (
   UINT8                  *OptionsBuffer;
   VOID                   *FirstFragment;
 
-  if (This == NULL) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  IpInstance = IP4_INSTANCE_FROM_PROTOCOL (This);
-
   if (IpInstance->State != IP4_STATE_CONFIGED) {
     return EFI_NOT_STARTED;
   }
@@ -1710,7 +1735,9 @@ EfiIp4Transmit (
   //
   // If don't fragment and fragment needed, return error
   //
-  if (DontFragment && (TxData->TotalDataLength + HeadLen > IpSb->MaxPacketSize)) {
+  if (DontFragment && ((OffloadFlags & EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND) == 0) && // MU_CHANGE - Network offloads
+      (TxData->TotalDataLength + HeadLen > IpSb->MaxPacketSize))
+  {
     Status = EFI_BAD_BUFFER_SIZE;
     goto ON_EXIT;
   }
@@ -1777,7 +1804,9 @@ EfiIp4Transmit (
              OptionsLength,
              GateWay,
              Ip4OnPacketSent,
-             Wrap
+             Wrap,
+             OffloadFlags,     // MU_CHANGE - Network offloads
+             SegmentSize       // MU_CHANGE - Network offloads
              );
 
   if (EFI_ERROR (Status)) {
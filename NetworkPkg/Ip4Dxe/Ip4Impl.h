@@ -21,6 +21,10 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Protocol/Dhcp4.h>
 #include <Protocol/HiiConfigRouting.h>
 #include <Protocol/HiiConfigAccess.h>
+// MU_CHANGE [BEGIN] - Network offloads
+#include <Protocol/ManagedNetworkOffload.h>
+#include <Protocol/Ip4Offload.h>
+// MU_CHANGE [END]
 
 #include <IndustryStandard/Dhcp.h>
 
@@ -116,111 +120,127 @@ typedef struct {
   LIST_ENTRY              Link;
   IP4_PROTOCOL            *IpInstance;
   NET_BUF                 *Packet;
+  UINT32                  OffloadFlags; // MU_CHANGE - Network offloads
   EFI_IP4_RECEIVE_DATA    RxData;
 } IP4_RXDATA_WRAP;
 
 struct _IP4_PROTOCOL {
-  UINT32                 Signature;
+  UINT32                        Signature;
 
-  EFI_IP4_PROTOCOL       Ip4Proto;
-  EFI_HANDLE             Handle;
-  INTN                   State;
+  EFI_IP4_PROTOCOL              Ip4Proto;
+  EDKII_IP4_OFFLOAD_PROTOCOL    Ip4Offload; // MU_CHANGE - Network offloads
+  EFI_HANDLE                    Handle;
+  INTN                          State;
 
-  BOOLEAN                InDestroy;
+  BOOLEAN                       InDestroy;
 
-  IP4_SERVICE            *Service;
-  LIST_ENTRY             Link;          // Link to all the IP protocol from the service
+  IP4_SERVICE                   *Service;
+  LIST_ENTRY                    Link;          // Link to all the IP protocol from the service
 
   //
   // User's transmit/receive tokens, and received/delivered packets
   //
-  NET_MAP                RxTokens;
-  NET_MAP                TxTokens;      // map between (User's Token, IP4_TXTOKE_WRAP)
-  LIST_ENTRY             Received;      // Received but not delivered packet
-  LIST_ENTRY             Delivered;     // Delivered and to be recycled packets
-  EFI_LOCK               RecycleLock;
+  NET_MAP                       RxTokens;
+  NET_MAP                       TxTokens;      // map between (User's Token, IP4_TXTOKE_WRAP)
+  LIST_ENTRY                    Received;      // Received but not delivered packet
+  LIST_ENTRY                    Delivered;     // Delivered and to be recycled packets
+  EFI_LOCK                      RecycleLock;
 
   //
   // Instance's address and route tables. There are two route tables.
   // RouteTable is used by the IP4 driver to route packet. EfiRouteTable
   // is used to communicate the current route info to the upper layer.
   //
-  IP4_INTERFACE          *Interface;
-  LIST_ENTRY             AddrLink;      // Ip instances with the same IP address.
-  IP4_ROUTE_TABLE        *RouteTable;
+  IP4_INTERFACE                 *Interface;
+  LIST_ENTRY                    AddrLink;      // Ip instances with the same IP address.
+  IP4_ROUTE_TABLE               *RouteTable;
 
-  EFI_IP4_ROUTE_TABLE    *EfiRouteTable;
-  UINT32                 EfiRouteCount;
+  EFI_IP4_ROUTE_TABLE           *EfiRouteTable;
+  UINT32                        EfiRouteCount;
 
   //
   // IGMP data for this instance
   //
-  IP4_ADDR               *Groups;       // stored in network byte order
-  UINT32                 GroupCount;
+  IP4_ADDR                      *Groups;       // stored in network byte order
+  UINT32                        GroupCount;
 
-  EFI_IP4_CONFIG_DATA    ConfigData;
+  EFI_IP4_CONFIG_DATA           ConfigData;
 };
 
 struct _IP4_SERVICE {
-  UINT32                             Signature;
-  EFI_SERVICE_BINDING_PROTOCOL       ServiceBinding;
-  INTN                               State;
+  UINT32                                    Signature;
+  EFI_SERVICE_BINDING_PROTOCOL              ServiceBinding;
+  INTN                                      State;
 
   //
   // List of all the IP instances and interfaces, and default
   // interface and route table and caches.
   //
-  UINTN                              NumChildren;
-  LIST_ENTRY                         Children;
+  UINTN                                     NumChildren;
+  LIST_ENTRY                                Children;
 
-  LIST_ENTRY                         Interfaces;
+  LIST_ENTRY                                Interfaces;
 
-  IP4_INTERFACE                      *DefaultInterface;
-  IP4_ROUTE_TABLE                    *DefaultRouteTable;
+  IP4_INTERFACE                             *DefaultInterface;
+  IP4_ROUTE_TABLE                           *DefaultRouteTable;
 
   //
   // Ip reassemble utilities, and IGMP data
   //
-  IP4_ASSEMBLE_TABLE                 Assemble;
-  IGMP_SERVICE_DATA                  IgmpCtrl;
+  IP4_ASSEMBLE_TABLE                        Assemble;
+  IGMP_SERVICE_DATA                         IgmpCtrl;
 
   //
   // Low level protocol used by this service instance
   //
-  EFI_HANDLE                         Image;
-  EFI_HANDLE                         Controller;
+  EFI_HANDLE                                Image;
+  EFI_HANDLE                                Controller;
 
-  EFI_HANDLE                         MnpChildHandle;
-  EFI_MANAGED_NETWORK_PROTOCOL       *Mnp;
+  EFI_HANDLE                                MnpChildHandle;
+  EFI_MANAGED_NETWORK_PROTOCOL              *Mnp;
 
-  EFI_MANAGED_NETWORK_CONFIG_DATA    MnpConfigData;
-  EFI_SIMPLE_NETWORK_MODE            SnpMode;
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // The offloads of the MNP child, NULL if it has none.
+  //
+  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL    *MnpOffload;
+  UINT32                                    OffloadCapabilities;
+  UINT32                                    MaxLargeSendSize;
+  // MU_CHANGE [END]
+
+  EFI_MANAGED_NETWORK_CONFIG_DATA           MnpConfigData;
+  EFI_SIMPLE_NETWORK_MODE                   SnpMode;
 
-  EFI_EVENT                          Timer;
-  EFI_EVENT                          ReconfigCheckTimer;
-  EFI_EVENT                          ReconfigEvent;
+  EFI_EVENT                                 Timer;
+  EFI_EVENT                                 ReconfigCheckTimer;
+  EFI_EVENT                                 ReconfigEvent;
 
-  BOOLEAN                            Reconfig;
+  BOOLEAN                                   Reconfig;
 
   //
   // Underlying media present status.
   //
-  BOOLEAN                            MediaPresent;
+  BOOLEAN                                   MediaPresent;
 
   //
   // IPv4 Configuration II Protocol instance
   //
-  IP4_CONFIG2_INSTANCE               Ip4Config2Instance;
+  IP4_CONFIG2_INSTANCE                      Ip4Config2Instance;
 
-  CHAR16                             *MacString;
+  CHAR16                                    *MacString;
 
-  UINT32                             MaxPacketSize;
-  UINT32                             OldMaxPacketSize; ///< The MTU before IPsec enable.
+  UINT32                                    MaxPacketSize;
+  UINT32                                    OldMaxPacketSize; ///< The MTU before IPsec enable.
 };
 
 #define IP4_INSTANCE_FROM_PROTOCOL(Ip4) \
           CR ((Ip4), IP4_PROTOCOL, Ip4Proto, IP4_PROTOCOL_SIGNATURE)
 
+// MU_CHANGE [BEGIN] - Network offloads
+#define IP4_INSTANCE_FROM_OFFLOAD(Offload) \
+          CR ((Offload), IP4_PROTOCOL, Ip4Offload, IP4_PROTOCOL_SIGNATURE)
+// MU_CHANGE [END]
+
 #define IP4_SERVICE_FROM_PROTOCOL(Sb)   \
           CR ((Sb), IP4_SERVICE, ServiceBinding, IP4_SERVICE_SIGNATURE)
 
@@ -410,4 +430,93 @@ Ip4FreeTxToken (
 extern EFI_IPSEC2_PROTOCOL  *mIpSec;
 extern BOOLEAN              mIpSec2Installed;
 
+// MU_CHANGE [BEGIN] - Network offloads
+extern EDKII_IP4_OFFLOAD_PROTOCOL  mIp4OffloadProtocolTemplate;
+
+/**
+  Places outgoing data packets into the transmit queue, with the offloads
+  requested by the upper layer. This is EfiIp4Transmit() for the IP4 child.
+
+  @param[in]  IpInstance    The IP4 child that issues the transmission.
+  @param[in]  Token         Pointer to the transmit token.
+  @param[in]  OffloadFlags  The EDKII_IP4_OFFLOAD_TX_* flags, validated by
+                            the caller.
+  @param[in]  SegmentSize   Largest TCP payload of a segment of a large send.
+
+  @retval  EFI_SUCCESS           The data has been queued for transmission.
+  @retval  Others                As returned by EfiIp4Transmit().
+
+**/
+EFI_STATUS
+Ip4TransmitWithOffload (
+  IN IP4_PROTOCOL              *IpInstance,
+  IN EFI_IP4_COMPLETION_TOKEN  *Token,
+  IN UINT32                    OffloadFlags,
+  IN UINT16                    SegmentSize
+  );
+
+/**
+  Get the offloads available to the child.
+
+  @param[in]   This               Pointer to the EDKII_IP4_OFFLOAD_PROTOCOL instance.
+  @param[out]  Capabilities       The EDKII_IP4_OFFLOAD_* flags supported.
+  @param[out]  MaxLargeSendSize   Largest TotalDataLength of a large send.
+
+  @retval EFI_SUCCESS            The capabilities are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+Ip4OffloadGetCapabilities (
+  IN  EDKII_IP4_OFFLOAD_PROTOCOL  *This,
+  OUT UINT32                      *Capabilities,
+  OUT UINT32                      *MaxLargeSendSize
+  );
+
+/**
+  Places an outgoing data packet with offloads into the transmit queue.
+
+  @param[in]  This          Pointer to the EDKII_IP4_OFFLOAD_PROTOCOL instance.
+  @param[in]  Token         Pointer to the transmit token.
+  @param[in]  Flags         The EDKII_IP4_OFFLOAD_TX_* flags.
+  @param[in]  SegmentSize   Largest TCP payload of a segment of a large send.
+
+  @retval  EFI_SUCCESS           The data has been queued for transmission.
+  @retval  EFI_INVALID_PARAMETER A parameter is invalid.
+  @retval  EFI_UNSUPPORTED       An offload is not available.
+  @retval  Others                As returned by EfiIp4Transmit().
+
+**/
+EFI_STATUS
+EFIAPI
+Ip4OffloadTransmit (
+  IN EDKII_IP4_OFFLOAD_PROTOCOL  *This,
+  IN EFI_IP4_COMPLETION_TOKEN    *Token,
+  IN UINT32                      Flags,
+  IN UINT16                      SegmentSize
+  );
+
+/**
+  Get the checksums verified by the interface for a received packet.
+
+  @param[in]   This      Pointer to the EDKII_IP4_OFFLOAD_PROTOCOL instance.
+  @param[in]   RxData    The receive data delivered to this instance.
+  @param[out]  Flags     The EDKII_IP4_OFFLOAD_RX_* flags.
+
+  @retval EFI_SUCCESS            The flags are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL, or RxData was not
+                                 delivered to this instance.
+
+**/
+EFI_STATUS
+EFIAPI
+Ip4OffloadGetReceiveFlags (
+  IN  EDKII_IP4_OFFLOAD_PROTOCOL  *This,
+  IN  EFI_IP4_RECEIVE_DATA        *RxData,
+  OUT UINT32                      *Flags
+  );
+
+// MU_CHANGE [END]
+
 #endif
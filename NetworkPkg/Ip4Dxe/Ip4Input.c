@@ -651,7 +651,7 @@ Ip4IpSecProcessPacket (
     }
 
     if ((Direction == EfiIPsecInBound) && (0 != CompareMem (*Head, &ZeroHead, sizeof (IP4_HEAD)))) {
-      Ip4PrependHead (Packet, *Head, *Options, *OptionsLen);
+      Ip4PrependHead (Packet, *Head, *Options, *OptionsLen, FALSE); // MU_CHANGE - Network offloads
       Ip4NtohHead (Packet->Ip.Ip4);
       NetbufTrim (Packet, ((*Head)->HeadLen << 2), TRUE);
 
@@ -722,17 +722,33 @@ Ip4PreProcessPacket (
   //
   // Some OS may send IP packets without checksum.
   //
-  Checksum = (UINT16)(~NetblockChecksum ((UINT8 *)Head, HeadLen));
+  // MU_CHANGE [BEGIN] - Network offloads
+  if ((Flag & EDKII_NETWORK_OFFLOAD_RX_IP4_CHECKSUM) == 0) {
+    Checksum = (UINT16)(~NetblockChecksum ((UINT8 *)Head, HeadLen));
 
-  if ((Head->Checksum != 0) && (Checksum != 0)) {
-    return EFI_INVALID_PARAMETER;
+    if ((Head->Checksum != 0) && (Checksum != 0)) {
+      return EFI_INVALID_PARAMETER;
+    }
   }
 
+  // MU_CHANGE [END]
+
   //
   // Convert the IP header to host byte order, then get the per packet info.
   //
   (*Packet)->Ip.Ip4 = Ip4NtohHead (Head);
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // The interface verified the transport checksum of the frame, which says
+  // nothing about a reassembled or decrypted packet.
+  //
+  if (((Head->Fragment & (IP4_HEAD_MF_MASK | IP4_HEAD_OFFSET_MASK)) != 0) || mIpSec2Installed) {
+    Flag &= ~IP4_LINK_OFFLOAD_L4_MASK;
+  }
+
+  // MU_CHANGE [END]
+
   Info           = IP4_GET_CLIP_INFO (*Packet);
   Info->LinkFlag = Flag;
   Info->CastType = Ip4GetHostCast (IpSb, Head->Dst, Head->Src);
@@ -1201,9 +1217,10 @@ Ip4WrapRxData (
 
   InitializeListHead (&Wrap->Link);
 
-  Wrap->IpInstance = IpInstance;
-  Wrap->Packet     = Packet;
-  RxData           = &Wrap->RxData;
+  Wrap->IpInstance   = IpInstance;
+  Wrap->Packet       = Packet;
+  Wrap->OffloadFlags = (UINT32)IP4_GET_CLIP_INFO (Packet)->LinkFlag & IP4_LINK_OFFLOAD_L4_MASK; // MU_CHANGE - Network offloads
+  RxData             = &Wrap->RxData;
 
   ZeroMem (RxData, sizeof (EFI_IP4_RECEIVE_DATA));
 
@@ -1451,7 +1468,7 @@ Ip4InterfaceEnquePacket (
     // In RawData mode, add IPv4 headers and options back to packet.
     //
     if ((IpInstance->ConfigData.RawData) && (Option != NULL) && (OptionLen != 0)) {
-      Ip4PrependHead (Packet, Head, Option, OptionLen);
+      Ip4PrependHead (Packet, Head, Option, OptionLen, FALSE); // MU_CHANGE - Network offloads
     }
 
     if (Ip4InstanceEnquePacket (IpInstance, Head, Packet) == EFI_SUCCESS) {
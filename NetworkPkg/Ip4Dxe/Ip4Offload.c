@@ -0,0 +1,216 @@
+/** @file
+  Implementation of the IPv4 Offload Protocol.
+
+  The TCP and UDP checksums and the large sends of the MNP child are passed
+  through to the IP4 children, except when IPsec is installed or the child
+  sends raw IP packets. The IPv4 header checksum is left to the interface in
+  Ip4Output() for all the packets when it can compute it. A packet with an
+  offloaded checksum that has to be fragmented has its checksum completed in
+  software before.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "Ip4Impl.h"
+
+#define IP4_OFFLOAD_CHILD_CAPABILITIES  (EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM |   \
+                                         EDKII_IP4_OFFLOAD_TX_UDP4_CHECKSUM |   \
+                                         EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND | \
+                                         IP4_LINK_OFFLOAD_L4_MASK)
+
+//
+// The flags of the IP4 children are passed through to the MNP child.
+//
+STATIC_ASSERT (
+  EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM == EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM,
+  "The TCP checksum flags of the IP4 and network offloads differ"
+  );
+STATIC_ASSERT (
+  EDKII_IP4_OFFLOAD_TX_UDP4_CHECKSUM == EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM,
+  "The UDP checksum flags of the IP4 and network offloads differ"
+  );
+STATIC_ASSERT (
+  EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND == EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND,
+  "The large send flags of the IP4 and network offloads differ"
+  );
+STATIC_ASSERT (
+  EDKII_IP4_OFFLOAD_RX_TCP4_CHECKSUM == EDKII_NETWORK_OFFLOAD_RX_TCP4_CHECKSUM,
+  "The TCP receive checksum flags of the IP4 and network offloads differ"
+  );
+STATIC_ASSERT (
+  EDKII_IP4_OFFLOAD_RX_UDP4_CHECKSUM == EDKII_NETWORK_OFFLOAD_RX_UDP4_CHECKSUM,
+  "The UDP receive checksum flags of the IP4 and network offloads differ"
+  );
+
+EDKII_IP4_OFFLOAD_PROTOCOL  mIp4OffloadProtocolTemplate = {
+  EDKII_IP4_OFFLOAD_PROTOCOL_REVISION,
+  Ip4OffloadGetCapabilities,
+  Ip4OffloadTransmit,
+  Ip4OffloadGetReceiveFlags
+};
+
+/**
+  Get the offloads available to the child.
+
+  @param[in]   This               Pointer to the EDKII_IP4_OFFLOAD_PROTOCOL instance.
+  @param[out]  Capabilities       The EDKII_IP4_OFFLOAD_* flags supported.
+  @param[out]  MaxLargeSendSize   Largest TotalDataLength of a large send.
+
+  @retval EFI_SUCCESS            The capabilities are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+Ip4OffloadGetCapabilities (
+  IN  EDKII_IP4_OFFLOAD_PROTOCOL  *This,
+  OUT UINT32                      *Capabilities,
+  OUT UINT32                      *MaxLargeSendSize
+  )
+{
+  IP4_PROTOCOL  *IpInstance;
+  IP4_SERVICE   *IpSb;
+
+  if ((This == NULL) || (Capabilities == NULL) || (MaxLargeSendSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IpInstance = IP4_INSTANCE_FROM_OFFLOAD (This);
+  IpSb       = IpInstance->Service;
+
+  *Capabilities     = 0;
+  *MaxLargeSendSize = 0;
+
+  //
+  // IPsec may protect the packets after the upper layer built them, and
+  // a raw IP child builds the IP header itself.
+  //
+  if (mIpSec2Installed || IpInstance->ConfigData.RawData) {
+    return EFI_SUCCESS;
+  }
+
+  *Capabilities = IpSb->OffloadCapabilities & IP4_OFFLOAD_CHILD_CAPABILITIES;
+
+  //
+  // The TCP header and the options of the IP header are sent with
+  // each segment, leave room for the largest IP header.
+  //
+  if (((*Capabilities & EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND) != 0) &&
+      ((*Capabilities & EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM) != 0) &&
+      (IpSb->MaxLargeSendSize > IP4_MAX_HEADLEN))
+  {
+    *MaxLargeSendSize = MIN (IpSb->MaxLargeSendSize, IP4_MAX_PACKET_SIZE) - IP4_MAX_HEADLEN;
+  } else {
+    *Capabilities &= ~EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Places an outgoing data packet with offloads into the transmit queue.
+
+  @param[in]  This          Pointer to the EDKII_IP4_OFFLOAD_PROTOCOL instance.
+  @param[in]  Token         Pointer to the transmit token.
+  @param[in]  Flags         The EDKII_IP4_OFFLOAD_TX_* flags.
+  @param[in]  SegmentSize   Largest TCP payload of a segment of a large send.
+
+  @retval  EFI_SUCCESS           The data has been queued for transmission.
+  @retval  EFI_INVALID_PARAMETER A parameter is invalid.
+  @retval  EFI_UNSUPPORTED       An offload is not available.
+  @retval  Others                As returned by EfiIp4Transmit().
+
+**/
+EFI_STATUS
+EFIAPI
+Ip4OffloadTransmit (
+  IN EDKII_IP4_OFFLOAD_PROTOCOL  *This,
+  IN EFI_IP4_COMPLETION_TOKEN    *Token,
+  IN UINT32                      Flags,
+  IN UINT16                      SegmentSize
+  )
+{
+  IP4_PROTOCOL  *IpInstance;
+  UINT32        Capabilities;
+  UINT32        MaxLargeSendSize;
+  EFI_STATUS    Status;
+
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IpInstance = IP4_INSTANCE_FROM_OFFLOAD (This);
+
+  if (Flags == 0) {
+    return Ip4TransmitWithOffload (IpInstance, Token, 0, 0);
+  }
+
+  Status = Ip4OffloadGetCapabilities (This, &Capabilities, &MaxLargeSendSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((Flags & ~(Capabilities & EDKII_NETWORK_OFFLOAD_TX_MASK)) != 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((Flags & (EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_IP4_OFFLOAD_TX_UDP4_CHECKSUM)) ==
+      (EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_IP4_OFFLOAD_TX_UDP4_CHECKSUM))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((Flags & EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND) != 0) {
+    if ((SegmentSize == 0) || ((Flags & EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM) == 0) ||
+        (Token == NULL) || (Token->Packet.TxData == NULL))
+    {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    if (Token->Packet.TxData->TotalDataLength > MaxLargeSendSize) {
+      return EFI_BAD_BUFFER_SIZE;
+    }
+  }
+
+  return Ip4TransmitWithOffload (IpInstance, Token, Flags, SegmentSize);
+}
+
+/**
+  Get the checksums verified by the interface for a received packet.
+
+  @param[in]   This      Pointer to the EDKII_IP4_OFFLOAD_PROTOCOL instance.
+  @param[in]   RxData    The receive data delivered to this instance.
+  @param[out]  Flags     The EDKII_IP4_OFFLOAD_RX_* flags.
+
+  @retval EFI_SUCCESS            The flags are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL, or RxData was not
+                                 delivered to this instance.
+
+**/
+EFI_STATUS
+EFIAPI
+Ip4OffloadGetReceiveFlags (
+  IN  EDKII_IP4_OFFLOAD_PROTOCOL  *This,
+  IN  EFI_IP4_RECEIVE_DATA        *RxData,
+  OUT UINT32                      *Flags
+  )
+{
+  IP4_PROTOCOL     *IpInstance;
+  IP4_RXDATA_WRAP  *Wrap;
+
+  if ((This == NULL) || (RxData == NULL) || (Flags == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IpInstance = IP4_INSTANCE_FROM_OFFLOAD (This);
+  Wrap       = BASE_CR (RxData, IP4_RXDATA_WRAP, RxData);
+
+  if (Wrap->IpInstance != IpInstance) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Flags = Wrap->OffloadFlags;
+  return EFI_SUCCESS;
+}
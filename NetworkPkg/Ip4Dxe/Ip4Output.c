@@ -10,6 +10,58 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 UINT16  mIp4Id;
 
+// MU_CHANGE [BEGIN] - Network offloads
+#define IP4_OFFLOAD_TCP_HEADLEN_OFFSET   12
+#define IP4_OFFLOAD_TCP_CHECKSUM_OFFSET  16
+#define IP4_OFFLOAD_UDP_CHECKSUM_OFFSET  6
+
+/**
+  Complete in software the TCP or UDP checksum that the upper layer asked the
+  interface to compute, when the packet can't be sent with the offload. The
+  checksum field holds the sum of the pseudo-header without the length.
+
+  @param[in, out]  Packet          The TCP or UDP packet, excluding the IP header.
+  @param[in]       OffloadFlags    The EDKII_NETWORK_OFFLOAD_TX_* flags of the packet.
+
+**/
+STATIC
+VOID
+Ip4CompleteChecksum (
+  IN OUT NET_BUF  *Packet,
+  IN     UINT32   OffloadFlags
+  )
+{
+  UINT8   *Field;
+  UINT16  Checksum;
+
+  if ((OffloadFlags & EDKII_NETWORK_OFFLOAD_TX_TCP4_CHECKSUM) != 0) {
+    Field = NetbufGetByte (Packet, IP4_OFFLOAD_TCP_CHECKSUM_OFFSET, NULL);
+  } else if ((OffloadFlags & EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM) != 0) {
+    Field = NetbufGetByte (Packet, IP4_OFFLOAD_UDP_CHECKSUM_OFFSET, NULL);
+  } else {
+    return;
+  }
+
+  if (Field == NULL) {
+    ASSERT (Field != NULL);
+    return;
+  }
+
+  Checksum = NetAddChecksum (NetbufChecksum (Packet), HTONS ((UINT16)Packet->TotalSize));
+  Checksum = (UINT16)~Checksum;
+
+  //
+  // A zero UDP checksum means that there is none.
+  //
+  if ((Checksum == 0) && ((OffloadFlags & EDKII_NETWORK_OFFLOAD_TX_UDP4_CHECKSUM) != 0)) {
+    Checksum = 0xffff;
+  }
+
+  WriteUnaligned16 ((UINT16 *)Field, Checksum);
+}
+
+// MU_CHANGE [END]
+
 /**
   Prepend an IP4 head to the Packet. It will copy the options and
   build the IP4 header fields. Used for IP4 fragmentation.
@@ -22,6 +74,7 @@ UINT16  mIp4Id;
                            the Ver, HeadLen, and checksum.
   @param  Option           The original IP4 option to copy from
   @param  OptLen           The length of the IP4 option
+  @param  ChecksumOffload  TRUE to leave the checksum to the interface.
 
   @retval EFI_BAD_BUFFER_SIZE  There is no enough room in the head space of
                                Packet.
@@ -33,7 +86,8 @@ Ip4PrependHead (
   IN OUT NET_BUF   *Packet,
   IN     IP4_HEAD  *Head,
   IN     UINT8     *Option,
-  IN     UINT32    OptLen
+  IN     UINT32    OptLen,
+  IN     BOOLEAN   ChecksumOffload    // MU_CHANGE - Network offloads
   )
 {
   UINT32    HeadLen;
@@ -74,7 +128,13 @@ Ip4PrependHead (
   PacketHead->Protocol = Head->Protocol;
   PacketHead->Src      = HTONL (Head->Src);
   PacketHead->Dst      = HTONL (Head->Dst);
-  PacketHead->Checksum = (UINT16)(~NetblockChecksum ((UINT8 *)PacketHead, HeadLen));
+
+  // MU_CHANGE [BEGIN] - Network offloads
+  if (!ChecksumOffload) {
+    PacketHead->Checksum = (UINT16)(~NetblockChecksum ((UINT8 *)PacketHead, HeadLen));
+  }
+
+  // MU_CHANGE [END]
 
   Packet->Ip.Ip4 = PacketHead;
   return EFI_SUCCESS;
@@ -190,6 +250,9 @@ Ip4SysPacketSent (
   @param[in]  Callback         The callback function to issue when transmission
                                completed.
   @param[in]  Context          The opaque context for the callback
+  @param[in]  OffloadFlags     The EDKII_NETWORK_OFFLOAD_TX_* flags requested by
+                               the upper layer, zero if none.
+  @param[in]  SegmentSize      Largest TCP payload of a segment of a large send.
 
   @retval EFI_NO_MAPPING       There is no interface to the destination.
   @retval EFI_NOT_FOUND        There is no route to the destination
@@ -211,21 +274,26 @@ Ip4Output (
   IN UINT32              OptLen,
   IN IP4_ADDR            GateWay,
   IN IP4_FRAME_CALLBACK  Callback,
-  IN VOID                *Context
+  IN VOID                *Context,
+  IN UINT32              OffloadFlags,      // MU_CHANGE - Network offloads
+  IN UINT16              SegmentSize        // MU_CHANGE - Network offloads
   )
 {
-  IP4_INTERFACE          *IpIf;
-  IP4_ROUTE_CACHE_ENTRY  *CacheEntry;
-  IP4_ADDR               Dest;
-  EFI_STATUS             Status;
-  NET_BUF                *Fragment;
-  UINT32                 Index;
-  UINT32                 HeadLen;
-  UINT32                 PacketLen;
-  UINT32                 Offset;
-  UINT32                 Mtu;
-  UINT32                 Num;
-  BOOLEAN                RawData;
+  IP4_INTERFACE                  *IpIf;
+  IP4_ROUTE_CACHE_ENTRY          *CacheEntry;
+  IP4_ADDR                       Dest;
+  EFI_STATUS                     Status;
+  NET_BUF                        *Fragment;
+  UINT32                         Index;
+  UINT32                         HeadLen;
+  UINT32                         PacketLen;
+  UINT32                         Offset;
+  UINT32                         Mtu;
+  UINT32                         Num;
+  BOOLEAN                        RawData;
+  EDKII_NETWORK_OFFLOAD_TX_INFO  Offload;          // MU_CHANGE - Network offloads
+  UINT8                          *TcpHeadLen;      // MU_CHANGE - Network offloads
+  BOOLEAN                        ChecksumOffload;  // MU_CHANGE - Network offloads
 
   //
   // Select an interface/source for system packet, application
@@ -260,6 +328,22 @@ Ip4Output (
     RawData       = FALSE;
   }
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // IPsec may protect the packet, so the interface can neither complete
+  // the upper layer checksum nor segment it.
+  //
+  if ((OffloadFlags != 0) && mIpSec2Installed) {
+    if ((OffloadFlags & EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND) != 0) {
+      return EFI_UNSUPPORTED;
+    }
+
+    Ip4CompleteChecksum (Packet, OffloadFlags);
+    OffloadFlags = 0;
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Call IPsec process.
   //
@@ -323,7 +407,41 @@ Ip4Output (
   //
   Mtu = IpSb->MaxPacketSize + sizeof (IP4_HEAD);
 
-  if (Packet->TotalSize + HeadLen > Mtu) {
+  // MU_CHANGE [BEGIN] - Network offloads
+  if ((OffloadFlags & EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND) != 0) {
+    //
+    // The interface segments the packet instead of fragmenting it,
+    // and each of the segments must fit in the MTU.
+    //
+    TcpHeadLen = NetbufGetByte (Packet, IP4_OFFLOAD_TCP_HEADLEN_OFFSET, NULL);
+
+    if (RawData || (TcpHeadLen == NULL) ||
+        (HeadLen + ((*TcpHeadLen >> 4) << 2) + SegmentSize > Mtu) ||
+        (Packet->TotalSize + HeadLen > MIN (IpSb->MaxLargeSendSize, IP4_MAX_PACKET_SIZE)))
+    {
+      return EFI_BAD_BUFFER_SIZE;
+    }
+  } else if ((Packet->TotalSize + HeadLen > Mtu) && (OffloadFlags != 0)) {
+    //
+    // The checksum covers all the fragments, which the interface sees
+    // one at a time.
+    //
+    Ip4CompleteChecksum (Packet, OffloadFlags);
+    OffloadFlags = 0;
+  }
+
+  ChecksumOffload = (BOOLEAN)(!RawData && ((IpSb->OffloadCapabilities & EDKII_NETWORK_OFFLOAD_TX_IP4_CHECKSUM) != 0));
+  if (ChecksumOffload) {
+    OffloadFlags |= EDKII_NETWORK_OFFLOAD_TX_IP4_CHECKSUM;
+  }
+
+  Offload.Flags           = OffloadFlags;
+  Offload.NetworkOffset   = 0;
+  Offload.TransportOffset = (UINT16)HeadLen;
+  Offload.SegmentSize     = SegmentSize;
+  // MU_CHANGE [END]
+
+  if ((Packet->TotalSize + HeadLen > Mtu) && ((OffloadFlags & EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND) == 0)) { // MU_CHANGE - Network offloads
     //
     // Fragmentation is disabled for RawData mode.
     //
@@ -361,7 +479,7 @@ Ip4Output (
       // fields that are required by Ip4PrependHead except the fragment.
       //
       Head->Fragment = IP4_HEAD_FRAGMENT_FIELD (FALSE, (Index != 0), Offset);
-      Ip4PrependHead (Fragment, Head, Option, OptLen);
+      Ip4PrependHead (Fragment, Head, Option, OptLen, ChecksumOffload); // MU_CHANGE - Network offloads
 
       //
       // Transmit the fragments, pass the Packet address as the context.
@@ -375,7 +493,8 @@ Ip4Output (
                  GateWay,
                  Ip4SysPacketSent,
                  Packet,
-                 IpSb
+                 IpSb,
+                 &Offload     // MU_CHANGE - Network offloads
                  );
 
       if (EFI_ERROR (Status)) {
@@ -417,8 +536,10 @@ Ip4Output (
   //    and signal the user's recycle event. So, also no problem for
   //    upper layer's packets.
   //
-  Ip4PrependHead (Packet, Head, Option, OptLen);
-  Status = Ip4SendFrame (IpIf, IpInstance, Packet, GateWay, Callback, Context, IpSb);
+  // MU_CHANGE [BEGIN] - Network offloads
+  Ip4PrependHead (Packet, Head, Option, OptLen, ChecksumOffload);
+  Status = Ip4SendFrame (IpIf, IpInstance, Packet, GateWay, Callback, Context, IpSb, &Offload);
+  // MU_CHANGE [END]
 
   if (EFI_ERROR (Status)) {
     goto ON_ERROR;
@@ -54,6 +54,9 @@ Ip4SysPacketSent (
   @param[in]  Callback         The callback function to issue when transmission
                                completed.
   @param[in]  Context          The opaque context for the callback
+  @param[in]  OffloadFlags     The EDKII_NETWORK_OFFLOAD_TX_* flags requested by
+                               the upper layer, zero if none.
+  @param[in]  SegmentSize      Largest TCP payload of a segment of a large send.
 
   @retval EFI_NO_MAPPING       There is no interface to the destination.
   @retval EFI_NOT_FOUND        There is no route to the destination
@@ -71,7 +74,9 @@ Ip4Output (
   IN UINT32              OptLen,
   IN IP4_ADDR            GateWay,
   IN IP4_FRAME_CALLBACK  Callback,
-  IN VOID                *Context
+  IN VOID                *Context,
+  IN UINT32              OffloadFlags,      // MU_CHANGE - Network offloads
+  IN UINT16              SegmentSize        // MU_CHANGE - Network offloads
   );
 
 /**
@@ -101,6 +106,7 @@ Ip4CancelPacket (
                            the Ver, HeadLen, and checksum.
   @param  Option           The original IP4 option to copy from
   @param  OptLen           The length of the IP4 option
+  @param  ChecksumOffload  TRUE to leave the checksum to the interface.
 
   @retval EFI_BAD_BUFFER_SIZE  There is no enough room in the head space of
                                Packet.
@@ -112,7 +118,8 @@ Ip4PrependHead (
   IN OUT NET_BUF   *Packet,
   IN     IP4_HEAD  *Head,
   IN     UINT8     *Option,
-  IN     UINT32    OptLen
+  IN     UINT32    OptLen,
+  IN     BOOLEAN   ChecksumOffload    // MU_CHANGE - Network offloads
   );
 
 extern UINT16  mIp4Id;
@@ -254,6 +254,54 @@ IpIoCloseProtocolDestroyIpChild (
            );
 }
 
+// MU_CHANGE [BEGIN] - Network offloads
+
+/**
+  This function gets the IPv4 offload protocol of an IP child.
+
+  The protocol is installed and uninstalled with the IP protocol of the child,
+  which is opened by driver, so it is only got here.
+
+  @param[in]  ControllerHandle    The controller handle.
+  @param[in]  ImageHandle         The image handle.
+  @param[in]  ChildHandle         The child handle of the IP child.
+  @param[in]  IpVersion           The version of the IP protocol of the child.
+
+  @return The IPv4 offload protocol, or NULL if the child does not provide it.
+
+**/
+EDKII_IP4_OFFLOAD_PROTOCOL *
+IpIoGetIp4Offload (
+  IN EFI_HANDLE  ControllerHandle,
+  IN EFI_HANDLE  ImageHandle,
+  IN EFI_HANDLE  ChildHandle,
+  IN UINT8       IpVersion
+  )
+{
+  EFI_STATUS                  Status;
+  EDKII_IP4_OFFLOAD_PROTOCOL  *Ip4Offload;
+
+  if (IpVersion != IP_VERSION_4) {
+    return NULL;
+  }
+
+  Status = gBS->OpenProtocol (
+                  ChildHandle,
+                  &gEdkiiIp4OffloadProtocolGuid,
+                  (VOID **)&Ip4Offload,
+                  ImageHandle,
+                  ControllerHandle,
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                  );
+  if (EFI_ERROR (Status)) {
+    return NULL;
+  }
+
+  return Ip4Offload;
+}
+
+// MU_CHANGE [END]
+
 /**
   This function handles ICMPv4 packets. It is the worker function of
   IpIoIcmpHandler.
@@ -1092,6 +1140,21 @@ IpIoListenHandlerDpc (
     Session.IpHdr.Ip4Hdr   = RxData->Ip4RxData.Header;
     Session.IpHdrLen       = RxData->Ip4RxData.HeaderLength;
     Session.IpVersion      = IP_VERSION_4;
+
+    // MU_CHANGE [BEGIN] - Network offloads
+    Session.OffloadFlags = 0;
+    if (IpIo->Ip4Offload != NULL) {
+      Status = IpIo->Ip4Offload->GetReceiveFlags (
+                                   IpIo->Ip4Offload,
+                                   &RxData->Ip4RxData,
+                                   &Session.OffloadFlags
+                                   );
+      if (EFI_ERROR (Status)) {
+        Session.OffloadFlags = 0;
+      }
+    }
+
+    // MU_CHANGE [END]
   } else {
     ASSERT (RxData->Ip6RxData.Header != NULL);
     if (!NetIp6IsValidUnicast (&RxData->Ip6RxData.Header->SourceAddress)) {
@@ -1141,6 +1204,7 @@ IpIoListenHandlerDpc (
     Session.IpHdr.Ip6Hdr = RxData->Ip6RxData.Header;
     Session.IpHdrLen     = RxData->Ip6RxData.HeaderLength;
     Session.IpVersion    = IP_VERSION_6;
+    Session.OffloadFlags = 0;             // MU_CHANGE - Network offloads
   }
 
   if (EFI_SUCCESS == Status) {
@@ -1269,6 +1333,8 @@ IpIoCreate (
     goto ReleaseIpIo;
   }
 
+  IpIo->Ip4Offload = IpIoGetIp4Offload (Controller, Image, IpIo->ChildHandle, IpVersion); // MU_CHANGE - Network offloads
+
   return IpIo;
 
 ReleaseIpIo:
@@ -1585,14 +1651,70 @@ IpIoSend (
   IN     IP_IO_OVERRIDE  *OverrideData  OPTIONAL
   )
 {
-  EFI_STATUS         Status;
-  IP_IO_IP_PROTOCOL  Ip;
-  IP_IO_SEND_ENTRY   *SndEntry;
+  // MU_CHANGE [BEGIN] - Network offloads
+  return IpIoSendWithOffload (IpIo, Pkt, Sender, Context, NotifyData, Dest, OverrideData, 0, 0);
+}
+
+/**
+  Send out an IP packet with checksum or segmentation offloads.
+
+  It works as IpIoSend(), and asks the interface to complete the checksums
+  or to segment the packet as specified by OffloadFlags. OffloadFlags may
+  only contain offloads returned by IpIoGetOffloadCapabilities() for the
+  same Sender. When OffloadFlags is zero, it is the same as IpIoSend().
+
+  @param[in, out]  IpIo                  Pointer to an IP_IO instance used for sending IP
+                                         packet.
+  @param[in, out]  Pkt                   Pointer to the IP packet to be sent.
+  @param[in]       Sender                The IP protocol instance used for sending.
+  @param[in]       Context               Optional context data.
+  @param[in]       NotifyData            Optional notify data.
+  @param[in]       Dest                  The destination IP address to send this packet to.
+                                         This parameter is optional when using IPv6.
+  @param[in]       OverrideData          The data to override some configuration of the IP
+                                         instance used for sending.
+  @param[in]       OffloadFlags          The EDKII_IP4_OFFLOAD_TX_* flags.
+  @param[in]       SegmentSize           The largest TCP payload of a segment when
+                                         OffloadFlags has EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND.
+
+  @retval          EFI_SUCCESS           The operation is completed successfully.
+  @retval          EFI_INVALID_PARAMETER The input parameter is not correct.
+  @retval          EFI_NOT_STARTED       The IpIo is not configured.
+  @retval          EFI_UNSUPPORTED       An offload is not available, the packet is not sent.
+  @retval          EFI_OUT_OF_RESOURCES  Failed due to resource limit.
+  @retval          Others                Error condition occurred.
+
+**/
+EFI_STATUS
+EFIAPI
+IpIoSendWithOffload (
+  IN OUT IP_IO           *IpIo,
+  IN OUT NET_BUF         *Pkt,
+  IN     IP_IO_IP_INFO   *Sender        OPTIONAL,
+  IN     VOID            *Context       OPTIONAL,
+  IN     VOID            *NotifyData    OPTIONAL,
+  IN     EFI_IP_ADDRESS  *Dest          OPTIONAL,
+  IN     IP_IO_OVERRIDE  *OverrideData  OPTIONAL,
+  IN     UINT32          OffloadFlags,
+  IN     UINT16          SegmentSize
+  )
+{
+  EFI_STATUS                  Status;
+  IP_IO_IP_PROTOCOL           Ip;
+  IP_IO_SEND_ENTRY            *SndEntry;
+  EDKII_IP4_OFFLOAD_PROTOCOL  *Ip4Offload;
 
   if ((IpIo == NULL) || (Pkt == NULL)) {
     return EFI_INVALID_PARAMETER;
   }
 
+  Ip4Offload = (NULL == Sender) ? IpIo->Ip4Offload : Sender->Ip4Offload;
+  if ((OffloadFlags != 0) && (Ip4Offload == NULL)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  // MU_CHANGE [END]
+
   if ((IpIo->IpVersion == IP_VERSION_4) && (Dest == NULL)) {
     return EFI_INVALID_PARAMETER;
   }
@@ -1614,7 +1736,17 @@ IpIoSend (
   //
   // Send this Packet
   //
-  if (IpIo->IpVersion == IP_VERSION_4) {
+  if (OffloadFlags != 0) { // MU_CHANGE - Network offloads
+    //
+    // Only IPv4 provides the offloads, see above.
+    //
+    Status = Ip4Offload->Transmit (
+                           Ip4Offload,
+                           &SndEntry->SndToken.Ip4Token,
+                           OffloadFlags,
+                           SegmentSize
+                           );
+  } else if (IpIo->IpVersion == IP_VERSION_4) { // MU_CHANGE - Network offloads
     Status = Ip.Ip4->Transmit (
                        Ip.Ip4,
                        &SndEntry->SndToken.Ip4Token
@@ -1633,6 +1765,57 @@ IpIoSend (
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - Network offloads
+
+/**
+  Get the offloads IpIoSendWithOffload() can use with the IP instance.
+
+  @param[in]   IpIo                  Pointer to an IP_IO instance.
+  @param[in]   Sender                The IP instance used for sending, or NULL for
+                                     the IP instance of IpIo.
+  @param[out]  Capabilities          The EDKII_IP4_OFFLOAD_* flags supported,
+                                     zero if none is.
+  @param[out]  MaxLargeSendSize      The largest TCP segment of a large send.
+
+  @retval      EFI_SUCCESS           The capabilities are returned.
+  @retval      EFI_INVALID_PARAMETER A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+IpIoGetOffloadCapabilities (
+  IN  IP_IO          *IpIo,
+  IN  IP_IO_IP_INFO  *Sender OPTIONAL,
+  OUT UINT32         *Capabilities,
+  OUT UINT32         *MaxLargeSendSize
+  )
+{
+  EFI_STATUS                  Status;
+  EDKII_IP4_OFFLOAD_PROTOCOL  *Ip4Offload;
+
+  if ((IpIo == NULL) || (Capabilities == NULL) || (MaxLargeSendSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Capabilities     = 0;
+  *MaxLargeSendSize = 0;
+
+  Ip4Offload = (NULL == Sender) ? IpIo->Ip4Offload : Sender->Ip4Offload;
+  if (Ip4Offload == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  Status = Ip4Offload->GetCapabilities (Ip4Offload, Capabilities, MaxLargeSendSize);
+  if (EFI_ERROR (Status)) {
+    *Capabilities     = 0;
+    *MaxLargeSendSize = 0;
+  }
+
+  return EFI_SUCCESS;
+}
+
+// MU_CHANGE [END]
+
 /**
   Cancel the IP transmit token which wraps this Packet.
 
@@ -1739,6 +1922,15 @@ IpIoAddIp (
     goto ReleaseIpInfo;
   }
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  IpInfo->Ip4Offload = IpIoGetIp4Offload (
+                         IpIo->Controller,
+                         IpIo->Image,
+                         IpInfo->ChildHandle,
+                         IpInfo->IpVersion
+                         );
+  // MU_CHANGE [END]
+
   //
   // Create the event for the DummyRcvToken.
   //
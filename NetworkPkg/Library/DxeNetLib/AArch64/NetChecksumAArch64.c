@@ -0,0 +1,22 @@
+/** @file
+  Kernel selection of the Internet checksum for AArch64.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "../NetChecksum.h"
+
+/**
+  Select the fastest vector kernel supported by the processor.
+
+  @return The Advanced SIMD kernel, which is always available to UEFI.
+
+**/
+NET_CHECKSUM_KERNEL
+NetChecksumSelectKernel (
+  VOID
+  )
+{
+  return InternalNetChecksumNeon;
+}
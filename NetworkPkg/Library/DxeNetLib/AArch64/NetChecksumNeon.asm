@@ -0,0 +1,70 @@
+;------------------------------------------------------------------------------
+;
+; InternalNetChecksumNeon() for AArch64
+;
+; Copyright (c) Microsoft Corporation.
+; SPDX-License-Identifier: BSD-2-Clause-Patent
+;
+;------------------------------------------------------------------------------
+
+  EXPORT InternalNetChecksumNeon
+  AREA DxeNetLib_LowLevel, CODE, READONLY
+
+;
+; The 32-bit lanes receive at most 2 words of each 64-byte block, so
+; they are folded into the 64-bit sum long before they can overflow.
+;
+NET_CHECKSUM_CHUNK_LEN  EQU  0x80000
+
+;/**
+;  Sums the 16-bit words of the data in 64-byte blocks with Advanced SIMD.
+;  Only the caller-saved registers V0-V7 are used.
+;
+;  @param  Bulk   Pointer to the data.
+;  @param  Len    Length of the data, a multiple of 64.
+;
+;  @return The 64-bit sum of the words.
+;
+;**/
+;UINT64
+;EFIAPI
+;InternalNetChecksumNeon (
+;  IN CONST UINT8  *Bulk,
+;  IN UINTN        Len
+;  );
+;
+InternalNetChecksumNeon
+  mov     x2, #0
+NetChecksumNeonNextChunk
+  movi    v0.4s, #0
+  movi    v1.4s, #0
+  movi    v2.4s, #0
+  movi    v3.4s, #0
+  mov     x3, #NET_CHECKSUM_CHUNK_LEN
+  cmp     x1, x3
+  csel    x3, x1, x3, lo
+  sub     x1, x1, x3
+NetChecksumNeonNextBlock
+  ld1     {v4.8h, v5.8h, v6.8h, v7.8h}, [x0], #64
+  uadalp  v0.4s, v4.8h
+  uadalp  v1.4s, v5.8h
+  uadalp  v2.4s, v6.8h
+  uadalp  v3.4s, v7.8h
+  subs    x3, x3, #64
+  b.ne    NetChecksumNeonNextBlock
+
+  ;
+  ; Widen the lanes to 64 bits and add them to the sum.
+  ;
+  uaddlp  v0.2d, v0.4s
+  uadalp  v0.2d, v1.4s
+  uadalp  v0.2d, v2.4s
+  uadalp  v0.2d, v3.4s
+  addp    d0, v0.2d
+  fmov    x4, d0
+  add     x2, x2, x4
+  cbnz    x1, NetChecksumNeonNextChunk
+  mov     x0, x2
+  ret
+
+  END
@@ -0,0 +1,267 @@
+/** @file
+  Tests for the vectorized Internet checksum of NetChecksum.c.
+
+  Each kernel the host can run is compared with the word loop the checksum
+  used before, on all the lengths and alignments a packet may have, and on
+  buffers large enough to overflow the accumulators of the kernels. The
+  benchmark only reports the throughput of each kernel.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+#include <gtest/gtest.h>
+#include <chrono>
+#include <vector>
+#if defined (_MSC_VER)
+  #include <intrin.h>
+#elif defined (__x86_64__)
+  #include <x86intrin.h>
+#endif
+
+extern "C" {
+  #include <Uefi.h>
+  #include <Library/BaseLib.h>
+  #include <Library/BaseMemoryLib.h>
+  #include "../NetChecksum.h"
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Helpers
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  CONST CHAR8            *Name;
+  NET_CHECKSUM_KERNEL    Kernel;
+} CHECKSUM_KERNEL_INFO;
+
+//
+// The word loop of NetblockChecksum before the vector kernels, with a 64-bit
+// sum so that it stays exact beyond the 128 KB where the 32-bit sum wraps.
+//
+STATIC
+UINT16
+ReferenceChecksum (
+  IN UINT8   *Bulk,
+  IN UINT32  Len
+  )
+{
+  UINT64  Sum;
+
+  Sum = 0;
+
+  if (Len % 2 != 0) {
+    Sum += *(Bulk + Len - 1);
+  }
+
+  while (Len > 1) {
+    Sum  += *(UINT16 *)Bulk;
+    Bulk += 2;
+    Len  -= 2;
+  }
+
+  while ((Sum >> 16) != 0) {
+    Sum = (Sum & 0xffff) + (Sum >> 16);
+  }
+
+  return (UINT16)Sum;
+}
+
+#if defined (MDE_CPU_X64)
+
+//
+// The host test does not link the selection of X64/NetChecksumX64.c, so the
+// AVX2 support is checked with the compiler instead.
+//
+STATIC
+BOOLEAN
+HostSupportsAvx2 (
+  VOID
+  )
+{
+ #if defined (_MSC_VER)
+  int  Info[4];
+
+  __cpuid (Info, 1);
+  if (((Info[2] & BIT27) == 0) || ((Info[2] & BIT28) == 0)) {
+    return FALSE;
+  }
+
+  if ((_xgetbv (0) & (BIT1 | BIT2)) != (BIT1 | BIT2)) {
+    return FALSE;
+  }
+
+  __cpuidex (Info, 7, 0);
+  return (Info[1] & BIT5) != 0;
+ #else
+  return __builtin_cpu_supports ("avx2") != 0;
+ #endif
+}
+
+#endif
+
+STATIC
+std::vector<CHECKSUM_KERNEL_INFO>
+HostKernels (
+  VOID
+  )
+{
+  std::vector<CHECKSUM_KERNEL_INFO>  Kernels;
+
+  Kernels.push_back ({ "Word loop", NULL });
+ #if defined (MDE_CPU_X64)
+  Kernels.push_back ({ "SSE2", InternalNetChecksumSse2 });
+  if (HostSupportsAvx2 ()) {
+    Kernels.push_back ({ "AVX2", InternalNetChecksumAvx2 });
+  }
+
+ #elif defined (MDE_CPU_AARCH64)
+  Kernels.push_back ({ "NEON", InternalNetChecksumNeon });
+ #endif
+
+  return Kernels;
+}
+
+//
+// Fill the buffer with the same pseudo-random bytes on every run.
+//
+STATIC
+VOID
+FillRandom (
+  IN OUT std::vector<UINT8>  &Buffer,
+  IN     UINT32              Seed
+  )
+{
+  for (UINTN Index = 0; Index < Buffer.size (); Index++) {
+    Seed          = Seed * 1103515245 + 12345;
+    Buffer[Index] = (UINT8)(Seed >> 16);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tests
+////////////////////////////////////////////////////////////////////////////////
+
+class NetChecksumTest : public ::testing::Test {
+protected:
+  std::vector<CHECKSUM_KERNEL_INFO> Kernels;
+
+  void
+  SetUp (
+    ) override
+  {
+    Kernels = HostKernels ();
+  }
+
+  void
+  ExpectAllKernels (
+    UINT8   *Bulk,
+    UINT32  Len
+    )
+  {
+    UINT16  Expected;
+
+    Expected = ReferenceChecksum (Bulk, Len);
+
+    for (auto &Info : Kernels) {
+      if ((Info.Kernel == NULL) && (Len > SIZE_64KB)) {
+        continue;
+      }
+
+      EXPECT_EQ (NetChecksumWithKernel (Info.Kernel, Bulk, Len), Expected)
+        << Info.Name << " Len " << Len << " Offset " << ((UINTN)Bulk & 0xF);
+    }
+  }
+};
+
+TEST_F (NetChecksumTest, KernelsShouldMatchTheWordLoopForAllLengthsAndAlignments) {
+  std::vector<UINT8>  Buffer (2048 + 16);
+
+  FillRandom (Buffer, 1);
+
+  for (UINT32 Offset = 0; Offset < 16; Offset++) {
+    for (UINT32 Len = 0; Len <= 2048; Len++) {
+      ExpectAllKernels (Buffer.data () + Offset, Len);
+    }
+  }
+}
+
+TEST_F (NetChecksumTest, KernelsShouldMatchTheWordLoopForLargeBuffers) {
+  static CONST UINT32  Lengths[] = { 1500, 9000, 65535, 65536, 0x80000 - 1, 0x80000 + 64, 3 * SIZE_1MB + 1 };
+  std::vector<UINT8>   Buffer (3 * SIZE_1MB + 64);
+
+  //
+  // The random data checks the byte order, the all-ones data the
+  // carries of the accumulators across the chunks of the kernels.
+  //
+  FillRandom (Buffer, 2);
+  for (UINT32 Len : Lengths) {
+    ExpectAllKernels (Buffer.data (), Len);
+    ExpectAllKernels (Buffer.data () + 1, Len);
+  }
+
+  std::fill (Buffer.begin (), Buffer.end (), 0xFF);
+  for (UINT32 Len : Lengths) {
+    ExpectAllKernels (Buffer.data (), Len);
+    ExpectAllKernels (Buffer.data () + 3, Len);
+  }
+}
+
+TEST_F (NetChecksumTest, NetblockChecksumShouldMatchTheWordLoop) {
+  std::vector<UINT8>  Buffer (SIZE_64KB + 16);
+
+  FillRandom (Buffer, 3);
+
+  for (UINT32 Len = 0; Len <= SIZE_64KB; Len += (Len < 512) ? 1 : 97) {
+    EXPECT_EQ (NetblockChecksum (Buffer.data () + (Len & 0xF), Len), ReferenceChecksum (Buffer.data () + (Len & 0xF), Len))
+      << "Len " << Len;
+  }
+}
+
+TEST_F (NetChecksumTest, Benchmark) {
+  static CONST UINT32  Sizes[] = { 64, 576, 1500, 4096, 9000, 65536 };
+  std::vector<UINT8>   Buffer (SIZE_64KB);
+  volatile UINT16      Sink;
+
+  FillRandom (Buffer, 4);
+
+  for (UINT32 Size : Sizes) {
+    UINTN  Iterations;
+
+    Iterations = (64 * SIZE_1MB) / Size;
+
+    printf ("%6u bytes:", Size);
+
+    for (INTN Index = -1; Index < (INTN)Kernels.size (); Index++) {
+      auto  Start = std::chrono::steady_clock::now ();
+ #if defined (MDE_CPU_X64)
+      UINT64  Tsc = __rdtsc ();
+ #endif
+
+      for (UINTN Round = 0; Round < Iterations; Round++) {
+        if (Index < 0) {
+          Sink = ReferenceChecksum (Buffer.data (), Size);
+        } else {
+          Sink = NetChecksumWithKernel (Kernels[Index].Kernel, Buffer.data (), Size);
+        }
+      }
+
+ #if defined (MDE_CPU_X64)
+      Tsc = __rdtsc () - Tsc;
+ #endif
+      double  Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now () - Start).count ();
+
+      printf (
+        "  %s %.0f MB/s",
+        (Index < 0) ? "Reference" : Kernels[Index].Name,
+        (double)Iterations * Size / Seconds / 1e6
+        );
+ #if defined (MDE_CPU_X64)
+      printf (" (%.2f B/cycle)", (double)Iterations * Size / (double)Tsc);
+ #endif
+    }
+
+    printf ("\n");
+  }
+
+  (VOID)Sink;
+}
@@ -1608,48 +1608,7 @@ NetbufQueFlush (
   NbufQue->BufSize = 0;
 }
 
-/**
-  Compute the checksum for a bulk of data.
-
-  @param[in]   Bulk                  Pointer to the data.
-  @param[in]   Len                   Length of the data, in bytes.
-
-  @return    The computed checksum.
-
-**/
-UINT16
-EFIAPI
-NetblockChecksum (
-  IN UINT8   *Bulk,
-  IN UINT32  Len
-  )
-{
-  register UINT32  Sum;
-
-  Sum = 0;
-
-  //
-  // Add left-over byte, if any
-  //
-  if (Len % 2 != 0) {
-    Sum += *(Bulk + Len - 1);
-  }
-
-  while (Len > 1) {
-    Sum  += *(UINT16 *)Bulk;
-    Bulk += 2;
-    Len  -= 2;
-  }
-
-  //
-  // Fold 32-bit sum to 16 bits
-  //
-  while ((Sum >> 16) != 0) {
-    Sum = (Sum & 0xffff) + (Sum >> 16);
-  }
-
-  return (UINT16)Sum;
-}
+// MU_CHANGE - Vectorized Internet checksum, NetblockChecksum moved to NetChecksum.c
 
 /**
   Add two checksums.
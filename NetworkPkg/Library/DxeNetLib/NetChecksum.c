@@ -0,0 +1,107 @@
+/** @file
+  Internet checksum of a bulk of data.
+
+  The data is summed by the fastest vector kernel the processor supports in
+  blocks of NET_CHECKSUM_BLOCK_LEN bytes, and by the word loop for the rest.
+  The kernel is selected on the first checksum of a buffer long enough.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "NetChecksum.h"
+
+STATIC NET_CHECKSUM_KERNEL  mNetChecksumKernel;
+STATIC BOOLEAN              mNetChecksumKernelSelected = FALSE;
+
+/**
+  Compute the checksum of a bulk of data with a vector kernel for the blocks
+  and the word loop for the rest.
+
+  @param[in]  Kernel   The vector kernel, or NULL for the word loop only.
+  @param[in]  Bulk     Pointer to the data.
+  @param[in]  Len      Length of the data, in bytes.
+
+  @return The computed checksum.
+
+**/
+UINT16
+NetChecksumWithKernel (
+  IN NET_CHECKSUM_KERNEL  Kernel,
+  IN UINT8                *Bulk,
+  IN UINT32               Len
+  )
+{
+  register UINT32  Sum;
+  UINT64           BlockSum;
+  UINT32           BlockLen;
+
+  Sum = 0;
+
+  if ((Kernel != NULL) && (Len >= NET_CHECKSUM_BLOCK_LEN)) {
+    BlockLen = Len & ~(UINT32)(NET_CHECKSUM_BLOCK_LEN - 1);
+    BlockSum = Kernel (Bulk, BlockLen);
+
+    //
+    // Fold the 64-bit sum to 16 bits. The blocks have an even
+    // length, so the rest of the data keeps its byte order.
+    //
+    while (RShiftU64 (BlockSum, 16) != 0) {
+      BlockSum = (BlockSum & 0xffff) + RShiftU64 (BlockSum, 16);
+    }
+
+    Sum   = (UINT32)BlockSum;
+    Bulk += BlockLen;
+    Len  -= BlockLen;
+  }
+
+  //
+  // Add left-over byte, if any
+  //
+  if (Len % 2 != 0) {
+    Sum += *(Bulk + Len - 1);
+  }
+
+  while (Len > 1) {
+    Sum  += *(UINT16 *)Bulk;
+    Bulk += 2;
+    Len  -= 2;
+  }
+
+  //
+  // Fold 32-bit sum to 16 bits
+  //
+  while ((Sum >> 16) != 0) {
+    Sum = (Sum & 0xffff) + (Sum >> 16);
+  }
+
+  return (UINT16)Sum;
+}
+
+/**
+  Compute the checksum for a bulk of data.
+
+  @param[in]   Bulk                  Pointer to the data.
+  @param[in]   Len                   Length of the data, in bytes.
+
+  @return    The computed checksum.
+
+**/
+UINT16
+EFIAPI
+NetblockChecksum (
+  IN UINT8   *Bulk,
+  IN UINT32  Len
+  )
+{
+  if (Len < NET_CHECKSUM_VECTOR_MIN_LEN) {
+    return NetChecksumWithKernel (NULL, Bulk, Len);
+  }
+
+  if (!mNetChecksumKernelSelected) {
+    mNetChecksumKernel         = NetChecksumSelectKernel ();
+    mNetChecksumKernelSelected = TRUE;
+  }
+
+  return NetChecksumWithKernel (mNetChecksumKernel, Bulk, Len);
+}
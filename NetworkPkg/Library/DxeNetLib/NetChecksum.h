@@ -0,0 +1,133 @@
+/** @file
+  Internal definitions of the vectorized Internet checksum.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef NET_CHECKSUM_H_
+#define NET_CHECKSUM_H_
+
+#include <Uefi.h>
+
+#include <Library/NetLib.h>
+#include <Library/BaseLib.h>
+
+//
+// The vector kernels sum blocks of this size.
+//
+#define NET_CHECKSUM_BLOCK_LEN  64
+
+//
+// Shorter data is summed by the word loop, the kernel call costs more
+// than it saves. It covers the pseudo headers and the bare ACKs.
+//
+#define NET_CHECKSUM_VECTOR_MIN_LEN  128
+
+/**
+  Sum the 16-bit words of the data with a vector kernel.
+
+  The words are read in the byte order of the processor, as the word loop of
+  NetblockChecksum reads them, and added in 64 bits without end-around carry.
+
+  @param[in]  Bulk     Pointer to the data, with any alignment.
+  @param[in]  Len      Length of the data, a non-zero multiple of
+                       NET_CHECKSUM_BLOCK_LEN.
+
+  @return The 64-bit sum of the words.
+
+**/
+typedef
+UINT64
+(EFIAPI *NET_CHECKSUM_KERNEL)(
+  IN CONST UINT8  *Bulk,
+  IN UINTN        Len
+  );
+
+/**
+  Select the fastest vector kernel supported by the processor.
+
+  @return The kernel, or NULL to use the word loop only.
+
+**/
+NET_CHECKSUM_KERNEL
+NetChecksumSelectKernel (
+  VOID
+  );
+
+/**
+  Compute the checksum of a bulk of data with a vector kernel for the blocks
+  and the word loop for the rest.
+
+  @param[in]  Kernel   The vector kernel, or NULL for the word loop only.
+  @param[in]  Bulk     Pointer to the data.
+  @param[in]  Len      Length of the data, in bytes.
+
+  @return The computed checksum.
+
+**/
+UINT16
+NetChecksumWithKernel (
+  IN NET_CHECKSUM_KERNEL  Kernel,
+  IN UINT8                *Bulk,
+  IN UINT32               Len
+  );
+
+#if defined (MDE_CPU_X64)
+
+/**
+  SSE2 kernel, see NET_CHECKSUM_KERNEL.
+
+  @param[in]  Bulk     Pointer to the data.
+  @param[in]  Len      Length of the data, a multiple of NET_CHECKSUM_BLOCK_LEN.
+
+  @return The 64-bit sum of the words.
+
+**/
+UINT64
+EFIAPI
+InternalNetChecksumSse2 (
+  IN CONST UINT8  *Bulk,
+  IN UINTN        Len
+  );
+
+/**
+  AVX2 kernel, see NET_CHECKSUM_KERNEL.
+
+  It must run with the interrupts disabled, as the interrupt handlers only
+  save the SSE state.
+
+  @param[in]  Bulk     Pointer to the data.
+  @param[in]  Len      Length of the data, a multiple of NET_CHECKSUM_BLOCK_LEN.
+
+  @return The 64-bit sum of the words.
+
+**/
+UINT64
+EFIAPI
+InternalNetChecksumAvx2 (
+  IN CONST UINT8  *Bulk,
+  IN UINTN        Len
+  );
+
+#elif defined (MDE_CPU_AARCH64)
+
+/**
+  Advanced SIMD kernel, see NET_CHECKSUM_KERNEL.
+
+  @param[in]  Bulk     Pointer to the data.
+  @param[in]  Len      Length of the data, a multiple of NET_CHECKSUM_BLOCK_LEN.
+
+  @return The 64-bit sum of the words.
+
+**/
+UINT64
+EFIAPI
+InternalNetChecksumNeon (
+  IN CONST UINT8  *Bulk,
+  IN UINTN        Len
+  );
+
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+/** @file
+  Kernel selection of the Internet checksum for the processors without a
+  vector kernel.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "NetChecksum.h"
+
+/**
+  Select the fastest vector kernel supported by the processor.
+
+  @return NULL, the word loop is used.
+
+**/
+NET_CHECKSUM_KERNEL
+NetChecksumSelectKernel (
+  VOID
+  )
+{
+  return NULL;
+}
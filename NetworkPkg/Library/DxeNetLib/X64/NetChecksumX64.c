@@ -0,0 +1,91 @@
+/** @file
+  Kernel selection of the Internet checksum for X64.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "../NetChecksum.h"
+
+#include <Register/Intel/Cpuid.h>
+
+//
+// The SSE and AVX states in XCR0, both must be enabled to use AVX2.
+//
+#define NET_CHECKSUM_XCR0_AVX  (BIT1 | BIT2)
+
+/**
+  AVX2 kernel with the interrupts disabled.
+
+  The interrupt handlers only save the SSE state with FXSAVE, so a checksum
+  computed in a timer callback would clobber the upper halves of the YMM
+  registers of an interrupted checksum.
+
+  @param[in]  Bulk     Pointer to the data.
+  @param[in]  Len      Length of the data, a multiple of NET_CHECKSUM_BLOCK_LEN.
+
+  @return The 64-bit sum of the words.
+
+**/
+STATIC
+UINT64
+EFIAPI
+NetChecksumAvx2 (
+  IN CONST UINT8  *Bulk,
+  IN UINTN        Len
+  )
+{
+  BOOLEAN  InterruptState;
+  UINT64   Sum;
+
+  InterruptState = SaveAndDisableInterrupts ();
+  Sum            = InternalNetChecksumAvx2 (Bulk, Len);
+  SetInterruptState (InterruptState);
+
+  return Sum;
+}
+
+/**
+  Select the fastest vector kernel supported by the processor.
+
+  @return The AVX2 kernel when the processor supports it and the AVX state is
+          enabled, the SSE2 kernel otherwise.
+
+**/
+NET_CHECKSUM_KERNEL
+NetChecksumSelectKernel (
+  VOID
+  )
+{
+  UINT32                                       MaxLeaf;
+  CPUID_VERSION_INFO_ECX                       VersionEcx;
+  CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS_EBX  ExtendedEbx;
+
+  AsmCpuid (CPUID_SIGNATURE, &MaxLeaf, NULL, NULL, NULL);
+  AsmCpuid (CPUID_VERSION_INFO, NULL, NULL, &VersionEcx.Uint32, NULL);
+
+  if ((MaxLeaf >= CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS) &&
+      (VersionEcx.Bits.OSXSAVE != 0) &&
+      (VersionEcx.Bits.AVX != 0))
+  {
+    AsmCpuidEx (
+      CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS,
+      CPUID_STRUCTURED_EXTENDED_FEATURE_FLAGS_SUB_LEAF_INFO,
+      NULL,
+      &ExtendedEbx.Uint32,
+      NULL,
+      NULL
+      );
+
+    if ((ExtendedEbx.Bits.AVX2 != 0) &&
+        ((AsmXGetBv (0) & NET_CHECKSUM_XCR0_AVX) == NET_CHECKSUM_XCR0_AVX))
+    {
+      return NetChecksumAvx2;
+    }
+  }
+
+  //
+  // SSE2 is architectural on X64.
+  //
+  return InternalNetChecksumSse2;
+}
@@ -15,6 +15,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/PcdLib.h> // MU_CHANGE - SACK and CUBIC congestion control
 
 /**
   The common notify function associated with various TcpIo events.
@@ -217,7 +218,7 @@ TcpIoCreateSocket (
   ControlOption.EnableNagle            = FALSE;
   ControlOption.EnableTimeStamp        = FALSE;
   ControlOption.EnableWindowScaling    = TRUE;
-  ControlOption.EnableSelectiveAck     = FALSE;
+  ControlOption.EnableSelectiveAck     = FeaturePcdGet (PcdTcpSelectiveAckEnable); // MU_CHANGE - SACK and CUBIC congestion control
   ControlOption.EnablePathMtuDiscovery = FALSE;
 
   if (TcpVersion == TCP_VERSION_4) {
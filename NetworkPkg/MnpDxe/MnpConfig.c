@@ -437,6 +437,11 @@ MnpInitializeDeviceData (
   //
   CopyMem (&MnpDeviceData->VlanConfig, &mVlanConfigProtocolTemplate, sizeof (EFI_VLAN_CONFIG_PROTOCOL));
 
+  // MU_CHANGE [BEGIN] - MNP batched receive
+  CopyMem (&MnpDeviceData->StatisticsProtocol, &mMnpStatisticsProtocolTemplate, sizeof (EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL));
+  MnpDeviceData->RxStatistics.RxBatchSize = MAX (PcdGet32 (PcdMnpReceiveBatchSize), 1);
+  // MU_CHANGE [END]
+
   //
   // Open the Simple Network protocol.
   //
@@ -458,6 +463,29 @@ MnpInitializeDeviceData (
   SnpMode            = Snp->Mode;
   MnpDeviceData->Snp = Snp;
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // The offloads transmit complete frames, so MNP builds the media header
+  // itself. Only use them on Ethernet.
+  //
+  Status = gBS->OpenProtocol (
+                  ControllerHandle,
+                  &gEdkiiNetworkOffloadProtocolGuid,
+                  (VOID **)&MnpDeviceData->NetworkOffload,
+                  ImageHandle,
+                  ControllerHandle,
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                  );
+  if (EFI_ERROR (Status) ||
+      (MnpDeviceData->NetworkOffload->Revision < EDKII_NETWORK_OFFLOAD_PROTOCOL_REVISION) ||
+      (SnpMode->IfType != NET_IFTYPE_ETHERNET) ||
+      (SnpMode->MediaHeaderSize != sizeof (ETHER_HEAD)))
+  {
+    MnpDeviceData->NetworkOffload = NULL;
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Initialize the lists.
   //
@@ -981,6 +1009,7 @@ MnpInitializeInstanceData (
   // Copy the MNP Protocol interfaces from the template.
   //
   CopyMem (&Instance->ManagedNetwork, &mMnpProtocolTemplate, sizeof (Instance->ManagedNetwork));
+  CopyMem (&Instance->ManagedNetworkOffload, &mMnpOffloadProtocolTemplate, sizeof (Instance->ManagedNetworkOffload)); // MU_CHANGE - Network offloads
 
   //
   // Copy the default config data.
@@ -1274,6 +1303,11 @@ MnpStart (
     }
 
     MnpDeviceData->EnableSystemPoll = EnableSystemPoll;
+
+    // MU_CHANGE [BEGIN] - MNP batched receive
+    MnpDeviceData->RxStatistics.PollInterval = EnableSystemPoll ? MNP_SYS_POLL_INTERVAL : 0;
+    MnpDeviceData->IdlePollCount             = 0;
+    // MU_CHANGE [END]
   }
 
   //
@@ -1331,8 +1365,9 @@ MnpStop (
     //
     //  The system poll in on, cancel the poll timer.
     //
-    Status                          = gBS->SetTimer (MnpDeviceData->PollTimer, TimerCancel, 0);
-    MnpDeviceData->EnableSystemPoll = FALSE;
+    Status                                   = gBS->SetTimer (MnpDeviceData->PollTimer, TimerCancel, 0);
+    MnpDeviceData->EnableSystemPoll          = FALSE;
+    MnpDeviceData->RxStatistics.PollInterval = 0; // MU_CHANGE - MNP batched receive
   }
 
   //
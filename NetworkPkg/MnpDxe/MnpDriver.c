@@ -176,6 +176,24 @@ MnpDriverBindingStart (
     return Status;
   }
 
+  // MU_CHANGE [BEGIN] - MNP batched receive
+  //
+  // Install the Managed Network Statistics Protocol. The receive path does not
+  // depend on it, so the driver still starts if it can't be installed.
+  //
+  Status = gBS->InstallMultipleProtocolInterfaces (
+                  &ControllerHandle,
+                  &gEdkiiManagedNetworkStatisticsProtocolGuid,
+                  &MnpDeviceData->StatisticsProtocol,
+                  NULL
+                  );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "MnpDriverBindingStart: Install statistics protocol failed, %r.\n", Status));
+    ZeroMem (&MnpDeviceData->StatisticsProtocol, sizeof (EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL));
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Check whether NIC driver has already produced VlanConfig protocol
   //
@@ -272,6 +290,18 @@ Exit:
              );
     }
 
+    // MU_CHANGE [BEGIN] - MNP batched receive
+    if (MnpDeviceData->StatisticsProtocol.GetStatistics != NULL) {
+      gBS->UninstallMultipleProtocolInterfaces (
+             MnpDeviceData->ControllerHandle,
+             &gEdkiiManagedNetworkStatisticsProtocolGuid,
+             &MnpDeviceData->StatisticsProtocol,
+             NULL
+             );
+    }
+
+    // MU_CHANGE [END]
+
     //
     // Destroy Mnp Device Data
     //
@@ -378,6 +408,18 @@ MnpDriverBindingStop (
              );
     }
 
+    // MU_CHANGE [BEGIN] - MNP batched receive
+    if (MnpDeviceData->StatisticsProtocol.GetStatistics != NULL) {
+      gBS->UninstallMultipleProtocolInterfaces (
+             MnpDeviceData->ControllerHandle,
+             &gEdkiiManagedNetworkStatisticsProtocolGuid,
+             &MnpDeviceData->StatisticsProtocol,
+             NULL
+             );
+    }
+
+    // MU_CHANGE [END]
+
     //
     // Destroy Mnp Device Data
     //
@@ -463,6 +505,8 @@ MnpServiceBindingCreateChild (
                   ChildHandle,
                   &gEfiManagedNetworkProtocolGuid,
                   &Instance->ManagedNetwork,
+                  &gEdkiiManagedNetworkOffloadProtocolGuid, // MU_CHANGE - Network offloads
+                  &Instance->ManagedNetworkOffload,         // MU_CHANGE - Network offloads
                   NULL
                   );
   if (EFI_ERROR (Status)) {
@@ -510,6 +554,8 @@ ErrorExit:
              Instance->Handle,
              &gEfiManagedNetworkProtocolGuid,
              &Instance->ManagedNetwork,
+             &gEdkiiManagedNetworkOffloadProtocolGuid,  // MU_CHANGE - Network offloads
+             &Instance->ManagedNetworkOffload,          // MU_CHANGE - Network offloads
              NULL
              );
     }
@@ -606,6 +652,8 @@ MnpServiceBindingDestroyChild (
                   ChildHandle,
                   &gEfiManagedNetworkProtocolGuid,
                   &Instance->ManagedNetwork,
+                  &gEdkiiManagedNetworkOffloadProtocolGuid, // MU_CHANGE - Network offloads
+                  &Instance->ManagedNetworkOffload,         // MU_CHANGE - Network offloads
                   NULL
                   );
   if (EFI_ERROR (Status)) {
@@ -15,6 +15,8 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Protocol/SimpleNetwork.h>
 #include <Protocol/ServiceBinding.h>
 #include <Protocol/VlanConfig.h>
+#include <Protocol/ManagedNetworkOffload.h> // MU_CHANGE - Network offloads
+#include <Protocol/ManagedNetworkStatistics.h> // MU_CHANGE - MNP batched receive
 
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
@@ -27,6 +29,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/DevicePathLib.h>
 #include <Library/PrintLib.h>
+#include <Library/PcdLib.h> // MU_CHANGE - MNP batched receive
 
 #include "ComponentName.h"
 
@@ -38,53 +41,68 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 extern  EFI_DRIVER_BINDING_PROTOCOL  gMnpDriverBinding;
 
 typedef struct {
-  UINT32                         Signature;
+  UINT32                                       Signature;
 
-  EFI_HANDLE                     ControllerHandle;
-  EFI_HANDLE                     ImageHandle;
+  EFI_HANDLE                                   ControllerHandle;
+  EFI_HANDLE                                   ImageHandle;
 
-  EFI_VLAN_CONFIG_PROTOCOL       VlanConfig;
-  UINTN                          NumberOfVlan;
-  CHAR16                         *MacString;
-  EFI_SIMPLE_NETWORK_PROTOCOL    *Snp;
+  EFI_VLAN_CONFIG_PROTOCOL                     VlanConfig;
+  UINTN                                        NumberOfVlan;
+  CHAR16                                       *MacString;
+  EFI_SIMPLE_NETWORK_PROTOCOL                  *Snp;
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // The offloads of the interface, NULL if it has none.
+  //
+  EDKII_NETWORK_OFFLOAD_PROTOCOL               *NetworkOffload;
+  // MU_CHANGE [END]
 
   //
   // List of MNP_SERVICE_DATA
   //
-  LIST_ENTRY                     ServiceList;
+  LIST_ENTRY                                   ServiceList;
   //
   // Number of configured MNP Service Binding child
   //
-  UINTN                          ConfiguredChildrenNumber;
+  UINTN                                        ConfiguredChildrenNumber;
 
-  LIST_ENTRY                     GroupAddressList;
-  UINT32                         GroupAddressCount;
+  LIST_ENTRY                                   GroupAddressList;
+  UINT32                                       GroupAddressCount;
 
-  LIST_ENTRY                     FreeTxBufList;
-  LIST_ENTRY                     AllTxBufList;
-  UINT32                         TxBufCount;
+  LIST_ENTRY                                   FreeTxBufList;
+  LIST_ENTRY                                   AllTxBufList;
+  UINT32                                       TxBufCount;
 
-  NET_BUF_QUEUE                  FreeNbufQue;
-  INTN                           NbufCnt;
+  NET_BUF_QUEUE                                FreeNbufQue;
+  INTN                                         NbufCnt;
 
-  EFI_EVENT                      PollTimer;
-  BOOLEAN                        EnableSystemPoll;
+  EFI_EVENT                                    PollTimer;
+  BOOLEAN                                      EnableSystemPoll;
 
-  EFI_EVENT                      TimeoutCheckTimer;
-  EFI_EVENT                      MediaDetectTimer;
+  EFI_EVENT                                    TimeoutCheckTimer;
+  EFI_EVENT                                    MediaDetectTimer;
 
-  UINT32                         UnicastCount;
-  UINT32                         BroadcastCount;
-  UINT32                         MulticastCount;
-  UINT32                         PromiscuousCount;
+  UINT32                                       UnicastCount;
+  UINT32                                       BroadcastCount;
+  UINT32                                       MulticastCount;
+  UINT32                                       PromiscuousCount;
 
   //
   // The size of the data buffer in the MNP_PACKET_BUFFER used to
   // store a packet.
   //
-  UINT32                         BufferLength;
-  UINT32                         PaddingSize;
-  NET_BUF                        *RxNbufCache;
+  UINT32                                       BufferLength;
+  UINT32                                       PaddingSize;
+  NET_BUF                                      *RxNbufCache;
+
+  // MU_CHANGE [BEGIN] - MNP batched receive
+  EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL    StatisticsProtocol;
+  EDKII_MANAGED_NETWORK_STATISTICS             RxStatistics;
+  //
+  // Number of system polls in a row that received no frame.
+  //
+  UINT32                                       IdlePollCount;
+  // MU_CHANGE [END]
 } MNP_DEVICE_DATA;
 
 #define MNP_DEVICE_DATA_FROM_THIS(a) \
@@ -95,6 +113,16 @@ typedef struct {
   MNP_DEVICE_DATA_SIGNATURE \
   )
 
+// MU_CHANGE [BEGIN] - MNP batched receive
+#define MNP_DEVICE_DATA_FROM_STATISTICS(a) \
+  CR ( \
+  (a), \
+  MNP_DEVICE_DATA, \
+  StatisticsProtocol, \
+  MNP_DEVICE_DATA_SIGNATURE \
+  )
+// MU_CHANGE [END]
+
 #define MNP_SERVICE_DATA_SIGNATURE  SIGNATURE_32 ('M', 'n', 'p', 'S')
 
 typedef struct {
@@ -25,6 +25,16 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #define MNP_MAX_RCVD_PACKET_QUE_SIZE  256
 
+// MU_CHANGE [BEGIN] - MNP batched receive
+//
+// The system poll period is halved down to MNP_SYS_POLL_MIN_INTERVAL after each
+// full batch, and doubled back up to MNP_SYS_POLL_INTERVAL after
+// MNP_SYS_POLL_IDLE_LIMIT polls in a row without any frame.
+//
+#define MNP_SYS_POLL_MIN_INTERVAL  (1 * TICKS_PER_MS)     // 1 millisecond
+#define MNP_SYS_POLL_IDLE_LIMIT    8
+// MU_CHANGE [END]
+
 #define MNP_RECEIVE_UNICAST    0x01
 #define MNP_RECEIVE_BROADCAST  0x02
 
@@ -41,31 +51,42 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
   MNP_INSTANCE_DATA_SIGNATURE \
   )
 
+// MU_CHANGE [BEGIN] - Network offloads
+#define MNP_INSTANCE_DATA_FROM_OFFLOAD(a) \
+  CR ( \
+  (a), \
+  MNP_INSTANCE_DATA, \
+  ManagedNetworkOffload, \
+  MNP_INSTANCE_DATA_SIGNATURE \
+  )
+// MU_CHANGE [END]
+
 typedef struct {
-  UINT32                             Signature;
+  UINT32                                    Signature;
 
-  MNP_SERVICE_DATA                   *MnpServiceData;
+  MNP_SERVICE_DATA                          *MnpServiceData;
 
-  EFI_HANDLE                         Handle;
+  EFI_HANDLE                                Handle;
 
-  LIST_ENTRY                         InstEntry;
+  LIST_ENTRY                                InstEntry;
 
-  EFI_MANAGED_NETWORK_PROTOCOL       ManagedNetwork;
+  EFI_MANAGED_NETWORK_PROTOCOL              ManagedNetwork;
+  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL    ManagedNetworkOffload; // MU_CHANGE - Network offloads
 
-  BOOLEAN                            Configured;
-  BOOLEAN                            Destroyed;
+  BOOLEAN                                   Configured;
+  BOOLEAN                                   Destroyed;
 
-  LIST_ENTRY                         GroupCtrlBlkList;
+  LIST_ENTRY                                GroupCtrlBlkList;
 
-  NET_MAP                            RxTokenMap;
+  NET_MAP                                   RxTokenMap;
 
-  LIST_ENTRY                         RxDeliveredPacketQueue;
-  LIST_ENTRY                         RcvdPacketQueue;
-  UINTN                              RcvdPacketQueueSize;
+  LIST_ENTRY                                RxDeliveredPacketQueue;
+  LIST_ENTRY                                RcvdPacketQueue;
+  UINTN                                     RcvdPacketQueueSize;
 
-  EFI_MANAGED_NETWORK_CONFIG_DATA    ConfigData;
+  EFI_MANAGED_NETWORK_CONFIG_DATA           ConfigData;
 
-  UINT8                              ReceiveFilter;
+  UINT8                                     ReceiveFilter;
 } MNP_INSTANCE_DATA;
 
 typedef struct {
@@ -85,6 +106,7 @@ typedef struct {
   EFI_MANAGED_NETWORK_RECEIVE_DATA    RxData;
   NET_BUF                             *Nbuf;
   UINT64                              TimeoutTick;
+  UINT32                              OffloadFlags; // MU_CHANGE - Network offloads
 } MNP_RXDATA_WRAP;
 
 #define MNP_TX_BUF_WRAP_SIGNATURE  SIGNATURE_32 ('M', 'T', 'B', 'W')
@@ -326,6 +348,8 @@ MnpGroupOp (
 
   @param[in]  Instance            Pointer to the Mnp instance context data.
   @param[in]  Token               Pointer to the transmit token to check.
+  @param[in]  MaxDataLength       The largest DataLength allowed, the MTU unless
+                                  the TCP segmentation is offloaded.
 
   @return The Token is valid or not.
 
@@ -333,7 +357,8 @@ MnpGroupOp (
 BOOLEAN
 MnpIsValidTxToken (
   IN MNP_INSTANCE_DATA                     *Instance,
-  IN EFI_MANAGED_NETWORK_COMPLETION_TOKEN  *Token
+  IN EFI_MANAGED_NETWORK_COMPLETION_TOKEN  *Token,
+  IN UINT32                                MaxDataLength      // MU_CHANGE - Network offloads
   );
 
 /**
@@ -430,6 +455,28 @@ MnpReceivePacket (
   IN OUT MNP_DEVICE_DATA  *MnpDeviceData
   );
 
+// MU_CHANGE [BEGIN] - MNP batched receive
+
+/**
+  Receive and deliver the packets waiting in the interface, up to the batch
+  size of the device.
+
+  @param[in, out]  MnpDeviceData        Pointer to the mnp device context data.
+  @param[out]      Received             Number of packets received.
+
+  @retval EFI_SUCCESS           At least one packet was received.
+  @retval Others                As returned by MnpReceivePacket() for the
+                                first packet.
+
+**/
+EFI_STATUS
+MnpReceivePacketBatch (
+  IN OUT MNP_DEVICE_DATA  *MnpDeviceData,
+  OUT UINT32              *Received
+  );
+
+// MU_CHANGE [END]
+
 /**
   Allocate a free NET_BUF from MnpDeviceData->FreeNbufQue. If there is none
   in the queue, first try to allocate some and add them into the queue, then
@@ -475,6 +522,23 @@ MnpAllocTxBuf (
   IN OUT MNP_DEVICE_DATA  *MnpDeviceData
   );
 
+// MU_CHANGE [BEGIN] - Network offloads
+
+/**
+  Try to reclaim the TX buffer into the buffer pool.
+
+  @param[in, out]  MnpDeviceData         Pointer to the mnp device context data.
+  @param[in, out]  TxBuf                 Pointer to the TX buffer to free.
+
+**/
+VOID
+MnpFreeTxBuf (
+  IN OUT MNP_DEVICE_DATA  *MnpDeviceData,
+  IN OUT UINT8            *TxBuf
+  );
+
+// MU_CHANGE [END]
+
 /**
   Try to recycle all the transmitted buffer address from SNP.
 
@@ -895,4 +959,97 @@ MnpConfigReceiveFilters (
   IN MNP_DEVICE_DATA  *MnpDeviceData
   );
 
+// MU_CHANGE [BEGIN] - Network offloads
+extern EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  mMnpOffloadProtocolTemplate;
+
+/**
+  Get the offloads available to the child.
+
+  @param[in]   This               Pointer to the EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[out]  Capabilities       The EDKII_NETWORK_OFFLOAD_* flags supported.
+  @param[out]  MaxLargeSendSize   Largest DataLength of a large send.
+
+  @retval EFI_SUCCESS            The capabilities are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+MnpOffloadGetCapabilities (
+  IN  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *This,
+  OUT UINT32                                  *Capabilities,
+  OUT UINT32                                  *MaxLargeSendSize
+  );
+
+/**
+  Place an outgoing packet with offloads into the transmit queue.
+
+  @param[in]  This     Pointer to the EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in]  Token    Pointer to a token associated with the transmit data
+                       descriptor.
+  @param[in]  TxInfo   The offloads to apply.
+
+  @retval EFI_SUCCESS            The transmit completion token was cached.
+  @retval EFI_NOT_STARTED        This MNP child driver instance has not been
+                                 configured.
+  @retval EFI_INVALID_PARAMETER  A parameter is invalid.
+  @retval EFI_UNSUPPORTED        An offload is not supported by the interface.
+  @retval EFI_OUT_OF_RESOURCES   The transmit data could not be queued due to a
+                                 lack of system resources.
+
+**/
+EFI_STATUS
+EFIAPI
+MnpOffloadTransmit (
+  IN EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *This,
+  IN EFI_MANAGED_NETWORK_COMPLETION_TOKEN    *Token,
+  IN CONST EDKII_NETWORK_OFFLOAD_TX_INFO     *TxInfo
+  );
+
+/**
+  Get the checksums verified by the interface for a received packet.
+
+  @param[in]   This      Pointer to the EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in]   RxData    The receive data delivered to this instance.
+  @param[out]  Flags     The EDKII_NETWORK_OFFLOAD_RX_* flags.
+
+  @retval EFI_SUCCESS            The flags are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL, or RxData was not
+                                 delivered to this instance.
+
+**/
+EFI_STATUS
+EFIAPI
+MnpOffloadGetReceiveFlags (
+  IN  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *This,
+  IN  EFI_MANAGED_NETWORK_RECEIVE_DATA        *RxData,
+  OUT UINT32                                  *Flags
+  );
+
+// MU_CHANGE [END]
+
+// MU_CHANGE [BEGIN] - MNP batched receive
+extern EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL  mMnpStatisticsProtocolTemplate;
+
+/**
+  Get the receive counters of the interface.
+
+  @param[in]   This         Pointer to the EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL instance.
+  @param[in]   Reset        TRUE to reset the counters after they are read.
+  @param[out]  Statistics   The counters.
+
+  @retval EFI_SUCCESS            The counters are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+MnpGetStatistics (
+  IN  EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL  *This,
+  IN  BOOLEAN                                    Reset,
+  OUT EDKII_MANAGED_NETWORK_STATISTICS           *Statistics
+  );
+
+// MU_CHANGE [END]
+
 #endif
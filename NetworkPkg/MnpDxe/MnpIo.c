@@ -14,6 +14,8 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
   @param[in]  Instance            Pointer to the Mnp instance context data.
   @param[in]  Token               Pointer to the transmit token to check.
+  @param[in]  MaxDataLength       The largest DataLength allowed, the MTU unless
+                                  the TCP segmentation is offloaded.
 
   @return The Token is valid or not.
 
@@ -21,7 +23,8 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 BOOLEAN
 MnpIsValidTxToken (
   IN MNP_INSTANCE_DATA                     *Instance,
-  IN EFI_MANAGED_NETWORK_COMPLETION_TOKEN  *Token
+  IN EFI_MANAGED_NETWORK_COMPLETION_TOKEN  *Token,
+  IN UINT32                                MaxDataLength      // MU_CHANGE - Network offloads
   )
 {
   MNP_SERVICE_DATA                   *MnpServiceData;
@@ -83,7 +86,7 @@ MnpIsValidTxToken (
     return FALSE;
   }
 
-  if (TxData->DataLength > MnpServiceData->Mtu) {
+  if (TxData->DataLength > MaxDataLength) { // MU_CHANGE - Network offloads
     //
     // The total length is larger than the MTU.
     //
@@ -496,6 +499,7 @@ MnpQueueRcvdPacket (
     //
     MnpRecycleRxData (NULL, (VOID *)OldRxDataWrap);
     Instance->RcvdPacketQueueSize--;
+    Instance->MnpServiceData->MnpDeviceData->RxStatistics.RxDroppedQueueFull++; // MU_CHANGE - MNP batched receive
   }
 
   //
@@ -754,12 +758,14 @@ MnpWrapRxData (
   @param[in]  MnpServiceData    Pointer to the mnp service context data.
   @param[in]  Nbuf              Pointer to the net buffer representing the received
                                 packet.
+  @param[in]  OffloadFlags      The EDKII_NETWORK_OFFLOAD_RX_* flags of the packet.
 
 **/
 VOID
 MnpEnqueuePacket (
   IN MNP_SERVICE_DATA  *MnpServiceData,
-  IN NET_BUF           *Nbuf
+  IN NET_BUF           *Nbuf,
+  IN UINT32            OffloadFlags   // MU_CHANGE - Network offloads
   )
 {
   LIST_ENTRY                        *Entry;
@@ -805,6 +811,8 @@ MnpEnqueuePacket (
         continue;
       }
 
+      RxDataWrap->OffloadFlags = OffloadFlags; // MU_CHANGE - Network offloads
+
       //
       // Associate RxDataWrap with Nbuf and increase the RefCnt.
       //
@@ -845,6 +853,7 @@ MnpReceivePacket (
   MNP_SERVICE_DATA             *MnpServiceData;
   UINT16                       VlanId;
   BOOLEAN                      IsVlanPacket;
+  UINT32                       OffloadFlags; // MU_CHANGE - Network offloads
 
   NET_CHECK_SIGNATURE (MnpDeviceData, MNP_DEVICE_DATA_SIGNATURE);
 
@@ -887,10 +896,25 @@ MnpReceivePacket (
 
   // MU_CHANGE End - CodeQL Change - unguardednullreturndereference
 
+  // MU_CHANGE [BEGIN] - Network offloads
   //
-  // Receive packet through Snp.
+  // Receive packet through Snp, or through the offload protocol of the
+  // interface to get the checksums it verified.
   //
-  Status = Snp->Receive (Snp, &HeaderSize, &BufLen, BufPtr, NULL, NULL, NULL);
+  OffloadFlags = 0;
+  if ((MnpDeviceData->NetworkOffload != NULL) && (MnpDeviceData->NetworkOffload->Receive != NULL)) {
+    HeaderSize = Snp->Mode->MediaHeaderSize;
+    Status     = MnpDeviceData->NetworkOffload->Receive (
+                                                  MnpDeviceData->NetworkOffload,
+                                                  &BufLen,
+                                                  BufPtr,
+                                                  &OffloadFlags
+                                                  );
+  } else {
+    Status = Snp->Receive (Snp, &HeaderSize, &BufLen, BufPtr, NULL, NULL, NULL);
+  }
+
+  // MU_CHANGE [END]
   if (EFI_ERROR (Status)) {
     DEBUG_CODE_BEGIN ();
     if (Status != EFI_NOT_READY) {
@@ -953,7 +977,7 @@ MnpReceivePacket (
   //
   // Enqueue the packet to the matched instances.
   //
-  MnpEnqueuePacket (MnpServiceData, Nbuf);
+  MnpEnqueuePacket (MnpServiceData, Nbuf, OffloadFlags); // MU_CHANGE - Network offloads
 
   if (Nbuf->RefCnt > 2) {
     //
@@ -997,6 +1021,136 @@ EXIT:
   return Status;
 }
 
+// MU_CHANGE [BEGIN] - MNP batched receive
+
+/**
+  Receive and deliver the packets waiting in the interface, up to the batch
+  size of the device.
+
+  The DPCs queued by the receivers are dispatched after each packet, so the
+  receive tokens they recycle are available for the next packet of the batch.
+  The packets are received into the NET_BUFs pre-allocated in FreeNbufQue.
+
+  @param[in, out]  MnpDeviceData        Pointer to the mnp device context data.
+  @param[out]      Received             Number of packets received.
+
+  @retval EFI_SUCCESS           At least one packet was received.
+  @retval Others                As returned by MnpReceivePacket() for the
+                                first packet.
+
+**/
+EFI_STATUS
+MnpReceivePacketBatch (
+  IN OUT MNP_DEVICE_DATA  *MnpDeviceData,
+  OUT UINT32              *Received
+  )
+{
+  EFI_STATUS                        Status;
+  EDKII_MANAGED_NETWORK_STATISTICS  *Statistics;
+
+  NET_CHECK_SIGNATURE (MnpDeviceData, MNP_DEVICE_DATA_SIGNATURE);
+
+  Statistics = &MnpDeviceData->RxStatistics;
+  *Received  = 0;
+
+  do {
+    Status = MnpReceivePacket (MnpDeviceData);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    (*Received)++;
+
+    //
+    // Dispatch the DPC queued by the NotifyFunction of rx token's events.
+    //
+    DispatchDpc ();
+  } while (*Received < Statistics->RxBatchSize);
+
+  if ((Status != EFI_NOT_READY) && (Status != EFI_NOT_STARTED) && EFI_ERROR (Status)) {
+    if (MnpDeviceData->RxNbufCache == NULL) {
+      Statistics->RxNoBuffer++;
+    } else {
+      Statistics->RxErrors++;
+    }
+  }
+
+  if (*Received == 0) {
+    return Status;
+  }
+
+  Statistics->RxFrames += *Received;
+  Statistics->RxBatches++;
+  if (*Received == Statistics->RxBatchSize) {
+    Statistics->RxFullBatches++;
+  }
+
+  if (*Received > Statistics->RxLargestBatch) {
+    Statistics->RxLargestBatch = *Received;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Adapt the period of the system poll timer to the receive load.
+
+  A full batch may have left packets in the interface, so the period is
+  halved. It is doubled back after several polls in a row without any packet.
+  The period does not change when a poll receives one packet at most.
+
+  @param[in, out]  MnpDeviceData        Pointer to the mnp device context data.
+  @param[in]       Received             Number of packets received by the poll.
+
+**/
+STATIC
+VOID
+MnpAdjustPollInterval (
+  IN OUT MNP_DEVICE_DATA  *MnpDeviceData,
+  IN     UINT32           Received
+  )
+{
+  EDKII_MANAGED_NETWORK_STATISTICS  *Statistics;
+  UINT64                            Interval;
+  EFI_STATUS                        Status;
+
+  Statistics = &MnpDeviceData->RxStatistics;
+  if ((Statistics->RxBatchSize <= 1) || (Statistics->PollInterval == 0)) {
+    return;
+  }
+
+  Interval = Statistics->PollInterval;
+  if (Received == Statistics->RxBatchSize) {
+    MnpDeviceData->IdlePollCount = 0;
+    Interval                     = MAX (Interval / 2, MNP_SYS_POLL_MIN_INTERVAL);
+  } else if (Received == 0) {
+    MnpDeviceData->IdlePollCount++;
+    if (MnpDeviceData->IdlePollCount < MNP_SYS_POLL_IDLE_LIMIT) {
+      return;
+    }
+
+    MnpDeviceData->IdlePollCount = 0;
+    Interval                     = MIN (Interval * 2, MNP_SYS_POLL_INTERVAL);
+  } else {
+    MnpDeviceData->IdlePollCount = 0;
+    return;
+  }
+
+  if (Interval == Statistics->PollInterval) {
+    return;
+  }
+
+  Status = gBS->SetTimer (MnpDeviceData->PollTimer, TimerPeriodic, Interval);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "MnpAdjustPollInterval: gBS->SetTimer for PollTimer failed, %r.\n", Status));
+    return;
+  }
+
+  Statistics->PollInterval = Interval;
+}
+
+// MU_CHANGE [END]
+
 /**
   Remove the received packets if timeout occurs.
 
@@ -1056,6 +1210,7 @@ MnpCheckPacketTimeout (
           DEBUG ((DEBUG_WARN, "MnpCheckPacketTimeout: Received packet timeout.\n"));
           MnpRecycleRxData (NULL, RxDataWrap);
           Instance->RcvdPacketQueueSize--;
+          MnpDeviceData->RxStatistics.RxDroppedTimeout++; // MU_CHANGE - MNP batched receive
         }
       }
 
@@ -1111,14 +1266,18 @@ MnpSystemPoll (
   )
 {
   MNP_DEVICE_DATA  *MnpDeviceData;
+  UINT32           Received; // MU_CHANGE - MNP batched receive
 
   MnpDeviceData = (MNP_DEVICE_DATA *)Context;
   NET_CHECK_SIGNATURE (MnpDeviceData, MNP_DEVICE_DATA_SIGNATURE);
 
+  // MU_CHANGE [BEGIN] - MNP batched receive
   //
-  // Try to receive packets from Snp.
+  // Try to receive a batch of packets from Snp.
   //
-  MnpReceivePacket (MnpDeviceData);
+  MnpReceivePacketBatch (MnpDeviceData, &Received);
+  MnpAdjustPollInterval (MnpDeviceData, Received);
+  // MU_CHANGE [END]
 
   //
   // Dispatch the DPC queued by the NotifyFunction of rx token's events.
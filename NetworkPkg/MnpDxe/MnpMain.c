@@ -8,6 +8,13 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include "MnpImpl.h"
 
+// MU_CHANGE [BEGIN] - MNP batched receive
+EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL  mMnpStatisticsProtocolTemplate = {
+  EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL_REVISION,
+  MnpGetStatistics
+};
+// MU_CHANGE [END]
+
 /**
   Returns the operational parameters for the current MNP child driver. May also
   support returning the underlying SNP driver mode data.
@@ -532,7 +539,7 @@ MnpTransmit (
     goto ON_EXIT;
   }
 
-  if (!MnpIsValidTxToken (Instance, Token)) {
+  if (!MnpIsValidTxToken (Instance, Token, Instance->MnpServiceData->Mtu)) { // MU_CHANGE - Network offloads
     //
     // The Token is invalid.
     //
@@ -758,6 +765,7 @@ MnpPoll (
   EFI_STATUS         Status;
   MNP_INSTANCE_DATA  *Instance;
   EFI_TPL            OldTpl;
+  UINT32             Received; // MU_CHANGE - MNP batched receive
 
   if (This == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -775,7 +783,7 @@ MnpPoll (
   //
   // Try to receive packets.
   //
-  Status = MnpReceivePacket (Instance->MnpServiceData->MnpDeviceData);
+  Status = MnpReceivePacketBatch (Instance->MnpServiceData->MnpDeviceData, &Received); // MU_CHANGE - MNP batched receive
 
   //
   // Dispatch the DPC queued by the NotifyFunction of rx token's events.
@@ -787,3 +795,58 @@ ON_EXIT:
 
   return Status;
 }
+
+// MU_CHANGE [BEGIN] - MNP batched receive
+
+/**
+  Get the receive counters of the interface.
+
+  @param[in]   This         Pointer to the EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL instance.
+  @param[in]   Reset        TRUE to reset the counters after they are read.
+  @param[out]  Statistics   The counters.
+
+  @retval EFI_SUCCESS            The counters are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+MnpGetStatistics (
+  IN  EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL  *This,
+  IN  BOOLEAN                                    Reset,
+  OUT EDKII_MANAGED_NETWORK_STATISTICS           *Statistics
+  )
+{
+  MNP_DEVICE_DATA  *MnpDeviceData;
+  EFI_TPL          OldTpl;
+
+  if ((This == NULL) || (Statistics == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  MnpDeviceData = MNP_DEVICE_DATA_FROM_STATISTICS (This);
+
+  //
+  // The counters are updated by the poll timer at TPL_CALLBACK.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  CopyMem (Statistics, &MnpDeviceData->RxStatistics, sizeof (EDKII_MANAGED_NETWORK_STATISTICS));
+
+  if (Reset) {
+    MnpDeviceData->RxStatistics.RxFrames           = 0;
+    MnpDeviceData->RxStatistics.RxBatches          = 0;
+    MnpDeviceData->RxStatistics.RxFullBatches      = 0;
+    MnpDeviceData->RxStatistics.RxLargestBatch     = 0;
+    MnpDeviceData->RxStatistics.RxDroppedQueueFull = 0;
+    MnpDeviceData->RxStatistics.RxDroppedTimeout   = 0;
+    MnpDeviceData->RxStatistics.RxNoBuffer         = 0;
+    MnpDeviceData->RxStatistics.RxErrors           = 0;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+// MU_CHANGE [END]
@@ -0,0 +1,342 @@
+/** @file
+  Implementation of the Managed Network Offload Protocol.
+
+  The offloads of the interface are passed through to the MNP children. A
+  frame with offloads is sent through EDKII_NETWORK_OFFLOAD_PROTOCOL instead of
+  the Simple Network Protocol, with the media header built by MNP. A large send
+  does not fit in the buffers of the transmit pool, so it is copied into a
+  buffer allocated for it, which the synchronous transmit of the interface
+  releases right away.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "MnpImpl.h"
+#include "MnpVlan.h"
+
+EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  mMnpOffloadProtocolTemplate = {
+  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL_REVISION,
+  MnpOffloadGetCapabilities,
+  MnpOffloadTransmit,
+  MnpOffloadGetReceiveFlags
+};
+
+/**
+  Get the largest DataLength of a large send through the service.
+
+  @param[in]  MnpServiceData      Pointer to the mnp service context data.
+
+  @return The largest DataLength, zero if the interface does not segment TCP
+          sends larger than the MTU.
+
+**/
+STATIC
+UINT32
+MnpOffloadMaxLargeSendSize (
+  IN MNP_SERVICE_DATA  *MnpServiceData
+  )
+{
+  EDKII_NETWORK_OFFLOAD_PROTOCOL  *NetworkOffload;
+  UINT32                          Overhead;
+
+  NetworkOffload = MnpServiceData->MnpDeviceData->NetworkOffload;
+  if ((NetworkOffload == NULL) || ((NetworkOffload->Capabilities & EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND) == 0)) {
+    return 0;
+  }
+
+  Overhead = sizeof (ETHER_HEAD);
+  if (MnpServiceData->VlanId != 0) {
+    Overhead += NET_VLAN_TAG_LEN;
+  }
+
+  if (NetworkOffload->MaxLargeSendSize <= Overhead + MnpServiceData->Mtu) {
+    return 0;
+  }
+
+  return NetworkOffload->MaxLargeSendSize - Overhead;
+}
+
+/**
+  Build the frame of a transmit token and send it with offloads.
+
+  @param[in]       MnpServiceData      Pointer to the mnp service context data.
+  @param[in]       TxInfo              The offloads, with the offsets counted
+                                       from the first byte of the fragments.
+  @param[in, out]  Token               Pointer to the transmit token.
+
+  @retval EFI_SUCCESS                  The token is completed.
+  @retval EFI_OUT_OF_RESOURCES         No buffer is available for the frame.
+
+**/
+STATIC
+EFI_STATUS
+MnpOffloadSendPacket (
+  IN     MNP_SERVICE_DATA                      *MnpServiceData,
+  IN     CONST EDKII_NETWORK_OFFLOAD_TX_INFO   *TxInfo,
+  IN OUT EFI_MANAGED_NETWORK_COMPLETION_TOKEN  *Token
+  )
+{
+  MNP_DEVICE_DATA                    *MnpDeviceData;
+  EFI_SIMPLE_NETWORK_MODE            *SnpMode;
+  EFI_MANAGED_NETWORK_TRANSMIT_DATA  *TxData;
+  EDKII_NETWORK_OFFLOAD_TX_INFO      Offload;
+  ETHER_HEAD                         *EtherHead;
+  BOOLEAN                            FromPool;
+  UINT8                              *TxBuf;
+  UINT8                              *Packet;
+  UINT8                              *DstPos;
+  UINT32                             HeaderSize;
+  UINT32                             Length;
+  UINT16                             ProtocolType;
+  UINT16                             Index;
+  EFI_STATUS                         Status;
+
+  MnpDeviceData = MnpServiceData->MnpDeviceData;
+  SnpMode       = MnpDeviceData->Snp->Mode;
+  TxData        = Token->Packet.TxData;
+  HeaderSize    = (TxData->DestinationAddress != NULL) ? sizeof (ETHER_HEAD) : 0;
+  Length        = HeaderSize + TxData->HeaderLength + TxData->DataLength;
+
+  FromPool = (BOOLEAN)(Length + NET_VLAN_TAG_LEN <= MnpDeviceData->BufferLength);
+  if (FromPool) {
+    TxBuf = MnpAllocTxBuf (MnpDeviceData);
+  } else {
+    TxBuf = AllocatePool (Length + NET_VLAN_TAG_LEN);
+  }
+
+  if (TxBuf == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Copy the fragments after the room of the VLAN tag and media header.
+  //
+  Packet = TxBuf + NET_VLAN_TAG_LEN;
+  DstPos = Packet + HeaderSize;
+  for (Index = 0; Index < TxData->FragmentCount; Index++) {
+    CopyMem (DstPos, TxData->FragmentTable[Index].FragmentBuffer, TxData->FragmentTable[Index].FragmentLength);
+    DstPos += TxData->FragmentTable[Index].FragmentLength;
+  }
+
+  CopyMem (&Offload, TxInfo, sizeof (Offload));
+
+  if (MnpServiceData->VlanId != 0) {
+    MnpInsertVlanTag (MnpServiceData, TxData, &ProtocolType, &Packet, &Length);
+    Offload.NetworkOffset   += NET_VLAN_TAG_LEN;
+    Offload.TransportOffset += NET_VLAN_TAG_LEN;
+  } else {
+    ProtocolType = TxData->ProtocolType;
+  }
+
+  if (TxData->DestinationAddress != NULL) {
+    EtherHead = (ETHER_HEAD *)Packet;
+    CopyMem (EtherHead->DstMac, TxData->DestinationAddress, NET_ETHER_ADDR_LEN);
+    CopyMem (
+      EtherHead->SrcMac,
+      (TxData->SourceAddress != NULL) ? TxData->SourceAddress : &SnpMode->CurrentAddress,
+      NET_ETHER_ADDR_LEN
+      );
+    EtherHead->EtherType     = HTONS (ProtocolType);
+    Offload.NetworkOffset   += sizeof (ETHER_HEAD);
+    Offload.TransportOffset += sizeof (ETHER_HEAD);
+  }
+
+  Token->Status = EFI_SUCCESS;
+
+  if (SnpMode->MediaPresentSupported && !SnpMode->MediaPresent) {
+    DEBUG ((DEBUG_WARN, "MnpOffloadSendPacket: No network cable detected.\n"));
+    Token->Status = EFI_NO_MEDIA;
+  } else {
+    Status = MnpDeviceData->NetworkOffload->Transmit (MnpDeviceData->NetworkOffload, &Offload, Length, Packet);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "MnpOffloadSendPacket: Transmit() = %r.\n", Status));
+      Token->Status = EFI_DEVICE_ERROR;
+    }
+  }
+
+  //
+  // The interface is done with the frame when Transmit() returns.
+  //
+  if (FromPool) {
+    MnpFreeTxBuf (MnpDeviceData, TxBuf);
+  } else {
+    FreePool (TxBuf);
+  }
+
+  gBS->SignalEvent (Token->Event);
+
+  //
+  // Dispatch the DPC queued by the NotifyFunction of Token->Event.
+  //
+  DispatchDpc ();
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the offloads available to the child.
+
+  @param[in]   This               Pointer to the EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[out]  Capabilities       The EDKII_NETWORK_OFFLOAD_* flags supported.
+  @param[out]  MaxLargeSendSize   Largest DataLength of a large send.
+
+  @retval EFI_SUCCESS            The capabilities are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+MnpOffloadGetCapabilities (
+  IN  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *This,
+  OUT UINT32                                  *Capabilities,
+  OUT UINT32                                  *MaxLargeSendSize
+  )
+{
+  MNP_INSTANCE_DATA  *Instance;
+  MNP_DEVICE_DATA    *MnpDeviceData;
+
+  if ((This == NULL) || (Capabilities == NULL) || (MaxLargeSendSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance      = MNP_INSTANCE_DATA_FROM_OFFLOAD (This);
+  MnpDeviceData = Instance->MnpServiceData->MnpDeviceData;
+
+  *Capabilities     = 0;
+  *MaxLargeSendSize = MnpOffloadMaxLargeSendSize (Instance->MnpServiceData);
+
+  if (MnpDeviceData->NetworkOffload != NULL) {
+    *Capabilities = MnpDeviceData->NetworkOffload->Capabilities;
+    if (MnpDeviceData->NetworkOffload->Receive == NULL) {
+      *Capabilities &= ~EDKII_NETWORK_OFFLOAD_RX_MASK;
+    }
+
+    if (*MaxLargeSendSize == 0) {
+      *Capabilities &= ~EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Place an outgoing packet with offloads into the transmit queue.
+
+  @param[in]  This     Pointer to the EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in]  Token    Pointer to a token associated with the transmit data
+                       descriptor.
+  @param[in]  TxInfo   The offloads to apply.
+
+  @retval EFI_SUCCESS            The transmit completion token was cached.
+  @retval EFI_NOT_STARTED        This MNP child driver instance has not been
+                                 configured.
+  @retval EFI_INVALID_PARAMETER  A parameter is invalid.
+  @retval EFI_UNSUPPORTED        An offload is not supported by the interface.
+  @retval EFI_OUT_OF_RESOURCES   The transmit data could not be queued due to a
+                                 lack of system resources.
+
+**/
+EFI_STATUS
+EFIAPI
+MnpOffloadTransmit (
+  IN EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *This,
+  IN EFI_MANAGED_NETWORK_COMPLETION_TOKEN    *Token,
+  IN CONST EDKII_NETWORK_OFFLOAD_TX_INFO     *TxInfo
+  )
+{
+  EFI_STATUS         Status;
+  MNP_INSTANCE_DATA  *Instance;
+  MNP_SERVICE_DATA   *MnpServiceData;
+  UINT32             Capabilities;
+  UINT32             MaxDataLength;
+  UINT32             TotalLength;
+  EFI_TPL            OldTpl;
+
+  if ((This == NULL) || (Token == NULL) || (TxInfo == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance = MNP_INSTANCE_DATA_FROM_OFFLOAD (This);
+
+  if (TxInfo->Flags == 0) {
+    return Instance->ManagedNetwork.Transmit (&Instance->ManagedNetwork, Token);
+  }
+
+  MnpServiceData = Instance->MnpServiceData;
+  NET_CHECK_SIGNATURE (MnpServiceData, MNP_SERVICE_DATA_SIGNATURE);
+
+  MnpOffloadGetCapabilities (This, &Capabilities, &MaxDataLength);
+  if ((TxInfo->Flags & ~(Capabilities & EDKII_NETWORK_OFFLOAD_TX_MASK)) != 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((TxInfo->Flags & EDKII_NETWORK_OFFLOAD_TX_TCP4_LARGE_SEND) == 0) {
+    MaxDataLength = MnpServiceData->Mtu;
+  } else if (TxInfo->SegmentSize == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  if (!Instance->Configured) {
+    Status = EFI_NOT_STARTED;
+    goto ON_EXIT;
+  }
+
+  if (!MnpIsValidTxToken (Instance, Token, MaxDataLength)) {
+    Status = EFI_INVALID_PARAMETER;
+    goto ON_EXIT;
+  }
+
+  TotalLength = Token->Packet.TxData->HeaderLength + Token->Packet.TxData->DataLength;
+  if ((TxInfo->NetworkOffset >= TxInfo->TransportOffset) || (TxInfo->TransportOffset >= TotalLength)) {
+    Status = EFI_INVALID_PARAMETER;
+    goto ON_EXIT;
+  }
+
+  Status = MnpOffloadSendPacket (MnpServiceData, TxInfo, Token);
+
+ON_EXIT:
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+  Get the checksums verified by the interface for a received packet.
+
+  @param[in]   This      Pointer to the EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL instance.
+  @param[in]   RxData    The receive data delivered to this instance.
+  @param[out]  Flags     The EDKII_NETWORK_OFFLOAD_RX_* flags.
+
+  @retval EFI_SUCCESS            The flags are returned.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL, or RxData was not
+                                 delivered to this instance.
+
+**/
+EFI_STATUS
+EFIAPI
+MnpOffloadGetReceiveFlags (
+  IN  EDKII_MANAGED_NETWORK_OFFLOAD_PROTOCOL  *This,
+  IN  EFI_MANAGED_NETWORK_RECEIVE_DATA        *RxData,
+  OUT UINT32                                  *Flags
+  )
+{
+  MNP_INSTANCE_DATA  *Instance;
+  MNP_RXDATA_WRAP    *RxDataWrap;
+
+  if ((This == NULL) || (RxData == NULL) || (Flags == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance   = MNP_INSTANCE_DATA_FROM_OFFLOAD (This);
+  RxDataWrap = BASE_CR (RxData, MNP_RXDATA_WRAP, RxData);
+  if (RxDataWrap->Instance != Instance) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Flags = RxDataWrap->OffloadFlags;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,346 @@
+/** @file
+  Tests for the offload fallback of TcpIo.c.
+
+  The IpIoLib functions are emulated by an interface whose offloads can be
+  withdrawn, as happens when IPsec is installed on it.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+#include <gtest/gtest.h>
+
+extern "C" {
+  #include <Uefi.h>
+  #include <Library/BaseLib.h>
+  #include <Library/BaseMemoryLib.h>
+  #include <Library/DebugLib.h>
+  #include <Library/MemoryAllocationLib.h>
+  #include "../TcpMain.h"
+}
+
+////////////////////////////////////////////////////////////////////////
+// Defines
+////////////////////////////////////////////////////////////////////////
+
+#define TEST_DATA_SIZE          1000
+#define TEST_MAX_LARGE_SEND     SIZE_64KB
+#define TEST_OFFLOAD_CHECKSUM   EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM
+#define TEST_OFFLOAD_ALL        (EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND)
+#define TEST_CHECKSUM_SENTINEL  0x5AA5
+
+//
+// The emulated interface.
+//
+typedef struct {
+  UINT32        Capabilities;
+  UINT32        MaxLargeSendSize;
+  EFI_STATUS    OffloadStatus;
+  UINTN         OffloadSends;
+  UINTN         PlainSends;
+  UINT32        LastOffloadFlags;
+  UINT16        LastSegmentSize;
+} TEST_INTERFACE;
+
+STATIC TEST_INTERFACE  mInterface;
+
+////////////////////////////////////////////////////////////////////////
+// Emulated IpIoLib and TcpDxe functions
+////////////////////////////////////////////////////////////////////////
+
+extern "C" {
+  EFI_STATUS
+  EFIAPI
+  IpIoSendWithOffload (
+    IN OUT IP_IO           *IpIo,
+    IN OUT NET_BUF         *Pkt,
+    IN     IP_IO_IP_INFO   *Sender        OPTIONAL,
+    IN     VOID            *Context       OPTIONAL,
+    IN     VOID            *NotifyData    OPTIONAL,
+    IN     EFI_IP_ADDRESS  *Dest          OPTIONAL,
+    IN     IP_IO_OVERRIDE  *OverrideData  OPTIONAL,
+    IN     UINT32          OffloadFlags,
+    IN     UINT16          SegmentSize
+    )
+  {
+    mInterface.OffloadSends++;
+    mInterface.LastOffloadFlags = OffloadFlags;
+    mInterface.LastSegmentSize  = SegmentSize;
+
+    if ((OffloadFlags & ~mInterface.Capabilities) != 0) {
+      return EFI_UNSUPPORTED;
+    }
+
+    return mInterface.OffloadStatus;
+  }
+
+  EFI_STATUS
+  EFIAPI
+  IpIoSend (
+    IN OUT IP_IO           *IpIo,
+    IN OUT NET_BUF         *Pkt,
+    IN     IP_IO_IP_INFO   *Sender        OPTIONAL,
+    IN     VOID            *Context       OPTIONAL,
+    IN     VOID            *NotifyData    OPTIONAL,
+    IN     EFI_IP_ADDRESS  *Dest          OPTIONAL,
+    IN     IP_IO_OVERRIDE  *OverrideData  OPTIONAL
+    )
+  {
+    mInterface.PlainSends++;
+    return EFI_SUCCESS;
+  }
+
+  EFI_STATUS
+  EFIAPI
+  IpIoGetOffloadCapabilities (
+    IN  IP_IO          *IpIo,
+    IN  IP_IO_IP_INFO  *Sender OPTIONAL,
+    OUT UINT32         *Capabilities,
+    OUT UINT32         *MaxLargeSendSize
+    )
+  {
+    *Capabilities     = mInterface.Capabilities;
+    *MaxLargeSendSize = mInterface.MaxLargeSendSize;
+    return EFI_SUCCESS;
+  }
+
+  IP_IO_IP_INFO *
+  EFIAPI
+  IpIoFindSender (
+    IN OUT IP_IO           **IpIo,
+    IN     UINT8           IpVersion,
+    IN     EFI_IP_ADDRESS  *Src
+    )
+  {
+    return NULL;
+  }
+
+  EFI_STATUS
+  EFIAPI
+  IpIoRefreshNeighbor (
+    IN IP_IO           *IpIo,
+    IN EFI_IP_ADDRESS  *Neighbor,
+    IN UINT32          Timeout
+    )
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  INTN
+  TcpInput (
+    IN NET_BUF         *Nbuf,
+    IN EFI_IP_ADDRESS  *Src,
+    IN EFI_IP_ADDRESS  *Dst,
+    IN UINT8           Version,
+    IN UINT32          OffloadFlags
+    )
+  {
+    return 0;
+  }
+
+  VOID
+  TcpIcmpInput (
+    IN NET_BUF         *Nbuf,
+    IN UINT8           IcmpErr,
+    IN EFI_IP_ADDRESS  *Src,
+    IN EFI_IP_ADDRESS  *Dst,
+    IN UINT8           Version
+    )
+  {
+  }
+
+  UINT16
+  TcpChecksum (
+    IN NET_BUF  *Nbuf,
+    IN UINT16   HeadSum
+    )
+  {
+    UINT16  Checksum;
+
+    Checksum = NetbufChecksum (Nbuf);
+    Checksum = NetAddChecksum (Checksum, HeadSum);
+    Checksum = NetAddChecksum (Checksum, HTONS ((UINT16)Nbuf->TotalSize));
+
+    return (UINT16)(~Checksum);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// TcpIoOffloadTest Tests
+////////////////////////////////////////////////////////////////////////
+
+class TcpIoOffloadTest : public ::testing::Test {
+protected:
+  IP_IO             IpIo;
+  IP_IO_IP_INFO     IpInfo;
+  TCP_SERVICE_DATA  TcpService;
+  SOCKET            Sock;
+  TCP_CB            Tcb;
+  NET_BUF           *Nbuf;
+  TCP_HEAD          *Head;
+  EFI_IP_ADDRESS    Src;
+  EFI_IP_ADDRESS    Dest;
+
+  void
+  SetUp (
+    ) override
+  {
+    TCP_PROTO_DATA  *TcpProto;
+    UINT8           *Data;
+
+    ZeroMem (&mInterface, sizeof (mInterface));
+    ZeroMem (&IpIo, sizeof (IpIo));
+    ZeroMem (&IpInfo, sizeof (IpInfo));
+    ZeroMem (&TcpService, sizeof (TcpService));
+    ZeroMem (&Sock, sizeof (Sock));
+    ZeroMem (&Tcb, sizeof (Tcb));
+    ZeroMem (&Src, sizeof (Src));
+    ZeroMem (&Dest, sizeof (Dest));
+
+    mInterface.Capabilities     = TEST_OFFLOAD_ALL;
+    mInterface.MaxLargeSendSize = TEST_MAX_LARGE_SEND;
+    mInterface.OffloadStatus    = EFI_SUCCESS;
+
+    IpIo.IpVersion       = IP_VERSION_4;
+    IpInfo.IpVersion     = IP_VERSION_4;
+    TcpService.IpVersion = IP_VERSION_4;
+    TcpService.IpIo      = &IpIo;
+
+    TcpProto             = (TCP_PROTO_DATA *)Sock.ProtoReserved;
+    TcpProto->TcpService = &TcpService;
+    TcpProto->TcpPcb     = &Tcb;
+    Sock.IpVersion       = IP_VERSION_4;
+
+    Tcb.Sk     = &Sock;
+    Tcb.IpInfo = &IpInfo;
+
+    Src.v4.Addr[0]  = 192;
+    Src.v4.Addr[1]  = 168;
+    Src.v4.Addr[3]  = 1;
+    Dest.v4.Addr[0] = 192;
+    Dest.v4.Addr[1] = 168;
+    Dest.v4.Addr[3] = 2;
+    Tcb.HeadSum     = NetPseudoHeadChecksum (Src.Addr[0], Dest.Addr[0], 6, 0);
+
+    TcpRefreshOffload (&Tcb);
+
+    //
+    // A segment whose checksum field holds what TcpTransmitSegment() leaves
+    // to an interface with the checksum offload.
+    //
+    Nbuf = NetbufAlloc (sizeof (TCP_HEAD) + TEST_DATA_SIZE);
+    ASSERT_NE (Nbuf, nullptr);
+
+    Head = (TCP_HEAD *)NetbufAllocSpace (Nbuf, sizeof (TCP_HEAD), NET_BUF_TAIL);
+    ASSERT_NE (Head, nullptr);
+    ZeroMem (Head, sizeof (TCP_HEAD));
+    Head->SrcPort  = HTONS (49152);
+    Head->DstPort  = HTONS (80);
+    Head->Seq      = HTONL (0x12345678);
+    Head->HeadLen  = sizeof (TCP_HEAD) >> 2;
+    Head->Flag     = TCP_FLG_ACK;
+    Head->Wnd      = HTONS (0xFFFF);
+    Head->Checksum = TEST_CHECKSUM_SENTINEL;
+    Nbuf->Tcp      = Head;
+
+    Data = NetbufAllocSpace (Nbuf, TEST_DATA_SIZE, NET_BUF_TAIL);
+    ASSERT_NE (Data, nullptr);
+    for (UINTN Index = 0; Index < TEST_DATA_SIZE; Index++) {
+      Data[Index] = (UINT8)(Index * 13);
+    }
+  }
+
+  void
+  TearDown (
+    ) override
+  {
+    NetbufFree (Nbuf);
+  }
+};
+
+// Test Description:
+// TcpRefreshOffload() takes the offloads of the interface and leaves room for
+// the largest TCP header in a large send.
+TEST_F (TcpIoOffloadTest, RefreshShouldTakeTheInterfaceOffloads) {
+  EXPECT_EQ (Tcb.OffloadCapabilities, (UINT32)TEST_OFFLOAD_ALL);
+  EXPECT_EQ (Tcb.MaxLargeSendSize, TEST_MAX_LARGE_SEND - sizeof (TCP_HEAD) - TCP_OPTION_MAX_LEN);
+
+  mInterface.MaxLargeSendSize = sizeof (TCP_HEAD) + TCP_OPTION_MAX_LEN;
+  TcpRefreshOffload (&Tcb);
+  EXPECT_EQ (Tcb.OffloadCapabilities, (UINT32)TEST_OFFLOAD_CHECKSUM);
+  EXPECT_EQ (Tcb.MaxLargeSendSize, 0U);
+
+  mInterface.Capabilities = EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND;
+  TcpRefreshOffload (&Tcb);
+  EXPECT_EQ (Tcb.OffloadCapabilities, 0U);
+
+  mInterface.Capabilities = TEST_OFFLOAD_ALL;
+  Sock.IpVersion          = IP_VERSION_6;
+  TcpRefreshOffload (&Tcb);
+  EXPECT_EQ (Tcb.OffloadCapabilities, 0U);
+  EXPECT_EQ (Tcb.MaxLargeSendSize, 0U);
+}
+
+// Test Description:
+// When the interface withdraws the checksum offload, the segment gets its
+// checksum from TCP and is sent without offloads, and the TCB stops asking
+// for the offloads.
+TEST_F (TcpIoOffloadTest, RejectedChecksumShouldFallBackToPlainSend) {
+  UINT16  Checksum;
+
+  mInterface.Capabilities = 0;
+
+  EXPECT_EQ (TcpSendIpPacket (&Tcb, Nbuf, &Src, &Dest, IP_VERSION_4, TEST_OFFLOAD_CHECKSUM, 0), 0);
+  EXPECT_EQ (mInterface.OffloadSends, 1U);
+  EXPECT_EQ (mInterface.LastOffloadFlags, (UINT32)TEST_OFFLOAD_CHECKSUM);
+  EXPECT_EQ (mInterface.PlainSends, 1U);
+  EXPECT_EQ (Tcb.OffloadCapabilities, 0U);
+  EXPECT_EQ (Tcb.MaxLargeSendSize, 0U);
+
+  //
+  // The completed segment sums to zero with its pseudo-header.
+  //
+  EXPECT_NE (Head->Checksum, TEST_CHECKSUM_SENTINEL);
+  Checksum = NetbufChecksum (Nbuf);
+  Checksum = NetAddChecksum (Checksum, Tcb.HeadSum);
+  Checksum = NetAddChecksum (Checksum, HTONS ((UINT16)Nbuf->TotalSize));
+  EXPECT_EQ (Checksum, 0xFFFF);
+}
+
+// Test Description:
+// A rejected large send is not sent, so that TcpOutput.c splits it, and the
+// TCB keeps the offloads that the interface still provides.
+TEST_F (TcpIoOffloadTest, RejectedLargeSendShouldFailWithoutSending) {
+  mInterface.Capabilities = TEST_OFFLOAD_CHECKSUM;
+
+  EXPECT_EQ (TcpSendIpPacket (&Tcb, Nbuf, &Src, &Dest, IP_VERSION_4, TEST_OFFLOAD_ALL, 1460), -1);
+  EXPECT_EQ (mInterface.OffloadSends, 1U);
+  EXPECT_EQ (mInterface.LastSegmentSize, 1460);
+  EXPECT_EQ (mInterface.PlainSends, 0U);
+  EXPECT_EQ (Tcb.OffloadCapabilities, (UINT32)TEST_OFFLOAD_CHECKSUM);
+  EXPECT_EQ (Tcb.MaxLargeSendSize, 0U);
+  EXPECT_EQ (Head->Checksum, TEST_CHECKSUM_SENTINEL);
+}
+
+// Test Description:
+// Other send errors are returned as they are and leave the offloads of the
+// TCB alone.
+TEST_F (TcpIoOffloadTest, OtherErrorsShouldKeepTheOffloads) {
+  mInterface.OffloadStatus = EFI_DEVICE_ERROR;
+
+  EXPECT_EQ (TcpSendIpPacket (&Tcb, Nbuf, &Src, &Dest, IP_VERSION_4, TEST_OFFLOAD_ALL, 1460), -1);
+  EXPECT_EQ (mInterface.PlainSends, 0U);
+  EXPECT_EQ (Tcb.OffloadCapabilities, (UINT32)TEST_OFFLOAD_ALL);
+  EXPECT_EQ (Head->Checksum, TEST_CHECKSUM_SENTINEL);
+}
+
+// Test Description:
+// A segment sent without offloads is never sent again, even when the
+// interface rejects it.
+TEST_F (TcpIoOffloadTest, PlainSendShouldNotFallBack) {
+  mInterface.OffloadStatus = EFI_UNSUPPORTED;
+
+  EXPECT_EQ (TcpSendIpPacket (&Tcb, Nbuf, &Src, &Dest, IP_VERSION_4, 0, 0), -1);
+  EXPECT_EQ (mInterface.OffloadSends, 1U);
+  EXPECT_EQ (mInterface.PlainSends, 0U);
+  EXPECT_EQ (Tcb.OffloadCapabilities, (UINT32)TEST_OFFLOAD_ALL);
+}
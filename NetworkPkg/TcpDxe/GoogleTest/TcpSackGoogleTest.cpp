@@ -0,0 +1,1189 @@
+/** @file
+  Tests for TcpSack.c, TcpCongestion.c and the large sends of TcpOutput.c.
+
+  The transfer tests connect two established TCP instances through a
+  simulated link with a bottleneck rate, a fixed delay and a deterministic
+  loss pattern. The input, output, option and timer code of TcpDxe runs on
+  both ends, while the socket and IP layers are emulated and a virtual clock
+  drives the TCP heartbeat. The link also completes the checksums and splits
+  the large sends as an interface with these offloads would.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <deque>
+#include <vector>
+
+extern "C" {
+  #include <Uefi.h>
+  #include <Library/BaseLib.h>
+  #include <Library/BaseMemoryLib.h>
+  #include <Library/DebugLib.h>
+  #include <Library/MemoryAllocationLib.h>
+  #include "../TcpMain.h"
+
+  VOID
+  EFIAPI
+  TcpTickingDpc (
+    IN VOID  *Context
+    );
+
+  VOID
+  TcpFastRecover (
+    IN OUT TCP_CB   *Tcb,
+    IN     TCP_SEG  *Seg
+    );
+}
+
+////////////////////////////////////////////////////////////////////////
+// Defines
+////////////////////////////////////////////////////////////////////////
+
+#define LINK_MSS            1460
+#define LINK_BUFFER         SIZE_2MB
+#define LINK_TRANSFER       (8 * SIZE_1MB)
+#define LINK_RATE_MBPS      100
+#define LINK_RTT_MS         50
+#define LINK_TIMEOUT_MS     (600 * 1000)
+#define LINK_SENDER_PORT    49152
+#define LINK_RECEIVER_PORT  80
+
+//
+// The byte of the stream at an offset.
+//
+#define LINK_PATTERN(Offset)  ((UINT8)((Offset) ^ ((Offset) >> 11)))
+
+//
+// A socket of the link, the socket must be first.
+//
+typedef struct {
+  SOCKET           Sock;
+  NET_BUF_QUEUE    SndQueue;
+  NET_BUF_QUEUE    RcvQueue;
+  UINT64           Sent;
+  UINT64           Received;
+  BOOLEAN          Corrupted;
+} LINK_SOCKET;
+
+//
+// A segment travelling on the link.
+//
+typedef struct {
+  UINT64                Arrival;
+  TCP_CB                *Dest;
+  std::vector<UINT8>    Data;
+} LINK_PACKET;
+
+//
+// Statistics of a transfer.
+//
+typedef struct {
+  UINT64    Time;
+  UINT64    Goodput;
+  UINT32    Segments;
+  UINT32    Dropped;
+  UINT32    Timeouts;
+  UINT32    LargeSends;
+  UINT32    LargestSend;
+} LINK_RESULT;
+
+////////////////////////////////////////////////////////////////////////
+// Simulated link
+////////////////////////////////////////////////////////////////////////
+
+class SimulatedLink;
+
+STATIC SimulatedLink  *mLink;
+
+class SimulatedLink {
+public:
+  TCP_CB                     Tcb[2];
+  LINK_SOCKET                Socket[2];
+  IP_IO_IP_INFO              IpInfo;
+  std::deque<LINK_PACKET>    Forward;
+  std::deque<LINK_PACKET>    Backward;
+  UINT64                     Clock;
+  UINT64                     BusyUntil;
+  UINT32                     LossPerMillion;
+  UINT32                     Seed;
+  BOOLEAN                    RejectLargeSend;
+  LINK_RESULT                Result;
+
+  SimulatedLink (
+    UINT32  CtrlFlag,
+    UINT32  LossPerMillion
+    ) : Clock (0), BusyUntil (0), LossPerMillion (LossPerMillion), Seed (0x2545F491), RejectLargeSend (FALSE)
+  {
+    ZeroMem (Tcb, sizeof (Tcb));
+    ZeroMem (Socket, sizeof (Socket));
+    ZeroMem (&IpInfo, sizeof (IpInfo));
+    ZeroMem (&Result, sizeof (Result));
+
+    IpInfo.IpVersion = IP_VERSION_4;
+    InitializeListHead (&mTcpRunQue);
+
+    InitEnd (0, LINK_SENDER_PORT, LINK_RECEIVER_PORT, 1000, 50000, CtrlFlag);
+    InitEnd (1, LINK_RECEIVER_PORT, LINK_SENDER_PORT, 50000, 1000, CtrlFlag);
+    mLink  = this;
+  }
+
+  ~SimulatedLink (
+    )
+  {
+    for (UINTN Index = 0; Index < 2; Index++) {
+      NetbufFreeList (&Tcb[Index].SndQue);
+      NetbufFreeList (&Tcb[Index].RcvQue);
+    }
+
+    InitializeListHead (&mTcpRunQue);
+    mLink = NULL;
+  }
+
+  //
+  // Set up an end of the connection as TcpInitTcbLocal and
+  // TcpInitTcbPeer would after the three-way handshake.
+  //
+  VOID
+  InitEnd (
+    UINTN      Index,
+    UINT16     LocalPort,
+    UINT16     RemotePort,
+    TCP_SEQNO  Iss,
+    TCP_SEQNO  Irs,
+    UINT32     CtrlFlag
+    )
+  {
+    TCP_CB  *Cb;
+    SOCKET  *Sk;
+
+    Sk                      = &Socket[Index].Sock;
+    Sk->IpVersion           = IP_VERSION_4;
+    Sk->SndBuffer.HighWater = LINK_BUFFER;
+    Sk->RcvBuffer.HighWater = LINK_BUFFER;
+    Sk->SndBuffer.DataQueue = &Socket[Index].SndQueue;
+    Sk->RcvBuffer.DataQueue = &Socket[Index].RcvQueue;
+
+    Cb = &Tcb[Index];
+    InitializeListHead (&Cb->SndQue);
+    InitializeListHead (&Cb->RcvQue);
+
+    Cb->Sk                   = Sk;
+    Cb->IpInfo               = &IpInfo;
+    Cb->State                = TCP_ESTABLISHED;
+    Cb->CtrlFlag             = CtrlFlag | TCP_CTRL_NO_KEEPALIVE | TCP_CTRL_NO_TS | TCP_CTRL_RCVD_WS;
+    Cb->LocalEnd.Port        = HTONS (LocalPort);
+    Cb->RemoteEnd.Port       = HTONS (RemotePort);
+    Cb->LocalEnd.Ip.Addr[0]  = (Index == 0) ? 0x0100000A : 0x0200000A;
+    Cb->RemoteEnd.Ip.Addr[0] = (Index == 0) ? 0x0200000A : 0x0100000A;
+    Cb->HeadSum              = NetPseudoHeadChecksum (Cb->LocalEnd.Ip.Addr[0], Cb->RemoteEnd.Ip.Addr[0], 0x06, 0);
+
+    Cb->Iss         = Iss;
+    Cb->SndUna      = Iss + 1;
+    Cb->SndNxt      = Iss + 1;
+    Cb->SndPsh      = Iss + 1;
+    Cb->SndWnd      = LINK_BUFFER;
+    Cb->SndWndMax   = LINK_BUFFER;
+    Cb->SndWl1      = Irs;
+    Cb->SndWl2      = Iss + 1;
+    Cb->SndMss      = LINK_MSS;
+    Cb->RcvMss      = LINK_MSS;
+    Cb->Irs         = Irs;
+    Cb->RcvNxt      = Irs + 1;
+    Cb->RcvWl2      = Irs + 1;
+    Cb->RcvWnd      = LINK_BUFFER;
+    Cb->SndWndScale = TcpComputeScale (Cb);
+    Cb->RcvWndScale = TcpComputeScale (Cb);
+
+    Cb->Rto          = 3 * TCP_TICK_HZ;
+    Cb->MaxRexmit    = TCP_MAX_LOSS;
+    Cb->CWnd         = Cb->SndMss;
+    Cb->Ssthresh     = 0xffffffff;
+    Cb->CongestState = TCP_CONGEST_OPEN;
+    Cb->SackHighRxt  = Cb->SndUna;
+    Cb->SackHigh     = Cb->SndUna;
+
+    InsertTailList (&mTcpRunQue, &Cb->List);
+  }
+
+  //
+  // Hand a segment to the interface. It completes the checksum and
+  // splits a large send in segments of SegmentSize bytes of data,
+  // each with a copy of the TCP header.
+  //
+  INTN
+  Send (
+    TCP_CB   *From,
+    NET_BUF  *Nbuf,
+    UINT32   OffloadFlags,
+    UINT16   SegmentSize
+    )
+  {
+    std::vector<UINT8>  Data;
+    std::vector<UINT8>  Segment;
+    TCP_HEAD            *Head;
+    UINT32              HeadLen;
+    UINT32              Offset;
+    UINT32              Len;
+    UINT16              Sum;
+
+    Data.resize (Nbuf->TotalSize);
+    NetbufCopy (Nbuf, 0, Nbuf->TotalSize, Data.data ());
+
+    if (OffloadFlags == 0) {
+      Transmit (From, Data);
+      return 0;
+    }
+
+    Head    = (TCP_HEAD *)Data.data ();
+    HeadLen = Head->HeadLen << 2;
+
+    if ((OffloadFlags & EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND) != 0) {
+      if (RejectLargeSend) {
+        From->OffloadCapabilities &= ~EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND;
+        return -1;
+      }
+
+      Result.LargeSends++;
+      Result.LargestSend = MAX (Result.LargestSend, (UINT32)Data.size () - HeadLen);
+    } else {
+      SegmentSize = (UINT16)(Data.size () - HeadLen);
+    }
+
+    Offset = HeadLen;
+    do {
+      Len = MIN ((UINT32)SegmentSize, (UINT32)Data.size () - Offset);
+
+      Segment.assign (Data.begin (), Data.begin () + HeadLen);
+      Segment.insert (Segment.end (), Data.begin () + Offset, Data.begin () + Offset + Len);
+
+      Head      = (TCP_HEAD *)Segment.data ();
+      Head->Seq = HTONL (NTOHL (Head->Seq) + Offset - HeadLen);
+      if (Offset + Len < Data.size ()) {
+        Head->Flag &= ~(TCP_FLG_FIN | TCP_FLG_PSH);
+      }
+
+      //
+      // The checksum field holds the sum of the pseudo header without the length.
+      //
+      Sum            = NetblockChecksum (Segment.data (), (UINT32)Segment.size ());
+      Sum            = NetAddChecksum (Sum, HTONS ((UINT16)Segment.size ()));
+      Head->Checksum = (UINT16)~Sum;
+
+      Transmit (From, Segment);
+      Offset += Len;
+    } while (Offset < Data.size ());
+
+    return 0;
+  }
+
+  //
+  // Put a segment on the link. The forward direction is limited
+  // by the bottleneck, whose queue holds one bandwidth-delay
+  // product, the backward direction only adds the delay.
+  //
+  VOID
+  Transmit (
+    TCP_CB                    *From,
+    CONST std::vector<UINT8>  &Data
+    )
+  {
+    LINK_PACKET  Packet;
+    UINT64       Start;
+
+    Packet.Data = Data;
+
+    if (From == &Tcb[1]) {
+      Packet.Dest    = &Tcb[0];
+      Packet.Arrival = Clock + LINK_RTT_MS * 1000 / 2;
+      Backward.push_back (Packet);
+      return;
+    }
+
+    Result.Segments++;
+    Seed = Seed * 1103515245 + 12345;
+
+    Start = MAX (Clock, BusyUntil);
+    if ((Start - Clock > LINK_RTT_MS * 1000) || ((Seed >> 8) % 1000000 < LossPerMillion)) {
+      Result.Dropped++;
+      return;
+    }
+
+    BusyUntil      = Start + (UINT64)Packet.Data.size () * 8 / LINK_RATE_MBPS;
+    Packet.Dest    = &Tcb[1];
+    Packet.Arrival = BusyUntil + LINK_RTT_MS * 1000 / 2;
+    Forward.push_back (Packet);
+  }
+
+  //
+  // Deliver the next segment or run the heartbeat, whichever is due first.
+  //
+  VOID
+  Step (
+    UINT64  &NextTick
+    )
+  {
+    std::deque<LINK_PACKET>  *Queue;
+    LINK_PACKET              Packet;
+    NET_BUF                  *Nbuf;
+    EFI_IP_ADDRESS           Src;
+    EFI_IP_ADDRESS           Dst;
+
+    Queue = NULL;
+    if (!Forward.empty () && (Forward.front ().Arrival < NextTick)) {
+      Queue = &Forward;
+    }
+
+    if (!Backward.empty () && (Backward.front ().Arrival < NextTick) &&
+        ((Queue == NULL) || (Backward.front ().Arrival < Queue->front ().Arrival)))
+    {
+      Queue = &Backward;
+    }
+
+    if (Queue == NULL) {
+      Clock     = NextTick;
+      NextTick += TCP_TICK * 1000;
+      TcpTickingDpc (NULL);
+      return;
+    }
+
+    Packet = Queue->front ();
+    Queue->pop_front ();
+    Clock = Packet.Arrival;
+
+    Nbuf = NetbufAlloc ((UINT32)Packet.Data.size ());
+    ASSERT (Nbuf != NULL);
+    CopyMem (NetbufAllocSpace (Nbuf, (UINT32)Packet.Data.size (), NET_BUF_TAIL), Packet.Data.data (), Packet.Data.size ());
+
+    ZeroMem (&Src, sizeof (Src));
+    ZeroMem (&Dst, sizeof (Dst));
+    Src.Addr[0] = Packet.Dest->RemoteEnd.Ip.Addr[0];
+    Dst.Addr[0] = Packet.Dest->LocalEnd.Ip.Addr[0];
+    TcpInput (Nbuf, &Src, &Dst, IP_VERSION_4, 0);
+  }
+
+  //
+  // Send Size bytes from the first end to the second one.
+  //
+  BOOLEAN
+  Transfer (
+    UINT64  Size
+    )
+  {
+    UINT64  NextTick;
+    UINT32  LossTimes;
+
+    Socket[0].SndQueue.BufSize = (UINT32)Size;
+    TcpToSendData (&Tcb[0], 0);
+
+    NextTick  = TCP_TICK * 1000;
+    LossTimes = 0;
+    while ((Socket[1].Received < Size) && (Clock < (UINT64)LINK_TIMEOUT_MS * 1000)) {
+      if (Tcb[0].State != TCP_ESTABLISHED) {
+        break;
+      }
+
+      Step (NextTick);
+
+      if (Tcb[0].LossTimes > LossTimes) {
+        Result.Timeouts++;
+      }
+
+      LossTimes = Tcb[0].LossTimes;
+    }
+
+    Result.Time    = Clock / 1000;
+    Result.Goodput = (Result.Time != 0) ? Socket[1].Received * 8 / Result.Time : 0;
+    return (BOOLEAN)((Socket[1].Received == Size) && !Socket[1].Corrupted);
+  }
+};
+
+////////////////////////////////////////////////////////////////////////
+// Symbol Definitions
+// These functions are not directly under test - but required to compile
+////////////////////////////////////////////////////////////////////////
+LIST_ENTRY  mTcpRunQue = {
+  &mTcpRunQue,
+  &mTcpRunQue
+};
+
+CHAR16  *mTcpStateName[] = {
+  (CHAR16 *)L"TCP_CLOSED",
+  (CHAR16 *)L"TCP_LISTEN",
+  (CHAR16 *)L"TCP_SYN_SENT",
+  (CHAR16 *)L"TCP_SYN_RCVD",
+  (CHAR16 *)L"TCP_ESTABLISHED",
+  (CHAR16 *)L"TCP_FIN_WAIT_1",
+  (CHAR16 *)L"TCP_FIN_WAIT_2",
+  (CHAR16 *)L"TCP_CLOSING",
+  (CHAR16 *)L"TCP_TIME_WAIT",
+  (CHAR16 *)L"TCP_CLOSE_WAIT",
+  (CHAR16 *)L"TCP_LAST_ACK"
+};
+
+EFI_STATUS
+EFIAPI
+QueueDpc (
+  IN EFI_TPL            DpcTpl,
+  IN EFI_DPC_PROCEDURE  DpcProcedure,
+  IN VOID               *DpcContext    OPTIONAL
+  )
+{
+  DpcProcedure (DpcContext);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+IpIoGetIcmpErrStatus (
+  IN  UINT8    IcmpError,
+  IN  UINT8    IpVersion,
+  OUT BOOLEAN  *IsHard  OPTIONAL,
+  OUT BOOLEAN  *Notify  OPTIONAL
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS
+Tcp6RefreshNeighbor (
+  IN TCP_CB          *Tcb,
+  IN EFI_IP_ADDRESS  *Neighbor,
+  IN UINT32          Timeout
+  )
+{
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+TcpInitTcbLocal (
+  IN OUT TCP_CB  *Tcb
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+VOID
+TcpInitTcbPeer (
+  IN OUT TCP_CB      *Tcb,
+  IN     TCP_SEG     *Seg,
+  IN     TCP_OPTION  *Opt
+  )
+{
+}
+
+TCP_CB *
+TcpLocateTcb (
+  IN TCP_PORTNO      LocalPort,
+  IN EFI_IP_ADDRESS  *LocalIp,
+  IN TCP_PORTNO      RemotePort,
+  IN EFI_IP_ADDRESS  *RemoteIp,
+  IN UINT8           Version,
+  IN BOOLEAN         Syn
+  )
+{
+  for (UINTN Index = 0; Index < 2; Index++) {
+    if ((mLink->Tcb[Index].LocalEnd.Port == LocalPort) && (mLink->Tcb[Index].RemoteEnd.Port == RemotePort)) {
+      return &mLink->Tcb[Index];
+    }
+  }
+
+  return NULL;
+}
+
+INTN
+TcpInsertTcb (
+  IN TCP_CB  *Tcb
+  )
+{
+  return -1;
+}
+
+TCP_CB *
+TcpCloneTcb (
+  IN TCP_CB  *Tcb
+  )
+{
+  return NULL;
+}
+
+VOID
+TcpSetState (
+  IN TCP_CB  *Tcb,
+  IN UINT8   State
+  )
+{
+  Tcb->State = State;
+}
+
+UINT16
+TcpChecksum (
+  IN NET_BUF  *Nbuf,
+  IN UINT16   HeadSum
+  )
+{
+  UINT16  Checksum;
+
+  Checksum = NetbufChecksum (Nbuf);
+  Checksum = NetAddChecksum (Checksum, HeadSum);
+  Checksum = NetAddChecksum (Checksum, HTONS ((UINT16)Nbuf->TotalSize));
+
+  return (UINT16)(~Checksum);
+}
+
+TCP_SEG *
+TcpFormatNetbuf (
+  IN     TCP_CB   *Tcb,
+  IN OUT NET_BUF  *Nbuf
+  )
+{
+  TCP_SEG   *Seg;
+  TCP_HEAD  *Head;
+
+  Seg       = TCPSEG_NETBUF (Nbuf);
+  Head      = (TCP_HEAD *)NetbufGetByte (Nbuf, 0, NULL);
+  Nbuf->Tcp = Head;
+
+  Seg->Seq  = NTOHL (Head->Seq);
+  Seg->Ack  = NTOHL (Head->Ack);
+  Seg->End  = Seg->Seq + (Nbuf->TotalSize - (Head->HeadLen << 2));
+  Seg->Urg  = NTOHS (Head->Urg);
+  Seg->Wnd  = (NTOHS (Head->Wnd) << Tcb->SndWndScale);
+  Seg->Flag = Head->Flag;
+
+  if (TCP_FLG_ON (Seg->Flag, TCP_FLG_SYN)) {
+    Seg->Wnd = NTOHS (Head->Wnd);
+    Seg->End++;
+  }
+
+  if (TCP_FLG_ON (Seg->Flag, TCP_FLG_FIN)) {
+    Seg->End++;
+  }
+
+  return Seg;
+}
+
+VOID
+TcpResetConnection (
+  IN TCP_CB  *Tcb
+  )
+{
+}
+
+INTN
+TcpSendIpPacket (
+  IN TCP_CB          *Tcb,
+  IN NET_BUF         *Nbuf,
+  IN EFI_IP_ADDRESS  *Src,
+  IN EFI_IP_ADDRESS  *Dest,
+  IN UINT8           Version,
+  IN UINT32          OffloadFlags,
+  IN UINT16          SegmentSize
+  )
+{
+  if (mLink != NULL) {
+    return mLink->Send (Tcb, Nbuf, OffloadFlags, SegmentSize);
+  }
+
+  return 0;
+}
+
+UINT32
+SockGetFreeSpace (
+  IN SOCKET  *Sock,
+  IN UINT32  Which
+  )
+{
+  //
+  // The application consumes the received data at once.
+  //
+  if (Which == SOCK_SND_BUF) {
+    return Sock->SndBuffer.HighWater - GET_SND_DATASIZE (Sock);
+  }
+
+  return Sock->RcvBuffer.HighWater;
+}
+
+UINT32
+SockGetDataToSend (
+  IN  SOCKET  *Sock,
+  IN  UINT32  Offset,
+  IN  UINT32  Len,
+  OUT UINT8   *Dest
+  )
+{
+  LINK_SOCKET  *Socket;
+  UINT32       Index;
+
+  Socket = (LINK_SOCKET *)Sock;
+  Len    = MIN (Len, GET_SND_DATASIZE (Sock) - Offset);
+
+  for (Index = 0; Index < Len; Index++) {
+    Dest[Index] = LINK_PATTERN (Socket->Sent + Offset + Index);
+  }
+
+  return Len;
+}
+
+VOID
+SockDataSent (
+  IN OUT SOCKET  *Sock,
+  IN     UINT32  Count
+  )
+{
+  ((LINK_SOCKET *)Sock)->Sent += Count;
+  GET_SND_DATASIZE (Sock)     -= Count;
+}
+
+VOID
+SockDataRcvd (
+  IN OUT SOCKET   *Sock,
+  IN OUT NET_BUF  *NetBuffer,
+  IN     UINT32   UrgLen
+  )
+{
+  LINK_SOCKET         *Socket;
+  std::vector<UINT8>  Data (NetBuffer->TotalSize);
+
+  Socket = (LINK_SOCKET *)Sock;
+  NetbufCopy (NetBuffer, 0, NetBuffer->TotalSize, Data.data ());
+
+  for (UINT32 Index = 0; Index < Data.size (); Index++) {
+    if (Data[Index] != LINK_PATTERN (Socket->Received + Index)) {
+      Socket->Corrupted = TRUE;
+    }
+  }
+
+  Socket->Received += Data.size ();
+}
+
+VOID
+SockNoMoreData (
+  IN OUT SOCKET  *Sock
+  )
+{
+}
+
+////////////////////////////////////////////////////////////////////////
+// TcpSackTest Tests
+////////////////////////////////////////////////////////////////////////
+
+class TcpSackTest : public ::testing::Test {
+protected:
+  TCP_CB        Tcb;
+  TCP_OPTION    Option;
+
+  void
+  SetUp (
+    ) override
+  {
+    ZeroMem (&Tcb, sizeof (Tcb));
+    ZeroMem (&Option, sizeof (Option));
+    InitializeListHead (&Tcb.SndQue);
+    InitializeListHead (&Tcb.RcvQue);
+
+    Tcb.SndUna      = 1000;
+    Tcb.SndNxt      = 20000;
+    Tcb.SackHighRxt = 1000;
+    Tcb.SackHigh    = 1000;
+  }
+
+  void
+  TearDown (
+    ) override
+  {
+    NetbufFreeList (&Tcb.RcvQue);
+  }
+
+  VOID
+  Sack (
+    TCP_SEQNO  Ack,
+    TCP_SEQNO  Left,
+    TCP_SEQNO  Right
+    )
+  {
+    Option.Flag               = TCP_OPTION_RCVD_SACK;
+    Option.SackBlockNum       = 1;
+    Option.SackBlock[0].Left  = Left;
+    Option.SackBlock[0].Right = Right;
+    TcpSackUpdate (&Tcb, Ack, &Option);
+  }
+
+  VOID
+  QueueSegment (
+    TCP_SEQNO  Seq,
+    TCP_SEQNO  End
+    )
+  {
+    NET_BUF  *Nbuf;
+
+    Nbuf = NetbufAlloc (1);
+    ASSERT (Nbuf != NULL);
+    TCPSEG_NETBUF (Nbuf)->Seq = Seq;
+    TCPSEG_NETBUF (Nbuf)->End = End;
+    InsertTailList (&Tcb.RcvQue, &Nbuf->List);
+  }
+};
+
+// Test Description:
+// The scoreboard keeps the blocks sorted, merges the adjacent ones and drops the acknowledged data.
+TEST_F (TcpSackTest, UpdateShouldMergeAndTrimBlocks) {
+  Sack (1000, 5000, 6000);
+  Sack (1000, 3000, 4000);
+  Sack (1000, 4000, 5000);
+  Sack (1000, 8000, 9000);
+
+  ASSERT_EQ (Tcb.SackBlockNum, 2);
+  EXPECT_EQ (Tcb.SackBlock[0].Left, 3000U);
+  EXPECT_EQ (Tcb.SackBlock[0].Right, 6000U);
+  EXPECT_EQ (Tcb.SackBlock[1].Left, 8000U);
+  EXPECT_EQ (Tcb.SackBlock[1].Right, 9000U);
+
+  Option.Flag = 0;
+  TcpSackUpdate (&Tcb, 5000, &Option);
+  ASSERT_EQ (Tcb.SackBlockNum, 2);
+  EXPECT_EQ (Tcb.SackBlock[0].Left, 5000U);
+
+  TcpSackUpdate (&Tcb, 7000, &Option);
+  ASSERT_EQ (Tcb.SackBlockNum, 1);
+  EXPECT_EQ (Tcb.SackBlock[0].Left, 8000U);
+}
+
+// Test Description:
+// The blocks below the acknowledgment, reversed or beyond the sent data are ignored.
+TEST_F (TcpSackTest, UpdateShouldIgnoreInvalidBlocks) {
+  Sack (3000, 2000, 2500);
+  Sack (3000, 6000, 5000);
+  Sack (3000, 19000, 21000);
+
+  EXPECT_EQ (Tcb.SackBlockNum, 0);
+}
+
+// Test Description:
+// A full scoreboard forgets the highest block to keep the lowest ones.
+TEST_F (TcpSackTest, UpdateShouldKeepTheLowestBlocksWhenFull) {
+  for (UINT32 Index = 0; Index < TCP_SACK_SCOREBOARD_SIZE + 2; Index++) {
+    Sack (1000, 19000 - Index * 1000, 19500 - Index * 1000);
+  }
+
+  ASSERT_EQ (Tcb.SackBlockNum, TCP_SACK_SCOREBOARD_SIZE);
+  EXPECT_EQ (Tcb.SackBlock[0].Left, 2000U);
+  EXPECT_EQ (Tcb.SackBlock[TCP_SACK_SCOREBOARD_SIZE - 1].Left, 17000U);
+}
+
+// Test Description:
+// The holes are reported in order and only once per recovery.
+TEST_F (TcpSackTest, NextHoleShouldSkipSackedAndRetransmittedData) {
+  TCP_SEQNO  Seq;
+
+  Sack (1000, 3000, 4000);
+  Sack (1000, 6000, 7000);
+
+  ASSERT_TRUE (TcpSackNextHole (&Tcb, 1000, &Seq));
+  EXPECT_EQ (Seq, 1000U);
+
+  Tcb.SackHighRxt = 3000;
+  ASSERT_TRUE (TcpSackNextHole (&Tcb, 1000, &Seq));
+  EXPECT_EQ (Seq, 4000U);
+
+  Tcb.SackHighRxt = 6000;
+  EXPECT_FALSE (TcpSackNextHole (&Tcb, 1000, &Seq));
+
+  //
+  // The retransmission timer forgets the scoreboard.
+  //
+  TcpSackReset (&Tcb);
+  EXPECT_EQ (Tcb.SackBlockNum, 0);
+  EXPECT_EQ (Tcb.SackHighRxt, Tcb.SndUna);
+  EXPECT_FALSE (TcpSackNextHole (&Tcb, 1000, &Seq));
+}
+
+// Test Description:
+// A retransmission stops at the next SACKed block and is skipped inside one.
+TEST_F (TcpSackTest, ClipRetransmitShouldStopAtSackedData) {
+  Sack (1000, 3000, 4000);
+
+  EXPECT_EQ (TcpSackClipRetransmit (&Tcb, 1000, 1460), 1460U);
+  EXPECT_EQ (TcpSackClipRetransmit (&Tcb, 2000, 1460), 1000U);
+  EXPECT_EQ (TcpSackClipRetransmit (&Tcb, 3500, 1460), 0U);
+  EXPECT_EQ (TcpSackClipRetransmit (&Tcb, 4000, 1460), 1460U);
+}
+
+// Test Description:
+// The pipe counts the data not SACKed nor lost, and the retransmitted data again.
+TEST_F (TcpSackTest, PipeShouldSkipSackedAndLostData) {
+  Tcb.SndMss = 1000;
+  EXPECT_EQ (TcpSackPipe (&Tcb, 1000), 19000U);
+
+  //
+  // Less than three segments are SACKed above 1000-2000, it is not lost.
+  //
+  Sack (1000, 3000, 4000);
+  EXPECT_EQ (TcpSackPipe (&Tcb, 1000), 17000U);
+
+  Tcb.SackHighRxt = 2000;
+  EXPECT_EQ (TcpSackPipe (&Tcb, 1000), 18000U);
+
+  //
+  // Three ranges are SACKed above 1000-3000, and three segments
+  // above 4000-5000, only the hole 6000-7000 is not lost.
+  //
+  Sack (1000, 5000, 6000);
+  Sack (1000, 7000, 8000);
+  EXPECT_EQ (TcpSackPipe (&Tcb, 1000), 14000U);
+
+  //
+  // The acknowledgment leaves the hole 4000-5000 and the data retransmitted in it.
+  //
+  Tcb.SackHighRxt = 4500;
+  EXPECT_EQ (TcpSackPipe (&Tcb, 4000), 13500U);
+}
+
+// Test Description:
+// A duplicated ACK sends nothing while the pipe is full.
+TEST_F (TcpSackTest, FastRecoverShouldWaitForThePipe) {
+  TCP_SEG  Seg;
+
+  ZeroMem (&Seg, sizeof (Seg));
+  Tcb.SndMss       = 1000;
+  Tcb.CtrlFlag     = TCP_CTRL_SND_SACK;
+  Tcb.CongestState = TCP_CONGEST_RECOVER;
+  Tcb.Recover      = Tcb.SndNxt;
+  Tcb.Ssthresh     = 8500;
+  Tcb.CWnd         = 12500;
+  Seg.Ack          = Tcb.SndUna;
+
+  Sack (1000, 2000, 12000);
+  TcpFastRecover (&Tcb, &Seg);
+  EXPECT_EQ (Tcb.CWnd, 12500U);
+  EXPECT_EQ (Tcb.SackHighRxt, 1000U);
+}
+
+// Test Description:
+// The block of the last received segment comes first, the others in sequence order.
+TEST_F (TcpSackTest, BuildBlocksShouldReportTheLastSegmentFirst) {
+  TCP_SACK_BLOCK  Block[TCP_OPTION_MAX_SACK_BLOCK];
+
+  Tcb.RcvNxt = 1000;
+  QueueSegment (2000, 3000);
+  QueueSegment (3000, 4000);
+  QueueSegment (5000, 6000);
+  QueueSegment (7000, 8000);
+  Tcb.RcvSackSeq = 5000;
+
+  ASSERT_EQ (TcpSackBuildBlocks (&Tcb, Block, TCP_OPTION_MAX_SACK_BLOCK), 3);
+  EXPECT_EQ (Block[0].Left, 5000U);
+  EXPECT_EQ (Block[1].Left, 2000U);
+  EXPECT_EQ (Block[1].Right, 4000U);
+  EXPECT_EQ (Block[2].Left, 7000U);
+
+  EXPECT_EQ (TcpSackBuildBlocks (&Tcb, Block, 2), 2);
+
+  Tcb.RcvNxt = 8000;
+  EXPECT_EQ (TcpSackBuildBlocks (&Tcb, Block, TCP_OPTION_MAX_SACK_BLOCK), 0);
+}
+
+////////////////////////////////////////////////////////////////////////
+// TcpSackOptionTest Tests
+////////////////////////////////////////////////////////////////////////
+
+class TcpSackOptionTest : public ::testing::Test {
+protected:
+  UINT8         Buffer[sizeof (TCP_HEAD) + TCP_OPTION_MAX_LEN];
+  TCP_HEAD      *Head;
+  TCP_OPTION    Option;
+
+  void
+  SetUp (
+    ) override
+  {
+    ZeroMem (Buffer, sizeof (Buffer));
+    Head = (TCP_HEAD *)Buffer;
+  }
+
+  INT32
+  Parse (
+    CONST UINT8  *Options,
+    UINT8        Len
+    )
+  {
+    CopyMem (Buffer + sizeof (TCP_HEAD), Options, Len);
+    Head->HeadLen = (UINT8)((sizeof (TCP_HEAD) + Len) >> 2);
+    return TcpParseOption (Head, &Option);
+  }
+};
+
+// Test Description:
+// The SACK permitted option is sent on an active open and parsed back.
+TEST_F (TcpSackOptionTest, SynShouldCarrySackPermitted) {
+  SimulatedLink  Link (0, 0);
+  NET_BUF        *Nbuf;
+  UINT16         Len;
+  UINT8          *Data;
+
+  Nbuf = NetbufAlloc (TCP_MAX_HEAD);
+  ASSERT_NE (Nbuf, nullptr);
+  NetbufReserve (Nbuf, TCP_MAX_HEAD);
+  TCPSEG_NETBUF (Nbuf)->Flag = TCP_FLG_SYN;
+
+  Len = TcpSynBuildOption (&Link.Tcb[0], Nbuf);
+  ASSERT_LE (Len, TCP_OPTION_MAX_LEN);
+  Data = NetbufGetByte (Nbuf, 0, NULL);
+  ASSERT_NE (Data, nullptr);
+  ASSERT_EQ (Parse (Data, (UINT8)Len), 0);
+  EXPECT_TRUE (TCP_FLG_ON (Option.Flag, TCP_OPTION_RCVD_SACK_PERM));
+  NetbufFree (Nbuf);
+
+  //
+  // Not in the SYN/ACK when the peer did not permit SACK.
+  //
+  Nbuf = NetbufAlloc (TCP_MAX_HEAD);
+  ASSERT_NE (Nbuf, nullptr);
+  NetbufReserve (Nbuf, TCP_MAX_HEAD);
+  TCPSEG_NETBUF (Nbuf)->Flag = TCP_FLG_SYN | TCP_FLG_ACK;
+
+  Len = TcpSynBuildOption (&Link.Tcb[0], Nbuf);
+  Data = NetbufGetByte (Nbuf, 0, NULL);
+  ASSERT_EQ (Parse (Data, (UINT8)Len), 0);
+  EXPECT_FALSE (TCP_FLG_ON (Option.Flag, TCP_OPTION_RCVD_SACK_PERM));
+  NetbufFree (Nbuf);
+
+  //
+  // Never when disabled by the application.
+  //
+  Nbuf = NetbufAlloc (TCP_MAX_HEAD);
+  ASSERT_NE (Nbuf, nullptr);
+  NetbufReserve (Nbuf, TCP_MAX_HEAD);
+  TCPSEG_NETBUF (Nbuf)->Flag = TCP_FLG_SYN;
+  TCP_SET_FLG (Link.Tcb[0].CtrlFlag, TCP_CTRL_NO_SACK);
+
+  Len  = TcpSynBuildOption (&Link.Tcb[0], Nbuf);
+  Data = NetbufGetByte (Nbuf, 0, NULL);
+  ASSERT_EQ (Parse (Data, (UINT8)Len), 0);
+  EXPECT_FALSE (TCP_FLG_ON (Option.Flag, TCP_OPTION_RCVD_SACK_PERM));
+  NetbufFree (Nbuf);
+}
+
+// Test Description:
+// The SACK option of an ACK reports the out-of-order data and is parsed back.
+TEST_F (TcpSackOptionTest, AckShouldCarrySackBlocks) {
+  SimulatedLink  Link (TCP_CTRL_SND_SACK, 0);
+  NET_BUF        *Nbuf;
+  NET_BUF        *Segment;
+  UINT16         Len;
+  UINT8          *Data;
+  TCP_CB         *Tcb;
+
+  Tcb = &Link.Tcb[1];
+  for (UINT32 Index = 0; Index < 6; Index++) {
+    Segment = NetbufAlloc (1);
+    ASSERT_NE (Segment, nullptr);
+    TCPSEG_NETBUF (Segment)->Seq = Tcb->RcvNxt + (2 * Index + 1) * LINK_MSS;
+    TCPSEG_NETBUF (Segment)->End = Tcb->RcvNxt + (2 * Index + 2) * LINK_MSS;
+    InsertTailList (&Tcb->RcvQue, &Segment->List);
+  }
+
+  Tcb->RcvSackSeq = Tcb->RcvNxt + 5 * LINK_MSS;
+
+  Nbuf = NetbufAlloc (TCP_MAX_HEAD);
+  ASSERT_NE (Nbuf, nullptr);
+  NetbufReserve (Nbuf, TCP_MAX_HEAD);
+  TCPSEG_NETBUF (Nbuf)->Flag = TCP_FLG_ACK;
+
+  Len = TcpBuildOption (Tcb, Nbuf);
+  ASSERT_EQ (Len, 4 + TCP_OPTION_MAX_SACK_BLOCK * TCP_OPTION_SACK_BLOCK_LEN);
+  Data = NetbufGetByte (Nbuf, 0, NULL);
+  ASSERT_EQ (Parse (Data, (UINT8)Len), 0);
+  ASSERT_TRUE (TCP_FLG_ON (Option.Flag, TCP_OPTION_RCVD_SACK));
+  ASSERT_EQ (Option.SackBlockNum, TCP_OPTION_MAX_SACK_BLOCK);
+  EXPECT_EQ (Option.SackBlock[0].Left, Tcb->RcvNxt + 5 * LINK_MSS);
+  EXPECT_EQ (Option.SackBlock[1].Left, Tcb->RcvNxt + LINK_MSS);
+  EXPECT_EQ (Option.SackBlock[1].Right, Tcb->RcvNxt + 2 * LINK_MSS);
+  NetbufFree (Nbuf);
+
+  //
+  // The segments with data don't carry the option.
+  //
+  Nbuf = NetbufAlloc (TCP_MAX_HEAD + 1);
+  ASSERT_NE (Nbuf, nullptr);
+  NetbufReserve (Nbuf, TCP_MAX_HEAD);
+  NetbufAllocSpace (Nbuf, 1, NET_BUF_TAIL);
+  TCPSEG_NETBUF (Nbuf)->Flag = TCP_FLG_ACK;
+  EXPECT_EQ (TcpBuildOption (Tcb, Nbuf), 0);
+  NetbufFree (Nbuf);
+}
+
+// Test Description:
+// A malformed SACK option is rejected.
+TEST_F (TcpSackOptionTest, MalformedSackShouldBeRejected) {
+  CONST UINT8  Short[]     = { TCP_OPTION_SACK, 6, 0, 0, 0, 1, TCP_OPTION_EOP, 0 };
+  CONST UINT8  Permitted[] = { TCP_OPTION_SACK_PERM, 3, 0, 0 };
+  CONST UINT8  Valid[]     = { TCP_OPTION_NOP, TCP_OPTION_NOP, TCP_OPTION_SACK, 10, 0, 0, 0, 1, 0, 0, 0, 2 };
+
+  EXPECT_EQ (Parse (Short, sizeof (Short)), -1);
+  EXPECT_EQ (Parse (Permitted, sizeof (Permitted)), -1);
+  ASSERT_EQ (Parse (Valid, sizeof (Valid)), 0);
+  ASSERT_EQ (Option.SackBlockNum, 1);
+  EXPECT_EQ (Option.SackBlock[0].Left, 1U);
+  EXPECT_EQ (Option.SackBlock[0].Right, 2U);
+}
+
+////////////////////////////////////////////////////////////////////////
+// TcpCongestionTest Tests
+////////////////////////////////////////////////////////////////////////
+
+class TcpCongestionTest : public ::testing::Test {
+protected:
+  LINK_RESULT    Reno;
+  LINK_RESULT    Sack;
+  LINK_RESULT    Cubic;
+
+  LINK_RESULT
+  Run (
+    UINT32  CtrlFlag,
+    UINT32  LossPerMillion
+    )
+  {
+    SimulatedLink  Link (CtrlFlag, LossPerMillion);
+
+    EXPECT_TRUE (Link.Transfer (LINK_TRANSFER));
+    return Link.Result;
+  }
+
+  VOID
+  Compare (
+    UINT32  LossPerMillion
+    )
+  {
+    Reno  = Run (TCP_CTRL_NO_SACK, LossPerMillion);
+    Sack  = Run (TCP_CTRL_SND_SACK, LossPerMillion);
+    Cubic = Run (TCP_CTRL_SND_SACK | TCP_CTRL_CUBIC, LossPerMillion);
+
+    printf (
+      "8 MB at %u Mbps, %u ms, %u.%u%% loss: NewReno %llu kbps (%u drops, %u RTO), "
+      "SACK %llu kbps (%u drops, %u RTO), SACK+CUBIC %llu kbps (%u drops, %u RTO)\n",
+      LINK_RATE_MBPS,
+      LINK_RTT_MS,
+      LossPerMillion / 10000,
+      LossPerMillion / 1000 % 10,
+      (unsigned long long)Reno.Goodput,
+      Reno.Dropped,
+      Reno.Timeouts,
+      (unsigned long long)Sack.Goodput,
+      Sack.Dropped,
+      Sack.Timeouts,
+      (unsigned long long)Cubic.Goodput,
+      Cubic.Dropped,
+      Cubic.Timeouts
+      );
+  }
+};
+
+// Test Description:
+// The bottleneck queue overflows at the end of the slow start and drops hundreds of
+// segments of the same window. NewReno recovers one of them per round trip, SACK
+// recovers them all in a few round trips.
+TEST_F (TcpCongestionTest, SackShouldRecoverFromTheSlowStartOverflow) {
+  Compare (0);
+
+  EXPECT_GT (Sack.Goodput, 4 * Reno.Goodput);
+  EXPECT_LE (Sack.Timeouts, Reno.Timeouts);
+}
+
+// Test Description:
+// SACK recovers several random losses per window in one round trip.
+TEST_F (TcpCongestionTest, SackShouldRecoverFasterFromRandomLoss) {
+  Compare (1000);
+
+  EXPECT_GT (Sack.Goodput, 2 * Reno.Goodput);
+  EXPECT_LE (Sack.Timeouts, Reno.Timeouts);
+}
+
+// Test Description:
+// With a high loss rate the window stays small and the losses are isolated,
+// SACK then performs as NewReno.
+TEST_F (TcpCongestionTest, SackShouldMatchRenoWithIsolatedLoss) {
+  Compare (10000);
+
+  EXPECT_GE (Sack.Goodput, Reno.Goodput * 9 / 10);
+  EXPECT_GE (Cubic.Goodput, Reno.Goodput * 9 / 10);
+}
+
+// Test Description:
+// CUBIC grows back faster than the linear growth after a loss.
+TEST_F (TcpCongestionTest, CubicShouldGrowFasterThanReno) {
+  Compare (1000);
+
+  EXPECT_GT (Cubic.Goodput, Sack.Goodput);
+}
+
+////////////////////////////////////////////////////////////////////////
+// TcpLargeSendTest Tests
+////////////////////////////////////////////////////////////////////////
+
+class TcpLargeSendTest : public ::testing::Test {
+protected:
+  VOID
+  EnableOffload (
+    SimulatedLink  &Link,
+    UINT32         Capabilities
+    )
+  {
+    Link.Tcb[0].OffloadCapabilities = Capabilities;
+    Link.Tcb[0].MaxLargeSendSize    = 16 * LINK_MSS + LINK_MSS / 2;
+  }
+};
+
+// Test Description:
+// New data is handed to the interface in multiples of the MSS up to the
+// largest send, and the stream arrives intact once the interface split it.
+TEST_F (TcpLargeSendTest, LargeSendsShouldCarryWholeSegments) {
+  SimulatedLink  Link (TCP_CTRL_SND_SACK, 0);
+
+  EnableOffload (Link, EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND);
+
+  ASSERT_TRUE (Link.Transfer (LINK_TRANSFER));
+  EXPECT_GT (Link.Result.LargeSends, 0U);
+  EXPECT_EQ (Link.Result.LargestSend, 16U * LINK_MSS);
+}
+
+// Test Description:
+// The losses are recovered with retransmissions of one segment, which
+// split the large sends queued for retransmission.
+TEST_F (TcpLargeSendTest, LargeSendsShouldRecoverFromLoss) {
+  SimulatedLink  Link (TCP_CTRL_SND_SACK, 1000);
+
+  EnableOffload (Link, EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND);
+
+  ASSERT_TRUE (Link.Transfer (LINK_TRANSFER));
+  EXPECT_GT (Link.Result.Dropped, 0U);
+  EXPECT_GT (Link.Result.LargeSends, 0U);
+}
+
+// Test Description:
+// Without the large send, only the checksum is left to the interface and
+// the segments keep the size of the MSS.
+TEST_F (TcpLargeSendTest, ChecksumOffloadShouldKeepTheSegmentSize) {
+  SimulatedLink  Link (TCP_CTRL_SND_SACK, 0);
+
+  EnableOffload (Link, EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM);
+
+  ASSERT_TRUE (Link.Transfer (LINK_TRANSFER));
+  EXPECT_EQ (Link.Result.LargeSends, 0U);
+}
+
+// Test Description:
+// When the interface stops segmenting, the rejected large send is sent
+// again in segments of the MSS without waiting for a retransmission.
+TEST_F (TcpLargeSendTest, RejectedLargeSendShouldBeSentAgainInSegments) {
+  SimulatedLink  Link (TCP_CTRL_SND_SACK, 0);
+
+  EnableOffload (Link, EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM | EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND);
+  Link.RejectLargeSend = TRUE;
+
+  ASSERT_TRUE (Link.Transfer (LINK_TRANSFER));
+  EXPECT_EQ (Link.Result.LargeSends, 0U);
+  EXPECT_EQ (Link.Result.Timeouts, 0U);
+  EXPECT_EQ (Link.Tcb[0].OffloadCapabilities, (UINT32)EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM);
+}
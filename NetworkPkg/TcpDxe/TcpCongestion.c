@@ -0,0 +1,203 @@
+/** @file
+  Growth and reduction of the TCP congestion window.
+
+  The window grows as specified in RFC5681 by default. When PcdTcpCongestionControl
+  selects CUBIC, the growth in congestion avoidance follows the cubic function
+  of RFC8312 instead, so that the window comes back quickly to its size before
+  the last loss on links with a large bandwidth-delay product. The time is
+  measured with the TCP heartbeat, so the window grows in steps of TCP_TICK.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "TcpMain.h"
+
+#define TCP_CUBIC_BETA        717         ///< Multiplicative decrease factor, scaled by 1024.
+#define TCP_CUBIC_FRIENDLY    542         ///< 3 * (1 - BETA) / (1 + BETA), scaled by 1024.
+#define TCP_CUBIC_C_INVERSE   2500000000U ///< 1 / C, in cubic milliseconds per segment.
+#define TCP_CUBIC_MAX_OFFSET  50000       ///< Largest distance to the inflection point in ms.
+
+/**
+  Compute the integer cube root of a value.
+
+  @param[in]  Value   The value.
+
+  @return The largest integer whose cube is not above Value.
+
+**/
+STATIC
+UINT32
+TcpCubeRoot (
+  IN UINT64  Value
+  )
+{
+  UINT64  Root;
+  UINT64  Step;
+  INTN    Shift;
+
+  Root = 0;
+
+  for (Shift = 63; Shift >= 0; Shift -= 3) {
+    Root = LShiftU64 (Root, 1);
+    Step = MultU64x64 (MultU64x64 (3, Root), Root + 1) + 1;
+
+    if (RShiftU64 (Value, Shift) >= Step) {
+      Value -= LShiftU64 (Step, Shift);
+      Root++;
+    }
+  }
+
+  return (UINT32)Root;
+}
+
+/**
+  Compute the increase of the congestion window for an ACK in the congestion
+  avoidance of CUBIC.
+
+  @param[in, out]  Tcb      Pointer to the TCP_CB of this TCP instance.
+
+  @return The increase in bytes.
+
+**/
+STATIC
+UINT32
+TcpCubicIncrease (
+  IN OUT TCP_CB  *Tcb
+  )
+{
+  UINT64  Time;
+  UINT64  Offset;
+  UINT64  Delta;
+  UINT64  Target;
+  UINT32  Increase;
+  UINT32  Friendly;
+
+  //
+  // A new epoch begins with the first ACK in congestion
+  // avoidance. K is the time to grow back to WMax.
+  //
+  if (Tcb->CubicEpoch == 0) {
+    Tcb->CubicEpoch = (mTcpTick != 0) ? mTcpTick : 1;
+
+    if (Tcb->CubicWMax > Tcb->CWnd) {
+      Tcb->CubicK = TcpCubeRoot (
+                      DivU64x32 (
+                        MultU64x32 (Tcb->CubicWMax - Tcb->CWnd, TCP_CUBIC_C_INVERSE),
+                        Tcb->SndMss
+                        )
+                      );
+    } else {
+      Tcb->CubicWMax = Tcb->CWnd;
+      Tcb->CubicK    = 0;
+    }
+  }
+
+  //
+  // W(t + RTT) = C * (t + RTT - K)^3 + WMax
+  //
+  Time = MultU64x32 (
+           TCP_SUB_TIME (mTcpTick, Tcb->CubicEpoch) + (Tcb->SRtt >> TCP_RTT_SHIFT),
+           TCP_TICK
+           );
+
+  if (Time < Tcb->CubicK) {
+    Offset = Tcb->CubicK - Time;
+  } else {
+    Offset = Time - Tcb->CubicK;
+  }
+
+  Offset = MIN (Offset, TCP_CUBIC_MAX_OFFSET);
+  Delta  = DivU64x32 (
+             MultU64x32 (MultU64x64 (MultU64x64 (Offset, Offset), Offset), Tcb->SndMss),
+             TCP_CUBIC_C_INVERSE
+             );
+
+  if (Time < Tcb->CubicK) {
+    Target = (Delta < Tcb->CubicWMax) ? Tcb->CubicWMax - Delta : 0;
+  } else {
+    Target = Tcb->CubicWMax + Delta;
+  }
+
+  //
+  // Grow by at most half of the window per RTT.
+  //
+  Target   = MIN (Target, (UINT64)Tcb->CWnd + (Tcb->CWnd >> 1));
+  Increase = 0;
+
+  if (Target > Tcb->CWnd) {
+    Increase = (UINT32)DivU64x32 (MultU64x32 (Target - Tcb->CWnd, Tcb->SndMss), Tcb->CWnd);
+  }
+
+  //
+  // Never grow slower than a standard TCP with the same
+  // decrease factor would, as in the TCP-friendly region.
+  //
+  Friendly = (UINT32)RShiftU64 (
+                       DivU64x32 (MultU64x32 ((UINT32)Tcb->SndMss * Tcb->SndMss, TCP_CUBIC_FRIENDLY), Tcb->CWnd),
+                       10
+                       );
+
+  return MAX (MAX (Increase, Friendly), 1);
+}
+
+/**
+  Grow the congestion window for an ACK of new data out of the fast recovery.
+
+  @param[in, out]  Tcb      Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpCongestionGrow (
+  IN OUT TCP_CB  *Tcb
+  )
+{
+  if (Tcb->CWnd < Tcb->Ssthresh) {
+    Tcb->CWnd += Tcb->SndMss;
+  } else if (TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_CUBIC)) {
+    Tcb->CWnd += TcpCubicIncrease (Tcb);
+  } else {
+    Tcb->CWnd += MAX (Tcb->SndMss * Tcb->SndMss / Tcb->CWnd, 1);
+  }
+
+  Tcb->CWnd = MIN (Tcb->CWnd, TCP_MAX_WIN << Tcb->SndWndScale);
+}
+
+/**
+  Reduce the slow start threshold after a loss, detected either by duplicate
+  ACKs or by the retransmission timer.
+
+  @param[in, out]  Tcb      Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpCongestionReduce (
+  IN OUT TCP_CB  *Tcb
+  )
+{
+  UINT32  FlightSize;
+
+  FlightSize = TCP_SUB_SEQ (Tcb->SndNxt, Tcb->SndUna);
+
+  if (!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_CUBIC)) {
+    Tcb->Ssthresh = MAX (FlightSize >> 1, (UINT32)(2 * Tcb->SndMss));
+    return;
+  }
+
+  //
+  // Fast convergence: release some bandwidth to the new flows
+  // when the window did not grow back to the previous WMax.
+  //
+  if (FlightSize < Tcb->CubicWMax) {
+    Tcb->CubicWMax = (UINT32)DivU64x32 (MultU64x32 (FlightSize, 1024 + TCP_CUBIC_BETA), 2048);
+  } else {
+    Tcb->CubicWMax = FlightSize;
+  }
+
+  Tcb->CubicEpoch = 0;
+  Tcb->Ssthresh   = MAX (
+                      (UINT32)DivU64x32 (MultU64x32 (FlightSize, TCP_CUBIC_BETA), 1024),
+                      (UINT32)(2 * Tcb->SndMss)
+                      );
+}
@@ -118,7 +118,7 @@ Tcp4GetMode (
       Option->EnableTimeStamp     = (BOOLEAN)(!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_TS));
       Option->EnableWindowScaling = (BOOLEAN)(!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_WS));
 
-      Option->EnableSelectiveAck     = FALSE;
+      Option->EnableSelectiveAck     = (BOOLEAN)(!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_SACK)); // MU_CHANGE - SACK and CUBIC congestion control
       Option->EnablePathMtuDiscovery = FALSE;
     }
   }
@@ -195,7 +195,7 @@ Tcp6GetMode (
       Option->EnableTimeStamp     = (BOOLEAN)(!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_TS));
       Option->EnableWindowScaling = (BOOLEAN)(!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_WS));
 
-      Option->EnableSelectiveAck     = FALSE;
+      Option->EnableSelectiveAck     = (BOOLEAN)(!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_SACK)); // MU_CHANGE - SACK and CUBIC congestion control
       Option->EnablePathMtuDiscovery = FALSE;
     }
   }
@@ -703,8 +703,24 @@ TcpConfigurePcb (
     if (!Option->EnableWindowScaling) {
       TCP_SET_FLG (Tcb->CtrlFlag, TCP_CTRL_NO_WS);
     }
+
+    // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+    if (!Option->EnableSelectiveAck) {
+      TCP_SET_FLG (Tcb->CtrlFlag, TCP_CTRL_NO_SACK);
+    }
+  } else {
+    //
+    // SACK is disabled by default, as specified by UEFI.
+    //
+    TCP_SET_FLG (Tcb->CtrlFlag, TCP_CTRL_NO_SACK);
+  }
+
+  if (PcdGet8 (PcdTcpCongestionControl) == TCP_CONGESTION_CONTROL_CUBIC) {
+    TCP_SET_FLG (Tcb->CtrlFlag, TCP_CTRL_CUBIC);
   }
 
+  // MU_CHANGE [END]
+
   //
   // The socket is bound, the <SrcIp, SrcPort, DstIp, DstPort> is
   // determined, construct the IP device path and install it.
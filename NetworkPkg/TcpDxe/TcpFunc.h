@@ -479,6 +479,8 @@ TcpIcmpInput (
                        address.
   @param[in]  Version  IP_VERSION_4 indicates IP4 stack, IP_VERSION_6 indicates
                        IP6 stack.
+  @param[in]  OffloadFlags  The EDKII_IP4_OFFLOAD_RX_* checksums verified by
+                            the interface.
 
   @retval 0        The segment processed successfully. It is either accepted or
                    discarded. But no connection is reset by the segment.
@@ -490,7 +492,8 @@ TcpInput (
   IN NET_BUF         *Nbuf,
   IN EFI_IP_ADDRESS  *Src,
   IN EFI_IP_ADDRESS  *Dst,
-  IN UINT8           Version
+  IN UINT8           Version,
+  IN UINT32          OffloadFlags   // MU_CHANGE - Network offloads
   );
 
 //
@@ -583,6 +586,138 @@ TcpSetKeepaliveTimer (
   IN OUT TCP_CB  *Tcb
   );
 
+// MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+//
+// Functions in TcpSack.c
+//
+
+/**
+  Build the blocks of the SACK option from the reassemble queue.
+
+  The first block contains the most recently received segment, as required by
+  RFC2018, the others follow in the order of the sequence numbers.
+
+  @param[in]   Tcb       Pointer to the TCP_CB of this TCP instance.
+  @param[out]  Block     Array of at least Max blocks to fill.
+  @param[in]   Max       Maximum number of blocks.
+
+  @return The number of blocks filled, zero if all the data is in order.
+
+**/
+UINT8
+TcpSackBuildBlocks (
+  IN  TCP_CB          *Tcb,
+  OUT TCP_SACK_BLOCK  *Block,
+  IN  UINT8           Max
+  );
+
+/**
+  Forget the data SACKed by the peer.
+
+  @param[in, out]  Tcb     Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpSackReset (
+  IN OUT TCP_CB  *Tcb
+  );
+
+/**
+  Update the scoreboard with the acknowledgment and the SACK option of a
+  received segment.
+
+  @param[in, out]  Tcb     Pointer to the TCP_CB of this TCP instance.
+  @param[in]       Ack     The acknowledge sequence number of the segment.
+  @param[in]       Option  The options of the segment.
+
+**/
+VOID
+TcpSackUpdate (
+  IN OUT TCP_CB      *Tcb,
+  IN     TCP_SEQNO   Ack,
+  IN     TCP_OPTION  *Option
+  );
+
+/**
+  Find the next hole to retransmit during the loss recovery.
+
+  @param[in]   Tcb     Pointer to the TCP_CB of this TCP instance.
+  @param[in]   Una     The first unacknowledged sequence number.
+  @param[out]  Seq     The first sequence number of the hole.
+
+  @retval TRUE         A hole is found.
+  @retval FALSE        There is no hole to retransmit.
+
+**/
+BOOLEAN
+TcpSackNextHole (
+  IN  TCP_CB     *Tcb,
+  IN  TCP_SEQNO  Una,
+  OUT TCP_SEQNO  *Seq
+  );
+
+/**
+  Estimate the number of bytes outstanding in the network during the loss
+  recovery, as the SetPipe() procedure of RFC6675.
+
+  @param[in]  Tcb      Pointer to the TCP_CB of this TCP instance.
+  @param[in]  Una      The first unacknowledged sequence number.
+
+  @return The number of bytes in the pipe.
+
+**/
+UINT32
+TcpSackPipe (
+  IN TCP_CB     *Tcb,
+  IN TCP_SEQNO  Una
+  );
+
+/**
+  Limit the length of a retransmission to the data not SACKed by the peer.
+
+  @param[in]  Tcb      Pointer to the TCP_CB of this TCP instance.
+  @param[in]  Seq      The sequence number of the retransmission.
+  @param[in]  Len      The maximum length of the retransmission.
+
+  @return The length to retransmit, zero if the data at Seq is SACKed.
+
+**/
+UINT32
+TcpSackClipRetransmit (
+  IN TCP_CB     *Tcb,
+  IN TCP_SEQNO  Seq,
+  IN UINT32     Len
+  );
+
+//
+// Functions in TcpCongestion.c
+//
+
+/**
+  Grow the congestion window for an ACK of new data out of the fast recovery.
+
+  @param[in, out]  Tcb      Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpCongestionGrow (
+  IN OUT TCP_CB  *Tcb
+  );
+
+/**
+  Reduce the slow start threshold after a loss, detected either by duplicate
+  ACKs or by the retransmission timer.
+
+  @param[in, out]  Tcb      Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpCongestionReduce (
+  IN OUT TCP_CB  *Tcb
+  );
+
+// MU_CHANGE [END]
+
 //
 // Functions in TcpIo.c
 //
@@ -618,6 +753,9 @@ TcpRxCallback (
   @param[in]  Src                Source address of the TCP segment.
   @param[in]  Dest               Destination address of the TCP segment.
   @param[in]  Version            IP_VERSION_4 or IP_VERSION_6
+  @param[in]  OffloadFlags       The EDKII_IP4_OFFLOAD_TX_* flags of the segment,
+                                 taken from Tcb->OffloadCapabilities.
+  @param[in]  SegmentSize        The TCP payload of each segment of a large send.
 
   @retval 0                      The segment was sent out successfully.
   @retval -1                     The segment failed to be sent.
@@ -629,9 +767,26 @@ TcpSendIpPacket (
   IN NET_BUF         *Nbuf,
   IN EFI_IP_ADDRESS  *Src,
   IN EFI_IP_ADDRESS  *Dest,
-  IN UINT8           Version
+  IN UINT8           Version,
+  IN UINT32          OffloadFlags,  // MU_CHANGE - Network offloads
+  IN UINT16          SegmentSize    // MU_CHANGE - Network offloads
   );
 
+// MU_CHANGE [BEGIN] - Network offloads
+
+/**
+  Get the offloads of the IP instance that sends the segments of the TCB.
+
+  @param[in, out]  Tcb           Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpRefreshOffload (
+  IN OUT TCP_CB  *Tcb
+  );
+
+// MU_CHANGE [END]
+
 /**
   Refresh the remote peer's Neighbor Cache State if already exists.
 
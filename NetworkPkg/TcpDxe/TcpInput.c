@@ -42,8 +42,9 @@ TcpFastRecover (
   IN     TCP_SEG  *Seg
   )
 {
-  UINT32  FlightSize;
-  UINT32  Acked;
+  UINT32     FlightSize;
+  UINT32     Acked;
+  TCP_SEQNO  Hole; // MU_CHANGE - SACK and CUBIC congestion control
 
   //
   // Step 1: Three duplicate ACKs and not in fast recovery
@@ -52,10 +53,11 @@ TcpFastRecover (
     //
     // Step 1A: Invoking fast retransmission.
     //
-    FlightSize = TCP_SUB_SEQ (Tcb->SndNxt, Tcb->SndUna);
-
-    Tcb->Ssthresh = MAX (FlightSize >> 1, (UINT32)(2 * Tcb->SndMss));
-    Tcb->Recover  = Tcb->SndNxt;
+    // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+    TcpCongestionReduce (Tcb);
+    Tcb->Recover     = Tcb->SndNxt;
+    Tcb->SackHighRxt = Tcb->SndUna;
+    // MU_CHANGE [END]
 
     Tcb->CongestState = TCP_CONGEST_RECOVER;
     TCP_CLEAR_FLG (Tcb->CtrlFlag, TCP_CTRL_RTT_ON);
@@ -87,7 +89,31 @@ TcpFastRecover (
     // Step 4 is skipped here only to be executed later
     // by TcpToSendData
     //
-    Tcb->CWnd += Tcb->SndMss;
+    // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+    // With SACK, nothing is sent unless the pipe leaves
+    // room for a segment, as RFC6675 section 5. Then the
+    // duplicated ACK is spent on the next hole if there
+    // is one, or on a segment of new data.
+    //
+    if (TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_SND_SACK)) {
+      if (TcpSackPipe (Tcb, Seg->Ack) + Tcb->SndMss > Tcb->Ssthresh) {
+        return;
+      }
+
+      if (TcpSackNextHole (Tcb, Seg->Ack, &Hole) &&
+          (TcpRetransmit (Tcb, Hole) == 0) &&
+          TCP_SEQ_GT (Tcb->SackHighRxt, Hole))
+      {
+        return;
+      }
+
+      FlightSize = TCP_SUB_SEQ (Tcb->SndNxt, Tcb->SndUna);
+      Tcb->CWnd  = MAX (Tcb->CWnd, FlightSize + Tcb->SndMss);
+    } else {
+      Tcb->CWnd += Tcb->SndMss;
+    }
+
+    // MU_CHANGE [END]
     DEBUG (
       (DEBUG_NET,
        "TcpFastRecover: received another duplicated ACK (%d) for TCB %p\n",
@@ -121,7 +147,21 @@ TcpFastRecover (
       // fast retransmit the first unacknowledge field
       // , then deflate the CWnd
       //
-      TcpRetransmit (Tcb, Seg->Ack);
+      // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+      // With SACK, retransmit the first hole not retransmitted
+      // yet, which is the first unacknowledged field unless
+      // it is already retransmitted, when the pipe leaves
+      // room for a segment.
+      //
+      if (!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_SND_SACK)) {
+        TcpRetransmit (Tcb, Seg->Ack);
+      } else if ((TcpSackPipe (Tcb, Seg->Ack) + Tcb->SndMss <= Tcb->Ssthresh) &&
+                 TcpSackNextHole (Tcb, Seg->Ack, &Hole))
+      {
+        TcpRetransmit (Tcb, Hole);
+      }
+
+      // MU_CHANGE [END]
       Acked = TCP_SUB_SEQ (Seg->Ack, Tcb->SndUna);
 
       //
@@ -563,6 +603,17 @@ TcpQueueData (
   Seg  = TCPSEG_NETBUF (Nbuf);
   Head = &Tcb->RcvQue;
 
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  //
+  // Remember the last out-of-order segment for the
+  // first block of the SACK option.
+  //
+  if (TCP_SEQ_GT (Seg->Seq, Tcb->RcvNxt)) {
+    Tcb->RcvSackSeq = Seg->Seq;
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Fast path to process normal case. That is,
   // no out-of-order segments are received.
@@ -700,6 +751,8 @@ TcpAdjustSndQue (
                        address.
   @param[in]  Version  IP_VERSION_4 indicates IP4 stack. IP_VERSION_6 indicates
                        IP6 stack.
+  @param[in]  OffloadFlags  The EDKII_IP4_OFFLOAD_RX_* checksums verified by
+                            the interface.
 
   @retval 0        Segment  processed successfully. It is either accepted or
                    discarded. However, no connection is reset by the segment.
@@ -711,7 +764,8 @@ TcpInput (
   IN NET_BUF         *Nbuf,
   IN EFI_IP_ADDRESS  *Src,
   IN EFI_IP_ADDRESS  *Dst,
-  IN UINT8           Version
+  IN UINT8           Version,
+  IN UINT32          OffloadFlags   // MU_CHANGE - Network offloads
   )
 {
   TCP_CB      *Tcb;
@@ -755,13 +809,23 @@ TcpInput (
     goto DISCARD;
   }
 
-  if (Version == IP_VERSION_4) {
-    Checksum = NetPseudoHeadChecksum (Src->Addr[0], Dst->Addr[0], 6, 0);
+  // MU_CHANGE [BEGIN] - Network offloads
+  if ((Version == IP_VERSION_4) && ((OffloadFlags & EDKII_IP4_OFFLOAD_RX_TCP4_CHECKSUM) != 0)) {
+    //
+    // The interface has verified the checksum.
+    //
+    Checksum = 0;
   } else {
-    Checksum = NetIp6PseudoHeadChecksum (&Src->v6, &Dst->v6, 6, 0);
+    if (Version == IP_VERSION_4) {
+      Checksum = NetPseudoHeadChecksum (Src->Addr[0], Dst->Addr[0], 6, 0);
+    } else {
+      Checksum = NetIp6PseudoHeadChecksum (&Src->v6, &Dst->v6, 6, 0);
+    }
+
+    Checksum = TcpChecksum (Nbuf, Checksum);
   }
 
-  Checksum = TcpChecksum (Nbuf, Checksum);
+  // MU_CHANGE [END]
 
   if (Checksum != 0) {
     DEBUG ((DEBUG_ERROR, "TcpInput: received a checksum error packet\n"));
@@ -1225,6 +1289,13 @@ TcpInput (
     TcpSetTimer (Tcb, TCP_TIMER_REXMIT, Tcb->Rto);
   }
 
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  if (TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_SND_SACK)) {
+    TcpSackUpdate (Tcb, Seg->Ack, &Option);
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Count duplicate acks.
   //
@@ -1245,13 +1316,7 @@ TcpInput (
       (Tcb->CongestState == TCP_CONGEST_LOSS))
   {
     if (TCP_SEQ_GT (Seg->Ack, Tcb->SndUna)) {
-      if (Tcb->CWnd < Tcb->Ssthresh) {
-        Tcb->CWnd += Tcb->SndMss;
-      } else {
-        Tcb->CWnd += MAX (Tcb->SndMss * Tcb->SndMss / Tcb->CWnd, 1);
-      }
-
-      Tcb->CWnd = MIN (Tcb->CWnd, TCP_MAX_WIN << Tcb->SndWndScale);
+      TcpCongestionGrow (Tcb); // MU_CHANGE - SACK and CUBIC congestion control
     }
 
     if (Tcb->CongestState == TCP_CONGEST_LOSS) {
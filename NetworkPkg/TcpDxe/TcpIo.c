@@ -33,7 +33,7 @@ TcpRxCallback (
   )
 {
   if (EFI_SUCCESS == Status) {
-    TcpInput (Pkt, &NetSession->Source, &NetSession->Dest, NetSession->IpVersion);
+    TcpInput (Pkt, &NetSession->Source, &NetSession->Dest, NetSession->IpVersion, NetSession->OffloadFlags); // MU_CHANGE - Network offloads
   } else {
     TcpIcmpInput (
       Pkt,
@@ -53,6 +53,9 @@ TcpRxCallback (
   @param[in]  Src                Source address of the TCP segment.
   @param[in]  Dest               Destination address of the TCP segment.
   @param[in]  Version            IP_VERSION_4 or IP_VERSION_6
+  @param[in]  OffloadFlags       The EDKII_IP4_OFFLOAD_TX_* flags of the segment,
+                                 taken from Tcb->OffloadCapabilities.
+  @param[in]  SegmentSize        The TCP payload of each segment of a large send.
 
   @retval 0                      The segment was sent out successfully.
   @retval -1                     The segment failed to send.
@@ -64,7 +67,9 @@ TcpSendIpPacket (
   IN NET_BUF         *Nbuf,
   IN EFI_IP_ADDRESS  *Src,
   IN EFI_IP_ADDRESS  *Dest,
-  IN UINT8           Version
+  IN UINT8           Version,
+  IN UINT32          OffloadFlags,  // MU_CHANGE - Network offloads
+  IN UINT16          SegmentSize    // MU_CHANGE - Network offloads
   )
 {
   EFI_STATUS      Status;
@@ -73,6 +78,7 @@ TcpSendIpPacket (
   SOCKET          *Sock;
   VOID            *IpSender;
   TCP_PROTO_DATA  *TcpProto;
+  TCP_HEAD        *Head;          // MU_CHANGE - Network offloads
 
   if (NULL == Tcb) {
     IpIo     = NULL;
@@ -125,7 +131,27 @@ TcpSendIpPacket (
     Override.Ip6OverrideData.FlowLabel = 0;
   }
 
-  Status = IpIoSend (IpIo, Nbuf, IpSender, NULL, NULL, Dest, &Override);
+  // MU_CHANGE [BEGIN] - Network offloads
+  Status = IpIoSendWithOffload (IpIo, Nbuf, IpSender, NULL, NULL, Dest, &Override, OffloadFlags, SegmentSize);
+
+  if ((Status == EFI_UNSUPPORTED) && (OffloadFlags != 0) && (Tcb != NULL)) {
+    //
+    // The interface no longer provides the offloads, for example because
+    // IPsec is installed. A large send is split by the caller, a segment
+    // gets its checksum here.
+    //
+    TcpRefreshOffload (Tcb);
+
+    if ((OffloadFlags & EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND) == 0) {
+      Head           = (TCP_HEAD *)Nbuf->Tcp;
+      Head->Checksum = 0;
+      Head->Checksum = TcpChecksum (Nbuf, Tcb->HeadSum);
+
+      Status = IpIoSend (IpIo, Nbuf, IpSender, NULL, NULL, Dest, &Override);
+    }
+  }
+
+  // MU_CHANGE [END]
 
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "TcpSendIpPacket: return %r error\n", Status));
@@ -135,6 +161,63 @@ TcpSendIpPacket (
   return 0;
 }
 
+// MU_CHANGE [BEGIN] - Network offloads
+
+/**
+  Get the offloads of the IP instance that sends the segments of the TCB.
+
+  TCP completes the checksum and segments the data itself when the offloads
+  are not available, which is always the case for IPv6.
+
+  @param[in, out]  Tcb           Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpRefreshOffload (
+  IN OUT TCP_CB  *Tcb
+  )
+{
+  TCP_PROTO_DATA  *TcpProto;
+  UINT32          Capabilities;
+  UINT32          MaxLargeSendSize;
+
+  Tcb->OffloadCapabilities = 0;
+  Tcb->MaxLargeSendSize    = 0;
+
+  if ((Tcb->Sk->IpVersion != IP_VERSION_4) || (Tcb->IpInfo == NULL)) {
+    return;
+  }
+
+  TcpProto = (TCP_PROTO_DATA *)Tcb->Sk->ProtoReserved;
+  IpIoGetOffloadCapabilities (TcpProto->TcpService->IpIo, Tcb->IpInfo, &Capabilities, &MaxLargeSendSize);
+
+  if ((Capabilities & EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM) == 0) {
+    return;
+  }
+
+  Tcb->OffloadCapabilities = EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM;
+
+  //
+  // Leave room for the largest TCP header.
+  //
+  if (((Capabilities & EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND) != 0) &&
+      (MaxLargeSendSize > sizeof (TCP_HEAD) + TCP_OPTION_MAX_LEN))
+  {
+    Tcb->OffloadCapabilities |= EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND;
+    Tcb->MaxLargeSendSize     = MaxLargeSendSize - sizeof (TCP_HEAD) - TCP_OPTION_MAX_LEN;
+  }
+
+  DEBUG (
+    (DEBUG_NET,
+     "TcpRefreshOffload: TCB %p offloads %x, large send %d bytes\n",
+     Tcb,
+     Tcb->OffloadCapabilities,
+     Tcb->MaxLargeSendSize)
+    );
+}
+
+// MU_CHANGE [END]
+
 /**
   Refresh the remote peer's Neighbor Cache State if already exists.
 
@@ -17,6 +17,7 @@
 #include <Library/IpIoLib.h>
 #include <Library/DevicePathLib.h>
 #include <Library/PrintLib.h>
+#include <Library/PcdLib.h> // MU_CHANGE - SACK and CUBIC congestion control
 
 #include "Socket.h"
 #include "TcpProto.h"
@@ -140,6 +140,16 @@ TcpInitTcbLocal (
   Tcb->RcvWndScale   = 0;
   Tcb->RetxmitSeqMax = 0;
 
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  Tcb->SackBlockNum = 0;
+  Tcb->SackHighRxt  = Tcb->Iss;
+  Tcb->SackHigh     = Tcb->Iss;
+  Tcb->CubicWMax    = 0;
+  Tcb->CubicEpoch   = 0;
+  // MU_CHANGE [END]
+
+  TcpRefreshOffload (Tcb); // MU_CHANGE - Network offloads
+
   Tcb->ProbeTimerOn = FALSE;
 
   return EFI_SUCCESS;
@@ -221,6 +231,13 @@ TcpInitTcbPeer (
     //
     Tcb->SndMss -= TCP_OPTION_TS_ALIGNED_LEN;
   }
+
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  if (TCP_FLG_ON (Opt->Flag, TCP_OPTION_RCVD_SACK_PERM) && !TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_SACK)) {
+    TCP_SET_FLG (Tcb->CtrlFlag, TCP_CTRL_SND_SACK);
+  }
+
+  // MU_CHANGE [END]
 }
 
 /**
@@ -1175,7 +1192,7 @@ TcpResetConnection (
   Nhead->Urg      = 0;
   Nhead->Checksum = TcpChecksum (Nbuf, Tcb->HeadSum);
 
-  TcpSendIpPacket (Tcb, Nbuf, &Tcb->LocalEnd.Ip, &Tcb->RemoteEnd.Ip, Tcb->Sk->IpVersion);
+  TcpSendIpPacket (Tcb, Nbuf, &Tcb->LocalEnd.Ip, &Tcb->RemoteEnd.Ip, Tcb->Sk->IpVersion, 0, 0); // MU_CHANGE - Network offloads
 
   NetbufFree (Nbuf);
 }
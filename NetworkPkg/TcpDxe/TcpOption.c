@@ -172,6 +172,34 @@ TcpSynBuildOption (
     TcpPutUint32 (Data, TCP_OPTION_WS_FAST | TcpComputeScale (Tcb));
   }
 
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  //
+  // Build SACK permitted option, only when configured
+  // to use SACK, and either we are doing active open
+  // or we have received SACK permitted option from peer.
+  //
+  if (!TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_NO_SACK) &&
+      (!TCP_FLG_ON (TCPSEG_NETBUF (Nbuf)->Flag, TCP_FLG_ACK) ||
+       TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_SND_SACK))
+      )
+  {
+    Data = NetbufAllocSpace (
+             Nbuf,
+             TCP_OPTION_SACK_PERM_ALIGNED_LEN,
+             NET_BUF_HEAD
+             );
+
+    if (Data == NULL) {
+      ASSERT (Data != NULL);
+      return 0;
+    }
+
+    Len += TCP_OPTION_SACK_PERM_ALIGNED_LEN;
+    TcpPutUint32 (Data, TCP_OPTION_SACK_PERM_FAST);
+  }
+
+  // MU_CHANGE [END]
+
   //
   // Build the MSS option.
   //
@@ -205,8 +233,11 @@ TcpBuildOption (
   IN NET_BUF  *Nbuf
   )
 {
-  UINT8   *Data;
-  UINT16  Len;
+  UINT8           *Data;
+  UINT16          Len;
+  TCP_SACK_BLOCK  Block[TCP_OPTION_MAX_SACK_BLOCK]; // MU_CHANGE - SACK and CUBIC congestion control
+  UINT8           BlockNum;                         // MU_CHANGE - SACK and CUBIC congestion control
+  UINT8           Index;                            // MU_CHANGE - SACK and CUBIC congestion control
 
   ASSERT ((Tcb != NULL) && (Nbuf != NULL) && (Nbuf->Tcp == NULL));
   Len = 0;
@@ -238,6 +269,51 @@ TcpBuildOption (
     TcpPutUint32 (Data + 8, Tcb->TsRecent);
   }
 
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  //
+  // Build the SACK option to report the out-of-order data
+  // in the reassemble queue. It is only added to segments
+  // without data, so the segment never exceeds SndMss.
+  //
+  if (TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_SND_SACK) &&
+      !TCP_FLG_ON (TCPSEG_NETBUF (Nbuf)->Flag, TCP_FLG_RST) &&
+      (Nbuf->TotalSize == 0)
+      )
+  {
+    BlockNum = TcpSackBuildBlocks (
+                 Tcb,
+                 Block,
+                 (UINT8)MIN (
+                          TCP_OPTION_MAX_SACK_BLOCK,
+                          (TCP_OPTION_MAX_LEN - Len - 4) / TCP_OPTION_SACK_BLOCK_LEN
+                          )
+                 );
+
+    if (BlockNum != 0) {
+      Data = NetbufAllocSpace (
+               Nbuf,
+               4 + BlockNum * TCP_OPTION_SACK_BLOCK_LEN,
+               NET_BUF_HEAD
+               );
+
+      if (Data == NULL) {
+        ASSERT (Data != NULL);
+        return 0;
+      }
+
+      Len = (UINT16)(Len + 4 + BlockNum * TCP_OPTION_SACK_BLOCK_LEN);
+
+      TcpPutUint32 (Data, TCP_OPTION_SACK_FAST + BlockNum * TCP_OPTION_SACK_BLOCK_LEN);
+
+      for (Index = 0; Index < BlockNum; Index++) {
+        TcpPutUint32 (Data + 4 + Index * TCP_OPTION_SACK_BLOCK_LEN, Block[Index].Left);
+        TcpPutUint32 (Data + 8 + Index * TCP_OPTION_SACK_BLOCK_LEN, Block[Index].Right);
+      }
+    }
+  }
+
+  // MU_CHANGE [END]
+
   return Len;
 }
 
@@ -263,6 +339,7 @@ TcpParseOption (
   UINT8  Cur;
   UINT8  Type;
   UINT8  Len;
+  UINT8  Index; // MU_CHANGE - SACK and CUBIC congestion control
 
   ASSERT ((Tcp != NULL) && (Option != NULL));
 
@@ -335,6 +412,44 @@ TcpParseOption (
         Cur += TCP_OPTION_TS_LEN;
         break;
 
+      // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+      case TCP_OPTION_SACK_PERM:
+        Len = Head[Cur + 1];
+
+        if ((Len != TCP_OPTION_SACK_PERM_LEN) || (TotalLen - Cur < TCP_OPTION_SACK_PERM_LEN)) {
+          return -1;
+        }
+
+        TCP_SET_FLG (Option->Flag, TCP_OPTION_RCVD_SACK_PERM);
+
+        Cur += TCP_OPTION_SACK_PERM_LEN;
+        break;
+
+      case TCP_OPTION_SACK:
+        Len = Head[Cur + 1];
+
+        if ((Len < 2 + TCP_OPTION_SACK_BLOCK_LEN) ||
+            (Len > 2 + TCP_OPTION_MAX_SACK_BLOCK * TCP_OPTION_SACK_BLOCK_LEN) ||
+            ((Len - 2) % TCP_OPTION_SACK_BLOCK_LEN != 0) ||
+            (TotalLen - Cur < Len))
+        {
+          return -1;
+        }
+
+        Option->SackBlockNum = (UINT8)((Len - 2) / TCP_OPTION_SACK_BLOCK_LEN);
+
+        for (Index = 0; Index < Option->SackBlockNum; Index++) {
+          Option->SackBlock[Index].Left  = TcpGetUint32 (&Head[Cur + 2 + Index * TCP_OPTION_SACK_BLOCK_LEN]);
+          Option->SackBlock[Index].Right = TcpGetUint32 (&Head[Cur + 6 + Index * TCP_OPTION_SACK_BLOCK_LEN]);
+        }
+
+        TCP_SET_FLG (Option->Flag, TCP_OPTION_RCVD_SACK);
+
+        Cur = (UINT8)(Cur + Len);
+        break;
+
+      // MU_CHANGE [END]
+
       case TCP_OPTION_NOP:
         Cur++;
         break;
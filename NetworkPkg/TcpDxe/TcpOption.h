@@ -23,6 +23,15 @@
 #define TCP_OPTION_TS_LEN          10 ///< Length of timestamp option
 #define TCP_OPTION_WS_ALIGNED_LEN  4  ///< Length of window scale option, aligned
 #define TCP_OPTION_TS_ALIGNED_LEN  12 ///< Length of timestamp option, aligned
+// MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+#define TCP_OPTION_SACK_PERM              4  ///< SACK permitted
+#define TCP_OPTION_SACK                   5  ///< SACK
+#define TCP_OPTION_SACK_PERM_LEN          2  ///< Length of SACK permitted option
+#define TCP_OPTION_SACK_PERM_ALIGNED_LEN  4  ///< Length of SACK permitted option, aligned
+#define TCP_OPTION_SACK_BLOCK_LEN         8  ///< Length of a block in the SACK option
+#define TCP_OPTION_MAX_SACK_BLOCK         4  ///< Maximum number of blocks in the SACK option
+#define TCP_OPTION_MAX_LEN                40 ///< Maximum length of the option field
+// MU_CHANGE [END]
 
 //
 // recommend format of timestamp window scale
@@ -39,12 +48,32 @@
 
 #define TCP_OPTION_MSS_FAST  ((TCP_OPTION_MSS << 24) | (TCP_OPTION_MSS_LEN << 16))
 
+// MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+#define TCP_OPTION_SACK_PERM_FAST  ((TCP_OPTION_NOP << 24) |       \
+                                    (TCP_OPTION_NOP << 16) |       \
+                                    (TCP_OPTION_SACK_PERM << 8) |  \
+                                    TCP_OPTION_SACK_PERM_LEN)
+
+//
+// The first four bytes of a SACK option, the length
+// is added for the number of blocks.
+//
+#define TCP_OPTION_SACK_FAST  ((TCP_OPTION_NOP << 24) |  \
+                               (TCP_OPTION_NOP << 16) |  \
+                               (TCP_OPTION_SACK << 8) |  \
+                               2)
+// MU_CHANGE [END]
+
 //
 // Other misc definitions
 //
 #define TCP_OPTION_RCVD_MSS  0x01
 #define TCP_OPTION_RCVD_WS   0x02
 #define TCP_OPTION_RCVD_TS   0x04
+// MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+#define TCP_OPTION_RCVD_SACK_PERM  0x08
+#define TCP_OPTION_RCVD_SACK       0x10
+// MU_CHANGE [END]
 #define TCP_OPTION_MAX_WS    14            ///< Maximum window scale value
 #define TCP_OPTION_MAX_WIN   0xffff        ///< Max window size in TCP header
 
@@ -53,11 +82,15 @@
 /// ParseOption only parses the options, doesn't process them.
 ///
 typedef struct _TCP_OPTION {
-  UINT8     Flag;     ///< Flag such as TCP_OPTION_RCVD_MSS
-  UINT8     WndScale; ///< The WndScale received
-  UINT16    Mss;      ///< The Mss received
-  UINT32    TSVal;    ///< The TSVal field in a timestamp option
-  UINT32    TSEcr;    ///< The TSEcr field in a timestamp option
+  UINT8             Flag;     ///< Flag such as TCP_OPTION_RCVD_MSS
+  UINT8             WndScale; ///< The WndScale received
+  UINT16            Mss;      ///< The Mss received
+  UINT32            TSVal;    ///< The TSVal field in a timestamp option
+  UINT32            TSEcr;    ///< The TSEcr field in a timestamp option
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  UINT8             SackBlockNum;                         ///< Number of blocks in a SACK option
+  TCP_SACK_BLOCK    SackBlock[TCP_OPTION_MAX_SACK_BLOCK]; ///< The blocks of a SACK option
+  // MU_CHANGE [END]
 } TCP_OPTION;
 
 /**
@@ -173,6 +173,7 @@ TcpDataToSend (
   UINT32  Len;
   UINT32  Left;
   UINT32  Limit;
+  UINT32  MaxLen;   // MU_CHANGE - Network offloads
 
   Sk = Tcb->Sk;
   ASSERT (Sk != NULL);
@@ -205,10 +206,32 @@ TcpDataToSend (
 
   Len = MIN (Win, Left);
 
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // When the interface segments the large sends, new data is handed to it in
+  // as many full-sized segments as possible. Retransmissions and the data
+  // sent during a loss recovery keep the size of a segment.
+  //
+  MaxLen = Tcb->SndMss;
+
+  if (((Tcb->OffloadCapabilities & EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND) != 0) &&
+      (Tcb->CongestState == TCP_CONGEST_OPEN) &&
+      (Tcb->SndNxt == TcpGetMaxSndNxt (Tcb)) &&
+      (Tcb->MaxLargeSendSize > Tcb->SndMss))
+  {
+    MaxLen = Tcb->MaxLargeSendSize - Tcb->MaxLargeSendSize % Tcb->SndMss;
+  }
+
+  if (Len > MaxLen) {
+    Len = MaxLen;
+  }
+
   if (Len > Tcb->SndMss) {
-    Len = Tcb->SndMss;
+    Len -= Len % Tcb->SndMss;
   }
 
+  // MU_CHANGE [END]
+
   if ((Force != 0) || ((Len == 0) && (Left == 0))) {
     return Len;
   }
@@ -225,7 +248,7 @@ TcpDataToSend (
   // c)It can send everything it has, and either it isn't
   // expecting an ACK, or the Nagle algorithm is disabled.
   //
-  if ((Len == Tcb->SndMss) || (2 * Len >= Tcb->SndWndMax)) {
+  if ((Len >= Tcb->SndMss) || (2 * Len >= Tcb->SndWndMax)) { // MU_CHANGE - Network offloads
     return Len;
   }
 
@@ -278,6 +301,8 @@ TcpTransmitSegment (
   TCP_SEG   *Seg;
   BOOLEAN   Syn;
   UINT32    DataLen;
+  UINT32    OffloadFlags;     // MU_CHANGE - Network offloads
+  UINT16    SegmentSize;      // MU_CHANGE - Network offloads
 
   ASSERT ((Nbuf != NULL) && (Nbuf->Tcp == NULL));
 
@@ -363,9 +388,35 @@ TcpTransmitSegment (
     }
   }
 
-  Head->Flag     = Seg->Flag;
-  Head->Urg      = NTOHS (Seg->Urg);
-  Head->Checksum = TcpChecksum (Nbuf, Tcb->HeadSum);
+  Head->Flag = Seg->Flag;
+  Head->Urg  = NTOHS (Seg->Urg);
+
+  // MU_CHANGE [BEGIN] - Network offloads
+  OffloadFlags = 0;
+  SegmentSize  = 0;
+
+  if ((Tcb->OffloadCapabilities & EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM) != 0) {
+    OffloadFlags = EDKII_IP4_OFFLOAD_TX_TCP4_CHECKSUM;
+
+    if (((Tcb->OffloadCapabilities & EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND) != 0) &&
+        (DataLen > Tcb->SndMss))
+    {
+      OffloadFlags |= EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND;
+      SegmentSize   = Tcb->SndMss;
+    }
+  }
+
+  if (OffloadFlags != 0) {
+    //
+    // The interface completes the checksum, it starts from the sum
+    // of the pseudo header without the TCP length.
+    //
+    Head->Checksum = Tcb->HeadSum;
+  } else {
+    Head->Checksum = TcpChecksum (Nbuf, Tcb->HeadSum);
+  }
+
+  // MU_CHANGE [END]
 
   //
   // Update the TCP session's control information.
@@ -380,7 +431,7 @@ TcpTransmitSegment (
   //
   Tcb->DelayedAck = 0;
 
-  return TcpSendIpPacket (Tcb, Nbuf, &Tcb->LocalEnd.Ip, &Tcb->RemoteEnd.Ip, Tcb->Sk->IpVersion);
+  return TcpSendIpPacket (Tcb, Nbuf, &Tcb->LocalEnd.Ip, &Tcb->RemoteEnd.Ip, Tcb->Sk->IpVersion, OffloadFlags, SegmentSize); // MU_CHANGE - Network offloads
 }
 
 /**
@@ -699,6 +750,19 @@ TcpRetransmit (
 
   Len = MIN (Len, Tcb->SndMss);
 
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  //
+  // Don't retransmit the data SACKed by the peer.
+  //
+  if (TCP_FLG_ON (Tcb->CtrlFlag, TCP_CTRL_SND_SACK) && (Len != 0)) {
+    Len = TcpSackClipRetransmit (Tcb, Seq, Len);
+    if (Len == 0) {
+      return 0;
+    }
+  }
+
+  // MU_CHANGE [END]
+
   Nbuf = TcpGetSegmentSndQue (Tcb, Seq, Len);
   if (Nbuf == NULL) {
     return -1;
@@ -716,6 +780,13 @@ TcpRetransmit (
     Tcb->RetxmitSeqMax = Seq;
   }
 
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  if (TCP_SEQ_GT (TCPSEG_NETBUF (Nbuf)->End, Tcb->SackHighRxt)) {
+    Tcb->SackHighRxt = TCPSEG_NETBUF (Nbuf)->End;
+  }
+
+  // MU_CHANGE [END]
+
   //
   // The retransmitted buffer may be on the SndQue,
   // trim TCP head because all the buffers on SndQue
@@ -917,6 +988,19 @@ TcpToSendData (
       NetbufTrim (Nbuf, (Nbuf->Tcp->HeadLen << 2), NET_BUF_HEAD);
       Nbuf->Tcp = NULL;
 
+      // MU_CHANGE [BEGIN] - Network offloads
+      //
+      // The interface stopped segmenting the large sends, send the
+      // data of this one again in full-sized segments.
+      //
+      if ((Len > Tcb->SndMss) && ((Tcb->OffloadCapabilities & EDKII_IP4_OFFLOAD_TX_TCP4_LARGE_SEND) == 0)) {
+        NetbufFree (Nbuf);
+        Nbuf = NULL;
+        continue;
+      }
+
+      // MU_CHANGE [END]
+
       if ((Flag & TCP_FLG_FIN) != 0) {
         TCP_SET_FLG (Tcb->CtrlFlag, TCP_CTRL_FIN_SENT);
       }
@@ -969,7 +1053,7 @@ TcpToSendData (
       Tcb->RttSeq     = Seq;
       Tcb->RttMeasure = 0;
     }
-  } while (Len == Tcb->SndMss);
+  } while (Len >= Tcb->SndMss); // MU_CHANGE - Network offloads
 
   return Sent;
 
@@ -1195,7 +1279,7 @@ TcpSendReset (
 
   Nhead->Checksum = TcpChecksum (Nbuf, HeadSum);
 
-  TcpSendIpPacket (Tcb, Nbuf, Local, Remote, Version);
+  TcpSendIpPacket (Tcb, Nbuf, Local, Remote, Version, 0, 0); // MU_CHANGE - Network offloads
 
   NetbufFree (Nbuf);
 
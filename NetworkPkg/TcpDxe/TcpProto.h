@@ -70,6 +70,22 @@
 #define TCP_CTRL_TIMER_ON      0x1000   ///< At least one of the timer is on.
 #define TCP_CTRL_RTT_ON        0x2000   ///< The RTT measurement is on.
 #define TCP_CTRL_ACK_NOW       0x4000   ///< Send the ACK now, don't delay.
+// MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+#define TCP_CTRL_NO_SACK   0x8000       ///< Disable SACK option.
+#define TCP_CTRL_SND_SACK  0x10000      ///< SACK is permitted by both ends.
+#define TCP_CTRL_CUBIC     0x20000      ///< Grow the congestion window with CUBIC.
+
+//
+// Congestion control algorithms selected by PcdTcpCongestionControl.
+//
+#define TCP_CONGESTION_CONTROL_NEWRENO  0
+#define TCP_CONGESTION_CONTROL_CUBIC    1
+
+//
+// Number of ranges of sent data SACKed by the peer that are remembered.
+//
+#define TCP_SACK_SCOREBOARD_SIZE  16
+// MU_CHANGE [END]
 
 //
 // Timer related values
@@ -204,6 +220,16 @@
 
 #define TCP_MAX_WIN  0xFFFFU
 
+// MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+///
+/// A range of sequence numbers received by the peer, Right excluded.
+///
+typedef struct _TCP_SACK_BLOCK {
+  TCP_SEQNO    Left;
+  TCP_SEQNO    Right;
+} TCP_SACK_BLOCK;
+// MU_CHANGE [END]
+
 ///
 /// TCP segmentation data.
 ///
@@ -312,6 +338,24 @@ struct _TCP_CONTROL_BLOCK {
   //
   TCP_SEQNO           RetxmitSeqMax;     ///< Max Seq number in previous retransmission.
 
+  // MU_CHANGE [BEGIN] - SACK and CUBIC congestion control
+  //
+  // RFC2018 and RFC6675 variables, about selective acknowledgment.
+  //
+  TCP_SACK_BLOCK      SackBlock[TCP_SACK_SCOREBOARD_SIZE]; ///< Sent data SACKed by the peer, sorted.
+  UINT8               SackBlockNum;                        ///< Number of valid blocks in SackBlock.
+  TCP_SEQNO           SackHighRxt;                         ///< End of the data retransmitted in this recovery.
+  TCP_SEQNO           SackHigh;                            ///< End of the highest data SACKed by the peer.
+  TCP_SEQNO           RcvSackSeq;                          ///< Seq of the last out-of-order segment received.
+
+  //
+  // RFC8312 variables, about CUBIC window growth.
+  //
+  UINT32              CubicWMax;  ///< Congestion window before the last reduction.
+  UINT32              CubicEpoch; ///< mTcpTick when the current avoidance epoch began, 0 if none.
+  UINT32              CubicK;     ///< Milliseconds for the window to grow back to CubicWMax.
+  // MU_CHANGE [END]
+
   //
   // configuration parameters, for EFI_TCP4_PROTOCOL specification
   //
@@ -335,6 +379,14 @@ struct _TCP_CONTROL_BLOCK {
   BOOLEAN             RemoteIpZero; ///< RemoteEnd.Ip is ZERO when configured.
   IP_IO_IP_INFO       *IpInfo;      ///< Pointer reference to Ip used to send pkt
   UINT32              Tick;         ///< 1 tick = 200ms
+
+  // MU_CHANGE [BEGIN] - Network offloads
+  //
+  // Offloads of the IPv4 instance in IpInfo, see TcpRefreshOffload().
+  //
+  UINT32              OffloadCapabilities; ///< EDKII_IP4_OFFLOAD_TX_* flags TCP may use.
+  UINT32              MaxLargeSendSize;    ///< Largest data of a large send.
+  // MU_CHANGE [END]
 };
 
 #endif
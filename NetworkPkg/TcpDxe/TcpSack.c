@@ -0,0 +1,378 @@
+/** @file
+  Selective acknowledgment as defined in RFC2018.
+
+  The receiving side reports the out-of-order segments of the reassemble
+  queue in the SACK option of its ACKs. The sending side keeps the ranges
+  reported by the peer in a scoreboard, so that the loss recovery only
+  retransmits the holes below the highest SACKed data, one per ACK, instead
+  of the single segment per round trip of the NewReno recovery. The pipe
+  estimate of RFC6675 keeps the recovery from sending more than the reduced
+  congestion window.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "TcpMain.h"
+
+/**
+  Get the next range of contiguous out-of-order data in the reassemble queue.
+
+  @param[in]       Tcb     Pointer to the TCP_CB of this TCP instance.
+  @param[in, out]  Entry   The entry to start from, updated to the entry
+                           following the range.
+  @param[out]      Range   The range found.
+
+  @retval TRUE             A range is found.
+  @retval FALSE            No more out-of-order data.
+
+**/
+STATIC
+BOOLEAN
+TcpSackNextRange (
+  IN     TCP_CB          *Tcb,
+  IN OUT LIST_ENTRY      **Entry,
+  OUT    TCP_SACK_BLOCK  *Range
+  )
+{
+  TCP_SEG  *Seg;
+  BOOLEAN  Found;
+
+  Found = FALSE;
+
+  while (*Entry != &Tcb->RcvQue) {
+    Seg = TCPSEG_NETBUF (NET_LIST_USER_STRUCT (*Entry, NET_BUF, List));
+
+    //
+    // Skip the data that is not delivered yet but already in order.
+    //
+    if (TCP_SEQ_LEQ (Seg->End, Tcb->RcvNxt)) {
+      *Entry = (*Entry)->ForwardLink;
+      continue;
+    }
+
+    if (!Found) {
+      Range->Left  = Seg->Seq;
+      Range->Right = Seg->End;
+      Found        = TRUE;
+    } else if (TCP_SEQ_LEQ (Seg->Seq, Range->Right)) {
+      if (TCP_SEQ_GT (Seg->End, Range->Right)) {
+        Range->Right = Seg->End;
+      }
+    } else {
+      break;
+    }
+
+    *Entry = (*Entry)->ForwardLink;
+  }
+
+  return Found;
+}
+
+/**
+  Build the blocks of the SACK option from the reassemble queue.
+
+  The first block contains the most recently received segment, as required by
+  RFC2018, the others follow in the order of the sequence numbers.
+
+  @param[in]   Tcb       Pointer to the TCP_CB of this TCP instance.
+  @param[out]  Block     Array of at least Max blocks to fill.
+  @param[in]   Max       Maximum number of blocks.
+
+  @return The number of blocks filled, zero if all the data is in order.
+
+**/
+UINT8
+TcpSackBuildBlocks (
+  IN  TCP_CB          *Tcb,
+  OUT TCP_SACK_BLOCK  *Block,
+  IN  UINT8           Max
+  )
+{
+  LIST_ENTRY      *Entry;
+  TCP_SACK_BLOCK  Range;
+  UINT8           Num;
+
+  Num = 0;
+
+  if ((Max == 0) || IsListEmpty (&Tcb->RcvQue)) {
+    return 0;
+  }
+
+  Entry = Tcb->RcvQue.ForwardLink;
+  while (TcpSackNextRange (Tcb, &Entry, &Range)) {
+    if (TCP_SEQ_LEQ (Range.Left, Tcb->RcvSackSeq) && TCP_SEQ_LT (Tcb->RcvSackSeq, Range.Right)) {
+      Block[Num++] = Range;
+      break;
+    }
+  }
+
+  Entry = Tcb->RcvQue.ForwardLink;
+  while ((Num < Max) && TcpSackNextRange (Tcb, &Entry, &Range)) {
+    if ((Num != 0) && (Range.Left == Block[0].Left)) {
+      continue;
+    }
+
+    Block[Num++] = Range;
+  }
+
+  return Num;
+}
+
+/**
+  Forget the data SACKed by the peer.
+
+  The peer may discard the out-of-order data it SACKed, so the scoreboard is
+  cleared when the retransmission timer expires as RFC2018 recommends.
+
+  @param[in, out]  Tcb     Pointer to the TCP_CB of this TCP instance.
+
+**/
+VOID
+TcpSackReset (
+  IN OUT TCP_CB  *Tcb
+  )
+{
+  Tcb->SackBlockNum = 0;
+  Tcb->SackHighRxt  = Tcb->SndUna;
+  Tcb->SackHigh     = Tcb->SndUna;
+}
+
+/**
+  Update the scoreboard with the acknowledgment and the SACK option of a
+  received segment.
+
+  @param[in, out]  Tcb     Pointer to the TCP_CB of this TCP instance.
+  @param[in]       Ack     The acknowledge sequence number of the segment.
+  @param[in]       Option  The options of the segment.
+
+**/
+VOID
+TcpSackUpdate (
+  IN OUT TCP_CB      *Tcb,
+  IN     TCP_SEQNO   Ack,
+  IN     TCP_OPTION  *Option
+  )
+{
+  TCP_SACK_BLOCK  *Board;
+  TCP_SACK_BLOCK  New;
+  UINT8           Num;
+  UINT8           Index;
+  UINT8           Cur;
+
+  Board = Tcb->SackBlock;
+  Num   = 0;
+
+  //
+  // Drop the blocks that are now cumulatively acknowledged.
+  //
+  for (Index = 0; Index < Tcb->SackBlockNum; Index++) {
+    if (TCP_SEQ_LEQ (Board[Index].Right, Ack)) {
+      continue;
+    }
+
+    Board[Num] = Board[Index];
+    if (TCP_SEQ_LT (Board[Num].Left, Ack)) {
+      Board[Num].Left = Ack;
+    }
+
+    Num++;
+  }
+
+  if (TCP_FLG_ON (Option->Flag, TCP_OPTION_RCVD_SACK)) {
+    for (Index = 0; Index < Option->SackBlockNum; Index++) {
+      New = Option->SackBlock[Index];
+
+      //
+      // Ignore the blocks below the acknowledgment, such
+      // as D-SACK, and the blocks not sent yet.
+      //
+      if (TCP_SEQ_LEQ (New.Right, New.Left) ||
+          TCP_SEQ_LEQ (New.Left, Ack) ||
+          TCP_SEQ_GT (New.Right, Tcb->SndNxt))
+      {
+        continue;
+      }
+
+      if (TCP_SEQ_GT (New.Right, Tcb->SackHigh)) {
+        Tcb->SackHigh = New.Right;
+      }
+
+      //
+      // Insert the block in order. When the scoreboard is
+      // full, the highest block is forgotten, which only
+      // costs a useless retransmission.
+      //
+      if (Num == TCP_SACK_SCOREBOARD_SIZE) {
+        if (TCP_SEQ_GEQ (New.Left, Board[Num - 1].Left)) {
+          continue;
+        }
+
+        Num--;
+      }
+
+      for (Cur = Num; (Cur > 0) && TCP_SEQ_GT (Board[Cur - 1].Left, New.Left); Cur--) {
+        Board[Cur] = Board[Cur - 1];
+      }
+
+      Board[Cur] = New;
+      Num++;
+    }
+
+    //
+    // Merge the overlapping and adjacent blocks.
+    //
+    for (Index = 0, Cur = 0; Index < Num; Index++) {
+      if ((Cur != 0) && TCP_SEQ_LEQ (Board[Index].Left, Board[Cur - 1].Right)) {
+        if (TCP_SEQ_GT (Board[Index].Right, Board[Cur - 1].Right)) {
+          Board[Cur - 1].Right = Board[Index].Right;
+        }
+
+        continue;
+      }
+
+      Board[Cur++] = Board[Index];
+    }
+
+    Num = Cur;
+  }
+
+  Tcb->SackBlockNum = Num;
+}
+
+/**
+  Find the next hole to retransmit during the loss recovery.
+
+  A hole is unacknowledged data below the highest SACKed data that has not
+  been retransmitted in this recovery yet.
+
+  @param[in]   Tcb     Pointer to the TCP_CB of this TCP instance.
+  @param[in]   Una     The first unacknowledged sequence number.
+  @param[out]  Seq     The first sequence number of the hole.
+
+  @retval TRUE         A hole is found.
+  @retval FALSE        There is no hole to retransmit.
+
+**/
+BOOLEAN
+TcpSackNextHole (
+  IN  TCP_CB     *Tcb,
+  IN  TCP_SEQNO  Una,
+  OUT TCP_SEQNO  *Seq
+  )
+{
+  TCP_SEQNO  Start;
+  UINT8      Index;
+
+  Start = Una;
+  if (TCP_SEQ_GT (Tcb->SackHighRxt, Start)) {
+    Start = Tcb->SackHighRxt;
+  }
+
+  for (Index = 0; Index < Tcb->SackBlockNum; Index++) {
+    if (TCP_SEQ_LT (Start, Tcb->SackBlock[Index].Left)) {
+      *Seq = Start;
+      return TRUE;
+    }
+
+    if (TCP_SEQ_LT (Start, Tcb->SackBlock[Index].Right)) {
+      Start = Tcb->SackBlock[Index].Right;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Estimate the number of bytes outstanding in the network during the loss
+  recovery, as the SetPipe() procedure of RFC6675.
+
+  The data not SACKed between Una and SND.NXT is counted, unless it is lost,
+  that is three discontiguous ranges or more than two segments of SACKed data
+  are above it. The scoreboard may have forgotten some of the SACKed ranges,
+  so the SACKed data above is measured up to the highest data SACKed by the
+  peer, as the forward acknowledgment does. The data retransmitted in this
+  recovery is counted again.
+
+  @param[in]  Tcb      Pointer to the TCP_CB of this TCP instance.
+  @param[in]  Una      The first unacknowledged sequence number.
+
+  @return The number of bytes in the pipe.
+
+**/
+UINT32
+TcpSackPipe (
+  IN TCP_CB     *Tcb,
+  IN TCP_SEQNO  Una
+  )
+{
+  TCP_SEQNO  Left;
+  TCP_SEQNO  Right;
+  TCP_SEQNO  Lost;
+  TCP_SEQNO  Start;
+  TCP_SEQNO  End;
+  UINT32     Pipe;
+  UINT8      Index;
+
+  Pipe = 0;
+  Lost = Tcb->SackHigh - 2 * (UINT32)Tcb->SndMss;
+  Left = Una;
+
+  for (Index = 0; Index <= Tcb->SackBlockNum; Index++) {
+    Right = (Index < Tcb->SackBlockNum) ? Tcb->SackBlock[Index].Left : Tcb->SndNxt;
+
+    if (TCP_SEQ_LT (Left, Right)) {
+      //
+      // The hole is lost below three ranges or below Lost.
+      //
+      Start = TCP_SEQ_LT (Left, Lost) ? Lost : Left;
+      if ((Tcb->SackBlockNum - Index < 3) && TCP_SEQ_LT (Start, Right)) {
+        Pipe += TCP_SUB_SEQ (Right, Start);
+      }
+
+      End = TCP_SEQ_LT (Tcb->SackHighRxt, Right) ? Tcb->SackHighRxt : Right;
+      if (TCP_SEQ_LT (Left, End)) {
+        Pipe += TCP_SUB_SEQ (End, Left);
+      }
+    }
+
+    if ((Index < Tcb->SackBlockNum) && TCP_SEQ_LT (Left, Tcb->SackBlock[Index].Right)) {
+      Left = Tcb->SackBlock[Index].Right;
+    }
+  }
+
+  return Pipe;
+}
+
+/**
+  Limit the length of a retransmission to the data not SACKed by the peer.
+
+  @param[in]  Tcb      Pointer to the TCP_CB of this TCP instance.
+  @param[in]  Seq      The sequence number of the retransmission.
+  @param[in]  Len      The maximum length of the retransmission.
+
+  @return The length to retransmit, zero if the data at Seq is SACKed.
+
+**/
+UINT32
+TcpSackClipRetransmit (
+  IN TCP_CB     *Tcb,
+  IN TCP_SEQNO  Seq,
+  IN UINT32     Len
+  )
+{
+  UINT8  Index;
+
+  for (Index = 0; Index < Tcb->SackBlockNum; Index++) {
+    if (TCP_SEQ_LT (Seq, Tcb->SackBlock[Index].Left)) {
+      return MIN (Len, TCP_SUB_SEQ (Tcb->SackBlock[Index].Left, Seq));
+    }
+
+    if (TCP_SEQ_LT (Seq, Tcb->SackBlock[Index].Right)) {
+      return 0;
+    }
+  }
+
+  return Len;
+}
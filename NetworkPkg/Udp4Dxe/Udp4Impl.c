@@ -1608,9 +1608,11 @@ Udp4Demultiplex (
 
   // MU_CHANGE End - CodeQL Change - unguardednullreturndereference
 
-  if (Udp4Header->Checksum != 0) {
+  if ((Udp4Header->Checksum != 0) &&
+      ((NetSession->OffloadFlags & EDKII_IP4_OFFLOAD_RX_UDP4_CHECKSUM) == 0)) // MU_CHANGE - Network offloads
+  {
     //
-    // check the checksum.
+    // check the checksum, unless the interface has verified it.
     //
     HeadSum = NetPseudoHeadChecksum (
                 NetSession->Source.Addr[0],
@@ -0,0 +1,175 @@
+/** @file
+  The implementation for the 'mnpstat' Shell command.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "UefiShellNetwork1CommandsLib.h"
+
+STATIC CONST SHELL_PARAM_ITEM  mMnpStatParamList[] = {
+  { L"-r", TypeFlag  },
+  { NULL,  TypeMax   }
+};
+
+/**
+  Print the receive counters of a network interface.
+
+  @param[in]  Handle       The controller handle of the interface.
+  @param[in]  Statistics   The counters of the interface.
+
+**/
+STATIC
+VOID
+MnpStatPrint (
+  IN EFI_HANDLE                        Handle,
+  IN EDKII_MANAGED_NETWORK_STATISTICS  *Statistics
+  )
+{
+  EFI_STATUS  Status;
+  CHAR16      *MacString;
+
+  Status = NetLibGetMacString (Handle, gImageHandle, &MacString);
+  if (EFI_ERROR (Status)) {
+    MacString = NULL;
+  }
+
+  ShellPrintHiiEx (
+    -1,
+    -1,
+    NULL,
+    STRING_TOKEN (STR_MNPSTAT_INTERFACE),
+    gShellNetwork1HiiHandle,
+    (MacString != NULL) ? MacString : L"Unknown"
+    );
+  ShellPrintHiiEx (
+    -1,
+    -1,
+    NULL,
+    STRING_TOKEN (STR_MNPSTAT_BATCH),
+    gShellNetwork1HiiHandle,
+    Statistics->RxFrames,
+    Statistics->RxBatches,
+    Statistics->RxFullBatches,
+    Statistics->RxLargestBatch,
+    Statistics->RxBatchSize
+    );
+  ShellPrintHiiEx (
+    -1,
+    -1,
+    NULL,
+    STRING_TOKEN (STR_MNPSTAT_DROP),
+    gShellNetwork1HiiHandle,
+    Statistics->RxDroppedQueueFull,
+    Statistics->RxDroppedTimeout,
+    Statistics->RxNoBuffer,
+    Statistics->RxErrors
+    );
+  ShellPrintHiiEx (
+    -1,
+    -1,
+    NULL,
+    STRING_TOKEN (STR_MNPSTAT_POLL),
+    gShellNetwork1HiiHandle,
+    DivU64x32 (Statistics->PollInterval, 10)
+    );
+
+  if (MacString != NULL) {
+    FreePool (MacString);
+  }
+}
+
+/**
+  Function for 'mnpstat' command.
+
+  @param[in] ImageHandle  Handle to the Image (NULL if Internal).
+  @param[in] SystemTable  Pointer to the System Table (NULL if Internal).
+
+  @retval SHELL_SUCCESS            The counters were printed.
+  @retval SHELL_INVALID_PARAMETER  The command line is invalid.
+  @retval SHELL_NOT_FOUND          No interface reports receive counters.
+**/
+SHELL_STATUS
+EFIAPI
+ShellCommandRunMnpStat (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS                                 Status;
+  SHELL_STATUS                               ShellStatus;
+  LIST_ENTRY                                 *ParamPackage;
+  CHAR16                                     *ProblemParam;
+  BOOLEAN                                    Reset;
+  EFI_HANDLE                                 *HandleBuffer;
+  UINTN                                      HandleCount;
+  UINTN                                      Index;
+  EDKII_MANAGED_NETWORK_STATISTICS_PROTOCOL  *StatisticsProtocol;
+  EDKII_MANAGED_NETWORK_STATISTICS           Statistics;
+
+  ShellStatus  = SHELL_SUCCESS;
+  ProblemParam = NULL;
+  HandleBuffer = NULL;
+
+  Status = ShellCommandLineParse (mMnpStatParamList, &ParamPackage, &ProblemParam, TRUE);
+  if (EFI_ERROR (Status)) {
+    if ((Status == EFI_VOLUME_CORRUPTED) && (ProblemParam != NULL)) {
+      ShellPrintHiiEx (-1, -1, NULL, STRING_TOKEN (STR_GEN_PROBLEM), gShellNetwork1HiiHandle, L"mnpstat", ProblemParam);
+      FreePool (ProblemParam);
+      return SHELL_INVALID_PARAMETER;
+    }
+
+    ASSERT (FALSE);
+    return SHELL_INVALID_PARAMETER;
+  }
+
+  if (ShellCommandLineGetCount (ParamPackage) > 1) {
+    ShellPrintHiiEx (-1, -1, NULL, STRING_TOKEN (STR_GEN_TOO_MANY), gShellNetwork1HiiHandle, L"mnpstat");
+    ShellStatus = SHELL_INVALID_PARAMETER;
+    goto ON_EXIT;
+  }
+
+  Reset = ShellCommandLineGetFlag (ParamPackage, L"-r");
+
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEdkiiManagedNetworkStatisticsProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &HandleBuffer
+                  );
+  if (EFI_ERROR (Status) || (HandleCount == 0)) {
+    ShellPrintHiiEx (-1, -1, NULL, STRING_TOKEN (STR_MNPSTAT_NOT_FOUND), gShellNetwork1HiiHandle, L"mnpstat");
+    ShellStatus = SHELL_NOT_FOUND;
+    goto ON_EXIT;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (
+                    HandleBuffer[Index],
+                    &gEdkiiManagedNetworkStatisticsProtocolGuid,
+                    (VOID **)&StatisticsProtocol
+                    );
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    Status = StatisticsProtocol->GetStatistics (StatisticsProtocol, Reset, &Statistics);
+    if (EFI_ERROR (Status)) {
+      ShellPrintHiiEx (-1, -1, NULL, STRING_TOKEN (STR_GEN_ERR_UK), gShellNetwork1HiiHandle, L"mnpstat", Status);
+      ShellStatus = SHELL_DEVICE_ERROR;
+      continue;
+    }
+
+    MnpStatPrint (HandleBuffer[Index], &Statistics);
+  }
+
+ON_EXIT:
+  if (HandleBuffer != NULL) {
+    FreePool (HandleBuffer);
+  }
+
+  ShellCommandLineFreeVarList (ParamPackage);
+  return ShellStatus;
+}
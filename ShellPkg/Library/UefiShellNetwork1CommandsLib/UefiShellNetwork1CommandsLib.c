@@ -61,6 +61,7 @@ ShellNetwork1CommandsLibConstructor (
   //
   ShellCommandRegisterCommandName (L"ping", ShellCommandRunPing, ShellCommandGetManFileNameNetwork1, 0, L"network1", TRUE, gShellNetwork1HiiHandle, STRING_TOKEN (STR_GET_HELP_PING));
   ShellCommandRegisterCommandName (L"ifconfig", ShellCommandRunIfconfig, ShellCommandGetManFileNameNetwork1, 0, L"network1", TRUE, gShellNetwork1HiiHandle, STRING_TOKEN (STR_GET_HELP_IFCONFIG));
+  ShellCommandRegisterCommandName (L"mnpstat", ShellCommandRunMnpStat, ShellCommandGetManFileNameNetwork1, 0, L"network1", TRUE, gShellNetwork1HiiHandle, STRING_TOKEN (STR_GET_HELP_MNPSTAT)); // MU_CHANGE - MNP batched receive
 
   return (EFI_SUCCESS);
 }
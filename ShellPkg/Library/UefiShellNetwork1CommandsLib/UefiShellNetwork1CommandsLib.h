@@ -21,6 +21,7 @@
 #include <Protocol/Ip4.h>
 #include <Protocol/Ip4Config2.h>
 #include <Protocol/Arp.h>
+#include <Protocol/ManagedNetworkStatistics.h> // MU_CHANGE - MNP batched receive
 
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
@@ -66,4 +67,21 @@ ShellCommandRunIfconfig (
   IN EFI_SYSTEM_TABLE  *SystemTable
   );
 
+// MU_CHANGE [BEGIN] - MNP batched receive
+
+/**
+  Function for 'mnpstat' command.
+
+  @param[in] ImageHandle  Handle to the Image (NULL if Internal).
+  @param[in] SystemTable  Pointer to the System Table (NULL if Internal).
+**/
+SHELL_STATUS
+EFIAPI
+ShellCommandRunMnpStat (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  );
+
+// MU_CHANGE [END]
+
 #endif
@@ -0,0 +1,385 @@
+/** @file
+  Parallel LZMA pre-decompression PEIM.
+
+  After permanent memory is installed, this PEIM locates every GUIDed section
+  tagged with gParallelLzmaCustomDecompressGuid in the firmware volumes known
+  to the PEI core, decompresses all of them concurrently on every enabled
+  processor, and publishes a gParallelLzmaCustomDecompressHobGuid HOB for each
+  successfully decompressed section, followed by a single
+  gParallelLzmaCustomDecompressIndexHobGuid HOB that indexes them.
+  ParallelLzmaCustomDecompressLib consumes these HOBs so the DXE IPL and DXE
+  core find the data already decompressed.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiPei.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PeiServicesLib.h>
+#include <Library/PerformanceLib.h>
+
+#include <Guid/ParallelLzmaDecompress.h>
+
+#include "ParallelLzmaDecompressPei.h"
+
+/**
+  Publishes the hash index of the decompressed sections.
+
+  The index is only an accelerator, ParallelLzmaCustomDecompressLib walks the
+  decompressed buffer HOBs when it is missing.
+
+  @param[in] Queue      The processed job queue.
+  @param[in] Published  The number of jobs that completed successfully.
+
+**/
+STATIC
+VOID
+PublishDecompressedBufferIndex (
+  IN CONST PARALLEL_LZMA_JOB_QUEUE  *Queue,
+  IN UINT32                         Published
+  )
+{
+  PARALLEL_DECOMPRESSED_BUFFER_INDEX  *BufferIndex;
+  CONST PARALLEL_LZMA_JOB             *Job;
+  UINTN                               Size;
+  UINT32                              BucketCount;
+  UINT32                              Bucket;
+  UINT32                              Index;
+
+  if (Published == 0) {
+    return;
+  }
+
+  BucketCount = 4;
+  while (BucketCount < Published * 2) {
+    BucketCount <<= 1;
+  }
+
+  //
+  // A GUID HOB is limited to 64KB.
+  //
+  Size = OFFSET_OF (PARALLEL_DECOMPRESSED_BUFFER_INDEX, Buckets) + BucketCount * sizeof (PARALLEL_DECOMPRESSED_BUFFER);
+  if (Size > MAX_UINT16 - sizeof (EFI_HOB_GUID_TYPE)) {
+    DEBUG ((DEBUG_WARN, "[%a] Too many sections to index: %d\n", __func__, Published));
+    return;
+  }
+
+  BufferIndex = BuildGuidHob (&gParallelLzmaCustomDecompressIndexHobGuid, Size);
+  if (BufferIndex == NULL) {
+    return;
+  }
+
+  ZeroMem (BufferIndex, Size);
+  BufferIndex->BucketCount = BucketCount;
+  BufferIndex->EntryCount  = Published;
+  for (Index = 0; Index < Queue->JobCount; Index++) {
+    Job = &Queue->Jobs[Index];
+    if (RETURN_ERROR (Job->Status)) {
+      continue;
+    }
+
+    Bucket = PARALLEL_DECOMPRESSED_BUFFER_HASH (Job->Source, BucketCount);
+    while (BufferIndex->Buckets[Bucket].SourceBuffer != NULL) {
+      Bucket = (Bucket + 1) & (BucketCount - 1);
+    }
+
+    BufferIndex->Buckets[Bucket].SourceBuffer       = (VOID *)Job->Source;
+    BufferIndex->Buckets[Bucket].DecompressedBuffer = Job->Destination;
+    BufferIndex->Buckets[Bucket].DecompressedSize   = Job->DestinationSize;
+  }
+}
+
+/**
+  Checks whether a section is a GUIDed section that this PEIM should handle.
+
+  On success, returns the location and size of the compressed data in the
+  same form ParallelLzmaCustomDecompressLib uses to match HOBs to sections.
+
+  @param[in]  Section   The section to examine.
+  @param[out] Data      The start of the compressed data.
+  @param[out] DataSize  The size of the compressed data.
+
+  @retval TRUE   The section is a Parallel LZMA GUIDed section.
+  @retval FALSE  The section is something else, or is malformed.
+
+**/
+STATIC
+BOOLEAN
+IsParallelLzmaSection (
+  IN  CONST EFI_COMMON_SECTION_HEADER  *Section,
+  OUT CONST VOID                       **Data,
+  OUT UINTN                            *DataSize
+  )
+{
+  UINTN   SectionSize;
+  UINT16  DataOffset;
+
+  if (Section->Type != EFI_SECTION_GUID_DEFINED) {
+    return FALSE;
+  }
+
+  if (IS_SECTION2 (Section)) {
+    if (!CompareGuid (
+           &gParallelLzmaCustomDecompressGuid,
+           &(((EFI_GUID_DEFINED_SECTION2 *)Section)->SectionDefinitionGuid)
+           ))
+    {
+      return FALSE;
+    }
+
+    SectionSize = SECTION2_SIZE (Section);
+    DataOffset  = ((EFI_GUID_DEFINED_SECTION2 *)Section)->DataOffset;
+  } else {
+    if (!CompareGuid (
+           &gParallelLzmaCustomDecompressGuid,
+           &(((EFI_GUID_DEFINED_SECTION *)Section)->SectionDefinitionGuid)
+           ))
+    {
+      return FALSE;
+    }
+
+    SectionSize = SECTION_SIZE (Section);
+    DataOffset  = ((EFI_GUID_DEFINED_SECTION *)Section)->DataOffset;
+  }
+
+  if (DataOffset >= SectionSize) {
+    return FALSE;
+  }
+
+  *Data     = (UINT8 *)Section + DataOffset;
+  *DataSize = SectionSize - DataOffset;
+  return TRUE;
+}
+
+/**
+  Walks the top level sections of every file in every firmware volume and
+  records the Parallel LZMA sections found.
+
+  The sections are not traversed through the PEI core section services, since
+  those would extract encapsulated sections on the BSP, which is exactly the
+  work this PEIM is meant to move off the critical path.
+
+  @param[out] Jobs     Optional array to receive the job descriptions. Pass NULL
+                       to only count the sections.
+  @param[in]  MaxJobs  Number of entries available in Jobs.
+
+  @return The number of Parallel LZMA sections found.
+
+**/
+STATIC
+UINT32
+CollectParallelLzmaSections (
+  OUT PARALLEL_LZMA_JOB  *Jobs  OPTIONAL,
+  IN  UINT32             MaxJobs
+  )
+{
+  EFI_STATUS                 Status;
+  UINTN                      Instance;
+  EFI_PEI_FV_HANDLE          VolumeHandle;
+  EFI_PEI_FILE_HANDLE        FileHandle;
+  EFI_FV_FILE_INFO           FileInfo;
+  EFI_COMMON_SECTION_HEADER  *Section;
+  UINTN                      SectionSize;
+  UINTN                      Offset;
+  CONST VOID                 *Data;
+  UINTN                      DataSize;
+  UINT32                     Count;
+
+  Count = 0;
+  for (Instance = 0; ; Instance++) {
+    Status = PeiServicesFfsFindNextVolume (Instance, &VolumeHandle);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    FileHandle = NULL;
+    while (!EFI_ERROR (PeiServicesFfsFindNextFile (EFI_FV_FILETYPE_ALL, VolumeHandle, &FileHandle))) {
+      Status = PeiServicesFfsGetFileInfo (FileHandle, &FileInfo);
+      if (EFI_ERROR (Status) || (FileInfo.Buffer == NULL)) {
+        continue;
+      }
+
+      //
+      // Sections that carry no data (e.g. RAW files) are skipped by the size
+      // checks below.
+      //
+      Offset = 0;
+      while (Offset + sizeof (EFI_COMMON_SECTION_HEADER) <= FileInfo.BufferSize) {
+        Section     = (EFI_COMMON_SECTION_HEADER *)((UINT8 *)FileInfo.Buffer + Offset);
+        SectionSize = IS_SECTION2 (Section) ? SECTION2_SIZE (Section) : SECTION_SIZE (Section);
+        if ((SectionSize < sizeof (EFI_COMMON_SECTION_HEADER)) ||
+            (SectionSize > FileInfo.BufferSize - Offset))
+        {
+          break;
+        }
+
+        if (IsParallelLzmaSection (Section, &Data, &DataSize)) {
+          if ((Jobs != NULL) && (Count < MaxJobs)) {
+            Jobs[Count].Source     = Data;
+            Jobs[Count].SourceSize = DataSize;
+          }
+
+          Count++;
+        }
+
+        Offset += ALIGN_VALUE (SectionSize, 4);
+      }
+    }
+  }
+
+  return Count;
+}
+
+/**
+  Allocates the output and scratch buffers for a job.
+
+  @param[in,out] Job  The job to prepare.
+
+  @retval EFI_SUCCESS           The buffers were allocated.
+  @retval EFI_OUT_OF_RESOURCES  The buffers could not be allocated.
+  @retval others                The section header could not be decoded.
+
+**/
+STATIC
+EFI_STATUS
+PrepareJob (
+  IN OUT PARALLEL_LZMA_JOB  *Job
+  )
+{
+  RETURN_STATUS  Status;
+
+  Status = LzmaUefiDecompressGetInfo (
+             Job->Source,
+             (UINT32)Job->SourceSize,
+             &Job->DestinationSize,
+             &Job->ScratchSize
+             );
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // The destination buffer outlives PEI; the HOB hands it to DXE.
+  //
+  Job->Destination = AllocatePages (EFI_SIZE_TO_PAGES (Job->DestinationSize));
+  if (Job->Destination == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Job->Scratch = AllocatePages (EFI_SIZE_TO_PAGES (Job->ScratchSize));
+  if (Job->Scratch == NULL) {
+    FreePages (Job->Destination, EFI_SIZE_TO_PAGES (Job->DestinationSize));
+    Job->Destination = NULL;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Entry point of the Parallel LZMA pre-decompression PEIM.
+
+  @param[in] FileHandle   Handle of the file being invoked.
+  @param[in] PeiServices  Describes the list of possible PEI Services.
+
+  @retval EFI_SUCCESS    Sections that could not be decompressed here are
+                         left to the consumer.
+  @retval EFI_NOT_FOUND  The MP services PPI is not installed.
+
+**/
+EFI_STATUS
+EFIAPI
+ParallelLzmaDecompressPeiEntry (
+  IN       EFI_PEI_FILE_HANDLE  FileHandle,
+  IN CONST EFI_PEI_SERVICES     **PeiServices
+  )
+{
+  EFI_STATUS                    Status;
+  EDKII_PEI_MP_SERVICES2_PPI    *MpServices;
+  PARALLEL_LZMA_JOB_QUEUE       Queue;
+  PARALLEL_LZMA_JOB             *Job;
+  PARALLEL_DECOMPRESSED_BUFFER  DecompBufferInfo;
+  UINT32                        Index;
+  UINT32                        Published;
+
+  //
+  // The depex guarantees that the MP services PPI is installed.
+  //
+  Status = PeiServicesLocatePpi (&gEdkiiPeiMpServices2PpiGuid, 0, NULL, (VOID **)&MpServices);
+  if (EFI_ERROR (Status)) {
+    ASSERT_EFI_ERROR (Status);
+    return Status;
+  }
+
+  ZeroMem (&Queue, sizeof (Queue));
+  Queue.JobCount = CollectParallelLzmaSections (NULL, 0);
+  if (Queue.JobCount == 0) {
+    DEBUG ((DEBUG_INFO, "[%a] No parallel LZMA sections found.\n", __func__));
+    return EFI_SUCCESS;
+  }
+
+  Queue.Jobs = AllocateZeroPool (Queue.JobCount * sizeof (PARALLEL_LZMA_JOB));
+  if (Queue.Jobs == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  Queue.JobCount = MIN (Queue.JobCount, CollectParallelLzmaSections (Queue.Jobs, Queue.JobCount));
+
+  //
+  // Jobs whose buffers cannot be prepared are compacted out of the queue, so
+  // the consumer falls back to decompressing those sections itself.
+  //
+  for (Index = 0, Job = Queue.Jobs; Index < Queue.JobCount; Index++) {
+    Queue.Jobs[Index].Status = PrepareJob (&Queue.Jobs[Index]);
+    if (RETURN_ERROR (Queue.Jobs[Index].Status)) {
+      DEBUG ((
+        DEBUG_ERROR,
+        "[%a] Skipping section at %p - %r\n",
+        __func__,
+        Queue.Jobs[Index].Source,
+        Queue.Jobs[Index].Status
+        ));
+      continue;
+    }
+
+    CopyMem (Job, &Queue.Jobs[Index], sizeof (*Job));
+    Job++;
+  }
+
+  Queue.JobCount = (UINT32)(Job - Queue.Jobs);
+
+  PERF_INMODULE_BEGIN ("ParallelLzmaDecompress");
+  ParallelLzmaDecompressRunJobs (MpServices, &Queue);
+  PERF_INMODULE_END ("ParallelLzmaDecompress");
+
+  Published = 0;
+  for (Index = 0; Index < Queue.JobCount; Index++) {
+    Job = &Queue.Jobs[Index];
+    FreePages (Job->Scratch, EFI_SIZE_TO_PAGES (Job->ScratchSize));
+
+    if (RETURN_ERROR (Job->Status)) {
+      DEBUG ((DEBUG_ERROR, "[%a] Failed to decompress section at %p - %r\n", __func__, Job->Source, Job->Status));
+      FreePages (Job->Destination, EFI_SIZE_TO_PAGES (Job->DestinationSize));
+      continue;
+    }
+
+    DecompBufferInfo.SourceBuffer       = (VOID *)Job->Source;
+    DecompBufferInfo.DecompressedBuffer = Job->Destination;
+    DecompBufferInfo.DecompressedSize   = Job->DestinationSize;
+    BuildGuidDataHob (&gParallelLzmaCustomDecompressHobGuid, &DecompBufferInfo, sizeof (DecompBufferInfo));
+    Published++;
+  }
+
+  PublishDecompressedBufferIndex (&Queue, Published);
+
+  DEBUG ((DEBUG_INFO, "[%a] Published %d of %d decompressed sections.\n", __func__, Published, Queue.JobCount));
+
+  FreePool (Queue.Jobs);
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,97 @@
+/** @file
+  Internal definitions for the Parallel LZMA pre-decompression PEIM.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef PARALLEL_LZMA_DECOMPRESS_PEI_H_
+#define PARALLEL_LZMA_DECOMPRESS_PEI_H_
+
+#include <PiPei.h>
+#include <Ppi/MpServices2.h>
+
+///
+/// A single GUIDed section to be decompressed by one CPU.
+///
+typedef struct {
+  CONST VOID       *Source;
+  UINTN            SourceSize;
+  VOID             *Destination;
+  UINT32           DestinationSize;
+  VOID             *Scratch;
+  UINT32           ScratchSize;
+  RETURN_STATUS    Status;
+} PARALLEL_LZMA_JOB;
+
+///
+/// Work queue shared by all CPUs. Every CPU claims the next unclaimed job by
+/// atomically incrementing NextJob, so jobs of uneven size are balanced
+/// across the processors without any further coordination.
+///
+typedef struct {
+  PARALLEL_LZMA_JOB    *Jobs;
+  UINT32               JobCount;
+  volatile UINT32      NextJob;
+} PARALLEL_LZMA_JOB_QUEUE;
+
+//
+// Routines provided by the LZMA decompression library. The PEIM expects to be
+// linked against LzmaCustomDecompressLib with a NULL| library instance.
+//
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressGetInfo (
+  IN  CONST VOID  *Source,
+  IN  UINT32      SourceSize,
+  OUT UINT32      *DestinationSize,
+  OUT UINT32      *ScratchSize
+  );
+
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompress (
+  IN CONST VOID  *Source,
+  IN UINTN       SourceSize,
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  );
+
+/**
+  Drains the shared job queue, decompressing one section per claimed job.
+
+  This routine runs on the BSP and on every enabled AP, so it must not use
+  any PEI services, debug output or memory allocation.
+
+  @param[in,out] Buffer  Pointer to the PARALLEL_LZMA_JOB_QUEUE to drain.
+
+**/
+VOID
+EFIAPI
+ParallelLzmaDecompressProcedure (
+  IN OUT VOID  *Buffer
+  );
+
+/**
+  Decompresses every job in the queue, using all CPUs when possible.
+
+  If MpServices is NULL or the processors cannot be started, the remaining
+  jobs are decompressed on the calling processor so that every job always
+  has a final status on return.
+
+  @param[in]     MpServices  Optional pointer to the MP services PPI.
+  @param[in,out] Queue       The job queue to process.
+
+  @retval EFI_SUCCESS            All jobs were processed. Check each job's
+                                 Status field for the per-job result.
+  @retval EFI_INVALID_PARAMETER  Queue is NULL.
+
+**/
+EFI_STATUS
+ParallelLzmaDecompressRunJobs (
+  IN     EDKII_PEI_MP_SERVICES2_PPI  *MpServices  OPTIONAL,
+  IN OUT PARALLEL_LZMA_JOB_QUEUE     *Queue
+  );
+
+#endif
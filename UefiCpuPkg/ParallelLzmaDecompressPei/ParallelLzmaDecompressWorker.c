@@ -0,0 +1,98 @@
+/** @file
+  Processor-independent worker for the Parallel LZMA pre-decompression PEIM.
+
+  The routines in this file only touch the job queue and the LZMA decoder so
+  that they are safe to run on application processors.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Library/SynchronizationLib.h>
+
+#include "ParallelLzmaDecompressPei.h"
+
+/**
+  Drains the shared job queue, decompressing one section per claimed job.
+
+  This routine runs on the BSP and on every enabled AP, so it must not use
+  any PEI services, debug output or memory allocation.
+
+  @param[in,out] Buffer  Pointer to the PARALLEL_LZMA_JOB_QUEUE to drain.
+
+**/
+VOID
+EFIAPI
+ParallelLzmaDecompressProcedure (
+  IN OUT VOID  *Buffer
+  )
+{
+  PARALLEL_LZMA_JOB_QUEUE  *Queue;
+  PARALLEL_LZMA_JOB        *Job;
+  UINT32                   Index;
+
+  Queue = (PARALLEL_LZMA_JOB_QUEUE *)Buffer;
+  if (Queue == NULL) {
+    return;
+  }
+
+  while (TRUE) {
+    //
+    // InterlockedIncrement() returns the incremented value, so the job this
+    // processor now owns is one less than that.
+    //
+    Index = InterlockedIncrement (&Queue->NextJob) - 1;
+    if (Index >= Queue->JobCount) {
+      break;
+    }
+
+    Job         = &Queue->Jobs[Index];
+    Job->Status = LzmaUefiDecompress (Job->Source, Job->SourceSize, Job->Destination, Job->Scratch);
+  }
+}
+
+/**
+  Decompresses every job in the queue, using all CPUs when possible.
+
+  If MpServices is NULL or the processors cannot be started, the remaining
+  jobs are decompressed on the calling processor so that every job always
+  has a final status on return.
+
+  @param[in]     MpServices  Optional pointer to the MP services PPI.
+  @param[in,out] Queue       The job queue to process.
+
+  @retval EFI_SUCCESS            All jobs were processed. Check each job's
+                                 Status field for the per-job result.
+  @retval EFI_INVALID_PARAMETER  Queue is NULL.
+
+**/
+EFI_STATUS
+ParallelLzmaDecompressRunJobs (
+  IN     EDKII_PEI_MP_SERVICES2_PPI  *MpServices  OPTIONAL,
+  IN OUT PARALLEL_LZMA_JOB_QUEUE     *Queue
+  )
+{
+  if (Queue == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Queue->NextJob = 0;
+
+  if ((MpServices != NULL) && (Queue->JobCount > 1)) {
+    //
+    // StartupAllCPUs() also runs the procedure on the BSP, so the BSP takes
+    // part in draining the queue instead of just waiting for the APs.
+    //
+    MpServices->StartupAllCPUs (MpServices, ParallelLzmaDecompressProcedure, 0, Queue);
+  }
+
+  //
+  // Pick up anything left over, either because there is no MP support, or
+  // because the APs could not be started. This is a no-op when the queue has
+  // already been drained.
+  //
+  ParallelLzmaDecompressProcedure (Queue);
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,244 @@
+/** @file
+  Host based unit tests for the Parallel LZMA pre-decompression worker.
+
+  The LZMA decoder is replaced with a deterministic, CPU bound generator and
+  the MP services PPI with a fake that runs the procedure on host threads, so
+  the tests can check that the parallel path produces byte-identical output
+  to the serial path and report the speedup.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/GoogleTestLib.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+extern "C" {
+  #include <PiPei.h>
+  #include <Library/BaseLib.h>
+  #include <Library/BaseMemoryLib.h>
+  #include "../ParallelLzmaDecompressPei.h"
+}
+
+using namespace testing;
+
+#define TEST_JOB_COUNT     16
+#define TEST_ROUNDS        64
+#define TEST_CPU_COUNT     8
+#define TEST_MIN_JOB_SIZE  SIZE_64KB
+
+///
+/// "Compressed" input understood by the fake decoder below.
+///
+typedef struct {
+  UINT32    Size;
+  UINT32    Seed;
+} FAKE_COMPRESSED_HEADER;
+
+STATIC std::atomic<UINT32>  mDecodeCalls[TEST_JOB_COUNT];
+
+/**
+  Generate the reference output for a fake compressed stream.
+**/
+STATIC
+VOID
+FakeExpand (
+  IN  CONST FAKE_COMPRESSED_HEADER  *Header,
+  OUT UINT8                         *Destination
+  )
+{
+  UINT32  State;
+  UINT32  Index;
+  UINT32  Round;
+
+  State = Header->Seed;
+  for (Index = 0; Index < Header->Size; Index++) {
+    for (Round = 0; Round < TEST_ROUNDS; Round++) {
+      State ^= State << 13;
+      State ^= State >> 17;
+      State ^= State << 5;
+    }
+
+    Destination[Index] = (UINT8)State;
+  }
+}
+
+extern "C" {
+  RETURN_STATUS
+  EFIAPI
+  LzmaUefiDecompress (
+    IN CONST VOID  *Source,
+    IN UINTN       SourceSize,
+    IN OUT VOID    *Destination,
+    IN OUT VOID    *Scratch
+    )
+  {
+    CONST FAKE_COMPRESSED_HEADER  *Header;
+
+    if (SourceSize < sizeof (FAKE_COMPRESSED_HEADER)) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    Header = (CONST FAKE_COMPRESSED_HEADER *)Source;
+    mDecodeCalls[Header->Seed % TEST_JOB_COUNT]++;
+    FakeExpand (Header, (UINT8 *)Destination);
+    return RETURN_SUCCESS;
+  }
+}
+
+STATIC UINTN       mFakeCpuCount;
+STATIC EFI_STATUS  mFakeStartupStatus;
+
+EFI_STATUS
+EFIAPI
+FakeStartupAllCpus (
+  IN  EDKII_PEI_MP_SERVICES2_PPI  *This,
+  IN  EFI_AP_PROCEDURE            Procedure,
+  IN  UINTN                       TimeoutInMicroSeconds,
+  IN  VOID                        *ProcedureArgument      OPTIONAL
+  )
+{
+  std::vector<std::thread>  Cpus;
+
+  if (EFI_ERROR (mFakeStartupStatus)) {
+    return mFakeStartupStatus;
+  }
+
+  for (UINTN Index = 0; Index < mFakeCpuCount; Index++) {
+    Cpus.emplace_back (Procedure, ProcedureArgument);
+  }
+
+  for (auto &Cpu : Cpus) {
+    Cpu.join ();
+  }
+
+  return EFI_SUCCESS;
+}
+
+class ParallelLzmaDecompressTest : public Test {
+protected:
+  EDKII_PEI_MP_SERVICES2_PPI                     MpServices;
+  FAKE_COMPRESSED_HEADER                         Sources[TEST_JOB_COUNT];
+  std::vector<std::vector<UINT8> >               Outputs;
+  PARALLEL_LZMA_JOB                              Jobs[TEST_JOB_COUNT];
+  PARALLEL_LZMA_JOB_QUEUE                        Queue;
+
+  void
+  SetUp (
+    ) override
+  {
+    ZeroMem (&MpServices, sizeof (MpServices));
+    MpServices.StartupAllCPUs = FakeStartupAllCpus;
+    mFakeCpuCount             = TEST_CPU_COUNT;
+    mFakeStartupStatus        = EFI_SUCCESS;
+
+    Outputs.resize (TEST_JOB_COUNT);
+    for (UINT32 Index = 0; Index < TEST_JOB_COUNT; Index++) {
+      mDecodeCalls[Index] = 0;
+      //
+      // Vary the job sizes so the queue has to balance uneven work.
+      //
+      Sources[Index].Size = TEST_MIN_JOB_SIZE * (1 + (Index % 4));
+      Sources[Index].Seed = Index + 1;
+      Outputs[Index].assign (Sources[Index].Size, 0);
+
+      Jobs[Index].Source          = &Sources[Index];
+      Jobs[Index].SourceSize      = sizeof (Sources[Index]);
+      Jobs[Index].Destination     = Outputs[Index].data ();
+      Jobs[Index].DestinationSize = Sources[Index].Size;
+      Jobs[Index].Status          = RETURN_NOT_STARTED;
+    }
+
+    Queue.Jobs     = Jobs;
+    Queue.JobCount = TEST_JOB_COUNT;
+  }
+
+  void
+  ExpectAllJobsDecodedOnce (
+    )
+  {
+    for (UINT32 Index = 0; Index < TEST_JOB_COUNT; Index++) {
+      std::vector<UINT8>  Expected (Sources[Index].Size);
+
+      FakeExpand (&Sources[Index], Expected.data ());
+      EXPECT_EQ (Jobs[Index].Status, RETURN_SUCCESS);
+      EXPECT_EQ (mDecodeCalls[(Index + 1) % TEST_JOB_COUNT].load (), 1u);
+      EXPECT_EQ (Outputs[Index], Expected);
+    }
+  }
+};
+
+// Without MP services, every job is decoded on the calling processor.
+TEST_F (ParallelLzmaDecompressTest, SerialDecodesEveryJob) {
+  EXPECT_EQ (ParallelLzmaDecompressRunJobs (NULL, &Queue), EFI_SUCCESS);
+  ExpectAllJobsDecodedOnce ();
+}
+
+// With MP services, every job is decoded exactly once, matching the serial output.
+TEST_F (ParallelLzmaDecompressTest, ParallelDecodesEveryJobOnce) {
+  EXPECT_EQ (ParallelLzmaDecompressRunJobs (&MpServices, &Queue), EFI_SUCCESS);
+  ExpectAllJobsDecodedOnce ();
+}
+
+// If the APs cannot be started, the BSP still decodes every job.
+TEST_F (ParallelLzmaDecompressTest, StartupFailureFallsBackToBsp) {
+  mFakeStartupStatus = EFI_NOT_READY;
+  EXPECT_EQ (ParallelLzmaDecompressRunJobs (&MpServices, &Queue), EFI_SUCCESS);
+  ExpectAllJobsDecodedOnce ();
+}
+
+// An empty queue is handled without touching any job.
+TEST_F (ParallelLzmaDecompressTest, EmptyQueue) {
+  Queue.JobCount = 0;
+  EXPECT_EQ (ParallelLzmaDecompressRunJobs (&MpServices, &Queue), EFI_SUCCESS);
+  for (UINT32 Index = 0; Index < TEST_JOB_COUNT; Index++) {
+    EXPECT_EQ (Jobs[Index].Status, RETURN_NOT_STARTED);
+  }
+}
+
+TEST_F (ParallelLzmaDecompressTest, NullQueue) {
+  EXPECT_EQ (ParallelLzmaDecompressRunJobs (&MpServices, NULL), EFI_INVALID_PARAMETER);
+}
+
+// Compare serial and parallel decode of the same jobs and report the speedup.
+TEST_F (ParallelLzmaDecompressTest, ParallelMatchesSerialAndReportsSpeedup) {
+  std::vector<std::vector<UINT8> >  SerialOutputs;
+
+  auto  Start = std::chrono::steady_clock::now ();
+
+  EXPECT_EQ (ParallelLzmaDecompressRunJobs (NULL, &Queue), EFI_SUCCESS);
+  auto  Serial = std::chrono::steady_clock::now () - Start;
+
+  SerialOutputs = Outputs;
+  for (UINT32 Index = 0; Index < TEST_JOB_COUNT; Index++) {
+    std::fill (Outputs[Index].begin (), Outputs[Index].end (), 0);
+    Jobs[Index].Status = RETURN_NOT_STARTED;
+  }
+
+  Start = std::chrono::steady_clock::now ();
+  EXPECT_EQ (ParallelLzmaDecompressRunJobs (&MpServices, &Queue), EFI_SUCCESS);
+  auto  Parallel = std::chrono::steady_clock::now () - Start;
+
+  for (UINT32 Index = 0; Index < TEST_JOB_COUNT; Index++) {
+    EXPECT_EQ (Jobs[Index].Status, RETURN_SUCCESS);
+    EXPECT_EQ (Outputs[Index], SerialOutputs[Index]);
+  }
+
+  RecordProperty ("SerialMicroseconds", (int)std::chrono::duration_cast<std::chrono::microseconds>(Serial).count ());
+  RecordProperty ("ParallelMicroseconds", (int)std::chrono::duration_cast<std::chrono::microseconds>(Parallel).count ());
+  RecordProperty ("Cpus", (int)mFakeCpuCount);
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}